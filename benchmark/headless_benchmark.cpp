@@ -0,0 +1,709 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file headless_benchmark.cpp
+ *
+ * @brief Measures the throughput and latency of acquiring and presenting images through the layer on headless
+ *        surfaces.
+ *
+ * Each configuration creates the requested number of swapchains, every one driven by its own thread, and acquires and
+ * presents images without rendering to them. The swapchains either each have their own device, or all share one device
+ * and queue, in which case the threads take turns presenting to the queue. It prints one line per configuration with
+ * the number of frames presented per second, over all the swapchains, and the p50/p99/p99.9 time spent in
+ * vkAcquireNextImageKHR and vkQueuePresentKHR.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace
+{
+
+constexpr const char *layer_name = "VK_LAYER_window_system_integration";
+
+/* Frames presented by each swapchain before the measurements start, so that every image has been presented once. */
+constexpr uint32_t warmup_frames = 16;
+
+struct options
+{
+   std::vector<VkPresentModeKHR> present_modes{ VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+                                                VK_PRESENT_MODE_IMMEDIATE_KHR };
+   std::vector<uint32_t> image_counts{ 2, 3, 4, 8 };
+   std::vector<uint32_t> swapchain_counts{ 1, 2, 4, 8, 16 };
+   std::vector<bool> shared_devices{ false };
+   uint32_t frames{ 500 };
+   VkExtent2D extent{ 256, 256 };
+};
+
+struct benchmark_config
+{
+   VkPresentModeKHR present_mode;
+   uint32_t image_count;
+   uint32_t swapchain_count;
+   /* Whether all the swapchains share one device and queue. */
+   bool shared_device;
+};
+
+/** @brief Resources of one swapchain and the samples measured while driving it. */
+struct swapchain_context
+{
+   VkSurfaceKHR surface{ VK_NULL_HANDLE };
+   VkDevice device{ VK_NULL_HANDLE };
+   VkQueue queue{ VK_NULL_HANDLE };
+   /* Serializes the presents of the swapchains sharing the queue, nullptr if the device is not shared. */
+   std::mutex *queue_lock{ nullptr };
+   VkSwapchainKHR swapchain{ VK_NULL_HANDLE };
+   /* Semaphore last signalled by the acquire of each image, plus a spare one for the next acquire. */
+   std::vector<VkSemaphore> image_semaphores;
+   VkSemaphore spare_semaphore{ VK_NULL_HANDLE };
+
+   std::vector<uint64_t> acquire_ns;
+   std::vector<uint64_t> present_ns;
+   VkResult result{ VK_SUCCESS };
+};
+
+[[noreturn]] void fail(const char *what, VkResult result)
+{
+   fprintf(stderr, "%s failed: %d\n", what, static_cast<int>(result));
+   exit(EXIT_FAILURE);
+}
+
+void check(VkResult result, const char *what)
+{
+   if (result < 0)
+   {
+      fail(what, result);
+   }
+}
+
+const char *present_mode_name(VkPresentModeKHR present_mode)
+{
+   switch (present_mode)
+   {
+   case VK_PRESENT_MODE_FIFO_KHR:
+      return "fifo";
+   case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+      return "fifo_relaxed";
+   case VK_PRESENT_MODE_MAILBOX_KHR:
+      return "mailbox";
+   case VK_PRESENT_MODE_IMMEDIATE_KHR:
+      return "immediate";
+   default:
+      return "unknown";
+   }
+}
+
+bool parse_present_mode(const std::string &name, VkPresentModeKHR &present_mode)
+{
+   for (VkPresentModeKHR mode : { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+                                  VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR })
+   {
+      if (name == present_mode_name(mode))
+      {
+         present_mode = mode;
+         return true;
+      }
+   }
+   return false;
+}
+
+/** @brief Split a comma separated list. */
+std::vector<std::string> split_list(const char *list)
+{
+   std::vector<std::string> items;
+   std::string item;
+   for (const char *c = list; *c != '\0'; c++)
+   {
+      if (*c == ',')
+      {
+         items.push_back(item);
+         item.clear();
+      }
+      else
+      {
+         item += *c;
+      }
+   }
+   items.push_back(item);
+   return items;
+}
+
+bool parse_count(const std::string &text, uint32_t &count)
+{
+   char *end = nullptr;
+   const unsigned long value = strtoul(text.c_str(), &end, 10);
+   if (text.empty() || *end != '\0' || value == 0 || value > UINT32_MAX)
+   {
+      return false;
+   }
+   count = static_cast<uint32_t>(value);
+   return true;
+}
+
+bool parse_counts(const char *list, std::vector<uint32_t> &counts)
+{
+   counts.clear();
+   for (const auto &item : split_list(list))
+   {
+      uint32_t count = 0;
+      if (!parse_count(item, count))
+      {
+         return false;
+      }
+      counts.push_back(count);
+   }
+   return true;
+}
+
+void print_usage(const char *program)
+{
+   fprintf(stderr,
+           "Usage: %s [options]\n"
+           "  --present-modes LIST  Present modes to measure, any of fifo, fifo_relaxed, mailbox and immediate\n"
+           "                        (default fifo,mailbox,immediate)\n"
+           "  --images LIST         Image counts of the swapchains (default 2,3,4,8)\n"
+           "  --swapchains LIST     Numbers of swapchains presenting concurrently, each from its own thread\n"
+           "                        (default 1,2,4,8,16)\n"
+           "  --devices LIST        own to give each swapchain its own device, shared to share one device and queue\n"
+           "                        between all of them (default own)\n"
+           "  --frames N            Frames measured per swapchain (default 500)\n"
+           "  --extent WxH          Size of the swapchain images (default 256x256)\n",
+           program);
+}
+
+bool parse_options(int argc, char **argv, options &opts)
+{
+   for (int i = 1; i < argc; i++)
+   {
+      const char *arg = argv[i];
+      const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+      if (value == nullptr)
+      {
+         return false;
+      }
+      i++;
+
+      if (strcmp(arg, "--present-modes") == 0)
+      {
+         opts.present_modes.clear();
+         for (const auto &name : split_list(value))
+         {
+            VkPresentModeKHR present_mode;
+            if (!parse_present_mode(name, present_mode))
+            {
+               return false;
+            }
+            opts.present_modes.push_back(present_mode);
+         }
+      }
+      else if (strcmp(arg, "--images") == 0)
+      {
+         if (!parse_counts(value, opts.image_counts))
+         {
+            return false;
+         }
+      }
+      else if (strcmp(arg, "--swapchains") == 0)
+      {
+         if (!parse_counts(value, opts.swapchain_counts))
+         {
+            return false;
+         }
+      }
+      else if (strcmp(arg, "--devices") == 0)
+      {
+         opts.shared_devices.clear();
+         for (const auto &name : split_list(value))
+         {
+            if (name != "own" && name != "shared")
+            {
+               return false;
+            }
+            opts.shared_devices.push_back(name == "shared");
+         }
+      }
+      else if (strcmp(arg, "--frames") == 0)
+      {
+         if (!parse_count(value, opts.frames))
+         {
+            return false;
+         }
+      }
+      else if (strcmp(arg, "--extent") == 0)
+      {
+         if (sscanf(value, "%ux%u", &opts.extent.width, &opts.extent.height) != 2 || opts.extent.width == 0 ||
+             opts.extent.height == 0)
+         {
+            return false;
+         }
+      }
+      else
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+uint64_t now_ns()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/** @brief The @p per_mille quantile of @p samples, which must be sorted. */
+uint64_t quantile(const std::vector<uint64_t> &samples, uint32_t per_mille)
+{
+   if (samples.empty())
+   {
+      return 0;
+   }
+   return samples[(samples.size() - 1) * per_mille / 1000];
+}
+
+class benchmark
+{
+public:
+   explicit benchmark(const options &opts)
+      : m_options(opts)
+   {
+   }
+
+   ~benchmark()
+   {
+      if (m_instance != VK_NULL_HANDLE)
+      {
+         vkDestroyInstance(m_instance, nullptr);
+      }
+   }
+
+   void init()
+   {
+      uint32_t layer_count = 0;
+      check(vkEnumerateInstanceLayerProperties(&layer_count, nullptr), "vkEnumerateInstanceLayerProperties");
+      std::vector<VkLayerProperties> layers(layer_count);
+      check(vkEnumerateInstanceLayerProperties(&layer_count, layers.data()), "vkEnumerateInstanceLayerProperties");
+      const bool layer_found = std::any_of(layers.begin(), layers.end(), [](const VkLayerProperties &layer) {
+         return strcmp(layer.layerName, layer_name) == 0;
+      });
+      if (!layer_found)
+      {
+         fprintf(stderr, "%s was not found by the Vulkan loader\n", layer_name);
+         exit(EXIT_FAILURE);
+      }
+
+      VkApplicationInfo app_info = {};
+      app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+      app_info.pApplicationName = "wsi_layer_benchmark";
+      app_info.apiVersion = VK_API_VERSION_1_1;
+
+      const char *extensions[] = { VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME };
+      VkInstanceCreateInfo instance_info = {};
+      instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+      instance_info.pApplicationInfo = &app_info;
+      instance_info.enabledLayerCount = 1;
+      instance_info.ppEnabledLayerNames = &layer_name;
+      instance_info.enabledExtensionCount = sizeof(extensions) / sizeof(extensions[0]);
+      instance_info.ppEnabledExtensionNames = extensions;
+      check(vkCreateInstance(&instance_info, nullptr, &m_instance), "vkCreateInstance");
+
+      m_create_headless_surface = reinterpret_cast<PFN_vkCreateHeadlessSurfaceEXT>(
+         vkGetInstanceProcAddr(m_instance, "vkCreateHeadlessSurfaceEXT"));
+      if (m_create_headless_surface == nullptr)
+      {
+         fail("vkGetInstanceProcAddr(vkCreateHeadlessSurfaceEXT)", VK_ERROR_EXTENSION_NOT_PRESENT);
+      }
+
+      uint32_t physical_device_count = 1;
+      VkResult result = vkEnumeratePhysicalDevices(m_instance, &physical_device_count, &m_physical_device);
+      if (result < 0 || physical_device_count == 0)
+      {
+         fail("vkEnumeratePhysicalDevices", result < 0 ? result : VK_ERROR_INITIALIZATION_FAILED);
+      }
+
+      VkSurfaceKHR surface = create_surface();
+      uint32_t family_count = 0;
+      vkGetPhysicalDeviceQueueFamilyProperties(m_physical_device, &family_count, nullptr);
+      m_queue_family = family_count;
+      for (uint32_t family = 0; family < family_count; family++)
+      {
+         VkBool32 supported = VK_FALSE;
+         check(vkGetPhysicalDeviceSurfaceSupportKHR(m_physical_device, family, surface, &supported),
+               "vkGetPhysicalDeviceSurfaceSupportKHR");
+         if (supported)
+         {
+            m_queue_family = family;
+            break;
+         }
+      }
+
+      uint32_t present_mode_count = 0;
+      check(vkGetPhysicalDeviceSurfacePresentModesKHR(m_physical_device, surface, &present_mode_count, nullptr),
+            "vkGetPhysicalDeviceSurfacePresentModesKHR");
+      m_supported_present_modes.resize(present_mode_count);
+      check(vkGetPhysicalDeviceSurfacePresentModesKHR(m_physical_device, surface, &present_mode_count,
+                                                      m_supported_present_modes.data()),
+            "vkGetPhysicalDeviceSurfacePresentModesKHR");
+
+      uint32_t format_count = 1;
+      result = vkGetPhysicalDeviceSurfaceFormatsKHR(m_physical_device, surface, &format_count, &m_surface_format);
+      if (result < 0 || format_count == 0)
+      {
+         fail("vkGetPhysicalDeviceSurfaceFormatsKHR", result < 0 ? result : VK_ERROR_FORMAT_NOT_SUPPORTED);
+      }
+
+      check(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physical_device, surface, &m_surface_capabilities),
+            "vkGetPhysicalDeviceSurfaceCapabilitiesKHR");
+      vkDestroySurfaceKHR(m_instance, surface, nullptr);
+
+      if (m_queue_family == family_count)
+      {
+         fail("vkGetPhysicalDeviceSurfaceSupportKHR", VK_ERROR_INCOMPATIBLE_DRIVER);
+      }
+   }
+
+   void run()
+   {
+      for (VkPresentModeKHR present_mode : m_options.present_modes)
+      {
+         for (uint32_t image_count : m_options.image_counts)
+         {
+            for (bool shared_device : m_options.shared_devices)
+            {
+               for (uint32_t swapchain_count : m_options.swapchain_counts)
+               {
+                  run_config({ present_mode, image_count, swapchain_count, shared_device });
+               }
+            }
+         }
+      }
+   }
+
+private:
+   VkSurfaceKHR create_surface()
+   {
+      VkHeadlessSurfaceCreateInfoEXT surface_info = {};
+      surface_info.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+      VkSurfaceKHR surface = VK_NULL_HANDLE;
+      check(m_create_headless_surface(m_instance, &surface_info, nullptr, &surface), "vkCreateHeadlessSurfaceEXT");
+      return surface;
+   }
+
+   bool is_supported(const benchmark_config &config) const
+   {
+      const bool present_mode_supported =
+         std::find(m_supported_present_modes.begin(), m_supported_present_modes.end(), config.present_mode) !=
+         m_supported_present_modes.end();
+      const bool image_count_supported =
+         config.image_count >= m_surface_capabilities.minImageCount &&
+         (m_surface_capabilities.maxImageCount == 0 || config.image_count <= m_surface_capabilities.maxImageCount);
+      return present_mode_supported && image_count_supported;
+   }
+
+   void create_device(VkDevice &device, VkQueue &queue)
+   {
+      const float priority = 1.0f;
+      VkDeviceQueueCreateInfo queue_info = {};
+      queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+      queue_info.queueFamilyIndex = m_queue_family;
+      queue_info.queueCount = 1;
+      queue_info.pQueuePriorities = &priority;
+
+      const char *extensions[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+      VkDeviceCreateInfo device_info = {};
+      device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+      device_info.queueCreateInfoCount = 1;
+      device_info.pQueueCreateInfos = &queue_info;
+      device_info.enabledExtensionCount = 1;
+      device_info.ppEnabledExtensionNames = extensions;
+      check(vkCreateDevice(m_physical_device, &device_info, nullptr, &device), "vkCreateDevice");
+      vkGetDeviceQueue(device, m_queue_family, 0, &queue);
+   }
+
+   void create_swapchain(const benchmark_config &config, swapchain_context &context)
+   {
+      context.surface = create_surface();
+
+      VkExtent2D extent = m_surface_capabilities.currentExtent;
+      if (extent.width == UINT32_MAX)
+      {
+         extent = m_options.extent;
+      }
+
+      VkCompositeAlphaFlagBitsKHR composite_alpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+      for (uint32_t bit = 1; bit <= static_cast<uint32_t>(VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR); bit <<= 1)
+      {
+         if (m_surface_capabilities.supportedCompositeAlpha & bit)
+         {
+            composite_alpha = static_cast<VkCompositeAlphaFlagBitsKHR>(bit);
+            break;
+         }
+      }
+
+      VkSwapchainCreateInfoKHR swapchain_info = {};
+      swapchain_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+      swapchain_info.surface = context.surface;
+      swapchain_info.minImageCount = config.image_count;
+      swapchain_info.imageFormat = m_surface_format.format;
+      swapchain_info.imageColorSpace = m_surface_format.colorSpace;
+      swapchain_info.imageExtent = extent;
+      swapchain_info.imageArrayLayers = 1;
+      swapchain_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+      swapchain_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      swapchain_info.preTransform = m_surface_capabilities.currentTransform;
+      swapchain_info.compositeAlpha = composite_alpha;
+      swapchain_info.presentMode = config.present_mode;
+      swapchain_info.clipped = VK_TRUE;
+      check(vkCreateSwapchainKHR(context.device, &swapchain_info, nullptr, &context.swapchain),
+            "vkCreateSwapchainKHR");
+
+      uint32_t image_count = 0;
+      check(vkGetSwapchainImagesKHR(context.device, context.swapchain, &image_count, nullptr),
+            "vkGetSwapchainImagesKHR");
+
+      VkSemaphoreCreateInfo semaphore_info = {};
+      semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      context.image_semaphores.resize(image_count, VK_NULL_HANDLE);
+      for (auto &semaphore : context.image_semaphores)
+      {
+         check(vkCreateSemaphore(context.device, &semaphore_info, nullptr, &semaphore), "vkCreateSemaphore");
+      }
+      check(vkCreateSemaphore(context.device, &semaphore_info, nullptr, &context.spare_semaphore),
+            "vkCreateSemaphore");
+
+      context.acquire_ns.reserve(m_options.frames);
+      context.present_ns.reserve(m_options.frames);
+   }
+
+   void destroy(swapchain_context &context)
+   {
+      if (context.queue_lock != nullptr)
+      {
+         std::lock_guard<std::mutex> lock(*context.queue_lock);
+         vkQueueWaitIdle(context.queue);
+      }
+      else
+      {
+         vkDeviceWaitIdle(context.device);
+      }
+      vkDestroySwapchainKHR(context.device, context.swapchain, nullptr);
+      for (VkSemaphore semaphore : context.image_semaphores)
+      {
+         vkDestroySemaphore(context.device, semaphore, nullptr);
+      }
+      vkDestroySemaphore(context.device, context.spare_semaphore, nullptr);
+      if (context.queue_lock == nullptr)
+      {
+         vkDestroyDevice(context.device, nullptr);
+      }
+      vkDestroySurfaceKHR(m_instance, context.surface, nullptr);
+   }
+
+   /**
+    * @brief Acquire and present the images of a swapchain, recording the time spent in each call.
+    *
+    * The image is acquired with the spare semaphore, which is then swapped with the one the image was last acquired
+    * with. The previous present of the image has completed once it is acquired again, so that semaphore is unused.
+    */
+   void drive(swapchain_context &context)
+   {
+      for (uint32_t frame = 0; frame < warmup_frames + m_options.frames; frame++)
+      {
+         uint32_t image_index = 0;
+         const uint64_t acquire_start = now_ns();
+         VkResult result = vkAcquireNextImageKHR(context.device, context.swapchain, UINT64_MAX,
+                                                 context.spare_semaphore, VK_NULL_HANDLE, &image_index);
+         const uint64_t acquire_end = now_ns();
+         if (result < 0)
+         {
+            context.result = result;
+            return;
+         }
+         std::swap(context.spare_semaphore, context.image_semaphores[image_index]);
+
+         VkPresentInfoKHR present_info = {};
+         present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+         present_info.waitSemaphoreCount = 1;
+         present_info.pWaitSemaphores = &context.image_semaphores[image_index];
+         present_info.swapchainCount = 1;
+         present_info.pSwapchains = &context.swapchain;
+         present_info.pImageIndices = &image_index;
+         const uint64_t present_start = now_ns();
+         if (context.queue_lock != nullptr)
+         {
+            std::lock_guard<std::mutex> lock(*context.queue_lock);
+            result = vkQueuePresentKHR(context.queue, &present_info);
+         }
+         else
+         {
+            result = vkQueuePresentKHR(context.queue, &present_info);
+         }
+         const uint64_t present_end = now_ns();
+         if (result < 0)
+         {
+            context.result = result;
+            return;
+         }
+
+         if (frame >= warmup_frames)
+         {
+            context.acquire_ns.push_back(acquire_end - acquire_start);
+            context.present_ns.push_back(present_end - present_start);
+         }
+      }
+   }
+
+   void run_config(const benchmark_config &config)
+   {
+      printf("present_mode %s images %" PRIu32 " device %s swapchains %" PRIu32, present_mode_name(config.present_mode),
+             config.image_count, config.shared_device ? "shared" : "own", config.swapchain_count);
+      if (!is_supported(config))
+      {
+         printf(" unsupported\n");
+         return;
+      }
+
+      VkDevice shared_device = VK_NULL_HANDLE;
+      VkQueue shared_queue = VK_NULL_HANDLE;
+      std::mutex shared_queue_lock;
+      if (config.shared_device)
+      {
+         create_device(shared_device, shared_queue);
+      }
+
+      std::vector<swapchain_context> contexts(config.swapchain_count);
+      for (auto &context : contexts)
+      {
+         if (config.shared_device)
+         {
+            context.device = shared_device;
+            context.queue = shared_queue;
+            context.queue_lock = &shared_queue_lock;
+         }
+         else
+         {
+            create_device(context.device, context.queue);
+         }
+         create_swapchain(config, context);
+      }
+
+      std::atomic<bool> start{ false };
+      std::vector<std::thread> threads;
+      for (auto &context : contexts)
+      {
+         threads.emplace_back([&]() {
+            while (!start.load(std::memory_order_acquire))
+            {
+               std::this_thread::yield();
+            }
+            drive(context);
+         });
+      }
+
+      const uint64_t start_time = now_ns();
+      start.store(true, std::memory_order_release);
+      for (auto &thread : threads)
+      {
+         thread.join();
+      }
+      const uint64_t duration_ns = now_ns() - start_time;
+
+      std::vector<uint64_t> acquire_ns;
+      std::vector<uint64_t> present_ns;
+      VkResult result = VK_SUCCESS;
+      for (auto &context : contexts)
+      {
+         acquire_ns.insert(acquire_ns.end(), context.acquire_ns.begin(), context.acquire_ns.end());
+         present_ns.insert(present_ns.end(), context.present_ns.begin(), context.present_ns.end());
+         if (context.result != VK_SUCCESS)
+         {
+            result = context.result;
+         }
+         destroy(context);
+      }
+      if (shared_device != VK_NULL_HANDLE)
+      {
+         vkDestroyDevice(shared_device, nullptr);
+      }
+
+      if (result != VK_SUCCESS)
+      {
+         printf(" failed %d\n", static_cast<int>(result));
+         return;
+      }
+
+      std::sort(acquire_ns.begin(), acquire_ns.end());
+      std::sort(present_ns.begin(), present_ns.end());
+      /* The warmup frames are included in the duration, so they count towards the throughput. */
+      const uint64_t frames = static_cast<uint64_t>(warmup_frames + m_options.frames) * config.swapchain_count;
+      printf(" frames %" PRIu64 " frames_per_s %.1f acquire_p50_ns %" PRIu64 " acquire_p99_ns %" PRIu64
+             " acquire_p999_ns %" PRIu64 " present_p50_ns %" PRIu64 " present_p99_ns %" PRIu64
+             " present_p999_ns %" PRIu64 "\n",
+             frames, static_cast<double>(frames) * 1e9 / static_cast<double>(duration_ns), quantile(acquire_ns, 500),
+             quantile(acquire_ns, 990), quantile(acquire_ns, 999), quantile(present_ns, 500), quantile(present_ns, 990),
+             quantile(present_ns, 999));
+      fflush(stdout);
+   }
+
+   const options &m_options;
+   VkInstance m_instance{ VK_NULL_HANDLE };
+   VkPhysicalDevice m_physical_device{ VK_NULL_HANDLE };
+   uint32_t m_queue_family{ 0 };
+   PFN_vkCreateHeadlessSurfaceEXT m_create_headless_surface{ nullptr };
+   std::vector<VkPresentModeKHR> m_supported_present_modes;
+   VkSurfaceFormatKHR m_surface_format{};
+   VkSurfaceCapabilitiesKHR m_surface_capabilities{};
+};
+
+} /* anonymous namespace */
+
+int main(int argc, char **argv)
+{
+   options opts;
+   if (!parse_options(argc, argv, opts))
+   {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   benchmark bench(opts);
+   bench.init();
+   bench.run();
+   return EXIT_SUCCESS;
+}
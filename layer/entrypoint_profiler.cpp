@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file entrypoint_profiler.cpp
+ *
+ * @brief Contains the implementation for measuring the CPU time spent in the swapchain entrypoints of the layer.
+ */
+
+#include "entrypoint_profiler.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <time.h>
+
+namespace layer
+{
+
+static const char *const entrypoint_names[] = {
+   "vkCreateSwapchainKHR", "vkDestroySwapchainKHR", "vkGetSwapchainImagesKHR",
+   "vkAcquireNextImageKHR", "vkQueuePresentKHR",
+};
+static_assert(sizeof(entrypoint_names) / sizeof(entrypoint_names[0]) ==
+                 static_cast<size_t>(entrypoint_profiler::entrypoint::count),
+              "Every entrypoint needs a name");
+
+static const char *const lock_names[] = {
+   "g_data_lock",
+   "swapchains_lock",
+   "internal_queue_lock",
+   "m_image_acquire_lock",
+};
+static_assert(sizeof(lock_names) / sizeof(lock_names[0]) == static_cast<size_t>(lock_profiler::lock_id::count),
+              "Every lock needs a name");
+
+std::array<lock_profiler::counters, static_cast<size_t>(lock_profiler::lock_id::count)> lock_profiler::s_counters;
+
+entrypoint_profiler::entrypoint_profiler()
+   : m_start_ns{ now() }
+{
+}
+
+uint64_t entrypoint_profiler::now()
+{
+   struct timespec ts = {};
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void entrypoint_profiler::record(entrypoint ep, uint64_t duration_ns)
+{
+   auto &entry = m_counters[static_cast<size_t>(ep)];
+   entry.call_count.fetch_add(1, std::memory_order_relaxed);
+   entry.total_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+
+   uint64_t max_ns = entry.max_ns.load(std::memory_order_relaxed);
+   while (duration_ns > max_ns && !entry.max_ns.compare_exchange_weak(max_ns, duration_ns, std::memory_order_relaxed))
+   {
+   }
+
+   size_t bucket = 0;
+   while (bucket + 1 < DURATION_BUCKET_COUNT && (duration_ns >> (bucket + 1)) != 0)
+   {
+      bucket++;
+   }
+   entry.duration_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void entrypoint_profiler::print_summary(const void *device) const
+{
+   const uint64_t elapsed_ns = now() - m_start_ns;
+   for (size_t i = 0; i < m_counters.size(); ++i)
+   {
+      const uint64_t call_count = m_counters[i].call_count.load(std::memory_order_relaxed);
+      if (call_count == 0)
+      {
+         continue;
+      }
+
+      /* The 99th percentile is reported as the upper bound of the bucket it falls in. */
+      const uint64_t tail_count = call_count - call_count * 99 / 100;
+      uint64_t counted = 0;
+      size_t p99_bucket = DURATION_BUCKET_COUNT - 1;
+      while (p99_bucket > 0)
+      {
+         counted += m_counters[i].duration_buckets[p99_bucket].load(std::memory_order_relaxed);
+         if (counted >= tail_count)
+         {
+            break;
+         }
+         p99_bucket--;
+      }
+      const uint64_t p99_ns = p99_bucket + 1 < DURATION_BUCKET_COUNT ? (uint64_t{ 1 } << (p99_bucket + 1)) : UINT64_MAX;
+
+      const uint64_t total_ns = m_counters[i].total_ns.load(std::memory_order_relaxed);
+      const uint64_t calls_per_s = elapsed_ns != 0 ? call_count * 1000000000ULL / elapsed_ns : 0;
+      fprintf(stderr,
+              "WSI layer profile: device %p %s calls %" PRIu64 " mean_ns %" PRIu64 " max_ns %" PRIu64 " total_ns %" PRIu64
+              " p99_ns %" PRIu64 " calls_per_s %" PRIu64 "\n",
+              device, entrypoint_names[i], call_count, total_ns / call_count,
+              m_counters[i].max_ns.load(std::memory_order_relaxed), total_ns, p99_ns, calls_per_s);
+   }
+}
+
+void lock_profiler::lock(std::unique_lock<std::mutex> &guard, lock_id id)
+{
+   auto &entry = s_counters[static_cast<size_t>(id)];
+   entry.acquisitions.fetch_add(1, std::memory_order_relaxed);
+   if (guard.try_lock())
+   {
+      return;
+   }
+
+   const uint64_t start_ns = entrypoint_profiler::now();
+   guard.lock();
+   entry.contended.fetch_add(1, std::memory_order_relaxed);
+   entry.wait_ns.fetch_add(entrypoint_profiler::now() - start_ns, std::memory_order_relaxed);
+}
+
+void lock_profiler::print_summary()
+{
+   for (size_t i = 0; i < s_counters.size(); ++i)
+   {
+      const uint64_t acquisitions = s_counters[i].acquisitions.load(std::memory_order_relaxed);
+      if (acquisitions == 0)
+      {
+         continue;
+      }
+
+      fprintf(stderr, "WSI layer locks: %s acquisitions %" PRIu64 " contended %" PRIu64 " wait_ns %" PRIu64 "\n",
+              lock_names[i], acquisitions, s_counters[i].contended.load(std::memory_order_relaxed),
+              s_counters[i].wait_ns.load(std::memory_order_relaxed));
+   }
+}
+
+} /* namespace layer */
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file entrypoint_profiler.hpp
+ *
+ * @brief Contains the class definition for measuring the CPU time spent in the swapchain entrypoints of the layer.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "util/helpers.hpp"
+
+#ifndef WSI_ENTRYPOINT_PROFILING
+#define WSI_ENTRYPOINT_PROFILING 0
+#endif
+
+namespace layer
+{
+
+/**
+ * @brief Accumulates the number of calls and the time spent in the swapchain entrypoints of a device.
+ *
+ * Only built with ENABLE_ENTRYPOINT_PROFILING. Together with an ICD that does no work, such as the Khronos mock ICD,
+ * the totals are the CPU cost of the layer itself: dispatch, locking and allocation.
+ */
+class entrypoint_profiler : private util::noncopyable
+{
+public:
+   enum class entrypoint
+   {
+      create_swapchain,
+      destroy_swapchain,
+      get_swapchain_images,
+      acquire_next_image,
+      queue_present,
+      count,
+   };
+
+   entrypoint_profiler();
+
+   /**
+    * @brief Measures the time from its construction to its destruction and records it for an entrypoint.
+    */
+   class scope : private util::noncopyable
+   {
+   public:
+      scope(entrypoint_profiler &profiler, entrypoint ep)
+         : m_profiler{ profiler }
+         , m_entrypoint{ ep }
+         , m_start_ns{ now() }
+      {
+      }
+
+      ~scope()
+      {
+         m_profiler.record(m_entrypoint, now() - m_start_ns);
+      }
+
+   private:
+      entrypoint_profiler &m_profiler;
+      entrypoint m_entrypoint;
+      uint64_t m_start_ns;
+   };
+
+   /**
+    * @brief Record a call of an entrypoint.
+    *
+    * @param ep          The entrypoint that was called.
+    * @param duration_ns Time spent in the call in nanoseconds.
+    */
+   void record(entrypoint ep, uint64_t duration_ns);
+
+   /**
+    * @brief Write the number of calls, the mean, maximum and 99th percentile time per call and the calls per second
+    * of each entrypoint to stderr.
+    *
+    * The summary is written in release builds too, so that it can be collected by CI.
+    *
+    * @param device The device the profiler belongs to, used to identify the summary.
+    */
+   void print_summary(const void *device) const;
+
+private:
+   /**
+    * @brief Get the current time.
+    *
+    * @return The CLOCK_MONOTONIC time in nanoseconds.
+    */
+   static uint64_t now();
+
+   /* Allow lock_profiler to time the waits with the same clock. */
+   friend class lock_profiler;
+
+   /* Bucket i counts the calls that took [2^i, 2^(i+1)) nanoseconds, bucket 0 also counts the ones below 1ns. */
+   static constexpr size_t DURATION_BUCKET_COUNT = 64;
+
+   struct counters
+   {
+      std::atomic<uint64_t> call_count{ 0 };
+      std::atomic<uint64_t> total_ns{ 0 };
+      std::atomic<uint64_t> max_ns{ 0 };
+      std::array<std::atomic<uint64_t>, DURATION_BUCKET_COUNT> duration_buckets{};
+   };
+
+   std::array<counters, static_cast<size_t>(entrypoint::count)> m_counters;
+
+   /* Time the profiler was created, the calls per second are measured from it. */
+   uint64_t m_start_ns;
+};
+
+/**
+ * @brief Counts how often the locks taken by the swapchain entrypoints are contended.
+ *
+ * Only built with ENABLE_ENTRYPOINT_PROFILING. The counters are shared by all the devices, so that running more
+ * threads, each presenting to its own swapchain or all sharing a device and queue, shows which lock stops scaling
+ * first: a lock is contended when it cannot be taken without blocking, and the time spent blocking is accumulated.
+ */
+class lock_profiler
+{
+public:
+   enum class lock_id
+   {
+      /* g_data_lock, taken when instances and devices are created or destroyed. */
+      private_data,
+      /* device_private_data::swapchains_lock, taken when swapchains are created or destroyed. */
+      swapchains,
+      /* device_private_data::internal_queue_lock, taken by the layer's own queue submissions. */
+      internal_queue,
+      /* swapchain_base::m_image_acquire_lock, taken when images are acquired or released. */
+      image_acquire,
+      count,
+   };
+
+   /**
+    * @brief Lock a mutex and record whether it was contended.
+    *
+    * @param guard A guard of the mutex that does not own it yet.
+    * @param id    The lock the mutex is.
+    */
+   static void lock(std::unique_lock<std::mutex> &guard, lock_id id);
+
+   /**
+    * @brief Write the number of acquisitions, contended acquisitions and time spent blocking of each lock to stderr.
+    */
+   static void print_summary();
+
+private:
+   struct counters
+   {
+      std::atomic<uint64_t> acquisitions{ 0 };
+      std::atomic<uint64_t> contended{ 0 };
+      std::atomic<uint64_t> wait_ns{ 0 };
+   };
+
+   static std::array<counters, static_cast<size_t>(lock_id::count)> s_counters;
+};
+
+} /* namespace layer */
+
+#if WSI_ENTRYPOINT_PROFILING
+#define WSI_PROFILE_ENTRYPOINT(device_data, ep)                                                 \
+   ::layer::entrypoint_profiler::scope entrypoint_profiler_scope{ (device_data).get_profiler(), \
+                                                                  ::layer::entrypoint_profiler::entrypoint::ep }
+#define WSI_PROFILED_LOCK(guard, mutex, id)                        \
+   std::unique_lock<std::mutex> guard{ mutex, std::defer_lock }; \
+   ::layer::lock_profiler::lock(guard, ::layer::lock_profiler::lock_id::id)
+#else
+#define WSI_PROFILE_ENTRYPOINT(device_data, ep) \
+   do                                           \
+   {                                            \
+   } while (0)
+#define WSI_PROFILED_LOCK(guard, mutex, id) std::unique_lock<std::mutex> guard{ mutex }
+#endif
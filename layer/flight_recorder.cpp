@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file flight_recorder.cpp
+ *
+ * @brief Contains the implementation for recording the latest presentation events of a device.
+ */
+
+#include "flight_recorder.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "layer/settings.hpp"
+#include "util/log.hpp"
+
+namespace layer
+{
+
+static constexpr uint32_t FILE_VERSION = 1;
+
+/* Number of devices whose flight recorder is dumped on signal. */
+static constexpr size_t MAX_SIGNAL_RECORDERS = 16;
+
+/* The recorders dumped on signal. Plain atomics rather than a locked container, as the handler reads them. */
+static std::atomic<const flight_recorder *> signal_recorders[MAX_SIGNAL_RECORDERS];
+
+/* Number of signal handlers dumping the recorders, so that a recorder is not destroyed while one reads it. */
+static std::atomic<uint32_t> signal_dumps_in_progress{ 0 };
+
+static std::atomic<uint32_t> dump_serial{ 0 };
+
+static void dump_on_signal(int)
+{
+   const int saved_errno = errno;
+   signal_dumps_in_progress.fetch_add(1, std::memory_order_seq_cst);
+   for (auto &recorder : signal_recorders)
+   {
+      const flight_recorder *r = recorder.load(std::memory_order_seq_cst);
+      if (r != nullptr)
+      {
+         r->dump(nullptr);
+      }
+   }
+   signal_dumps_in_progress.fetch_sub(1, std::memory_order_seq_cst);
+   errno = saved_errno;
+}
+
+/**
+ * @brief Append the decimal digits of @p value to @p buffer. Does not use the C library so that it can be used in a
+ *        signal handler.
+ *
+ * @return The position after the digits, or nullptr if they do not fit before @p end.
+ */
+static char *append_decimal(char *buffer, const char *end, uint32_t value)
+{
+   char digits[10];
+   size_t count = 0;
+   do
+   {
+      digits[count++] = static_cast<char>('0' + value % 10);
+      value /= 10;
+   } while (value != 0);
+
+   if (end - buffer < static_cast<ptrdiff_t>(count))
+   {
+      return nullptr;
+   }
+   while (count > 0)
+   {
+      *buffer++ = digits[--count];
+   }
+   return buffer;
+}
+
+/**
+ * @brief Append a null terminated string to @p buffer, see @ref append_decimal.
+ */
+static char *append_string(char *buffer, const char *end, const char *string)
+{
+   const size_t length = strlen(string);
+   if (end - buffer < static_cast<ptrdiff_t>(length))
+   {
+      return nullptr;
+   }
+   memcpy(buffer, string, length);
+   return buffer + length;
+}
+
+/**
+ * @brief Install the handler of the signal dumping the recorders, once per process.
+ */
+static void install_signal_handler(int signal_number)
+{
+   static std::atomic<int> installed_signal{ 0 };
+   int expected = 0;
+   if (!installed_signal.compare_exchange_strong(expected, signal_number))
+   {
+      if (expected != signal_number)
+      {
+         WSI_LOG_WARNING("Flight recorder already dumped on signal %d, ignoring signal %d.", expected, signal_number);
+      }
+      return;
+   }
+
+   struct sigaction action = {};
+   action.sa_handler = dump_on_signal;
+   sigemptyset(&action.sa_mask);
+   action.sa_flags = SA_RESTART;
+   if (sigaction(signal_number, &action, nullptr) != 0)
+   {
+      WSI_LOG_WARNING("Failed to install the flight recorder handler of signal %d.", signal_number);
+   }
+}
+
+flight_recorder::flight_recorder(const util::allocator &allocator)
+   : m_allocator{ allocator }
+{
+}
+
+flight_recorder::~flight_recorder()
+{
+   bool registered = false;
+   for (auto &recorder : signal_recorders)
+   {
+      const flight_recorder *expected = this;
+      registered |= recorder.compare_exchange_strong(expected, nullptr, std::memory_order_seq_cst);
+   }
+
+   /* A handler that started before the recorder was unregistered may still be dumping it on another thread. */
+   while (registered && signal_dumps_in_progress.load(std::memory_order_seq_cst) != 0)
+   {
+      sched_yield();
+   }
+
+   if (m_records != nullptr)
+   {
+      m_allocator.destroy(RECORD_COUNT, m_records);
+   }
+}
+
+void flight_recorder::enable(const layer_settings &settings)
+{
+   if (!settings.flight_recorder || m_records != nullptr)
+   {
+      return;
+   }
+
+   /* Without a directory set, dump to the runtime directory of the user rather than a shared one. */
+   const char *dir = settings.flight_recorder_dir;
+   if (dir[0] == '\0')
+   {
+      dir = std::getenv("XDG_RUNTIME_DIR");
+   }
+   if (dir != nullptr && dir[0] != '\0')
+   {
+      const int length =
+         snprintf(m_dump_prefix, sizeof(m_dump_prefix), "%s/wsi-flight-recorder-%d-%u-", dir,
+                  static_cast<int>(getpid()), dump_serial.fetch_add(1, std::memory_order_relaxed));
+      if (length < 0 || static_cast<size_t>(length) >= sizeof(m_dump_prefix))
+      {
+         m_dump_prefix[0] = '\0';
+      }
+   }
+   if (m_dump_prefix[0] == '\0')
+   {
+      WSI_LOG_INFO("No flight recorder directory, the flight recorder is only dumped to explicit paths.");
+   }
+
+   m_records = m_allocator.create<slot>(RECORD_COUNT);
+   if (m_records == nullptr)
+   {
+      WSI_LOG_WARNING("Failed to allocate the flight recorder, presentation events are not recorded.");
+      return;
+   }
+
+   if (settings.flight_recorder_signal != 0)
+   {
+      bool registered = false;
+      for (auto &recorder : signal_recorders)
+      {
+         const flight_recorder *expected = nullptr;
+         if (recorder.compare_exchange_strong(expected, this, std::memory_order_acq_rel))
+         {
+            registered = true;
+            break;
+         }
+      }
+
+      if (registered)
+      {
+         install_signal_handler(settings.flight_recorder_signal);
+      }
+      else
+      {
+         WSI_LOG_WARNING("Too many devices to dump their flight recorder on signal.");
+      }
+   }
+}
+
+int flight_recorder::open_default_dump_file() const
+{
+   if (m_dump_prefix[0] == '\0')
+   {
+      return -1;
+   }
+
+   /* Never follow or reuse an existing file, a name that is taken is skipped. */
+   for (uint32_t attempt = 0; attempt < MAX_DUMP_ATTEMPTS; attempt++)
+   {
+      char path[sizeof(m_dump_prefix) + 16];
+      const char *path_end = path + sizeof(path) - 1;
+      char *pos = append_string(path, path_end, m_dump_prefix);
+      pos = pos != nullptr ? append_decimal(pos, path_end, m_dump_count.fetch_add(1, std::memory_order_relaxed)) : pos;
+      pos = pos != nullptr ? append_string(pos, path_end, ".bin") : pos;
+      if (pos == nullptr)
+      {
+         return -1;
+      }
+      *pos = '\0';
+
+      const int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+      if (fd >= 0 || errno != EEXIST)
+      {
+         return fd;
+      }
+   }
+   return -1;
+}
+
+bool flight_recorder::dump(const char *path) const
+{
+   if (m_records == nullptr)
+   {
+      return false;
+   }
+
+   int fd = -1;
+   if (path != nullptr)
+   {
+      fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+   }
+   else
+   {
+      fd = open_default_dump_file();
+   }
+   if (fd < 0)
+   {
+      return false;
+   }
+
+   const uint64_t end = m_next.load(std::memory_order_acquire);
+   const uint64_t begin = end > RECORD_COUNT ? end - RECORD_COUNT : 0;
+   const size_t file_size =
+      sizeof(flight_recorder_file_header) + static_cast<size_t>(end - begin) * sizeof(flight_recorder_file_entry);
+   if (ftruncate(fd, static_cast<off_t>(file_size)) != 0)
+   {
+      close(fd);
+      return false;
+   }
+
+   void *mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (mapping == MAP_FAILED)
+   {
+      close(fd);
+      return false;
+   }
+
+   auto *entries = reinterpret_cast<flight_recorder_file_entry *>(static_cast<char *>(mapping) +
+                                                                   sizeof(flight_recorder_file_header));
+   uint32_t entry_count = 0;
+   for (uint64_t index = begin; index < end; index++)
+   {
+      const slot &s = m_records[index & (RECORD_COUNT - 1)];
+
+      /* Skip the slots being written, or overwritten by a newer event since the dump started. */
+      if (s.sequence.load(std::memory_order_acquire) != index + 1)
+      {
+         continue;
+      }
+      flight_recorder_file_entry entry = {};
+      entry.time_ns = s.time_ns.load(std::memory_order_relaxed);
+      entry.present_id = s.present_id.load(std::memory_order_relaxed);
+      entry.swapchain = s.swapchain.load(std::memory_order_relaxed);
+      const uint64_t info = s.info.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (s.sequence.load(std::memory_order_relaxed) != index + 1)
+      {
+         continue;
+      }
+
+      entry.value = static_cast<int32_t>(static_cast<uint32_t>(info >> 32));
+      entry.image_index = static_cast<uint16_t>(info >> 16);
+      entry.event = static_cast<uint16_t>(info);
+      entries[entry_count++] = entry;
+   }
+
+   flight_recorder_file_header header = {};
+   std::memcpy(header.magic, "WSIFLTR", sizeof(header.magic));
+   header.version = FILE_VERSION;
+   header.entry_count = entry_count;
+   std::memcpy(mapping, &header, sizeof(header));
+
+   munmap(mapping, file_size);
+
+   /* Drop the space of the skipped entries. */
+   const size_t used_size = sizeof(flight_recorder_file_header) + entry_count * sizeof(flight_recorder_file_entry);
+   const bool truncated = used_size == file_size || ftruncate(fd, static_cast<off_t>(used_size)) == 0;
+   close(fd);
+   return truncated;
+}
+
+} /* namespace layer */
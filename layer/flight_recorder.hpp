@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file flight_recorder.hpp
+ *
+ * @brief Contains the class definition for recording the latest presentation events of a device.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <time.h>
+
+#include "util/custom_allocator.hpp"
+#include "util/helpers.hpp"
+
+namespace layer
+{
+
+struct layer_settings;
+
+/**
+ * @brief Header of the files the flight recorder is dumped to, followed by @ref entry_count entries.
+ */
+struct flight_recorder_file_header
+{
+   /* "WSIFLTR" followed by a null character. */
+   char magic[8];
+   uint32_t version;
+   uint32_t entry_count;
+};
+
+/**
+ * @brief An event in the files the flight recorder is dumped to. Entries are sorted from the oldest to the newest.
+ */
+struct flight_recorder_file_entry
+{
+   /* CLOCK_MONOTONIC time of the event, in nanoseconds. */
+   uint64_t time_ns;
+   /* Present ID of the present the event belongs to, or 0. */
+   uint64_t present_id;
+   /* The swapchain the event happened on. */
+   uint64_t swapchain;
+   /* The VkResult of error events, whether the swapchain has an ancestor for swapchain creations, 0 otherwise. */
+   int32_t value;
+   /* A @ref flight_recorder::event. */
+   uint16_t event;
+   /* Index of the image the event happened on, or @ref flight_recorder::NO_IMAGE. */
+   uint16_t image_index;
+};
+
+/**
+ * @brief Keeps the latest presentation events of a device in a fixed size ring, so that the activity of the layer
+ *        leading to a stutter or an error can be looked at afterwards, without a tracer attached.
+ *
+ * Events are written without locks from any thread, at the cost of an atomic increment, a clock read and a few
+ * stores. Each slot of the ring has a sequence number written last, so a dump taken while events are being recorded
+ * skips the slots that are being written instead of reading torn events.
+ *
+ * The ring is dumped to a file on the first VK_ERROR_SURFACE_LOST_KHR of a swapchain, on the signal given by the
+ * "flight_recorder_signal" setting and through vkDumpFlightRecorderARM.
+ */
+class flight_recorder : private util::noncopyable
+{
+public:
+   enum class event : uint16_t
+   {
+      /* An image was acquired. */
+      acquire,
+      /* An image was queued for presentation. */
+      present,
+      /* The present payload of an image completed, and it is handed over to the presentation engine. */
+      payload_complete,
+      /* The presentation engine completed a present, e.g. flipped to the image. */
+      present_complete,
+      /* The presentation engine released an image. */
+      release,
+      /* The error state of a swapchain changed. */
+      error,
+      /* A swapchain was created. */
+      create_swapchain,
+   };
+
+   /* Image index of the events that do not belong to an image. */
+   static constexpr uint16_t NO_IMAGE = UINT16_MAX;
+
+   /* Number of events kept, a power of two. */
+   static constexpr size_t RECORD_COUNT = 4096;
+
+   explicit flight_recorder(const util::allocator &allocator);
+   ~flight_recorder();
+
+   /**
+    * @brief Allocate the ring, if the "flight_recorder" setting is enabled, and register it for the dumps on signal.
+    *
+    * The recorder stays disabled if the ring cannot be allocated.
+    *
+    * @param settings The settings of the instance of the device.
+    */
+   void enable(const layer_settings &settings);
+
+   /**
+    * @brief Record an event.
+    *
+    * @param ev          The event.
+    * @param swapchain   The swapchain the event happened on.
+    * @param present_id  Present ID of the present the event belongs to, or 0.
+    * @param image_index Index of the image the event happened on, or @ref NO_IMAGE.
+    * @param value       Value of the event, see @ref flight_recorder_file_entry::value.
+    */
+   void record(event ev, const void *swapchain, uint64_t present_id, uint32_t image_index, int32_t value = 0)
+   {
+      if (m_records == nullptr)
+      {
+         return;
+      }
+
+      const uint64_t index = m_next.fetch_add(1, std::memory_order_relaxed);
+      slot &s = m_records[index & (RECORD_COUNT - 1)];
+
+      /* Mark the slot as being written before changing it, see dump. */
+      s.sequence.store(0, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      struct timespec ts = {};
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      s.time_ns.store(static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec),
+                      std::memory_order_relaxed);
+      s.present_id.store(present_id, std::memory_order_relaxed);
+      s.swapchain.store(reinterpret_cast<uintptr_t>(swapchain), std::memory_order_relaxed);
+      s.info.store((static_cast<uint64_t>(static_cast<uint32_t>(value)) << 32) |
+                      (static_cast<uint64_t>(image_index & NO_IMAGE) << 16) | static_cast<uint64_t>(ev),
+                   std::memory_order_relaxed);
+      s.sequence.store(index + 1, std::memory_order_release);
+   }
+
+   /**
+    * @brief Whether events are being recorded.
+    */
+   bool is_enabled() const
+   {
+      return m_records != nullptr;
+   }
+
+   /**
+    * @brief Write the recorded events to a file, through a shared mapping of the file.
+    *
+    * Only makes system calls and does not allocate, so it can be called from a signal handler.
+    *
+    * @param path Path of the file, or nullptr for a new file in the directory given by the "flight_recorder_dir"
+    *             setting. Symbolic links are not followed.
+    *
+    * @return true if the events were written.
+    */
+   bool dump(const char *path) const;
+
+private:
+   /**
+    * @brief A slot of the ring. The fields are atomics so that a dump may read them while they are written.
+    */
+   struct slot
+   {
+      /* Index of the event in the slot plus one, 0 while it is being written. */
+      std::atomic<uint64_t> sequence{ 0 };
+      std::atomic<uint64_t> time_ns{ 0 };
+      std::atomic<uint64_t> present_id{ 0 };
+      std::atomic<uint64_t> swapchain{ 0 };
+      /* The value in the upper 32 bits, the image index and the event in the lower ones. */
+      std::atomic<uint64_t> info{ 0 };
+   };
+
+   const util::allocator m_allocator;
+   slot *m_records{ nullptr };
+   std::atomic<uint64_t> m_next{ 0 };
+
+   /* Number of attempts to find a free file name for a dump to the default directory. */
+   static constexpr uint32_t MAX_DUMP_ATTEMPTS = 16;
+
+   /**
+    * @brief Create a new file in the directory given by the "flight_recorder_dir" setting, readable only by the user.
+    *
+    * @return The file descriptor, or -1 on failure.
+    */
+   int open_default_dump_file() const;
+
+   /* Path of the dumps to the default directory without their number, set by enable. Empty for no default dumps. */
+   char m_dump_prefix[256]{};
+   /* Number of the next dump to the default directory. */
+   mutable std::atomic<uint32_t> m_dump_count{ 0 };
+};
+
+} /* namespace layer */
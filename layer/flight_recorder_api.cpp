@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file flight_recorder_api.cpp
+ *
+ * @brief Contains the Vulkan entrypoint for dumping the flight recorder of a device.
+ */
+#include "wsi_layer_experimental.hpp"
+
+#include <layer/private_data.hpp>
+#include <util/log.hpp>
+#include "util/macros.hpp"
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+/**
+ * @brief Implements vkDumpFlightRecorderARM entrypoint.
+ */
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkDumpFlightRecorderARM(VkDevice device, const char *pPath) VWL_API_POST
+{
+   auto &recorder = layer::device_private_data::get(device).get_flight_recorder();
+   if (!recorder.is_enabled())
+   {
+      return VK_ERROR_FEATURE_NOT_PRESENT;
+   }
+
+   if (!recorder.dump(pPath))
+   {
+      WSI_LOG_ERROR("Failed to dump the flight recorder.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+   return VK_SUCCESS;
+}
+#endif /* VULKAN_WSI_LAYER_EXPERIMENTAL */
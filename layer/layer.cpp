@@ -22,10 +22,12 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstring>
 #include <array>
+#include <optional>
 
 #include <vulkan/vk_layer.h>
 #include <vulkan/vulkan.h>
@@ -41,6 +43,7 @@
 #include "util/log.hpp"
 #include "util/macros.hpp"
 #include "util/helpers.hpp"
+#include "util/proc_addr_table.hpp"
 #include "wsi/unsupported_surfaces.hpp"
 
 #define VK_LAYER_API_VERSION VK_MAKE_VERSION(1, 2, VK_HEADER_VERSION)
@@ -125,6 +128,8 @@ VKAPI_ATTR VkResult create_instance(const VkInstanceCreateInfo *pCreateInfo, con
       return VK_ERROR_INITIALIZATION_FAILED;
    }
 
+   const layer_settings settings = read_layer_settings(*pCreateInfo);
+
    /* For instances handled by the layer, we need to enable extra extensions, therefore take a copy of pCreateInfo. */
    VkInstanceCreateInfo modified_info = *pCreateInfo;
 
@@ -186,23 +191,19 @@ VKAPI_ATTR VkResult create_instance(const VkInstanceCreateInfo *pCreateInfo, con
     * otherwise use the default callbacks.
     */
    util::allocator instance_allocator{ VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE, pAllocator };
-   std::optional<instance_dispatch_table> table = instance_dispatch_table::create(instance_allocator);
-   if (!table.has_value())
-   {
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
-   }
-
-   TRY_LOG_CALL(table->populate(*pInstance, fpGetInstanceProcAddr));
-   table->set_user_enabled_extensions(pCreateInfo->ppEnabledExtensionNames, pCreateInfo->enabledExtensionCount);
+   instance_dispatch_table table{};
+   TRY_LOG_CALL(table.populate(*pInstance, fpGetInstanceProcAddr));
+   table.set_user_enabled_extensions(pCreateInfo->ppEnabledExtensionNames, pCreateInfo->enabledExtensionCount);
 
    uint32_t api_version =
       pCreateInfo->pApplicationInfo != nullptr ? pCreateInfo->pApplicationInfo->apiVersion : VK_API_VERSION_1_3;
 
-   TRY_LOG_CALL(instance_private_data::associate(*pInstance, std::move(*table), loader_callback,
+   TRY_LOG_CALL(instance_private_data::associate(*pInstance, std::move(table), loader_callback,
                                                  layer_platforms_to_enable, api_version, instance_allocator));
 
    /* Set the swapchain maintenance flag to true or false based on the enabled extensions checked above*/
    instance_private_data::get(*pInstance).set_maintainance1_support(maintainance1_support);
+   instance_private_data::get(*pInstance).set_layer_settings(settings);
    /*
     * Store the enabled instance extensions in order to return nullptr in
     * vkGetInstanceProcAddr for functions of disabled extensions.
@@ -219,6 +220,99 @@ VKAPI_ATTR VkResult create_instance(const VkInstanceCreateInfo *pCreateInfo, con
    return VK_SUCCESS;
 }
 
+/**
+ * @brief Add a queue for the synchronization only submissions of the layer to the queues created with a device.
+ *
+ * Queue families the application does not create queues from are preferred, otherwise the queue is added after the
+ * queues the application creates from a family with a queue to spare. Nothing is added if no family has one.
+ *
+ * @param instance             The instance private data of the physical device.
+ * @param physical_device      The physical device.
+ * @param allocator            Allocator for the queue family properties.
+ * @param[in,out] create_info  The create info of the device, pointed to @p queue_infos when a queue is added.
+ * @param[out] queue_infos     Storage for the queue create infos with the added queue.
+ * @param[out] priorities      Storage for the priorities of the queues created with the added queue.
+ *
+ * @return The queue family index and the queue index of the added queue, or an empty optional if none was added.
+ */
+static std::optional<std::pair<uint32_t, uint32_t>> reserve_internal_queue(
+   instance_private_data &instance, VkPhysicalDevice physical_device, const util::allocator &allocator,
+   VkDeviceCreateInfo &create_info, util::vector<VkDeviceQueueCreateInfo> &queue_infos, util::vector<float> &priorities)
+{
+   uint32_t family_count = 0;
+   instance.disp.GetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+   util::vector<VkQueueFamilyProperties> families{ allocator };
+   if (!families.try_resize(family_count))
+   {
+      return std::nullopt;
+   }
+   instance.disp.GetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+   std::optional<uint32_t> chosen_family;
+   std::optional<uint32_t> chosen_info;
+   for (uint32_t family = 0; family < family_count && (!chosen_family.has_value() || chosen_info.has_value());
+        family++)
+   {
+      std::optional<uint32_t> family_info;
+      for (uint32_t i = 0; i < create_info.queueCreateInfoCount; i++)
+      {
+         const auto &queue_info = create_info.pQueueCreateInfos[i];
+         if (queue_info.queueFamilyIndex == family && queue_info.flags == 0)
+         {
+            family_info = i;
+         }
+      }
+
+      const uint32_t used = family_info.has_value() ? create_info.pQueueCreateInfos[*family_info].queueCount : 0;
+      if (families[family].queueCount > used && (!chosen_family.has_value() || !family_info.has_value()))
+      {
+         chosen_family = family;
+         chosen_info = family_info;
+      }
+   }
+
+   if (!chosen_family.has_value() ||
+       !queue_infos.try_resize(create_info.queueCreateInfoCount + (chosen_info.has_value() ? 0 : 1)))
+   {
+      return std::nullopt;
+   }
+   std::copy(create_info.pQueueCreateInfos, create_info.pQueueCreateInfos + create_info.queueCreateInfoCount,
+             queue_infos.begin());
+
+   uint32_t queue_index = 0;
+   if (chosen_info.has_value())
+   {
+      auto &queue_info = queue_infos[*chosen_info];
+      queue_index = queue_info.queueCount;
+      if (!priorities.try_resize(queue_index + 1))
+      {
+         return std::nullopt;
+      }
+      std::copy(queue_info.pQueuePriorities, queue_info.pQueuePriorities + queue_index, priorities.begin());
+      queue_info.queueCount++;
+      queue_info.pQueuePriorities = priorities.data();
+   }
+   else
+   {
+      if (!priorities.try_resize(1))
+      {
+         return std::nullopt;
+      }
+      auto &queue_info = queue_infos[create_info.queueCreateInfoCount];
+      queue_info = {};
+      queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+      queue_info.queueFamilyIndex = *chosen_family;
+      queue_info.queueCount = 1;
+      queue_info.pQueuePriorities = priorities.data();
+   }
+   /* The submissions carry no work, so the highest priority does not take any GPU time from the application. */
+   priorities[queue_index] = 1.0f;
+
+   create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_infos.size());
+   create_info.pQueueCreateInfos = queue_infos.data();
+   return std::make_pair(*chosen_family, queue_index);
+}
+
 VKAPI_ATTR VkResult create_device(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo *pCreateInfo,
                                   const VkAllocationCallbacks *pAllocator, VkDevice *pDevice)
 {
@@ -272,7 +366,7 @@ VKAPI_ATTR VkResult create_device(VkPhysicalDevice physicalDevice, const VkDevic
    bool should_layer_handle_frame_boundary_events = false;
    VkPhysicalDeviceFrameBoundaryFeaturesEXT frame_boundary;
 
-   if (ENABLE_INSTRUMENTATION)
+   if (inst_data.get_layer_settings().instrumentation_level >= 1)
    {
       if (enabled_extensions.contains(VK_EXT_FRAME_BOUNDARY_EXTENSION_NAME))
       {
@@ -310,6 +404,19 @@ VKAPI_ATTR VkResult create_device(VkPhysicalDevice physicalDevice, const VkDevic
       }
    }
 
+   util::vector<VkDeviceQueueCreateInfo> modified_queue_infos{ allocator };
+   util::vector<float> internal_queue_priorities{ allocator };
+   std::optional<std::pair<uint32_t, uint32_t>> internal_queue;
+   if (!enabled_platforms.empty() && inst_data.get_layer_settings().internal_queue)
+   {
+      internal_queue = reserve_internal_queue(inst_data, physicalDevice, allocator, modified_info,
+                                              modified_queue_infos, internal_queue_priorities);
+      if (!internal_queue.has_value())
+      {
+         WSI_LOG_WARNING("No queue to spare for the layer, sharing the queues of the application.");
+      }
+   }
+
    /* Now call create device on the chain further down the list. */
    TRY_LOG(fpCreateDevice(physicalDevice, &modified_info, pAllocator, pDevice), "Failed to create the device");
 
@@ -321,23 +428,17 @@ VKAPI_ATTR VkResult create_device(VkPhysicalDevice physicalDevice, const VkDevic
     * provided to the instance (if no allocator callbacks was provided to the instance, it will use default ones).
     */
    util::allocator device_allocator{ inst_data.get_allocator(), VK_SYSTEM_ALLOCATION_SCOPE_DEVICE, pAllocator };
-   std::optional<device_dispatch_table> table = device_dispatch_table::create(device_allocator);
-   if (!table.has_value())
-   {
-      fn_destroy_device(*pDevice, pAllocator);
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
-   }
-
-   VkResult result = table->populate(*pDevice, fpGetDeviceProcAddr);
+   device_dispatch_table table{};
+   VkResult result = table.populate(*pDevice, fpGetDeviceProcAddr);
    if (result != VK_SUCCESS)
    {
       fn_destroy_device(*pDevice, pAllocator);
       return result;
    }
 
-   table->set_user_enabled_extensions(pCreateInfo->ppEnabledExtensionNames, pCreateInfo->enabledExtensionCount);
+   table.set_user_enabled_extensions(pCreateInfo->ppEnabledExtensionNames, pCreateInfo->enabledExtensionCount);
 
-   result = device_private_data::associate(*pDevice, inst_data, physicalDevice, std::move(*table), loader_callback,
+   result = device_private_data::associate(*pDevice, inst_data, physicalDevice, std::move(table), loader_callback,
                                            device_allocator);
    if (result != VK_SUCCESS)
    {
@@ -361,6 +462,29 @@ VKAPI_ATTR VkResult create_device(VkPhysicalDevice physicalDevice, const VkDevic
       return result;
    }
 
+   /* Only record the queues of the application, which never presents on the internal queue. */
+   result = device_data.set_device_queues(*pCreateInfo);
+   if (result != VK_SUCCESS)
+   {
+      layer::device_private_data::disassociate(*pDevice);
+      fn_destroy_device(*pDevice, pAllocator);
+      return result;
+   }
+
+   if (internal_queue.has_value())
+   {
+      VkQueue queue = VK_NULL_HANDLE;
+      device_data.disp.GetDeviceQueue(*pDevice, internal_queue->first, internal_queue->second, &queue);
+      result = loader_callback(*pDevice, queue);
+      if (result != VK_SUCCESS)
+      {
+         layer::device_private_data::disassociate(*pDevice);
+         fn_destroy_device(*pDevice, pAllocator);
+         return result;
+      }
+      device_data.set_internal_queue(queue, internal_queue->first);
+   }
+
    const auto *swapchain_compression_feature =
       util::find_extension<VkPhysicalDeviceImageCompressionControlSwapchainFeaturesEXT>(
          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_COMPRESSION_CONTROL_SWAPCHAIN_FEATURES_EXT, pCreateInfo->pNext);
@@ -386,6 +510,15 @@ VKAPI_ATTR VkResult create_device(VkPhysicalDevice physicalDevice, const VkDevic
          physical_device_swapchain_maintenance1_features->swapchainMaintenance1);
    }
 
+   const auto *timeline_semaphore_features = util::find_extension<VkPhysicalDeviceTimelineSemaphoreFeatures>(
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES, pCreateInfo->pNext);
+   const auto *vulkan_12_features = util::find_extension<VkPhysicalDeviceVulkan12Features>(
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES, pCreateInfo->pNext);
+   device_data.set_timeline_semaphore_enabled(
+      (timeline_semaphore_features != nullptr && timeline_semaphore_features->timelineSemaphore) ||
+      (vulkan_12_features != nullptr && vulkan_12_features->timelineSemaphore));
+   device_data.setup_present_semaphore_export();
+
    return VK_SUCCESS;
 }
 
@@ -406,8 +539,8 @@ wsi_layer_vkDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pA
       return;
    }
 
-   auto fn_destroy_instance =
-      layer::instance_private_data::get(instance).disp.get_fn<PFN_vkDestroyInstance>("vkDestroyInstance");
+   auto fn_destroy_instance = layer::instance_private_data::get(instance).disp.get_fn<PFN_vkDestroyInstance>(
+      layer::instance_entrypoint::DestroyInstance);
 
    /* Call disassociate() before doing vkDestroyInstance as an instance may be created by a different thread
     * just after we call vkDestroyInstance() and it could get the same address if we are unlucky.
@@ -426,7 +559,11 @@ wsi_layer_vkDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocat
       return;
    }
 
-   auto fn_destroy_device = layer::device_private_data::get(device).disp.get_fn<PFN_vkDestroyDevice>("vkDestroyDevice");
+   auto fn_destroy_device =
+      layer::device_private_data::get(device).disp.get_fn<PFN_vkDestroyDevice>(layer::device_entrypoint::DestroyDevice);
+
+   /* The swapchains waiting to be destroyed in the background use the device private data. */
+   layer::device_private_data::get(device).stop_swapchain_reaper();
 
    /* Call disassociate() before doing vkDestroyDevice as a device may be created by a different thread
     * just after we call vkDestroyDevice().
@@ -502,6 +639,13 @@ wsi_layer_vkGetPhysicalDeviceFeatures2KHR(VkPhysicalDevice physicalDevice,
       present_id_features->presentId = true;
    }
 
+   auto *present_wait_features = util::find_extension<VkPhysicalDevicePresentWaitFeaturesKHR>(
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR, pFeatures->pNext);
+   if (present_wait_features != nullptr)
+   {
+      present_wait_features->presentWait = true;
+   }
+
    wsi::set_swapchain_maintenance1_state(physicalDevice, physical_device_swapchain_maintenance1_features);
 
 #if VULKAN_WSI_LAYER_EXPERIMENTAL
@@ -516,76 +660,101 @@ wsi_layer_vkGetPhysicalDeviceFeatures2KHR(VkPhysicalDevice physicalDevice,
 #endif
 }
 
-#define GET_PROC_ADDR(func)      \
-   if (!strcmp(funcName, #func)) \
-      return (PFN_vkVoidFunction)&wsi_layer_##func;
+#define LAYER_PROC_ADDR(func, ext_name) { #func, ext_name, &util::erase_proc_addr<&wsi_layer_##func> }
+
+/* Device entrypoints implemented by the layer, sorted by name. */
+static constexpr util::proc_addr_entry device_proc_addr_table[] = {
+   LAYER_PROC_ADDR(vkAcquireNextImage2KHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkAcquireNextImageKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkBindImageMemory2, nullptr),
+   LAYER_PROC_ADDR(vkCreateImage, nullptr),
+   LAYER_PROC_ADDR(vkCreateSemaphore, nullptr),
+   LAYER_PROC_ADDR(vkCreateSwapchainKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkDestroyDevice, nullptr),
+   LAYER_PROC_ADDR(vkDestroySemaphore, nullptr),
+   LAYER_PROC_ADDR(vkDestroySwapchainKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   LAYER_PROC_ADDR(vkDumpFlightRecorderARM, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+#endif
+   LAYER_PROC_ADDR(vkGetDeviceGroupPresentCapabilitiesKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkGetDeviceGroupSurfacePresentModesKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   LAYER_PROC_ADDR(vkGetPastPresentationTimingEXT, VK_EXT_PRESENT_TIMING_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkGetSwapchainFrameStatisticsARM, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+#endif
+   LAYER_PROC_ADDR(vkGetSwapchainImagesKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   LAYER_PROC_ADDR(vkGetSwapchainLatencyHistogramsARM, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkGetSwapchainMemoryUsageARM, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+#endif
+   LAYER_PROC_ADDR(vkGetSwapchainStatusKHR, VK_KHR_SHARED_PRESENTABLE_IMAGE_EXTENSION_NAME),
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   LAYER_PROC_ADDR(vkGetSwapchainTimeDomainPropertiesEXT, VK_EXT_PRESENT_TIMING_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkGetSwapchainTimingPropertiesEXT, VK_EXT_PRESENT_TIMING_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkLatencySleepARM, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+#endif
+   LAYER_PROC_ADDR(vkQueuePresentKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkReleaseSwapchainImagesEXT, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME),
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   LAYER_PROC_ADDR(vkSetLatencyMarkerARM, VK_KHR_SWAPCHAIN_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkSetSwapchainPresentTimingQueueSizeEXT, VK_EXT_PRESENT_TIMING_EXTENSION_NAME),
+#endif
+   LAYER_PROC_ADDR(vkWaitForPresentKHR, VK_KHR_PRESENT_WAIT_EXTENSION_NAME),
+};
+static_assert(util::is_sorted_by_name(device_proc_addr_table), "Device entrypoints must be sorted by name");
+
+/* Instance entrypoints implemented by the layer, sorted by name. Entrypoints of the surface extensions implemented
+ * by the WSI backends are resolved by wsi::get_proc_addr.
+ */
+static constexpr util::proc_addr_entry instance_proc_addr_table[] = {
+   LAYER_PROC_ADDR(vkCreateDevice, nullptr),
+   LAYER_PROC_ADDR(vkCreateInstance, nullptr),
+   LAYER_PROC_ADDR(vkDestroyInstance, nullptr),
+   LAYER_PROC_ADDR(vkDestroySurfaceKHR, VK_KHR_SURFACE_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkGetDeviceProcAddr, nullptr),
+   LAYER_PROC_ADDR(vkGetInstanceProcAddr, nullptr),
+   { "vkGetPhysicalDeviceFeatures2", nullptr, &util::erase_proc_addr<&wsi_layer_vkGetPhysicalDeviceFeatures2KHR> },
+   LAYER_PROC_ADDR(vkGetPhysicalDeviceFeatures2KHR, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkGetPhysicalDevicePresentRectanglesKHR, nullptr),
+   /* VK_KHR_get_surface_capabilities2 requires VK_KHR_surface, so checking the former is enough. */
+   LAYER_PROC_ADDR(vkGetPhysicalDeviceSurfaceCapabilities2KHR, VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkGetPhysicalDeviceSurfaceCapabilitiesKHR, VK_KHR_SURFACE_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkGetPhysicalDeviceSurfaceFormats2KHR, VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkGetPhysicalDeviceSurfaceFormatsKHR, VK_KHR_SURFACE_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkGetPhysicalDeviceSurfacePresentModesKHR, VK_KHR_SURFACE_EXTENSION_NAME),
+   LAYER_PROC_ADDR(vkGetPhysicalDeviceSurfaceSupportKHR, VK_KHR_SURFACE_EXTENSION_NAME),
+};
+static_assert(util::is_sorted_by_name(instance_proc_addr_table), "Instance entrypoints must be sorted by name");
+
+#undef LAYER_PROC_ADDR
 
 VWL_VKAPI_CALL(PFN_vkVoidFunction)
 wsi_layer_vkGetDeviceProcAddr(VkDevice device, const char *funcName) VWL_API_POST
 {
-   if (layer::device_private_data::get(device).is_device_extension_enabled(VK_KHR_SWAPCHAIN_EXTENSION_NAME))
-   {
-      GET_PROC_ADDR(vkCreateSwapchainKHR);
-      GET_PROC_ADDR(vkDestroySwapchainKHR);
-      GET_PROC_ADDR(vkGetSwapchainImagesKHR);
-      GET_PROC_ADDR(vkAcquireNextImageKHR);
-      GET_PROC_ADDR(vkQueuePresentKHR);
-      GET_PROC_ADDR(vkAcquireNextImage2KHR);
-      GET_PROC_ADDR(vkGetDeviceGroupPresentCapabilitiesKHR);
-      GET_PROC_ADDR(vkGetDeviceGroupSurfacePresentModesKHR);
-   }
-   if (layer::device_private_data::get(device).is_device_extension_enabled(
-          VK_KHR_SHARED_PRESENTABLE_IMAGE_EXTENSION_NAME))
-   {
-      GET_PROC_ADDR(vkGetSwapchainStatusKHR);
-   }
-#if VULKAN_WSI_LAYER_EXPERIMENTAL
-   if (layer::device_private_data::get(device).is_device_extension_enabled(VK_EXT_PRESENT_TIMING_EXTENSION_NAME))
-   {
-      GET_PROC_ADDR(vkSetSwapchainPresentTimingQueueSizeEXT);
-      GET_PROC_ADDR(vkGetSwapchainTimingPropertiesEXT);
-      GET_PROC_ADDR(vkGetSwapchainTimeDomainPropertiesEXT);
-      GET_PROC_ADDR(vkGetPastPresentationTimingEXT);
-   }
-#endif
-   GET_PROC_ADDR(vkDestroyDevice);
-
-   GET_PROC_ADDR(vkCreateImage);
-   GET_PROC_ADDR(vkBindImageMemory2);
+   auto &device_data = layer::device_private_data::get(device);
 
-   /* VK_EXT_swapchain_maintenance1 */
-   if (layer::device_private_data::get(device).is_device_extension_enabled(
-          VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME))
+   const util::proc_addr_entry *entry = util::find_proc_addr(device_proc_addr_table, funcName);
+   if (entry != nullptr && (entry->ext_name == nullptr || device_data.is_device_extension_enabled(entry->ext_name)))
    {
-      GET_PROC_ADDR(vkReleaseSwapchainImagesEXT);
+      return entry->get_fn();
    }
 
-   return layer::device_private_data::get(device).disp.get_user_enabled_entrypoint(
-      device, layer::device_private_data::get(device).instance_data.api_version, funcName);
+   return device_data.disp.get_user_enabled_entrypoint(device, device_data.instance_data.api_version, funcName);
 }
 
 VWL_VKAPI_CALL(PFN_vkVoidFunction)
 wsi_layer_vkGetInstanceProcAddr(VkInstance instance, const char *funcName) VWL_API_POST
 {
-   GET_PROC_ADDR(vkGetDeviceProcAddr);
-   GET_PROC_ADDR(vkGetInstanceProcAddr);
-   GET_PROC_ADDR(vkCreateInstance);
-   GET_PROC_ADDR(vkDestroyInstance);
-   GET_PROC_ADDR(vkCreateDevice);
-   GET_PROC_ADDR(vkGetPhysicalDevicePresentRectanglesKHR);
-
-   if (!strcmp(funcName, "vkGetPhysicalDeviceFeatures2"))
+   /* Entrypoints that are always exposed are resolved first, as instance may be VK_NULL_HANDLE for them. */
+   const util::proc_addr_entry *entry = util::find_proc_addr(instance_proc_addr_table, funcName);
+   if (entry != nullptr && entry->ext_name == nullptr)
    {
-      return (PFN_vkVoidFunction)wsi_layer_vkGetPhysicalDeviceFeatures2KHR;
+      return entry->get_fn();
    }
 
    auto &instance_data = layer::instance_private_data::get(instance);
 
-   if (instance_data.is_instance_extension_enabled(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
-   {
-      GET_PROC_ADDR(vkGetPhysicalDeviceFeatures2KHR);
-   }
-
+   /* The WSI backends may override the surface entrypoints of the layer, so they are queried first. */
    if (instance_data.is_instance_extension_enabled(VK_KHR_SURFACE_EXTENSION_NAME))
    {
       PFN_vkVoidFunction wsi_func = wsi::get_proc_addr(funcName, instance_data);
@@ -593,18 +762,11 @@ wsi_layer_vkGetInstanceProcAddr(VkInstance instance, const char *funcName) VWL_A
       {
          return wsi_func;
       }
+   }
 
-      GET_PROC_ADDR(vkGetPhysicalDeviceSurfaceSupportKHR);
-      GET_PROC_ADDR(vkGetPhysicalDeviceSurfaceCapabilitiesKHR);
-      GET_PROC_ADDR(vkGetPhysicalDeviceSurfaceFormatsKHR);
-      GET_PROC_ADDR(vkGetPhysicalDeviceSurfacePresentModesKHR);
-      GET_PROC_ADDR(vkDestroySurfaceKHR);
-
-      if (instance_data.is_instance_extension_enabled(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME))
-      {
-         GET_PROC_ADDR(vkGetPhysicalDeviceSurfaceCapabilities2KHR);
-         GET_PROC_ADDR(vkGetPhysicalDeviceSurfaceFormats2KHR);
-      }
+   if (entry != nullptr && instance_data.is_instance_extension_enabled(entry->ext_name))
+   {
+      return entry->get_fn();
    }
 
    return instance_data.disp.get_user_enabled_entrypoint(instance, instance_data.api_version, funcName);
@@ -26,142 +26,100 @@
 
 #include "private_data.hpp"
 #include "wsi/wsi_factory.hpp"
+#include "wsi/presentation_worker_pool.hpp"
+#include "wsi/swapchain_reaper.hpp"
 #include "wsi/surface.hpp"
-#include "util/unordered_map.hpp"
+#include "util/allocation_tracker.hpp"
+#include "util/atomic_pointer_map.hpp"
+#include "util/proc_addr_table.hpp"
 #include "util/log.hpp"
 #include "util/helpers.hpp"
 #include "util/macros.hpp"
 
+#include <cstdlib>
+
 namespace layer
 {
 
+/* Serializes insertions and removals in the maps below. Lookups do not take it, as they happen on every intercepted
+ * call and the maps support wait-free lookups concurrently with a single writer.
+ */
 static std::mutex g_data_lock;
 
 /* The dictionaries below use plain pointers to store the instance/device private data objects.
  * This means that these objects are leaked if the application terminates without calling vkDestroyInstance
  * or vkDestroyDevice. This is fine as it is the application's responsibility to call these.
  */
-static util::unordered_map<void *, instance_private_data *> g_instance_data{ util::allocator::get_generic() };
-static util::unordered_map<void *, device_private_data *> g_device_data{ util::allocator::get_generic() };
+static util::atomic_pointer_map<instance_private_data> g_instance_data{ util::allocator::get_generic() };
+static util::atomic_pointer_map<device_private_data> g_device_data{ util::allocator::get_generic() };
 
-VkResult instance_dispatch_table::populate(VkInstance instance, PFN_vkGetInstanceProcAddr get_proc)
-{
-   static constexpr entrypoint entrypoints_init[] = {
+static constexpr entrypoint instance_entrypoints_init[] = {
 #define DISPATCH_TABLE_ENTRY(name, ext_name, api_version, required) \
    { "vk" #name, ext_name, nullptr, api_version, false, required },
-      INSTANCE_ENTRYPOINTS_LIST(DISPATCH_TABLE_ENTRY)
+   INSTANCE_ENTRYPOINTS_LIST(DISPATCH_TABLE_ENTRY)
 #undef DISPATCH_TABLE_ENTRY
-   };
+};
 
-   static constexpr auto num_entrypoints = std::distance(std::begin(entrypoints_init), std::end(entrypoints_init));
+static constexpr entrypoint device_entrypoints_init[] = {
+#define DISPATCH_TABLE_ENTRY(name, ext_name, api_version, required) \
+   { "vk" #name, ext_name, nullptr, api_version, false, required },
+   DEVICE_ENTRYPOINTS_LIST(DISPATCH_TABLE_ENTRY)
+#undef DISPATCH_TABLE_ENTRY
+};
 
-   for (size_t i = 0; i < num_entrypoints; i++)
-   {
-      const entrypoint *entrypoint = &entrypoints_init[i];
-      PFN_vkVoidFunction ret = get_proc(instance, entrypoint->name);
-      if (!ret && entrypoint->required)
-      {
-         return VK_ERROR_INITIALIZATION_FAILED;
-      }
-      struct entrypoint e = *entrypoint;
-      e.fn = ret;
-      e.user_visible = false;
+static constexpr auto instance_entrypoints_name_order = util::sort_by_name(instance_entrypoints_init);
+static constexpr auto device_entrypoints_name_order = util::sort_by_name(device_entrypoints_init);
 
-      if (!m_entrypoints->try_insert(std::make_pair(e.name, e)).has_value())
-      {
-         WSI_LOG_ERROR("Failed to allocate memory for instance dispatch table entry.");
-         return VK_ERROR_OUT_OF_HOST_MEMORY;
-      }
-   }
+/**
+ * @brief Check whether the user is allowed to use an entrypoint of the dispatch table.
+ *
+ * An entrypoint is allowed to use if it has been enabled by the user or is included in the core specification of the
+ * API version. Entrypoints included in API version 1.0 are allowed by default.
+ */
+static bool is_entrypoint_user_enabled(const entrypoint &item, uint32_t api_version)
+{
+   return item.user_visible || item.api_version <= api_version || item.api_version == VK_API_VERSION_1_0;
+}
 
-   return VK_SUCCESS;
+instance_dispatch_table::instance_dispatch_table()
+   : dispatch_table{ instance_entrypoints_init, instance_entrypoints_name_order }
+{
 }
 
-void dispatch_table::set_user_enabled_extensions(const char *const *extension_names, size_t extension_count)
+VkResult instance_dispatch_table::populate(VkInstance instance, PFN_vkGetInstanceProcAddr get_proc)
 {
-   for (size_t i = 0; i < extension_count; i++)
-   {
-      for (auto &entrypoint : *m_entrypoints)
-      {
-         if (!strcmp(entrypoint.second.ext_name, extension_names[i]))
-         {
-            entrypoint.second.user_visible = true;
-         }
-      }
-   }
+   return populate_entrypoints(instance, get_proc);
 }
 
 PFN_vkVoidFunction instance_dispatch_table::get_user_enabled_entrypoint(VkInstance instance, uint32_t api_version,
                                                                         const char *fn_name) const
 {
-   auto item = m_entrypoints->find(fn_name);
-   if (item != m_entrypoints->end())
+   const entrypoint *item = find_entrypoint(fn_name);
+   if (item != nullptr)
    {
-      /* An entrypoint is allowed to use if it has been enabled by the user or is included in the core specficiation of the API version.
-       * Entrypoints included in API version 1.0 are allowed by default. */
-      if (item->second.user_visible || item->second.api_version <= api_version ||
-          item->second.api_version == VK_API_VERSION_1_0)
-      {
-         return item->second.fn;
-      }
-      else
-      {
-         return nullptr;
-      }
+      return is_entrypoint_user_enabled(*item, api_version) ? item->fn : nullptr;
    }
 
    return GetInstanceProcAddr(instance, fn_name).value_or(nullptr);
 }
 
-VkResult device_dispatch_table::populate(VkDevice dev, PFN_vkGetDeviceProcAddr get_proc_fn)
+device_dispatch_table::device_dispatch_table()
+   : dispatch_table{ device_entrypoints_init, device_entrypoints_name_order }
 {
-   static constexpr entrypoint entrypoints_init[] = {
-#define DISPATCH_TABLE_ENTRY(name, ext_name, api_version, required) \
-   { "vk" #name, ext_name, nullptr, api_version, false, required },
-      DEVICE_ENTRYPOINTS_LIST(DISPATCH_TABLE_ENTRY)
-#undef DISPATCH_TABLE_ENTRY
-   };
-   static constexpr auto num_entrypoints = std::distance(std::begin(entrypoints_init), std::end(entrypoints_init));
-
-   for (size_t i = 0; i < num_entrypoints; i++)
-   {
-      const entrypoint entrypoint = entrypoints_init[i];
-      PFN_vkVoidFunction ret = get_proc_fn(dev, entrypoint.name);
-      if (!ret && entrypoint.required)
-      {
-         return VK_ERROR_INITIALIZATION_FAILED;
-      }
-      struct entrypoint e = entrypoint;
-      e.fn = ret;
-      e.user_visible = false;
-
-      if (!m_entrypoints->try_insert(std::make_pair(e.name, e)).has_value())
-      {
-         WSI_LOG_ERROR("Failed to allocate memory for device dispatch table entry.");
-         return VK_ERROR_OUT_OF_HOST_MEMORY;
-      }
-   }
+}
 
-   return VK_SUCCESS;
+VkResult device_dispatch_table::populate(VkDevice dev, PFN_vkGetDeviceProcAddr get_proc_fn)
+{
+   return populate_entrypoints(dev, get_proc_fn);
 }
 
 PFN_vkVoidFunction device_dispatch_table::get_user_enabled_entrypoint(VkDevice device, uint32_t api_version,
                                                                       const char *fn_name) const
 {
-   auto item = m_entrypoints->find(fn_name);
-   if (item != m_entrypoints->end())
+   const entrypoint *item = find_entrypoint(fn_name);
+   if (item != nullptr)
    {
-      /* An entrypoint is allowed to use if it has been enabled by the user or is included in the core specficiation of the API version.
-       * Entrypoints included in API version 1.0 are allowed by default. */
-      if (item->second.user_visible || item->second.api_version <= api_version ||
-          item->second.api_version == VK_API_VERSION_1_0)
-      {
-         return item->second.fn;
-      }
-      else
-      {
-         return nullptr;
-      }
+      return is_entrypoint_user_enabled(*item, api_version) ? item->fn : nullptr;
    }
 
    return GetDeviceProcAddr(device, fn_name).value_or(nullptr);
@@ -177,6 +135,7 @@ instance_private_data::instance_private_data(instance_dispatch_table table, PFN_
    , allocator{ alloc }
    , surfaces{ alloc }
    , enabled_extensions{ allocator }
+   , physical_devices{ allocator }
 {
 }
 
@@ -208,19 +167,17 @@ VkResult instance_private_data::associate(VkInstance instance, instance_dispatch
    }
 
    const auto key = get_key(instance);
-   scoped_mutex lock(g_data_lock);
+   WSI_PROFILED_LOCK(lock, g_data_lock, private_data);
 
-   auto it = g_instance_data.find(key);
-   if (it != g_instance_data.end())
+   instance_private_data *previous_data = g_instance_data.erase(key);
+   if (previous_data != nullptr)
    {
       WSI_LOG_WARNING("Hash collision when adding new instance (%p)", reinterpret_cast<void *>(instance));
 
-      destroy(it->second);
-      g_instance_data.erase(it);
+      destroy(previous_data);
    }
 
-   auto result = g_instance_data.try_insert(std::make_pair(key, instance_data.get()));
-   if (result.has_value())
+   if (g_instance_data.insert(key, instance_data.get()))
    {
       instance_data.release(); // NOLINT(bugprone-unused-return-value)
       return VK_SUCCESS;
@@ -239,16 +196,13 @@ void instance_private_data::disassociate(VkInstance instance)
    assert(instance != VK_NULL_HANDLE);
    instance_private_data *instance_data = nullptr;
    {
-      scoped_mutex lock(g_data_lock);
-      auto it = g_instance_data.find(get_key(instance));
-      if (it == g_instance_data.end())
+      WSI_PROFILED_LOCK(lock, g_data_lock, private_data);
+      instance_data = g_instance_data.erase(get_key(instance));
+      if (instance_data == nullptr)
       {
          WSI_LOG_WARNING("Failed to find private data for instance (%p)", reinterpret_cast<void *>(instance));
          return;
       }
-
-      instance_data = it->second;
-      g_instance_data.erase(it);
    }
 
    destroy(instance_data);
@@ -257,8 +211,9 @@ void instance_private_data::disassociate(VkInstance instance)
 template <typename dispatchable_type>
 static instance_private_data &get_instance_private_data(dispatchable_type dispatchable_object)
 {
-   scoped_mutex lock(g_data_lock);
-   return *g_instance_data.at(get_key(dispatchable_object));
+   instance_private_data *instance_data = g_instance_data.find(get_key(dispatchable_object));
+   assert(instance_data != nullptr);
+   return *instance_data;
 }
 
 instance_private_data &instance_private_data::get(VkInstance instance)
@@ -358,28 +313,114 @@ bool instance_private_data::should_layer_handle_surface(VkPhysicalDevice phys_de
    return ret;
 }
 
-bool instance_private_data::has_image_compression_support(VkPhysicalDevice phys_dev)
+instance_private_data::physical_device_support *instance_private_data::get_physical_device_support(
+   VkPhysicalDevice phys_dev)
 {
+   scoped_mutex lock(physical_devices_lock);
+   for (auto &support : physical_devices)
+   {
+      if (support->physical_device == phys_dev)
+      {
+         return support.get();
+      }
+   }
+
+   auto support = allocator.make_unique<physical_device_support>(phys_dev, allocator);
+   if (support == nullptr)
+   {
+      return nullptr;
+   }
+
+   util::vector<VkExtensionProperties> properties{ util::allocator(allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) };
+   uint32_t count = 0;
+   VkResult result = disp.EnumerateDeviceExtensionProperties(phys_dev, nullptr, &count, nullptr);
+   if (result == VK_SUCCESS && !properties.try_resize(count))
+   {
+      result = VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   if (result == VK_SUCCESS)
+   {
+      result = disp.EnumerateDeviceExtensionProperties(phys_dev, nullptr, &count, properties.data());
+   }
+   if (result == VK_SUCCESS)
+   {
+      result = support->extensions.add(properties.data(), count);
+   }
+   if (result != VK_SUCCESS)
+   {
+      WSI_LOG_ERROR("Failed to enumerate properties of available physical device extensions");
+      return nullptr;
+   }
+
+   VkPhysicalDeviceFrameBoundaryFeaturesEXT frame_boundary = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAME_BOUNDARY_FEATURES_EXT, nullptr, VK_FALSE
+   };
    VkPhysicalDeviceImageCompressionControlFeaturesEXT compression = {
-      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_COMPRESSION_CONTROL_FEATURES_EXT, nullptr, VK_FALSE
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_COMPRESSION_CONTROL_FEATURES_EXT, &frame_boundary, VK_FALSE
    };
    VkPhysicalDeviceFeatures2KHR features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR, &compression, {} };
 
    disp.GetPhysicalDeviceFeatures2KHR(phys_dev, &features);
+   support->image_compression_control = compression.imageCompressionControl != VK_FALSE;
+   support->frame_boundary = frame_boundary.frameBoundary != VK_FALSE;
+
+   if (support->extensions.contains(VK_EXT_PHYSICAL_DEVICE_DRM_EXTENSION_NAME))
+   {
+      VkPhysicalDeviceDrmPropertiesEXT drm_properties = {};
+      drm_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DRM_PROPERTIES_EXT;
+      VkPhysicalDeviceProperties2KHR properties2 = {};
+      properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+      properties2.pNext = &drm_properties;
+      disp.GetPhysicalDeviceProperties2KHR(phys_dev, &properties2);
+
+      support->has_render_node = drm_properties.hasRender != VK_FALSE;
+      support->render_major = drm_properties.renderMajor;
+      support->render_minor = drm_properties.renderMinor;
+   }
 
-   return compression.imageCompressionControl != VK_FALSE;
+   if (!physical_devices.try_push_back(std::move(support)))
+   {
+      return nullptr;
+   }
+   return physical_devices.back().get();
+}
+
+bool instance_private_data::has_image_compression_support(VkPhysicalDevice phys_dev)
+{
+   const physical_device_support *support = get_physical_device_support(phys_dev);
+   return support != nullptr && support->image_compression_control;
 }
 
 bool instance_private_data::has_frame_boundary_support(VkPhysicalDevice phys_dev)
 {
-   VkPhysicalDeviceFrameBoundaryFeaturesEXT frame_boundary = {
-      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_COMPRESSION_CONTROL_FEATURES_EXT, nullptr, VK_FALSE
-   };
-   VkPhysicalDeviceFeatures2KHR features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR, &frame_boundary, {} };
+   const physical_device_support *support = get_physical_device_support(phys_dev);
+   return support != nullptr && support->frame_boundary;
+}
 
-   disp.GetPhysicalDeviceFeatures2KHR(phys_dev, &features);
+bool instance_private_data::get_render_node(VkPhysicalDevice phys_dev, int64_t &major, int64_t &minor)
+{
+   const physical_device_support *support = get_physical_device_support(phys_dev);
+   if (support == nullptr || !support->has_render_node)
+   {
+      return false;
+   }
 
-   return frame_boundary.frameBoundary != VK_FALSE;
+   major = support->render_major;
+   minor = support->render_minor;
+   return true;
+}
+
+VkResult instance_private_data::get_available_device_extensions(VkPhysicalDevice phys_dev,
+                                                                const util::extension_list *&extensions)
+{
+   const physical_device_support *support = get_physical_device_support(phys_dev);
+   if (support == nullptr)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   extensions = &support->extensions;
+   return VK_SUCCESS;
 }
 
 VkResult instance_private_data::set_instance_enabled_extensions(const char *const *extension_names,
@@ -403,6 +444,38 @@ bool instance_private_data::get_maintainance1_support()
    return enabled_unsupported_swapchain_maintenance1_extensions;
 }
 
+void instance_private_data::set_layer_settings(const layer_settings &new_settings)
+{
+   settings = new_settings;
+}
+
+const layer_settings &instance_private_data::get_layer_settings() const
+{
+   return settings;
+}
+
+void instance_private_data::add_deferred_swapchain_destruction()
+{
+   scoped_mutex lock(deferred_swapchain_destructions_lock);
+   deferred_swapchain_destructions++;
+}
+
+void instance_private_data::complete_deferred_swapchain_destruction()
+{
+   {
+      scoped_mutex lock(deferred_swapchain_destructions_lock);
+      assert(deferred_swapchain_destructions > 0);
+      deferred_swapchain_destructions--;
+   }
+   deferred_swapchain_destructions_done.notify_all();
+}
+
+void instance_private_data::wait_for_deferred_swapchain_destructions()
+{
+   std::unique_lock<std::mutex> lock(deferred_swapchain_destructions_lock);
+   deferred_swapchain_destructions_done.wait(lock, [this]() { return deferred_swapchain_destructions == 0; });
+}
+
 device_private_data::device_private_data(instance_private_data &inst_data, VkPhysicalDevice phys_dev, VkDevice dev,
                                          device_dispatch_table table, PFN_vkSetDeviceLoaderData set_loader_data,
                                          const util::allocator &alloc)
@@ -414,14 +487,27 @@ device_private_data::device_private_data(instance_private_data &inst_data, VkPhy
    , allocator{ alloc }
    , swapchains{ allocator } /* clang-format off */
    , enabled_extensions{ allocator }
+   , queue_families{ allocator }
    , compression_control_enabled{ false }
    , present_id_enabled { false }
    , swapchain_maintenance1_enabled{ false }
+   , timeline_semaphore_enabled{ false }
 #if VULKAN_WSI_LAYER_EXPERIMENTAL
    , present_timing_enabled { true }
 #endif
+   , exportable_semaphores{ allocator }
+   , sync_objects{ *this, allocator }
+   , format_modifier_cache{ phys_dev, allocator }
+   , import_memory_types{ allocator }
+   , recorder{ allocator }
 /* clang-format on */
 {
+   VkPhysicalDeviceMemoryProperties2 memory_props = {};
+   memory_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+   instance_data.disp.GetPhysicalDeviceMemoryProperties2KHR(physical_device, &memory_props);
+   memory_properties = memory_props.memoryProperties;
+
+   recorder.enable(instance_data.get_layer_settings());
 }
 
 VkResult device_private_data::associate(VkDevice dev, instance_private_data &inst_data, VkPhysicalDevice phys_dev,
@@ -439,18 +525,16 @@ VkResult device_private_data::associate(VkDevice dev, instance_private_data &ins
    }
 
    const auto key = get_key(dev);
-   scoped_mutex lock(g_data_lock);
+   WSI_PROFILED_LOCK(lock, g_data_lock, private_data);
 
-   auto it = g_device_data.find(key);
-   if (it != g_device_data.end())
+   device_private_data *previous_data = g_device_data.erase(key);
+   if (previous_data != nullptr)
    {
       WSI_LOG_WARNING("Hash collision when adding new device (%p)", reinterpret_cast<void *>(dev));
-      destroy(it->second);
-      g_device_data.erase(it);
+      destroy(previous_data);
    }
 
-   auto result = g_device_data.try_insert(std::make_pair(key, device_data.get()));
-   if (result.has_value())
+   if (g_device_data.insert(key, device_data.get()))
    {
       device_data.release(); // NOLINT(bugprone-unused-return-value)
       return VK_SUCCESS;
@@ -469,16 +553,13 @@ void device_private_data::disassociate(VkDevice dev)
    assert(dev != VK_NULL_HANDLE);
    device_private_data *device_data = nullptr;
    {
-      scoped_mutex lock(g_data_lock);
-      auto it = g_device_data.find(get_key(dev));
-      if (it == g_device_data.end())
+      WSI_PROFILED_LOCK(lock, g_data_lock, private_data);
+      device_data = g_device_data.erase(get_key(dev));
+      if (device_data == nullptr)
       {
          WSI_LOG_WARNING("Failed to find private data for device (%p)", reinterpret_cast<void *>(dev));
          return;
       }
-
-      device_data = it->second;
-      g_device_data.erase(it);
    }
 
    destroy(device_data);
@@ -487,9 +568,9 @@ void device_private_data::disassociate(VkDevice dev)
 template <typename dispatchable_type>
 static device_private_data &get_device_private_data(dispatchable_type dispatchable_object)
 {
-   scoped_mutex lock(g_data_lock);
-
-   return *g_device_data.at(get_key(dispatchable_object));
+   device_private_data *device_data = g_device_data.find(get_key(dispatchable_object));
+   assert(device_data != nullptr);
+   return *device_data;
 }
 
 device_private_data &device_private_data::get(VkDevice device)
@@ -502,29 +583,40 @@ device_private_data &device_private_data::get(VkQueue queue)
    return get_device_private_data(queue);
 }
 
-VkResult device_private_data::add_layer_swapchain(VkSwapchainKHR swapchain)
+/**
+ * @brief Get the key of a swapchain handle in the swapchains map of a device.
+ * @note Swapchains created by the layer are swapchain_base pointers, so their key is the pointer itself.
+ */
+static const void *get_swapchain_key(VkSwapchainKHR swapchain)
 {
-   scoped_mutex lock(swapchains_lock);
-   auto result = swapchains.try_insert(swapchain);
-   return result.has_value() ? VK_SUCCESS : VK_ERROR_OUT_OF_HOST_MEMORY;
+   return reinterpret_cast<const void *>(swapchain);
 }
 
-void device_private_data::remove_layer_swapchain(VkSwapchainKHR swapchain)
+VkResult device_private_data::add_layer_swapchain(VkSwapchainKHR swapchain)
 {
-   scoped_mutex lock(swapchains_lock);
-   auto it = swapchains.find(swapchain);
-   if (it != swapchains.end())
+   WSI_PROFILED_LOCK(lock, swapchains_lock, swapchains);
+   if (!swapchains.insert(get_swapchain_key(swapchain), reinterpret_cast<wsi::swapchain_base *>(swapchain)))
    {
-      swapchains.erase(swapchain);
+      WSI_LOG_ERROR("Failed to add swapchain (%p) as host is out of memory.",
+                    get_swapchain_key(swapchain));
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
+   return VK_SUCCESS;
+}
+
+void device_private_data::remove_layer_swapchain(VkSwapchainKHR swapchain)
+{
+   WSI_PROFILED_LOCK(lock, swapchains_lock, swapchains);
+   swapchains.erase(get_swapchain_key(swapchain));
 }
 
 bool device_private_data::layer_owns_all_swapchains(const VkSwapchainKHR *swapchain, uint32_t swapchain_count) const
 {
-   scoped_mutex lock(swapchains_lock);
    for (uint32_t i = 0; i < swapchain_count; i++)
    {
-      if (swapchains.find(swapchain[i]) == swapchains.end())
+      /* Compare the full handle, as the key may be truncated if handles are wider than pointers. */
+      auto *layer_swapchain = swapchains.find(get_swapchain_key(swapchain[i]));
+      if (layer_swapchain == nullptr || reinterpret_cast<VkSwapchainKHR>(layer_swapchain) != swapchain[i])
       {
          return false;
       }
@@ -540,7 +632,7 @@ bool device_private_data::should_layer_create_swapchain(VkSurfaceKHR vk_surface)
 bool device_private_data::can_icds_create_swapchain(VkSurfaceKHR vk_surface)
 {
    UNUSED(vk_surface);
-   return disp.get_fn<PFN_vkCreateSwapchainKHR>("vkCreateSwapchainKHR").has_value();
+   return disp.get_fn<PFN_vkCreateSwapchainKHR>(device_entrypoint::CreateSwapchainKHR).has_value();
 }
 
 VkResult device_private_data::set_device_enabled_extensions(const char *const *extension_names, size_t extension_count)
@@ -548,6 +640,43 @@ VkResult device_private_data::set_device_enabled_extensions(const char *const *e
    return enabled_extensions.add(extension_names, extension_count);
 }
 
+VkResult device_private_data::set_device_queues(const VkDeviceCreateInfo &create_info)
+{
+   for (uint32_t i = 0; i < create_info.queueCreateInfoCount; ++i)
+   {
+      const VkDeviceQueueCreateInfo &queue_info = create_info.pQueueCreateInfos[i];
+      if (queue_info.flags != 0)
+      {
+         continue;
+      }
+
+      for (uint32_t queue_index = 0; queue_index < queue_info.queueCount; ++queue_index)
+      {
+         VkQueue queue = VK_NULL_HANDLE;
+         disp.GetDeviceQueue(device, queue_info.queueFamilyIndex, queue_index, &queue);
+         if (!queue_families.try_push_back(std::make_pair(queue, queue_info.queueFamilyIndex)))
+         {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+         }
+      }
+   }
+
+   return VK_SUCCESS;
+}
+
+std::optional<uint32_t> device_private_data::get_queue_family_index(VkQueue queue) const
+{
+   for (const auto &queue_family : queue_families)
+   {
+      if (queue_family.first == queue)
+      {
+         return queue_family.second;
+      }
+   }
+
+   return std::nullopt;
+}
+
 bool device_private_data::is_device_extension_enabled(const char *extension_name) const
 {
    return enabled_extensions.contains(extension_name);
@@ -557,6 +686,15 @@ void device_private_data::destroy(device_private_data *device_data)
 {
    assert(device_data);
 
+#if WSI_ENTRYPOINT_PROFILING
+   device_data->profiler.print_summary(reinterpret_cast<void *>(device_data->device));
+   lock_profiler::print_summary();
+#endif
+
+#if WSI_ALLOCATION_TRACKING
+   util::allocation_tracker::print_summary();
+#endif
+
    auto alloc = device_data->get_allocator();
    alloc.destroy<device_private_data>(1, device_data);
 }
@@ -601,4 +739,299 @@ bool device_private_data::is_swapchain_maintenance1_enabled() const
    return swapchain_maintenance1_enabled;
 }
 
+void device_private_data::set_timeline_semaphore_enabled(bool enable)
+{
+   timeline_semaphore_enabled = enable;
+}
+
+bool device_private_data::is_timeline_semaphore_enabled() const
+{
+   return timeline_semaphore_enabled;
+}
+
+VkResult device_private_data::get_internal_queue(VkQueue &queue)
+{
+   if (internal_queue != VK_NULL_HANDLE)
+   {
+      queue = internal_queue;
+      return VK_SUCCESS;
+   }
+
+   disp.GetDeviceQueue(device, 0, 0, &queue);
+   return SetDeviceLoaderData(device, queue);
+}
+
+void device_private_data::setup_present_semaphore_export()
+{
+   if (!instance_data.get_layer_settings().merge_present_wait_semaphores ||
+       !is_device_extension_enabled(VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME) ||
+       disp.get_fn<PFN_vkGetSemaphoreFdKHR>(device_entrypoint::GetSemaphoreFdKHR).value_or(nullptr) == nullptr)
+   {
+      return;
+   }
+
+   auto get_properties = instance_data.disp
+                            .get_fn<PFN_vkGetPhysicalDeviceExternalSemaphorePropertiesKHR>(
+                               instance_entrypoint::GetPhysicalDeviceExternalSemaphorePropertiesKHR)
+                            .value_or(nullptr);
+   if (get_properties == nullptr)
+   {
+      return;
+   }
+
+   VkPhysicalDeviceExternalSemaphoreInfo external_semaphore_info = {};
+   external_semaphore_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_SEMAPHORE_INFO;
+   external_semaphore_info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
+   VkExternalSemaphoreProperties semaphore_properties = {};
+   semaphore_properties.sType = VK_STRUCTURE_TYPE_EXTERNAL_SEMAPHORE_PROPERTIES;
+   get_properties(physical_device, &external_semaphore_info, &semaphore_properties);
+   present_semaphore_export_enabled =
+      (semaphore_properties.externalSemaphoreFeatures & VK_EXTERNAL_SEMAPHORE_FEATURE_EXPORTABLE_BIT) != 0;
+}
+
+bool device_private_data::add_exportable_semaphore(VkSemaphore semaphore)
+{
+   scoped_mutex lock(exportable_semaphores_lock);
+   return exportable_semaphores.try_insert(semaphore).has_value();
+}
+
+void device_private_data::remove_exportable_semaphore(VkSemaphore semaphore)
+{
+   scoped_mutex lock(exportable_semaphores_lock);
+   exportable_semaphores.erase(semaphore);
+}
+
+bool device_private_data::are_semaphores_exportable(const VkSemaphore *semaphores, uint32_t count)
+{
+   scoped_mutex lock(exportable_semaphores_lock);
+   for (uint32_t i = 0; i < count; i++)
+   {
+      if (exportable_semaphores.find(semaphores[i]) == exportable_semaphores.end())
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+wsi::presentation_worker_pool *device_private_data::get_presentation_worker_pool()
+{
+   scoped_mutex lock(presentation_workers_lock);
+   if (presentation_workers == nullptr)
+   {
+      presentation_workers = wsi::presentation_worker_pool::create(
+         allocator, instance_data.get_layer_settings().presentation_threads);
+   }
+   return presentation_workers.get();
+}
+
+wsi::swapchain_reaper *device_private_data::get_swapchain_reaper()
+{
+   scoped_mutex lock(swapchain_reaper_lock);
+   if (swapchain_reaper == nullptr)
+   {
+      swapchain_reaper = wsi::swapchain_reaper::create(*this, allocator);
+   }
+   return swapchain_reaper.get();
+}
+
+void device_private_data::stop_swapchain_reaper()
+{
+   util::unique_ptr<wsi::swapchain_reaper> reaper;
+   {
+      scoped_mutex lock(swapchain_reaper_lock);
+      reaper = std::move(swapchain_reaper);
+   }
+   /* Destroying the reaper destroys its pending swapchains. */
+   reaper.reset();
+}
+
+const device_private_data::sync_fd_import_support &device_private_data::get_sync_fd_import_support()
+{
+   scoped_mutex lock(sync_fd_import_lock);
+   if (!sync_fd_import_probed)
+   {
+      probe_sync_fd_import_support();
+      sync_fd_import_probed = true;
+   }
+   return sync_fd_import;
+}
+
+std::optional<uint32_t> device_private_data::get_import_memory_type(const import_memory_source &source)
+{
+   scoped_mutex lock(import_memory_types_lock);
+   for (const auto &entry : import_memory_types)
+   {
+      if (entry.first == source)
+      {
+         return entry.second;
+      }
+   }
+   return std::nullopt;
+}
+
+void device_private_data::set_import_memory_type(const import_memory_source &source, uint32_t memory_type_index)
+{
+   scoped_mutex lock(import_memory_types_lock);
+   for (auto &entry : import_memory_types)
+   {
+      if (entry.first == source)
+      {
+         entry.second = memory_type_index;
+         return;
+      }
+   }
+
+   if (!import_memory_types.try_push_back(std::make_pair(source, memory_type_index)))
+   {
+      /* Not fatal, the next import from the same source queries its memory type again. */
+      WSI_LOG_WARNING("Failed to cache the memory type of an external memory import.");
+   }
+}
+
+/**
+ * @brief Check that an already signalled sync FD can be imported into a temporary fence.
+ */
+static bool probe_fence_sync_fd_import(device_private_data &device, int sync_fd)
+{
+   const VkAllocationCallbacks *callbacks = device.get_allocator().get_original_callbacks();
+   VkFenceCreateInfo fence_info = {};
+   fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+   VkFence fence = VK_NULL_HANDLE;
+   if (device.disp.CreateFence(device.device, &fence_info, callbacks, &fence) != VK_SUCCESS)
+   {
+      return false;
+   }
+   const bool imported = wsi::import_fence_sync_fd(device, fence, sync_fd) == VK_SUCCESS;
+   device.disp.DestroyFence(device.device, fence, callbacks);
+   return imported;
+}
+
+/**
+ * @brief Check that an already signalled sync FD can be imported into a temporary binary semaphore.
+ */
+static bool probe_semaphore_sync_fd_import(device_private_data &device, int sync_fd)
+{
+   const VkAllocationCallbacks *callbacks = device.get_allocator().get_original_callbacks();
+   VkSemaphoreCreateInfo semaphore_info = {};
+   semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+   VkSemaphore semaphore = VK_NULL_HANDLE;
+   if (device.disp.CreateSemaphore(device.device, &semaphore_info, callbacks, &semaphore) != VK_SUCCESS)
+   {
+      return false;
+   }
+   const bool imported = wsi::import_semaphore_sync_fd(device, semaphore, sync_fd) == VK_SUCCESS;
+   device.disp.DestroySemaphore(device.device, semaphore, callbacks);
+   return imported;
+}
+
+bool device_private_data::create_signalled_sync_fd()
+{
+   if (instance_data.disp
+             .get_fn<PFN_vkGetPhysicalDeviceExternalFencePropertiesKHR>(
+                instance_entrypoint::GetPhysicalDeviceExternalFencePropertiesKHR)
+             .value_or(nullptr) == nullptr ||
+       disp.get_fn<PFN_vkGetFenceFdKHR>(device_entrypoint::GetFenceFdKHR).value_or(nullptr) == nullptr ||
+       !wsi::sync_fd_fence_sync::is_supported(instance_data, physical_device))
+   {
+      return false;
+   }
+
+   auto fence = wsi::sync_fd_fence_sync::create(*this);
+   if (!fence.has_value())
+   {
+      return false;
+   }
+
+   VkQueue queue = VK_NULL_HANDLE;
+   if (get_internal_queue(queue) != VK_SUCCESS)
+   {
+      return false;
+   }
+
+   /* Export while the empty submission may still be pending, as drivers may return -1 for a fence that has
+    * already signalled, which is exactly what is being avoided. */
+   WSI_PROFILED_LOCK(queue_lock, internal_queue_lock, internal_queue);
+   if (fence->set_payload(queue, wsi::queue_submit_semaphores{ nullptr, 0, nullptr, 0 }) != VK_SUCCESS)
+   {
+      return false;
+   }
+   queue_lock.unlock();
+   auto sync_fd = fence->export_sync_fd();
+   if (!sync_fd.has_value() || !sync_fd->is_valid())
+   {
+      return false;
+   }
+   if (wsi::wait_sync_fd(sync_fd->get(), UINT64_MAX) != VK_SUCCESS)
+   {
+      return false;
+   }
+
+   signalled_sync_fd = std::move(sync_fd.value());
+   return true;
+}
+
+void device_private_data::probe_sync_fd_import_support()
+{
+   const int already_signalled_sentinel_fd = -1;
+   const acquire_signal_mode requested_mode = instance_data.get_layer_settings().acquire_mode;
+   const bool fence_import_available =
+      disp.get_fn<PFN_vkImportFenceFdKHR>(device_entrypoint::ImportFenceFdKHR).value_or(nullptr) != nullptr;
+   const bool semaphore_import_available =
+      disp.get_fn<PFN_vkImportSemaphoreFdKHR>(device_entrypoint::ImportSemaphoreFdKHR).value_or(nullptr) != nullptr;
+
+   /* Present fence import relies on the sentinel too, so it is probed whatever acquire mode is requested. */
+   if (fence_import_available)
+   {
+      sync_fd_import.fence = probe_fence_sync_fd_import(*this, already_signalled_sentinel_fd);
+   }
+   if (semaphore_import_available)
+   {
+      sync_fd_import.semaphore = probe_semaphore_sync_fd_import(*this, already_signalled_sentinel_fd);
+   }
+
+   if (requested_mode == acquire_signal_mode::sentinel_sync_fd)
+   {
+      sync_fd_import.fence_acquire_mode =
+         sync_fd_import.fence ? acquire_signal_mode::sentinel_sync_fd : acquire_signal_mode::queue_submit;
+      sync_fd_import.semaphore_acquire_mode =
+         sync_fd_import.semaphore ? acquire_signal_mode::sentinel_sync_fd : acquire_signal_mode::queue_submit;
+   }
+
+   const bool try_fence_signalled = fence_import_available &&
+                                    sync_fd_import.fence_acquire_mode == acquire_signal_mode::queue_submit;
+   const bool try_semaphore_signalled = semaphore_import_available &&
+                                        sync_fd_import.semaphore_acquire_mode == acquire_signal_mode::queue_submit;
+   if (requested_mode <= acquire_signal_mode::signalled_sync_fd && (try_fence_signalled || try_semaphore_signalled) &&
+       create_signalled_sync_fd())
+   {
+      if (try_fence_signalled && probe_fence_sync_fd_import(*this, signalled_sync_fd.get()))
+      {
+         sync_fd_import.fence = true;
+         sync_fd_import.fence_acquire_mode = acquire_signal_mode::signalled_sync_fd;
+      }
+      if (try_semaphore_signalled && probe_semaphore_sync_fd_import(*this, signalled_sync_fd.get()))
+      {
+         sync_fd_import.semaphore = true;
+         sync_fd_import.semaphore_acquire_mode = acquire_signal_mode::signalled_sync_fd;
+      }
+
+      if (sync_fd_import.fence_acquire_mode == acquire_signal_mode::signalled_sync_fd ||
+          sync_fd_import.semaphore_acquire_mode == acquire_signal_mode::signalled_sync_fd)
+      {
+         sync_fd_import.signalled_sync_fd = signalled_sync_fd.get();
+      }
+      else
+      {
+         signalled_sync_fd = util::fd_owner{};
+      }
+   }
+
+   if (sync_fd_import.fence_acquire_mode == acquire_signal_mode::queue_submit ||
+       sync_fd_import.semaphore_acquire_mode == acquire_signal_mode::queue_submit)
+   {
+      WSI_LOG_INFO("Sync FD import is not fully supported, acquire will signal with a queue submission.");
+   }
+}
+
 } /* namespace layer */
@@ -25,12 +25,20 @@
 #pragma once
 
 #include <layer/wsi_layer_experimental.hpp>
+#include <layer/settings.hpp>
+#include <layer/entrypoint_profiler.hpp>
+#include <layer/flight_recorder.hpp>
 
 #include <util/platform_set.hpp>
 #include <util/custom_allocator.hpp>
 #include <util/unordered_set.hpp>
-#include <util/unordered_map.hpp>
+#include <util/flat_unordered_map.hpp>
+#include <util/atomic_pointer_map.hpp>
 #include <util/extension_list.hpp>
+#include <util/format_modifiers.hpp>
+#include <util/memory_usage.hpp>
+
+#include <wsi/synchronization.hpp>
 
 #include <vulkan/vulkan.h>
 #include <vulkan/vk_layer.h>
@@ -41,18 +49,26 @@
 #include <X11/Xlib.h>
 #include <vulkan/vulkan_xlib.h>
 
+#include <array>
+#include <algorithm>
+#include <condition_variable>
 #include <memory>
 #include <unordered_set>
 #include <cassert>
 #include <mutex>
 #include <limits>
 #include <cstring>
+#include <optional>
+#include <utility>
 using scoped_mutex = std::lock_guard<std::mutex>;
 
 /** Forward declare stored objects */
 namespace wsi
 {
 class surface;
+class swapchain_base;
+class presentation_worker_pool;
+class swapchain_reaper;
 }
 
 namespace layer
@@ -74,39 +90,46 @@ struct entrypoint
 /**
  * @brief Dispatch table base.
  *
- * This struct defines generic get and call function templates for a dispatch table.
+ * This class defines generic get and call function templates for a dispatch table. Entrypoints are stored in a fixed
+ * size array indexed by @p EntrypointIndex, which is generated from the entrypoint lists below, so forwarding a call
+ * through the table is a single indirect call without any name lookup.
+ *
+ * @tparam EntrypointIndex Enumeration with one enumerator per entrypoint, terminated by a @c count enumerator.
  */
+template <typename EntrypointIndex>
 class dispatch_table
 {
 public:
-   using entrypoint_list = util::unordered_map<std::string, entrypoint>;
+   /** @brief Number of entrypoints in the dispatch table */
+   static constexpr size_t num_entrypoints = static_cast<size_t>(EntrypointIndex::count);
 
    /**
     * @brief Construct a new dispatch table object
     *
-    * @param allocator Pre-allocated entrypoint storage container
+    * @param entrypoints Description of every entrypoint in the table, in @p EntrypointIndex order.
+    * @param name_order  Indices of @p entrypoints in increasing name order, see util::sort_by_name.
     */
-   dispatch_table(util::unique_ptr<entrypoint_list> entrypoints)
-      : m_entrypoints(std::move(entrypoints))
+   dispatch_table(const entrypoint (&entrypoints)[num_entrypoints],
+                  const std::array<size_t, num_entrypoints> &name_order)
+      : m_name_order{ &name_order }
    {
-      /* This pointer is expected to be valid */
-      assert(m_entrypoints != nullptr);
+      std::copy(std::begin(entrypoints), std::end(entrypoints), m_entrypoints.begin());
    }
 
    /**
     * @brief Get the function object from the entrypoints.
     *
     * @tparam FunctionType The signature of the requested function.
-    * @param fn_name The name of the function.
-    * @return the requested function pointer, or std::nullopt.
+    * @param index The index of the function.
+    * @return the requested function pointer, or std::nullopt if the function was not retrieved from the next layer.
     */
    template <typename FunctionType>
-   std::optional<FunctionType> get_fn(const char *fn_name) const
+   std::optional<FunctionType> get_fn(EntrypointIndex index) const
    {
-      auto fn = m_entrypoints->find(fn_name);
-      if (fn != m_entrypoints->end())
+      PFN_vkVoidFunction fn = m_entrypoints[static_cast<size_t>(index)].fn;
+      if (fn != nullptr)
       {
-         return reinterpret_cast<FunctionType>(fn->second.fn);
+         return reinterpret_cast<FunctionType>(fn);
       }
 
       return std::nullopt;
@@ -118,31 +141,89 @@ public:
     * @param extension_names Names of the extensions enabled by user.
     * @param extension_count Number of extensions enabled by the user.
     */
-   void set_user_enabled_extensions(const char *const *extension_names, size_t extension_count);
+   void set_user_enabled_extensions(const char *const *extension_names, size_t extension_count)
+   {
+      for (size_t i = 0; i < extension_count; i++)
+      {
+         for (auto &entrypoint : m_entrypoints)
+         {
+            if (!strcmp(entrypoint.ext_name, extension_names[i]))
+            {
+               entrypoint.user_visible = true;
+            }
+         }
+      }
+   }
 
 protected:
+   /**
+    * @brief Find an entrypoint of the dispatch table by name.
+    *
+    * @param fn_name The name of the function.
+    * @return pointer to the entrypoint, or nullptr if the dispatch table does not contain the function.
+    */
+   const entrypoint *find_entrypoint(const char *fn_name) const
+   {
+      auto it = std::lower_bound(m_name_order->begin(), m_name_order->end(), fn_name,
+                                 [this](size_t index, const char *name) {
+                                    return strcmp(m_entrypoints[index].name, name) < 0;
+                                 });
+      if (it != m_name_order->end() && !strcmp(m_entrypoints[*it].name, fn_name))
+      {
+         return &m_entrypoints[*it];
+      }
+
+      return nullptr;
+   }
+
+   /**
+    * @brief Retrieve the function pointers of the dispatch table from the next layer.
+    *
+    * @tparam DispatchableType The type of the dispatchable object the entrypoints are retrieved for.
+    * @tparam GetProcAddrType The signature of the vkGet*ProcAddr function to use.
+    *
+    * @param dispatchable The dispatchable object the entrypoints are retrieved for.
+    * @param get_proc The pointer to the vkGet*ProcAddr function of the next layer.
+    * @return VK_SUCCESS if successful, VK_ERROR_INITIALIZATION_FAILED if a required entrypoint is missing.
+    */
+   template <typename DispatchableType, typename GetProcAddrType>
+   VkResult populate_entrypoints(DispatchableType dispatchable, GetProcAddrType get_proc)
+   {
+      for (auto &entrypoint : m_entrypoints)
+      {
+         entrypoint.fn = get_proc(dispatchable, entrypoint.name);
+         entrypoint.user_visible = false;
+         if (entrypoint.fn == nullptr && entrypoint.required)
+         {
+            return VK_ERROR_INITIALIZATION_FAILED;
+         }
+      }
+
+      return VK_SUCCESS;
+   }
+
    /**
     * @brief Call function from the dispatch table entrypoints.
     *
     * @tparam FunctionType The signature of the function to call.
     * @tparam Args Argument types of the function to call.
     *
-    * @param fn_name Name of the function to call.
+    * @param index Index of the function to call.
     * @param args Arguments to the function to call.
     * @return function return value or std::nullopt if function is not present in entrypoints
     */
    template <
       typename FunctionType, class... Args, typename ReturnType = std::invoke_result_t<FunctionType, Args...>,
       std::enable_if_t<!std::is_void<ReturnType>::value && !std::is_same<ReturnType, VkResult>::value, bool> = true>
-   std::optional<ReturnType> call_fn(const char *fn_name, Args &&...args) const
+   std::optional<ReturnType> call_fn(EntrypointIndex index, Args &&...args) const
    {
-      auto fn = get_fn<FunctionType>(fn_name);
+      auto fn = get_fn<FunctionType>(index);
       if (fn.has_value())
       {
          return (*fn)(std::forward<Args>(args)...);
       }
 
-      WSI_LOG_WARNING("Call to %s failed, dispatch table does not contain the function.", fn_name);
+      WSI_LOG_WARNING("Call to %s failed, dispatch table does not contain the function.", get_name(index));
 
       return std::nullopt;
    }
@@ -154,20 +235,20 @@ protected:
     * @tparam FunctionType The signature of the function to call.
     * @tparam Args Argument types of the function to call.
     *
-    * @param fn_name Name of the function to call.
+    * @param index Index of the function to call.
     * @param args Arguments to the function to call.
     */
    template <typename FunctionType, class... Args, typename ReturnType = std::invoke_result_t<FunctionType, Args...>,
              std::enable_if_t<std::is_void<ReturnType>::value, bool> = true>
-   void call_fn(const char *fn_name, Args &&...args) const
+   void call_fn(EntrypointIndex index, Args &&...args) const
    {
-      auto fn = get_fn<FunctionType>(fn_name);
+      auto fn = get_fn<FunctionType>(index);
       if (fn.has_value())
       {
          return (*fn)(std::forward<Args>(args)...);
       }
 
-      WSI_LOG_WARNING("Call to %s failed, dispatch table does not contain the function.", fn_name);
+      WSI_LOG_WARNING("Call to %s failed, dispatch table does not contain the function.", get_name(index));
    }
 
    /**
@@ -177,27 +258,36 @@ protected:
     * @tparam FunctionType The signature of the function to call.
     * @tparam Args Argument types of the function to call.
     *
-    * @param fn_name Name of the function to call.
+    * @param index Index of the function to call.
     * @param args Arguments to the function to call.
     * @return function return value or VK_ERROR_EXTENSION_NOT_PRESENT if function is not present in entrypoints
     */
    template <typename FunctionType, class... Args, typename ReturnType = std::invoke_result_t<FunctionType, Args...>,
              std::enable_if_t<std::is_same<ReturnType, VkResult>::value, bool> = true>
-   VkResult call_fn(const char *fn_name, Args &&...args) const
+   VkResult call_fn(EntrypointIndex index, Args &&...args) const
    {
-      auto fn = get_fn<FunctionType>(fn_name);
+      auto fn = get_fn<FunctionType>(index);
       if (fn.has_value())
       {
          return (*fn)(std::forward<Args>(args)...);
       }
 
-      WSI_LOG_WARNING("Call to %s failed, dispatch table does not contain the function.", fn_name);
+      WSI_LOG_WARNING("Call to %s failed, dispatch table does not contain the function.", get_name(index));
 
       return VK_ERROR_EXTENSION_NOT_PRESENT;
    }
 
-   /** @brief Vector that holds the entrypoints of the dispatch table */
-   util::unique_ptr<entrypoint_list> m_entrypoints;
+   /** @brief Array that holds the entrypoints of the dispatch table, indexed by @p EntrypointIndex */
+   std::array<entrypoint, num_entrypoints> m_entrypoints{};
+
+private:
+   /** @brief Indices of the entrypoints in increasing name order, used to look them up by name */
+   const std::array<size_t, num_entrypoints> *m_name_order;
+
+   const char *get_name(EntrypointIndex index) const
+   {
+      return m_entrypoints[static_cast<size_t>(index)].name;
+   }
 };
 
 /* Represents the maximum possible Vulkan API version. */
@@ -221,6 +311,7 @@ static constexpr uint32_t API_VERSION_MAX = UINT32_MAX;
    EP(GetPhysicalDeviceProperties, "", VK_API_VERSION_1_0, true)                                                     \
    EP(GetPhysicalDeviceImageFormatProperties, "", VK_API_VERSION_1_0, true)                                          \
    EP(EnumerateDeviceExtensionProperties, "", VK_API_VERSION_1_0, true)                                              \
+   EP(GetPhysicalDeviceQueueFamilyProperties, "", VK_API_VERSION_1_0, true)                                          \
    /* VK_KHR_surface */                                                                                              \
    EP(DestroySurfaceKHR, VK_KHR_SURFACE_EXTENSION_NAME, API_VERSION_MAX, false)                                      \
    EP(GetPhysicalDeviceSurfaceCapabilitiesKHR, VK_KHR_SURFACE_EXTENSION_NAME, API_VERSION_MAX, false)                \
@@ -265,24 +356,33 @@ static constexpr uint32_t API_VERSION_MAX = UINT32_MAX;
    EP(GetPhysicalDeviceExternalFencePropertiesKHR, VK_KHR_EXTERNAL_FENCE_CAPABILITIES_EXTENSION_NAME,                \
       VK_API_VERSION_1_1, false)                                                                                     \
    EP(GetPhysicalDeviceExternalBufferPropertiesKHR, VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME,              \
+      VK_API_VERSION_1_1, false)                                                                                     \
+   /* VK_KHR_external_semaphore_capabilities or */                                                                   \
+   /* 1.1 (without KHR suffix) */                                                                                    \
+   EP(GetPhysicalDeviceExternalSemaphorePropertiesKHR, VK_KHR_EXTERNAL_SEMAPHORE_CAPABILITIES_EXTENSION_NAME,        \
       VK_API_VERSION_1_1, false)
 
+/**
+ * @brief Indices of the entrypoints in the instance dispatch table.
+ */
+enum class instance_entrypoint
+{
+#define DISPATCH_TABLE_INDEX(name, unused1, unused2, unused3) name,
+   INSTANCE_ENTRYPOINTS_LIST(DISPATCH_TABLE_INDEX)
+#undef DISPATCH_TABLE_INDEX
+   count
+};
+
 /**
  * @brief Struct representing the instance dispatch table.
  */
-class instance_dispatch_table : public dispatch_table
+class instance_dispatch_table : public dispatch_table<instance_entrypoint>
 {
 public:
-   static std::optional<instance_dispatch_table> create(const util::allocator &allocator)
-   {
-      auto entrypoints = allocator.make_unique<dispatch_table::entrypoint_list>(allocator);
-      if (entrypoints == nullptr)
-      {
-         return std::nullopt;
-      }
-
-      return instance_dispatch_table{ std::move(entrypoints) };
-   }
+   /**
+    * @brief Construct a instance dispatch table object with no function pointers retrieved yet.
+    */
+   instance_dispatch_table();
 
    /**
     * @brief Populate the instance dispatch table with functions that it requires.
@@ -311,26 +411,15 @@ public:
     *    disp.GetInstanceProcAddr(instance, fn_name);
     * The result type will be matching the function signature, so there is no need for casting.
     */
-#define DISPATCH_TABLE_SHORTCUT(name, unused1, unused2, unused3)             \
-   template <class... Args>                                                  \
-   auto name(Args &&...args) const                                           \
-   {                                                                         \
-      return call_fn<PFN_vk##name>("vk" #name, std::forward<Args>(args)...); \
+#define DISPATCH_TABLE_SHORTCUT(name, unused1, unused2, unused3)                            \
+   template <class... Args>                                                                 \
+   auto name(Args &&...args) const                                                          \
+   {                                                                                        \
+      return call_fn<PFN_vk##name>(instance_entrypoint::name, std::forward<Args>(args)...); \
    };
 
    INSTANCE_ENTRYPOINTS_LIST(DISPATCH_TABLE_SHORTCUT)
 #undef DISPATCH_TABLE_SHORTCUT
-
-private:
-   /**
-    * @brief Construct instance dispatch table object
-    *
-    * @param table Pre-allocated dispatch table
-    */
-   instance_dispatch_table(util::unique_ptr<dispatch_table::entrypoint_list> table)
-      : dispatch_table{ std::move(table) }
-   {
-   }
 };
 
 /* List of device entrypoints in the layer's device dispatch table.
@@ -351,6 +440,7 @@ private:
 
 #if VULKAN_WSI_LAYER_EXPERIMENTAL
 #define DEVICE_ENTRYPOINTS_LIST_EXPERIMENTAL(EP)                                                         \
+   EP(GetPastPresentationTimingEXT, VK_EXT_PRESENT_TIMING_EXTENSION_NAME, API_VERSION_MAX, false)        \
    EP(GetSwapchainTimeDomainPropertiesEXT, VK_EXT_PRESENT_TIMING_EXTENSION_NAME, API_VERSION_MAX, false) \
    EP(GetSwapchainTimingPropertiesEXT, VK_EXT_PRESENT_TIMING_EXTENSION_NAME, API_VERSION_MAX, false)     \
    EP(SetSwapchainPresentTimingQueueSizeEXT, VK_EXT_PRESENT_TIMING_EXTENSION_NAME, API_VERSION_MAX, false)
@@ -377,9 +467,19 @@ private:
    EP(CreateImage, "", VK_API_VERSION_1_0, true)                                                                   \
    EP(DestroyImage, "", VK_API_VERSION_1_0, true)                                                                  \
    EP(GetImageMemoryRequirements, "", VK_API_VERSION_1_0, true)                                                    \
+   EP(GetImageSubresourceLayout, "", VK_API_VERSION_1_0, true)                                                     \
    EP(BindImageMemory, "", VK_API_VERSION_1_0, true)                                                               \
    EP(AllocateMemory, "", VK_API_VERSION_1_0, true)                                                                \
    EP(FreeMemory, "", VK_API_VERSION_1_0, true)                                                                    \
+   EP(MapMemory, "", VK_API_VERSION_1_0, true)                                                                     \
+   EP(UnmapMemory, "", VK_API_VERSION_1_0, true)                                                                   \
+   EP(InvalidateMappedMemoryRanges, "", VK_API_VERSION_1_0, true)                                                  \
+   EP(CreateBuffer, "", VK_API_VERSION_1_0, true)                                                                  \
+   EP(DestroyBuffer, "", VK_API_VERSION_1_0, true)                                                                 \
+   EP(GetBufferMemoryRequirements, "", VK_API_VERSION_1_0, true)                                                   \
+   EP(BindBufferMemory, "", VK_API_VERSION_1_0, true)                                                              \
+   EP(CmdPipelineBarrier, "", VK_API_VERSION_1_0, true)                                                            \
+   EP(CmdCopyImageToBuffer, "", VK_API_VERSION_1_0, true)                                                          \
    EP(CreateFence, "", VK_API_VERSION_1_0, true)                                                                   \
    EP(DestroyFence, "", VK_API_VERSION_1_0, true)                                                                  \
    EP(CreateSemaphore, "", VK_API_VERSION_1_0, true)                                                               \
@@ -387,6 +487,9 @@ private:
    EP(ResetFences, "", VK_API_VERSION_1_0, true)                                                                   \
    EP(WaitForFences, "", VK_API_VERSION_1_0, true)                                                                 \
    EP(DestroyDevice, "", VK_API_VERSION_1_0, true)                                                                 \
+   /* Vulkan 1.2 */                                                                                                \
+   EP(GetSemaphoreCounterValue, "", VK_API_VERSION_1_2, false)                                                     \
+   EP(WaitSemaphores, "", VK_API_VERSION_1_2, false)                                                               \
    /* VK_KHR_swapchain */                                                                                          \
    EP(CreateSwapchainKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME, API_VERSION_MAX, false)                                 \
    EP(DestroySwapchainKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME, API_VERSION_MAX, false)                                \
@@ -403,6 +506,8 @@ private:
       false) /* VK_KHR_external_memory_fd */                                                                       \
    EP(GetMemoryFdKHR, VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME, API_VERSION_MAX, false)                            \
    EP(GetMemoryFdPropertiesKHR, VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME, API_VERSION_MAX, false)                  \
+   /* VK_EXT_external_memory_host */                                                                               \
+   EP(GetMemoryHostPointerPropertiesEXT, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME, API_VERSION_MAX, false)       \
    /* VK_KHR_bind_memory2 or */ /* 1.1 (without KHR suffix) */                                                     \
    EP(BindImageMemory2KHR, VK_KHR_BIND_MEMORY_2_EXTENSION_NAME, VK_API_VERSION_1_1, false)                         \
    EP(BindBufferMemory2KHR, VK_KHR_BIND_MEMORY_2_EXTENSION_NAME, VK_API_VERSION_1_1,                               \
@@ -425,25 +530,31 @@ private:
    EP(GetImageSparseMemoryRequirements2KHR, VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, VK_API_VERSION_1_1,   \
       false)                                                                                                       \
    EP(ReleaseSwapchainImagesEXT, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME, VK_API_VERSION_1_1, false)         \
+   EP(WaitForPresentKHR, VK_KHR_PRESENT_WAIT_EXTENSION_NAME, API_VERSION_MAX, false)                               \
    /* Custom entrypoints */                                                                                        \
    DEVICE_ENTRYPOINTS_LIST_EXPANSION(EP)
 
+/**
+ * @brief Indices of the entrypoints in the device dispatch table.
+ */
+enum class device_entrypoint
+{
+#define DISPATCH_TABLE_INDEX(name, unused1, unused2, unused3) name,
+   DEVICE_ENTRYPOINTS_LIST(DISPATCH_TABLE_INDEX)
+#undef DISPATCH_TABLE_INDEX
+   count
+};
+
 /**
  * @brief Struct representing the device dispatch table.
  */
-class device_dispatch_table : public dispatch_table
+class device_dispatch_table : public dispatch_table<device_entrypoint>
 {
 public:
-   static std::optional<device_dispatch_table> create(const util::allocator &allocator)
-   {
-      auto entrypoints = allocator.make_unique<dispatch_table::entrypoint_list>(allocator);
-      if (entrypoints == nullptr)
-      {
-         return std::nullopt;
-      }
-
-      return device_dispatch_table{ std::move(entrypoints) };
-   }
+   /**
+    * @brief Construct a device dispatch table object with no function pointers retrieved yet.
+    */
+   device_dispatch_table();
 
    /**
     * @brief Populate the device dispatch table with functions that it requires.
@@ -472,26 +583,15 @@ public:
     *    disp.GetDeviceProcAddr(instance, fn_name);
     * The result type will be matching the function signature, so there is no need for casting.
     */
-#define DISPATCH_TABLE_SHORTCUT(name, unused1, unused2, unused3)             \
-   template <class... Args>                                                  \
-   auto name(Args &&...args) const                                           \
-   {                                                                         \
-      return call_fn<PFN_vk##name>("vk" #name, std::forward<Args>(args)...); \
+#define DISPATCH_TABLE_SHORTCUT(name, unused1, unused2, unused3)                          \
+   template <class... Args>                                                               \
+   auto name(Args &&...args) const                                                        \
+   {                                                                                      \
+      return call_fn<PFN_vk##name>(device_entrypoint::name, std::forward<Args>(args)...); \
    };
 
    DEVICE_ENTRYPOINTS_LIST(DISPATCH_TABLE_SHORTCUT)
 #undef DISPATCH_TABLE_SHORTCUT
-
-private:
-   /**
-    * @brief Construct instance dispatch table object
-    *
-    * @param table Pre-allocated dispatch table
-    */
-   device_dispatch_table(util::unique_ptr<dispatch_table::entrypoint_list> table)
-      : dispatch_table{ std::move(table) }
-   {
-   }
 };
 
 /**
@@ -616,8 +716,37 @@ public:
     */
    bool has_image_compression_support(VkPhysicalDevice phys_dev);
 
+   /**
+    * @brief Check if a physical device supports frame boundary events.
+    *
+    * @param phys_dev The physical device to query.
+    * @return Whether VK_EXT_frame_boundary is supported by the ICD.
+    */
    bool has_frame_boundary_support(VkPhysicalDevice phys_dev);
 
+   /**
+    * @brief Get the DRM render node of a physical device.
+    *
+    * @param phys_dev     The physical device to query.
+    * @param[out] major   Major number of the render node.
+    * @param[out] minor   Minor number of the render node.
+    * @return Whether the ICD reported a render node through VK_EXT_physical_device_drm.
+    */
+   bool get_render_node(VkPhysicalDevice phys_dev, int64_t &major, int64_t &minor);
+
+   /**
+    * @brief Get the device extensions available on a physical device.
+    *
+    * The extensions are enumerated on the first query for @p phys_dev and cached until the instance is destroyed, so
+    * creating more devices does not enumerate them again.
+    *
+    * @param phys_dev        The physical device to query.
+    * @param[out] extensions Set to the available extensions, valid until the instance is destroyed.
+    *
+    * @return VK_SUCCESS on success, otherwise an error.
+    */
+   VkResult get_available_device_extensions(VkPhysicalDevice phys_dev, const util::extension_list *&extensions);
+
    /**
     * @brief Get the instance allocator
     *
@@ -666,6 +795,33 @@ public:
     */
    bool get_maintainance1_support();
 
+   /**
+    * @brief Set the settings of the layer for this instance, read at instance creation.
+    */
+   void set_layer_settings(const layer_settings &new_settings);
+
+   /**
+    * @brief Get the settings of the layer for this instance.
+    */
+   const layer_settings &get_layer_settings() const;
+
+   /**
+    * @brief Record that a swapchain of the instance was handed over to a swapchain reaper.
+    */
+   void add_deferred_swapchain_destruction();
+
+   /**
+    * @brief Record that a swapchain handed over to a swapchain reaper has been destroyed.
+    */
+   void complete_deferred_swapchain_destruction();
+
+   /**
+    * @brief Wait until the swapchains handed over to the swapchain reapers of the instance have been destroyed.
+    *
+    * Called before destroying a surface, whose swapchains may still be using it.
+    */
+   void wait_for_deferred_swapchain_destructions();
+
 private:
    /* Allow util::allocator to access the private constructor */
    friend util::allocator;
@@ -695,6 +851,33 @@ private:
     */
    bool do_icds_support_surface(VkPhysicalDevice phys_dev, VkSurfaceKHR surface);
 
+   /**
+    * @brief Extensions and features of a physical device, queried once per instance.
+    */
+   struct physical_device_support
+   {
+      physical_device_support(VkPhysicalDevice phys_dev, const util::allocator &alloc)
+         : physical_device{ phys_dev }
+         , extensions{ alloc }
+      {
+      }
+
+      VkPhysicalDevice physical_device;
+      util::extension_list extensions;
+      bool image_compression_control{ false };
+      bool frame_boundary{ false };
+      bool has_render_node{ false };
+      int64_t render_major{ 0 };
+      int64_t render_minor{ 0 };
+   };
+
+   /**
+    * @brief Get the support of a physical device, querying the ICD on the first call for @p phys_dev.
+    *
+    * @return The cached support, or nullptr if querying it failed.
+    */
+   physical_device_support *get_physical_device_support(VkPhysicalDevice phys_dev);
+
    const PFN_vkSetInstanceLoaderData SetInstanceLoaderData;
    const util::wsi_platform_set enabled_layer_platforms;
    const util::allocator allocator;
@@ -705,7 +888,7 @@ private:
     * Uses plain pointers to store surface data as the lifetime of the object is explicitly controlled by the Vulkan
     * application. The application may also use different but compatible host allocators on creation and destruction.
     */
-   util::unordered_map<VkSurfaceKHR, wsi::surface *> surfaces;
+   util::flat_unordered_map<VkSurfaceKHR, wsi::surface *> surfaces;
 
    /**
     * @brief Lock for thread safe access to @ref surfaces
@@ -721,6 +904,24 @@ private:
     * @brief True if unsupported extensions are enabled.
     */
    bool enabled_unsupported_swapchain_maintenance1_extensions;
+
+   /**
+    * @brief Support of the physical devices queried so far, see @ref get_physical_device_support.
+    */
+   util::vector<util::unique_ptr<physical_device_support>> physical_devices;
+   std::mutex physical_devices_lock;
+
+   /**
+    * @brief The settings of the layer for this instance.
+    */
+   layer_settings settings{};
+
+   /**
+    * @brief Number of swapchains of the instance waiting to be destroyed on a swapchain reaper.
+    */
+   uint32_t deferred_swapchain_destructions{ 0 };
+   std::mutex deferred_swapchain_destructions_lock;
+   std::condition_variable deferred_swapchain_destructions_done;
 };
 
 /**
@@ -816,6 +1017,26 @@ public:
     */
    VkResult set_device_enabled_extensions(const char *const *extension_names, size_t extension_count);
 
+   /**
+    * @brief Store the queues created with the device, so that the queue family of a queue can be looked up.
+    *
+    * Queues created with flags cannot be retrieved with vkGetDeviceQueue, so they are not stored.
+    *
+    * @param create_info The create info the device was created with.
+    *
+    * @return VK_SUCCESS if successful, otherwise an error.
+    */
+   VkResult set_device_queues(const VkDeviceCreateInfo &create_info);
+
+   /**
+    * @brief Get the queue family of a queue of the device.
+    *
+    * @param queue The queue.
+    *
+    * @return The queue family index, or std::nullopt if the queue is unknown.
+    */
+   std::optional<uint32_t> get_queue_family_index(VkQueue queue) const;
+
    /**
     * @brief Check whether a device extension is enabled.
     *
@@ -887,6 +1108,270 @@ public:
     */
    bool is_swapchain_maintenance1_enabled() const;
 
+   /**
+    * @brief Set whether the timeline semaphore feature is enabled for this device.
+    *
+    * @param enable Value to set timeline_semaphore_enabled member variable.
+    */
+   void set_timeline_semaphore_enabled(bool enable);
+
+   /**
+    * @brief Check whether the timeline semaphore feature is enabled for this device.
+    *
+    * @return true if enabled, false otherwise.
+    */
+   bool is_timeline_semaphore_enabled() const;
+
+   /**
+    * @brief Set the queue reserved at device creation for the synchronization only submissions of the layer.
+    *
+    * @param queue              The queue, which the application does not know about.
+    * @param queue_family_index The family of the queue.
+    */
+   void set_internal_queue(VkQueue queue, uint32_t queue_family_index)
+   {
+      internal_queue = queue;
+      internal_queue_family_index = queue_family_index;
+   }
+
+   /**
+    * @brief Get the queue reserved at device creation for the layer if it belongs to a queue family.
+    *
+    * Submissions to the queue must hold the lock returned by @ref get_internal_queue_lock.
+    *
+    * @param queue_family_index The queue family.
+    *
+    * @return The queue, or VK_NULL_HANDLE if no queue was reserved or it belongs to another family.
+    */
+   VkQueue get_reserved_internal_queue(uint32_t queue_family_index) const
+   {
+      return internal_queue_family_index == queue_family_index ? internal_queue : VK_NULL_HANDLE;
+   }
+
+   /**
+    * @brief Get the queue for the synchronization only submissions of the layer.
+    *
+    * This is the queue reserved at device creation with the internal_queue setting, or otherwise the first queue of the
+    * first queue family, which the application may submit rendering work to as well. Submissions to the queue and
+    * waits for it to idle must hold the lock returned by @ref get_internal_queue_lock.
+    *
+    * @param[out] queue The queue.
+    *
+    * @return VK_SUCCESS on success or the error returned by the loader when setting up a queue of the application.
+    */
+   VkResult get_internal_queue(VkQueue &queue);
+
+   /**
+    * @brief Get the lock serializing the submissions of the layer to the queue returned by @ref get_internal_queue.
+    */
+   std::mutex &get_internal_queue_lock()
+   {
+      return internal_queue_lock;
+   }
+
+   /**
+    * @brief Get the lock protecting the links between the swapchains of the device and their ancestors.
+    */
+   std::mutex &get_swapchain_links_lock()
+   {
+      return swapchain_links_lock;
+   }
+
+   /**
+    * @brief Get the condition variable notified when a swapchain unlinks itself or stops using its ancestor.
+    */
+   std::condition_variable &get_swapchain_links_changed()
+   {
+      return swapchain_links_changed;
+   }
+
+   /**
+    * @brief Enable the export of application semaphores to Sync FDs if the merge_present_wait_semaphores setting of
+    *        the layer is on and the device can export binary semaphores to Sync FDs.
+    *
+    * Called once the enabled device extensions are known.
+    */
+   void setup_present_semaphore_export();
+
+   /**
+    * @brief Check whether the binary semaphores created by the application are made exportable to Sync FDs.
+    */
+   bool is_present_semaphore_export_enabled() const
+   {
+      return present_semaphore_export_enabled;
+   }
+
+   /**
+    * @brief Record a semaphore of the application that was created exportable to Sync FDs.
+    *
+    * @param semaphore The semaphore.
+    *
+    * @return true on success, false if out of memory, in which case the semaphore is never exported.
+    */
+   bool add_exportable_semaphore(VkSemaphore semaphore);
+
+   /**
+    * @brief Forget a semaphore of the application before it is destroyed.
+    *
+    * @param semaphore The semaphore, which does not need to have been recorded.
+    */
+   void remove_exportable_semaphore(VkSemaphore semaphore);
+
+   /**
+    * @brief Check whether semaphores of the application were all created exportable to Sync FDs.
+    *
+    * @param semaphores The semaphores.
+    * @param count      Number of semaphores.
+    *
+    * @return true if all of them were recorded by @ref add_exportable_semaphore, false otherwise.
+    */
+   bool are_semaphores_exportable(const VkSemaphore *semaphores, uint32_t count);
+
+   /**
+    * @brief Get the pool of presentation workers shared by the swapchains of this device, creating it on first use.
+    *
+    * @return Pointer to the pool, valid for the lifetime of the device, or nullptr if it could not be created.
+    */
+   wsi::presentation_worker_pool *get_presentation_worker_pool();
+
+   /**
+    * @brief Get the reaper destroying the swapchains of this device in the background, creating it on first use.
+    *
+    * @return Pointer to the reaper, valid until @ref stop_swapchain_reaper, or nullptr if it could not be created.
+    */
+   wsi::swapchain_reaper *get_swapchain_reaper();
+
+   /**
+    * @brief Destroy the swapchains still pending on the reaper and stop its thread.
+    *
+    * Called before the device is destroyed.
+    */
+   void stop_swapchain_reaper();
+
+   using acquire_signal_mode = layer::acquire_signal_mode;
+
+   /**
+    * @brief Whether already signalled sync FDs can be imported into the Vulkan objects given to acquire.
+    */
+   struct sync_fd_import_support
+   {
+      /** Whether any already signalled sync FD can be imported into a fence. */
+      bool fence;
+      /** Whether any already signalled sync FD can be imported into a semaphore. */
+      bool semaphore;
+      acquire_signal_mode fence_acquire_mode;
+      acquire_signal_mode semaphore_acquire_mode;
+      /** The signalled sync FD imported by @ref acquire_signal_mode::signalled_sync_fd, or -1 if unused. */
+      int signalled_sync_fd;
+   };
+
+   /**
+    * @brief Get the sync FD import support of the device, probing it on first use.
+    *
+    * The probe imports the already signalled sentinel sync FD into a temporary fence and semaphore, exactly as
+    * image acquisition does, so that drivers that reject the import are only called once per device. Where the
+    * sentinel is rejected, a real sync FD that has already signalled is created once and tried instead. The first
+    * mode tried can be lowered with the acquire_signal_mode setting of the layer.
+    *
+    * @return The sync FD import support, valid for the lifetime of the device.
+    */
+   const sync_fd_import_support &get_sync_fd_import_support();
+
+   /**
+    * @brief Get the pool of semaphores and fences shared by the swapchains of this device.
+    *
+    * @return The pool, valid for the lifetime of the device.
+    */
+   wsi::sync_object_pool &get_sync_object_pool()
+   {
+      return sync_objects;
+   }
+
+   /**
+    * @brief Get the cache of the DRM modifiers supported for the swapchain images of this device.
+    *
+    * @return The cache, valid for the lifetime of the device.
+    */
+   util::drm_format_modifier_cache &get_format_modifier_cache()
+   {
+      return format_modifier_cache;
+   }
+
+   /**
+    * @brief Description of where imported external memory comes from.
+    *
+    * Memory allocated the same way for images of the same format and modifier is importable with the same memory
+    * type, so the type found for the first import is reused by the following ones.
+    */
+   struct import_memory_source
+   {
+      VkExternalMemoryHandleTypeFlagBits handle_type;
+      uint32_t fourcc;
+      uint64_t modifier;
+      /** Flags of the external allocator, which select the memory heap. */
+      uint64_t allocation_flags;
+      /** Index of the memory plane within the image. */
+      uint32_t memory_plane;
+
+      bool operator==(const import_memory_source &other) const
+      {
+         return handle_type == other.handle_type && fourcc == other.fourcc && modifier == other.modifier &&
+                allocation_flags == other.allocation_flags && memory_plane == other.memory_plane;
+      }
+   };
+
+   /**
+    * @brief Get the memory type a previous import from @p source used.
+    *
+    * @return The memory type index, or std::nullopt if there was no import from @p source yet.
+    */
+   std::optional<uint32_t> get_import_memory_type(const import_memory_source &source);
+
+   /**
+    * @brief Record the memory type that an import from @p source succeeded with.
+    */
+   void set_import_memory_type(const import_memory_source &source, uint32_t memory_type_index);
+
+   /**
+    * @brief Get the memory held by all the swapchains of this device.
+    */
+   util::memory_usage &get_memory_usage()
+   {
+      return memory_usage_totals;
+   }
+
+   /**
+    * @brief Get the memory heap of a memory type of the physical device.
+    *
+    * @return The heap index, or 0 if the memory properties of the physical device could not be queried.
+    */
+   uint32_t get_memory_heap_index(uint32_t memory_type_index) const
+   {
+      if (memory_type_index >= memory_properties.memoryTypeCount)
+      {
+         return 0;
+      }
+      return memory_properties.memoryTypes[memory_type_index].heapIndex;
+   }
+
+   /**
+    * @brief Get the recorder of the presentation events of this device.
+    */
+   flight_recorder &get_flight_recorder()
+   {
+      return recorder;
+   }
+
+#if WSI_ENTRYPOINT_PROFILING
+   /**
+    * @brief Get the profiler of the swapchain entrypoints called on this device.
+    */
+   entrypoint_profiler &get_profiler()
+   {
+      return profiler;
+   }
+#endif
+
 private:
    /* Allow util::allocator to access the private constructor */
    friend util::allocator;
@@ -913,15 +1398,39 @@ private:
     */
    static void destroy(device_private_data *device_data);
 
+   /**
+    * @brief Probe the sync FD import support of the device and store it in @ref sync_fd_import.
+    */
+   void probe_sync_fd_import_support();
+
+   /**
+    * @brief Create a sync FD that has already signalled and store it in @ref signalled_sync_fd.
+    *
+    * @return true on success, false if the device cannot export sync FDs or creating it failed.
+    */
+   bool create_signalled_sync_fd();
+
    const util::allocator allocator;
-   util::unordered_set<VkSwapchainKHR> swapchains;
-   mutable std::mutex swapchains_lock;
+
+   /**
+    * @brief Swapchains created by the layer, keyed by their handle.
+    *
+    * Ownership checks run on every present and acquire, so they look up the map without taking a lock.
+    * @ref swapchains_lock only serializes insertions and removals.
+    */
+   util::atomic_pointer_map<wsi::swapchain_base> swapchains;
+   std::mutex swapchains_lock;
 
    /**
     * @brief List with the names of the enabled device extensions.
     */
    util::extension_list enabled_extensions;
 
+   /**
+    * @brief Queues created with the device and their queue family index.
+    */
+   util::vector<std::pair<VkQueue, uint32_t>> queue_families;
+
    /**
     * @brief Stores whether the device supports controlling the swapchain image compression.
     *
@@ -944,12 +1453,104 @@ private:
     */
    bool swapchain_maintenance1_enabled;
 
+   /**
+    * @brief Stores whether the device has enabled the timeline semaphore feature.
+    */
+   bool timeline_semaphore_enabled;
+
 #if VULKAN_WSI_LAYER_EXPERIMENTAL
    /**
     * @brief Stores whether the device has enabled support for the present timing features.
     */
    bool present_timing_enabled;
 #endif
+
+   /**
+    * @brief Queue reserved for the layer, see @ref get_internal_queue.
+    */
+   VkQueue internal_queue{ VK_NULL_HANDLE };
+   uint32_t internal_queue_family_index{ 0 };
+   std::mutex internal_queue_lock;
+
+   /**
+    * @brief Protect the ancestor and descendant links of the swapchains, see @ref get_swapchain_links_lock.
+    */
+   std::mutex swapchain_links_lock;
+   std::condition_variable swapchain_links_changed;
+
+   /**
+    * @brief Stores whether the semaphores of the application are created exportable to Sync FDs.
+    */
+   bool present_semaphore_export_enabled{ false };
+
+   /**
+    * @brief Semaphores of the application created exportable to Sync FDs, see @ref add_exportable_semaphore.
+    */
+   util::unordered_set<VkSemaphore> exportable_semaphores;
+   std::mutex exportable_semaphores_lock;
+
+   /**
+    * @brief Pool of presentation workers shared by the swapchains of the device, created on first use.
+    */
+   util::unique_ptr<wsi::presentation_worker_pool> presentation_workers;
+   std::mutex presentation_workers_lock;
+
+   /**
+    * @brief Reaper destroying the swapchains of the device in the background, created on first use.
+    */
+   util::unique_ptr<wsi::swapchain_reaper> swapchain_reaper;
+   std::mutex swapchain_reaper_lock;
+
+   /**
+    * @brief Sync FD import support of the device, valid once @ref sync_fd_import_probed is set.
+    */
+   sync_fd_import_support sync_fd_import{ false, false, acquire_signal_mode::queue_submit,
+                                          acquire_signal_mode::queue_submit, -1 };
+   bool sync_fd_import_probed{ false };
+   std::mutex sync_fd_import_lock;
+
+   /**
+    * @brief Owns the sync FD referenced by sync_fd_import_support::signalled_sync_fd.
+    */
+   util::fd_owner signalled_sync_fd;
+
+   /**
+    * @brief Semaphores and fences released by destroyed swapchains, for reuse by new ones.
+    */
+   wsi::sync_object_pool sync_objects;
+
+   /**
+    * @brief DRM modifier support for swapchain images, shared by the swapchains of this device.
+    */
+   util::drm_format_modifier_cache format_modifier_cache;
+
+   /**
+    * @brief Memory types of the previous external memory imports, see @ref get_import_memory_type.
+    */
+   util::vector<std::pair<import_memory_source, uint32_t>> import_memory_types;
+   std::mutex import_memory_types_lock;
+
+   /**
+    * @brief Memory properties of the physical device, queried when the device is created.
+    */
+   VkPhysicalDeviceMemoryProperties memory_properties{};
+
+   /**
+    * @brief Memory held by the swapchains of this device, see @ref get_memory_usage.
+    */
+   util::memory_usage memory_usage_totals;
+
+   /**
+    * @brief Latest presentation events of the swapchains of this device, see @ref get_flight_recorder.
+    */
+   flight_recorder recorder;
+
+#if WSI_ENTRYPOINT_PROFILING
+   /**
+    * @brief Time spent in the swapchain entrypoints, printed when the device is destroyed.
+    */
+   entrypoint_profiler profiler;
+#endif
 };
 
 } /* namespace layer */
@@ -0,0 +1,599 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "settings.hpp"
+
+#include <cassert>
+#include <cctype>
+#include <charconv>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#include <util/helpers.hpp>
+#include <util/log.hpp>
+
+namespace layer
+{
+
+/**
+ * @brief Name of the layer, as given in the pLayerName of the settings meant for it.
+ */
+static constexpr const char *LAYER_NAME = "VK_LAYER_window_system_integration";
+
+/**
+ * @brief Prefix of the environment variables that override the settings.
+ */
+static constexpr const char *ENV_PREFIX = "VK_WINDOW_SYSTEM_INTEGRATION_";
+
+/**
+ * @brief Value of a setting, either given as a string or as a number.
+ */
+struct setting_value
+{
+   const char *string;
+   std::optional<uint64_t> integer;
+   /** The integer of the INT32 and INT64 settings, which may be negative. */
+   std::optional<int64_t> signed_integer;
+};
+
+static std::optional<uint64_t> get_integer(const setting_value &value)
+{
+   if (value.string == nullptr)
+   {
+      return value.integer;
+   }
+
+   uint64_t integer = 0;
+   const char *end = value.string + std::strlen(value.string);
+   auto result = std::from_chars(value.string, end, integer);
+   if (result.ec != std::errc() || result.ptr != end)
+   {
+      return std::nullopt;
+   }
+   return integer;
+}
+
+static std::optional<int64_t> get_signed_integer(const setting_value &value)
+{
+   if (value.string == nullptr)
+   {
+      if (value.signed_integer.has_value())
+      {
+         return value.signed_integer;
+      }
+      return value.integer.has_value() && *value.integer <= INT64_MAX ?
+                std::optional<int64_t>(static_cast<int64_t>(*value.integer)) :
+                std::nullopt;
+   }
+
+   int64_t integer = 0;
+   const char *end = value.string + std::strlen(value.string);
+   auto result = std::from_chars(value.string, end, integer);
+   if (result.ec != std::errc() || result.ptr != end)
+   {
+      return std::nullopt;
+   }
+   return integer;
+}
+
+static std::optional<bool> get_bool(const setting_value &value)
+{
+   if (value.string == nullptr)
+   {
+      return value.integer.has_value() ? std::optional<bool>(*value.integer != 0) : std::nullopt;
+   }
+
+   if (strcmp(value.string, "true") == 0 || strcmp(value.string, "on") == 0 || strcmp(value.string, "1") == 0)
+   {
+      return true;
+   }
+   else if (strcmp(value.string, "false") == 0 || strcmp(value.string, "off") == 0 || strcmp(value.string, "0") == 0)
+   {
+      return false;
+   }
+   return std::nullopt;
+}
+
+static bool set_fifo_presentation_thread(layer_settings &settings, const setting_value &value)
+{
+   auto enable = get_bool(value);
+   if (!enable.has_value())
+   {
+      return false;
+   }
+   settings.fifo_presentation_thread = *enable;
+   return true;
+}
+
+static bool set_presentation_worker_pool(layer_settings &settings, const setting_value &value)
+{
+   auto enable = get_bool(value);
+   if (!enable.has_value())
+   {
+      return false;
+   }
+   settings.presentation_worker_pool = *enable;
+   return true;
+}
+
+static bool set_max_pending_presents(layer_settings &settings, const setting_value &value)
+{
+   auto count = get_integer(value);
+   if (!count.has_value() || *count > UINT32_MAX)
+   {
+      return false;
+   }
+   settings.max_pending_presents = static_cast<uint32_t>(*count);
+   return true;
+}
+
+static bool set_present_sync(layer_settings &settings, const setting_value &value)
+{
+   if (value.string == nullptr)
+   {
+      return false;
+   }
+   else if (strcmp(value.string, "timeline") == 0)
+   {
+      settings.present_sync = present_sync_mode::timeline;
+   }
+   else if (strcmp(value.string, "fence") == 0)
+   {
+      settings.present_sync = present_sync_mode::fence;
+   }
+   else
+   {
+      return false;
+   }
+   return true;
+}
+
+static bool set_acquire_signal_mode(layer_settings &settings, const setting_value &value)
+{
+   if (value.string == nullptr)
+   {
+      return false;
+   }
+   else if (strcmp(value.string, "sentinel_sync_fd") == 0)
+   {
+      settings.acquire_mode = acquire_signal_mode::sentinel_sync_fd;
+   }
+   else if (strcmp(value.string, "signalled_sync_fd") == 0)
+   {
+      settings.acquire_mode = acquire_signal_mode::signalled_sync_fd;
+   }
+   else if (strcmp(value.string, "queue_submit") == 0)
+   {
+      settings.acquire_mode = acquire_signal_mode::queue_submit;
+   }
+   else
+   {
+      return false;
+   }
+   return true;
+}
+
+static bool set_allocator_cache_budget(layer_settings &settings, const setting_value &value)
+{
+   auto budget = get_integer(value);
+   if (!budget.has_value())
+   {
+      return false;
+   }
+   settings.allocator_cache_budget = *budget;
+   return true;
+}
+
+static bool set_instrumentation_level(layer_settings &settings, const setting_value &value)
+{
+   auto level = get_integer(value);
+   if (!level.has_value() || *level > UINT32_MAX)
+   {
+      return false;
+   }
+   settings.instrumentation_level = static_cast<uint32_t>(*level);
+   return true;
+}
+
+static bool set_scanout_compression(layer_settings &settings, const setting_value &value)
+{
+   auto enable = get_bool(value);
+   if (!enable.has_value())
+   {
+      return false;
+   }
+   settings.scanout_compression = *enable;
+   return true;
+}
+
+static bool set_prime_copy(layer_settings &settings, const setting_value &value)
+{
+   auto enable = get_bool(value);
+   if (!enable.has_value())
+   {
+      return false;
+   }
+   settings.prime_copy = *enable;
+   return true;
+}
+
+static bool set_adaptive_image_count(layer_settings &settings, const setting_value &value)
+{
+   auto enable = get_bool(value);
+   if (!enable.has_value())
+   {
+      return false;
+   }
+   settings.adaptive_image_count = *enable;
+   return true;
+}
+
+static bool set_parallel_image_creation(layer_settings &settings, const setting_value &value)
+{
+   auto enable = get_bool(value);
+   if (!enable.has_value())
+   {
+      return false;
+   }
+   settings.parallel_image_creation = *enable;
+   return true;
+}
+
+static bool set_speculative_allocation(layer_settings &settings, const setting_value &value)
+{
+   auto enable = get_bool(value);
+   if (!enable.has_value())
+   {
+      return false;
+   }
+   settings.speculative_allocation = *enable;
+   return true;
+}
+
+static bool set_occluded_frame_rate(layer_settings &settings, const setting_value &value)
+{
+   auto rate = get_integer(value);
+   if (!rate.has_value() || *rate > UINT32_MAX)
+   {
+      return false;
+   }
+   settings.occluded_frame_rate = static_cast<uint32_t>(*rate);
+   return true;
+}
+
+static bool set_presentation_thread_policy(layer_settings &settings, const setting_value &value)
+{
+   if (value.string == nullptr)
+   {
+      return false;
+   }
+   else if (strcmp(value.string, "normal") == 0)
+   {
+      settings.presentation_threads.policy = util::thread_policy::normal;
+   }
+   else if (strcmp(value.string, "fifo") == 0)
+   {
+      settings.presentation_threads.policy = util::thread_policy::fifo;
+   }
+   else if (strcmp(value.string, "rr") == 0)
+   {
+      settings.presentation_threads.policy = util::thread_policy::round_robin;
+   }
+   else
+   {
+      return false;
+   }
+   return true;
+}
+
+static bool set_presentation_thread_priority(layer_settings &settings, const setting_value &value)
+{
+   auto priority = get_integer(value);
+   if (!priority.has_value() || *priority < 1 || *priority > 99)
+   {
+      return false;
+   }
+   settings.presentation_threads.priority = static_cast<uint32_t>(*priority);
+   return true;
+}
+
+static bool set_presentation_thread_nice(layer_settings &settings, const setting_value &value)
+{
+   auto nice = get_signed_integer(value);
+   if (!nice.has_value() || *nice < -20 || *nice > 19)
+   {
+      return false;
+   }
+   settings.presentation_threads.nice = static_cast<int32_t>(*nice);
+   return true;
+}
+
+static bool set_presentation_thread_affinity(layer_settings &settings, const setting_value &value)
+{
+   if (value.string == nullptr)
+   {
+      return false;
+   }
+   else if (strcmp(value.string, "none") == 0)
+   {
+      settings.presentation_threads.numa_affinity = false;
+      settings.presentation_threads.cpus.reset();
+   }
+   else if (strcmp(value.string, "numa") == 0)
+   {
+      settings.presentation_threads.numa_affinity = true;
+      settings.presentation_threads.cpus.reset();
+   }
+   else
+   {
+      cpu_set_t cpus;
+      if (!util::parse_cpu_list(value.string, cpus))
+      {
+         return false;
+      }
+      settings.presentation_threads.cpus = cpus;
+   }
+   return true;
+}
+
+static bool set_deferred_swapchain_destruction(layer_settings &settings, const setting_value &value)
+{
+   auto enable = get_bool(value);
+   if (!enable.has_value())
+   {
+      return false;
+   }
+   settings.deferred_swapchain_destruction = *enable;
+   return true;
+}
+
+static bool set_merge_present_wait_semaphores(layer_settings &settings, const setting_value &value)
+{
+   auto enable = get_bool(value);
+   if (!enable.has_value())
+   {
+      return false;
+   }
+   settings.merge_present_wait_semaphores = *enable;
+   return true;
+}
+
+static bool set_internal_queue(layer_settings &settings, const setting_value &value)
+{
+   auto enable = get_bool(value);
+   if (!enable.has_value())
+   {
+      return false;
+   }
+   settings.internal_queue = *enable;
+   return true;
+}
+
+static bool set_flight_recorder(layer_settings &settings, const setting_value &value)
+{
+   auto enable = get_bool(value);
+   if (!enable.has_value())
+   {
+      return false;
+   }
+   settings.flight_recorder = *enable;
+   return true;
+}
+
+static bool set_flight_recorder_dir(layer_settings &settings, const setting_value &value)
+{
+   if (value.string == nullptr || value.string[0] == '\0' ||
+       std::strlen(value.string) >= sizeof(settings.flight_recorder_dir))
+   {
+      return false;
+   }
+   std::strcpy(settings.flight_recorder_dir, value.string);
+   return true;
+}
+
+static bool set_flight_recorder_signal(layer_settings &settings, const setting_value &value)
+{
+   auto signal_number = get_integer(value);
+   if (!signal_number.has_value())
+   {
+      return false;
+   }
+
+   /* Only signals without a default meaning to the application or the C library. */
+   const uint64_t sig = *signal_number;
+   if (sig != 0 && sig != SIGUSR1 && sig != SIGUSR2 &&
+       (sig < static_cast<uint64_t>(SIGRTMIN) || sig > static_cast<uint64_t>(SIGRTMAX)))
+   {
+      return false;
+   }
+   settings.flight_recorder_signal = static_cast<int32_t>(*signal_number);
+   return true;
+}
+
+/**
+ * @brief A setting of the layer.
+ */
+struct setting_entry
+{
+   const char *name;
+   /** An older environment variable that also sets the setting, or nullptr. */
+   const char *legacy_env;
+   bool (*set)(layer_settings &settings, const setting_value &value);
+};
+
+static constexpr setting_entry setting_entries[] = {
+   { "fifo_presentation_thread", nullptr, set_fifo_presentation_thread },
+   { "presentation_worker_pool", nullptr, set_presentation_worker_pool },
+   { "max_pending_presents", nullptr, set_max_pending_presents },
+   { "present_sync", nullptr, set_present_sync },
+   { "acquire_signal_mode", "WSI_ACQUIRE_SIGNAL_MODE", set_acquire_signal_mode },
+   { "allocator_cache_budget", nullptr, set_allocator_cache_budget },
+   { "instrumentation_level", nullptr, set_instrumentation_level },
+   { "scanout_compression", nullptr, set_scanout_compression },
+   { "prime_copy", nullptr, set_prime_copy },
+   { "adaptive_image_count", nullptr, set_adaptive_image_count },
+   { "parallel_image_creation", nullptr, set_parallel_image_creation },
+   { "speculative_allocation", nullptr, set_speculative_allocation },
+   { "occluded_frame_rate", nullptr, set_occluded_frame_rate },
+   { "presentation_thread_policy", nullptr, set_presentation_thread_policy },
+   { "presentation_thread_priority", nullptr, set_presentation_thread_priority },
+   { "presentation_thread_nice", nullptr, set_presentation_thread_nice },
+   { "presentation_thread_affinity", nullptr, set_presentation_thread_affinity },
+   { "deferred_swapchain_destruction", nullptr, set_deferred_swapchain_destruction },
+   { "merge_present_wait_semaphores", nullptr, set_merge_present_wait_semaphores },
+   { "internal_queue", nullptr, set_internal_queue },
+   { "flight_recorder", nullptr, set_flight_recorder },
+   { "flight_recorder_dir", nullptr, set_flight_recorder_dir },
+   { "flight_recorder_signal", nullptr, set_flight_recorder_signal },
+};
+
+/**
+ * @brief Get the first value of a setting given with VK_EXT_layer_settings.
+ */
+static std::optional<setting_value> get_setting_value(const VkLayerSettingEXT &setting)
+{
+   if (setting.valueCount == 0 || setting.pValues == nullptr)
+   {
+      return std::nullopt;
+   }
+
+   switch (setting.type)
+   {
+   case VK_LAYER_SETTING_TYPE_BOOL32_EXT:
+      return setting_value{ nullptr, *static_cast<const VkBool32 *>(setting.pValues) != VK_FALSE ? 1u : 0u,
+                            std::nullopt };
+   case VK_LAYER_SETTING_TYPE_INT32_EXT:
+   {
+      const int32_t integer = *static_cast<const int32_t *>(setting.pValues);
+      return setting_value{ nullptr, integer >= 0 ? std::optional<uint64_t>(integer) : std::nullopt, integer };
+   }
+   case VK_LAYER_SETTING_TYPE_UINT32_EXT:
+      return setting_value{ nullptr, *static_cast<const uint32_t *>(setting.pValues), std::nullopt };
+   case VK_LAYER_SETTING_TYPE_INT64_EXT:
+   {
+      const int64_t integer = *static_cast<const int64_t *>(setting.pValues);
+      return setting_value{ nullptr, integer >= 0 ? std::optional<uint64_t>(integer) : std::nullopt, integer };
+   }
+   case VK_LAYER_SETTING_TYPE_UINT64_EXT:
+      return setting_value{ nullptr, *static_cast<const uint64_t *>(setting.pValues), std::nullopt };
+   case VK_LAYER_SETTING_TYPE_STRING_EXT:
+   {
+      const char *string = *static_cast<const char *const *>(setting.pValues);
+      return string != nullptr ?
+                std::optional<setting_value>(setting_value{ string, std::nullopt, std::nullopt }) :
+                std::nullopt;
+   }
+   default:
+      return std::nullopt;
+   }
+}
+
+/**
+ * @brief Apply the settings given by the application with VkLayerSettingsCreateInfoEXT.
+ */
+static void apply_layer_settings_create_info(layer_settings &settings, const VkLayerSettingsCreateInfoEXT &info)
+{
+   for (uint32_t i = 0; i < info.settingCount; i++)
+   {
+      const VkLayerSettingEXT &setting = info.pSettings[i];
+      if (setting.pLayerName == nullptr || strcmp(setting.pLayerName, LAYER_NAME) != 0 ||
+          setting.pSettingName == nullptr)
+      {
+         continue;
+      }
+
+      const setting_entry *entry = nullptr;
+      for (const auto &candidate : setting_entries)
+      {
+         if (strcmp(candidate.name, setting.pSettingName) == 0)
+         {
+            entry = &candidate;
+            break;
+         }
+      }
+
+      if (entry == nullptr)
+      {
+         WSI_LOG_WARNING("Unknown layer setting \"%s\" ignored.", setting.pSettingName);
+         continue;
+      }
+
+      auto value = get_setting_value(setting);
+      if (!value.has_value() || !entry->set(settings, *value))
+      {
+         WSI_LOG_WARNING("Invalid value for layer setting \"%s\" ignored.", setting.pSettingName);
+      }
+   }
+}
+
+/**
+ * @brief Apply the environment variables that override a setting.
+ */
+static void apply_setting_environment(layer_settings &settings, const setting_entry &entry)
+{
+   char env_name[64];
+   const size_t prefix_length = strlen(ENV_PREFIX);
+   const size_t name_length = strlen(entry.name);
+   assert(prefix_length + name_length < sizeof(env_name));
+   memcpy(env_name, ENV_PREFIX, prefix_length);
+   for (size_t i = 0; i < name_length; i++)
+   {
+      env_name[prefix_length + i] = static_cast<char>(std::toupper(static_cast<unsigned char>(entry.name[i])));
+   }
+   env_name[prefix_length + name_length] = '\0';
+
+   for (const char *name : { entry.legacy_env, static_cast<const char *>(env_name) })
+   {
+      const char *env = name != nullptr ? std::getenv(name) : nullptr;
+      if (env != nullptr && !entry.set(settings, setting_value{ env, std::nullopt, std::nullopt }))
+      {
+         WSI_LOG_WARNING("Invalid value \"%s\" of %s ignored.", env, name);
+      }
+   }
+}
+
+layer_settings read_layer_settings(const VkInstanceCreateInfo &create_info)
+{
+   layer_settings settings{};
+
+   for (auto *info = util::find_extension<VkLayerSettingsCreateInfoEXT>(
+           VK_STRUCTURE_TYPE_LAYER_SETTINGS_CREATE_INFO_EXT, create_info.pNext);
+        info != nullptr; info = util::find_extension<VkLayerSettingsCreateInfoEXT>(
+                            VK_STRUCTURE_TYPE_LAYER_SETTINGS_CREATE_INFO_EXT, info->pNext))
+   {
+      apply_layer_settings_create_info(settings, *info);
+   }
+
+   /* The environment takes precedence, so settings can be changed without modifying the application. */
+   for (const auto &entry : setting_entries)
+   {
+      apply_setting_environment(settings, entry);
+   }
+
+   return settings;
+}
+
+} /* namespace layer */
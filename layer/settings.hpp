@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file settings.hpp
+ *
+ * @brief Runtime settings of the layer, read at vkCreateInstance.
+ *
+ * The settings are given by the application with VK_EXT_layer_settings, and each of them can be overridden by an
+ * environment variable named VK_WINDOW_SYSTEM_INTEGRATION_ followed by the name of the setting in upper case, e.g.
+ * VK_WINDOW_SYSTEM_INTEGRATION_MAX_PENDING_PRESENTS for max_pending_presents.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include <vulkan/vulkan.h>
+
+#include <util/thread.hpp>
+
+namespace layer
+{
+
+/**
+ * @brief How acquire signals the fence or semaphore given by the application, in order of preference.
+ */
+enum class acquire_signal_mode
+{
+   /** Import the already signalled sentinel sync FD (-1). */
+   sentinel_sync_fd,
+   /** Import a duplicate of a real sync FD that has signalled, kept by the device. */
+   signalled_sync_fd,
+   /** Signal with an empty queue submission, the last resort. */
+   queue_submit,
+};
+
+/**
+ * @brief How the presentation thread of the headless backend waits for the present payloads.
+ */
+enum class present_sync_mode
+{
+   /** Signal a timeline semaphore shared by the swapchain images, if the device supports it. */
+   timeline,
+   /** Signal a fence per swapchain image. */
+   fence,
+};
+
+/**
+ * @brief Settings of the layer for an instance.
+ */
+struct layer_settings
+{
+   /**
+    * @brief Setting "fifo_presentation_thread": whether FIFO swapchains on Wayland present from a presentation thread.
+    *
+    * Unset means the ENABLE_WAYLAND_FIFO_PRESENTATION_THREAD build option decides.
+    */
+   std::optional<bool> fifo_presentation_thread;
+
+   /**
+    * @brief Setting "presentation_worker_pool": whether swapchains share a pool of presentation threads per device.
+    */
+   bool presentation_worker_pool{ WSI_PRESENTATION_WORKER_POOL != 0 };
+
+   /**
+    * @brief Setting "max_pending_presents": number of presents that can be queued for a presentation thread before
+    *        vkQueuePresentKHR waits for the oldest one to be handed to the presentation engine. 0 means no limit.
+    */
+   uint32_t max_pending_presents{ 0 };
+
+   /**
+    * @brief Setting "present_sync": "timeline" or "fence", see @ref present_sync_mode.
+    *
+    * The other backends always use sync FD fences, as they hand the payloads over to the window system.
+    */
+   present_sync_mode present_sync{ present_sync_mode::timeline };
+
+   /**
+    * @brief Setting "acquire_signal_mode": "sentinel_sync_fd", "signalled_sync_fd" or "queue_submit", the first
+    *        @ref acquire_signal_mode to probe. The WSI_ACQUIRE_SIGNAL_MODE environment variable is also supported.
+    */
+   acquire_signal_mode acquire_mode{ acquire_signal_mode::sentinel_sync_fd };
+
+   /**
+    * @brief Setting "allocator_cache_budget": number of bytes of released buffers the wsialloc allocator shared by the
+    *        swapchains of a device may keep for reuse. 0 disables the cache.
+    */
+   uint64_t allocator_cache_budget{ 0 };
+
+   /**
+    * @brief Setting "instrumentation_level": 0 disables instrumentation, 1 passes frame boundary events with
+    *        VK_EXT_frame_boundary.
+    */
+   uint32_t instrumentation_level{ ENABLE_INSTRUMENTATION != 0 ? 1u : 0u };
+
+   /**
+    * @brief Setting "scanout_compression": whether the swapchains that are scanned out, on the display and Wayland
+    *        backends, use the most compressed layout the compositor or the DRM plane accepts when the application
+    *        does not control their compression.
+    */
+   bool scanout_compression{ false };
+
+   /**
+    * @brief Setting "prime_copy": whether Wayland swapchains always render to device local images and present linear
+    *        copies of them. Otherwise the copies are only used when the compositor cannot import the images the
+    *        device renders to.
+    */
+   bool prime_copy{ false };
+
+   /**
+    * @brief Setting "adaptive_image_count": whether swapchains limit how many of their images the application can use
+    *        at once, to the fewest that keep its frame rate, based on the measured acquire waits and presents.
+    */
+   bool adaptive_image_count{ false };
+
+   /**
+    * @brief Setting "parallel_image_creation": whether the images created with a swapchain are allocated and imported
+    *        on worker threads, on the backends that support it.
+    */
+   bool parallel_image_creation{ false };
+
+   /**
+    * @brief Setting "speculative_allocation": whether display surfaces start allocating the buffers of their first
+    *        swapchain when the application queries their capabilities.
+    */
+   bool speculative_allocation{ false };
+
+   /**
+    * @brief Setting "occluded_frame_rate": frames per second the application may acquire images at while its surface
+    *        is hidden, on the backends that can tell. 0 does not throttle hidden surfaces.
+    */
+   uint32_t occluded_frame_rate{ 0 };
+
+   /**
+    * @brief Scheduling of the threads that hand images over to the presentation engine: the page flip threads, the
+    *        presentation worker pool and the X11 present event threads.
+    *
+    * Given by the settings "presentation_thread_policy" ("normal", "fifo" or "rr"), "presentation_thread_priority"
+    * (the real-time priority), "presentation_thread_nice" (the nice level with the normal policy) and
+    * "presentation_thread_affinity" ("none", "numa" or a list of CPUs such as "0-3,6").
+    */
+   util::thread_scheduling presentation_threads;
+
+   /**
+    * @brief Setting "deferred_swapchain_destruction": whether vkDestroySwapchainKHR hands the swapchains over to a
+    *        background thread of the device, which destroys them once the presentation engine has released their
+    *        images, instead of waiting for it.
+    */
+   bool deferred_swapchain_destruction{ false };
+
+   /**
+    * @brief Setting "merge_present_wait_semaphores": whether the semaphores the application creates are made exportable
+    *        to Sync FDs, so that the semaphores a present waits on can be merged into the Sync FD the presentation
+    *        engine waits on, instead of being waited on by a queue submission of the layer.
+    */
+   bool merge_present_wait_semaphores{ false };
+
+   /**
+    * @brief Setting "internal_queue": whether an extra queue is created with the devices for the synchronization only
+    *        submissions of the layer, so that they do not wait behind the rendering work of the application.
+    */
+   bool internal_queue{ false };
+
+   /**
+    * @brief Setting "flight_recorder": whether the latest presentation events of each device are kept in memory, to be
+    *        dumped to a file when a surface is lost or on request.
+    */
+   bool flight_recorder{ true };
+
+   /**
+    * @brief Setting "flight_recorder_dir": directory the flight recorder is dumped to. Empty for $XDG_RUNTIME_DIR.
+    */
+   char flight_recorder_dir[192]{};
+
+   /**
+    * @brief Setting "flight_recorder_signal": signal that dumps the flight recorders of the process, SIGUSR1, SIGUSR2
+    *        or a realtime signal. 0 does not install a signal handler.
+    */
+   int32_t flight_recorder_signal{ 0 };
+};
+
+/**
+ * @brief Read the settings of the layer.
+ *
+ * Unknown settings and invalid values are reported and ignored, so they never fail instance creation.
+ *
+ * @param create_info The create info of the instance, whose pNext chain may contain VkLayerSettingsCreateInfoEXT.
+ *
+ * @return The settings, with the defaults for the settings that are not given.
+ */
+layer_settings read_layer_settings(const VkInstanceCreateInfo &create_info);
+
+} /* namespace layer */
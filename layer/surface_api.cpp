@@ -168,6 +168,9 @@ wsi_layer_vkDestroySurfaceKHR(VkInstance instance, VkSurfaceKHR surface,
 {
    auto &instance_data = layer::instance_private_data::get(instance);
 
+   /* The swapchains of the surface may still be waiting to be destroyed in the background. */
+   instance_data.wait_for_deferred_swapchain_destructions();
+
    instance_data.disp.DestroySurfaceKHR(instance, surface, pAllocator);
 
    instance_data.remove_surface(
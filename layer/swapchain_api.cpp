@@ -35,11 +35,14 @@
 #include "private_data.hpp"
 #include "swapchain_api.hpp"
 
+#include <util/allocation_tracker.hpp>
 #include <util/helpers.hpp>
+#include <util/small_vector.hpp>
 
 #include <wsi/synchronization.hpp>
 #include <wsi/wsi_factory.hpp>
 #include <wsi/extensions/frame_boundary.hpp>
+#include <wsi/extensions/present_id.hpp>
 #include "util/macros.hpp"
 
 VWL_VKAPI_CALL(VkResult)
@@ -48,6 +51,7 @@ wsi_layer_vkCreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR *
 {
    assert(pSwapchain != nullptr);
    layer::device_private_data &device_data = layer::device_private_data::get(device);
+   WSI_PROFILE_ENTRYPOINT(device_data, create_swapchain);
    VkSurfaceKHR surface = pSwapchainCreateInfo->surface;
 
    if (!device_data.should_layer_create_swapchain(surface))
@@ -81,6 +85,7 @@ wsi_layer_vkDestroySwapchainKHR(VkDevice device, VkSwapchainKHR swapc,
                                 const VkAllocationCallbacks *pAllocator) VWL_API_POST
 {
    layer::device_private_data &device_data = layer::device_private_data::get(device);
+   WSI_PROFILE_ENTRYPOINT(device_data, destroy_swapchain);
 
    if (!device_data.layer_owns_swapchain(swapc))
    {
@@ -99,6 +104,7 @@ wsi_layer_vkGetSwapchainImagesKHR(VkDevice device, VkSwapchainKHR swapc, uint32_
                                   VkImage *pSwapchainImages) VWL_API_POST
 {
    layer::device_private_data &device_data = layer::device_private_data::get(device);
+   WSI_PROFILE_ENTRYPOINT(device_data, get_swapchain_images);
 
    if (!device_data.layer_owns_swapchain(swapc))
    {
@@ -116,12 +122,15 @@ wsi_layer_vkAcquireNextImageKHR(VkDevice device, VkSwapchainKHR swapc, uint64_t
                                 VkFence fence, uint32_t *pImageIndex) VWL_API_POST
 {
    layer::device_private_data &device_data = layer::device_private_data::get(device);
+   WSI_PROFILE_ENTRYPOINT(device_data, acquire_next_image);
 
    if (!device_data.layer_owns_swapchain(swapc))
    {
       return device_data.disp.AcquireNextImageKHR(device_data.device, swapc, timeout, semaphore, fence, pImageIndex);
    }
 
+   WSI_FRAME_ALLOCATION_SCOPE("vkAcquireNextImageKHR");
+
    assert(swapc != VK_NULL_HANDLE);
    assert(semaphore != VK_NULL_HANDLE || fence != VK_NULL_HANDLE);
    assert(pImageIndex != nullptr);
@@ -130,10 +139,12 @@ wsi_layer_vkAcquireNextImageKHR(VkDevice device, VkSwapchainKHR swapc, uint64_t
 }
 
 static VkResult submit_wait_request(VkQueue queue, const VkPresentInfoKHR &present_info,
+                                    const wsi::present_info_extensions &present_extensions,
                                     layer::device_private_data &device_data, bool &frame_boundary_event_handled)
 {
-   util::vector<VkSemaphore> swapchain_semaphores{ util::allocator(device_data.get_allocator(),
-                                                                   VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) };
+   /* Only allocate on the heap for unusually many swapchains. */
+   util::small_vector<VkSemaphore, 8> swapchain_semaphores{ util::allocator(device_data.get_allocator(),
+                                                                            VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) };
    if (!swapchain_semaphores.try_resize(present_info.swapchainCount))
    {
       return VK_ERROR_OUT_OF_HOST_MEMORY;
@@ -146,11 +157,10 @@ static VkResult submit_wait_request(VkQueue queue, const VkPresentInfoKHR &prese
    }
 
    wsi::queue_submit_semaphores semaphores = { present_info.pWaitSemaphores, present_info.waitSemaphoreCount,
-                                               swapchain_semaphores.data(),
-                                               static_cast<uint32_t>(swapchain_semaphores.size()) };
+                                               swapchain_semaphores.data(), present_info.swapchainCount };
 
    void *submission_pnext = nullptr;
-   auto frame_boundary = wsi::create_frame_boundary(present_info);
+   auto frame_boundary = wsi::create_frame_boundary(present_extensions.frame_boundary);
    if (frame_boundary.has_value())
    {
       submission_pnext = &frame_boundary.value();
@@ -163,6 +173,31 @@ static VkResult submit_wait_request(VkQueue queue, const VkPresentInfoKHR &prese
    return VK_SUCCESS;
 }
 
+/**
+ * @brief Check whether all swapchains of a presentation request can share a single present payload.
+ *
+ * The first swapchain then submits the only payload of the request and the others import it, instead of a shared
+ * wait submission followed by a payload submission per swapchain.
+ */
+static bool can_share_present_payload(const VkPresentInfoKHR &present_info, layer::device_private_data &device_data)
+{
+   /* The layer generated frame boundaries need a submission per swapchain image. */
+   if (present_info.swapchainCount < 2 || device_data.should_layer_handle_frame_boundary_events())
+   {
+      return false;
+   }
+
+   for (uint32_t i = 0; i < present_info.swapchainCount; ++i)
+   {
+      auto swapchain = reinterpret_cast<wsi::swapchain_base *>(present_info.pSwapchains[i]);
+      if (!swapchain->can_share_present_payload())
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
 VWL_VKAPI_CALL(VkResult)
 wsi_layer_vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) VWL_API_POST
 {
@@ -170,32 +205,40 @@ wsi_layer_vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo)
    assert(pPresentInfo != nullptr);
 
    layer::device_private_data &device_data = layer::device_private_data::get(queue);
+   WSI_PROFILE_ENTRYPOINT(device_data, queue_present);
 
    if (!device_data.layer_owns_all_swapchains(pPresentInfo->pSwapchains, pPresentInfo->swapchainCount))
    {
       return device_data.disp.QueuePresentKHR(queue, pPresentInfo);
    }
 
+   WSI_FRAME_ALLOCATION_SCOPE("vkQueuePresentKHR");
+
+   /* Walk the pNext chain once, for all swapchains. */
+   const wsi::present_info_extensions present_extensions = wsi::find_present_info_extensions(*pPresentInfo);
+
    /* Avoid allocating on the heap when there is only one swapchain. */
    const VkPresentInfoKHR *present_info = pPresentInfo;
    bool use_image_present_semaphore = false;
-   bool frame_boundary_event_handled = true;
-   if (pPresentInfo->swapchainCount > 1)
+   bool frame_boundary_event_handled = false;
+   const bool share_present_payload = can_share_present_payload(*pPresentInfo, device_data);
+   util::fd_owner shared_payload_sync_fd;
+   bool shared_payload_submitted = false;
+   if (pPresentInfo->swapchainCount > 1 && !share_present_payload)
    {
-      TRY_LOG_CALL(submit_wait_request(queue, *pPresentInfo, device_data, frame_boundary_event_handled));
+      TRY_LOG_CALL(
+         submit_wait_request(queue, *pPresentInfo, present_extensions, device_data, frame_boundary_event_handled));
       use_image_present_semaphore = true;
    }
 
    VkResult ret = VK_SUCCESS;
 
-   auto *present_ids = util::find_extension<VkPresentIdKHR>(VK_STRUCTURE_TYPE_PRESENT_ID_KHR, pPresentInfo->pNext);
-   const auto present_fence_info = util::find_extension<VkSwapchainPresentFenceInfoEXT>(
-      VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT, present_info->pNext);
-   const auto swapchain_present_mode_info = util::find_extension<VkSwapchainPresentModeInfoEXT>(
-      VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_MODE_INFO_EXT, present_info->pNext);
+   const auto *present_ids = present_extensions.present_ids;
+   const auto *present_regions = present_extensions.present_regions;
+   const auto *present_fence_info = present_extensions.present_fence_info;
+   const auto *swapchain_present_mode_info = present_extensions.present_mode_info;
 #if VULKAN_WSI_LAYER_EXPERIMENTAL
-   const auto present_timings_info =
-      util::find_extension<VkPresentTimingsInfoEXT>(VK_STRUCTURE_TYPE_PRESENT_TIMINGS_INFO_EXT, present_info->pNext);
+   const auto *present_timings_info = present_extensions.present_timings_info;
    if (present_timings_info)
    {
       assert(present_timings_info->swapchainCount == pPresentInfo->swapchainCount);
@@ -223,9 +266,30 @@ wsi_layer_vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo)
 
       present_params.pending_present.image_index = pPresentInfo->pImageIndices[i];
       present_params.pending_present.present_id = present_id;
+      if (present_regions != nullptr && present_regions->pRegions != nullptr &&
+          present_regions->swapchainCount == pPresentInfo->swapchainCount)
+      {
+         present_params.present_region = &present_regions->pRegions[i];
+      }
 
       present_params.use_image_present_semaphore = use_image_present_semaphore;
-      present_params.handle_present_frame_boundary_event = frame_boundary_event_handled;
+      present_params.handle_present_frame_boundary_event = !frame_boundary_event_handled;
+      if (share_present_payload)
+      {
+         /* The first swapchain submits the payload for the whole request, the others take it over. If it fails before
+          * submitting, the next swapchain submits it instead. */
+         present_params.handle_present_frame_boundary_event = !shared_payload_submitted;
+         if (!shared_payload_submitted)
+         {
+            present_params.share_payload_sync_fd = &shared_payload_sync_fd;
+            present_params.share_payload_submitted = &shared_payload_submitted;
+         }
+         else
+         {
+            present_params.use_shared_payload = true;
+            present_params.shared_payload_sync_fd = shared_payload_sync_fd.get();
+         }
+      }
 
 #if VULKAN_WSI_LAYER_EXPERIMENTAL
       if (present_timings_info)
@@ -234,13 +298,16 @@ wsi_layer_vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo)
          present_params.m_present_timing_info.pNext = nullptr;
       }
 #endif
-      VkResult res = sc->queue_present(queue, present_info, present_params);
+      /* Every swapchain is presented, so that a failure of one does not keep the images of the others acquired. */
+      VkResult res = sc->queue_present(queue, present_info, present_extensions, present_params);
+
       if (pPresentInfo->pResults != nullptr)
       {
          pPresentInfo->pResults[i] = res;
       }
 
-      if (res != VK_SUCCESS && ret == VK_SUCCESS)
+      /* An error of any swapchain takes precedence over VK_SUBOPTIMAL_KHR. */
+      if (res != VK_SUCCESS && (ret == VK_SUCCESS || (res < VK_SUCCESS && ret > VK_SUCCESS)))
       {
          ret = res;
       }
@@ -342,12 +409,15 @@ wsi_layer_vkAcquireNextImage2KHR(VkDevice device, const VkAcquireNextImageInfoKH
    assert(pImageIndex != nullptr);
 
    auto &device_data = layer::device_private_data::get(device);
+   WSI_PROFILE_ENTRYPOINT(device_data, acquire_next_image);
 
    if (!device_data.layer_owns_swapchain(pAcquireInfo->swapchain))
    {
       return device_data.disp.AcquireNextImage2KHR(device, pAcquireInfo, pImageIndex);
    }
 
+   WSI_FRAME_ALLOCATION_SCOPE("vkAcquireNextImage2KHR");
+
    auto *sc = reinterpret_cast<wsi::swapchain_base *>(pAcquireInfo->swapchain);
 
    return sc->acquire_next_image(pAcquireInfo->timeout, pAcquireInfo->semaphore, pAcquireInfo->fence, pImageIndex);
@@ -371,6 +441,62 @@ wsi_layer_vkCreateImage(VkDevice device, const VkImageCreateInfo *pCreateInfo, c
    return sc->create_aliased_image_handle(pImage);
 }
 
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkCreateSemaphore(VkDevice device, const VkSemaphoreCreateInfo *pCreateInfo,
+                            const VkAllocationCallbacks *pAllocator, VkSemaphore *pSemaphore) VWL_API_POST
+{
+   auto &device_data = layer::device_private_data::get(device);
+   if (!device_data.is_present_semaphore_export_enabled())
+   {
+      return device_data.disp.CreateSemaphore(device_data.device, pCreateInfo, pAllocator, pSemaphore);
+   }
+
+   /* Only binary semaphores can be waited on by a present. */
+   const auto *type_info = util::find_extension<VkSemaphoreTypeCreateInfo>(
+      VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO, pCreateInfo->pNext);
+   if (type_info != nullptr && type_info->semaphoreType != VK_SEMAPHORE_TYPE_BINARY)
+   {
+      return device_data.disp.CreateSemaphore(device_data.device, pCreateInfo, pAllocator, pSemaphore);
+   }
+
+   /* Semaphores the application exports itself keep their handle types, other handle types may not combine with
+    * Sync FDs. */
+   const auto *export_info = util::find_extension<VkExportSemaphoreCreateInfo>(
+      VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO, pCreateInfo->pNext);
+   const bool exportable =
+      export_info == nullptr || (export_info->handleTypes & VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT) != 0;
+
+   VkSemaphoreCreateInfo create_info = *pCreateInfo;
+   VkExportSemaphoreCreateInfo sync_fd_export_info = {};
+   if (export_info == nullptr)
+   {
+      sync_fd_export_info.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO;
+      sync_fd_export_info.pNext = create_info.pNext;
+      sync_fd_export_info.handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
+      create_info.pNext = &sync_fd_export_info;
+   }
+
+   TRY(device_data.disp.CreateSemaphore(device_data.device, &create_info, pAllocator, pSemaphore));
+   if (exportable && !device_data.add_exportable_semaphore(*pSemaphore))
+   {
+      /* Not fatal, presents waiting on the semaphore submit a queue operation for it. */
+      WSI_LOG_WARNING("Failed to record an exportable semaphore.");
+   }
+   return VK_SUCCESS;
+}
+
+VWL_VKAPI_CALL(void)
+wsi_layer_vkDestroySemaphore(VkDevice device, VkSemaphore semaphore,
+                             const VkAllocationCallbacks *pAllocator) VWL_API_POST
+{
+   auto &device_data = layer::device_private_data::get(device);
+   if (device_data.is_present_semaphore_export_enabled() && semaphore != VK_NULL_HANDLE)
+   {
+      device_data.remove_exportable_semaphore(semaphore);
+   }
+   device_data.disp.DestroySemaphore(device_data.device, semaphore, pAllocator);
+}
+
 VWL_VKAPI_CALL(VkResult)
 wsi_layer_vkBindImageMemory2(VkDevice device, uint32_t bindInfoCount,
                              const VkBindImageMemoryInfo *pBindInfos) VWL_API_POST
@@ -438,3 +564,20 @@ wsi_layer_vkGetSwapchainStatusKHR(VkDevice device, VkSwapchainKHR swapchain) VWL
 
    return sc->get_swapchain_status();
 }
+
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkWaitForPresentKHR(VkDevice device, VkSwapchainKHR swapchain, uint64_t presentId,
+                              uint64_t timeout) VWL_API_POST
+{
+   auto &device_data = layer::device_private_data::get(device);
+
+   if (!device_data.layer_owns_swapchain(swapchain))
+   {
+      return device_data.disp.WaitForPresentKHR(device, swapchain, presentId, timeout);
+   }
+
+   auto *sc = reinterpret_cast<wsi::swapchain_base *>(swapchain);
+   auto *ext = sc->get_swapchain_extension<wsi::wsi_ext_present_id>(true);
+
+   return ext->wait_for_present(presentId, timeout);
+}
@@ -73,9 +73,21 @@ VWL_VKAPI_CALL(VkResult)
 wsi_layer_vkCreateImage(VkDevice device, const VkImageCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
                         VkImage *pImage) VWL_API_POST;
 
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkCreateSemaphore(VkDevice device, const VkSemaphoreCreateInfo *pCreateInfo,
+                            const VkAllocationCallbacks *pAllocator, VkSemaphore *pSemaphore) VWL_API_POST;
+
+VWL_VKAPI_CALL(void)
+wsi_layer_vkDestroySemaphore(VkDevice device, VkSemaphore semaphore,
+                             const VkAllocationCallbacks *pAllocator) VWL_API_POST;
+
 VWL_VKAPI_CALL(VkResult)
 wsi_layer_vkBindImageMemory2(VkDevice device, uint32_t bindInfoCount,
                              const VkBindImageMemoryInfo *pBindInfos) VWL_API_POST;
 
 VWL_VKAPI_CALL(VkResult)
 wsi_layer_vkGetSwapchainStatusKHR(VkDevice device, VkSwapchainKHR swapchain) VWL_API_POST;
+
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkWaitForPresentKHR(VkDevice device, VkSwapchainKHR swapchain, uint64_t presentId,
+                              uint64_t timeout) VWL_API_POST;
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file swapchain_latency_api.cpp
+ *
+ * @brief Contains the Vulkan entrypoints for the swapchain latency histograms, frame statistics and frame pacing.
+ */
+#include <cassert>
+#include "wsi_layer_experimental.hpp"
+
+#include <wsi/swapchain_base.hpp>
+#include "util/macros.hpp"
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+/**
+ * @brief Implements vkGetSwapchainLatencyHistogramsARM entrypoint.
+ */
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkGetSwapchainLatencyHistogramsARM(VkDevice device, VkSwapchainKHR swapchain,
+                                             VkSwapchainLatencyHistogramsARM *pLatencyHistograms) VWL_API_POST
+{
+   assert(swapchain != VK_NULL_HANDLE);
+   assert(pLatencyHistograms != nullptr);
+
+   auto &device_data = layer::device_private_data::get(device);
+   if (!device_data.layer_owns_swapchain(swapchain))
+   {
+      /* The query is specific to the layer, so there is nothing further down the chain to forward it to. */
+      return VK_ERROR_FEATURE_NOT_PRESENT;
+   }
+
+   auto *sc = reinterpret_cast<wsi::swapchain_base *>(swapchain);
+   sc->get_latency_histograms(*pLatencyHistograms);
+
+   return VK_SUCCESS;
+}
+
+/**
+ * @brief Implements vkGetSwapchainFrameStatisticsARM entrypoint.
+ */
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkGetSwapchainFrameStatisticsARM(VkDevice device, VkSwapchainKHR swapchain, uint32_t *pFrameCount,
+                                           VkSwapchainFrameStatisticsARM *pFrameStatistics) VWL_API_POST
+{
+   assert(swapchain != VK_NULL_HANDLE);
+   assert(pFrameCount != nullptr);
+
+   auto &device_data = layer::device_private_data::get(device);
+   if (!device_data.layer_owns_swapchain(swapchain))
+   {
+      /* The query is specific to the layer, so there is nothing further down the chain to forward it to. */
+      return VK_ERROR_FEATURE_NOT_PRESENT;
+   }
+
+   auto *sc = reinterpret_cast<wsi::swapchain_base *>(swapchain);
+   return sc->get_frame_statistics(pFrameCount, pFrameStatistics);
+}
+
+/**
+ * @brief Implements vkSetLatencyMarkerARM entrypoint.
+ */
+VWL_VKAPI_CALL(void)
+wsi_layer_vkSetLatencyMarkerARM(VkDevice device, VkSwapchainKHR swapchain,
+                                const VkLatencyMarkerInfoARM *pMarkerInfo) VWL_API_POST
+{
+   assert(swapchain != VK_NULL_HANDLE);
+   assert(pMarkerInfo != nullptr);
+
+   auto &device_data = layer::device_private_data::get(device);
+   if (!device_data.layer_owns_swapchain(swapchain))
+   {
+      /* The markers are specific to the layer, so there is nothing further down the chain to forward them to. */
+      return;
+   }
+
+   auto *sc = reinterpret_cast<wsi::swapchain_base *>(swapchain);
+   sc->set_latency_marker(pMarkerInfo->marker);
+}
+
+/**
+ * @brief Implements vkLatencySleepARM entrypoint.
+ */
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkLatencySleepARM(VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout) VWL_API_POST
+{
+   assert(swapchain != VK_NULL_HANDLE);
+
+   auto &device_data = layer::device_private_data::get(device);
+   if (!device_data.layer_owns_swapchain(swapchain))
+   {
+      /* The query is specific to the layer, so there is nothing further down the chain to forward it to. */
+      return VK_ERROR_FEATURE_NOT_PRESENT;
+   }
+
+   auto *sc = reinterpret_cast<wsi::swapchain_base *>(swapchain);
+   return sc->latency_sleep(timeout);
+}
+#endif /* VULKAN_WSI_LAYER_EXPERIMENTAL */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file swapchain_memory_api.cpp
+ *
+ * @brief Contains the Vulkan entrypoint for the query of the memory the layer holds for swapchains.
+ */
+#include <cassert>
+#include "wsi_layer_experimental.hpp"
+
+#include <util/helpers.hpp>
+#include <util/memory_usage.hpp>
+#include <wsi/swapchain_base.hpp>
+#include "util/macros.hpp"
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+/**
+ * @brief Copy memory usage counters to the structure returned to the application.
+ */
+static void fill_memory_usage(const util::memory_usage &usage, VkSwapchainMemoryUsageARM &memory_usage)
+{
+   for (uint32_t heap = 0; heap < VK_MAX_MEMORY_HEAPS; heap++)
+   {
+      memory_usage.heapUsage[heap] = usage.get_heap_bytes(heap);
+   }
+   memory_usage.dmaBufUsage = usage.get_dma_buf_bytes();
+   memory_usage.hostUsage = usage.get_host_bytes();
+}
+
+/**
+ * @brief Implements vkGetSwapchainMemoryUsageARM entrypoint.
+ */
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkGetSwapchainMemoryUsageARM(VkDevice device, VkSwapchainKHR swapchain,
+                                       VkSwapchainMemoryUsageARM *pMemoryUsage) VWL_API_POST
+{
+   assert(pMemoryUsage != nullptr);
+
+   auto &device_data = layer::device_private_data::get(device);
+   if (swapchain == VK_NULL_HANDLE)
+   {
+      fill_memory_usage(device_data.get_memory_usage(), *pMemoryUsage);
+   }
+   else if (device_data.layer_owns_swapchain(swapchain))
+   {
+      auto *sc = reinterpret_cast<wsi::swapchain_base *>(swapchain);
+      fill_memory_usage(sc->get_memory_usage(), *pMemoryUsage);
+   }
+   else
+   {
+      /* The query is specific to the layer, so there is nothing further down the chain to forward it to. */
+      return VK_ERROR_FEATURE_NOT_PRESENT;
+   }
+
+   auto *budget = util::find_extension<VkPhysicalDeviceMemoryBudgetPropertiesEXT>(
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT, pMemoryUsage->pNext);
+   if (budget != nullptr && device_data.is_device_extension_enabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+   {
+      /* Query the budget alone, the rest of the chain of the application is not valid for the query. */
+      void *next = budget->pNext;
+      budget->pNext = nullptr;
+
+      VkPhysicalDeviceMemoryProperties2 memory_props = {};
+      memory_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+      memory_props.pNext = budget;
+      device_data.instance_data.disp.GetPhysicalDeviceMemoryProperties2KHR(device_data.physical_device,
+                                                                          &memory_props);
+      budget->pNext = next;
+   }
+
+   return VK_SUCCESS;
+}
+#endif /* VULKAN_WSI_LAYER_EXPERIMENTAL */
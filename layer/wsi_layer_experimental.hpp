@@ -181,6 +181,10 @@ typedef VkResult(VKAPI_PTR *PFN_vkGetSwapchainTimingPropertiesEXT)(
 typedef VkResult(VKAPI_PTR *PFN_vkSetSwapchainPresentTimingQueueSizeEXT)(VkDevice device, VkSwapchainKHR swapchain,
                                                                          uint32_t size);
 
+typedef VkResult(VKAPI_PTR *PFN_vkGetPastPresentationTimingEXT)(
+   VkDevice device, const VkPastPresentationTimingInfoEXT *pPastPresentationTimingInfo,
+   VkPastPresentationTimingPropertiesEXT *pPastPresentationTimingProperties);
+
 VWL_VKAPI_CALL(VkResult)
 wsi_layer_vkSetSwapchainPresentTimingQueueSizeEXT(VkDevice device, VkSwapchainKHR swapchain,
                                                   uint32_t size) VWL_API_POST;
@@ -199,4 +203,236 @@ wsi_layer_vkGetPastPresentationTimingEXT(
    VkDevice device, const VkPastPresentationTimingInfoEXT *pPastPresentationTimingInfo,
    VkPastPresentationTimingPropertiesEXT *pPastPresentationTimingProperties) VWL_API_POST;
 
+/* Layer specific query for the latency of the presentation stages of a swapchain. */
+#define VK_SWAPCHAIN_LATENCY_HISTOGRAM_BUCKET_COUNT_ARM 32
+
+/* Placeholder. Layer specific structure type. */
+#define VK_STRUCTURE_TYPE_SWAPCHAIN_LATENCY_HISTOGRAMS_ARM ((VkStructureType)1000999000)
+
+/**
+ * Histogram of the durations of a presentation stage.
+ *
+ * Bucket i counts the durations in the range [2^i, 2^(i+1)) microseconds, with bucket 0 also counting durations
+ * below 1 microsecond and the last bucket also counting all the longer durations.
+ */
+typedef struct VkSwapchainLatencyHistogramARM
+{
+   uint64_t sampleCount;
+   uint64_t totalDuration;
+   uint64_t maxDuration;
+   uint64_t buckets[VK_SWAPCHAIN_LATENCY_HISTOGRAM_BUCKET_COUNT_ARM];
+} VkSwapchainLatencyHistogramARM;
+
+/**
+ * Latency histograms of a swapchain, accumulated since the swapchain was created. Durations are in nanoseconds.
+ */
+typedef struct VkSwapchainLatencyHistogramsARM
+{
+   VkStructureType sType;
+   void *pNext;
+   /* Time vkAcquireNextImageKHR spent waiting for a free image. */
+   VkSwapchainLatencyHistogramARM acquireWait;
+   /* Time from vkQueuePresentKHR until the payload of the presented image completed. Only recorded by swapchains
+    * that wait for the payload on a presentation thread. */
+   VkSwapchainLatencyHistogramARM gpuWait;
+   /* Time from the payload completing until the image was handed over to the display. */
+   VkSwapchainLatencyHistogramARM presentToDisplay;
+} VkSwapchainLatencyHistogramsARM;
+
+typedef VkResult(VKAPI_PTR *PFN_vkGetSwapchainLatencyHistogramsARM)(
+   VkDevice device, VkSwapchainKHR swapchain, VkSwapchainLatencyHistogramsARM *pLatencyHistograms);
+
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkGetSwapchainLatencyHistogramsARM(VkDevice device, VkSwapchainKHR swapchain,
+                                             VkSwapchainLatencyHistogramsARM *pLatencyHistograms) VWL_API_POST;
+
+/* Layer specific query for the statistics of the most recent frames presented to a swapchain. */
+#define VK_SWAPCHAIN_FRAME_STATISTICS_COUNT_ARM 64
+
+/**
+ * Statistics of a frame presented to a swapchain, recorded while the layer passes frame boundary events.
+ * Times are in CLOCK_MONOTONIC nanoseconds.
+ */
+typedef struct VkSwapchainFrameStatisticsARM
+{
+   /* frameID of the VkFrameBoundaryEXT of the present, given by the application or generated by the layer. */
+   uint64_t frameID;
+   /* Time vkQueuePresentKHR was called. */
+   uint64_t presentCallTime;
+   /* Time vkQueuePresentKHR spent queueing the image of the swapchain. */
+   uint64_t presentCallDuration;
+   /* Time from vkQueuePresentKHR until the present payload completed, 0 until it has, or if the swapchain presents
+    * without a presentation thread. */
+   uint64_t gpuWaitDuration;
+   /* Number of images of the swapchain queued for presentation or being presented, including this one. */
+   uint32_t imagesInFlight;
+   /* Number of presents of the swapchain completed by flipping and by copying, including this one, 0 until it has
+    * completed. Only reported by the X11 backend, always 0 otherwise. */
+   uint64_t flipCount;
+   uint64_t copyCount;
+} VkSwapchainFrameStatisticsARM;
+
+typedef VkResult(VKAPI_PTR *PFN_vkGetSwapchainFrameStatisticsARM)(VkDevice device, VkSwapchainKHR swapchain,
+                                                                   uint32_t *pFrameCount,
+                                                                   VkSwapchainFrameStatisticsARM *pFrameStatistics);
+
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkGetSwapchainFrameStatisticsARM(VkDevice device, VkSwapchainKHR swapchain, uint32_t *pFrameCount,
+                                           VkSwapchainFrameStatisticsARM *pFrameStatistics) VWL_API_POST;
+
+/* Layer specific query for the memory the layer holds for swapchains. */
+
+/* Placeholder. Layer specific structure type. */
+#define VK_STRUCTURE_TYPE_SWAPCHAIN_MEMORY_USAGE_ARM ((VkStructureType)1000999004)
+
+/**
+ * Memory held by the layer for a swapchain, or for all the swapchains of a device, in bytes.
+ *
+ * The device memory is the memory of the swapchain images and of the buffers they are copied to, allocated or
+ * imported by the layer. The driver counts it in VkPhysicalDeviceMemoryBudgetPropertiesEXT::heapUsage too, which can
+ * be chained to this structure to get both in a single query.
+ */
+typedef struct VkSwapchainMemoryUsageARM
+{
+   VkStructureType sType;
+   void *pNext;
+   /* Device memory per memory heap, indexed like VkPhysicalDeviceMemoryProperties::memoryHeaps. */
+   VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS];
+   /* Device memory imported from dma-bufs the layer allocated, also counted in heapUsage. */
+   VkDeviceSize dmaBufUsage;
+   /* Host memory the layer allocated while creating the swapchains. */
+   VkDeviceSize hostUsage;
+} VkSwapchainMemoryUsageARM;
+
+/**
+ * Get the memory held by the layer for a swapchain, or for all the swapchains of the device if swapchain is
+ * VK_NULL_HANDLE.
+ *
+ * If VK_EXT_memory_budget is enabled on the device, a VkPhysicalDeviceMemoryBudgetPropertiesEXT chained to
+ * pMemoryUsage is filled as by vkGetPhysicalDeviceMemoryProperties2.
+ */
+typedef VkResult(VKAPI_PTR *PFN_vkGetSwapchainMemoryUsageARM)(VkDevice device, VkSwapchainKHR swapchain,
+                                                               VkSwapchainMemoryUsageARM *pMemoryUsage);
+
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkGetSwapchainMemoryUsageARM(VkDevice device, VkSwapchainKHR swapchain,
+                                       VkSwapchainMemoryUsageARM *pMemoryUsage) VWL_API_POST;
+
+/* Layer specific latency markers and frame pacing, letting applications start each frame just in time. */
+
+/* Placeholder. Layer specific structure type. */
+#define VK_STRUCTURE_TYPE_LATENCY_MARKER_INFO_ARM ((VkStructureType)1000999003)
+
+/**
+ * Points of a frame the application reports to the layer, in the order they happen.
+ */
+typedef enum VkLatencyMarkerARM
+{
+   /* The application starts simulating the frame, e.g. processing the input. */
+   VK_LATENCY_MARKER_SIMULATION_START_ARM = 0,
+   /* The application starts submitting the rendering of the frame to the GPU. */
+   VK_LATENCY_MARKER_RENDER_SUBMIT_ARM = 1,
+   /* The application is about to present the frame. */
+   VK_LATENCY_MARKER_PRESENT_ARM = 2,
+} VkLatencyMarkerARM;
+
+typedef struct VkLatencyMarkerInfoARM
+{
+   VkStructureType sType;
+   const void *pNext;
+   VkLatencyMarkerARM marker;
+} VkLatencyMarkerInfoARM;
+
+typedef void(VKAPI_PTR *PFN_vkSetLatencyMarkerARM)(VkDevice device, VkSwapchainKHR swapchain,
+                                                    const VkLatencyMarkerInfoARM *pMarkerInfo);
+
+/**
+ * Wait until the optimal time to start the next frame presented to the swapchain, or for at most timeout
+ * nanoseconds. The time is estimated from how long the recent frames took, from their simulation start (or from
+ * vkAcquireNextImageKHR when no marker is given) until their rendering completed, and from the rate the images are
+ * presented at. The frame then completes just before the presentation engine can take it, instead of waiting in the
+ * queue of presents.
+ *
+ * Returns VK_SUCCESS, or VK_TIMEOUT if the optimal start is further than timeout away.
+ */
+typedef VkResult(VKAPI_PTR *PFN_vkLatencySleepARM)(VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout);
+
+VWL_VKAPI_CALL(void)
+wsi_layer_vkSetLatencyMarkerARM(VkDevice device, VkSwapchainKHR swapchain,
+                                const VkLatencyMarkerInfoARM *pMarkerInfo) VWL_API_POST;
+
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkLatencySleepARM(VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout) VWL_API_POST;
+
+/* Layer specific capture of the frames presented to headless swapchains. */
+
+/* Placeholders. Layer specific structure types. */
+#define VK_STRUCTURE_TYPE_SWAPCHAIN_FRAME_CAPTURE_CREATE_INFO_ARM ((VkStructureType)1000999001)
+#define VK_STRUCTURE_TYPE_SWAPCHAIN_CAPTURED_FRAME_ARM ((VkStructureType)1000999002)
+
+/**
+ * A frame presented to a swapchain, tightly packed in the swapchain image format.
+ */
+typedef struct VkSwapchainCapturedFrameARM
+{
+   VkStructureType sType;
+   const void *pNext;
+   uint32_t imageIndex;
+   /* Present id of the presentation, or 0 if it has none. */
+   uint64_t presentId;
+   /* CLOCK_MONOTONIC time the frame was presented at, in nanoseconds. */
+   uint64_t presentTime;
+   VkExtent2D extent;
+   VkFormat format;
+   uint32_t rowPitch;
+   VkDeviceSize size;
+   /* Contents of the frame, only valid until the callback returns. */
+   const void *pData;
+} VkSwapchainCapturedFrameARM;
+
+typedef void(VKAPI_PTR *PFN_vkSwapchainFrameCapturedARM)(const VkSwapchainCapturedFrameARM *pFrame, void *pUserData);
+
+/**
+ * Chained to VkSwapchainCreateInfoKHR to receive the frames presented to a headless swapchain. The callback is called
+ * on the presentation thread of the swapchain, so it should hand the frame over rather than process it.
+ */
+typedef struct VkSwapchainFrameCaptureCreateInfoARM
+{
+   VkStructureType sType;
+   const void *pNext;
+   PFN_vkSwapchainFrameCapturedARM pfnFrameCaptured;
+   void *pUserData;
+} VkSwapchainFrameCaptureCreateInfoARM;
+
+/* Layer specific destination extent of scaled presents, for surfaces whose extent is defined by the swapchain. */
+
+/* Placeholder. Layer specific structure type. */
+#define VK_STRUCTURE_TYPE_SWAPCHAIN_SCALED_EXTENT_CREATE_INFO_ARM ((VkStructureType)1000999005)
+
+/**
+ * Chained to VkSwapchainCreateInfoKHR together with a VkSwapchainPresentScalingCreateInfoEXT requesting
+ * VK_PRESENT_SCALING_STRETCH_BIT_EXT. The presentation engine stretches the swapchain images to scaledExtent, which
+ * then becomes the extent of the surface. On Wayland this is the wp_viewporter destination size of the surface.
+ */
+typedef struct VkSwapchainScaledExtentCreateInfoARM
+{
+   VkStructureType sType;
+   const void *pNext;
+   VkExtent2D scaledExtent;
+} VkSwapchainScaledExtentCreateInfoARM;
+
+/* Layer specific dump of the latest presentation events of a device. */
+
+/**
+ * Write the latest presentation events of the swapchains of device to the file at pPath, or to the file given by the
+ * flight_recorder_dir setting if pPath is NULL. The format of the file is described in the README.
+ *
+ * Returns VK_ERROR_FEATURE_NOT_PRESENT if the flight_recorder setting is disabled and
+ * VK_ERROR_INITIALIZATION_FAILED if the file cannot be written.
+ */
+typedef VkResult(VKAPI_PTR *PFN_vkDumpFlightRecorderARM)(VkDevice device, const char *pPath);
+
+VWL_VKAPI_CALL(VkResult)
+wsi_layer_vkDumpFlightRecorderARM(VkDevice device, const char *pPath) VWL_API_POST;
+
 #endif
\ No newline at end of file
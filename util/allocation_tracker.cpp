@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file allocation_tracker.cpp
+ *
+ * @brief Contains the implementation of the counters of the memory allocations made by the layer.
+ */
+
+#include "allocation_tracker.hpp"
+#include "log.hpp"
+
+#include <cassert>
+#include <cinttypes>
+
+namespace util
+{
+
+std::atomic<uint64_t> allocation_tracker::s_allocation_count{ 0 };
+std::atomic<uint64_t> allocation_tracker::s_allocation_bytes{ 0 };
+std::atomic<uint64_t> allocation_tracker::s_device_allocation_count{ 0 };
+std::atomic<uint64_t> allocation_tracker::s_device_allocation_bytes{ 0 };
+std::atomic<uint64_t> allocation_tracker::s_frame_allocation_count{ 0 };
+
+/* Name of the innermost frame scope of the thread, or nullptr outside of frame scopes. */
+static thread_local const char *current_frame_scope = nullptr;
+
+/* Number of allocations made by the thread inside frame scopes. */
+static thread_local uint64_t thread_frame_allocation_count = 0;
+
+allocation_tracker::frame_scope::frame_scope(const char *name)
+   : m_previous_name{ current_frame_scope }
+   , m_start_count{ thread_frame_allocation_count }
+{
+   current_frame_scope = name;
+}
+
+allocation_tracker::frame_scope::~frame_scope()
+{
+   current_frame_scope = m_previous_name;
+}
+
+uint64_t allocation_tracker::frame_scope::get_allocation_count() const
+{
+   return thread_frame_allocation_count - m_start_count;
+}
+
+void allocation_tracker::report_frame_allocation(const char *kind, uint64_t size)
+{
+   if (current_frame_scope != nullptr)
+   {
+      thread_frame_allocation_count++;
+      s_frame_allocation_count.fetch_add(1, std::memory_order_relaxed);
+      WSI_LOG_ERROR("Allocation of %" PRIu64 " bytes of %s memory in the per-frame scope %s.", size, kind,
+                    current_frame_scope);
+      assert(!"Allocation in a per-frame scope");
+   }
+}
+
+void allocation_tracker::record_allocation(size_t size)
+{
+   s_allocation_count.fetch_add(1, std::memory_order_relaxed);
+   s_allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+   report_frame_allocation("host", size);
+}
+
+void allocation_tracker::record_device_allocation(uint64_t size)
+{
+   s_device_allocation_count.fetch_add(1, std::memory_order_relaxed);
+   s_device_allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+   report_frame_allocation("device", size);
+}
+
+void allocation_tracker::print_summary()
+{
+   WSI_LOG_INFO("WSI layer allocations: count %" PRIu64 " bytes %" PRIu64 " device_count %" PRIu64
+                " device_bytes %" PRIu64 " per_frame %" PRIu64,
+                s_allocation_count.load(std::memory_order_relaxed), s_allocation_bytes.load(std::memory_order_relaxed),
+                s_device_allocation_count.load(std::memory_order_relaxed),
+                s_device_allocation_bytes.load(std::memory_order_relaxed),
+                s_frame_allocation_count.load(std::memory_order_relaxed));
+}
+
+} /* namespace util */
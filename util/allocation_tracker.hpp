@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file allocation_tracker.hpp
+ *
+ * @brief Contains the counters of the host and device memory allocations made by the layer.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "helpers.hpp"
+
+#ifndef WSI_ALLOCATION_TRACKING
+#define WSI_ALLOCATION_TRACKING 0
+#endif
+
+namespace util
+{
+
+/**
+ * @brief Counts the host allocations made through @ref allocator and the device memory allocated or imported by the
+ * layer, and the ones made inside per-frame scopes.
+ *
+ * Only built with ENABLE_ALLOCATION_TRACKING. Once a swapchain has presented its first frames, acquiring and
+ * presenting its images is expected not to allocate. Code that runs for every frame is wrapped in a
+ * @ref frame_scope, and an allocation made while a thread is inside one is reported: it is logged and, in debug
+ * builds, asserts.
+ */
+class allocation_tracker
+{
+public:
+   /**
+    * @brief Marks the code that runs for every frame on the calling thread for as long as it exists.
+    */
+   class frame_scope : private noncopyable
+   {
+   public:
+      /**
+       * @param name Name of the scope reported with the allocations made inside it, must outlive the scope. A
+       *             nullptr name instead allows allocations until the scope is destroyed, for the work done once
+       *             inside a per-frame scope, such as the deferred allocation of a swapchain image.
+       */
+      explicit frame_scope(const char *name);
+      ~frame_scope();
+
+      /**
+       * @brief Get the number of allocations made inside this scope so far, including the nested scopes.
+       */
+      uint64_t get_allocation_count() const;
+
+   private:
+      const char *m_previous_name;
+      uint64_t m_start_count;
+   };
+
+   /**
+    * @brief Record an allocation or a reallocation.
+    *
+    * @param size Size of the allocation in bytes.
+    */
+   static void record_allocation(size_t size);
+
+   /**
+    * @brief Record device memory allocated or imported by the layer.
+    *
+    * @param size Size of the memory in bytes.
+    */
+   static void record_device_allocation(uint64_t size);
+
+   /**
+    * @brief Log the number of allocations made so far at the info level.
+    */
+   static void print_summary();
+
+private:
+   static void report_frame_allocation(const char *kind, uint64_t size);
+
+   static std::atomic<uint64_t> s_allocation_count;
+   static std::atomic<uint64_t> s_allocation_bytes;
+   static std::atomic<uint64_t> s_device_allocation_count;
+   static std::atomic<uint64_t> s_device_allocation_bytes;
+   static std::atomic<uint64_t> s_frame_allocation_count;
+};
+
+} /* namespace util */
+
+#if WSI_ALLOCATION_TRACKING
+#define WSI_TRACK_ALLOCATION(size) ::util::allocation_tracker::record_allocation(size)
+#define WSI_TRACK_DEVICE_ALLOCATION(size) ::util::allocation_tracker::record_device_allocation(size)
+#define WSI_FRAME_ALLOCATION_SCOPE(name) ::util::allocation_tracker::frame_scope frame_allocation_scope{ name }
+#define WSI_SETUP_ALLOCATION_SCOPE() ::util::allocation_tracker::frame_scope setup_allocation_scope{ nullptr }
+#else
+#define WSI_TRACK_ALLOCATION(size) \
+   do                              \
+   {                               \
+   } while (0)
+#define WSI_TRACK_DEVICE_ALLOCATION(size) \
+   do                                     \
+   {                                      \
+   } while (0)
+#define WSI_FRAME_ALLOCATION_SCOPE(name) \
+   do                                    \
+   {                                     \
+   } while (0)
+#define WSI_SETUP_ALLOCATION_SCOPE() \
+   do                                \
+   {                                 \
+   } while (0)
+#endif
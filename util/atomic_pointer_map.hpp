@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "custom_allocator.hpp"
+
+namespace util
+{
+
+/**
+ * @brief Map from pointer keys to object pointers with wait-free lookups.
+ *
+ * The map is an open addressing hash table with linear probing. @ref find may be called concurrently with any other
+ * operation and never blocks: it performs a bounded number of atomic loads. @ref insert and @ref erase must be
+ * serialized by the caller, typically with a mutex that is only taken when objects are created or destroyed.
+ *
+ * Erased slots are marked as deleted rather than emptied when lookups of other keys may need to probe past them.
+ * Deleted slots are reused by later insertions.
+ *
+ * When an insertion would fill more than half of the table, the writer copies the keys into a table twice as large
+ * and publishes it atomically. Lookups that started on the previous table finish on it, so the previous tables are
+ * only freed with the map. They take less memory than the current table altogether.
+ *
+ * A lookup is only guaranteed to find a key that was inserted before it started and is not erased while it runs,
+ * which matches how the layer uses the dispatchable objects of the application. A lookup racing with the removal of
+ * its key returns the object or nullptr, never the object of a key inserted in the freed slot.
+ *
+ * @tparam Value Type of the objects the map points to.
+ */
+template <typename Value>
+class atomic_pointer_map
+{
+public:
+   /**
+    * @brief Construct an empty map, the table is allocated by the first insertion.
+    *
+    * @param allocator        The allocator for the tables.
+    * @param initial_capacity Number of slots of the first table, must be a power of two.
+    */
+   explicit atomic_pointer_map(const util::allocator &allocator, std::size_t initial_capacity = 16)
+      : m_allocator(allocator)
+      , m_initial_capacity(initial_capacity)
+   {
+      assert(initial_capacity != 0 && (initial_capacity & (initial_capacity - 1)) == 0);
+   }
+
+   ~atomic_pointer_map()
+   {
+      table *current = m_table.load(std::memory_order_relaxed);
+      while (current != nullptr)
+      {
+         table *previous = current->previous;
+         destroy_table(current);
+         current = previous;
+      }
+   }
+
+   atomic_pointer_map(const atomic_pointer_map &) = delete;
+   atomic_pointer_map &operator=(const atomic_pointer_map &) = delete;
+
+   /**
+    * @brief Find the object associated with a key.
+    *
+    * @param key The key to look up.
+    * @return pointer to the object, or nullptr if the key is not in the map.
+    */
+   Value *find(const void *key) const
+   {
+      const table *current = m_table.load(std::memory_order_acquire);
+      if (current == nullptr)
+      {
+         return nullptr;
+      }
+
+      const uintptr_t target = reinterpret_cast<uintptr_t>(key);
+      const std::size_t mask = current->capacity - 1;
+      std::size_t index = hash(target, mask);
+      for (std::size_t i = 0; i < current->capacity; i++, index = (index + 1) & mask)
+      {
+         const slot &entry = current->slots[index];
+         const uintptr_t slot_key = entry.key.load(std::memory_order_acquire);
+         if (slot_key == target)
+         {
+            /* The slot may be erased and reused by another key while the value is loaded, in which case the value
+             * belongs to that key. Check that the key is still there once the value is loaded. */
+            Value *value = entry.value.load(std::memory_order_acquire);
+            return entry.key.load(std::memory_order_relaxed) == target ? value : nullptr;
+         }
+         else if (slot_key == empty_key)
+         {
+            break;
+         }
+      }
+
+      return nullptr;
+   }
+
+   /**
+    * @brief Associate an object with a key that is not in the map.
+    *
+    * @param key   The key, which must not be nullptr.
+    * @param value The object to associate with the key.
+    * @return true on success, false if a larger table could not be allocated.
+    */
+   bool insert(const void *key, Value *value)
+   {
+      table *current = m_table.load(std::memory_order_relaxed);
+      if (current == nullptr || 2 * (current->used + 1) > current->capacity)
+      {
+         current = grow(current);
+         if (current == nullptr)
+         {
+            return false;
+         }
+      }
+
+      insert_slot(*current, reinterpret_cast<uintptr_t>(key), value);
+      return true;
+   }
+
+   /**
+    * @brief Remove a key from the map.
+    *
+    * @param key The key to remove.
+    * @return the object that was associated with the key, or nullptr if the key is not in the map.
+    */
+   Value *erase(const void *key)
+   {
+      table *current = m_table.load(std::memory_order_relaxed);
+      if (current == nullptr)
+      {
+         return nullptr;
+      }
+
+      const uintptr_t target = reinterpret_cast<uintptr_t>(key);
+      const std::size_t mask = current->capacity - 1;
+      std::size_t index = hash(target, mask);
+      for (std::size_t i = 0; i < current->capacity; i++, index = (index + 1) & mask)
+      {
+         const uintptr_t slot_key = current->slots[index].key.load(std::memory_order_relaxed);
+         if (slot_key == target)
+         {
+            Value *value = current->slots[index].value.load(std::memory_order_relaxed);
+            release_slot(*current, index);
+            return value;
+         }
+         else if (slot_key == empty_key)
+         {
+            break;
+         }
+      }
+
+      return nullptr;
+   }
+
+private:
+   static constexpr uintptr_t empty_key = 0;
+   static constexpr uintptr_t deleted_key = UINTPTR_MAX;
+
+   struct slot
+   {
+      std::atomic<uintptr_t> key{ empty_key };
+      std::atomic<Value *> value{ nullptr };
+   };
+
+   struct table
+   {
+      std::size_t capacity{ 0 };
+      /* Number of slots that are not empty, including the deleted ones. Only accessed by the writer. */
+      std::size_t used{ 0 };
+      slot *slots{ nullptr };
+      /* Table this one replaced, which lookups that started before the replacement may still be reading. */
+      table *previous{ nullptr };
+   };
+
+   static std::size_t hash(uintptr_t key, std::size_t mask)
+   {
+      /* Keys are pointers to aligned structures, drop the low bits and mix the rest with a Fibonacci hash. */
+      const uint64_t mixed = static_cast<uint64_t>(key >> 4) * UINT64_C(0x9e3779b97f4a7c15);
+      return static_cast<std::size_t>(mixed >> 32) & mask;
+   }
+
+   void destroy_table(table *old_table)
+   {
+      m_allocator.destroy(old_table->capacity, old_table->slots);
+      m_allocator.destroy(1, old_table);
+   }
+
+   /**
+    * @brief Publish a table twice as large as @p current with the keys of @p current.
+    *
+    * @return The new table, or nullptr if it could not be allocated.
+    */
+   table *grow(table *current)
+   {
+      table *new_table = m_allocator.create<table>(1);
+      if (new_table == nullptr)
+      {
+         return nullptr;
+      }
+
+      new_table->capacity = current != nullptr ? 2 * current->capacity : m_initial_capacity;
+      new_table->slots = m_allocator.create<slot>(new_table->capacity);
+      if (new_table->slots == nullptr)
+      {
+         m_allocator.destroy(1, new_table);
+         return nullptr;
+      }
+
+      if (current != nullptr)
+      {
+         for (std::size_t i = 0; i < current->capacity; i++)
+         {
+            const uintptr_t slot_key = current->slots[i].key.load(std::memory_order_relaxed);
+            if (slot_key != empty_key && slot_key != deleted_key)
+            {
+               insert_slot(*new_table, slot_key, current->slots[i].value.load(std::memory_order_relaxed));
+            }
+         }
+      }
+
+      /* The previous table is no longer written to, so lookups still reading it see the keys it had. */
+      new_table->previous = current;
+      m_table.store(new_table, std::memory_order_release);
+      return new_table;
+   }
+
+   static void insert_slot(table &target_table, uintptr_t key, Value *value)
+   {
+      const std::size_t mask = target_table.capacity - 1;
+      std::size_t index = hash(key, mask);
+      for (std::size_t i = 0; i < target_table.capacity; i++, index = (index + 1) & mask)
+      {
+         const uintptr_t slot_key = target_table.slots[index].key.load(std::memory_order_relaxed);
+         if (slot_key == empty_key || slot_key == deleted_key)
+         {
+            if (slot_key == empty_key)
+            {
+               target_table.used++;
+            }
+
+            /* Publish the value before the key, lookups load the key with acquire semantics. */
+            target_table.slots[index].value.store(value, std::memory_order_relaxed);
+            target_table.slots[index].key.store(key, std::memory_order_release);
+            return;
+         }
+      }
+
+      /* The table is never more than half full. */
+      assert(false);
+   }
+
+   /**
+    * @brief Mark a slot as deleted, or as empty when no probe sequence of a key in the map goes past it.
+    *
+    * A slot followed by an empty slot cannot be in the middle of the probe sequence of any key in the map, so it can
+    * be emptied, and so can the deleted slots preceding it. This keeps lookups of keys that are not in the map short
+    * after many insertions and removals.
+    */
+   static void release_slot(table &target_table, std::size_t index)
+   {
+      const std::size_t mask = target_table.capacity - 1;
+      if (target_table.slots[(index + 1) & mask].key.load(std::memory_order_relaxed) != empty_key)
+      {
+         target_table.slots[index].key.store(deleted_key, std::memory_order_release);
+         return;
+      }
+
+      for (std::size_t i = 0; i < target_table.capacity; i++, index = (index - 1) & mask)
+      {
+         if (i != 0 && target_table.slots[index].key.load(std::memory_order_relaxed) != deleted_key)
+         {
+            break;
+         }
+         target_table.slots[index].key.store(empty_key, std::memory_order_release);
+         target_table.used--;
+      }
+   }
+
+   const util::allocator m_allocator;
+   const std::size_t m_initial_capacity;
+   std::atomic<table *> m_table{ nullptr };
+};
+
+} /* namespace util */
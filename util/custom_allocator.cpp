@@ -26,6 +26,10 @@
 #include "macros.hpp"
 #include <vulkan/vulkan.h>
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
 namespace util
 {
 
@@ -45,6 +49,24 @@ VWL_VKAPI_CALL(void) default_free(void *, void *pMemory) VWL_API_POST
    free(pMemory);
 }
 
+VWL_VKAPI_CALL(void *)
+arena_allocation(void *user_data, size_t size, size_t alignment, VkSystemAllocationScope scope) VWL_API_POST
+{
+   return static_cast<arena *>(user_data)->allocate(size, alignment, scope);
+}
+
+VWL_VKAPI_CALL(void *)
+arena_reallocation(void *user_data, void *original, size_t size, size_t alignment,
+                   VkSystemAllocationScope scope) VWL_API_POST
+{
+   return static_cast<arena *>(user_data)->reallocate(original, size, alignment, scope);
+}
+
+VWL_VKAPI_CALL(void) arena_free(void *user_data, void *memory) VWL_API_POST
+{
+   static_cast<arena *>(user_data)->free(memory);
+}
+
 const allocator &allocator::get_generic()
 {
    static allocator generic{ VK_SYSTEM_ALLOCATION_SCOPE_COMMAND, nullptr };
@@ -52,7 +74,7 @@ const allocator &allocator::get_generic()
 }
 
 allocator::allocator(const allocator &other, VkSystemAllocationScope new_scope, const VkAllocationCallbacks *callbacks)
-   : allocator{ new_scope, callbacks == nullptr ? other.get_original_callbacks() : callbacks }
+   : allocator{ new_scope, callbacks == nullptr ? other.get_inherited_callbacks() : callbacks }
 {
 }
 
@@ -75,7 +97,226 @@ allocator::allocator(VkSystemAllocationScope scope, const VkAllocationCallbacks
 
 const VkAllocationCallbacks *allocator::get_original_callbacks() const
 {
+   if (m_callbacks.pfnAllocation == arena_allocation)
+   {
+      return static_cast<const arena *>(m_callbacks.pUserData)->get_parent().get_original_callbacks();
+   }
    return m_callbacks.pfnAllocation == default_allocation ? nullptr : &m_callbacks;
 }
 
+const VkAllocationCallbacks *allocator::get_inherited_callbacks() const
+{
+   return m_callbacks.pfnAllocation == arena_allocation ? &m_callbacks : get_original_callbacks();
+}
+
+/* Size of the chunks the arena requests from its parent allocator, unless an allocation needs a larger one. */
+static constexpr size_t ARENA_CHUNK_SIZE = 4096;
+
+struct arena::chunk
+{
+   /** @brief Next chunk in the list of chunks of the arena. */
+   chunk *next;
+   /** @brief Size of the chunk, including this header. */
+   size_t size;
+   /** @brief Number of bytes used from the start of the chunk, including this header. */
+   size_t used;
+};
+
+/* Every allocation from a chunk is preceded by its size, so that it can be copied when reallocated. */
+using arena_allocation_header = size_t;
+
+static size_t get_arena_allocation_size(const void *memory)
+{
+   return *(reinterpret_cast<const arena_allocation_header *>(memory) - 1);
+}
+
+arena::arena(const allocator &parent, memory_usage *usage)
+   : m_parent{ parent }
+   , m_usage{ usage }
+{
+}
+
+arena::~arena()
+{
+   while (m_chunks != nullptr)
+   {
+      chunk *next = m_chunks->next;
+      if (m_usage != nullptr)
+      {
+         m_usage->remove_host_memory(m_chunks->size);
+      }
+      m_parent.m_callbacks.pfnFree(m_parent.m_callbacks.pUserData, m_chunks);
+      m_chunks = next;
+   }
+}
+
+allocator arena::get_allocator()
+{
+   VkAllocationCallbacks callbacks = {};
+   callbacks.pUserData = this;
+   callbacks.pfnAllocation = arena_allocation;
+   callbacks.pfnReallocation = arena_reallocation;
+   callbacks.pfnFree = arena_free;
+   return allocator{ m_parent.m_scope, &callbacks };
+}
+
+void arena::seal()
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   m_sealed.store(true, std::memory_order_release);
+}
+
+bool arena::owns(const void *memory) const
+{
+   const auto address = reinterpret_cast<uintptr_t>(memory);
+   for (const chunk *c = m_chunks; c != nullptr; c = c->next)
+   {
+      const auto start = reinterpret_cast<uintptr_t>(c);
+      if (address > start && address < start + c->size)
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+void *arena::allocate_locked(size_t size, size_t alignment)
+{
+   const size_t header_size = sizeof(arena_allocation_header);
+   if (alignment < alignof(arena_allocation_header))
+   {
+      alignment = alignof(arena_allocation_header);
+   }
+
+   for (int attempt = 0; attempt < 2; attempt++)
+   {
+      if (m_chunks != nullptr)
+      {
+         const auto start = reinterpret_cast<uintptr_t>(m_chunks);
+         const uintptr_t address = (start + m_chunks->used + header_size + alignment - 1) & ~(alignment - 1);
+         if (address - start <= m_chunks->size && size <= m_chunks->size - (address - start))
+         {
+            m_chunks->used = (address - start) + size;
+            *(reinterpret_cast<arena_allocation_header *>(address) - 1) = size;
+            m_last_allocation = reinterpret_cast<void *>(address);
+            return m_last_allocation;
+         }
+      }
+
+      if (attempt == 0)
+      {
+         /* The allocation does not fit in the current chunk, start a new one large enough for it. */
+         const size_t min_size = sizeof(chunk) + header_size + alignment + size;
+         if (min_size < size)
+         {
+            return nullptr;
+         }
+         const size_t chunk_size = std::max(ARENA_CHUNK_SIZE, min_size);
+         auto &cb = m_parent.m_callbacks;
+         void *memory = cb.pfnAllocation(cb.pUserData, chunk_size, alignof(std::max_align_t), m_parent.m_scope);
+         if (memory == nullptr)
+         {
+            return nullptr;
+         }
+         m_chunks = new (memory) chunk{ m_chunks, chunk_size, sizeof(chunk) };
+         if (m_usage != nullptr)
+         {
+            m_usage->add_host_memory(chunk_size);
+         }
+      }
+   }
+
+   return nullptr;
+}
+
+void *arena::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+   if (m_sealed.load(std::memory_order_acquire))
+   {
+      auto &cb = m_parent.m_callbacks;
+      return cb.pfnAllocation(cb.pUserData, size, alignment, scope);
+   }
+
+   std::lock_guard<std::mutex> lock(m_lock);
+   return allocate_locked(size, alignment);
+}
+
+void *arena::reallocate(void *original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+   if (original == nullptr)
+   {
+      return allocate(size, alignment, scope);
+   }
+   if (size == 0)
+   {
+      free(original);
+      return nullptr;
+   }
+
+   const bool sealed = m_sealed.load(std::memory_order_acquire);
+   if (sealed && !owns(original))
+   {
+      auto &cb = m_parent.m_callbacks;
+      return cb.pfnReallocation(cb.pUserData, original, size, alignment, scope);
+   }
+
+   size_t original_size = 0;
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (!owns(original))
+      {
+         auto &cb = m_parent.m_callbacks;
+         return cb.pfnReallocation(cb.pUserData, original, size, alignment, scope);
+      }
+
+      original_size = get_arena_allocation_size(original);
+      const auto start = reinterpret_cast<uintptr_t>(m_chunks);
+      const auto address = reinterpret_cast<uintptr_t>(original);
+      if (!sealed && original == m_last_allocation && size <= m_chunks->size - (address - start))
+      {
+         /* The most recent allocation is resized in place. */
+         m_chunks->used = (address - start) + size;
+         *(reinterpret_cast<arena_allocation_header *>(original) - 1) = size;
+         return original;
+      }
+   }
+
+   void *memory = allocate(size, alignment, scope);
+   if (memory != nullptr)
+   {
+      memcpy(memory, original, std::min(size, original_size));
+      free(original);
+   }
+   return memory;
+}
+
+void arena::free(void *memory)
+{
+   if (memory == nullptr)
+   {
+      return;
+   }
+
+   if (m_sealed.load(std::memory_order_acquire))
+   {
+      if (!owns(memory))
+      {
+         m_parent.m_callbacks.pfnFree(m_parent.m_callbacks.pUserData, memory);
+      }
+      return;
+   }
+
+   std::lock_guard<std::mutex> lock(m_lock);
+   if (!owns(memory))
+   {
+      m_parent.m_callbacks.pfnFree(m_parent.m_callbacks.pUserData, memory);
+   }
+   else if (memory == m_last_allocation)
+   {
+      /* Roll back the most recent allocation. The header and alignment padding before it are not reclaimed. */
+      m_chunks->used = reinterpret_cast<uintptr_t>(memory) - reinterpret_cast<uintptr_t>(m_chunks);
+      m_last_allocation = nullptr;
+   }
+}
+
 } /* namespace util */
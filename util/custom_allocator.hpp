@@ -29,10 +29,14 @@
 #include <cassert>
 #include <memory>
 #include <stdexcept>
+#include <atomic>
+#include <mutex>
 
 #include <vulkan/vulkan.h>
 
+#include "allocation_tracker.hpp"
 #include "helpers.hpp"
+#include "memory_usage.hpp"
 
 #pragma once
 
@@ -114,6 +118,94 @@ public:
 
    VkAllocationCallbacks m_callbacks{};
    VkSystemAllocationScope m_scope;
+
+private:
+   /**
+    * @brief Get the callbacks that allocators derived from this one use when they are given no callbacks.
+    */
+   const VkAllocationCallbacks *get_inherited_callbacks() const;
+};
+
+/**
+ * @brief Bump allocator for the allocations of an object that are released together when it is destroyed.
+ *
+ * Allocations made through the allocator returned by @ref get_allocator are carved out of chunks requested from the
+ * parent allocator, and freeing them does not return memory to the parent allocator, except for the most recent
+ * allocation which is rolled back. All the chunks are released together when the arena is destroyed, so the arena
+ * must outlive every object allocated from it.
+ *
+ * Once @ref seal is called, new allocations are forwarded to the parent allocator, so that allocations and frees made
+ * for every frame do not grow the arena. Allocators derived from the arena allocator without explicit callbacks keep
+ * using the arena, while @ref allocator::get_original_callbacks still returns the callbacks of the parent allocator
+ * to pass to Vulkan.
+ */
+class arena : private noncopyable
+{
+public:
+   /**
+    * @brief Construct an arena.
+    *
+    * @param parent The allocator the chunks of the arena and the allocations made after sealing come from.
+    * @param usage  Counters the chunks of the arena are recorded in as host memory, or nullptr. They must outlive the
+    *               arena.
+    */
+   arena(const allocator &parent, memory_usage *usage = nullptr);
+
+   ~arena();
+
+   /**
+    * @brief Get an allocator that allocates from the arena.
+    */
+   allocator get_allocator();
+
+   /**
+    * @brief Forward all the allocations made from now on to the parent allocator.
+    */
+   void seal();
+
+   /**
+    * @brief Get the parent allocator of the arena.
+    */
+   const allocator &get_parent() const
+   {
+      return m_parent;
+   }
+
+   /**
+    * @brief Implementation of the allocation callbacks of the arena allocator.
+    * @{
+    */
+   void *allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+   void *reallocate(void *original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+   void free(void *memory);
+   /** @} */
+
+private:
+   struct chunk;
+
+   /**
+    * @brief Check whether some memory was allocated from the chunks of the arena.
+    */
+   bool owns(const void *memory) const;
+
+   /**
+    * @brief Allocate from the chunks of the arena, adding a new chunk if needed.
+    * @note m_lock must be held.
+    */
+   void *allocate_locked(size_t size, size_t alignment);
+
+   const allocator m_parent;
+   memory_usage *const m_usage;
+   std::mutex m_lock;
+
+   /** @brief Set by @ref seal. The list of chunks is never modified once it is set. */
+   std::atomic<bool> m_sealed{ false };
+
+   /** @brief Chunks of the arena, the one allocations are made from first. */
+   chunk *m_chunks{ nullptr };
+
+   /** @brief Most recent allocation made from the arena, which can be rolled back. */
+   void *m_last_allocation{ nullptr };
 };
 
 /**
@@ -150,6 +242,7 @@ public:
       {
          throw std::bad_alloc();
       }
+      WSI_TRACK_ALLOCATION(size);
       auto &cb = m_alloc.m_callbacks;
       void *ret = cb.pfnAllocation(cb.pUserData, size, alignof(T), m_alloc.m_scope);
       if (ret == nullptr)
@@ -165,6 +258,7 @@ public:
       {
          throw std::bad_alloc();
       }
+      WSI_TRACK_ALLOCATION(size);
       auto &cb = m_alloc.m_callbacks;
       void *ret = cb.pfnReallocation(cb.pUserData, ptr, size, alignof(T), m_alloc.m_scope);
       if (ret == nullptr)
@@ -25,56 +25,151 @@
 #include "drm_utils.hpp"
 #include "format_table.h"
 
+#include <algorithm>
+#include <array>
+#include <iterator>
+
 namespace util
 {
 namespace drm
 {
 
-uint32_t vk_to_drm_format(VkFormat vk_format)
+namespace
+{
+
+struct format_pair
+{
+   uint32_t drm_format;
+   VkFormat vk_format;
+};
+
+#define FORMAT_PAIR(drm_format, nr_planes, bpp, vk_format) format_pair{ drm_format, vk_format },
+constexpr format_pair fourcc_formats[] = { FOURCC_FORMAT_TABLE(FORMAT_PAIR) };
+constexpr format_pair srgb_fourcc_formats[] = { SRGB_FOURCC_FORMAT_TABLE(FORMAT_PAIR) };
+#undef FORMAT_PAIR
+
+/* The Vulkan formats of the tables are core formats, whose values are small enough to index a table directly. */
+template <size_t N>
+constexpr size_t max_vk_format(const format_pair (&formats)[N])
 {
-   for (size_t i = 0; i < fourcc_format_table_len; i++)
+   size_t max_format = 0;
+   for (const auto &format : formats)
    {
-      if (vk_format == fourcc_format_table[i].vk_format)
-      {
-         return fourcc_format_table[i].drm_format;
-      }
+      max_format = std::max(max_format, static_cast<size_t>(format.vk_format));
    }
+   return max_format;
+}
 
-   for (size_t i = 0; i < srgb_fourcc_format_table_len; i++)
+constexpr size_t VK_FORMAT_TABLE_SIZE = std::max(max_vk_format(fourcc_formats), max_vk_format(srgb_fourcc_formats)) + 1;
+static_assert(VK_FORMAT_TABLE_SIZE <= 256, "Vulkan formats of the format tables must be core formats");
+
+using vk_to_drm_table_type = std::array<uint32_t, VK_FORMAT_TABLE_SIZE>;
+
+template <size_t N>
+constexpr void add_vk_to_drm_formats(vk_to_drm_table_type &table, const format_pair (&formats)[N])
+{
+   for (const auto &format : formats)
    {
-      if (vk_format == srgb_fourcc_format_table[i].vk_format)
+      const auto index = static_cast<size_t>(format.vk_format);
+      /* Earlier entries win, as they did in a linear search. */
+      if (format.vk_format != VK_FORMAT_UNDEFINED && table[index] == 0)
       {
-         return srgb_fourcc_format_table[i].drm_format;
+         table[index] = format.drm_format;
       }
    }
+}
 
-   return 0;
+/* DRM formats of the tables indexed by their Vulkan format. */
+constexpr vk_to_drm_table_type make_vk_to_drm_table()
+{
+   vk_to_drm_table_type table{};
+   add_vk_to_drm_formats(table, fourcc_formats);
+   add_vk_to_drm_formats(table, srgb_fourcc_formats);
+   return table;
 }
 
-VkFormat drm_to_vk_format(uint32_t drm_format)
+constexpr auto vk_to_drm_table = make_vk_to_drm_table();
+
+/*
+ * Perfect hash of the DRM formats of a table: (drm_format * multiplier) >> (32 - DRM_FORMAT_HASH_BITS) gives every
+ * format of the table its own slot. The multiplier is searched for at compile time.
+ */
+constexpr uint32_t DRM_FORMAT_HASH_BITS = 7;
+constexpr uint32_t DRM_FORMAT_HASH_SLOTS = 1u << DRM_FORMAT_HASH_BITS;
+
+constexpr uint32_t drm_format_hash(uint32_t drm_format, uint32_t multiplier)
+{
+   return (drm_format * multiplier) >> (32 - DRM_FORMAT_HASH_BITS);
+}
+
+template <size_t N>
+constexpr uint32_t find_drm_format_hash_multiplier(const format_pair (&formats)[N])
 {
-   for (size_t i = 0; i < fourcc_format_table_len; i++)
+   static_assert(N <= DRM_FORMAT_HASH_SLOTS / 2, "Too many DRM formats for the hash table");
+   /* Odd multipliers from the golden ratio onwards, one of the first few hundred is collision free. */
+   for (uint32_t multiplier = 0x9e3779b1u; multiplier != 0x9e3779b1u + 2 * 4096; multiplier += 2)
    {
-      if (drm_format == fourcc_format_table[i].drm_format)
+      bool used[DRM_FORMAT_HASH_SLOTS] = {};
+      bool collision = false;
+      for (size_t i = 0; i < N && !collision; i++)
+      {
+         const uint32_t slot = drm_format_hash(formats[i].drm_format, multiplier);
+         collision = used[slot];
+         used[slot] = true;
+      }
+      if (!collision)
       {
-         return fourcc_format_table[i].vk_format;
+         return multiplier;
       }
    }
-
-   return VK_FORMAT_UNDEFINED;
+   return 0;
 }
 
-VkFormat drm_to_vk_srgb_format(uint32_t drm_format)
+template <size_t N>
+struct drm_format_hash_table
 {
-   for (size_t i = 0; i < srgb_fourcc_format_table_len; i++)
+   constexpr explicit drm_format_hash_table(const format_pair (&formats)[N])
+      : multiplier{ find_drm_format_hash_multiplier(formats) }
+      , slots{}
    {
-      if (drm_format == srgb_fourcc_format_table[i].drm_format)
+      for (size_t i = 0; i < N; i++)
       {
-         return srgb_fourcc_format_table[i].vk_format;
+         slots[drm_format_hash(formats[i].drm_format, multiplier)] = formats[i];
       }
    }
 
-   return VK_FORMAT_UNDEFINED;
+   VkFormat find(uint32_t drm_format) const
+   {
+      const format_pair &slot = slots[drm_format_hash(drm_format, multiplier)];
+      /* Empty slots hold DRM format 0, which is not a valid fourcc. */
+      return (slot.drm_format == drm_format && drm_format != 0) ? slot.vk_format : VK_FORMAT_UNDEFINED;
+   }
+
+   uint32_t multiplier;
+   std::array<format_pair, DRM_FORMAT_HASH_SLOTS> slots;
+};
+
+constexpr drm_format_hash_table<std::size(fourcc_formats)> drm_to_vk_table{ fourcc_formats };
+constexpr drm_format_hash_table<std::size(srgb_fourcc_formats)> drm_to_vk_srgb_table{ srgb_fourcc_formats };
+static_assert(drm_to_vk_table.multiplier != 0 && drm_to_vk_srgb_table.multiplier != 0,
+              "No perfect hash found for the DRM formats");
+
+} /* namespace */
+
+uint32_t vk_to_drm_format(VkFormat vk_format)
+{
+   const auto index = static_cast<size_t>(vk_format);
+   return index < vk_to_drm_table.size() ? vk_to_drm_table[index] : 0;
+}
+
+VkFormat drm_to_vk_format(uint32_t drm_format)
+{
+   return drm_to_vk_table.find(drm_format);
+}
+
+VkFormat drm_to_vk_srgb_format(uint32_t drm_format)
+{
+   return drm_to_vk_srgb_table.find(drm_format);
 }
 
 /* Returns the number of planes represented by a fourcc format. */
@@ -120,5 +215,21 @@ uint32_t drm_fourcc_format_get_num_planes(uint32_t format)
    }
 }
 
+/* Returns how much a modifier compresses images, the higher the more, or 0 when it does not compress them.
+ * Fixed-rate compression is reported by the ICD, through VkImageCompressionPropertiesEXT, and ranks above the lossless
+ * compressed layouts. */
+uint32_t get_modifier_compression_rank(uint64_t modifier, VkImageCompressionFixedRateFlagsEXT fixed_rate_flags)
+{
+   if (fixed_rate_flags != 0)
+   {
+      /* Bit N is a rate of N + 1 bits per component, so the lowest bit set is the highest compression. */
+      return 2 + (31 - static_cast<uint32_t>(__builtin_ctz(fixed_rate_flags)));
+   }
+
+   const uint64_t vendor = modifier >> 56;
+   const uint64_t arm_type = (modifier >> 52) & 0xf;
+   return (vendor == DRM_FORMAT_MOD_VENDOR_ARM && arm_type == DRM_FORMAT_MOD_ARM_TYPE_AFBC) ? 1 : 0;
+}
+
 } // namespace drm
 } // namespace util
@@ -35,6 +35,51 @@
 
 #define NELEMS(x) (sizeof(x) / sizeof(x[0]))
 
+/*
+ * The format tables, as lists of X(drm_format, nr_planes, (bpp...), vk_format) entries. They are expanded into the
+ * fmt_spec arrays below, and into the lookup tables of the format conversions at compile time.
+ */
+#define FOURCC_FORMAT_TABLE(X)                                                                                       \
+   /* Supported R,G,B,A formats */                                                                                   \
+   X(DRM_FORMAT_RGB332, 1, (8, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                        \
+   X(DRM_FORMAT_BGR233, 1, (8, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                        \
+   X(DRM_FORMAT_XRGB4444, 1, (16, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_XBGR4444, 1, (16, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_RGBX4444, 1, (16, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_BGRX4444, 1, (16, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_ARGB4444, 1, (16, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_ABGR4444, 1, (16, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_RGBA4444, 1, (16, 0, 0, 0), VK_FORMAT_R4G4B4A4_UNORM_PACK16)                                         \
+   X(DRM_FORMAT_BGRA4444, 1, (16, 0, 0, 0), VK_FORMAT_B4G4R4A4_UNORM_PACK16)                                         \
+   X(DRM_FORMAT_XRGB1555, 1, (16, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_XBGR1555, 1, (16, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_RGBX5551, 1, (16, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_BGRX5551, 1, (16, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_ARGB1555, 1, (16, 0, 0, 0), VK_FORMAT_A1R5G5B5_UNORM_PACK16)                                         \
+   X(DRM_FORMAT_ABGR1555, 1, (16, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_RGBA5551, 1, (16, 0, 0, 0), VK_FORMAT_R5G5B5A1_UNORM_PACK16)                                         \
+   X(DRM_FORMAT_BGRA5551, 1, (16, 0, 0, 0), VK_FORMAT_B5G5R5A1_UNORM_PACK16)                                         \
+   X(DRM_FORMAT_RGB565, 1, (16, 0, 0, 0), VK_FORMAT_R5G6B5_UNORM_PACK16)                                             \
+   X(DRM_FORMAT_BGR565, 1, (16, 0, 0, 0), VK_FORMAT_B5G6R5_UNORM_PACK16)                                             \
+   X(DRM_FORMAT_RGB888, 1, (24, 0, 0, 0), VK_FORMAT_B8G8R8_UNORM)                                                    \
+   X(DRM_FORMAT_BGR888, 1, (24, 0, 0, 0), VK_FORMAT_R8G8B8_UNORM)                                                    \
+   X(DRM_FORMAT_XRGB8888, 1, (32, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_XBGR8888, 1, (32, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_RGBX8888, 1, (32, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_BGRX8888, 1, (32, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_ARGB8888, 1, (32, 0, 0, 0), VK_FORMAT_B8G8R8A8_UNORM)                                                \
+   X(DRM_FORMAT_ABGR8888, 1, (32, 0, 0, 0), VK_FORMAT_R8G8B8A8_UNORM)                                                \
+   X(DRM_FORMAT_RGBA8888, 1, (32, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   X(DRM_FORMAT_BGRA8888, 1, (32, 0, 0, 0), VK_FORMAT_UNDEFINED)                                                     \
+   /* X(DRM_FORMAT_ABGR2101010, 1, (32, 0, 0, 0), VK_FORMAT_A2B10G10R10_UNORM_PACK32) */
+
+#define SRGB_FOURCC_FORMAT_TABLE(X)                                                                                  \
+   X(DRM_FORMAT_ARGB8888, 1, (32, 0, 0, 0), VK_FORMAT_B8G8R8A8_SRGB)                                                 \
+   X(DRM_FORMAT_ABGR8888, 1, (32, 0, 0, 0), VK_FORMAT_R8G8B8A8_SRGB)
+
+/* Expands the bits per plane of a format table entry into an array initializer. */
+#define FMT_SPEC_BPP(bpp0, bpp1, bpp2, bpp3) { bpp0, bpp1, bpp2, bpp3 }
+
 typedef struct fmt_spec
 {
    uint32_t drm_format;
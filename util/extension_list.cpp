@@ -24,6 +24,7 @@
 
 #include "extension_list.hpp"
 #include "util/custom_allocator.hpp"
+#include "util/macros.hpp"
 #include <layer/private_data.hpp>
 #include <cstdio>
 #include <cstring>
@@ -35,9 +36,32 @@ namespace util
 extension_list::extension_list(const util::allocator &allocator)
    : m_alloc{ allocator }
    , m_ext_props(allocator)
+   , m_ext_names(allocator)
 {
 }
 
+VkResult extension_list::index_names(size_t first)
+{
+   if (m_ext_props.data() != m_indexed_props)
+   {
+      /* The names in the set refer to the previous storage. */
+      m_ext_names.clear();
+      first = 0;
+      m_indexed_props = m_ext_props.data();
+   }
+
+   for (size_t i = first; i < m_ext_props.size(); i++)
+   {
+      if (!m_ext_names.try_insert(std::string_view{ m_ext_props[i].extensionName }).has_value())
+      {
+         /* Make the next call add all the names again. */
+         m_indexed_props = nullptr;
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+   return VK_SUCCESS;
+}
+
 VkResult extension_list::add(const char *const *extensions, size_t count)
 {
    auto initial_size = m_ext_props.size();
@@ -66,23 +90,33 @@ VkResult extension_list::add(const char *const *extensions, size_t count)
          abort();
       }
    }
-   return VK_SUCCESS;
+   return index_names(initial_size);
 }
 
 VkResult extension_list::add(const char *const *extensions, size_t count, const char *const *extensions_subset,
                              size_t subset_count)
 {
+   util::unordered_set<std::string_view> subset(m_alloc);
+   if (!subset.try_reserve(subset_count))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   for (size_t subset_index = 0; subset_index < subset_count; ++subset_index)
+   {
+      if (!subset.try_insert(extensions_subset[subset_index]).has_value())
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
    util::vector<const char *> extensions_to_add(m_alloc);
    for (size_t ext_index = 0; ext_index < count; ++ext_index)
    {
-      for (size_t subset_index = 0; subset_index < subset_count; ++subset_index)
+      if (subset.find(extensions[ext_index]) != subset.end())
       {
-         if (!strcmp(extensions[ext_index], extensions_subset[subset_index]))
+         if (!extensions_to_add.try_push_back(extensions[ext_index]))
          {
-            if (!extensions_to_add.try_push_back(extensions[ext_index]))
-            {
-               return VK_ERROR_OUT_OF_HOST_MEMORY;
-            }
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
          }
       }
    }
@@ -104,6 +138,7 @@ VkResult extension_list::add(VkExtensionProperties ext_prop)
       {
          return VK_ERROR_OUT_OF_HOST_MEMORY;
       }
+      return index_names(m_ext_props.size() - 1);
    }
    return VK_SUCCESS;
 }
@@ -119,7 +154,7 @@ VkResult extension_list::add(const VkExtensionProperties *props, size_t count)
    {
       m_ext_props[initial_size + i] = props[i];
    }
-   return VK_SUCCESS;
+   return index_names(initial_size);
 }
 
 VkResult extension_list::add(const extension_list &ext_list)
@@ -163,14 +198,14 @@ bool extension_list::contains(const extension_list &req) const
 
 bool extension_list::contains(const char *extension_name) const
 {
-   for (const auto &p : m_ext_props)
+   if (m_indexed_props != m_ext_props.data())
    {
-      if (strcmp(p.extensionName, extension_name) == 0)
-      {
-         return true;
-      }
+      /* Indexing the names ran out of memory, fall back to comparing them. */
+      return std::any_of(m_ext_props.begin(), m_ext_props.end(), [extension_name](const VkExtensionProperties &p) {
+         return strcmp(p.extensionName, extension_name) == 0;
+      });
    }
-   return false;
+   return m_ext_names.find(extension_name) != m_ext_names.end();
 }
 
 void extension_list::remove(const char *ext)
@@ -178,5 +213,9 @@ void extension_list::remove(const char *ext)
    m_ext_props.erase(std::remove_if(m_ext_props.begin(), m_ext_props.end(), [&ext](VkExtensionProperties ext_prop) {
       return (strcmp(ext_prop.extensionName, ext) == 0);
    }));
+
+   /* The following names have moved, so add them all again. */
+   m_indexed_props = nullptr;
+   UNUSED(index_names(0));
 }
 } // namespace util
@@ -25,9 +25,11 @@
 
 #include "custom_allocator.hpp"
 #include "helpers.hpp"
+#include "unordered_set.hpp"
 
 #include <vector>
 #include <algorithm>
+#include <string_view>
 
 #include <vulkan/vulkan.h>
 
@@ -37,6 +39,9 @@ namespace util
 /**
  * @brief A helper class for storing a vector of extension names
  *
+ * The names are also kept in a hash set, so checking whether the list contains an extension does not compare it
+ * against every name of the list.
+ *
  * @note This class does not store the extension versions.
  */
 class extension_list : private noncopyable
@@ -105,11 +110,30 @@ public:
    VkResult add(const char *const *extensions, size_t count, const char *const *extensions_subset, size_t subset_count);
 
 private:
+   /**
+    * @brief Add the names of the extensions from @p first onwards to the hash set.
+    *
+    * All the names are added again if the extensions have been moved since they were last added.
+    *
+    * @return VK_SUCCESS on success, VK_ERROR_OUT_OF_HOST_MEMORY otherwise.
+    */
+   VkResult index_names(size_t first);
+
    util::allocator m_alloc;
 
    /**
     * @note We are using VkExtensionProperties to store the extension name only
     */
    util::vector<VkExtensionProperties> m_ext_props;
+
+   /**
+    * @brief Names of the extensions, referring to the strings in m_ext_props.
+    */
+   util::unordered_set<std::string_view> m_ext_names;
+
+   /**
+    * @brief Storage of m_ext_props when the names were added to m_ext_names, which refer to it.
+    */
+   const VkExtensionProperties *m_indexed_props{ nullptr };
 };
 } // namespace util
@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+
+#include "custom_allocator.hpp"
+#include "helpers.hpp"
+
+namespace util
+{
+
+/**
+ * @brief Open addressing hash map using a Vulkan custom allocator.
+ *
+ * Entries are stored inline in a single array and looked up with linear probing, so small maps are a single
+ * allocation and lookups do not chase pointers. Like @ref unordered_map, operations that can allocate report out of
+ * memory errors instead of throwing.
+ *
+ * Erasing shifts the following entries of the probe sequence back, so there are no deleted markers, but it
+ * invalidates all iterators. Inserting invalidates all iterators if the map grows.
+ *
+ * @tparam Key   Type of the keys.
+ * @tparam Value Type of the values.
+ * @tparam Hash  Hash function of the keys. Its result is mixed, so identity hashes of pointers are fine.
+ * @tparam Equal Equality comparison of the keys.
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key>>
+class flat_unordered_map : private noncopyable
+{
+   using slot = std::optional<std::pair<Key, Value>>;
+
+public:
+   using value_type = std::pair<Key, Value>;
+   using size_type = size_t;
+
+   /**
+    * @brief Iterator over the entries of the map.
+    */
+   template <typename MapType, typename EntryType>
+   class iterator_base
+   {
+   public:
+      iterator_base(MapType *map, size_t index)
+         : m_map{ map }
+         , m_index{ index }
+      {
+         skip_empty();
+      }
+
+      EntryType &operator*() const
+      {
+         return *m_map->m_slots[m_index];
+      }
+
+      EntryType *operator->() const
+      {
+         return &*m_map->m_slots[m_index];
+      }
+
+      iterator_base &operator++()
+      {
+         m_index++;
+         skip_empty();
+         return *this;
+      }
+
+      bool operator==(const iterator_base &other) const
+      {
+         return m_index == other.m_index;
+      }
+
+      bool operator!=(const iterator_base &other) const
+      {
+         return m_index != other.m_index;
+      }
+
+   private:
+      friend class flat_unordered_map;
+
+      void skip_empty()
+      {
+         while (m_index < m_map->m_capacity && !m_map->m_slots[m_index].has_value())
+         {
+            m_index++;
+         }
+      }
+
+      MapType *m_map;
+      size_t m_index;
+   };
+
+   using iterator = iterator_base<flat_unordered_map, value_type>;
+   using const_iterator = iterator_base<const flat_unordered_map, const value_type>;
+
+   /**
+    * @brief Construct a new flat unordered map object with a custom allocator.
+    *
+    * @param allocator The allocator that will be used.
+    */
+   explicit flat_unordered_map(const util::allocator &allocator)
+      : m_allocator{ allocator }
+   {
+   }
+
+   ~flat_unordered_map()
+   {
+      if (m_slots != nullptr)
+      {
+         m_allocator.destroy(m_capacity, m_slots);
+      }
+   }
+
+   iterator begin()
+   {
+      return iterator{ this, 0 };
+   }
+
+   iterator end()
+   {
+      return iterator{ this, m_capacity };
+   }
+
+   const_iterator begin() const
+   {
+      return const_iterator{ this, 0 };
+   }
+
+   const_iterator end() const
+   {
+      return const_iterator{ this, m_capacity };
+   }
+
+   size_type size() const
+   {
+      return m_size;
+   }
+
+   bool empty() const
+   {
+      return m_size == 0;
+   }
+
+   /**
+    * @brief Find the entry of a key.
+    *
+    * @param key The key to look up.
+    * @return iterator to the entry, or end() if the key is not in the map.
+    */
+   iterator find(const Key &key)
+   {
+      return iterator{ this, find_index(key) };
+   }
+
+   const_iterator find(const Key &key) const
+   {
+      return const_iterator{ this, find_index(key) };
+   }
+
+   /**
+    * @brief Like std::unordered_map.insert but doesn't throw on out of memory errors.
+    *
+    * @param value The value to insert in the map.
+    * @return std::optional<std::pair<iterator, bool>> If successful, the optional contains an iterator to the entry of
+    *         the key and whether it was inserted, as for std::unordered_map.insert. If out of memory, the function
+    *         returns std::nullopt.
+    */
+   std::optional<std::pair<iterator, bool>> try_insert(const value_type &value)
+   {
+      size_t index = find_index(value.first);
+      if (index != m_capacity)
+      {
+         return std::make_pair(iterator{ this, index }, false);
+      }
+
+      /* Keep the load factor at or below 3/4 so that probe sequences stay short. */
+      if ((m_size + 1) * 4 > m_capacity * 3 && !try_rehash(m_capacity == 0 ? MIN_CAPACITY : m_capacity * 2))
+      {
+         return std::nullopt;
+      }
+
+      for (index = home_index(value.first); m_slots[index].has_value(); index = (index + 1) & (m_capacity - 1))
+      {
+      }
+      m_slots[index].emplace(value);
+      m_size++;
+      return std::make_pair(iterator{ this, index }, true);
+   }
+
+   /**
+    * @brief Like std::unordered_map.reserve but doesn't throw on out of memory errors.
+    *
+    * @param count The number of entries to make room for.
+    * @return true If the container was resized successfuly.
+    * @return false If the host has run out of memory
+    */
+   bool try_reserve(size_type count)
+   {
+      size_t capacity = MIN_CAPACITY;
+      while (capacity * 3 < count * 4)
+      {
+         capacity *= 2;
+      }
+      return capacity <= m_capacity || try_rehash(capacity);
+   }
+
+   /**
+    * @brief Erase an entry of the map.
+    * @note This invalidates all the iterators of the map.
+    */
+   void erase(iterator it)
+   {
+      assert(it.m_map == this && it.m_index < m_capacity);
+      erase_index(it.m_index);
+   }
+
+   /**
+    * @brief Erase the entry of a key, if any.
+    * @note This invalidates all the iterators of the map.
+    *
+    * @return the number of entries erased.
+    */
+   size_type erase(const Key &key)
+   {
+      size_t index = find_index(key);
+      if (index == m_capacity)
+      {
+         return 0;
+      }
+      erase_index(index);
+      return 1;
+   }
+
+   void clear()
+   {
+      for (size_t i = 0; i < m_capacity; i++)
+      {
+         m_slots[i].reset();
+      }
+      m_size = 0;
+   }
+
+private:
+   static constexpr size_t MIN_CAPACITY = 8;
+
+   size_t home_index(const Key &key) const
+   {
+      const uint64_t mixed = static_cast<uint64_t>(Hash{}(key)) * UINT64_C(0x9e3779b97f4a7c15);
+      return static_cast<size_t>(mixed >> 32) & (m_capacity - 1);
+   }
+
+   /**
+    * @brief Get the index of the slot of a key, or m_capacity if the key is not in the map.
+    */
+   size_t find_index(const Key &key) const
+   {
+      if (m_size == 0)
+      {
+         return m_capacity;
+      }
+
+      for (size_t index = home_index(key); m_slots[index].has_value(); index = (index + 1) & (m_capacity - 1))
+      {
+         if (Equal{}(m_slots[index]->first, key))
+         {
+            return index;
+         }
+      }
+      return m_capacity;
+   }
+
+   void erase_index(size_t index)
+   {
+      m_slots[index].reset();
+      m_size--;
+
+      /* Shift back the entries that follow in the probe sequence, so lookups do not stop at the hole. */
+      const size_t mask = m_capacity - 1;
+      for (size_t next = (index + 1) & mask; m_slots[next].has_value(); next = (next + 1) & mask)
+      {
+         const size_t home = home_index(m_slots[next]->first);
+         /* The entry can move to the hole if the hole is cyclically between its home slot and its slot. */
+         if (((next - home) & mask) >= ((next - index) & mask))
+         {
+            m_slots[index].emplace(std::move(*m_slots[next]));
+            m_slots[next].reset();
+            index = next;
+         }
+      }
+   }
+
+   bool try_rehash(size_t capacity)
+   {
+      slot *slots = m_allocator.create<slot>(capacity);
+      if (slots == nullptr)
+      {
+         return false;
+      }
+
+      slot *old_slots = m_slots;
+      const size_t old_capacity = m_capacity;
+      m_slots = slots;
+      m_capacity = capacity;
+      for (size_t i = 0; i < old_capacity; i++)
+      {
+         if (old_slots[i].has_value())
+         {
+            size_t index = home_index(old_slots[i]->first);
+            while (m_slots[index].has_value())
+            {
+               index = (index + 1) & (m_capacity - 1);
+            }
+            m_slots[index].emplace(std::move(*old_slots[i]));
+         }
+      }
+
+      if (old_slots != nullptr)
+      {
+         m_allocator.destroy(old_capacity, old_slots);
+      }
+      return true;
+   }
+
+   const util::allocator m_allocator;
+   slot *m_slots{ nullptr };
+   size_t m_capacity{ 0 };
+   size_t m_size{ 0 };
+};
+
+} /* namespace util */
@@ -23,8 +23,12 @@
  */
 
 #include "format_modifiers.hpp"
+#include "helpers.hpp"
+#include "log.hpp"
 #include "layer/private_data.hpp"
 
+#include <algorithm>
+
 namespace util
 {
 
@@ -51,4 +55,221 @@ VkResult get_drm_format_properties(VkPhysicalDevice physical_device, VkFormat fo
    instance_data.disp.GetPhysicalDeviceFormatProperties2KHR(physical_device, format, &format_props);
    return VK_SUCCESS;
 }
+
+bool drm_format_modifier_support::supports_image(const VkImageCreateInfo &info) const
+{
+   if (image_format_properties.maxExtent.width < info.extent.width ||
+       image_format_properties.maxExtent.height < info.extent.height ||
+       image_format_properties.maxExtent.depth < info.extent.depth)
+   {
+      return false;
+   }
+   if (image_format_properties.maxMipLevels < info.mipLevels ||
+       image_format_properties.maxArrayLayers < info.arrayLayers)
+   {
+      return false;
+   }
+   return (image_format_properties.sampleCounts & info.samples) == info.samples;
+}
+
+drm_format_modifier_cache::entry::entry(const util::allocator &allocator)
+   : format{ VK_FORMAT_UNDEFINED }
+   , image_type{ VK_IMAGE_TYPE_2D }
+   , usage{ 0 }
+   , flags{ 0 }
+   , sharing_mode{ VK_SHARING_MODE_EXCLUSIVE }
+   , queue_family_indices{ allocator }
+   , has_compression_control{ false }
+   , compression_flags{ 0 }
+   , fixed_rate_flags{ allocator }
+   , modifiers{ allocator }
+{
+}
+
+bool drm_format_modifier_cache::entry::matches(const VkImageCreateInfo &info,
+                                               const VkImageCompressionControlEXT *compression_control) const
+{
+   if (format != info.format || image_type != info.imageType || usage != info.usage || flags != info.flags ||
+       sharing_mode != info.sharingMode)
+   {
+      return false;
+   }
+
+   /* The queue family indices are only used with concurrent sharing. */
+   if (sharing_mode == VK_SHARING_MODE_CONCURRENT &&
+       (queue_family_indices.size() != info.queueFamilyIndexCount ||
+        !std::equal(queue_family_indices.begin(), queue_family_indices.end(), info.pQueueFamilyIndices)))
+   {
+      return false;
+   }
+
+   if (has_compression_control != (compression_control != nullptr))
+   {
+      return false;
+   }
+   if (compression_control != nullptr)
+   {
+      const VkImageCompressionFixedRateFlagsEXT *fixed_rate_begin = compression_control->pFixedRateFlags;
+      const uint32_t fixed_rate_count =
+         fixed_rate_begin != nullptr ? compression_control->compressionControlPlaneCount : 0;
+      if (compression_flags != compression_control->flags || fixed_rate_flags.size() != fixed_rate_count ||
+          !std::equal(fixed_rate_flags.begin(), fixed_rate_flags.end(), fixed_rate_begin))
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+drm_format_modifier_cache::drm_format_modifier_cache(VkPhysicalDevice physical_device,
+                                                     const util::allocator &allocator)
+   : m_physical_device{ physical_device }
+   , m_allocator{ allocator }
+   , m_entries{ allocator }
+{
+}
+
+VkResult drm_format_modifier_cache::query_supported_modifiers(const VkImageCreateInfo &info,
+                                                              const VkImageCompressionControlEXT *compression_control,
+                                                              entry &new_entry)
+{
+   auto &instance_data = layer::instance_private_data::get(m_physical_device);
+
+   util::vector<VkDrmFormatModifierPropertiesEXT> drm_format_props(
+      util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+   TRY_LOG(get_drm_format_properties(m_physical_device, info.format, drm_format_props),
+           "Failed to get format properties");
+
+   for (const auto &prop : drm_format_props)
+   {
+      VkExternalImageFormatPropertiesKHR external_props = {};
+      external_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES_KHR;
+
+      VkImageFormatProperties2KHR format_props = {};
+      format_props.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2_KHR;
+      format_props.pNext = &external_props;
+
+      VkPhysicalDeviceExternalImageFormatInfoKHR external_info = {};
+      external_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO_KHR;
+      external_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+
+      VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_mod_info = {};
+      drm_mod_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT;
+      drm_mod_info.pNext = &external_info;
+      drm_mod_info.drmFormatModifier = prop.drmFormatModifier;
+      drm_mod_info.sharingMode = info.sharingMode;
+      drm_mod_info.queueFamilyIndexCount = info.queueFamilyIndexCount;
+      drm_mod_info.pQueueFamilyIndices = info.pQueueFamilyIndices;
+
+      VkPhysicalDeviceImageFormatInfo2KHR image_info = {};
+      image_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2_KHR;
+      image_info.pNext = &drm_mod_info;
+      image_info.format = info.format;
+      image_info.type = info.imageType;
+      image_info.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+      image_info.usage = info.usage;
+      image_info.flags = info.flags;
+
+      VkImageCompressionControlEXT compression = {};
+      VkImageCompressionPropertiesEXT compression_props = {};
+      compression_props.sType = VK_STRUCTURE_TYPE_IMAGE_COMPRESSION_PROPERTIES_EXT;
+      if (compression_control != nullptr)
+      {
+         compression = *compression_control;
+         compression.pNext = image_info.pNext;
+         image_info.pNext = &compression;
+
+         compression_props.pNext = format_props.pNext;
+         format_props.pNext = &compression_props;
+      }
+
+      if (instance_data.disp.GetPhysicalDeviceImageFormatProperties2KHR(m_physical_device, &image_info,
+                                                                        &format_props) != VK_SUCCESS)
+      {
+         continue;
+      }
+
+      drm_format_modifier_support support = {};
+      support.modifier_properties = prop;
+      support.image_format_properties = format_props.imageFormatProperties;
+      support.external_memory_features = external_props.externalMemoryProperties.externalMemoryFeatures;
+      support.compression_flags = compression_props.imageCompressionFlags;
+      support.fixed_rate_flags = compression_props.imageCompressionFixedRateFlags;
+      if (!new_entry.modifiers.try_push_back(support))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   new_entry.format = info.format;
+   new_entry.image_type = info.imageType;
+   new_entry.usage = info.usage;
+   new_entry.flags = info.flags;
+   new_entry.sharing_mode = info.sharingMode;
+   if (info.sharingMode == VK_SHARING_MODE_CONCURRENT)
+   {
+      for (uint32_t i = 0; i < info.queueFamilyIndexCount; i++)
+      {
+         if (!new_entry.queue_family_indices.try_push_back(info.pQueueFamilyIndices[i]))
+         {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+         }
+      }
+   }
+   new_entry.has_compression_control = compression_control != nullptr;
+   if (compression_control != nullptr)
+   {
+      new_entry.compression_flags = compression_control->flags;
+      if (compression_control->pFixedRateFlags != nullptr)
+      {
+         for (uint32_t i = 0; i < compression_control->compressionControlPlaneCount; i++)
+         {
+            if (!new_entry.fixed_rate_flags.try_push_back(compression_control->pFixedRateFlags[i]))
+            {
+               return VK_ERROR_OUT_OF_HOST_MEMORY;
+            }
+         }
+      }
+   }
+
+   return VK_SUCCESS;
+}
+
+VkResult drm_format_modifier_cache::get_supported_modifiers(
+   const VkImageCreateInfo &info, const VkImageCompressionControlEXT *compression_control,
+   util::vector<drm_format_modifier_support> &supported_modifiers)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+
+   auto it = std::find_if(m_entries.begin(), m_entries.end(),
+                          [&](const util::unique_ptr<entry> &e) { return e->matches(info, compression_control); });
+   if (it == m_entries.end())
+   {
+      auto new_entry = m_allocator.make_unique<entry>(m_allocator);
+      if (new_entry == nullptr)
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+      TRY_LOG_CALL(query_supported_modifiers(info, compression_control, *new_entry));
+
+      if (m_entries.size() == max_entries)
+      {
+         m_entries.erase(m_entries.begin());
+      }
+      if (!m_entries.try_push_back(std::move(new_entry)))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+      it = m_entries.end() - 1;
+   }
+
+   const auto &modifiers = (*it)->modifiers;
+   if (!supported_modifiers.try_resize(modifiers.size()))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   std::copy(modifiers.begin(), modifiers.end(), supported_modifiers.begin());
+   return VK_SUCCESS;
+}
 } /* namespace util */
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2022 Arm Limited.
+ * Copyright (c) 2022, 2025 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -27,6 +27,8 @@
 #include <vulkan/vulkan.h>
 #include "custom_allocator.hpp"
 
+#include <mutex>
+
 namespace util
 {
 
@@ -44,4 +46,111 @@ namespace util
 VkResult get_drm_format_properties(VkPhysicalDevice physical_device, VkFormat format,
                                    util::vector<VkDrmFormatModifierPropertiesEXT> &format_props_list);
 
+/**
+ * @brief Support of a DRM modifier for the images of a swapchain, as reported by the ICD.
+ */
+struct drm_format_modifier_support
+{
+   /**
+    * @brief Properties of the format when combined with the modifier.
+    */
+   VkDrmFormatModifierPropertiesEXT modifier_properties;
+
+   /**
+    * @brief Limits of images created with the modifier.
+    */
+   VkImageFormatProperties image_format_properties;
+
+   /**
+    * @brief Whether dma-bufs of images created with the modifier can be exported and/or imported.
+    */
+   VkExternalMemoryFeatureFlags external_memory_features;
+
+   /**
+    * @brief Compression applied to images created with the modifier.
+    *
+    * Only reported when the modifier was queried with an image compression control, 0 otherwise.
+    */
+   VkImageCompressionFlagsEXT compression_flags;
+
+   /**
+    * @brief Fixed compression rates applied to images created with the modifier, 0 when not fixed-rate compressed.
+    *
+    * Only reported when the modifier was queried with an image compression control.
+    */
+   VkImageCompressionFixedRateFlagsEXT fixed_rate_flags;
+
+   /**
+    * @brief Check whether an image created with @p info fits the limits of the modifier.
+    */
+   bool supports_image(const VkImageCreateInfo &info) const;
+};
+
+/**
+ * @brief Cache of the DRM modifiers the ICD supports for swapchain images.
+ *
+ * Finding the modifiers usable with an image takes one image format properties query per modifier the format
+ * supports. The results only depend on the parameters of the image that are given to these queries, so they are
+ * kept and reused by the following swapchains created with the same parameters. The extent, mip levels, array layers
+ * and samples of the image are checked against the cached limits instead, with
+ * drm_format_modifier_support::supports_image().
+ *
+ * The cache is thread safe.
+ */
+class drm_format_modifier_cache
+{
+public:
+   drm_format_modifier_cache(VkPhysicalDevice physical_device, const util::allocator &allocator);
+
+   /**
+    * @brief Get the DRM modifiers that can be used for dma-buf backed images created with @p info.
+    *
+    * Only the modifiers for which the image format properties query succeeds are returned.
+    *
+    * @param      info                The image create info. Only the parameters given to the queries are used.
+    * @param      compression_control Image compression control to chain to the queries, or nullptr.
+    * @param[out] supported_modifiers The supported modifiers, in the order reported by the ICD.
+    *
+    * @return VK_SUCCESS on success, VK_ERROR_OUT_OF_HOST_MEMORY when the host gets out of memory.
+    */
+   VkResult get_supported_modifiers(const VkImageCreateInfo &info,
+                                    const VkImageCompressionControlEXT *compression_control,
+                                    util::vector<drm_format_modifier_support> &supported_modifiers);
+
+private:
+   /**
+    * @brief Maximum number of image parameter sets kept, the oldest is dropped first.
+    */
+   static constexpr size_t max_entries = 8;
+
+   struct entry
+   {
+      entry(const util::allocator &allocator);
+
+      /**
+       * @brief Check whether the entry was made for the given query parameters.
+       */
+      bool matches(const VkImageCreateInfo &info, const VkImageCompressionControlEXT *compression_control) const;
+
+      VkFormat format;
+      VkImageType image_type;
+      VkImageUsageFlags usage;
+      VkImageCreateFlags flags;
+      VkSharingMode sharing_mode;
+      util::vector<uint32_t> queue_family_indices;
+      bool has_compression_control;
+      VkImageCompressionFlagsEXT compression_flags;
+      util::vector<VkImageCompressionFixedRateFlagsEXT> fixed_rate_flags;
+      util::vector<drm_format_modifier_support> modifiers;
+   };
+
+   VkResult query_supported_modifiers(const VkImageCreateInfo &info,
+                                      const VkImageCompressionControlEXT *compression_control, entry &new_entry);
+
+   VkPhysicalDevice m_physical_device;
+   util::allocator m_allocator;
+   std::mutex m_lock;
+   util::vector<util::unique_ptr<entry>> m_entries;
+};
+
 } /* namespace util */
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "futex.hpp"
+
+namespace util
+{
+
+VkResult futex_wait(std::atomic<uint32_t> &word, uint32_t expected, uint64_t timeout)
+{
+   struct timespec relative = {};
+   struct timespec *timeout_ptr = nullptr;
+   if (timeout != UINT64_MAX)
+   {
+      /* FUTEX_WAIT takes a relative timeout measured against CLOCK_MONOTONIC. */
+      relative.tv_sec = static_cast<time_t>(timeout / (1000 * 1000 * 1000));
+      relative.tv_nsec = static_cast<long>(timeout % (1000 * 1000 * 1000));
+      timeout_ptr = &relative;
+   }
+
+   long res = syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE, expected, timeout_ptr,
+                      nullptr, 0);
+   if (res == -1)
+   {
+      /* EAGAIN means the word changed before we went to sleep, EINTR means a signal arrived. Both are reported as
+       * a normal wake up, any other error is a programming error. */
+      assert(errno == ETIMEDOUT || errno == EAGAIN || errno == EINTR);
+      if (errno == ETIMEDOUT)
+      {
+         return VK_TIMEOUT;
+      }
+   }
+
+   return VK_SUCCESS;
+}
+
+void futex_wake(std::atomic<uint32_t> &word, int count)
+{
+   long res = syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+   /* Only programming error can cause FUTEX_WAKE to fail. */
+   assert(res >= 0);
+   (void)res;
+}
+
+} /* namespace util */
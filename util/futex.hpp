@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file futex.hpp
+ *
+ * @brief Contains thin wrappers around the Linux futex system call.
+ *
+ * The wrappers operate on 32-bit atomics so that lock-free data structures in the layer can put a waiting thread to
+ * sleep without having to fall back to a mutex and a condition variable.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+namespace util
+{
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Futex words must be plain 32-bit integers");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Futex words must be lock-free");
+
+/**
+ * @brief Block the calling thread while @p word still holds @p expected.
+ *
+ * The call may return spuriously, so callers must re-check their condition in a loop.
+ *
+ * @param word     The futex word to wait on.
+ * @param expected The value the word is expected to hold. If it differs, the call returns immediately.
+ * @param timeout  Time to wait (ns). UINT64_MAX waits indefinitely.
+ *
+ * @retval VK_TIMEOUT if the timeout was reached.
+ * @retval VK_SUCCESS if the thread was woken up, interrupted or the word did not hold @p expected.
+ */
+VkResult futex_wait(std::atomic<uint32_t> &word, uint32_t expected, uint64_t timeout);
+
+/**
+ * @brief Wake up threads blocked in @ref futex_wait on @p word.
+ *
+ * @param word  The futex word to wake the waiters of.
+ * @param count Maximum number of waiters to wake up.
+ */
+void futex_wake(std::atomic<uint32_t> &word, int count);
+
+} /* namespace util */
@@ -119,6 +119,41 @@ private:
    noncopyable &operator=(const noncopyable &) = delete;
 };
 
+/**
+ * @brief Get the size of a texel of the single plane color formats the layer copies images of.
+ *
+ * @return The size in bytes, or 0 if the layer does not copy images in @p format.
+ */
+inline uint32_t get_texel_size(VkFormat format)
+{
+   switch (format)
+   {
+   case VK_FORMAT_R5G6B5_UNORM_PACK16:
+   case VK_FORMAT_B5G6R5_UNORM_PACK16:
+   case VK_FORMAT_R4G4B4A4_UNORM_PACK16:
+   case VK_FORMAT_B4G4R4A4_UNORM_PACK16:
+   case VK_FORMAT_R5G5B5A1_UNORM_PACK16:
+   case VK_FORMAT_B5G5R5A1_UNORM_PACK16:
+   case VK_FORMAT_A1R5G5B5_UNORM_PACK16:
+      return 2;
+   case VK_FORMAT_R8G8B8A8_UNORM:
+   case VK_FORMAT_R8G8B8A8_SRGB:
+   case VK_FORMAT_B8G8R8A8_UNORM:
+   case VK_FORMAT_B8G8R8A8_SRGB:
+   case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+   case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+   case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+   case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+   case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+      return 4;
+   case VK_FORMAT_R16G16B16A16_UNORM:
+   case VK_FORMAT_R16G16B16A16_SFLOAT:
+      return 8;
+   default:
+      return 0;
+   }
+}
+
 static constexpr uint32_t MAX_PLANES = 4;
 
 /**
@@ -23,13 +23,23 @@
  */
 
 #include "log.hpp"
-#include <iostream>
+#include "custom_allocator.hpp"
+#include "futex.hpp"
+#include "thread.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <charconv>
+#include <chrono>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
-#include <string>
 #include <cstring>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <pthread.h>
+#include <unistd.h>
 
 namespace util
 {
@@ -37,9 +47,29 @@ namespace util
 #ifndef NDEBUG
 
 /**
- * @brief check if a log level is enabled, and print it
+ * @brief Length of the window in which the messages of a call site are counted for rate limiting.
  */
-static bool check_and_print_log_level(int level)
+static constexpr uint64_t LOG_RATE_WINDOW_NS = 1000000000;
+
+/**
+ * @brief Number of messages a call site can print in a rate limiting window, the rest are suppressed.
+ */
+static constexpr uint32_t LOG_RATE_BURST = 10;
+
+/**
+ * @brief Maximum length of a formatted message, longer messages are truncated.
+ */
+static constexpr size_t LOG_MESSAGE_SIZE = 512;
+
+/**
+ * @brief Number of messages that a thread can have queued before the writer thread prints them.
+ */
+static constexpr size_t LOG_RING_SIZE = 32;
+
+/**
+ * @brief Get the log level set through VULKAN_WSI_DEBUG_LEVEL.
+ */
+static int get_log_level()
 {
    struct log_state
    {
@@ -53,43 +83,349 @@ static bool check_and_print_log_level(int level)
       }
    };
    static log_state state;
+   return state.level;
+}
+
+/**
+ * @brief Single producer, single consumer queue of the messages logged by a thread.
+ *
+ * The logging thread writes at m_head and the writer thread reads at m_tail, so neither ever waits for the other.
+ * When the queue is full, messages are dropped and counted instead.
+ */
+struct log_ring
+{
+   struct message
+   {
+      size_t length;
+      char text[LOG_MESSAGE_SIZE];
+   };
+
+   std::array<message, LOG_RING_SIZE> messages;
+   std::atomic<uint64_t> head{ 0 };
+   std::atomic<uint64_t> tail{ 0 };
+   std::atomic<uint32_t> dropped{ 0 };
 
-   bool result = level <= state.level;
-   if (result)
+   /**
+    * @brief Set when the thread that owns the ring exits, the writer thread then frees the ring once it is drained.
+    */
+   std::atomic<bool> orphaned{ false };
+   log_ring *next{ nullptr };
+
+   bool try_push(const char *text, size_t length)
    {
-      switch (level)
+      const uint64_t current_head = head.load(std::memory_order_relaxed);
+      if (current_head - tail.load(std::memory_order_acquire) == LOG_RING_SIZE)
       {
-      case 0:
-         /* Reserved for no logging */
-         break;
-      case 1:
-         std::fprintf(stderr, "ERROR");
-         break;
-      case 2:
-         std::fprintf(stderr, "WARNING");
-         break;
-      case 3:
-         std::fprintf(stderr, "INFO");
-         break;
-      default:
-         std::fprintf(stderr, "LEVEL_%d", level);
-         break;
+         dropped.fetch_add(1, std::memory_order_relaxed);
+         return false;
       }
+
+      message &msg = messages[current_head % LOG_RING_SIZE];
+      std::memcpy(msg.text, text, length);
+      msg.length = length;
+      head.store(current_head + 1, std::memory_order_release);
+      return true;
    }
-   return result;
+};
+
+/**
+ * @brief Set once the writer thread has been stopped, messages are then printed by the logging threads.
+ *
+ * This is outside of @ref log_writer so that it can still be checked after the writer object is destroyed.
+ */
+static std::atomic<bool> g_log_writer_stopped{ false };
+
+/**
+ * @brief Print the messages of a forked child directly, as fork does not copy the writer thread into the child.
+ */
+static void stop_log_writer_in_child()
+{
+   g_log_writer_stopped.store(true);
 }
 
-void wsi_log_message(int level, const char *file, int line, const char *format, ...)
+static const int log_writer_fork_handler = pthread_atfork(nullptr, nullptr, stop_log_writer_in_child);
+
+/**
+ * @brief Background thread that prints the messages queued by all the threads.
+ */
+class log_writer
 {
-   if (check_and_print_log_level(level))
-   {
-      std::fprintf(stderr, "(%s:%d): ", file, line);
-      std::va_list args;
-      va_start(args, format);
-      std::vfprintf(stderr, format, args);
-      va_end(args);
-      std::putc('\n', stderr);
+public:
+   ~log_writer()
+   {
+      g_log_writer_stopped.store(true);
+      if (m_thread.joinable() && m_process_id != getpid())
+      {
+         /* The thread belongs to the parent process and cannot be joined, only release the handle. */
+         m_thread.detach();
+      }
+      else if (m_thread.joinable())
+      {
+         m_stop.store(true);
+         m_wake_seq.fetch_add(1);
+         futex_wake(m_wake_seq, 1);
+         m_thread.join();
+      }
+   }
+
+   /**
+    * @brief Create the ring of a thread, starting the writer thread if needed.
+    *
+    * @return The new ring, or nullptr if the messages of the thread must be printed synchronously.
+    */
+   log_ring *create_ring()
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (!m_thread.joinable())
+      {
+         if (m_thread_failed)
+         {
+            return nullptr;
+         }
+
+         try
+         {
+            m_thread = start_thread("wsi-log", nullptr, &log_writer::run, this);
+            m_process_id = getpid();
+         }
+         catch (const std::system_error &)
+         {
+            m_thread_failed = true;
+            return nullptr;
+         }
+      }
+
+      log_ring *ring = allocator::get_generic().create<log_ring>(1);
+      if (ring != nullptr)
+      {
+         ring->next = m_rings;
+         m_rings = ring;
+      }
+      return ring;
    }
+
+   /**
+    * @brief Wake up the writer thread after a message was queued.
+    */
+   void notify()
+   {
+      m_wake_seq.fetch_add(1);
+      if (m_sleeping.load())
+      {
+         futex_wake(m_wake_seq, 1);
+      }
+   }
+
+private:
+   void run()
+   {
+      while (true)
+      {
+         const uint32_t seq = m_wake_seq.load();
+         const bool stop = m_stop.load();
+         drain();
+         if (stop)
+         {
+            break;
+         }
+
+         m_sleeping.store(true);
+         futex_wait(m_wake_seq, seq, UINT64_MAX);
+         m_sleeping.store(false);
+      }
+   }
+
+   /**
+    * @brief Print the messages queued in all the rings and free the rings of the threads that exited.
+    */
+   void drain()
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      bool written = false;
+      for (log_ring **link = &m_rings; *link != nullptr;)
+      {
+         log_ring *ring = *link;
+         /* Read the flag first, so that messages queued right before the thread exited are drained below. */
+         const bool orphaned = ring->orphaned.load(std::memory_order_acquire);
+         const uint64_t head = ring->head.load(std::memory_order_acquire);
+         uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+         for (; tail != head; tail++)
+         {
+            const log_ring::message &msg = ring->messages[tail % LOG_RING_SIZE];
+            std::fwrite(msg.text, 1, msg.length, stderr);
+            ring->tail.store(tail + 1, std::memory_order_release);
+            written = true;
+         }
+
+         if (const uint32_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed))
+         {
+            std::fprintf(stderr, "WARNING: %u log messages were dropped\n", dropped);
+            written = true;
+         }
+
+         if (orphaned)
+         {
+            *link = ring->next;
+            allocator::get_generic().destroy<log_ring>(1, ring);
+         }
+         else
+         {
+            link = &ring->next;
+         }
+      }
+
+      if (written)
+      {
+         std::fflush(stderr);
+      }
+   }
+
+   /**
+    * @brief Protects the list of rings against threads registering their ring while it is drained.
+    */
+   std::mutex m_lock;
+   log_ring *m_rings{ nullptr };
+   std::thread m_thread;
+   /**
+    * @brief Process that started @ref m_thread.
+    */
+   pid_t m_process_id{ 0 };
+   bool m_thread_failed{ false };
+   std::atomic<uint32_t> m_wake_seq{ 0 };
+   std::atomic<bool> m_sleeping{ false };
+   std::atomic<bool> m_stop{ false };
+};
+
+static log_writer &get_log_writer()
+{
+   static log_writer writer;
+   return writer;
+}
+
+/**
+ * @brief Ring of the calling thread, handed over to the writer thread when the thread exits.
+ */
+struct thread_log_ring
+{
+   log_ring *ring{ nullptr };
+   bool initialized{ false };
+
+   ~thread_log_ring()
+   {
+      if (ring != nullptr)
+      {
+         ring->orphaned.store(true, std::memory_order_release);
+      }
+   }
+};
+
+static thread_local thread_log_ring t_log_ring;
+
+/**
+ * @brief Queue a formatted message for the writer thread, or print it if it cannot be queued.
+ */
+static void write_log_message(const char *text, size_t length)
+{
+   if (!g_log_writer_stopped.load(std::memory_order_relaxed))
+   {
+      if (!t_log_ring.initialized)
+      {
+         t_log_ring.ring = get_log_writer().create_ring();
+         t_log_ring.initialized = true;
+      }
+
+      if (t_log_ring.ring != nullptr)
+      {
+         /* A full ring means the writer is behind, drop the message rather than wait for it. */
+         if (t_log_ring.ring->try_push(text, length))
+         {
+            get_log_writer().notify();
+         }
+         return;
+      }
+   }
+
+   std::fwrite(text, 1, length, stderr);
+}
+
+/**
+ * @brief Check whether a call site exceeded its budget of messages in the current rate limiting window.
+ *
+ * @param site       The call site.
+ * @param suppressed Set to the number of messages of the site that were suppressed since it last printed one.
+ * @return true if the message must be suppressed.
+ */
+static bool is_rate_limited(log_site &site, uint32_t &suppressed)
+{
+   const uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                           .count();
+   uint64_t window_start = site.window_start.load(std::memory_order_relaxed);
+   if (now - window_start >= LOG_RATE_WINDOW_NS &&
+       site.window_start.compare_exchange_strong(window_start, now, std::memory_order_relaxed))
+   {
+      site.window_count.store(0, std::memory_order_relaxed);
+   }
+
+   if (site.window_count.fetch_add(1, std::memory_order_relaxed) >= LOG_RATE_BURST)
+   {
+      site.suppressed.fetch_add(1, std::memory_order_relaxed);
+      return true;
+   }
+
+   suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+   return false;
+}
+
+void wsi_log_message(log_site &site, int level, const char *file, int line, const char *format, ...)
+{
+   /* Level 0 is reserved for no logging */
+   if (level <= 0 || level > get_log_level())
+   {
+      return;
+   }
+
+   uint32_t suppressed = 0;
+   if (is_rate_limited(site, suppressed))
+   {
+      return;
+   }
+
+   char text[LOG_MESSAGE_SIZE];
+   /* Keep the last character for the newline. */
+   constexpr size_t max_length = sizeof(text) - 1;
+   int length;
+   switch (level)
+   {
+   case 1:
+      length = std::snprintf(text, max_length, "ERROR(%s:%d): ", file, line);
+      break;
+   case 2:
+      length = std::snprintf(text, max_length, "WARNING(%s:%d): ", file, line);
+      break;
+   case 3:
+      length = std::snprintf(text, max_length, "INFO(%s:%d): ", file, line);
+      break;
+   default:
+      length = std::snprintf(text, max_length, "LEVEL_%d(%s:%d): ", level, file, line);
+      break;
+   }
+
+   size_t used = std::min(static_cast<size_t>(std::max(length, 0)), max_length - 1);
+   std::va_list args;
+   va_start(args, format);
+   length = std::vsnprintf(text + used, max_length - used, format, args);
+   va_end(args);
+   used = std::min(used + static_cast<size_t>(std::max(length, 0)), max_length - 1);
+
+   if (suppressed > 0)
+   {
+      length = std::snprintf(text + used, max_length - used, " (%u similar messages suppressed)", suppressed);
+      used = std::min(used + static_cast<size_t>(std::max(length, 0)), max_length - 1);
+   }
+
+   text[used++] = '\n';
+   write_log_message(text, used);
 }
 
 #endif
@@ -23,10 +23,34 @@
  */
 
 #pragma once
+
+#include <atomic>
+#include <cstdint>
+
 namespace util
 {
 #define WSI_DEFAULT_LOG_LEVEL 1
 
+/**
+ * @brief Highest log level compiled in, messages of a higher level are removed at compile time.
+ */
+#ifndef WSI_LOG_MAX_LEVEL
+#define WSI_LOG_MAX_LEVEL 3
+#endif
+
+/**
+ * @brief Rate limiting state of a call site of @ref WSI_LOG.
+ *
+ * A call site prints a limited number of messages per second. The messages above that are counted and the count is
+ * appended to the next message the site prints, so a message repeated in a retry loop is coalesced.
+ */
+struct log_site
+{
+   std::atomic<uint64_t> window_start{ 0 };
+   std::atomic<uint32_t> window_count{ 0 };
+   std::atomic<uint32_t> suppressed{ 0 };
+};
+
 /**
  * @brief Log a message to a certain log level
  *
@@ -37,6 +61,11 @@ namespace util
  * is set to 2, messages with log level 1 and 2 are printed. Please note that
  * the newline character '\n' is automatically appended.
  *
+ * The message is formatted by the calling thread and queued for a background
+ * thread that writes it to stderr, so logging never waits on stderr. Messages
+ * are dropped if the queue of the thread is full.
+ *
+ * @param[in] site      The rate limiting state of the call site.
  * @param[in] level     The log level of this message, you can set an arbitary
  *                      integer however please refer to the included macros for
  *                      the sensible defaults.
@@ -45,9 +74,9 @@ namespace util
  * @param[in] format    A C-style formatting string.
  */
 
-void wsi_log_message(int level, const char *file, int line, const char *format, ...)
+void wsi_log_message(log_site &site, int level, const char *file, int line, const char *format, ...)
 #ifdef __GNUC__
-   __attribute__((format(printf, 4, 5)))
+   __attribute__((format(printf, 5, 6)))
 #endif
    ;
 
@@ -57,11 +86,14 @@ static constexpr bool wsi_log_enable = false;
 static constexpr bool wsi_log_enable = true;
 #endif
 
-#define WSI_LOG(level, ...)                                               \
-   do                                                                     \
-   {                                                                      \
-      if (::util::wsi_log_enable)                                         \
-         ::util::wsi_log_message(level, __FILE__, __LINE__, __VA_ARGS__); \
+#define WSI_LOG(level, ...)                                                             \
+   do                                                                                   \
+   {                                                                                    \
+      if (::util::wsi_log_enable && (level) <= WSI_LOG_MAX_LEVEL)                       \
+      {                                                                                 \
+         static ::util::log_site wsi_log_site;                                          \
+         ::util::wsi_log_message(wsi_log_site, level, __FILE__, __LINE__, __VA_ARGS__); \
+      }                                                                                 \
    } while (0)
 
 #define WSI_LOG_ERROR(...) WSI_LOG(1, __VA_ARGS__)
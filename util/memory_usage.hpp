@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file memory_usage.hpp
+ *
+ * @brief Contains the counters of the memory the layer allocates for swapchains.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "helpers.hpp"
+
+namespace util
+{
+
+/**
+ * @brief Counts the bytes of memory held by a swapchain or by all the swapchains of a device.
+ *
+ * The counters of a swapchain have the counters of its device as parent, and every change recorded in them is
+ * recorded in the parent too. The counters can be read from any thread while they are updated.
+ */
+class memory_usage : private noncopyable
+{
+public:
+   /**
+    * @param parent Counters that every change is also recorded in, or nullptr.
+    */
+   explicit memory_usage(memory_usage *parent = nullptr)
+      : m_parent{ parent }
+   {
+   }
+
+   /**
+    * @brief Record device memory allocated or imported by the layer.
+    *
+    * @param heap_index Index of the memory heap of the memory.
+    * @param size       Size of the memory in bytes.
+    * @param dma_buf    Whether the memory was imported from a dma-buf the layer allocated.
+    */
+   void add_device_memory(uint32_t heap_index, uint64_t size, bool dma_buf)
+   {
+      assert(heap_index < VK_MAX_MEMORY_HEAPS);
+      m_heap_bytes[heap_index].fetch_add(size, std::memory_order_relaxed);
+      if (dma_buf)
+      {
+         m_dma_buf_bytes.fetch_add(size, std::memory_order_relaxed);
+      }
+      if (m_parent != nullptr)
+      {
+         m_parent->add_device_memory(heap_index, size, dma_buf);
+      }
+   }
+
+   /**
+    * @brief Record the release of device memory recorded with @ref add_device_memory.
+    */
+   void remove_device_memory(uint32_t heap_index, uint64_t size, bool dma_buf)
+   {
+      assert(heap_index < VK_MAX_MEMORY_HEAPS);
+      m_heap_bytes[heap_index].fetch_sub(size, std::memory_order_relaxed);
+      if (dma_buf)
+      {
+         m_dma_buf_bytes.fetch_sub(size, std::memory_order_relaxed);
+      }
+      if (m_parent != nullptr)
+      {
+         m_parent->remove_device_memory(heap_index, size, dma_buf);
+      }
+   }
+
+   /**
+    * @brief Record host memory allocated by the layer.
+    */
+   void add_host_memory(uint64_t size)
+   {
+      m_host_bytes.fetch_add(size, std::memory_order_relaxed);
+      if (m_parent != nullptr)
+      {
+         m_parent->add_host_memory(size);
+      }
+   }
+
+   /**
+    * @brief Record the release of host memory recorded with @ref add_host_memory.
+    */
+   void remove_host_memory(uint64_t size)
+   {
+      m_host_bytes.fetch_sub(size, std::memory_order_relaxed);
+      if (m_parent != nullptr)
+      {
+         m_parent->remove_host_memory(size);
+      }
+   }
+
+   /**
+    * @brief Get the bytes of device memory held in a memory heap.
+    */
+   uint64_t get_heap_bytes(uint32_t heap_index) const
+   {
+      assert(heap_index < VK_MAX_MEMORY_HEAPS);
+      return m_heap_bytes[heap_index].load(std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Get the bytes of device memory imported from dma-bufs, which are also counted in their heap.
+    */
+   uint64_t get_dma_buf_bytes() const
+   {
+      return m_dma_buf_bytes.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Get the bytes of host memory.
+    */
+   uint64_t get_host_bytes() const
+   {
+      return m_host_bytes.load(std::memory_order_relaxed);
+   }
+
+private:
+   memory_usage *const m_parent;
+   std::array<std::atomic<uint64_t>, VK_MAX_MEMORY_HEAPS> m_heap_bytes{};
+   std::atomic<uint64_t> m_dma_buf_bytes{ 0 };
+   std::atomic<uint64_t> m_host_bytes{ 0 };
+};
+
+} /* namespace util */
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file proc_addr_table.hpp
+ *
+ * @brief Helpers for resolving entrypoint names through tables sorted at compile time.
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+
+namespace util
+{
+
+/**
+ * @brief Compare two entrypoint names.
+ *
+ * Equivalent to strcmp, but usable in constant expressions.
+ */
+constexpr int compare_proc_names(const char *lhs, const char *rhs)
+{
+   while (*lhs != '\0' && *lhs == *rhs)
+   {
+      lhs++;
+      rhs++;
+   }
+   return static_cast<unsigned char>(*lhs) - static_cast<unsigned char>(*rhs);
+}
+
+/**
+ * @brief Get a function as a PFN_vkVoidFunction.
+ *
+ * Casting function pointers is not allowed in constant expressions, so tables store a pointer to an instance of this
+ * function instead of the entrypoint itself.
+ *
+ * @tparam Fn The entrypoint to return.
+ */
+template <auto Fn>
+PFN_vkVoidFunction erase_proc_addr()
+{
+   return reinterpret_cast<PFN_vkVoidFunction>(Fn);
+}
+
+/**
+ * @brief Entry of a table of entrypoints exposed through vkGet*ProcAddr.
+ */
+struct proc_addr_entry
+{
+   /** @brief Name of the entrypoint. */
+   const char *name;
+   /** @brief Extension that must be enabled for the entrypoint to be exposed, or nullptr if it is always exposed. */
+   const char *ext_name;
+   /** @brief Function returning the implementation of the entrypoint, see @ref erase_proc_addr. */
+   PFN_vkVoidFunction (*get_fn)();
+};
+
+/**
+ * @brief Build the entry of an entrypoint that is always exposed and is implemented by @p func, whose name is the name
+ *        of the entrypoint without the "vk" prefix.
+ */
+#define PROC_ADDR_ENTRY(func) { "vk" #func, nullptr, &util::erase_proc_addr<&func> }
+
+/**
+ * @brief Check that a table of entries is sorted by name, with no duplicate names.
+ */
+template <typename T, std::size_t N>
+constexpr bool is_sorted_by_name(const T (&entries)[N])
+{
+   for (std::size_t i = 1; i < N; i++)
+   {
+      if (compare_proc_names(entries[i - 1].name, entries[i].name) >= 0)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * @brief Find an entrypoint in a table sorted by name.
+ *
+ * @param entries The table, which must satisfy @ref is_sorted_by_name.
+ * @param name    The name of the entrypoint.
+ * @return pointer to the entry, or nullptr if the table does not contain the entrypoint.
+ */
+template <std::size_t N>
+const proc_addr_entry *find_proc_addr(const proc_addr_entry (&entries)[N], const char *name)
+{
+   auto it = std::lower_bound(std::begin(entries), std::end(entries), name,
+                              [](const proc_addr_entry &entry, const char *key) { return strcmp(entry.name, key) < 0; });
+   if (it != std::end(entries) && strcmp(it->name, name) == 0)
+   {
+      return it;
+   }
+   return nullptr;
+}
+
+/**
+ * @brief Compute the order of a table of entries sorted by name.
+ *
+ * @param entries The table, whose entries have a name member.
+ * @return indices of the entries of the table, in increasing name order.
+ */
+template <typename T, std::size_t N>
+constexpr std::array<std::size_t, N> sort_by_name(const T (&entries)[N])
+{
+   std::array<std::size_t, N> order{};
+   for (std::size_t i = 0; i < N; i++)
+   {
+      std::size_t j = i;
+      for (; j > 0 && compare_proc_names(entries[order[j - 1]].name, entries[i].name) > 0; j--)
+      {
+         order[j] = order[j - 1];
+      }
+      order[j] = i;
+   }
+   return order;
+}
+
+} /* namespace util */
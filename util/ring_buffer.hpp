@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2021-2022 Arm Limited.
+ * Copyright (c) 2021-2022, 2025 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -22,10 +22,16 @@
  * SOFTWARE.
  */
 
+#pragma once
+
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <optional>
 
+#include "futex.hpp"
+
 namespace util
 {
 
@@ -128,4 +134,194 @@ private:
    std::size_t m_size{};
 };
 
+/**
+ * @brief Lock-free single-producer/single-consumer variant of @ref ring_buffer.
+ *
+ * One thread may call @ref push_back and @ref wait_for_space while another thread concurrently calls @ref pop_front
+ * and @ref wait, without any external locking. The consumer can block in @ref wait until the producer places an item,
+ * and the producer in @ref wait_for_space until the consumer pops one, using futexes so that either end only enters
+ * the kernel when the other one is actually asleep.
+ */
+template <typename T, std::size_t N>
+class spsc_ring_buffer
+{
+public:
+   /**
+    * @brief Return maximum capacity of the ring buffer.
+    */
+   constexpr std::size_t capacity() const
+   {
+      return N;
+   }
+
+   /**
+    * @brief Return current size of the ring buffer.
+    *
+    * The value is only a snapshot when called concurrently with the other end of the queue.
+    */
+   std::size_t size() const
+   {
+      return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+   }
+
+   /**
+    * @brief Places item into next slot of the ring buffer. Must only be called by the producer thread.
+    * @return Boolean to indicate success or failure.
+    */
+   template <typename U>
+   bool push_back(U &&item)
+   {
+      const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+      if (tail - m_head.load(std::memory_order_acquire) == N)
+      {
+         return false;
+      }
+
+      m_data[tail % N].emplace(std::forward<U>(item));
+      m_tail.store(tail + 1, std::memory_order_seq_cst);
+
+      m_sequence.fetch_add(1, std::memory_order_seq_cst);
+      if (m_consumer_waiting.load(std::memory_order_seq_cst))
+      {
+         futex_wake(m_sequence, 1);
+      }
+
+      return true;
+   }
+
+   /**
+    * @brief Pop the front of the ring buffer. Must only be called by the consumer thread.
+    *
+    * @return Item wrapped in an optional, std::nullopt if the ring buffer is empty.
+    */
+   std::optional<T> pop_front()
+   {
+      const std::size_t head = m_head.load(std::memory_order_relaxed);
+      if (head == m_tail.load(std::memory_order_acquire))
+      {
+         return std::nullopt;
+      }
+
+      std::optional<T> value = std::move(m_data[head % N]);
+      m_data[head % N].reset();
+      m_head.store(head + 1, std::memory_order_seq_cst);
+
+      if (m_producer_waiting.load(std::memory_order_seq_cst))
+      {
+         m_pop_sequence.fetch_add(1, std::memory_order_seq_cst);
+         futex_wake(m_pop_sequence, 1);
+      }
+
+      return value;
+   }
+
+   /**
+    * @brief Wait until the ring buffer is not empty. Must only be called by the consumer thread.
+    *
+    * @param timeout Time to wait (ns). 0 doesn't block, UINT64_MAX waits indefinitely.
+    *
+    * @retval VK_SUCCESS if there is at least one item to pop.
+    * @retval VK_NOT_READY if timeout was zero and the ring buffer is empty.
+    * @retval VK_TIMEOUT if timeout was non-zero and was reached.
+    */
+   VkResult wait(uint64_t timeout)
+   {
+      while (true)
+      {
+         const uint32_t sequence = m_sequence.load(std::memory_order_seq_cst);
+         if (!empty())
+         {
+            return VK_SUCCESS;
+         }
+         else if (timeout == 0)
+         {
+            return VK_NOT_READY;
+         }
+
+         /* Announce the wait before re-checking, so a concurrent push either becomes visible here or sees the flag
+          * and wakes us up. */
+         m_consumer_waiting.store(true, std::memory_order_seq_cst);
+         VkResult res = VK_SUCCESS;
+         if (empty())
+         {
+            res = futex_wait(m_sequence, sequence, timeout);
+         }
+         m_consumer_waiting.store(false, std::memory_order_relaxed);
+
+         if (res == VK_TIMEOUT)
+         {
+            return empty() ? VK_TIMEOUT : VK_SUCCESS;
+         }
+      }
+   }
+
+   /**
+    * @brief Wait until the ring buffer holds fewer than @p max_size items. Must only be called by the producer thread.
+    *
+    * @param max_size Number of items at which the producer is throttled.
+    * @param timeout  Time to wait (ns). UINT64_MAX waits indefinitely.
+    *
+    * @retval VK_SUCCESS if the ring buffer holds fewer than @p max_size items.
+    * @retval VK_TIMEOUT if the timeout was reached.
+    */
+   VkResult wait_for_space(std::size_t max_size, uint64_t timeout)
+   {
+      while (true)
+      {
+         const uint32_t sequence = m_pop_sequence.load(std::memory_order_seq_cst);
+         if (queued() < max_size)
+         {
+            return VK_SUCCESS;
+         }
+
+         /* Announce the wait before re-checking, so a concurrent pop either becomes visible here or sees the flag
+          * and wakes us up. */
+         m_producer_waiting.store(true, std::memory_order_seq_cst);
+         VkResult res = VK_SUCCESS;
+         if (queued() >= max_size)
+         {
+            res = futex_wait(m_pop_sequence, sequence, timeout);
+         }
+         m_producer_waiting.store(false, std::memory_order_relaxed);
+
+         if (res == VK_TIMEOUT)
+         {
+            return queued() < max_size ? VK_SUCCESS : VK_TIMEOUT;
+         }
+      }
+   }
+
+private:
+   bool empty() const
+   {
+      return m_head.load(std::memory_order_relaxed) == m_tail.load(std::memory_order_seq_cst);
+   }
+
+   std::size_t queued() const
+   {
+      return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_seq_cst);
+   }
+
+   std::array<std::optional<T>, N> m_data{};
+
+   /* Number of items popped so far, only written by the consumer. */
+   alignas(64) std::atomic<std::size_t> m_head{ 0 };
+
+   /* Number of items pushed so far, only written by the producer. */
+   alignas(64) std::atomic<std::size_t> m_tail{ 0 };
+
+   /* Futex word bumped on every push, the consumer sleeps on it while the ring buffer is empty. */
+   std::atomic<uint32_t> m_sequence{ 0 };
+
+   /* Set while the consumer may be sleeping on @ref m_sequence. */
+   std::atomic<bool> m_consumer_waiting{ false };
+
+   /* Futex word bumped on pops while the producer is waiting, the producer sleeps on it while the ring buffer is
+    * too full. */
+   std::atomic<uint32_t> m_pop_sequence{ 0 };
+
+   /* Set while the producer may be sleeping on @ref m_pop_sequence. */
+   std::atomic<bool> m_producer_waiting{ false };
+};
+
 } /* namespace util */
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "custom_allocator.hpp"
+#include "helpers.hpp"
+
+namespace util
+{
+
+/**
+ * @brief Vector with inline storage for its first elements, using a Vulkan custom allocator beyond that.
+ *
+ * Containers that are usually small, like per present or per submission arrays, can be filled without allocating at
+ * all. Like @ref vector, operations that can allocate report out of memory errors instead of throwing.
+ *
+ * @tparam T Type of the elements.
+ * @tparam N Number of elements stored inline.
+ */
+template <typename T, size_t N>
+class small_vector : private noncopyable
+{
+   static_assert(N > 0, "small_vector needs inline storage, use util::vector otherwise");
+
+public:
+   using value_type = T;
+   using size_type = size_t;
+   using iterator = T *;
+   using const_iterator = const T *;
+
+   /**
+    * @brief Construct a new small vector object with a custom allocator.
+    *
+    * @param allocator The allocator that will be used to store elements beyond the inline capacity.
+    */
+   explicit small_vector(const util::allocator &allocator)
+      : m_allocator{ allocator }
+   {
+   }
+
+   ~small_vector()
+   {
+      clear();
+      release_heap();
+   }
+
+   T *data()
+   {
+      return m_data;
+   }
+
+   const T *data() const
+   {
+      return m_data;
+   }
+
+   iterator begin()
+   {
+      return m_data;
+   }
+
+   iterator end()
+   {
+      return m_data + m_size;
+   }
+
+   const_iterator begin() const
+   {
+      return m_data;
+   }
+
+   const_iterator end() const
+   {
+      return m_data + m_size;
+   }
+
+   T &operator[](size_type index)
+   {
+      assert(index < m_size);
+      return m_data[index];
+   }
+
+   const T &operator[](size_type index) const
+   {
+      assert(index < m_size);
+      return m_data[index];
+   }
+
+   T &back()
+   {
+      assert(m_size > 0);
+      return m_data[m_size - 1];
+   }
+
+   size_type size() const
+   {
+      return m_size;
+   }
+
+   size_type capacity() const
+   {
+      return m_capacity;
+   }
+
+   bool empty() const
+   {
+      return m_size == 0;
+   }
+
+   /**
+    * @brief Like std::vector.reserve but doesn't throw on out of memory errors.
+    *
+    * @param capacity The number of elements to make room for.
+    * @return true If the container was resized successfuly.
+    * @return false If the host has run out of memory
+    */
+   bool try_reserve(size_type capacity)
+   {
+      if (capacity <= m_capacity)
+      {
+         return true;
+      }
+
+      WSI_TRACK_ALLOCATION(sizeof(T) * capacity);
+      const VkAllocationCallbacks &callbacks = m_allocator.m_callbacks;
+      T *data = static_cast<T *>(
+         callbacks.pfnAllocation(callbacks.pUserData, sizeof(T) * capacity, alignof(T), m_allocator.m_scope));
+      if (data == nullptr)
+      {
+         return false;
+      }
+
+      for (size_type i = 0; i < m_size; i++)
+      {
+         new (&data[i]) T(std::move(m_data[i]));
+         m_data[i].~T();
+      }
+      release_heap();
+      m_data = data;
+      m_capacity = capacity;
+      return true;
+   }
+
+   /**
+    * @brief Like std::vector.push_back but doesn't throw on out of memory errors.
+    *
+    * @param args The arguments to construct the new element with.
+    * @return true If the element was appended successfuly.
+    * @return false If the host has run out of memory
+    */
+   template <typename... Args>
+   bool try_push_back(Args &&...args)
+   {
+      if (m_size == m_capacity && !try_reserve(m_capacity * 2))
+      {
+         return false;
+      }
+      new (&m_data[m_size]) T(std::forward<Args>(args)...);
+      m_size++;
+      return true;
+   }
+
+   /**
+    * @brief Like std::vector.resize but doesn't throw on out of memory errors.
+    *
+    * @param size The new size of the vector.
+    * @param args The arguments to construct the new elements with, if the vector grows.
+    * @return true If the container was resized successfuly.
+    * @return false If the host has run out of memory
+    */
+   template <typename... Args>
+   bool try_resize(size_type size, const Args &...args)
+   {
+      if (!try_reserve(size))
+      {
+         return false;
+      }
+      while (m_size > size)
+      {
+         pop_back();
+      }
+      for (; m_size < size; m_size++)
+      {
+         new (&m_data[m_size]) T(args...);
+      }
+      return true;
+   }
+
+   void pop_back()
+   {
+      assert(m_size > 0);
+      m_size--;
+      m_data[m_size].~T();
+   }
+
+   /**
+    * @brief Erase an element, moving the following elements back.
+    *
+    * @return iterator to the element that followed the erased one.
+    */
+   iterator erase(iterator position)
+   {
+      assert(position >= begin() && position < end());
+      std::move(position + 1, end(), position);
+      pop_back();
+      return position;
+   }
+
+   void clear()
+   {
+      while (m_size > 0)
+      {
+         pop_back();
+      }
+   }
+
+private:
+   T *inline_data()
+   {
+      return std::launder(reinterpret_cast<T *>(&m_inline_storage));
+   }
+
+   void release_heap()
+   {
+      if (m_data != inline_data())
+      {
+         m_allocator.m_callbacks.pfnFree(m_allocator.m_callbacks.pUserData, m_data);
+      }
+   }
+
+   const util::allocator m_allocator;
+   std::aligned_storage_t<sizeof(T) * N, alignof(T)> m_inline_storage;
+   T *m_data{ inline_data() };
+   size_type m_size{ 0 };
+   size_type m_capacity{ N };
+};
+
+} /* namespace util */
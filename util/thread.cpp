@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "thread.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "log.hpp"
+
+namespace util
+{
+
+bool parse_cpu_list(const char *list, cpu_set_t &cpus)
+{
+   CPU_ZERO(&cpus);
+   const char *it = list;
+   while (*it != '\0' && *it != '\n')
+   {
+      char *end = nullptr;
+      errno = 0;
+      const unsigned long first = strtoul(it, &end, 10);
+      if (end == it || errno != 0)
+      {
+         return false;
+      }
+
+      unsigned long last = first;
+      it = end;
+      if (*it == '-')
+      {
+         it++;
+         last = strtoul(it, &end, 10);
+         if (end == it || errno != 0 || last < first)
+         {
+            return false;
+         }
+         it = end;
+      }
+
+      if (last >= CPU_SETSIZE)
+      {
+         return false;
+      }
+      for (unsigned long cpu = first; cpu <= last; cpu++)
+      {
+         CPU_SET(cpu, &cpus);
+      }
+
+      if (*it == ',')
+      {
+         it++;
+      }
+      else if (*it != '\0' && *it != '\n')
+      {
+         return false;
+      }
+   }
+   return CPU_COUNT(&cpus) > 0;
+}
+
+/**
+ * @brief Get the CPUs of the NUMA node the calling thread runs on.
+ */
+static std::optional<cpu_set_t> get_numa_node_cpus()
+{
+   const int cpu = sched_getcpu();
+   if (cpu < 0)
+   {
+      return std::nullopt;
+   }
+
+   char path[64];
+   snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+   DIR *dir = opendir(path);
+   if (dir == nullptr)
+   {
+      return std::nullopt;
+   }
+
+   /* The CPU directory links to its node as "node<N>". */
+   long node = -1;
+   while (const struct dirent *entry = readdir(dir))
+   {
+      char *end = nullptr;
+      if (strncmp(entry->d_name, "node", 4) == 0)
+      {
+         const long value = strtol(entry->d_name + 4, &end, 10);
+         if (end != entry->d_name + 4 && *end == '\0')
+         {
+            node = value;
+            break;
+         }
+      }
+   }
+   closedir(dir);
+   if (node < 0)
+   {
+      return std::nullopt;
+   }
+
+   snprintf(path, sizeof(path), "/sys/devices/system/node/node%ld/cpulist", node);
+   FILE *file = fopen(path, "re");
+   if (file == nullptr)
+   {
+      return std::nullopt;
+   }
+   char list[256];
+   const bool read = fgets(list, sizeof(list), file) != nullptr;
+   fclose(file);
+
+   cpu_set_t cpus;
+   if (!read || !parse_cpu_list(list, cpus))
+   {
+      return std::nullopt;
+   }
+   return cpus;
+}
+
+/**
+ * @brief Log a failure to apply part of the scheduling, only the first time it happens in the process.
+ */
+static void warn_once(std::atomic<bool> &warned, const char *what, int error)
+{
+   if (!warned.exchange(true, std::memory_order_relaxed))
+   {
+      WSI_LOG_WARNING("Failed to set the %s of the presentation threads (%s), keeping the default.", what,
+                      strerror(error));
+   }
+}
+
+thread_setup::thread_setup(const char *name, const thread_scheduling *scheduling)
+{
+   strncpy(m_name, name, sizeof(m_name) - 1);
+   m_name[sizeof(m_name) - 1] = '\0';
+
+   if (scheduling != nullptr)
+   {
+      m_scheduling = *scheduling;
+      if (scheduling->cpus.has_value())
+      {
+         m_affinity = scheduling->cpus;
+      }
+      else if (scheduling->numa_affinity)
+      {
+         m_affinity = get_numa_node_cpus();
+      }
+   }
+}
+
+void thread_setup::apply() const
+{
+   pthread_setname_np(pthread_self(), m_name);
+
+   if (m_affinity.has_value() && sched_setaffinity(0, sizeof(*m_affinity), &*m_affinity) != 0)
+   {
+      static std::atomic<bool> warned{ false };
+      warn_once(warned, "CPU affinity", errno);
+   }
+
+   if (m_scheduling.policy != thread_policy::normal)
+   {
+      sched_param param = {};
+      param.sched_priority = static_cast<int>(m_scheduling.priority);
+      const int policy = m_scheduling.policy == thread_policy::fifo ? SCHED_FIFO : SCHED_RR;
+      const int result = pthread_setschedparam(pthread_self(), policy, &param);
+      if (result != 0)
+      {
+         static std::atomic<bool> warned{ false };
+         warn_once(warned, "real-time scheduling", result);
+      }
+   }
+   else if (m_scheduling.nice.has_value())
+   {
+      /* On Linux the nice level of PRIO_PROCESS with a thread ID only applies to that thread. */
+      const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+      if (setpriority(PRIO_PROCESS, tid, *m_scheduling.nice) != 0)
+      {
+         static std::atomic<bool> warned{ false };
+         warn_once(warned, "nice level", errno);
+      }
+   }
+}
+
+} /* namespace util */
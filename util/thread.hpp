@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file thread.hpp
+ *
+ * @brief Contains the creation of the threads of the layer, with their names and scheduling.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <sched.h>
+#include <thread>
+#include <utility>
+
+namespace util
+{
+
+/**
+ * @brief Scheduling policy of the presentation threads.
+ */
+enum class thread_policy
+{
+   /** Keep the scheduling inherited from the thread that creates them. */
+   normal,
+   /** SCHED_FIFO with the configured priority. */
+   fifo,
+   /** SCHED_RR with the configured priority. */
+   round_robin,
+};
+
+/**
+ * @brief Scheduling of the threads that hand images over to the presentation engine.
+ *
+ * Every part of it is best effort: when the process is not allowed to apply a part, a warning is logged once and the
+ * thread keeps the default for that part.
+ */
+struct thread_scheduling
+{
+   thread_policy policy{ thread_policy::normal };
+
+   /** Real-time priority used with the fifo and round_robin policies. */
+   uint32_t priority{ 1 };
+
+   /** Nice level used with the normal policy, unset to keep the inherited one. */
+   std::optional<int32_t> nice;
+
+   /** Pin the threads to the CPUs of the NUMA node the creating thread runs on. */
+   bool numa_affinity{ false };
+
+   /** Pin the threads to these CPUs. Takes precedence over @ref numa_affinity. */
+   std::optional<cpu_set_t> cpus;
+};
+
+/**
+ * @brief Parse a list of CPUs such as "0-3,6" as used by the kernel in sysfs and by taskset.
+ *
+ * @param list     The list.
+ * @param[out] cpus The CPUs of the list.
+ *
+ * @return false if the list is malformed or empty.
+ */
+bool parse_cpu_list(const char *list, cpu_set_t &cpus);
+
+/**
+ * @brief Settings a new thread applies to itself before running.
+ *
+ * It is created by the thread that starts the new one, so that the NUMA node is the one of the thread submitting the
+ * work, and applied by the new thread with @ref apply.
+ */
+class thread_setup
+{
+public:
+   /**
+    * @brief Prepare the settings of a thread.
+    *
+    * @param name       Name of the thread, truncated to the 15 characters the kernel keeps.
+    * @param scheduling Scheduling of the thread or nullptr to keep the inherited one.
+    */
+   thread_setup(const char *name, const thread_scheduling *scheduling);
+
+   /**
+    * @brief Name the calling thread and apply its scheduling.
+    */
+   void apply() const;
+
+private:
+   char m_name[16];
+   thread_scheduling m_scheduling;
+   std::optional<cpu_set_t> m_affinity;
+};
+
+/**
+ * @brief Start a thread with a name and, optionally, the scheduling of the presentation threads.
+ *
+ * @param name       Name of the thread, as shown by tools such as top or perf.
+ * @param scheduling Scheduling of the thread or nullptr to keep the inherited one.
+ * @param function   Function the thread runs.
+ * @param args       Arguments of @p function.
+ *
+ * @return The thread. Throws the same exceptions as the constructor of std::thread.
+ */
+template <typename F, typename... Args>
+std::thread start_thread(const char *name, const thread_scheduling *scheduling, F &&function, Args &&...args)
+{
+   return std::thread(
+      [setup = thread_setup(name, scheduling)](auto &&function, auto &&...args) {
+         setup.apply();
+         std::invoke(std::forward<decltype(function)>(function), std::forward<decltype(args)>(args)...);
+      },
+      std::forward<F>(function), std::forward<Args>(args)...);
+}
+
+} /* namespace util */
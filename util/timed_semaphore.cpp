@@ -23,50 +23,31 @@
  */
 
 #include <cassert>
-#include <cerrno>
+#include <ctime>
 
+#include "futex.hpp"
 #include "timed_semaphore.hpp"
 
 namespace util
 {
 
-VkResult timed_semaphore::init(unsigned count)
+/**
+ * @brief Get the CLOCK_MONOTONIC time in nanoseconds.
+ */
+static uint64_t monotonic_time_ns()
 {
-   int res;
-
-   m_count = count;
-
-   pthread_condattr_t attr;
-   res = pthread_condattr_init(&attr);
-   /* the only failure that can occur is ENOMEM */
-   assert(res == 0 || res == ENOMEM);
-   if (res != 0)
-   {
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
-   }
-
-   res = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
-   /* only programming error can cause _setclock to fail */
-   assert(res == 0);
-
-   res = pthread_cond_init(&m_cond, &attr);
-   /* the only failure that can occur that is not programming error is ENOMEM */
-   assert(res == 0 || res == ENOMEM);
-   if (res != 0)
-   {
-      res = pthread_condattr_destroy(&attr);
-      assert(res == 0);
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
-   }
-
-   res = pthread_condattr_destroy(&attr);
-   /* only programming error can cause _destroy to fail */
-   assert(res == 0);
+   struct timespec now = {};
+   int res = clock_gettime(CLOCK_MONOTONIC, &now);
+   assert(res == 0); /* only fails with programming error (EINVAL, EFAULT, EPERM) */
+   (void)res;
 
-   res = pthread_mutex_init(&m_mutex, nullptr);
-   /* only programming errors can result in failure */
-   assert(res == 0);
+   return static_cast<uint64_t>(now.tv_sec) * 1000 * 1000 * 1000 + static_cast<uint64_t>(now.tv_nsec);
+}
 
+VkResult timed_semaphore::init(unsigned count)
+{
+   m_count.store(count, std::memory_order_relaxed);
+   m_waiters.store(0, std::memory_order_relaxed);
    initialized = true;
 
    return VK_SUCCESS;
@@ -74,97 +55,80 @@ VkResult timed_semaphore::init(unsigned count)
 
 timed_semaphore::~timed_semaphore()
 {
-   int res;
-   (void)res; /* unused when NDEBUG */
+   /* No thread may be waiting on a semaphore that is being destroyed. */
+   assert(!initialized || m_waiters.load(std::memory_order_relaxed) == 0);
+}
 
-   if (initialized)
+bool timed_semaphore::try_decrement()
+{
+   uint32_t count = m_count.load(std::memory_order_relaxed);
+   while (count > 0)
    {
-      res = pthread_cond_destroy(&m_cond);
-      assert(res == 0); /* only programming error (EBUSY, EINVAL) */
-
-      res = pthread_mutex_destroy(&m_mutex);
-      assert(res == 0); /* only programming error (EBUSY, EINVAL) */
+      if (m_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+      {
+         return true;
+      }
    }
+   return false;
 }
 
 VkResult timed_semaphore::wait(uint64_t timeout)
 {
-   VkResult retval = VK_SUCCESS;
-   int res;
-
    assert(initialized);
 
-   res = pthread_mutex_lock(&m_mutex);
-   assert(res == 0); /* only fails with programming error (EINVAL) */
+   if (try_decrement())
+   {
+      return VK_SUCCESS;
+   }
 
-   if (m_count == 0)
+   if (timeout == 0)
    {
-      switch (timeout)
-      {
-      case 0:
-         retval = VK_NOT_READY;
-         break;
-      case UINT64_MAX:
-         res = pthread_cond_wait(&m_cond, &m_mutex);
-         assert(res == 0); /* only fails with programming error (EINVAL) */
-
-         break;
-      default:
-         struct timespec diff = { /* narrowing casts */
-                                  static_cast<time_t>(timeout / (1000 * 1000 * 1000)),
-                                  static_cast<long>(timeout % (1000 * 1000 * 1000))
-         };
-
-         struct timespec now = {};
-         res = clock_gettime(CLOCK_MONOTONIC, &now);
-         assert(res == 0); /* only fails with programming error (EINVAL, EFAULT, EPERM) */
-
-         /* add diff to now, handling overflow */
-         struct timespec end = { now.tv_sec + diff.tv_sec, now.tv_nsec + diff.tv_nsec };
-
-         if (end.tv_nsec >= 1000 * 1000 * 1000)
-         {
-            end.tv_nsec -= 1000 * 1000 * 1000;
-            end.tv_sec++;
-         }
+      return VK_NOT_READY;
+   }
 
-         res = pthread_cond_timedwait(&m_cond, &m_mutex, &end);
-         /* only fails with programming error, other than timeout */
-         assert(res == 0 || res == ETIMEDOUT);
-         if (res != 0)
+   const uint64_t start = monotonic_time_ns();
+   VkResult retval = VK_SUCCESS;
+
+   /* Announce the waiter before re-checking the count, so that a concurrent post either sees the waiter and wakes it
+    * up, or makes its increment visible to the re-check. The fence keeps the relaxed load of the count in
+    * try_decrement from being ordered before the announcement. */
+   m_waiters.fetch_add(1, std::memory_order_seq_cst);
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   while (!try_decrement())
+   {
+      uint64_t remaining = UINT64_MAX;
+      if (timeout != UINT64_MAX)
+      {
+         const uint64_t elapsed = monotonic_time_ns() - start;
+         if (elapsed >= timeout)
          {
             retval = VK_TIMEOUT;
+            break;
          }
+         remaining = timeout - elapsed;
       }
+
+      /* Returns immediately if the count is no longer 0, spurious wake ups are handled by the loop. */
+      futex_wait(m_count, 0, remaining);
    }
-   if (retval == VK_SUCCESS)
-   {
-      assert(m_count > 0);
-      m_count--;
-   }
-   res = pthread_mutex_unlock(&m_mutex);
-   assert(res == 0); /* only fails with programming error (EPERM) */
+   m_waiters.fetch_sub(1, std::memory_order_relaxed);
 
    return retval;
 }
 
-void timed_semaphore::post()
+void timed_semaphore::post(uint32_t count)
 {
-   int res;
-   (void)res; /* unused when NDEBUG */
-
    assert(initialized);
+   if (count == 0)
+   {
+      return;
+   }
 
-   res = pthread_mutex_lock(&m_mutex);
-   assert(res == 0); /* only fails with programming error (EINVAL) */
-
-   m_count++;
-
-   res = pthread_cond_signal(&m_cond);
-   assert(res == 0); /* only fails with programming error (EINVAL) */
-
-   res = pthread_mutex_unlock(&m_mutex);
-   assert(res == 0); /* only fails with programming error (EPERM) */
+   m_count.fetch_add(count, std::memory_order_seq_cst);
+   if (m_waiters.load(std::memory_order_seq_cst) != 0)
+   {
+      futex_wake(m_count, count > INT32_MAX ? INT32_MAX : static_cast<int>(count));
+   }
 }
 
 } /* namespace util */
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017, 2019, 2024 Arm Limited.
+ * Copyright (c) 2017, 2019, 2024-2025 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -32,16 +32,15 @@
  * as the system time may change, resulting in an incorrect timeout period
  * (potentially by a significant amount).
  *
- * We therefore have to re-engineer semaphores using condition variables.
+ * We therefore have to re-engineer semaphores, here on top of a futex.
  *
  * This code does not use the C++ standard library to avoid exceptions.
  */
 
 #pragma once
 
-extern "C" {
-#include <pthread.h>
-}
+#include <atomic>
+#include <cstdint>
 
 #include <vulkan/vulkan.h>
 #include "helpers.hpp"
@@ -57,9 +56,9 @@ namespace util
  * as the system time may change, resulting in an incorrect timeout period
  * (potentially by a significant amount).
  *
- * We therefore have to re-engineer semaphores using condition variables.
- *
- * This code does not use the C++ standard library to avoid exceptions.
+ * The count is a futex word. Waiting while the count is non-zero and posting
+ * without waiters are a single atomic operation, and only a thread that has
+ * to block enters the kernel.
  */
 class timed_semaphore : private noncopyable
 {
@@ -72,7 +71,6 @@ public:
     * @brief initializes the semaphore
     *
     * @param count initial value of the semaphore
-    * @retval VK_ERROR_OUT_OF_HOST_MEMORY out of memory condition from pthread calls
     * @retval VK_SUCCESS on success
     */
    VkResult init(unsigned count);
@@ -88,24 +86,34 @@ public:
    VkResult wait(uint64_t timeout);
 
    /**
-    * @brief increment semaphore, potentially unblocking a waiting thread
+    * @brief increment semaphore, potentially unblocking waiting threads
+    *
+    * @param count value to add, posting several units at once takes a single atomic operation and wake up
     */
-   void post();
+   void post(uint32_t count = 1);
 
 private:
    /**
-    * @brief true if the semaphore has been initialized
+    * @brief Decrement the semaphore if its value is non-zero.
     *
-    * Determines if the destructor should cleanup the mutex and cond.
+    * @return true if the semaphore was decremented, false if its value was 0.
+    */
+   bool try_decrement();
+
+   /**
+    * @brief true if the semaphore has been initialized
     */
    bool initialized;
+
    /**
-    * @brief semaphore value
+    * @brief semaphore value, also used as the futex word
     */
-   unsigned m_count;
+   std::atomic<uint32_t> m_count{ 0 };
 
-   pthread_mutex_t m_mutex;
-   pthread_cond_t m_cond;
+   /**
+    * @brief number of threads blocked, or about to block, in @ref wait
+    */
+   std::atomic<uint32_t> m_waiters{ 0 };
 };
 
 } /* namespace util */
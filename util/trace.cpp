@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file trace.cpp
+ *
+ * @brief Contains the implementation of the tracing of the acquire and present pipeline to ftrace.
+ */
+
+#include "trace.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <initializer_list>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+namespace util
+{
+
+/**
+ * @brief Open the trace_marker file of the mounted tracefs, if any.
+ *
+ * @return The file descriptor, or -1 if tracing is not built in or no trace_marker file can be opened.
+ */
+static int open_trace_marker()
+{
+#if WSI_TRACING
+   for (const char *path : { "/sys/kernel/tracing/trace_marker", "/sys/kernel/debug/tracing/trace_marker" })
+   {
+      const int fd = open(path, O_WRONLY | O_CLOEXEC);
+      if (fd >= 0)
+      {
+         return fd;
+      }
+   }
+#endif
+   return -1;
+}
+
+int trace::s_marker_fd = open_trace_marker();
+
+/* The atrace events are tagged with the process ID, as they would be by Android's atrace. */
+static int process_id = getpid();
+
+/**
+ * @brief Tag the events of a forked child with its own process ID.
+ */
+static void update_process_id()
+{
+   process_id = getpid();
+}
+
+static const int process_id_updater = pthread_atfork(nullptr, nullptr, update_process_id);
+
+/**
+ * @brief Write an event to trace_marker, it is dropped if it does not fit in the buffer.
+ */
+template <typename... Args>
+static void write_event(int marker_fd, const char *format, Args... args)
+{
+   char event[256];
+   const int length = std::snprintf(event, sizeof(event), format, args...);
+   if (length > 0 && static_cast<size_t>(length) < sizeof(event))
+   {
+      if (write(marker_fd, event, static_cast<size_t>(length)) < 0)
+      {
+         /* A failed write only loses the event. */
+      }
+   }
+}
+
+void trace::begin(const char *name, uint64_t present_id)
+{
+   if (present_id != 0)
+   {
+      write_event(s_marker_fd, "B|%d|%s present_id=%" PRIu64, process_id, name, present_id);
+   }
+   else
+   {
+      write_event(s_marker_fd, "B|%d|%s", process_id, name);
+   }
+}
+
+void trace::end()
+{
+   write_event(s_marker_fd, "E|%d", process_id);
+}
+
+void trace::instant(const char *name, uint64_t present_id)
+{
+   begin(name, present_id);
+   end();
+}
+
+void trace::async_begin(const char *name, const void *object, uint64_t cookie)
+{
+   write_event(s_marker_fd, "S|%d|%s %p|%" PRIu64, process_id, name, object, cookie);
+}
+
+void trace::async_end(const char *name, const void *object, uint64_t cookie)
+{
+   write_event(s_marker_fd, "F|%d|%s %p|%" PRIu64, process_id, name, object, cookie);
+}
+
+} /* namespace util */
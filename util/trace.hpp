@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file trace.hpp
+ *
+ * @brief Contains the tracing of the acquire and present pipeline to ftrace.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "helpers.hpp"
+
+#ifndef WSI_TRACING
+#define WSI_TRACING 0
+#endif
+
+namespace util
+{
+
+/**
+ * @brief Writes the events of the acquire and present pipeline to the trace_marker file of ftrace.
+ *
+ * Only built with ENABLE_TRACING. The events use the atrace format, which Perfetto and systrace show as slices on the
+ * threads of the layer, next to the GPU, compositor and scheduler events they collect from ftrace. Events of a
+ * present carry its present ID, and the presentation of an image with a present ID is an asynchronous slice from
+ * vkQueuePresentKHR to its completion, so that the events of a frame can be followed across threads.
+ *
+ * The trace_marker file is opened when the layer is loaded. If it cannot be opened, every event costs a single
+ * branch.
+ */
+class trace
+{
+public:
+   /**
+    * @brief Check whether the events are written to ftrace.
+    */
+   static bool is_enabled()
+   {
+      return s_marker_fd >= 0;
+   }
+
+   /**
+    * @brief Begin a slice on the calling thread.
+    *
+    * @param name       Name of the slice.
+    * @param present_id Present ID of the present the slice belongs to, or 0.
+    */
+   static void begin(const char *name, uint64_t present_id);
+
+   /**
+    * @brief End the last slice begun on the calling thread.
+    */
+   static void end();
+
+   /**
+    * @brief Write an event of no duration on the calling thread.
+    *
+    * @param name       Name of the event.
+    * @param present_id Present ID of the present the event belongs to, or 0.
+    */
+   static void instant(const char *name, uint64_t present_id);
+
+   /**
+    * @brief Begin a slice that may end on another thread.
+    *
+    * @param name   Name of the slice.
+    * @param object The object the slice belongs to, e.g. a swapchain.
+    * @param cookie Value identifying the slice among the ones of @p object with the same name.
+    */
+   static void async_begin(const char *name, const void *object, uint64_t cookie);
+
+   /**
+    * @brief End a slice begun by @ref async_begin.
+    */
+   static void async_end(const char *name, const void *object, uint64_t cookie);
+
+   /**
+    * @brief Slice on the calling thread for as long as it exists.
+    */
+   class scope : private noncopyable
+   {
+   public:
+      scope(const char *name, uint64_t present_id)
+         : m_enabled{ is_enabled() }
+      {
+         if (m_enabled)
+         {
+            begin(name, present_id);
+         }
+      }
+
+      ~scope()
+      {
+         if (m_enabled)
+         {
+            end();
+         }
+      }
+
+   private:
+      bool m_enabled;
+   };
+
+private:
+   static int s_marker_fd;
+};
+
+} /* namespace util */
+
+#if WSI_TRACING
+#define WSI_TRACE_SCOPE(name, present_id) ::util::trace::scope trace_scope{ name, present_id }
+#define WSI_TRACE_EVENT(name, present_id)          \
+   do                                              \
+   {                                               \
+      if (::util::trace::is_enabled())             \
+      {                                            \
+         ::util::trace::instant(name, present_id); \
+      }                                            \
+   } while (0)
+#define WSI_TRACE_ASYNC_BEGIN(name, object, cookie)        \
+   do                                                      \
+   {                                                       \
+      if (::util::trace::is_enabled())                     \
+      {                                                    \
+         ::util::trace::async_begin(name, object, cookie); \
+      }                                                    \
+   } while (0)
+#define WSI_TRACE_ASYNC_END(name, object, cookie)        \
+   do                                                    \
+   {                                                     \
+      if (::util::trace::is_enabled())                   \
+      {                                                  \
+         ::util::trace::async_end(name, object, cookie); \
+      }                                                  \
+   } while (0)
+#else
+#define WSI_TRACE_SCOPE(name, present_id) \
+   do                                     \
+   {                                      \
+   } while (0)
+#define WSI_TRACE_EVENT(name, present_id) \
+   do                                     \
+   {                                      \
+   } while (0)
+#define WSI_TRACE_ASYNC_BEGIN(name, object, cookie) \
+   do                                               \
+   {                                                \
+   } while (0)
+#define WSI_TRACE_ASYNC_END(name, object, cookie) \
+   do                                             \
+   {                                              \
+   } while (0)
+#endif
@@ -64,8 +64,13 @@ extern "C" {
  * 2 - Added WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION
  * 3 - Grouped the return values of wsialloc_alloc to wsialloc_allocate_result and added another value for returning
  *     whether or not the allocation will be disjoint.
+ * 4 - Added an opt-in cache of released buffers: wsialloc_set_cache_budget(), wsialloc_release() and
+ *     wsialloc_cache_trim().
+ * 5 - Added wsialloc_alloc_batch().
+ * 6 - Added the WSIALLOC_ALLOCATE_USAGE_* hints for selecting the memory a buffer is allocated from.
+ * 7 - Added wsialloc_new_for_device().
  */
-#define WSIALLOC_INTERFACE_VERSION 3
+#define WSIALLOC_INTERFACE_VERSION 7
 
 #define WSIALLOC_CONCAT(x, y) x##y
 #define WSIALLOC_SYMBOL_VERSION(symbol, version) WSIALLOC_CONCAT(symbol, version)
@@ -124,6 +129,22 @@ typedef enum wsialloc_error
  */
 wsialloc_error wsialloc_new(wsialloc_allocator **allocator);
 
+/**
+ * @brief Allocate and initialize a new WSI Allocator for the buffers of a device.
+ *
+ * Implementations allocating from a DRM device use the render node of the device the buffers are rendered by,
+ * unless they were configured with a device at build time. Others behave like wsialloc_new().
+ *
+ * @param[out] allocator    a valid allocator for use in wsialloc functions.
+ * @param      render_major Major number of the render node of the device, as reported by
+ *                          VkPhysicalDeviceDrmPropertiesEXT.
+ * @param      render_minor Minor number of the render node of the device.
+ *
+ * @retval WSIALLOC_ERROR_NONE          on successful allocator creation.
+ * @retval WSIALLOC_ERROR_FAILED        on failed allocator creation.
+ */
+wsialloc_error wsialloc_new_for_device(wsialloc_allocator **allocator, int64_t render_major, int64_t render_minor);
+
 /**
  * @brief Close down and free resources associated with a WSI Allocator
  *
@@ -154,6 +175,17 @@ enum wsialloc_allocate_flag
    WSIALLOC_ALLOCATE_NO_MEMORY = 0x2,
    /** Sets a preference for selecting the format with the highest fixed compression rate. */
    WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION = 0x4,
+   /**
+    * Usage hints. They let the implementation pick the memory best suited to how the buffer is used, e.g. physically
+    * contiguous memory for scanout. Implementations may ignore them, and fall back to their default memory when the
+    * preferred memory is not available. WSIALLOC_ALLOCATE_PROTECTED takes precedence over all of them.
+    */
+   /** The buffer is scanned out directly by a display controller. */
+   WSIALLOC_ALLOCATE_USAGE_SCANOUT = 0x8,
+   /** The buffer is composited by a window system, which samples it with a GPU. */
+   WSIALLOC_ALLOCATE_USAGE_COMPOSITE = 0x10,
+   /** The buffer contents are read back on the CPU. */
+   WSIALLOC_ALLOCATE_USAGE_CPU_READBACK = 0x20,
 };
 
 typedef struct wsialloc_format
@@ -229,7 +261,8 @@ typedef struct wsialloc_allocate_result
  * are pointers to storage large enough to hold per-plane information.
  * @pre @p info::width >=1 && @p info::height >= 1
  * @pre @p allocator is a currently valid WSI Allocator from wsialloc_new()
- * @post The allocated buffer will be zeroed.
+ * @post The allocated buffer will be zeroed, unless it was served from the cache of released buffers (see
+ * wsialloc_set_cache_budget()), in which case it keeps the contents it had when it was passed to wsialloc_release().
  *
  * @param      allocator  The WSI Allocator to allocate from.
  * @param[in]  info       The requested allocation information.
@@ -246,6 +279,66 @@ typedef struct wsialloc_allocate_result
 wsialloc_error wsialloc_alloc(wsialloc_allocator *allocator, const wsialloc_allocate_info *info,
                               wsialloc_allocate_result *result);
 
+/**
+ * @brief Allocate several buffers of the same size and format from the WSI Allocator
+ *
+ * Behaves like @p count calls to wsialloc_alloc() with the same @p info, except that the format is selected only once
+ * and every buffer uses the same format, strides and plane offsets. Each buffer is returned with its own file
+ * descriptors and is freed independently of the others.
+ *
+ * @pre @p results is an array of @p count elements, each satisfying the requirements of wsialloc_alloc() on result.
+ * @post On failure, no buffer is left allocated.
+ *
+ * @param      allocator  The WSI Allocator to allocate from.
+ * @param[in]  info       The requested allocation information, shared by all the buffers.
+ * @param      count      The number of buffers to allocate. Must be greater than 0.
+ * @param[out] results    The allocation results, one per buffer.
+ *
+ * @return The same values as wsialloc_alloc().
+ */
+wsialloc_error wsialloc_alloc_batch(wsialloc_allocator *allocator, const wsialloc_allocate_info *info, uint32_t count,
+                                    wsialloc_allocate_result *results);
+
+/**
+ * @brief Set the byte budget of the allocator's cache of released buffers.
+ *
+ * The cache is disabled by default. While it is enabled, wsialloc_alloc() hands out a buffer previously given back
+ * with wsialloc_release() when one of the same size was allocated with the same memory selecting flags (e.g.
+ * WSIALLOC_ALLOCATE_PROTECTED), skipping the allocation and zeroing of new memory by the kernel. The least recently
+ * released buffers are closed whenever the cache would exceed its budget.
+ *
+ * @param allocator The WSI Allocator.
+ * @param budget    Maximum number of bytes the cache may hold. 0 disables the cache and closes every cached buffer.
+ *
+ * @retval WSIALLOC_ERROR_NONE          on success.
+ * @retval WSIALLOC_ERROR_NOT_SUPPORTED if the implementation does not cache buffers.
+ */
+wsialloc_error wsialloc_set_cache_budget(wsialloc_allocator *allocator, uint64_t budget);
+
+/**
+ * @brief Give a buffer back to the WSI Allocator.
+ *
+ * This is an alternative to close() for freeing a buffer allocated with wsialloc_alloc(). When the cache is enabled,
+ * the buffer may be kept and handed out again by a later allocation, otherwise it is closed. The client must not
+ * use @p fd after this call, and must not release a buffer that is still in use, e.g. by the window system.
+ *
+ * @pre @p fd is a unique fd from @p result::buffer_fds of an allocation made from @p allocator, or a duplicate of one
+ * that is no longer referenced by any other fd.
+ *
+ * @param allocator The WSI Allocator the buffer was allocated from.
+ * @param flags     The @p info::flags the buffer was allocated with.
+ * @param fd        The buffer to release. Ownership is transferred to the allocator.
+ */
+void wsialloc_release(wsialloc_allocator *allocator, uint64_t flags, int fd);
+
+/**
+ * @brief Close the least recently released cached buffers until the cache holds at most @p max_bytes.
+ *
+ * @param allocator The WSI Allocator.
+ * @param max_bytes Number of bytes the cache may still hold. 0 empties the cache.
+ */
+void wsialloc_cache_trim(wsialloc_allocator *allocator, uint64_t max_bytes);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -28,8 +28,10 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
@@ -43,7 +45,7 @@
  *
  * This should only be increased when this implementation is updated to match newer versions of wsialloc.h.
  */
-#define WSIALLOC_IMPLEMENTATION_VERSION 3
+#define WSIALLOC_IMPLEMENTATION_VERSION 7
 
 /* Ensure we are implementing the wsialloc version matching the wsialloc.h header we are using. */
 #if WSIALLOC_IMPLEMENTATION_VERSION != WSIALLOC_INTERFACE_VERSION
@@ -56,6 +58,20 @@ const uint32_t WSIALLOC_IMPLEMENTATION_VERSION_SYMBOL = WSIALLOC_IMPLEMENTATION_
 #define STR_EXPAND(tok...) #tok
 #define STR(tok) STR_EXPAND(tok)
 
+/* Heaps preferred for specific buffer usages. An empty name means the usage is served from the memory heap. */
+#ifndef WSIALLOC_SCANOUT_HEAP_NAME
+#define WSIALLOC_SCANOUT_HEAP_NAME
+#endif
+#ifndef WSIALLOC_COMPOSITE_HEAP_NAME
+#define WSIALLOC_COMPOSITE_HEAP_NAME
+#endif
+#ifndef WSIALLOC_CPU_READBACK_HEAP_NAME
+#define WSIALLOC_CPU_READBACK_HEAP_NAME
+#endif
+#ifndef WSIALLOC_PROTECTED_HEAP_NAME
+#define WSIALLOC_PROTECTED_HEAP_NAME
+#endif
+
 struct wsialloc_allocator
 {
    /* File descriptor for a DMA-BUF heap for allocating memory accessible to
@@ -67,6 +83,16 @@ struct wsialloc_allocator
     * accessible to the windowing system.
     */
    int protected_fd;
+
+   /* File descriptors of the heaps preferred for WSIALLOC_ALLOCATE_USAGE_SCANOUT, WSIALLOC_ALLOCATE_USAGE_COMPOSITE
+    * and WSIALLOC_ALLOCATE_USAGE_CPU_READBACK buffers, or -1 to use memory_fd.
+    */
+   int scanout_fd;
+   int composite_fd;
+   int cpu_readback_fd;
+
+   /* Buffers released by the client, kept for reuse by later allocations. */
+   wsiallocp_cache cache;
 };
 
 static int allocate(int fd, uint64_t size)
@@ -88,7 +114,29 @@ static int allocate(int fd, uint64_t size)
    return heap_data.fd;
 }
 
-static int dma_allocate(const wsialloc_allocator *allocator, const wsialloc_allocate_info *info, uint64_t size)
+/* Pick the heap for an allocation, -1 if there is none. Protected allocations never fall back to another heap. */
+static int select_heap(const wsialloc_allocator *allocator, uint64_t flags)
+{
+   if (flags & WSIALLOC_ALLOCATE_PROTECTED)
+   {
+      return allocator->protected_fd;
+   }
+   if ((flags & WSIALLOC_ALLOCATE_USAGE_SCANOUT) && allocator->scanout_fd >= 0)
+   {
+      return allocator->scanout_fd;
+   }
+   if ((flags & WSIALLOC_ALLOCATE_USAGE_CPU_READBACK) && allocator->cpu_readback_fd >= 0)
+   {
+      return allocator->cpu_readback_fd;
+   }
+   if ((flags & WSIALLOC_ALLOCATE_USAGE_COMPOSITE) && allocator->composite_fd >= 0)
+   {
+      return allocator->composite_fd;
+   }
+   return allocator->memory_fd;
+}
+
+static int dma_allocate(wsialloc_allocator *allocator, const wsialloc_allocate_info *info, uint64_t size)
 {
    assert(allocator != NULL);
    assert(info != NULL);
@@ -96,20 +144,61 @@ static int dma_allocate(const wsialloc_allocator *allocator, const wsialloc_allo
 
    /* The only error that can be encountered on allocations is lack of resources. Other parameter validation and
     * support checks are done on format selection. */
-   int alloc_fd = allocator->memory_fd;
-   if (info->flags & WSIALLOC_ALLOCATE_PROTECTED)
-   {
-      alloc_fd = allocator->protected_fd;
-   }
+   int alloc_fd = select_heap(allocator, info->flags);
    if (alloc_fd < 0)
    {
       assert(false);
       return -1;
    }
 
+   const int cached_fd = wsiallocp_cache_take(&allocator->cache, info->flags, size);
+   if (cached_fd >= 0)
+   {
+      return cached_fd;
+   }
+
    return allocate(alloc_fd, size);
 }
 
+/* Open the DMA-BUF heap called @p name, returns -1 if it cannot be opened or the name is empty. */
+static int open_heap(const char *name)
+{
+   if (name[0] == '\0')
+   {
+      return -1;
+   }
+
+   char path[PATH_MAX];
+   if (snprintf(path, sizeof(path), "/dev/dma_heap/%s", name) >= (int)sizeof(path))
+   {
+      return -1;
+   }
+   return open(path, O_RDWR | O_CLOEXEC);
+}
+
+static void close_fd(int fd)
+{
+   if (fd >= 0)
+   {
+      close(fd);
+   }
+}
+
+static void close_heaps(wsialloc_allocator *allocator)
+{
+   close_fd(allocator->memory_fd);
+   close_fd(allocator->protected_fd);
+   close_fd(allocator->scanout_fd);
+   close_fd(allocator->composite_fd);
+   close_fd(allocator->cpu_readback_fd);
+
+   allocator->memory_fd = -1;
+   allocator->protected_fd = -1;
+   allocator->scanout_fd = -1;
+   allocator->composite_fd = -1;
+   allocator->cpu_readback_fd = -1;
+}
+
 wsialloc_error wsialloc_new(wsialloc_allocator **allocator)
 {
    assert(allocator != NULL);
@@ -120,25 +209,36 @@ wsialloc_error wsialloc_new(wsialloc_allocator **allocator)
       return WSIALLOC_ERROR_NO_RESOURCE;
    }
 
-   dma_buf_heaps->memory_fd = open("/dev/dma_heap/" STR(WSIALLOC_MEMORY_HEAP_NAME), O_RDWR);
-   dma_buf_heaps->protected_fd = -1;
-
+   dma_buf_heaps->memory_fd = open_heap(STR(WSIALLOC_MEMORY_HEAP_NAME));
    if (dma_buf_heaps->memory_fd < 0)
    {
       free(dma_buf_heaps);
       return WSIALLOC_ERROR_NO_RESOURCE;
    }
 
+   /* The other heaps are optional, a missing one leaves its usages to the memory heap. */
+   dma_buf_heaps->protected_fd = open_heap(STR(WSIALLOC_PROTECTED_HEAP_NAME));
+   dma_buf_heaps->scanout_fd = open_heap(STR(WSIALLOC_SCANOUT_HEAP_NAME));
+   dma_buf_heaps->composite_fd = open_heap(STR(WSIALLOC_COMPOSITE_HEAP_NAME));
+   dma_buf_heaps->cpu_readback_fd = open_heap(STR(WSIALLOC_CPU_READBACK_HEAP_NAME));
+
+   if (wsiallocp_cache_init(&dma_buf_heaps->cache) != WSIALLOC_ERROR_NONE)
+   {
+      close_heaps(dma_buf_heaps);
+      free(dma_buf_heaps);
+      return WSIALLOC_ERROR_NO_RESOURCE;
+   }
+
    *allocator = dma_buf_heaps;
    return WSIALLOC_ERROR_NONE;
 }
 
-static void close_fd(int fd)
+wsialloc_error wsialloc_new_for_device(wsialloc_allocator **allocator, int64_t render_major, int64_t render_minor)
 {
-   if (fd >= 0)
-   {
-      close(fd);
-   }
+   /* Heaps are not tied to a device. */
+   (void)render_major;
+   (void)render_minor;
+   return wsialloc_new(allocator);
 }
 
 void wsialloc_delete(wsialloc_allocator *allocator)
@@ -149,26 +249,55 @@ void wsialloc_delete(wsialloc_allocator *allocator)
       return;
    }
 
-   close_fd(allocator->memory_fd);
-   close_fd(allocator->protected_fd);
-
-   allocator->memory_fd = -1;
-   allocator->protected_fd = -1;
+   wsiallocp_cache_destroy(&allocator->cache);
+   close_heaps(allocator);
 
    free(allocator);
 }
 
+static bool has_heap_for(const wsialloc_allocator *allocator, const wsialloc_allocate_info *info)
+{
+   return select_heap(allocator, info->flags) >= 0;
+}
+
 wsialloc_error wsialloc_alloc(wsialloc_allocator *allocator, const wsialloc_allocate_info *info,
                               wsialloc_allocate_result *result)
 {
-   int fd_to_use = allocator->memory_fd;
-   if (info->flags & WSIALLOC_ALLOCATE_PROTECTED)
+   if (!has_heap_for(allocator, info))
    {
-      fd_to_use = allocator->protected_fd;
+      return WSIALLOC_ERROR_NO_RESOURCE;
    }
-   if (fd_to_use < 0)
+   return wsiallocp_alloc(allocator, dma_allocate, info, result);
+}
+
+wsialloc_error wsialloc_alloc_batch(wsialloc_allocator *allocator, const wsialloc_allocate_info *info, uint32_t count,
+                                    wsialloc_allocate_result *results)
+{
+   if (!has_heap_for(allocator, info))
    {
       return WSIALLOC_ERROR_NO_RESOURCE;
    }
-   return wsiallocp_alloc(allocator, dma_allocate, info, result);
+   return wsiallocp_alloc_batch(allocator, dma_allocate, info, count, results);
+}
+
+wsialloc_error wsialloc_set_cache_budget(wsialloc_allocator *allocator, uint64_t budget)
+{
+   assert(allocator != NULL);
+   wsiallocp_cache_set_budget(&allocator->cache, budget);
+   return WSIALLOC_ERROR_NONE;
+}
+
+void wsialloc_release(wsialloc_allocator *allocator, uint64_t flags, int fd)
+{
+   assert(allocator != NULL);
+   if (fd >= 0)
+   {
+      wsiallocp_cache_put(&allocator->cache, flags, fd);
+   }
+}
+
+void wsialloc_cache_trim(wsialloc_allocator *allocator, uint64_t max_bytes)
+{
+   assert(allocator != NULL);
+   wsiallocp_cache_trim(&allocator->cache, max_bytes);
 }
@@ -0,0 +1,408 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "wsialloc.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <gbm.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#include <xf86drm.h>
+
+/**
+ * @brief Version of the wsialloc interface we are implementing in this file.
+ *
+ * This should only be increased when this implementation is updated to match newer versions of wsialloc.h.
+ */
+#define WSIALLOC_IMPLEMENTATION_VERSION 7
+
+/* Ensure we are implementing the wsialloc version matching the wsialloc.h header we are using. */
+#if WSIALLOC_IMPLEMENTATION_VERSION != WSIALLOC_INTERFACE_VERSION
+#error "Version mismatch between wsialloc implementation and interface version"
+#endif
+
+const uint32_t WSIALLOC_IMPLEMENTATION_VERSION_SYMBOL = WSIALLOC_IMPLEMENTATION_VERSION;
+
+/* Some string may contain commas, setting the macro as variadic */
+#define STR_EXPAND(tok...) #tok
+#define STR(tok) STR_EXPAND(tok)
+
+/** Maximum number of modifiers passed to GBM for a single fourcc. */
+#define MAX_MODIFIERS_PER_FORMAT 64
+
+/** Maximum image size allowed for each dimension */
+#define MAX_IMAGE_SIZE 128000
+
+struct wsialloc_allocator
+{
+   /* File descriptor of the DRM device GBM allocates from. */
+   int drm_fd;
+
+   /* GBM device created on drm_fd. */
+   struct gbm_device *device;
+};
+
+/**
+ * @brief Open the render node of a DRM device.
+ *
+ * @param device The device, or NULL for the first device with a render node.
+ *
+ * @return The file descriptor of the render node, or -1 on failure.
+ */
+static int open_render_node(drmDevicePtr device)
+{
+   drmDevicePtr devices[64];
+   int count = 1;
+   if (device == NULL)
+   {
+      count = drmGetDevices2(0, devices, sizeof(devices) / sizeof(devices[0]));
+   }
+   else
+   {
+      devices[0] = device;
+   }
+
+   int fd = -1;
+   for (int i = 0; i < count && fd < 0; i++)
+   {
+      if ((devices[i]->available_nodes & (1 << DRM_NODE_RENDER)) != 0)
+      {
+         fd = open(devices[i]->nodes[DRM_NODE_RENDER], O_RDWR | O_CLOEXEC);
+      }
+   }
+
+   if (device == NULL && count > 0)
+   {
+      drmFreeDevices(devices, count);
+   }
+   return fd;
+}
+
+/**
+ * @brief Create an allocator on an open DRM device, taking ownership of @p drm_fd.
+ */
+static wsialloc_error new_allocator(int drm_fd, wsialloc_allocator **allocator)
+{
+   if (drm_fd < 0)
+   {
+      return WSIALLOC_ERROR_NO_RESOURCE;
+   }
+
+   wsialloc_allocator *gbm = malloc(sizeof(*gbm));
+   if (NULL == gbm)
+   {
+      close(drm_fd);
+      return WSIALLOC_ERROR_NO_RESOURCE;
+   }
+
+   gbm->drm_fd = drm_fd;
+   gbm->device = gbm_create_device(gbm->drm_fd);
+   if (gbm->device == NULL)
+   {
+      close(gbm->drm_fd);
+      free(gbm);
+      return WSIALLOC_ERROR_NO_RESOURCE;
+   }
+
+   *allocator = gbm;
+   return WSIALLOC_ERROR_NONE;
+}
+
+/** Whether a device was chosen at build time, which takes precedence over the device of the swapchain. */
+static bool has_device_override(void)
+{
+   return sizeof(STR(WSIALLOC_GBM_DEVICE)) > 1;
+}
+
+wsialloc_error wsialloc_new(wsialloc_allocator **allocator)
+{
+   assert(allocator != NULL);
+
+   if (has_device_override())
+   {
+      return new_allocator(open(STR(WSIALLOC_GBM_DEVICE), O_RDWR | O_CLOEXEC), allocator);
+   }
+   return new_allocator(open_render_node(NULL), allocator);
+}
+
+wsialloc_error wsialloc_new_for_device(wsialloc_allocator **allocator, int64_t render_major, int64_t render_minor)
+{
+   assert(allocator != NULL);
+
+   drmDevicePtr device = NULL;
+   if (has_device_override() ||
+       drmGetDeviceFromDevId(makedev((unsigned int)render_major, (unsigned int)render_minor), 0, &device) != 0)
+   {
+      return wsialloc_new(allocator);
+   }
+
+   const int drm_fd = open_render_node(device);
+   drmFreeDevice(&device);
+   return new_allocator(drm_fd, allocator);
+}
+
+void wsialloc_delete(wsialloc_allocator *allocator)
+{
+   assert(allocator != NULL);
+   if (NULL == allocator)
+   {
+      return;
+   }
+
+   /* Buffer objects are destroyed as soon as they are exported, so the device has no users left. The exported
+    * dma-bufs outlive it. */
+   gbm_device_destroy(allocator->device);
+   close(allocator->drm_fd);
+
+   free(allocator);
+}
+
+static uint32_t get_bo_flags(uint64_t flags)
+{
+   uint32_t bo_flags = GBM_BO_USE_RENDERING;
+   if (flags & WSIALLOC_ALLOCATE_PROTECTED)
+   {
+      bo_flags |= GBM_BO_USE_PROTECTED;
+   }
+   if (flags & WSIALLOC_ALLOCATE_USAGE_SCANOUT)
+   {
+      bo_flags |= GBM_BO_USE_SCANOUT;
+   }
+   return bo_flags;
+}
+
+/**
+ * @brief Create a buffer object for the first fourcc in @p info::formats that GBM can allocate.
+ *
+ * All the modifiers listed for a fourcc are given to GBM at once, letting the driver pick the optimal one, e.g. a
+ * tiled or compressed layout, among those the other users of the buffer can import.
+ * With WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION, the first modifier listed for the fourcc, which the caller
+ * prefers for its compression, is tried on its own first.
+ *
+ * @param      allocator      The allocator.
+ * @param      info           The requested allocation info.
+ * @param[out] selected_index Index in @p info::formats of the format that was allocated.
+ *
+ * @return The buffer object, or NULL when none of the formats could be allocated.
+ */
+static struct gbm_bo *create_bo(const wsialloc_allocator *allocator, const wsialloc_allocate_info *info,
+                                unsigned *selected_index)
+{
+   const uint32_t bo_flags = get_bo_flags(info->flags);
+   for (unsigned i = 0; i < info->format_count; i++)
+   {
+      const uint32_t fourcc = info->formats[i].fourcc;
+
+      /* Each fourcc is tried once, with the modifiers of all its entries. */
+      bool tried = false;
+      for (unsigned j = 0; j < i && !tried; j++)
+      {
+         tried = info->formats[j].fourcc == fourcc;
+      }
+      if (tried)
+      {
+         continue;
+      }
+
+      uint64_t modifiers[MAX_MODIFIERS_PER_FORMAT];
+      unsigned modifier_count = 0;
+      for (unsigned j = i; j < info->format_count && modifier_count < MAX_MODIFIERS_PER_FORMAT; j++)
+      {
+         if (info->formats[j].fourcc == fourcc)
+         {
+            modifiers[modifier_count++] = info->formats[j].modifier;
+         }
+      }
+
+      struct gbm_bo *bo = NULL;
+      if ((info->flags & WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION) && modifier_count > 1)
+      {
+         bo = gbm_bo_create_with_modifiers2(allocator->device, info->width, info->height, fourcc, modifiers, 1,
+                                            bo_flags);
+      }
+      if (bo == NULL)
+      {
+         bo = gbm_bo_create_with_modifiers2(allocator->device, info->width, info->height, fourcc, modifiers,
+                                            modifier_count, bo_flags);
+      }
+      if (bo == NULL)
+      {
+         continue;
+      }
+
+      const uint64_t modifier = gbm_bo_get_modifier(bo);
+      for (unsigned j = i; j < info->format_count; j++)
+      {
+         if (info->formats[j].fourcc == fourcc && info->formats[j].modifier == modifier)
+         {
+            *selected_index = j;
+            return bo;
+         }
+      }
+
+      /* The driver picked a modifier that was not offered, which the other users cannot import. */
+      gbm_bo_destroy(bo);
+   }
+
+   return NULL;
+}
+
+static wsialloc_error allocate_buffer(const wsialloc_allocator *allocator, const wsialloc_allocate_info *info,
+                                      wsialloc_allocate_result *result)
+{
+   unsigned selected_index = 0;
+   struct gbm_bo *bo = create_bo(allocator, info, &selected_index);
+   if (bo == NULL)
+   {
+      return WSIALLOC_ERROR_NOT_SUPPORTED;
+   }
+
+   const int plane_count = gbm_bo_get_plane_count(bo);
+   if (plane_count < 1 || plane_count > WSIALLOC_MAX_PLANES)
+   {
+      gbm_bo_destroy(bo);
+      return WSIALLOC_ERROR_NOT_SUPPORTED;
+   }
+
+   for (int plane = 0; plane < plane_count; plane++)
+   {
+      result->average_row_strides[plane] = (int)gbm_bo_get_stride_for_plane(bo, plane);
+      result->offsets[plane] = gbm_bo_get_offset(bo, plane);
+   }
+   result->format = info->formats[selected_index];
+   result->is_disjoint = false;
+
+   /* The layout is only known once the driver has allocated the buffer object, so format selection without memory
+    * still allocates it and then releases it straight away. */
+   if (!(info->flags & WSIALLOC_ALLOCATE_NO_MEMORY))
+   {
+      /* All the planes of a buffer object share one dma-buf. */
+      const int fd = gbm_bo_get_fd(bo);
+      if (fd < 0)
+      {
+         gbm_bo_destroy(bo);
+         return WSIALLOC_ERROR_NO_RESOURCE;
+      }
+
+      assert(result->buffer_fds != NULL);
+      for (int plane = 0; plane < plane_count; plane++)
+      {
+         result->buffer_fds[plane] = fd;
+      }
+   }
+
+   gbm_bo_destroy(bo);
+   return WSIALLOC_ERROR_NONE;
+}
+
+static bool validate_parameters(const wsialloc_allocator *allocator, const wsialloc_allocate_info *info,
+                                const wsialloc_allocate_result *result)
+{
+   if (allocator == NULL || info == NULL || result == NULL)
+   {
+      return false;
+   }
+   else if (info->format_count == 0 || info->formats == NULL)
+   {
+      return false;
+   }
+   else if (info->width < 1 || info->height < 1 || info->width > MAX_IMAGE_SIZE || info->height > MAX_IMAGE_SIZE)
+   {
+      return false;
+   }
+
+   return true;
+}
+
+wsialloc_error wsialloc_alloc(wsialloc_allocator *allocator, const wsialloc_allocate_info *info,
+                              wsialloc_allocate_result *result)
+{
+   return wsialloc_alloc_batch(allocator, info, 1, result);
+}
+
+wsialloc_error wsialloc_alloc_batch(wsialloc_allocator *allocator, const wsialloc_allocate_info *info, uint32_t count,
+                                    wsialloc_allocate_result *results)
+{
+   if (count == 0 || !validate_parameters(allocator, info, results))
+   {
+      return WSIALLOC_ERROR_INVALID;
+   }
+
+   wsialloc_error err = allocate_buffer(allocator, info, &results[0]);
+   if (err != WSIALLOC_ERROR_NONE)
+   {
+      return err;
+   }
+
+   /* Every other buffer is allocated with the format and modifier selected for the first one. */
+   wsialloc_allocate_info selected_info = *info;
+   selected_info.formats = &results[0].format;
+   selected_info.format_count = 1;
+   for (uint32_t i = 1; i < count; i++)
+   {
+      err = allocate_buffer(allocator, &selected_info, &results[i]);
+      if (err != WSIALLOC_ERROR_NONE)
+      {
+         /* Do not leave the client with a partial batch. */
+         if (!(info->flags & WSIALLOC_ALLOCATE_NO_MEMORY))
+         {
+            for (uint32_t j = 0; j < i; j++)
+            {
+               close(results[j].buffer_fds[0]);
+            }
+         }
+         return err == WSIALLOC_ERROR_NOT_SUPPORTED ? WSIALLOC_ERROR_NO_RESOURCE : err;
+      }
+   }
+
+   return WSIALLOC_ERROR_NONE;
+}
+
+wsialloc_error wsialloc_set_cache_budget(wsialloc_allocator *allocator, uint64_t budget)
+{
+   assert(allocator != NULL);
+
+   /* Buffers cannot be matched to a request before the driver has chosen their layout, so none are cached. */
+   return budget == 0 ? WSIALLOC_ERROR_NONE : WSIALLOC_ERROR_NOT_SUPPORTED;
+}
+
+void wsialloc_release(wsialloc_allocator *allocator, uint64_t flags, int fd)
+{
+   assert(allocator != NULL);
+   (void)flags;
+   if (fd >= 0)
+   {
+      close(fd);
+   }
+}
+
+void wsialloc_cache_trim(wsialloc_allocator *allocator, uint64_t max_bytes)
+{
+   assert(allocator != NULL);
+   (void)max_bytes;
+}
@@ -26,6 +26,9 @@
 #include "format_table.h"
 
 #include <assert.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
 
 /** Default alignment */
 #define WSIALLOCP_MIN_ALIGN_SZ (64u)
@@ -130,20 +133,19 @@ static bool validate_parameters(const wsialloc_allocator *allocator, const wsial
    return true;
 }
 
-wsialloc_error wsiallocp_alloc(wsialloc_allocator *allocator, wsiallocp_alloc_callback fn_alloc,
-                               const wsialloc_allocate_info *info, wsialloc_allocate_result *result)
+/**
+ * @brief Pick the first format of @p info that the allocator can lay out and fill in the layout of @p result.
+ *
+ * @p result::buffer_fds are left untouched.
+ */
+static wsialloc_error select_format(const wsialloc_allocate_info *info, wsialloc_allocate_result *result,
+                                    uint32_t *nr_planes, uint64_t *total_size)
 {
-   if (!validate_parameters(allocator, info, result))
-   {
-      return WSIALLOC_ERROR_INVALID;
-   }
-
    int local_strides[WSIALLOC_MAX_PLANES];
-   int local_offsets[WSIALLOC_MAX_PLANES];
+   uint32_t local_offsets[WSIALLOC_MAX_PLANES];
    wsialloc_error err = WSIALLOC_ERROR_NONE;
    wsialloc_format_descriptor selected_format_desc = {};
 
-   uint64_t total_size = 0;
    for (size_t i = 0; i < info->format_count; i++)
    {
       const wsialloc_format *current_format = &info->formats[i];
@@ -155,7 +157,7 @@ wsialloc_error wsiallocp_alloc(wsialloc_allocator *allocator, wsiallocp_alloc_ca
       }
 
       wsialloc_format_descriptor current_format_desc = { *current_format, *format_spec };
-      err = calculate_format_properties(&current_format_desc, info, local_strides, local_offsets, &total_size);
+      err = calculate_format_properties(&current_format_desc, info, local_strides, local_offsets, total_size);
       if (err != WSIALLOC_ERROR_NONE)
       {
          continue;
@@ -171,29 +173,211 @@ wsialloc_error wsiallocp_alloc(wsialloc_allocator *allocator, wsiallocp_alloc_ca
       return err;
    }
 
-   int local_fds[WSIALLOC_MAX_PLANES] = { -1, -1, -1, -1 };
-   if (!(info->flags & WSIALLOC_ALLOCATE_NO_MEMORY))
+   result->format = selected_format_desc.format;
+   for (size_t plane = 0; plane < selected_format_desc.format_spec.nr_planes; plane++)
    {
-      local_fds[0] = fn_alloc(allocator, info, total_size);
-      if (local_fds[0] < 0)
+      result->average_row_strides[plane] = local_strides[plane];
+      result->offsets[plane] = local_offsets[plane];
+   }
+
+   result->is_disjoint = false;
+   *nr_planes = selected_format_desc.format_spec.nr_planes;
+   return WSIALLOC_ERROR_NONE;
+}
+
+/**
+ * @brief Allocate the memory of a buffer whose layout was chosen by select_format().
+ */
+static wsialloc_error allocate_buffer(wsialloc_allocator *allocator, wsiallocp_alloc_callback fn_alloc,
+                                      const wsialloc_allocate_info *info, uint32_t nr_planes, uint64_t total_size,
+                                      wsialloc_allocate_result *result)
+{
+   if (info->flags & WSIALLOC_ALLOCATE_NO_MEMORY)
+   {
+      return WSIALLOC_ERROR_NONE;
+   }
+
+   const int fd = fn_alloc(allocator, info, total_size);
+   if (fd < 0)
+   {
+      return WSIALLOC_ERROR_NO_RESOURCE;
+   }
+
+   assert(result->buffer_fds != NULL);
+   for (size_t plane = 0; plane < nr_planes; plane++)
+   {
+      result->buffer_fds[plane] = fd;
+   }
+   return WSIALLOC_ERROR_NONE;
+}
+
+wsialloc_error wsiallocp_alloc(wsialloc_allocator *allocator, wsiallocp_alloc_callback fn_alloc,
+                               const wsialloc_allocate_info *info, wsialloc_allocate_result *result)
+{
+   return wsiallocp_alloc_batch(allocator, fn_alloc, info, 1, result);
+}
+
+wsialloc_error wsiallocp_alloc_batch(wsialloc_allocator *allocator, wsiallocp_alloc_callback fn_alloc,
+                                     const wsialloc_allocate_info *info, uint32_t count,
+                                     wsialloc_allocate_result *results)
+{
+   if (count == 0 || results == NULL || !validate_parameters(allocator, info, &results[0]))
+   {
+      return WSIALLOC_ERROR_INVALID;
+   }
+
+   uint32_t nr_planes = 0;
+   uint64_t total_size = 0;
+   wsialloc_error err = select_format(info, &results[0], &nr_planes, &total_size);
+   if (err != WSIALLOC_ERROR_NONE)
+   {
+      return err;
+   }
+
+   for (uint32_t i = 0; i < count; i++)
+   {
+      if (i > 0)
       {
-         return WSIALLOC_ERROR_NO_RESOURCE;
+         memcpy(results[i].average_row_strides, results[0].average_row_strides, sizeof(results[0].average_row_strides));
+         memcpy(results[i].offsets, results[0].offsets, sizeof(results[0].offsets));
+         results[i].format = results[0].format;
+         results[i].is_disjoint = results[0].is_disjoint;
       }
 
-      assert(result->buffer_fds != NULL);
-      result->buffer_fds[0] = local_fds[0];
-      for (size_t plane = 1; plane < selected_format_desc.format_spec.nr_planes; plane++)
+      err = allocate_buffer(allocator, fn_alloc, info, nr_planes, total_size, &results[i]);
+      if (err != WSIALLOC_ERROR_NONE)
       {
-         result->buffer_fds[plane] = result->buffer_fds[0];
+         /* Do not leave the client with a partial batch. */
+         for (uint32_t j = 0; j < i; j++)
+         {
+            close(results[j].buffer_fds[0]);
+            for (size_t plane = 0; plane < nr_planes; plane++)
+            {
+               results[j].buffer_fds[plane] = -1;
+            }
+         }
+         return err;
       }
    }
-   result->format = selected_format_desc.format;
-   for (size_t plane = 0; plane < selected_format_desc.format_spec.nr_planes; plane++)
+
+   return WSIALLOC_ERROR_NONE;
+}
+
+wsialloc_error wsiallocp_cache_init(wsiallocp_cache *cache)
+{
+   assert(cache != NULL);
+
+   cache->budget = 0;
+   cache->total_size = 0;
+   cache->count = 0;
+   if (pthread_mutex_init(&cache->lock, NULL) != 0)
    {
-      result->average_row_strides[plane] = local_strides[plane];
-      result->offsets[plane] = local_offsets[plane];
+      return WSIALLOC_ERROR_NO_RESOURCE;
    }
-
-   result->is_disjoint = false;
    return WSIALLOC_ERROR_NONE;
-}
\ No newline at end of file
+}
+
+/* Must be called with the cache lock held. */
+static void cache_evict_oldest(wsiallocp_cache *cache)
+{
+   assert(cache->count > 0);
+
+   close(cache->entries[0].fd);
+   cache->total_size -= cache->entries[0].size;
+   cache->count--;
+   memmove(&cache->entries[0], &cache->entries[1], cache->count * sizeof(cache->entries[0]));
+}
+
+/* Must be called with the cache lock held. */
+static void cache_trim_locked(wsiallocp_cache *cache, uint64_t max_bytes)
+{
+   while (cache->total_size > max_bytes)
+   {
+      cache_evict_oldest(cache);
+   }
+}
+
+void wsiallocp_cache_destroy(wsiallocp_cache *cache)
+{
+   assert(cache != NULL);
+
+   cache_trim_locked(cache, 0);
+   pthread_mutex_destroy(&cache->lock);
+}
+
+void wsiallocp_cache_set_budget(wsiallocp_cache *cache, uint64_t budget)
+{
+   assert(cache != NULL);
+
+   pthread_mutex_lock(&cache->lock);
+   cache->budget = budget;
+   cache_trim_locked(cache, budget);
+   pthread_mutex_unlock(&cache->lock);
+}
+
+void wsiallocp_cache_trim(wsiallocp_cache *cache, uint64_t max_bytes)
+{
+   assert(cache != NULL);
+
+   pthread_mutex_lock(&cache->lock);
+   cache_trim_locked(cache, max_bytes);
+   pthread_mutex_unlock(&cache->lock);
+}
+
+int wsiallocp_cache_take(wsiallocp_cache *cache, uint64_t flags, uint64_t size)
+{
+   assert(cache != NULL);
+   assert(size > 0);
+
+   const uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+   const uint64_t aligned_size = (size + page_size - 1) / page_size * page_size;
+   flags &= WSIALLOCP_CACHE_KEY_FLAGS;
+
+   int fd = -1;
+   pthread_mutex_lock(&cache->lock);
+   /* Prefer the most recently released buffer, which is the most likely to still be warm in the caches. */
+   for (unsigned i = cache->count; i > 0; i--)
+   {
+      const wsiallocp_cache_entry *entry = &cache->entries[i - 1];
+      if (entry->flags == flags && entry->size == aligned_size)
+      {
+         fd = entry->fd;
+         cache->total_size -= entry->size;
+         cache->count--;
+         memmove(&cache->entries[i - 1], &cache->entries[i], (cache->count - (i - 1)) * sizeof(cache->entries[0]));
+         break;
+      }
+   }
+   pthread_mutex_unlock(&cache->lock);
+
+   return fd;
+}
+
+void wsiallocp_cache_put(wsiallocp_cache *cache, uint64_t flags, int fd)
+{
+   assert(cache != NULL);
+   assert(fd >= 0);
+
+   const off_t size = lseek(fd, 0, SEEK_END);
+
+   pthread_mutex_lock(&cache->lock);
+   if (size <= 0 || (uint64_t)size > cache->budget)
+   {
+      pthread_mutex_unlock(&cache->lock);
+      close(fd);
+      return;
+   }
+
+   cache_trim_locked(cache, cache->budget - (uint64_t)size);
+   if (cache->count == WSIALLOCP_CACHE_MAX_ENTRIES)
+   {
+      cache_evict_oldest(cache);
+   }
+
+   wsiallocp_cache_entry *entry = &cache->entries[cache->count++];
+   entry->fd = fd;
+   entry->size = (uint64_t)size;
+   entry->flags = flags & WSIALLOCP_CACHE_KEY_FLAGS;
+   cache->total_size += entry->size;
+   pthread_mutex_unlock(&cache->lock);
+}
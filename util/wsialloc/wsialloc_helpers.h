@@ -24,11 +24,13 @@
 
 #include "wsialloc.h"
 
+#include <pthread.h>
+
 /**
  * @brief Internal callback used in wsiallocp_alloc(). Different wsialloc implementations define this
  * callback and use wsiallocp_alloc to implement the wsialloc_alloc entrypoint.
  */
-typedef int (*wsiallocp_alloc_callback)(const wsialloc_allocator *allocator, const wsialloc_allocate_info *info,
+typedef int (*wsiallocp_alloc_callback)(wsialloc_allocator *allocator, const wsialloc_allocate_info *info,
                                         uint64_t size);
 /**
  *
@@ -49,4 +51,99 @@ typedef int (*wsiallocp_alloc_callback)(const wsialloc_allocator *allocator, con
  *                                               * The allocator does not support allocating with the selected flags
  */
 wsialloc_error wsiallocp_alloc(wsialloc_allocator *allocator, wsiallocp_alloc_callback fn_alloc,
-                               const wsialloc_allocate_info *info, wsialloc_allocate_result *result);
\ No newline at end of file
+                               const wsialloc_allocate_info *info, wsialloc_allocate_result *result);
+
+/**
+ * @brief Allocate several buffers sharing the same format, selecting the format only once.
+ *
+ * A helper function used to implement the wsialloc_alloc_batch entrypoint. On failure no buffer is left allocated.
+ *
+ * @param      allocator The wsialloc allocator
+ * @param      fn_alloc  The function that will be called to perform the actual memory allocation of each buffer
+ * @param      info      The requested allocation info, shared by all the buffers
+ * @param      count     The number of buffers to allocate
+ * @param[out] results   Array of @p count allocation results.
+ * @return The same values as wsiallocp_alloc().
+ */
+wsialloc_error wsiallocp_alloc_batch(wsialloc_allocator *allocator, wsiallocp_alloc_callback fn_alloc,
+                                     const wsialloc_allocate_info *info, uint32_t count,
+                                     wsialloc_allocate_result *results);
+
+/** Maximum number of buffers a wsiallocp_cache keeps, independently of its byte budget. */
+#define WSIALLOCP_CACHE_MAX_ENTRIES 16
+
+/**
+ * @brief Allocation flags that select the memory a buffer comes from. Cached buffers are only handed out again for
+ * allocations that agree on these flags.
+ */
+#define WSIALLOCP_CACHE_KEY_FLAGS                                              \
+   ((uint64_t)(WSIALLOC_ALLOCATE_PROTECTED | WSIALLOC_ALLOCATE_USAGE_SCANOUT | \
+               WSIALLOC_ALLOCATE_USAGE_COMPOSITE | WSIALLOC_ALLOCATE_USAGE_CPU_READBACK))
+
+typedef struct wsiallocp_cache_entry
+{
+   int fd; /**< The cached buffer. */
+   uint64_t size; /**< Size of the buffer in bytes, as reported by the kernel. */
+   uint64_t flags; /**< Allocation flags the buffer was made with, masked by WSIALLOCP_CACHE_KEY_FLAGS. */
+} wsiallocp_cache_entry;
+
+/**
+ * @brief Cache of released buffers shared by the wsialloc implementations.
+ *
+ * Entries are kept oldest first so that eviction drops the buffers that have been idle the longest. The cache starts
+ * disabled, with a zero byte budget.
+ */
+typedef struct wsiallocp_cache
+{
+   pthread_mutex_t lock;
+   uint64_t budget; /**< Maximum number of bytes the cache may hold. */
+   uint64_t total_size; /**< Number of bytes currently held. */
+   unsigned count; /**< Number of valid elements in entries. */
+   wsiallocp_cache_entry entries[WSIALLOCP_CACHE_MAX_ENTRIES];
+} wsiallocp_cache;
+
+/**
+ * @brief Initialize an empty, disabled cache.
+ *
+ * @retval WSIALLOC_ERROR_NONE        on success.
+ * @retval WSIALLOC_ERROR_NO_RESOURCE if the cache lock could not be created.
+ */
+wsialloc_error wsiallocp_cache_init(wsiallocp_cache *cache);
+
+/**
+ * @brief Close every cached buffer and release the cache resources.
+ */
+void wsiallocp_cache_destroy(wsiallocp_cache *cache);
+
+/**
+ * @brief Set the byte budget of the cache, evicting buffers as needed to honour it. A budget of 0 disables the cache.
+ */
+void wsiallocp_cache_set_budget(wsiallocp_cache *cache, uint64_t budget);
+
+/**
+ * @brief Evict the least recently released buffers until the cache holds at most @p max_bytes.
+ */
+void wsiallocp_cache_trim(wsiallocp_cache *cache, uint64_t max_bytes);
+
+/**
+ * @brief Take a buffer out of the cache.
+ *
+ * @param cache The cache.
+ * @param flags The allocation flags of the request.
+ * @param size  The requested size in bytes. Buffers are matched on the page-aligned size the kernel would allocate.
+ *
+ * @return The file descriptor of a matching buffer, now owned by the caller, or -1 if the cache has none.
+ */
+int wsiallocp_cache_take(wsiallocp_cache *cache, uint64_t flags, uint64_t size);
+
+/**
+ * @brief Hand a released buffer to the cache.
+ *
+ * The least recently released buffers are evicted to make room for it. A buffer larger than the whole budget is closed
+ * straight away.
+ *
+ * @param cache The cache.
+ * @param flags The allocation flags the buffer was made with.
+ * @param fd    The buffer. Ownership is transferred to the cache in every case.
+ */
+void wsiallocp_cache_put(wsiallocp_cache *cache, uint64_t flags, int fd);
@@ -44,7 +44,7 @@
  *
  * This should only be increased when this implementation is updated to match newer versions of wsialloc.h.
  */
-#define WSIALLOC_IMPLEMENTATION_VERSION 3
+#define WSIALLOC_IMPLEMENTATION_VERSION 7
 
 /* Ensure we are implementing the wsialloc version matching the wsialloc.h header we are using. */
 #if WSIALLOC_IMPLEMENTATION_VERSION != WSIALLOC_INTERFACE_VERSION
@@ -62,6 +62,8 @@ struct wsialloc_allocator
    /* Protected allocator heap id */
    uint32_t protected_alloc_heap_id;
    bool protected_heap_exists;
+   /* Buffers released by the client, kept for reuse by later allocations. */
+   wsiallocp_cache cache;
 };
 
 static int find_alloc_heap_id(int fd)
@@ -122,6 +124,12 @@ wsialloc_error wsialloc_new(wsialloc_allocator **allocator)
       return WSIALLOC_ERROR_NO_RESOURCE;
    }
 
+   if (wsiallocp_cache_init(&ion->cache) != WSIALLOC_ERROR_NONE)
+   {
+      free(ion);
+      return WSIALLOC_ERROR_NO_RESOURCE;
+   }
+
    ion->fd = open("/dev/ion", O_RDONLY);
    if (ion->fd < 0)
    {
@@ -141,6 +149,14 @@ wsialloc_error wsialloc_new(wsialloc_allocator **allocator)
    return WSIALLOC_ERROR_NONE;
 }
 
+wsialloc_error wsialloc_new_for_device(wsialloc_allocator **allocator, int64_t render_major, int64_t render_minor)
+{
+   /* ION heaps are not tied to a device. */
+   (void)render_major;
+   (void)render_minor;
+   return wsialloc_new(allocator);
+}
+
 void wsialloc_delete(wsialloc_allocator *allocator)
 {
    assert(allocator != NULL);
@@ -149,6 +165,7 @@ void wsialloc_delete(wsialloc_allocator *allocator)
       return;
    }
 
+   wsiallocp_cache_destroy(&allocator->cache);
    if (allocator->fd >= 0)
    {
       close(allocator->fd);
@@ -158,7 +175,7 @@ void wsialloc_delete(wsialloc_allocator *allocator)
    free(allocator);
 }
 
-static int ion_allocate(const wsialloc_allocator *allocator, const wsialloc_allocate_info *info, uint64_t size)
+static int ion_allocate(wsialloc_allocator *allocator, const wsialloc_allocate_info *info, uint64_t size)
 {
    assert(allocator != NULL);
    assert(info != NULL);
@@ -166,7 +183,7 @@ static int ion_allocate(const wsialloc_allocator *allocator, const wsialloc_allo
    assert(size > 0);
 
    /* The only error that can be encountered on allocations is lack of resources. Other parameter validation and
-    * support checks are done on format selection. */
+    * support checks are done on format selection. The usage hints are ignored, every buffer comes from the DMA heap. */
    uint32_t alloc_heap_id = allocator->alloc_heap_id;
    if (info->flags & WSIALLOC_ALLOCATE_PROTECTED)
    {
@@ -179,6 +196,12 @@ static int ion_allocate(const wsialloc_allocator *allocator, const wsialloc_allo
       alloc_heap_id = allocator->protected_alloc_heap_id;
    }
 
+   const int cached_fd = wsiallocp_cache_take(&allocator->cache, info->flags, size);
+   if (cached_fd >= 0)
+   {
+      return cached_fd;
+   }
+
    return allocate(allocator->fd, size, alloc_heap_id);
 }
 
@@ -192,3 +215,36 @@ wsialloc_error wsialloc_alloc(wsialloc_allocator *allocator, const wsialloc_allo
 
    return wsiallocp_alloc(allocator, ion_allocate, info, result);
 }
+
+wsialloc_error wsialloc_alloc_batch(wsialloc_allocator *allocator, const wsialloc_allocate_info *info, uint32_t count,
+                                    wsialloc_allocate_result *results)
+{
+   if ((info->flags & WSIALLOC_ALLOCATE_PROTECTED) && (!allocator->protected_heap_exists))
+   {
+      return WSIALLOC_ERROR_NO_RESOURCE;
+   }
+
+   return wsiallocp_alloc_batch(allocator, ion_allocate, info, count, results);
+}
+
+wsialloc_error wsialloc_set_cache_budget(wsialloc_allocator *allocator, uint64_t budget)
+{
+   assert(allocator != NULL);
+   wsiallocp_cache_set_budget(&allocator->cache, budget);
+   return WSIALLOC_ERROR_NONE;
+}
+
+void wsialloc_release(wsialloc_allocator *allocator, uint64_t flags, int fd)
+{
+   assert(allocator != NULL);
+   if (fd >= 0)
+   {
+      wsiallocp_cache_put(&allocator->cache, flags, fd);
+   }
+}
+
+void wsialloc_cache_trim(wsialloc_allocator *allocator, uint64_t max_bytes)
+{
+   assert(allocator != NULL);
+   wsiallocp_cache_trim(&allocator->cache, max_bytes);
+}
@@ -131,11 +131,12 @@ public:
       }
 
       const present_mode_compatibility &present_mode_comp = *it;
+      auto compatible_modes_end =
+         present_mode_comp.compatible_present_modes.begin() + present_mode_comp.present_mode_count;
       auto present_mode_it =
-         std::find_if(present_mode_comp.compatible_present_modes.begin(),
-                      present_mode_comp.compatible_present_modes.begin() + present_mode_comp.present_mode_count,
+         std::find_if(present_mode_comp.compatible_present_modes.begin(), compatible_modes_end,
                       [present_mode_b](VkPresentModeKHR p) { return p == present_mode_b; });
-      return present_mode_it != present_mode_comp.compatible_present_modes.end();
+      return present_mode_it != compatible_modes_end;
    }
 
 private:
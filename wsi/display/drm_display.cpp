@@ -26,6 +26,7 @@
 #include "util/custom_allocator.hpp"
 #include "wsi/surface.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <cerrno>
@@ -34,6 +35,7 @@
 #include <unistd.h>
 #include <assert.h>
 #include <mutex>
+#include <iterator>
 #include <drm_fourcc.h>
 namespace wsi
 {
@@ -43,37 +45,43 @@ namespace display
 
 const std::string default_dri_device_name{ "/dev/dri/card0" };
 
-drm_display::drm_display(util::fd_owner drm_fd, int crtc_id, drm_connector_owner drm_connector,
-                         util::unique_ptr<util::vector<drm_format_pair>> supported_formats,
+drm_display::drm_display(int drm_fd, drm_connector_owner drm_connector,
                          util::unique_ptr<drm_display_mode> display_modes, size_t num_display_modes, uint32_t max_width,
-                         uint32_t max_height, bool supports_fb_modifiers)
-   : m_drm_fd(std::move(drm_fd))
-   , m_crtc_id(crtc_id)
+                         uint32_t max_height, drm_event_loop *event_loop,
+                         util::unique_ptr<util::vector<drm_format_pair>> supported_formats,
+                         util::unique_ptr<util::vector<drm_overlay_plane>> overlay_planes)
+   : m_drm_fd(drm_fd)
+   , m_crtc_id(-1)
+   , m_crtc_index(0)
    , m_drm_connector(std::move(drm_connector))
+   , m_current_connector(nullptr)
+   , m_connector_refreshed(false)
    , m_supported_formats(std::move(supported_formats))
    , m_display_modes(std::move(display_modes))
    , m_num_display_modes(num_display_modes)
    , m_max_width(max_width)
    , m_max_height(max_height)
-   , m_supports_fb_modifiers(supports_fb_modifiers)
+   , m_supports_fb_modifiers(false)
+   , m_primary_plane_id(0)
+   , m_atomic_properties(std::nullopt)
+   , m_supports_legacy_async_page_flip(false)
+   , m_supports_atomic_async_page_flip(false)
+   , m_supports_plane_scaling(false)
+   , m_event_loop(event_loop)
+   , m_overlay_planes(std::move(overlay_planes))
+   , m_framebuffer_cache(nullptr)
 {
 }
 
-drm_display::~drm_display()
-{
-   if (m_drm_fd.is_valid())
-   {
-      /* Finish using the DRM device. */
-      drmDropMaster(m_drm_fd.get());
-   }
-}
-
 /**
  * @brief Utility function to find a compatible CRTC to drive this display's connector.
  *
+ * @param used_crtcs Bit mask of the indices of the CRTCs already driving other connectors.
+ * @param crtc_index Set to the index of the CRTC in the resources.
  * @return An integer < 0 on failure, otherwise a valid CRTC id.
  */
-static int find_compatible_crtc(int fd, drm_resources_owner &resources, drm_connector_owner &connector)
+static int find_compatible_crtc(int fd, drm_resources_owner &resources, drm_connector_owner &connector,
+                                uint32_t used_crtcs, uint32_t &crtc_index)
 {
    assert(resources);
    assert(connector);
@@ -97,8 +105,13 @@ static int find_compatible_crtc(int fd, drm_resources_owner &resources, drm_conn
             continue;
          }
 
-         /* Make the assumption that only one connector will be in use at a time so there is no
-          * need to check that any other connectors are being driven by this CRTC. */
+         /* Each connector gets a CRTC of its own so that they can be flipped independently. */
+         if (used_crtcs & (1u << j))
+         {
+            continue;
+         }
+
+         crtc_index = static_cast<uint32_t>(j);
          return resources->crtcs[j];
       }
    }
@@ -108,38 +121,62 @@ static int find_compatible_crtc(int fd, drm_resources_owner &resources, drm_conn
    return -ENODEV;
 }
 
+/**
+ * @brief Get the value of a property of a KMS object.
+ *
+ * @return true if the object has the property, otherwise false.
+ */
+static bool get_property_value(const util::fd_owner &drm_fd, uint32_t object_id, uint32_t object_type,
+                               const char *name, uint64_t &value)
+{
+   drm_object_properties_owner props{ drmModeObjectGetProperties(drm_fd.get(), object_id, object_type) };
+   if (props == nullptr)
+   {
+      return false;
+   }
+
+   for (uint32_t j = 0; j < props->count_props; j++)
+   {
+      drm_property_owner prop{ drmModeGetProperty(drm_fd.get(), props->props[j]) };
+      if (prop != nullptr && !strcmp(prop->name, name))
+      {
+         value = props->prop_values[j];
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * @brief Get the type of a plane, one of the DRM_PLANE_TYPE_* values.
+ *
+ * @return true if the plane has a type property, otherwise false.
+ */
+static bool get_plane_type(const util::fd_owner &drm_fd, uint32_t plane_id, uint64_t &type)
+{
+   return get_property_value(drm_fd, plane_id, DRM_MODE_OBJECT_PLANE, "type", type);
+}
+
 static bool find_primary_plane(const util::fd_owner &drm_fd, const drm_plane_resources_owner &plane_res,
+                               uint32_t crtc_index, const util::vector<uint32_t> &used_planes,
                                drm_plane_owner &primary_plane, uint32_t &primary_plane_index)
 {
    for (uint32_t i = 0; i < plane_res->count_planes; i++)
    {
-      drm_plane_owner temp_plane{ drmModeGetPlane(drm_fd.get(), plane_res->planes[i]) };
-      if (temp_plane != nullptr)
+      if (std::find(used_planes.begin(), used_planes.end(), plane_res->planes[i]) != used_planes.end())
       {
-         drm_object_properties_owner props{ drmModeObjectGetProperties(drm_fd.get(), plane_res->planes[i],
-                                                                       DRM_MODE_OBJECT_PLANE) };
-         if (props == nullptr)
-         {
-            continue;
-         }
+         continue;
+      }
 
-         for (uint32_t j = 0; j < props->count_props; j++)
+      drm_plane_owner temp_plane{ drmModeGetPlane(drm_fd.get(), plane_res->planes[i]) };
+      if (temp_plane != nullptr && (temp_plane->possible_crtcs & (1u << crtc_index)) != 0)
+      {
+         uint64_t type = 0;
+         if (get_plane_type(drm_fd, plane_res->planes[i], type) && type == DRM_PLANE_TYPE_PRIMARY)
          {
-            drm_property_owner prop{ drmModeGetProperty(drm_fd.get(), props->props[j]) };
-            if (prop == nullptr)
-            {
-               continue;
-            }
-
-            if (!strcmp(prop->name, "type"))
-            {
-               if (props->prop_values[j] == DRM_PLANE_TYPE_PRIMARY)
-               {
-                  primary_plane = std::move(temp_plane);
-                  primary_plane_index = i;
-                  return true;
-               }
-            }
+            primary_plane = std::move(temp_plane);
+            primary_plane_index = i;
+            return true;
          }
       }
    }
@@ -202,55 +239,119 @@ static bool fill_supported_formats_with_modifiers(uint32_t primary_plane_index,
    return true;
 }
 
-std::optional<drm_display> drm_display::make_display(const util::allocator &allocator, const char *drm_device)
+/**
+ * @brief Fill the formats a plane can scan out, with their modifiers if framebuffers with modifiers are supported.
+ */
+static bool fill_plane_formats(const util::fd_owner &drm_fd, const drm_plane_resources_owner &plane_res,
+                               uint32_t plane_index, const drm_plane_owner &plane, bool supports_fb_modifiers,
+                               util::vector<drm_format_pair> &supported_formats)
 {
-   util::fd_owner drm_fd{ open(drm_device, O_RDWR | O_CLOEXEC, 0) };
-
-   if (!drm_fd.is_valid())
+   if (supports_fb_modifiers &&
+       fill_supported_formats_with_modifiers(plane_index, drm_fd, plane_res, supported_formats))
    {
-      WSI_LOG_ERROR("Failed to open DRM device %s.", drm_device);
-      return std::nullopt;
+      return true;
    }
 
-   /* Get the DRM master permission so that mode can be set on the drm device later. */
-   if (!drmIsMaster(drm_fd.get()))
-   {
-      if (drmSetMaster(drm_fd.get()) != 0)
-      {
-         WSI_LOG_ERROR("Failed to set DRM master: %s.", std::strerror(errno));
-         return std::nullopt;
-      }
-   }
+   /* Fall back to the linear formats */
+   supported_formats.clear();
+   return fill_supported_formats(plane, supported_formats);
+}
 
-   drm_resources_owner resources{ drmModeGetResources(drm_fd.get()) };
-   if (resources == nullptr)
+/**
+ * @brief A KMS property to look up by name.
+ */
+struct drm_property_query
+{
+   const char *name;
+   uint32_t *id;
+};
+
+/**
+ * @brief Look up the ids of properties of a KMS object.
+ *
+ * @return true if all the properties were found, otherwise false.
+ */
+static bool find_property_ids(const util::fd_owner &drm_fd, uint32_t object_id, uint32_t object_type,
+                              const drm_property_query *queries, size_t query_count)
+{
+   drm_object_properties_owner props{ drmModeObjectGetProperties(drm_fd.get(), object_id, object_type) };
+   if (props == nullptr)
    {
-      WSI_LOG_ERROR("Failed to get DRM resources.");
-      return std::nullopt;
+      return false;
    }
 
-   drm_connector_owner connector{ nullptr };
-   int crtc_id = -1;
-   for (int i = 0; i < resources->count_connectors; ++i)
+   size_t found = 0;
+   for (size_t i = 0; i < query_count; i++)
    {
-      drm_connector_owner temp_connector{ drmModeGetConnector(drm_fd.get(), resources->connectors[i]) };
-      if (temp_connector != nullptr && temp_connector->connection == DRM_MODE_CONNECTED)
+      for (uint32_t j = 0; j < props->count_props; j++)
       {
-         crtc_id = find_compatible_crtc(drm_fd.get(), resources, temp_connector);
-         if (crtc_id >= 0)
+         drm_property_owner prop{ drmModeGetProperty(drm_fd.get(), props->props[j]) };
+         if (prop != nullptr && !strcmp(prop->name, queries[i].name))
          {
-            connector = std::move(temp_connector);
+            *queries[i].id = prop->prop_id;
+            found++;
             break;
          }
       }
    }
 
-   if (connector == nullptr)
+   return found == query_count;
+}
+
+/**
+ * @brief Look up the properties the swapchains set in atomic commits on a plane.
+ *
+ * @return true if all the properties were found, otherwise false.
+ */
+static bool get_plane_properties(const util::fd_owner &drm_fd, uint32_t plane_id, drm_plane_properties &props)
+{
+   const drm_property_query plane_queries[] = {
+      { "FB_ID", &props.fb_id },       { "CRTC_ID", &props.crtc_id },   { "SRC_X", &props.src_x },
+      { "SRC_Y", &props.src_y },       { "SRC_W", &props.src_w },       { "SRC_H", &props.src_h },
+      { "CRTC_X", &props.crtc_x },     { "CRTC_Y", &props.crtc_y },     { "CRTC_W", &props.crtc_w },
+      { "CRTC_H", &props.crtc_h },     { "IN_FENCE_FD", &props.in_fence_fd },
+   };
+
+   return find_property_ids(drm_fd, plane_id, DRM_MODE_OBJECT_PLANE, plane_queries, std::size(plane_queries));
+}
+
+/**
+ * @brief Look up the properties the swapchains set in atomic commits on a display.
+ *
+ * @return The properties, or std::nullopt if the display can't use atomic modesetting.
+ */
+static std::optional<drm_atomic_properties> get_atomic_properties(const util::fd_owner &drm_fd, uint32_t connector_id,
+                                                                  uint32_t crtc_id, uint32_t plane_id)
+{
+   drm_atomic_properties props{};
+   const drm_property_query connector_queries[] = { { "CRTC_ID", &props.connector_crtc_id } };
+   const drm_property_query crtc_queries[] = { { "MODE_ID", &props.crtc_mode_id }, { "ACTIVE", &props.crtc_active } };
+
+   if (!find_property_ids(drm_fd, connector_id, DRM_MODE_OBJECT_CONNECTOR, connector_queries,
+                          std::size(connector_queries)) ||
+       !find_property_ids(drm_fd, crtc_id, DRM_MODE_OBJECT_CRTC, crtc_queries, std::size(crtc_queries)) ||
+       !get_plane_properties(drm_fd, plane_id, props.plane))
    {
-      WSI_LOG_ERROR("Failed to find connector for DRM device.");
+      WSI_LOG_INFO("Missing atomic KMS properties for connector %u, using legacy KMS.", connector_id);
       return std::nullopt;
    }
 
+   /* Variable refresh rate is optional, it needs a capable sink and driver. */
+   uint64_t vrr_capable = 0;
+   const drm_property_query vrr_query[] = { { "VRR_ENABLED", &props.crtc_vrr_enabled } };
+   if (!get_property_value(drm_fd, connector_id, DRM_MODE_OBJECT_CONNECTOR, "vrr_capable", vrr_capable) ||
+       vrr_capable == 0 ||
+       !find_property_ids(drm_fd, crtc_id, DRM_MODE_OBJECT_CRTC, vrr_query, std::size(vrr_query)))
+   {
+      props.crtc_vrr_enabled = 0;
+   }
+
+   return props;
+}
+
+std::optional<drm_display> drm_display::make_display(const util::allocator &allocator, const util::fd_owner &drm_fd,
+                                                     drm_connector_owner connector, drm_event_loop &event_loop)
+{
    uint32_t max_width = 0;
    uint32_t max_height = 0;
    util::vector<drm_display_mode> display_modes{ allocator };
@@ -282,26 +383,39 @@ std::optional<drm_display> drm_display::make_display(const util::allocator &allo
       WSI_LOG_ERROR("Failed to allocate memory for display mode vector.");
       return std::nullopt;
    }
+   std::copy(display_modes.begin(), display_modes.end(), display_modes_mem.get());
 
-   /* Allow userspace to query native primary plane information */
-   if (drmSetClientCap(drm_fd.get(), DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) != 0)
+   auto supported_formats = allocator.make_unique<util::vector<drm_format_pair>>(allocator);
+   auto overlay_planes = allocator.make_unique<util::vector<drm_overlay_plane>>(allocator);
+   if (supported_formats == nullptr || overlay_planes == nullptr)
    {
       return std::nullopt;
    }
 
-   drm_plane_resources_owner plane_res{ drmModeGetPlaneResources(drm_fd.get()) };
-   if (plane_res == nullptr || plane_res->count_planes == 0)
-   {
-      return std::nullopt;
-   }
+   drm_display display{ drm_fd.get(),
+                        std::move(connector),
+                        std::move(display_modes_mem),
+                        display_modes.size(),
+                        max_width,
+                        max_height,
+                        &event_loop,
+                        std::move(supported_formats),
+                        std::move(overlay_planes) };
 
+   return std::make_optional(std::move(display));
+}
+
+bool drm_display::init_planes(const util::allocator &allocator, const util::fd_owner &drm_fd, int crtc_id,
+                              uint32_t crtc_index, const drm_plane_resources_owner &plane_res,
+                              util::vector<uint32_t> &used_planes, bool use_atomic)
+{
    uint32_t primary_plane_index = std::numeric_limits<uint32_t>::max();
    drm_plane_owner primary_plane{ nullptr };
 
-   if (!find_primary_plane(drm_fd, plane_res, primary_plane, primary_plane_index))
+   if (!find_primary_plane(drm_fd, plane_res, crtc_index, used_planes, primary_plane, primary_plane_index))
    {
       WSI_LOG_ERROR("Failed to find primary plane for display.");
-      return std::nullopt;
+      return false;
    }
 
    assert(primary_plane != nullptr);
@@ -317,41 +431,287 @@ std::optional<drm_display> drm_display::make_display(const util::allocator &allo
    }
 #endif
 
-   auto supported_formats = allocator.make_unique<util::vector<drm_format_pair>>(allocator);
+   if (!fill_plane_formats(drm_fd, plane_res, primary_plane_index, primary_plane, supports_fb_modifiers,
+                           *m_supported_formats))
+   {
+      return false;
+   }
+
+   const uint32_t primary_plane_id = plane_res->planes[primary_plane_index];
+   std::optional<drm_atomic_properties> atomic_properties = std::nullopt;
+   if (use_atomic)
+   {
+      atomic_properties = get_atomic_properties(drm_fd, get_connector_id(), crtc_id, primary_plane_id);
+   }
+
+   uint64_t async_page_flip = 0;
+   const bool supports_legacy_async_page_flip =
+      drmGetCap(drm_fd.get(), DRM_CAP_ASYNC_PAGE_FLIP, &async_page_flip) == 0 && async_page_flip != 0;
+
+   bool supports_atomic_async_page_flip = false;
+#ifdef DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP
+   async_page_flip = 0;
+   supports_atomic_async_page_flip = atomic_properties.has_value() &&
+                                     drmGetCap(drm_fd.get(), DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP, &async_page_flip) == 0 &&
+                                     async_page_flip != 0;
+#endif
+
+   auto framebuffer_cache =
+      allocator.make_unique<drm_framebuffer_cache>(drm_fd.get(), supports_fb_modifiers, allocator);
+   if (framebuffer_cache == nullptr || !used_planes.try_push_back(primary_plane_id))
+   {
+      return false;
+   }
+
+   m_crtc_id = crtc_id;
+   m_crtc_index = crtc_index;
+   m_supports_fb_modifiers = supports_fb_modifiers;
+   m_primary_plane_id = primary_plane_id;
+   m_atomic_properties = atomic_properties;
+   m_supports_legacy_async_page_flip = supports_legacy_async_page_flip;
+   m_supports_atomic_async_page_flip = supports_atomic_async_page_flip;
+   m_framebuffer_cache = std::move(framebuffer_cache);
 
-   if (supports_fb_modifiers)
+   if (m_atomic_properties.has_value() && m_num_display_modes > 0)
    {
-      if (!fill_supported_formats_with_modifiers(primary_plane_index, drm_fd, plane_res, *supported_formats))
+      const drm_display_mode *mode = get_display_modes_begin();
+      for (auto it = get_display_modes_begin(); it != get_display_modes_end(); ++it)
       {
-         /* Fall back to the linear formats */
-         if (!fill_supported_formats(primary_plane, *supported_formats))
+         if (it->is_preferred())
          {
-            return std::nullopt;
+            mode = it;
+            break;
          }
       }
+      const drmModeModeInfo mode_info = mode->get_drm_mode();
+      const VkRect2D crtc_rect = { { 0, 0 }, { mode_info.hdisplay, mode_info.vdisplay } };
+      const VkExtent2D src_extent = { std::max(mode_info.hdisplay / 2u, 1u), std::max(mode_info.vdisplay / 2u, 1u) };
+      m_supports_plane_scaling =
+         test_plane_scaling(m_primary_plane_id, m_atomic_properties->plane, src_extent, crtc_rect, &mode_info);
    }
-   else
+   return true;
+}
+
+drm_display_registry::drm_display_registry(util::fd_owner drm_fd, util::unique_ptr<drm_event_loop> event_loop,
+                                           util::unique_ptr<util::vector<drm_display>> displays)
+   : m_drm_fd(std::move(drm_fd))
+   , m_event_loop(std::move(event_loop))
+   , m_displays(std::move(displays))
+   , m_planes_initialized(false)
+   , m_planes_available(false)
+{
+   m_event_loop->set_hotplug_handler(this);
+}
+
+drm_display_registry::~drm_display_registry()
+{
+   /* Stop the event loop before the displays its hotplug events refresh are destroyed. */
+   m_event_loop.reset();
+
+   if (m_planes_initialized)
    {
-      if (!fill_supported_formats(primary_plane, *supported_formats))
+      /* Finish using the DRM device. */
+      drmDropMaster(m_drm_fd.get());
+   }
+}
+
+util::unique_ptr<drm_display_registry> drm_display_registry::make_registry(const util::allocator &allocator,
+                                                                           const char *drm_device)
+{
+   util::fd_owner drm_fd{ open(drm_device, O_RDWR | O_CLOEXEC, 0) };
+
+   if (!drm_fd.is_valid())
+   {
+      WSI_LOG_ERROR("Failed to open DRM device %s.", drm_device);
+      return nullptr;
+   }
+
+   drm_resources_owner resources{ drmModeGetResources(drm_fd.get()) };
+   if (resources == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to get DRM resources.");
+      return nullptr;
+   }
+
+   auto event_loop = allocator.make_unique<drm_event_loop>(drm_fd.get(), allocator);
+   if (event_loop == nullptr)
+   {
+      return nullptr;
+   }
+
+   /* The displays are not moved once the registry is built, so their addresses can be used as VkDisplayKHR. */
+   auto displays = allocator.make_unique<util::vector<drm_display>>(allocator);
+   if (displays == nullptr || !displays->try_reserve(resources->count_connectors))
+   {
+      return nullptr;
+   }
+
+   for (int i = 0; i < resources->count_connectors; ++i)
+   {
+      drm_connector_owner connector{ drmModeGetConnector(drm_fd.get(), resources->connectors[i]) };
+      if (connector == nullptr || connector->connection != DRM_MODE_CONNECTED)
       {
-         return std::nullopt;
+         continue;
+      }
+
+      auto display = drm_display::make_display(allocator, drm_fd, std::move(connector), *event_loop);
+      if (!display.has_value())
+      {
+         WSI_LOG_WARNING("Failed to set up the display of connector %u, skipping it.", resources->connectors[i]);
+         continue;
       }
+
+      displays->try_push_back(std::move(display.value()));
    }
 
-   std::copy(display_modes.begin(), display_modes.end(), display_modes_mem.get());
+   if (displays->empty())
+   {
+      WSI_LOG_ERROR("Failed to find connector for DRM device.");
+      return nullptr;
+   }
 
-   drm_display display{
-      std::move(drm_fd),    crtc_id,   std::move(connector), std::move(supported_formats), std::move(display_modes_mem),
-      display_modes.size(), max_width, max_height,           supports_fb_modifiers
-   };
+   return allocator.make_unique<drm_display_registry>(std::move(drm_fd), std::move(event_loop), std::move(displays));
+}
 
-   return std::make_optional(std::move(display));
+void drm_display_registry::connectors_changed(uint32_t connector_id)
+{
+   for (auto &display : *m_displays)
+   {
+      if (connector_id == 0 || display.get_connector_id() == connector_id)
+      {
+         display.refresh_connector();
+      }
+   }
+}
+
+bool drm_display_registry::init_planes(const util::allocator &allocator)
+{
+   /* Get the DRM master permission so that mode can be set on the drm device later. */
+   if (!drmIsMaster(m_drm_fd.get()))
+   {
+      if (drmSetMaster(m_drm_fd.get()) != 0)
+      {
+         WSI_LOG_ERROR("Failed to set DRM master: %s.", std::strerror(errno));
+         return false;
+      }
+   }
+
+   drm_resources_owner resources{ drmModeGetResources(m_drm_fd.get()) };
+   if (resources == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to get DRM resources.");
+      return false;
+   }
+
+   /* Allow userspace to query native primary plane information */
+   if (drmSetClientCap(m_drm_fd.get(), DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) != 0)
+   {
+      return false;
+   }
+
+   drm_plane_resources_owner plane_res{ drmModeGetPlaneResources(m_drm_fd.get()) };
+   if (plane_res == nullptr || plane_res->count_planes == 0)
+   {
+      return false;
+   }
+
+   bool use_atomic = false;
+   if (std::getenv("WSI_DISPLAY_LEGACY_KMS") == nullptr)
+   {
+      use_atomic = drmSetClientCap(m_drm_fd.get(), DRM_CLIENT_CAP_ATOMIC, 1) == 0;
+      if (!use_atomic)
+      {
+         WSI_LOG_INFO("Atomic modesetting not supported, using legacy KMS.");
+      }
+   }
+
+   util::vector<uint32_t> used_planes{ allocator };
+   uint32_t used_crtcs = 0;
+   bool any_presentable = false;
+   for (auto &display : *m_displays)
+   {
+      uint32_t crtc_index = 0;
+      int crtc_id = find_compatible_crtc(m_drm_fd.get(), resources, display.m_drm_connector, used_crtcs, crtc_index);
+      if (crtc_id < 0)
+      {
+         WSI_LOG_WARNING("No free CRTC for connector %u, it cannot be presented to.", display.get_connector_id());
+         continue;
+      }
+
+      if (!display.init_planes(allocator, m_drm_fd, crtc_id, crtc_index, plane_res, used_planes, use_atomic))
+      {
+         WSI_LOG_WARNING("Failed to set up the planes of connector %u, it cannot be presented to.",
+                         display.get_connector_id());
+         continue;
+      }
+
+      used_crtcs |= 1u << crtc_index;
+      any_presentable = true;
+   }
+
+   if (!any_presentable)
+   {
+      return false;
+   }
+
+   assign_overlay_planes(allocator, m_drm_fd, plane_res, used_planes, *m_displays);
+   return true;
 }
 
-std::optional<drm_display> &drm_display::get_display()
+void drm_display_registry::assign_overlay_planes(const util::allocator &allocator, const util::fd_owner &drm_fd,
+                                                 const drm_plane_resources_owner &plane_res,
+                                                 const util::vector<uint32_t> &used_planes,
+                                                 util::vector<drm_display> &displays)
+{
+   for (uint32_t i = 0; i < plane_res->count_planes; i++)
+   {
+      const uint32_t plane_id = plane_res->planes[i];
+      uint64_t type = 0;
+      if (std::find(used_planes.begin(), used_planes.end(), plane_id) != used_planes.end() ||
+          !get_plane_type(drm_fd, plane_id, type) || type != DRM_PLANE_TYPE_OVERLAY)
+      {
+         continue;
+      }
+
+      drm_plane_owner plane{ drmModeGetPlane(drm_fd.get(), plane_id) };
+      if (plane == nullptr)
+      {
+         continue;
+      }
+
+      /* Planes usable by several CRTCs go to the display with the fewest overlays so far. */
+      drm_display *target = nullptr;
+      for (auto &display : displays)
+      {
+         if (display.get_atomic_properties() != nullptr && display.is_plane_compatible(plane->possible_crtcs) &&
+             (target == nullptr || display.get_num_overlay_planes() < target->get_num_overlay_planes()))
+         {
+            target = &display;
+         }
+      }
+
+      if (target == nullptr)
+      {
+         continue;
+      }
+
+      drm_overlay_plane overlay_plane{ plane_id, {}, nullptr };
+      overlay_plane.supported_formats = allocator.make_unique<util::vector<drm_format_pair>>(allocator);
+      if (!get_plane_properties(drm_fd, plane_id, overlay_plane.properties) ||
+          overlay_plane.supported_formats == nullptr ||
+          !fill_plane_formats(drm_fd, plane_res, i, plane, target->supports_fb_modifiers(),
+                              *overlay_plane.supported_formats) ||
+          !target->add_overlay_plane(std::move(overlay_plane)))
+      {
+         WSI_LOG_WARNING("Failed to set up overlay plane %u, skipping it.", plane_id);
+      }
+   }
+}
+
+drm_display_registry *drm_display_registry::get()
 {
    static std::once_flag flag{};
-   static std::optional<drm_display> display{ std::nullopt };
+   static util::unique_ptr<drm_display_registry> registry{ nullptr };
 
    std::call_once(flag, []() {
       const char *dri_device = std::getenv("WSI_DISPLAY_DRI_DEV");
@@ -360,9 +720,79 @@ std::optional<drm_display> &drm_display::get_display()
          dri_device = default_dri_device_name.c_str();
       }
 
-      display = drm_display::make_display(util::allocator::get_generic(), dri_device);
+      registry = drm_display_registry::make_registry(util::allocator::get_generic(), dri_device);
    });
-   return display;
+   return registry.get();
+}
+
+drm_display_registry *drm_display_registry::get_for_presentation()
+{
+   drm_display_registry *registry = get();
+   if (registry == nullptr)
+   {
+      return nullptr;
+   }
+
+   std::lock_guard<std::mutex> lock(registry->m_planes_lock);
+   if (!registry->m_planes_initialized)
+   {
+      registry->m_planes_initialized = true;
+      registry->m_planes_available = registry->init_planes(util::allocator::get_generic());
+   }
+   return registry->m_planes_available ? registry : nullptr;
+}
+
+size_t drm_display_registry::get_num_displays() const
+{
+   return m_displays->size();
+}
+
+drm_display *drm_display_registry::get_display(size_t index)
+{
+   return index < m_displays->size() ? &(*m_displays)[index] : nullptr;
+}
+
+drm_display *drm_display_registry::find_display(const drm_display_mode *mode)
+{
+   for (auto &display : *m_displays)
+   {
+      if (mode >= display.get_display_modes_begin() && mode < display.get_display_modes_end())
+      {
+         return &display;
+      }
+   }
+   return nullptr;
+}
+
+size_t drm_display_registry::get_num_planes() const
+{
+   size_t num_planes = m_displays->size();
+   for (const auto &display : *m_displays)
+   {
+      num_planes += display.get_num_overlay_planes();
+   }
+   return num_planes;
+}
+
+drm_display *drm_display_registry::get_plane_display(size_t plane_index, const drm_overlay_plane *&overlay_plane)
+{
+   overlay_plane = nullptr;
+   if (plane_index < m_displays->size())
+   {
+      return &(*m_displays)[plane_index];
+   }
+
+   plane_index -= m_displays->size();
+   for (auto &display : *m_displays)
+   {
+      if (plane_index < display.get_num_overlay_planes())
+      {
+         overlay_plane = display.get_overlay_plane(plane_index);
+         return &display;
+      }
+      plane_index -= display.get_num_overlay_planes();
+   }
+   return nullptr;
 }
 
 const util::vector<drm_format_pair> *drm_display::get_supported_formats() const
@@ -372,12 +802,18 @@ const util::vector<drm_format_pair> *drm_display::get_supported_formats() const
 
 bool drm_display::is_format_supported(const drm_format_pair &format) const
 {
-   auto supported_format =
-      std::find_if(m_supported_formats->begin(), m_supported_formats->end(), [format](const auto &supported_format) {
-         return format.fourcc == supported_format.fourcc && format.modifier == supported_format.modifier;
-      });
+   return is_format_supported(format, nullptr);
+}
+
+bool drm_display::is_format_supported(const drm_format_pair &format, const drm_overlay_plane *overlay_plane) const
+{
+   const util::vector<drm_format_pair> &formats =
+      overlay_plane != nullptr ? *overlay_plane->supported_formats : *m_supported_formats;
+   auto supported_format = std::find_if(formats.begin(), formats.end(), [format](const auto &supported_format) {
+      return format.fourcc == supported_format.fourcc && format.modifier == supported_format.modifier;
+   });
 
-   return supported_format != m_supported_formats->end();
+   return supported_format != formats.end();
 }
 
 bool drm_display::supports_fb_modifiers() const
@@ -444,7 +880,7 @@ size_t drm_display::get_num_display_modes() const
 
 int drm_display::get_drm_fd() const
 {
-   return m_drm_fd.get();
+   return m_drm_fd;
 }
 
 uint32_t drm_display::get_connector_id() const
@@ -457,11 +893,242 @@ int drm_display::get_crtc_id() const
    return m_crtc_id;
 }
 
+bool drm_display::is_presentable() const
+{
+   return m_crtc_id >= 0;
+}
+
 drmModeConnector *drm_display::get_connector() const
 {
    return m_drm_connector.get();
 }
 
+void drm_display::refresh_connector()
+{
+   /* The kernel detected the change before sending the event, so the current state is enough. A probe could block
+    * the event loop on a slow EDID read. */
+   m_current_connector = drm_connector_owner{ drmModeGetConnectorCurrent(m_drm_fd, get_connector_id()) };
+   m_connector_refreshed = true;
+}
+
+const drmModeConnector *drm_display::get_current_connector() const
+{
+   return m_connector_refreshed ? m_current_connector.get() : m_drm_connector.get();
+}
+
+bool drm_display::is_connected() const
+{
+   const drmModeConnector *connector = get_current_connector();
+   return connector != nullptr && connector->connection == DRM_MODE_CONNECTED;
+}
+
+/**
+ * @brief Whether two modes have the same timings, regardless of their names and types.
+ */
+static bool have_same_timings(const drmModeModeInfo &lhs, const drmModeModeInfo &rhs)
+{
+   return lhs.clock == rhs.clock && lhs.hdisplay == rhs.hdisplay && lhs.hsync_start == rhs.hsync_start &&
+          lhs.hsync_end == rhs.hsync_end && lhs.htotal == rhs.htotal && lhs.hskew == rhs.hskew &&
+          lhs.vdisplay == rhs.vdisplay && lhs.vsync_start == rhs.vsync_start && lhs.vsync_end == rhs.vsync_end &&
+          lhs.vtotal == rhs.vtotal && lhs.vscan == rhs.vscan && lhs.flags == rhs.flags;
+}
+
+bool drm_display::is_mode_available(const drmModeModeInfo &mode) const
+{
+   const drmModeConnector *connector = get_current_connector();
+   if (connector == nullptr)
+   {
+      return false;
+   }
+
+   /* Without a probe the modes of a connector plugged in again are not known yet, so the mode is given the benefit of
+    * the doubt. */
+   if (connector->count_modes == 0)
+   {
+      return true;
+   }
+
+   return std::any_of(connector->modes, connector->modes + connector->count_modes,
+                      [&mode](const drmModeModeInfo &connector_mode) { return have_same_timings(connector_mode, mode); });
+}
+
+bool drm_display::is_mode_preferred(const drmModeModeInfo &mode) const
+{
+   const drmModeConnector *connector = get_current_connector();
+   if (connector == nullptr)
+   {
+      return false;
+   }
+
+   /* As in is_mode_available, modes that are not known yet do not change the preference. */
+   if (connector->count_modes == 0)
+   {
+      return true;
+   }
+
+   return std::any_of(connector->modes, connector->modes + connector->count_modes,
+                      [&mode](const drmModeModeInfo &connector_mode) {
+                         return (connector_mode.type & DRM_MODE_TYPE_PREFERRED) != 0 &&
+                                have_same_timings(connector_mode, mode);
+                      });
+}
+
+bool drm_display::is_mode_set(const drmModeModeInfo &mode) const
+{
+   drm_crtc_owner crtc{ drmModeGetCrtc(m_drm_fd, static_cast<uint32_t>(get_crtc_id())) };
+   if (crtc == nullptr || !crtc->mode_valid || crtc->buffer_id == 0 || !have_same_timings(crtc->mode, mode))
+   {
+      return false;
+   }
+
+   drm_connector_owner connector{ drmModeGetConnectorCurrent(m_drm_fd, get_connector_id()) };
+   if (connector == nullptr || connector->encoder_id == 0)
+   {
+      return false;
+   }
+
+   drm_encoder_owner encoder{ drmModeGetEncoder(m_drm_fd, connector->encoder_id) };
+   return encoder != nullptr && encoder->crtc_id == crtc->crtc_id;
+}
+
+uint32_t drm_display::get_primary_plane_id() const
+{
+   return m_primary_plane_id;
+}
+
+size_t drm_display::get_num_overlay_planes() const
+{
+   return m_overlay_planes->size();
+}
+
+const drm_overlay_plane *drm_display::get_overlay_plane(size_t index) const
+{
+   return index < m_overlay_planes->size() ? &(*m_overlay_planes)[index] : nullptr;
+}
+
+bool drm_display::is_plane_compatible(uint32_t possible_crtcs) const
+{
+   return (possible_crtcs & (1u << m_crtc_index)) != 0;
+}
+
+bool drm_display::add_overlay_plane(drm_overlay_plane plane)
+{
+   return m_overlay_planes->try_push_back(std::move(plane));
+}
+
+const drm_atomic_properties *drm_display::get_atomic_properties() const
+{
+   return m_atomic_properties.has_value() ? &m_atomic_properties.value() : nullptr;
+}
+
+bool drm_display::supports_vrr() const
+{
+   return m_atomic_properties.has_value() && m_atomic_properties->crtc_vrr_enabled != 0;
+}
+
+bool drm_display::supports_async_page_flip(bool atomic) const
+{
+   return atomic ? m_supports_atomic_async_page_flip : m_supports_legacy_async_page_flip;
+}
+
+bool drm_display::supports_plane_scaling() const
+{
+   return m_supports_plane_scaling;
+}
+
+bool drm_display::test_plane_scaling(uint32_t plane_id, const drm_plane_properties &plane_props, VkExtent2D src_extent,
+                                     const VkRect2D &crtc_rect, const drmModeModeInfo *mode) const
+{
+   if (!m_atomic_properties.has_value())
+   {
+      return false;
+   }
+
+   drm_mode_create_dumb create_dumb = {};
+   create_dumb.width = src_extent.width;
+   create_dumb.height = src_extent.height;
+   create_dumb.bpp = 32;
+   if (drmIoctl(m_drm_fd, DRM_IOCTL_MODE_CREATE_DUMB, &create_dumb) != 0)
+   {
+      WSI_LOG_WARNING("Failed to create a buffer to test plane scaling: %s", std::strerror(errno));
+      return true;
+   }
+
+   const uint32_t handles[4] = { create_dumb.handle, 0, 0, 0 };
+   const uint32_t pitches[4] = { create_dumb.pitch, 0, 0, 0 };
+   const uint32_t offsets[4] = { 0, 0, 0, 0 };
+   uint32_t fb_id = 0;
+   uint32_t mode_blob_id = 0;
+   drm_atomic_req_owner request{ drmModeAtomicAlloc() };
+   bool test_ready =
+      request != nullptr && drmModeAddFB2(m_drm_fd, src_extent.width, src_extent.height, DRM_FORMAT_XRGB8888, handles,
+                                          pitches, offsets, &fb_id, 0) == 0;
+   if (test_ready && mode != nullptr)
+   {
+      test_ready = drmModeCreatePropertyBlob(m_drm_fd, mode, sizeof(*mode), &mode_blob_id) == 0;
+   }
+
+   bool accepted = true;
+   if (test_ready)
+   {
+      /* Plane source coordinates are in 16.16 fixed point. */
+      const uint32_t crtc_id = static_cast<uint32_t>(m_crtc_id);
+      const std::pair<uint32_t, uint64_t> plane_properties[] = {
+         { plane_props.fb_id, fb_id },
+         { plane_props.crtc_id, crtc_id },
+         { plane_props.src_x, 0 },
+         { plane_props.src_y, 0 },
+         { plane_props.src_w, static_cast<uint64_t>(src_extent.width) << 16 },
+         { plane_props.src_h, static_cast<uint64_t>(src_extent.height) << 16 },
+         { plane_props.crtc_x, static_cast<uint64_t>(crtc_rect.offset.x) },
+         { plane_props.crtc_y, static_cast<uint64_t>(crtc_rect.offset.y) },
+         { plane_props.crtc_w, crtc_rect.extent.width },
+         { plane_props.crtc_h, crtc_rect.extent.height },
+      };
+      for (const auto &property : plane_properties)
+      {
+         test_ready =
+            test_ready && drmModeAtomicAddProperty(request.get(), plane_id, property.first, property.second) >= 0;
+      }
+      if (mode != nullptr)
+      {
+         test_ready = test_ready &&
+                      drmModeAtomicAddProperty(request.get(), get_connector_id(),
+                                               m_atomic_properties->connector_crtc_id, crtc_id) >= 0 &&
+                      drmModeAtomicAddProperty(request.get(), crtc_id, m_atomic_properties->crtc_mode_id,
+                                               mode_blob_id) >= 0 &&
+                      drmModeAtomicAddProperty(request.get(), crtc_id, m_atomic_properties->crtc_active, 1) >= 0;
+      }
+
+      accepted = !test_ready || drmModeAtomicCommit(m_drm_fd, request.get(),
+                                                    DRM_MODE_ATOMIC_TEST_ONLY | DRM_MODE_ATOMIC_ALLOW_MODESET,
+                                                    nullptr) == 0;
+   }
+
+   if (mode_blob_id != 0)
+   {
+      drmModeDestroyPropertyBlob(m_drm_fd, mode_blob_id);
+   }
+   if (fb_id != 0)
+   {
+      drmModeRmFB(m_drm_fd, fb_id);
+   }
+   drm_mode_destroy_dumb destroy_dumb = {};
+   destroy_dumb.handle = create_dumb.handle;
+   drmIoctl(m_drm_fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy_dumb);
+   return accepted;
+}
+
+drm_event_loop &drm_display::get_event_loop() const
+{
+   return *m_event_loop;
+}
+
+drm_framebuffer_cache &drm_display::get_framebuffer_cache() const
+{
+   return *m_framebuffer_cache;
+}
+
 uint32_t drm_display::get_max_width() const
 {
    return m_max_width;
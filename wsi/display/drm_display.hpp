@@ -27,11 +27,14 @@
 #include <vulkan/vulkan.h>
 #include <xf86drmMode.h>
 #include <xf86drm.h>
+#include <mutex>
 #include <optional>
 
 #include "util/custom_allocator.hpp"
 #include "util/file_descriptor.hpp"
 #include "wsi/surface.hpp"
+#include "drm_event_loop.hpp"
+#include "drm_framebuffer_cache.hpp"
 
 namespace wsi
 {
@@ -57,11 +60,69 @@ using drm_owner = std::unique_ptr<T, drm_deleter<T, drm_object_free>>;
 using drm_resources_owner = drm_owner<_drmModeRes, drmModeFreeResources>;
 using drm_connector_owner = drm_owner<_drmModeConnector, drmModeFreeConnector>;
 using drm_encoder_owner = drm_owner<_drmModeEncoder, drmModeFreeEncoder>;
+using drm_crtc_owner = drm_owner<_drmModeCrtc, drmModeFreeCrtc>;
 using drm_plane_owner = drm_owner<_drmModePlane, drmModeFreePlane>;
 using drm_plane_resources_owner = drm_owner<_drmModePlaneRes, drmModeFreePlaneResources>;
 using drm_object_properties_owner = drm_owner<_drmModeObjectProperties, drmModeFreeObjectProperties>;
 using drm_property_owner = drm_owner<_drmModeProperty, drmModeFreeProperty>;
 using drm_property_blob_owner = drm_owner<_drmModePropertyBlob, drmModeFreePropertyBlob>;
+using drm_atomic_req_owner = drm_owner<_drmModeAtomicReq, drmModeAtomicFree>;
+
+/**
+ * @brief Ids of the KMS properties set by atomic commits on a plane.
+ */
+struct drm_plane_properties
+{
+   uint32_t fb_id;
+   uint32_t crtc_id;
+   uint32_t src_x;
+   uint32_t src_y;
+   uint32_t src_w;
+   uint32_t src_h;
+   uint32_t crtc_x;
+   uint32_t crtc_y;
+   uint32_t crtc_w;
+   uint32_t crtc_h;
+   uint32_t in_fence_fd;
+};
+
+/**
+ * @brief Ids of the KMS properties set by atomic commits on the display's connector, CRTC and primary plane.
+ */
+struct drm_atomic_properties
+{
+   uint32_t connector_crtc_id;
+
+   uint32_t crtc_mode_id;
+   uint32_t crtc_active;
+   /* 0 if the connector or the CRTC are not capable of variable refresh rate. */
+   uint32_t crtc_vrr_enabled;
+
+   drm_plane_properties plane;
+};
+
+/**
+ * @brief An overlay plane of a display's CRTC, composed over the primary plane by the display controller.
+ *
+ * Overlay planes are only driven with atomic commits, so they are only assigned to displays using atomic KMS.
+ */
+struct drm_overlay_plane
+{
+   /**
+    * @brief Id of the plane.
+    */
+   uint32_t id;
+
+   /**
+    * @brief KMS properties of the plane.
+    */
+   drm_plane_properties properties;
+
+   /**
+    * @brief Formats the plane can scan out.
+    */
+   util::unique_ptr<util::vector<drm_format_pair>> supported_formats;
+};
 
 /**
  * @brief Owner class for an array of DRM GEM buffer handles.
@@ -184,24 +245,23 @@ class drm_display
 {
 public:
    /**
-    * @brief Construct and initialize a display object.
+    * @brief Construct the display of a connector with its modes.
+    *
+    * The CRTC and planes of the display are only set up by @ref init_planes, when the display is presented to.
     *
-    * @param allocator The allocator object that the display will use.
+    * @param allocator   The allocator object that the display will use.
+    * @param drm_fd      The DRM device, owned by the @ref drm_display_registry.
+    * @param connector   The connector to drive.
+    * @param event_loop  The page flip event loop of the device.
     * @return std::optional<drm_display> containing a display if initialization went well, otherwise std::nullopt.
     */
-   static std::optional<drm_display> make_display(const util::allocator &allocator, const char *drm_device);
-
-   static std::optional<drm_display> &get_display();
+   static std::optional<drm_display> make_display(const util::allocator &allocator, const util::fd_owner &drm_fd,
+                                                  drm_connector_owner connector, drm_event_loop &event_loop);
 
    drm_display(drm_display &&other) = default;
 
    drm_display &operator=(drm_display &&other) = default;
 
-   /**
-    * @brief display destructor.
-    */
-   ~drm_display();
-
    /**
     * @brief Get the display modes begin pointer.
     *
@@ -273,6 +333,15 @@ public:
     */
    bool is_format_supported(const drm_format_pair &format) const;
 
+   /**
+    * @brief Query a plane of the display for support of a specific format and modifier combination.
+    *
+    * @param format        The format to query support for.
+    * @param overlay_plane The overlay plane to query, or nullptr for the primary plane.
+    * @return true if the format is supported by the plane, otherwise false.
+    */
+   bool is_format_supported(const drm_format_pair &format, const drm_overlay_plane *overlay_plane) const;
+
    /**
     * @brief Returns a CRTC compatible with this display's connector.
     *
@@ -280,6 +349,113 @@ public:
     */
    int get_crtc_id() const;
 
+   /**
+    * @brief Whether a CRTC and a primary plane could be reserved for the display, which presenting requires.
+    *
+    * Only meaningful once the registry has been set up for presentation with
+    * @ref drm_display_registry::get_for_presentation.
+    */
+   bool is_presentable() const;
+
+   /**
+    * @brief Get the id of the primary plane of the CRTC.
+    */
+   uint32_t get_primary_plane_id() const;
+
+   /**
+    * @brief Get the number of overlay planes assigned to the display.
+    */
+   size_t get_num_overlay_planes() const;
+
+   /**
+    * @brief Get an overlay plane of the display.
+    *
+    * @return The plane or nullptr if @p index is out of range.
+    */
+   const drm_overlay_plane *get_overlay_plane(size_t index) const;
+
+   /**
+    * @brief Get the KMS properties used for atomic commits.
+    *
+    * @return The properties, or nullptr if the device does not support atomic modesetting or the
+    *         WSI_DISPLAY_LEGACY_KMS environment variable is set.
+    */
+   const drm_atomic_properties *get_atomic_properties() const;
+
+   /**
+    * @brief Whether the device can flip without waiting for vblank.
+    *
+    * @param atomic Whether the flips are atomic commits or legacy page flips.
+    */
+   bool supports_async_page_flip(bool atomic) const;
+
+   /**
+    * @brief Whether the display can use variable refresh rate, which requires atomic modesetting.
+    */
+   bool supports_vrr() const;
+
+   /**
+    * @brief Whether the primary plane of the display can upscale images, which requires atomic modesetting.
+    *
+    * Checked once, when the planes are set up, with a test commit stretching half of the preferred mode to all of it.
+    */
+   bool supports_plane_scaling() const;
+
+   /**
+    * @brief Check with a test commit whether a plane of the display can scale images to a rectangle of the CRTC.
+    *
+    * A dumb buffer of @p src_extent stands in for the images, which may not exist yet.
+    *
+    * @param plane_id    The primary plane or an overlay plane of the display.
+    * @param plane_props The KMS properties of the plane.
+    * @param src_extent  Extent of the images.
+    * @param crtc_rect   Rectangle of the CRTC the images are scaled to.
+    * @param mode        The mode set with the commit, or nullptr to test without a modeset.
+    *
+    * @return false if the driver rejects the commit, true if it accepts it or the test could not be made.
+    */
+   bool test_plane_scaling(uint32_t plane_id, const drm_plane_properties &plane_props, VkExtent2D src_extent,
+                           const VkRect2D &crtc_rect, const drmModeModeInfo *mode) const;
+
+   /**
+    * @brief Get the loop handling the page flip events of the DRM device.
+    */
+   drm_event_loop &get_event_loop() const;
+
+   /**
+    * @brief Whether the connector of the display was connected when it was last read.
+    *
+    * Only called on the event loop thread, which refreshes the connector on hotplug events.
+    */
+   bool is_connected() const;
+
+   /**
+    * @brief Whether the connector offered a mode with the timings of @p mode when it was last read.
+    *
+    * Only called on the event loop thread, which refreshes the connector on hotplug events.
+    */
+   bool is_mode_available(const drmModeModeInfo &mode) const;
+
+   /**
+    * @brief Whether @p mode has the timings of the preferred mode of the connector when it was last read.
+    *
+    * Only called on the event loop thread, which refreshes the connector on hotplug events.
+    */
+   bool is_mode_preferred(const drmModeModeInfo &mode) const;
+
+   /**
+    * @brief Whether the CRTC of the display currently scans out @p mode to its connector.
+    *
+    * Reads the current state from the kernel, without probing the connector, so a new framebuffer can then be shown
+    * with a page flip instead of a modeset.
+    */
+   bool is_mode_set(const drmModeModeInfo &mode) const;
+
+   /**
+    * @brief Get the cache of the framebuffers of the swapchain images presented to the display.
+    */
+   drm_framebuffer_cache &get_framebuffer_cache() const;
+
    /**
     * @brief Get the max width of the display in pixels.
     */
@@ -291,31 +467,90 @@ public:
    uint32_t get_max_height() const;
 
 private:
+   friend class drm_display_registry;
+
    /**
     * @brief display constructor.
-    *
-    * @param allocator The allocator that the display will use.
     */
-   drm_display(util::fd_owner drm_fd, int crtc_id, drm_connector_owner drm_connector,
+   drm_display(int drm_fd, drm_connector_owner drm_connector, util::unique_ptr<drm_display_mode> display_modes,
+               size_t num_display_modes, uint32_t max_width, uint32_t max_height, drm_event_loop *event_loop,
                util::unique_ptr<util::vector<drm_format_pair>> supported_formats,
-               util::unique_ptr<drm_display_mode> display_modes, size_t num_display_modes, uint32_t max_width,
-               uint32_t max_height, bool supports_fb_modifiers);
+               util::unique_ptr<util::vector<drm_overlay_plane>> overlay_planes);
 
    /**
-    * @brief File descriptor for the display device.
+    * @brief Reserve a CRTC and a primary plane for the display and query what they support.
+    *
+    * @param allocator   The allocator used for the display's framebuffer cache.
+    * @param drm_fd      The DRM device.
+    * @param crtc_id     The CRTC reserved for the connector.
+    * @param crtc_index  Index of the CRTC in the DRM resources.
+    * @param plane_res   The plane resources of the device.
+    * @param used_planes Planes already used by other displays. The primary plane of the display is added to it.
+    * @param use_atomic  Whether the device has atomic modesetting enabled.
+    * @return true on success, otherwise false and the display cannot be presented to.
     */
-   util::fd_owner m_drm_fd;
+   bool init_planes(const util::allocator &allocator, const util::fd_owner &drm_fd, int crtc_id, uint32_t crtc_index,
+                    const drm_plane_resources_owner &plane_res, util::vector<uint32_t> &used_planes, bool use_atomic);
 
    /**
-    * @brief Id of CRTC compatible with the chosen connector.
+    * @brief Whether the CRTC of the display can use a plane.
+    *
+    * @param possible_crtcs The possible_crtcs mask of the plane.
+    */
+   bool is_plane_compatible(uint32_t possible_crtcs) const;
+
+   /**
+    * @brief Assign an overlay plane to the display.
+    *
+    * @return true on success, false when out of memory.
+    */
+   bool add_overlay_plane(drm_overlay_plane plane);
+
+   /**
+    * @brief Read the connector of the display again, after a hotplug event.
+    *
+    * Only the state checked by @ref is_connected, @ref is_mode_available and @ref is_mode_preferred is refreshed, the
+    * modes enumerated through Vulkan keep their handles. Called on the event loop thread.
+    */
+   void refresh_connector();
+
+   /**
+    * @brief Get the connector as last read by @ref refresh_connector, or as read when the display was created.
+    *
+    * @return The connector or nullptr if it could not be read.
+    */
+   const drmModeConnector *get_current_connector() const;
+
+   /**
+    * @brief File descriptor for the display device, owned by the @ref drm_display_registry.
+    */
+   int m_drm_fd;
+
+   /**
+    * @brief Id of CRTC compatible with the chosen connector, -1 until @ref init_planes has reserved one.
     */
    int m_crtc_id;
 
+   /**
+    * @brief Index of @ref m_crtc_id in the DRM resources.
+    */
+   uint32_t m_crtc_index;
+
    /**
     * @brief Handle to the drm connector.
     */
    drm_connector_owner m_drm_connector;
 
+   /**
+    * @brief The connector as read by the last @ref refresh_connector, only accessed on the event loop thread.
+    */
+   drm_connector_owner m_current_connector;
+
+   /**
+    * @brief Whether @ref refresh_connector has run, @ref m_drm_connector is current until then.
+    */
+   bool m_connector_refreshed;
+
    /**
     * @brief Vector of supported formats for use with the display.
     */
@@ -345,6 +580,175 @@ private:
     * @brief Flag to indicate if the display supports framebuffers with format modifiers.
     */
    bool m_supports_fb_modifiers;
+
+   /**
+    * @brief Id of the primary plane.
+    */
+   uint32_t m_primary_plane_id;
+
+   /**
+    * @brief KMS properties for atomic commits, if atomic modesetting is used.
+    */
+   std::optional<drm_atomic_properties> m_atomic_properties;
+
+   /**
+    * @brief Whether DRM_MODE_PAGE_FLIP_ASYNC can be used with drmModePageFlip.
+    */
+   bool m_supports_legacy_async_page_flip;
+
+   /**
+    * @brief Whether DRM_MODE_PAGE_FLIP_ASYNC can be used with atomic commits.
+    */
+   bool m_supports_atomic_async_page_flip;
+
+   /**
+    * @brief Whether the primary plane can upscale images, see @ref supports_plane_scaling.
+    */
+   bool m_supports_plane_scaling;
+
+   /**
+    * @brief Page flip event loop of @ref m_drm_fd, shared with the other displays of the device.
+    */
+   drm_event_loop *m_event_loop;
+
+   /**
+    * @brief Overlay planes assigned to the display.
+    */
+   util::unique_ptr<util::vector<drm_overlay_plane>> m_overlay_planes;
+
+   /**
+    * @brief Framebuffers of the swapchain images, kept alive for as long as any swapchain uses them.
+    */
+   util::unique_ptr<drm_framebuffer_cache> m_framebuffer_cache;
+};
+
+/**
+ * @brief The displays of the DRM device.
+ *
+ * Owns the device and creates a display for every connected connector. Enumerating the displays and their modes
+ * only reads the connectors, so processes that merely probe for displays never become DRM master. The CRTCs and
+ * planes are set up the first time the registry is used for presentation: each display gets a CRTC and a primary
+ * plane of its own so that they can be presented to independently, and the overlay planes left over are shared out
+ * between the displays whose CRTCs can use them. There is a single registry for the process, since only one file
+ * descriptor can hold DRM master.
+ *
+ * Vulkan plane i is the primary plane of display i for i below the number of displays. The overlay planes follow,
+ * display by display.
+ */
+class drm_display_registry : private drm_hotplug_handler
+{
+public:
+   /**
+    * @brief Get the registry, opening the device from WSI_DISPLAY_DRI_DEV and reading its connectors on first use.
+    *
+    * @return The registry, or nullptr if the device could not be used or has no connected displays.
+    */
+   static drm_display_registry *get();
+
+   /**
+    * @brief Get the registry with the CRTCs and planes of its displays set up, as needed to query planes and present.
+    *
+    * @return The registry, or nullptr if the device could not be used or none of its displays can be presented to.
+    */
+   static drm_display_registry *get_for_presentation();
+
+   /**
+    * @brief Registry constructor, use @ref get instead.
+    */
+   drm_display_registry(util::fd_owner drm_fd, util::unique_ptr<drm_event_loop> event_loop,
+                        util::unique_ptr<util::vector<drm_display>> displays);
+
+   drm_display_registry(const drm_display_registry &) = delete;
+   drm_display_registry &operator=(const drm_display_registry &) = delete;
+
+   ~drm_display_registry();
+
+   /**
+    * @brief Get the number of displays.
+    */
+   size_t get_num_displays() const;
+
+   /**
+    * @brief Get a display, the display of plane @p index in Vulkan.
+    *
+    * @return The display or nullptr if @p index is out of range.
+    */
+   drm_display *get_display(size_t index);
+
+   /**
+    * @brief Find the display a mode belongs to.
+    *
+    * @return The display or nullptr if the mode is not one of the displays' modes.
+    */
+   drm_display *find_display(const drm_display_mode *mode);
+
+   /**
+    * @brief Get the number of planes, primary and overlay, of all the displays.
+    */
+   size_t get_num_planes() const;
+
+   /**
+    * @brief Get the display of a Vulkan plane.
+    *
+    * @param plane_index   Index of the plane.
+    * @param overlay_plane Set to the overlay plane, or nullptr if the plane is the display's primary plane.
+    * @return The display or nullptr if @p plane_index is out of range.
+    */
+   drm_display *get_plane_display(size_t plane_index, const drm_overlay_plane *&overlay_plane);
+
+private:
+   static util::unique_ptr<drm_display_registry> make_registry(const util::allocator &allocator,
+                                                               const char *drm_device);
+
+   /**
+    * @brief Refresh the connectors of the displays, called on the event loop thread for a hotplug event.
+    *
+    * Connectors connected after the registry was built do not get a display.
+    *
+    * @param connector_id The connector that changed, or 0 to refresh all of them.
+    */
+   void connectors_changed(uint32_t connector_id) override;
+
+   /**
+    * @brief Become DRM master and set up the CRTCs and planes of the displays.
+    *
+    * @return true if at least one display can be presented to, otherwise false.
+    */
+   bool init_planes(const util::allocator &allocator);
+
+   static void assign_overlay_planes(const util::allocator &allocator, const util::fd_owner &drm_fd,
+                                     const drm_plane_resources_owner &plane_res,
+                                     const util::vector<uint32_t> &used_planes, util::vector<drm_display> &displays);
+
+   /**
+    * @brief File descriptor for the display device.
+    */
+   util::fd_owner m_drm_fd;
+
+   /**
+    * @brief Page flip event loop of @ref m_drm_fd. Declared after it so that it is stopped before the fd is closed.
+    */
+   util::unique_ptr<drm_event_loop> m_event_loop;
+
+   /**
+    * @brief The displays of the connected connectors. Never reallocated, their addresses are the VkDisplayKHR handles.
+    */
+   util::unique_ptr<util::vector<drm_display>> m_displays;
+
+   /**
+    * @brief Protects the set up of the planes.
+    */
+   std::mutex m_planes_lock;
+
+   /**
+    * @brief Whether @ref init_planes has run.
+    */
+   bool m_planes_initialized;
+
+   /**
+    * @brief Whether @ref init_planes succeeded.
+    */
+   bool m_planes_available;
 };
 
 } /* namespace display */
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Implementation of the per DRM device page flip event loop.
+ */
+
+#include "drm_event_loop.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <xf86drm.h>
+
+#include "util/log.hpp"
+#include "util/macros.hpp"
+#include "util/thread.hpp"
+
+namespace wsi
+{
+
+namespace display
+{
+
+namespace
+{
+/** The loop handling events on the current thread, drmHandleEvent does not pass it to the handlers. */
+thread_local drm_event_loop *handling_loop = nullptr;
+} // namespace
+
+drm_event_loop::drm_event_loop(int drm_fd, const util::allocator &allocator)
+   : m_drm_fd(drm_fd)
+   , m_wakeup_fd()
+   , m_listeners(allocator)
+   , m_hotplug_handler(nullptr)
+#if DISPLAY_HOTPLUG_ENABLED
+   , m_udev(nullptr)
+   , m_udev_monitor(nullptr)
+#endif
+   , m_run(false)
+   , m_running(false)
+{
+}
+
+drm_event_loop::~drm_event_loop()
+{
+   stop();
+}
+
+bool drm_event_loop::start()
+{
+   if (m_thread.joinable())
+   {
+      return true;
+   }
+
+   m_wakeup_fd = util::fd_owner{ eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK) };
+   if (!m_wakeup_fd.is_valid())
+   {
+      WSI_LOG_ERROR("Failed to create the DRM event loop wake up event.");
+      return false;
+   }
+
+#if DISPLAY_HOTPLUG_ENABLED
+   if (m_udev_monitor == nullptr)
+   {
+      start_hotplug_monitor();
+   }
+#endif
+
+   m_run.store(true, std::memory_order_release);
+   m_running.store(true, std::memory_order_release);
+   try
+   {
+      m_thread = util::start_thread("wsi-drm-events", nullptr, &drm_event_loop::run, this);
+   }
+   catch (const std::system_error &)
+   {
+      WSI_LOG_ERROR("Failed to start the DRM event loop thread.");
+      m_run.store(false, std::memory_order_release);
+      m_running.store(false, std::memory_order_release);
+      return false;
+   }
+
+   return true;
+}
+
+void drm_event_loop::stop()
+{
+   m_run.store(false, std::memory_order_release);
+   if (m_thread.joinable())
+   {
+      const uint64_t value = 1;
+      ssize_t res = write(m_wakeup_fd.get(), &value, sizeof(value));
+      /* The write can only fail if the counter would overflow, which still leaves the thread woken up. */
+      UNUSED(res);
+      m_thread.join();
+   }
+}
+
+bool drm_event_loop::add_listener(drm_page_flip_listener *listener)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   if (!start())
+   {
+      return false;
+   }
+
+   return m_listeners.try_push_back(listener);
+}
+
+void drm_event_loop::remove_listener(drm_page_flip_listener *listener)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   auto it = std::find(m_listeners.begin(), m_listeners.end(), listener);
+   if (it != m_listeners.end())
+   {
+      m_listeners.erase(it);
+   }
+}
+
+void drm_event_loop::page_flip_handler(int fd, unsigned int sequence, unsigned int tv_sec, unsigned int tv_usec,
+                                       void *user_data)
+{
+   UNUSED(fd);
+   UNUSED(sequence);
+   assert(handling_loop != nullptr);
+
+   /* The listener may have been removed, and destroyed, while its flip was pending. */
+   auto *listener = static_cast<drm_page_flip_listener *>(user_data);
+   const auto &listeners = handling_loop->m_listeners;
+   if (std::find(listeners.begin(), listeners.end(), listener) != listeners.end())
+   {
+      const uint64_t timestamp_ns =
+         static_cast<uint64_t>(tv_sec) * 1000000000 + static_cast<uint64_t>(tv_usec) * 1000;
+      listener->page_flip_complete(timestamp_ns);
+   }
+}
+
+#if DISPLAY_HOTPLUG_ENABLED
+void drm_event_loop::start_hotplug_monitor()
+{
+   m_udev = udev_owner<struct udev>{ udev_new() };
+   if (m_udev == nullptr)
+   {
+      WSI_LOG_WARNING("Failed to create a udev context, display hotplug events will not be handled.");
+      return;
+   }
+
+   udev_owner<struct udev_monitor> monitor{ udev_monitor_new_from_netlink(m_udev.get(), "udev") };
+   if (monitor == nullptr || udev_monitor_filter_add_match_subsystem_devtype(monitor.get(), "drm", "drm_minor") < 0 ||
+       udev_monitor_enable_receiving(monitor.get()) < 0)
+   {
+      WSI_LOG_WARNING("Failed to create a udev monitor, display hotplug events will not be handled.");
+      m_udev.reset();
+      return;
+   }
+
+   m_udev_monitor = std::move(monitor);
+}
+
+void drm_event_loop::handle_udev_event()
+{
+   udev_owner<struct udev_device> device{ udev_monitor_receive_device(m_udev_monitor.get()) };
+   if (device == nullptr)
+   {
+      return;
+   }
+
+   /* The monitor receives the events of every DRM device, only the ones of the device of the loop matter. */
+   struct stat drm_stat = {};
+   if (fstat(m_drm_fd, &drm_stat) != 0 || udev_device_get_devnum(device.get()) != drm_stat.st_rdev)
+   {
+      return;
+   }
+
+   const char *hotplug = udev_device_get_property_value(device.get(), "HOTPLUG");
+   if (hotplug == nullptr || std::strcmp(hotplug, "1") != 0)
+   {
+      return;
+   }
+
+   /* Recent kernels name the connector that changed, so that only its display has to be refreshed. */
+   uint32_t connector_id = 0;
+   const char *connector = udev_device_get_property_value(device.get(), "CONNECTOR");
+   if (connector != nullptr)
+   {
+      connector_id = static_cast<uint32_t>(std::strtoul(connector, nullptr, 10));
+   }
+
+   /* Reading the connectors does not need the lock, so flip requests and listener changes are not held up by it. */
+   if (m_hotplug_handler != nullptr)
+   {
+      m_hotplug_handler->connectors_changed(connector_id);
+   }
+
+   std::lock_guard<std::mutex> lock(m_lock);
+   for (auto *listener : m_listeners)
+   {
+      listener->displays_changed();
+   }
+}
+#endif
+
+void drm_event_loop::run()
+{
+   handling_loop = this;
+
+   while (m_run.load(std::memory_order_acquire))
+   {
+      struct pollfd fds[3] = {};
+      fds[0].fd = m_drm_fd;
+      fds[0].events = POLLIN;
+      fds[1].fd = m_wakeup_fd.get();
+      fds[1].events = POLLIN;
+      /* poll ignores negative file descriptors, so the loop runs without hotplug events if there is no monitor. */
+#if DISPLAY_HOTPLUG_ENABLED
+      fds[2].fd = m_udev_monitor != nullptr ? udev_monitor_get_fd(m_udev_monitor.get()) : -1;
+#else
+      fds[2].fd = -1;
+#endif
+      fds[2].events = POLLIN;
+
+      int ret = poll(fds, 3, -1);
+      if (ret < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+
+         WSI_LOG_ERROR("Failed to poll the DRM device: %s", std::strerror(errno));
+         break;
+      }
+
+      if ((fds[1].revents & POLLIN) != 0)
+      {
+         /* Reset the event counter, the thread re-checks its state after every wake up. */
+         uint64_t value = 0;
+         ssize_t res = read(m_wakeup_fd.get(), &value, sizeof(value));
+         UNUSED(res);
+      }
+
+      if ((fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+      {
+         WSI_LOG_ERROR("The DRM device can no longer be polled for events.");
+         break;
+      }
+
+      if ((fds[0].revents & POLLIN) != 0)
+      {
+         drmEventContext context = {};
+         context.version = 2;
+         context.page_flip_handler = page_flip_handler;
+
+         std::lock_guard<std::mutex> lock(m_lock);
+         drmHandleEvent(m_drm_fd, &context);
+      }
+
+#if DISPLAY_HOTPLUG_ENABLED
+      if ((fds[2].revents & POLLIN) != 0)
+      {
+         handle_udev_event();
+      }
+#endif
+   }
+
+   handling_loop = nullptr;
+   m_running.store(false, std::memory_order_release);
+}
+
+} /* namespace display */
+
+} /* namespace wsi */
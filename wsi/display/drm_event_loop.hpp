@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Per DRM device loop handling page flip and hotplug events.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if DISPLAY_HOTPLUG_ENABLED
+#include <libudev.h>
+#endif
+
+#include "util/custom_allocator.hpp"
+#include "util/file_descriptor.hpp"
+
+namespace wsi
+{
+
+namespace display
+{
+
+/**
+ * @brief Receives the completion of the page flips it requested and the changes of the device's connectors.
+ */
+class drm_page_flip_listener
+{
+public:
+   /**
+    * @brief Called on the event loop thread when a flip requested with this listener as user data has completed.
+    *
+    * @param timestamp_ns Time at which the new framebuffer started scanning out, in CLOCK_MONOTONIC nanoseconds.
+    */
+   virtual void page_flip_complete(uint64_t timestamp_ns) = 0;
+
+   /**
+    * @brief Called on the event loop thread after the displays have been refreshed for a hotplug event.
+    */
+   virtual void displays_changed() = 0;
+
+protected:
+   ~drm_page_flip_listener() = default;
+};
+
+/**
+ * @brief Refreshes the state of the displays when the connectors of the device change.
+ */
+class drm_hotplug_handler
+{
+public:
+   /**
+    * @brief Called on the event loop thread for a hotplug event of the device, before the listeners are told.
+    *
+    * @param connector_id The connector that changed, or 0 if the event does not tell which one.
+    */
+   virtual void connectors_changed(uint32_t connector_id) = 0;
+
+protected:
+   ~drm_hotplug_handler() = default;
+};
+
+/**
+ * @brief Thread reading the events of a DRM device.
+ *
+ * There is one loop per DRM file descriptor, shared by all the swapchains presenting on it. Page flips and atomic
+ * commits are requested with DRM_MODE_PAGE_FLIP_EVENT and a registered listener as user data. The loop polls the
+ * device and calls the listener when the flip has completed, so the presenting thread does not have to wait for the
+ * vblank itself.
+ *
+ * When built with DISPLAY_HOTPLUG_ENABLED, the loop also polls a udev monitor for the hotplug events of the device,
+ * sent when a connector is plugged or unplugged or its modes change. For each of them it calls the hotplug handler,
+ * without the loop's lock, and then every listener, so that the swapchains can be marked out of date as soon as their
+ * display changes rather than when a flip fails.
+ *
+ * Listeners are called with the loop's lock held.
+ */
+class drm_event_loop
+{
+public:
+   /**
+    * @brief Create the loop of a DRM device. The thread is started when the first listener is added.
+    *
+    * @param drm_fd    The DRM device, which must outlive the loop.
+    * @param allocator The allocator used for the list of listeners.
+    */
+   drm_event_loop(int drm_fd, const util::allocator &allocator);
+   ~drm_event_loop();
+
+   drm_event_loop(const drm_event_loop &) = delete;
+   drm_event_loop &operator=(const drm_event_loop &) = delete;
+
+   /**
+    * @brief Start delivering page flip events to @p listener.
+    *
+    * @return true on success, false if the thread could not be started or memory could not be allocated.
+    */
+   bool add_listener(drm_page_flip_listener *listener);
+
+   /**
+    * @brief Stop delivering page flip events to @p listener.
+    *
+    * When this returns the listener is not running and will not be called again. Events of flips still pending for
+    * the listener are dropped.
+    */
+   void remove_listener(drm_page_flip_listener *listener);
+
+   /**
+    * @brief Set the handler called for the hotplug events of the device.
+    *
+    * Must be called before the first listener is added.
+    */
+   void set_hotplug_handler(drm_hotplug_handler *handler)
+   {
+      m_hotplug_handler = handler;
+   }
+
+   /**
+    * @brief Whether the thread is still reading events.
+    *
+    * The thread exits if the device can no longer be polled, in which case pending flips never complete.
+    */
+   bool is_running() const
+   {
+      return m_running.load(std::memory_order_acquire);
+   }
+
+private:
+   /**
+    * @brief Create the wake up event and start the thread if it is not running yet.
+    *
+    * @return true on success, false otherwise.
+    */
+   bool start();
+
+   /** @brief Stop and join the thread. */
+   void stop();
+
+   /** @brief Entry point of the thread. */
+   void run();
+
+   /** @brief Handler for the page flip events read by drmHandleEvent. */
+   static void page_flip_handler(int fd, unsigned int sequence, unsigned int tv_sec, unsigned int tv_usec,
+                                 void *user_data);
+
+#if DISPLAY_HOTPLUG_ENABLED
+   /**
+    * @brief Create the udev monitor of the device's hotplug events.
+    *
+    * Hotplug events are not handled if this fails, which is not an error.
+    */
+   void start_hotplug_monitor();
+
+   /** @brief Read an event of the udev monitor and handle it if it is a hotplug event of the device. */
+   void handle_udev_event();
+
+   struct udev_deleter
+   {
+      void operator()(struct udev *context)
+      {
+         udev_unref(context);
+      }
+
+      void operator()(struct udev_monitor *monitor)
+      {
+         udev_monitor_unref(monitor);
+      }
+
+      void operator()(struct udev_device *device)
+      {
+         udev_device_unref(device);
+      }
+   };
+
+   template <typename T>
+   using udev_owner = std::unique_ptr<T, udev_deleter>;
+#endif
+
+   /** The DRM device the loop reads. */
+   int m_drm_fd;
+
+   /** Event used to wake the thread up from its poll. */
+   util::fd_owner m_wakeup_fd;
+
+   /** Protects @ref m_listeners and is held while the events are handled. */
+   std::mutex m_lock;
+
+   /** Listeners events are delivered to. */
+   util::vector<drm_page_flip_listener *> m_listeners;
+
+   /** Handler of the hotplug events, called before the listeners. */
+   drm_hotplug_handler *m_hotplug_handler;
+
+#if DISPLAY_HOTPLUG_ENABLED
+   /** udev context of @ref m_udev_monitor. */
+   udev_owner<struct udev> m_udev;
+
+   /** Monitor of the DRM uevents, nullptr if hotplug events are not handled. */
+   udev_owner<struct udev_monitor> m_udev_monitor;
+#endif
+
+   /** Set while the thread should keep running. */
+   std::atomic<bool> m_run;
+
+   /** Set while the thread is reading events. */
+   std::atomic<bool> m_running;
+
+   /** The thread reading the device. */
+   std::thread m_thread;
+};
+
+} /* namespace display */
+
+} /* namespace wsi */
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Implementation of the display framebuffer cache.
+ */
+
+#include "drm_framebuffer_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "drm_display.hpp"
+#include "util/log.hpp"
+#include "util/macros.hpp"
+
+namespace wsi
+{
+
+namespace display
+{
+
+drm_framebuffer_cache::drm_framebuffer_cache(int drm_fd, bool supports_fb_modifiers, const util::allocator &allocator)
+   : m_drm_fd(drm_fd)
+   , m_supports_fb_modifiers(supports_fb_modifiers)
+   , m_entries(allocator)
+{
+}
+
+drm_framebuffer_cache::~drm_framebuffer_cache()
+{
+   /* Swapchains release their framebuffers when their images are destroyed. */
+   assert(m_entries.empty());
+   while (!m_entries.empty())
+   {
+      entry cached = m_entries.back();
+      drmModeRmFB(m_drm_fd, cached.fb_id);
+      m_entries.pop_back();
+      close_unused_handles(cached);
+   }
+}
+
+void drm_framebuffer_cache::close_unused_handles(const entry &closed_entry)
+{
+   for (uint32_t plane = 0; plane < closed_entry.num_planes; plane++)
+   {
+      const uint32_t handle = closed_entry.gem_handles[plane];
+      /* Planes of the same buffer share a handle, which only has to be closed once. */
+      bool in_use = std::find(closed_entry.gem_handles.begin(), closed_entry.gem_handles.begin() + plane, handle) !=
+                    closed_entry.gem_handles.begin() + plane;
+      for (const auto &cached : m_entries)
+      {
+         in_use = in_use || std::find(cached.gem_handles.begin(), cached.gem_handles.begin() + cached.num_planes,
+                                      handle) != cached.gem_handles.begin() + cached.num_planes;
+      }
+
+      if (!in_use)
+      {
+         drmCloseBufferHandle(m_drm_fd, handle);
+      }
+   }
+}
+
+VkResult drm_framebuffer_cache::create_framebuffer(entry &new_entry)
+{
+   std::array<uint64_t, util::MAX_PLANES> modifiers{ 0, 0, 0, 0 };
+   for (uint32_t plane = 0; plane < new_entry.num_planes; plane++)
+   {
+      modifiers[plane] = new_entry.format.modifier;
+   }
+
+   int error = 0;
+   if (m_supports_fb_modifiers)
+   {
+      error = drmModeAddFB2WithModifiers(m_drm_fd, new_entry.width, new_entry.height, new_entry.format.fourcc,
+                                         new_entry.gem_handles.data(), new_entry.strides.data(),
+                                         new_entry.offsets.data(), modifiers.data(), &new_entry.fb_id,
+                                         DRM_MODE_FB_MODIFIERS);
+   }
+   else
+   {
+      error = drmModeAddFB2(m_drm_fd, new_entry.width, new_entry.height, new_entry.format.fourcc,
+                            new_entry.gem_handles.data(), new_entry.strides.data(), new_entry.offsets.data(),
+                            &new_entry.fb_id, 0);
+   }
+
+   if (error != 0)
+   {
+      WSI_LOG_ERROR("Failed to create framebuffer: %s", std::strerror(errno));
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   return VK_SUCCESS;
+}
+
+VkResult drm_framebuffer_cache::acquire(const drm_framebuffer_desc &desc, uint32_t &fb_id)
+{
+   assert(desc.num_planes > 0 && desc.num_planes <= util::MAX_PLANES);
+
+   entry key{};
+   key.width = desc.width;
+   key.height = desc.height;
+   key.format = desc.format;
+   key.num_planes = desc.num_planes;
+   key.strides = desc.strides;
+   key.offsets = desc.offsets;
+
+   /* The handles are looked up with the lock held, so that release cannot close a handle between its lookup and its
+    * use. */
+   std::lock_guard<std::mutex> lock(m_lock);
+   for (uint32_t plane = 0; plane < desc.num_planes; plane++)
+   {
+      /* Importing a buffer that already has a GEM handle on the device returns that handle. */
+      if (drmPrimeFDToHandle(m_drm_fd, desc.buffer_fds[plane], &key.gem_handles[plane]) != 0)
+      {
+         WSI_LOG_ERROR("Failed to convert buffer FD to GEM handle: %s", std::strerror(errno));
+         key.num_planes = plane;
+         close_unused_handles(key);
+         return VK_ERROR_INITIALIZATION_FAILED;
+      }
+   }
+
+   auto cached = std::find_if(m_entries.begin(), m_entries.end(), [&key](const entry &candidate) {
+      return candidate.gem_handles == key.gem_handles && candidate.width == key.width &&
+             candidate.height == key.height && candidate.format.fourcc == key.format.fourcc &&
+             candidate.format.modifier == key.format.modifier && candidate.num_planes == key.num_planes &&
+             candidate.strides == key.strides && candidate.offsets == key.offsets;
+   });
+   if (cached != m_entries.end())
+   {
+      cached->ref_count++;
+      fb_id = cached->fb_id;
+      return VK_SUCCESS;
+   }
+
+   VkResult result = create_framebuffer(key);
+   if (result != VK_SUCCESS)
+   {
+      close_unused_handles(key);
+      return result;
+   }
+
+   key.ref_count = 1;
+   if (!m_entries.try_push_back(key))
+   {
+      drmModeRmFB(m_drm_fd, key.fb_id);
+      close_unused_handles(key);
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   fb_id = key.fb_id;
+   return VK_SUCCESS;
+}
+
+void drm_framebuffer_cache::release(uint32_t fb_id)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   auto cached = std::find_if(m_entries.begin(), m_entries.end(),
+                              [fb_id](const entry &candidate) { return candidate.fb_id == fb_id; });
+   assert(cached != m_entries.end());
+   if (cached == m_entries.end() || --cached->ref_count > 0)
+   {
+      return;
+   }
+
+   /* Removing a framebuffer that is still scanned out disables the plane, which is expected once no swapchain
+    * uses the buffer any more. */
+   int result = drmModeRmFB(m_drm_fd, cached->fb_id);
+   assert(result == 0);
+   UNUSED(result);
+
+   const entry removed = *cached;
+   m_entries.erase(cached);
+   close_unused_handles(removed);
+}
+
+} /* namespace display */
+
+} /* namespace wsi */
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Cache of the framebuffers created for swapchain images on a display.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+#include "util/custom_allocator.hpp"
+#include "util/helpers.hpp"
+#include "wsi/surface.hpp"
+
+namespace wsi
+{
+
+namespace display
+{
+
+/**
+ * @brief Description of the buffer a framebuffer scans out.
+ */
+struct drm_framebuffer_desc
+{
+   uint32_t width;
+   uint32_t height;
+   drm_format_pair format;
+   uint32_t num_planes;
+   std::array<int, util::MAX_PLANES> buffer_fds;
+   std::array<uint32_t, util::MAX_PLANES> strides;
+   std::array<uint32_t, util::MAX_PLANES> offsets;
+};
+
+/**
+ * @brief Reference counted framebuffers of a display, shared by all its swapchains.
+ *
+ * Framebuffers are keyed by the GEM handles of their buffers together with the layout of the buffer. The DRM device
+ * hands out a single GEM handle per buffer object however many times it is imported, whichever FD or dma-buf file it
+ * comes from, so a buffer imported again, by another swapchain or after a recreation, reuses its framebuffer instead
+ * of creating new kernel objects. The GEM handles are kept open while a framebuffer uses them, so that their values
+ * cannot be reused for other buffers. A framebuffer is removed when its last user releases it: it holds a reference
+ * to the buffer, so keeping it any longer would keep the memory of a freed image alive.
+ */
+class drm_framebuffer_cache
+{
+public:
+   /**
+    * @brief Create the cache of a display.
+    *
+    * @param drm_fd                The DRM device, which must outlive the cache.
+    * @param supports_fb_modifiers Whether framebuffers can be created with format modifiers.
+    * @param allocator             The allocator used for the cache entries.
+    */
+   drm_framebuffer_cache(int drm_fd, bool supports_fb_modifiers, const util::allocator &allocator);
+   ~drm_framebuffer_cache();
+
+   drm_framebuffer_cache(const drm_framebuffer_cache &) = delete;
+   drm_framebuffer_cache &operator=(const drm_framebuffer_cache &) = delete;
+
+   /**
+    * @brief Get a framebuffer for a buffer, creating it if it is not in the cache already.
+    *
+    * @param desc  The buffer to scan out.
+    * @param fb_id Set to the id of the framebuffer, which must be given back with @ref release.
+    * @return VK_SUCCESS on success, other result codes on failure.
+    */
+   VkResult acquire(const drm_framebuffer_desc &desc, uint32_t &fb_id);
+
+   /**
+    * @brief Release a framebuffer acquired with @ref acquire, removing it if it has no other user.
+    */
+   void release(uint32_t fb_id);
+
+private:
+   struct entry
+   {
+      std::array<uint32_t, util::MAX_PLANES> gem_handles;
+      uint32_t width;
+      uint32_t height;
+      drm_format_pair format;
+      uint32_t num_planes;
+      std::array<uint32_t, util::MAX_PLANES> strides;
+      std::array<uint32_t, util::MAX_PLANES> offsets;
+      uint32_t fb_id;
+      uint32_t ref_count;
+   };
+
+   /**
+    * @brief Create the framebuffer of an entry from its GEM handles.
+    */
+   VkResult create_framebuffer(entry &new_entry);
+
+   /**
+    * @brief Close the GEM handles of an entry that no entry in @ref m_entries uses. Called with @ref m_lock held.
+    */
+   void close_unused_handles(const entry &closed_entry);
+
+   /** The DRM device the framebuffers are created on. */
+   int m_drm_fd;
+
+   /** Whether framebuffers are created with drmModeAddFB2WithModifiers. */
+   bool m_supports_fb_modifiers;
+
+   /** Protects @ref m_entries, since swapchains of the display can be created and destroyed concurrently. */
+   std::mutex m_lock;
+
+   /** The framebuffers in use. */
+   util::vector<entry> m_entries;
+};
+
+} /* namespace display */
+
+} /* namespace wsi */
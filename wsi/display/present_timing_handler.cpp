@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file present_timing_handler.cpp
+ *
+ * @brief Contains the functionality to implement features for present timing extension.
+ */
+
+#include "present_timing_handler.hpp"
+#include <cstdint>
+
+wsi_ext_present_timing_display::wsi_ext_present_timing_display(const util::allocator &allocator,
+                                                               uint64_t refresh_duration)
+   : wsi::wsi_ext_present_timing(allocator)
+   , m_refresh_duration(refresh_duration)
+{
+}
+
+util::unique_ptr<wsi_ext_present_timing_display> wsi_ext_present_timing_display::create(
+   const util::allocator &allocator, uint64_t refresh_duration)
+{
+   /* The timestamps of DRM page flip events are taken with CLOCK_MONOTONIC. */
+   std::array<util::unique_ptr<wsi::vulkan_time_domain>, 3> time_domains_array = {
+      allocator.make_unique<wsi::vulkan_time_domain>(VK_PRESENT_STAGE_QUEUE_OPERATIONS_END_BIT_EXT,
+                                                     VK_TIME_DOMAIN_DEVICE_KHR),
+      allocator.make_unique<wsi::vulkan_time_domain>(VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT,
+                                                     VK_TIME_DOMAIN_CLOCK_MONOTONIC_KHR),
+      allocator.make_unique<wsi::vulkan_time_domain>(VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT,
+                                                     VK_TIME_DOMAIN_CLOCK_MONOTONIC_KHR)
+   };
+
+   return wsi_ext_present_timing::create<wsi_ext_present_timing_display>(allocator, time_domains_array,
+                                                                         refresh_duration);
+}
+
+VkResult wsi_ext_present_timing_display::get_swapchain_timing_properties(
+   uint64_t &timing_properties_counter, VkSwapchainTimingPropertiesEXT &timing_properties)
+{
+   timing_properties_counter = 1;
+   timing_properties.refreshDuration = m_refresh_duration;
+   timing_properties.variableRefreshDelay = UINT64_MAX;
+
+   return VK_SUCCESS;
+}
+
+void wsi_ext_present_timing_display::image_presented(uint64_t timing_slot, uint64_t present_time)
+{
+   /* The flip completes on the vertical blank the new framebuffer is latched on, and its scanout starts then. */
+   constexpr VkPresentStageFlagsEXT stages =
+      VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT | VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT;
+   complete_presentation_entry(timing_slot, stages, present_time, m_refresh_duration, 0);
+}
+
+void wsi_ext_present_timing_display::image_discarded(uint64_t timing_slot)
+{
+   complete_presentation_entry(timing_slot, 0, 0, m_refresh_duration, 0);
+}
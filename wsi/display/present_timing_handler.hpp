@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file present_timing_handler.hpp
+ *
+ * @brief Contains the functionality to implement features for present timing extension.
+ */
+#pragma once
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+
+#include <wsi/extensions/present_timing.hpp>
+
+/**
+ * @brief Present timing extension class
+ *
+ * This class implements present timing features declarations that are specific to the display backend, which reports
+ * the vertical blank timestamps of the page flips.
+ */
+class wsi_ext_present_timing_display : public wsi::wsi_ext_present_timing
+{
+public:
+   /**
+    * @brief Create the display present timing extension.
+    *
+    * @param allocator        Allocator for the extension.
+    * @param refresh_duration Refresh duration of the display mode in nanoseconds, or 0 if unknown.
+    *
+    * @return The extension, or nullptr on failure.
+    */
+   static util::unique_ptr<wsi_ext_present_timing_display> create(const util::allocator &allocator,
+                                                                  uint64_t refresh_duration);
+
+   VkResult get_swapchain_timing_properties(uint64_t &timing_properties_counter,
+                                            VkSwapchainTimingPropertiesEXT &timing_properties) override;
+
+   /**
+    * @brief Record the page flip that put an image on screen.
+    *
+    * @param timing_slot  The slot of the presentation entry, 0 if no timing was requested.
+    * @param present_time CLOCK_MONOTONIC time of the vertical blank the flip completed on, in nanoseconds.
+    */
+   void image_presented(uint64_t timing_slot, uint64_t present_time);
+
+   /**
+    * @brief Record that an image was replaced before it was flipped on screen.
+    *
+    * @param timing_slot The slot of the presentation entry, 0 if no timing was requested.
+    */
+   void image_discarded(uint64_t timing_slot);
+
+private:
+   wsi_ext_present_timing_display(const util::allocator &allocator, uint64_t refresh_duration);
+
+   /* Allow util::allocator to access the private constructor */
+   friend util::allocator;
+
+   /**
+    * @brief Refresh duration of the display mode, 0 when unknown.
+    */
+   uint64_t m_refresh_duration;
+};
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/** @file
+ * @brief Implementation of the buffers allocated ahead of the first swapchain of a display surface.
+ */
+
+#include "speculative_allocation.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+#include <system_error>
+
+#include "util/log.hpp"
+#include "util/thread.hpp"
+
+namespace wsi
+{
+
+namespace display
+{
+
+speculative_allocation::speculative_allocation(const util::allocator &allocator,
+                                               layer::instance_private_data &instance_data,
+                                               VkPhysicalDevice physical_device, VkExtent2D extent, uint64_t flags)
+   : m_instance_data(instance_data)
+   , m_physical_device(physical_device)
+   , m_formats(allocator)
+   , m_extent(extent)
+   , m_flags(flags)
+   , m_allocations(allocator)
+   , m_allocated(false)
+{
+}
+
+util::unique_ptr<speculative_allocation> speculative_allocation::create(const util::allocator &allocator,
+                                                                        layer::instance_private_data &instance_data,
+                                                                        VkPhysicalDevice physical_device,
+                                                                        const util::vector<wsialloc_format> &formats,
+                                                                        VkExtent2D extent, uint64_t flags,
+                                                                        uint32_t count)
+{
+   assert(count > 0);
+   auto allocation =
+      allocator.make_unique<speculative_allocation>(allocator, instance_data, physical_device, extent, flags);
+   if (allocation == nullptr || !allocation->m_formats.try_resize(formats.size()) ||
+       !allocation->m_allocations.try_resize(count))
+   {
+      return nullptr;
+   }
+   std::copy(formats.begin(), formats.end(), allocation->m_formats.begin());
+
+   try
+   {
+      allocation->m_thread = util::start_thread("wsi-prealloc", nullptr, &speculative_allocation::allocate,
+                                                allocation.get());
+   }
+   catch (const std::system_error &)
+   {
+      return nullptr;
+   }
+   catch (const std::bad_alloc &)
+   {
+      return nullptr;
+   }
+   return allocation;
+}
+
+speculative_allocation::~speculative_allocation()
+{
+   if (m_thread.joinable())
+   {
+      m_thread.join();
+   }
+
+   if (m_allocated)
+   {
+      std::for_each(m_allocations.begin(), m_allocations.end(), close_wsialloc_buffer);
+   }
+}
+
+void speculative_allocation::allocate()
+{
+   wsialloc_allocator *wsi_allocator = nullptr;
+   /* The same device as the swapchain's allocator, so that the buffers can be taken over. */
+   if (create_wsialloc_allocator(m_instance_data, m_physical_device, &wsi_allocator) != WSIALLOC_ERROR_NONE)
+   {
+      return;
+   }
+
+   const wsialloc_allocate_info info = { m_formats.data(), static_cast<unsigned>(m_formats.size()), m_extent.width,
+                                         m_extent.height, m_flags };
+   const auto count = static_cast<uint32_t>(m_allocations.size());
+   const auto res = wsialloc_alloc_batch(wsi_allocator, &info, count, m_allocations.data());
+   if (res == WSIALLOC_ERROR_NONE)
+   {
+      m_allocated = true;
+   }
+   else
+   {
+      WSI_LOG_WARNING("Speculative allocation of swapchain buffers failed. WSI error: %d", static_cast<int>(res));
+   }
+
+   /* The allocator is only released once the buffers allocated from it are closed. */
+   wsialloc_delete(wsi_allocator);
+}
+
+uint32_t speculative_allocation::take(const wsialloc_format &format, VkExtent2D extent, uint64_t flags,
+                                      wsialloc_batch &allocations)
+{
+   if (m_thread.joinable())
+   {
+      m_thread.join();
+   }
+
+   if (!m_allocated || m_allocations.empty() || extent.width != m_extent.width ||
+       extent.height != m_extent.height || flags != m_flags || m_allocations[0].format.fourcc != format.fourcc ||
+       m_allocations[0].format.modifier != format.modifier)
+   {
+      return 0;
+   }
+
+   uint32_t taken = 0;
+   while (!m_allocations.empty() && allocations.add(m_allocations.back()))
+   {
+      m_allocations.pop_back();
+      taken++;
+   }
+   return taken;
+}
+
+} /* namespace display */
+
+} /* namespace wsi */
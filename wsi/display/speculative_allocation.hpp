@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/** @file
+ * @brief Buffers allocated in the background for the first swapchain of a display surface.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+#include <vulkan/vulkan.h>
+
+#include "util/custom_allocator.hpp"
+#include "util/helpers.hpp"
+#include "util/wsialloc/wsialloc.h"
+#include "wsi/wsialloc_batch.hpp"
+
+namespace wsi
+{
+
+namespace display
+{
+
+/**
+ * @brief Buffers allocated ahead of the first swapchain of a surface.
+ *
+ * Allocating and zeroing the buffers is a large part of the time vkCreateSwapchainKHR takes. When the
+ * "speculative_allocation" setting is enabled, a surface starts allocating the buffers its first swapchain most likely
+ * uses on a background thread as soon as the application queries its capabilities. The swapchain takes them over if it
+ * allocates its images with the same format, extent and flags, otherwise they are freed.
+ */
+class speculative_allocation : private util::noncopyable
+{
+public:
+   /**
+    * @brief Start allocating buffers on a background thread.
+    *
+    * @param allocator       Allocator for the host objects.
+    * @param instance_data   The instance of @p physical_device.
+    * @param physical_device The physical device the swapchain is most likely created on.
+    * @param formats         Formats the buffers may be allocated with, wsialloc selects one of them.
+    * @param extent          Extent of the buffers.
+    * @param flags           wsialloc allocation flags of the buffers.
+    * @param count           Number of buffers.
+    *
+    * @return The allocation, or nullptr if it could not be started.
+    */
+   static util::unique_ptr<speculative_allocation> create(const util::allocator &allocator,
+                                                          layer::instance_private_data &instance_data,
+                                                          VkPhysicalDevice physical_device,
+                                                          const util::vector<wsialloc_format> &formats,
+                                                          VkExtent2D extent, uint64_t flags, uint32_t count);
+
+   /**
+    * @brief Wait for the background thread and free the buffers that were not taken.
+    */
+   ~speculative_allocation();
+
+   /**
+    * @brief Take the buffers over, if they match the images of a swapchain.
+    *
+    * Waits for the background allocation to finish.
+    *
+    * @param format           Format the swapchain allocates its images with.
+    * @param extent           Extent of the images.
+    * @param flags            wsialloc allocation flags of the images.
+    * @param[out] allocations The buffers taken over are added to it.
+    *
+    * @return The number of buffers taken over, 0 if they do not match.
+    */
+   uint32_t take(const wsialloc_format &format, VkExtent2D extent, uint64_t flags, wsialloc_batch &allocations);
+
+private:
+   speculative_allocation(const util::allocator &allocator, layer::instance_private_data &instance_data,
+                          VkPhysicalDevice physical_device, VkExtent2D extent, uint64_t flags);
+
+   /* Allow util::allocator to access the private constructor */
+   friend util::allocator;
+
+   /**
+    * @brief Body of the background thread.
+    */
+   void allocate();
+
+   layer::instance_private_data &m_instance_data;
+   VkPhysicalDevice m_physical_device;
+   util::vector<wsialloc_format> m_formats;
+   VkExtent2D m_extent;
+   uint64_t m_flags;
+
+   /**
+    * @brief The buffers, written by the background thread and only accessed by others once it is joined.
+    */
+   util::vector<wsialloc_allocate_result> m_allocations;
+
+   /**
+    * @brief Whether the background thread allocated @ref m_allocations.
+    */
+   bool m_allocated;
+
+   std::thread m_thread;
+};
+
+} /* namespace display */
+
+} /* namespace wsi */
@@ -26,19 +26,28 @@
  * @brief Implementation of a headless WSI Surface
  */
 
+#include <algorithm>
+
 #include "surface.hpp"
 #include "swapchain.hpp"
 #include "surface_properties.hpp"
 
+#include "layer/private_data.hpp"
+#include "util/drm/drm_utils.hpp"
+
 namespace wsi
 {
 namespace display
 {
 
-surface::surface(drm_display_mode *display_mode, VkExtent2D extent)
-   : m_display_mode(display_mode)
+surface::surface(drm_display &display, const drm_overlay_plane *overlay_plane, drm_display_mode *display_mode,
+                 VkExtent2D extent)
+   : m_display(display)
+   , m_overlay_plane(overlay_plane)
+   , m_display_mode(display_mode)
    , m_extent(extent)
    , m_surface_properties(this)
+   , m_speculative_allocation_started(false)
 {
 }
 
@@ -64,5 +73,73 @@ drm_display_mode *surface::get_display_mode()
    return m_display_mode;
 }
 
+drm_display &surface::get_display()
+{
+   return m_display;
+}
+
+const drm_overlay_plane *surface::get_overlay_plane() const
+{
+   return m_overlay_plane;
+}
+
+void surface::start_speculative_allocation(VkPhysicalDevice physical_device, uint32_t image_count)
+{
+   auto &instance_data = layer::instance_private_data::get(physical_device);
+   const auto &settings = instance_data.get_layer_settings();
+   if (!settings.speculative_allocation)
+   {
+      return;
+   }
+
+   std::lock_guard<std::mutex> lock(m_speculative_allocation_lock);
+   if (m_speculative_allocation_started)
+   {
+      return;
+   }
+   m_speculative_allocation_started = true;
+
+   const auto *plane_formats =
+      m_overlay_plane != nullptr ? m_overlay_plane->supported_formats.get() : m_display.get_supported_formats();
+   if (plane_formats == nullptr || plane_formats->empty())
+   {
+      return;
+   }
+
+   uint32_t fourcc = util::drm::vk_to_drm_format(VK_FORMAT_B8G8R8A8_UNORM);
+   if (std::none_of(plane_formats->begin(), plane_formats->end(),
+                    [fourcc](const drm_format_pair &format) { return format.fourcc == fourcc; }))
+   {
+      fourcc = plane_formats->front().fourcc;
+   }
+
+   util::allocator allocator{ instance_data.get_allocator(), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT };
+   util::vector<wsialloc_format> formats(util::allocator(allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+   for (const auto &format : *plane_formats)
+   {
+      if (format.fourcc == fourcc &&
+          !formats.try_push_back(wsialloc_format{ format.fourcc, format.modifier, WSIALLOC_FORMAT_NON_DISJOINT }))
+      {
+         return;
+      }
+   }
+
+   /* The same flags as the swapchains use, see swapchain::get_allocation_flags. */
+   uint64_t flags = WSIALLOC_ALLOCATE_USAGE_SCANOUT;
+   if (settings.scanout_compression)
+   {
+      flags |= WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION;
+   }
+
+   m_speculative_allocation = speculative_allocation::create(allocator, instance_data, physical_device, formats,
+                                                             m_extent, flags, image_count);
+}
+
+util::unique_ptr<speculative_allocation> surface::take_speculative_allocation()
+{
+   std::lock_guard<std::mutex> lock(m_speculative_allocation_lock);
+   return std::move(m_speculative_allocation);
+}
+
 } /* namespace display */
 } /* namespace wsi */
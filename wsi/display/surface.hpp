@@ -28,9 +28,12 @@
 
 #pragma once
 
+#include <mutex>
+
 #include "wsi/surface.hpp"
 #include "surface_properties.hpp"
 #include "drm_display.hpp"
+#include "speculative_allocation.hpp"
 
 namespace wsi
 {
@@ -43,10 +46,12 @@ public:
    /**
     * @brief Construct a new surface.
     *
+    * @param display The display the surface presents to.
+    * @param overlay_plane The overlay plane of the display the surface presents to, or nullptr for the primary plane.
     * @param mode The display mode to be used with the surface.
     * @param extent The extent of the surface.
     */
-   surface(drm_display_mode *mode, VkExtent2D extent);
+   surface(drm_display &display, const drm_overlay_plane *overlay_plane, drm_display_mode *mode, VkExtent2D extent);
 
    wsi::surface_properties &get_properties() override;
    util::unique_ptr<swapchain_base> allocate_swapchain(layer::device_private_data &dev_data,
@@ -62,7 +67,43 @@ public:
     */
    drm_display_mode *get_display_mode();
 
+   /**
+    * @brief Get the display this surface presents to.
+    */
+   drm_display &get_display();
+
+   /**
+    * @brief Get the overlay plane this surface presents to, or nullptr if it presents to the primary plane.
+    */
+   const drm_overlay_plane *get_overlay_plane() const;
+
+   /**
+    * @brief Start allocating the buffers of the first swapchain, when the "speculative_allocation" setting is enabled.
+    *
+    * Only the first call starts an allocation. It guesses the most common choice of applications, a B8G8R8A8 format
+    * when the plane supports it.
+    *
+    * @param physical_device The physical device the capabilities of the surface are queried for.
+    * @param image_count     Number of buffers to allocate.
+    */
+   void start_speculative_allocation(VkPhysicalDevice physical_device, uint32_t image_count);
+
+   /**
+    * @brief Take the buffers started by @ref start_speculative_allocation, if any. Only the first caller gets them.
+    */
+   util::unique_ptr<speculative_allocation> take_speculative_allocation();
+
 private:
+   /**
+    * @brief The display this surface presents to, owned by the @ref drm_display_registry.
+    */
+   drm_display &m_display;
+
+   /**
+    * @brief The overlay plane this surface presents to, nullptr for the display's primary plane.
+    */
+   const drm_overlay_plane *m_overlay_plane;
+
    /**
     * @brief Pointer to the DRM display mode used with this surface.
     */
@@ -77,6 +118,18 @@ private:
     * @brief Surface properties instance specific to this surface.
     */
    surface_properties m_surface_properties;
+
+   std::mutex m_speculative_allocation_lock;
+
+   /**
+    * @brief Whether @ref start_speculative_allocation was called already.
+    */
+   bool m_speculative_allocation_started;
+
+   /**
+    * @brief Buffers allocated for the first swapchain, until it takes them.
+    */
+   util::unique_ptr<speculative_allocation> m_speculative_allocation;
 };
 
 } /* namespace display */
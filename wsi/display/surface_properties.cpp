@@ -28,6 +28,7 @@
 #include "surface_properties.hpp"
 #include "surface.hpp"
 #include "util/macros.hpp"
+#include "util/proc_addr_table.hpp"
 
 namespace wsi
 {
@@ -39,18 +40,86 @@ constexpr int max_core_1_0_formats = VK_FORMAT_ASTC_12x12_SRGB_BLOCK + 1;
 
 void surface_properties::populate_present_mode_compatibilities()
 {
-   std::array<present_mode_compatibility, 1> compatible_present_modes_list = { present_mode_compatibility{
-      VK_PRESENT_MODE_FIFO_KHR, 1, { VK_PRESENT_MODE_FIFO_KHR } } };
-   m_compatible_present_modes = compatible_present_modes<1>(compatible_present_modes_list);
+   std::array<present_mode_compatibility, NUM_PRESENT_MODES> compatible_present_modes_list = {
+      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_KHR, 1, { VK_PRESENT_MODE_FIFO_KHR } },
+      present_mode_compatibility{ VK_PRESENT_MODE_MAILBOX_KHR, 1, { VK_PRESENT_MODE_MAILBOX_KHR } },
+      present_mode_compatibility{ VK_PRESENT_MODE_IMMEDIATE_KHR, 1, { VK_PRESENT_MODE_IMMEDIATE_KHR } },
+      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_RELAXED_KHR, 1, { VK_PRESENT_MODE_FIFO_RELAXED_KHR } },
+   };
+   m_compatible_present_modes = compatible_present_modes<NUM_PRESENT_MODES>(compatible_present_modes_list);
 }
 
 surface_properties::surface_properties(surface *wsi_surface)
    : m_specific_surface(wsi_surface)
-   , m_supported_modes({ VK_PRESENT_MODE_FIFO_KHR })
+   , m_supported_modes({ VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR,
+                         VK_PRESENT_MODE_FIFO_RELAXED_KHR })
 {
    populate_present_mode_compatibilities();
 }
 
+drm_display *surface_properties::get_display() const
+{
+   if (m_specific_surface != nullptr)
+   {
+      return &m_specific_surface->get_display();
+   }
+
+   /* Without a surface, report the properties of the first display that can be presented to. */
+   drm_display_registry *registry = drm_display_registry::get_for_presentation();
+   for (size_t i = 0; registry != nullptr && i < registry->get_num_displays(); i++)
+   {
+      if (registry->get_display(i)->is_presentable())
+      {
+         return registry->get_display(i);
+      }
+   }
+   return nullptr;
+}
+
+bool surface_properties::supports_async_page_flip() const
+{
+   /* Swapchains on overlay planes flip with vblank, see swapchain::present_image_atomic. */
+   if (m_specific_surface != nullptr && m_specific_surface->get_overlay_plane() != nullptr)
+   {
+      return false;
+   }
+
+   const drm_display *display = get_display();
+   return display != nullptr && display->supports_async_page_flip(display->get_atomic_properties() != nullptr);
+}
+
+bool surface_properties::supports_vrr() const
+{
+   /* Variable refresh rate is a CRTC state, set by the swapchains on the primary plane. */
+   if (m_specific_surface != nullptr && m_specific_surface->get_overlay_plane() != nullptr)
+   {
+      return false;
+   }
+
+   const drm_display *display = get_display();
+   return display != nullptr && display->supports_vrr();
+}
+
+bool surface_properties::supports_plane_scaling() const
+{
+   const drm_display *display = get_display();
+   return display != nullptr && display->supports_plane_scaling();
+}
+
+bool surface_properties::is_present_mode_available(VkPresentModeKHR present_mode) const
+{
+   switch (present_mode)
+   {
+   case VK_PRESENT_MODE_IMMEDIATE_KHR:
+      return supports_async_page_flip();
+   case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+      /* Late frames are either waited for by the display or flipped without waiting for vblank. */
+      return supports_vrr() || supports_async_page_flip();
+   default:
+      return true;
+   }
+}
+
 surface_properties::surface_properties()
    : surface_properties(nullptr)
 {
@@ -72,6 +141,12 @@ VkResult surface_properties::get_surface_capabilities(VkPhysicalDevice physical_
    pSurfaceCapabilities->minImageCount = 2;
    pSurfaceCapabilities->maxImageCount = 3;
 
+   if (m_specific_surface != nullptr)
+   {
+      /* Most applications ask for one image more than the minimum. */
+      m_specific_surface->start_speculative_allocation(physical_device, pSurfaceCapabilities->minImageCount + 1);
+   }
+
    /* Composite alpha */
    pSurfaceCapabilities->supportedCompositeAlpha =
       static_cast<VkCompositeAlphaFlagBitsKHR>(VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR | VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR);
@@ -84,6 +159,13 @@ VkResult surface_properties::get_surface_capabilities(VkPhysicalDevice physical_
                                                       VkSurfaceCapabilities2KHR *pSurfaceCapabilities)
 {
    TRY(check_surface_present_mode_query_is_supported(pSurfaceInfo, m_supported_modes));
+   auto surface_present_mode =
+      util::find_extension<VkSurfacePresentModeEXT>(VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_EXT, pSurfaceInfo);
+   if (surface_present_mode != nullptr && !is_present_mode_available(surface_present_mode->presentMode))
+   {
+      WSI_LOG_ERROR("Querying surface capability support for a present mode that is not supported by the surface");
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
 
    /* Image count limits */
    get_surface_capabilities(physical_device, &pSurfaceCapabilities->surfaceCapabilities);
@@ -97,6 +179,11 @@ VkResult surface_properties::get_surface_capabilities(VkPhysicalDevice physical_
       get_surface_present_scaling_and_gravity(surface_scaling_capabilities);
       surface_scaling_capabilities->minScaledImageExtent = pSurfaceCapabilities->surfaceCapabilities.minImageExtent;
       surface_scaling_capabilities->maxScaledImageExtent = pSurfaceCapabilities->surfaceCapabilities.maxImageExtent;
+      if (supports_plane_scaling())
+      {
+         /* Smaller images are upscaled or placed on the surface by the plane. */
+         surface_scaling_capabilities->minScaledImageExtent = { 1, 1 };
+      }
    }
 
    return VK_SUCCESS;
@@ -106,13 +193,16 @@ VkResult surface_properties::get_surface_formats(VkPhysicalDevice physical_devic
                                                  VkSurfaceFormatKHR *surfaceFormats,
                                                  VkSurfaceFormat2KHR *extended_surface_formats)
 {
-   auto &display = drm_display::get_display();
-   if (!display.has_value())
+   const drm_display *display = get_display();
+   if (display == nullptr)
    {
       return VK_ERROR_SURFACE_LOST_KHR;
    }
 
-   auto display_formats = display->get_supported_formats();
+   const drm_overlay_plane *overlay_plane =
+      m_specific_surface != nullptr ? m_specific_surface->get_overlay_plane() : nullptr;
+   auto display_formats =
+      overlay_plane != nullptr ? overlay_plane->supported_formats.get() : display->get_supported_formats();
 
    uint32_t format_count = 0;
 
@@ -182,7 +272,29 @@ VkResult surface_properties::get_surface_present_modes(VkPhysicalDevice physical
    UNUSED(physical_device);
    UNUSED(surface);
 
-   return get_surface_present_modes_common(pPresentModeCount, pPresentModes, m_supported_modes);
+   assert(pPresentModeCount != nullptr);
+
+   /* Leave out the modes the display cannot honour. */
+   std::array<VkPresentModeKHR, NUM_PRESENT_MODES> modes{};
+   uint32_t mode_count = 0;
+   for (const auto mode : m_supported_modes)
+   {
+      if (is_present_mode_available(mode))
+      {
+         modes[mode_count++] = mode;
+      }
+   }
+
+   if (pPresentModes == nullptr)
+   {
+      *pPresentModeCount = mode_count;
+      return VK_SUCCESS;
+   }
+
+   const VkResult res = mode_count > *pPresentModeCount ? VK_INCOMPLETE : VK_SUCCESS;
+   *pPresentModeCount = std::min(*pPresentModeCount, mode_count);
+   std::copy(modes.begin(), modes.begin() + *pPresentModeCount, pPresentModes);
+   return res;
 }
 
 VWL_VKAPI_CALL(VkResult)
@@ -234,11 +346,33 @@ CreateDisplayPlaneSurfaceKHR(VkInstance instance, const VkDisplaySurfaceCreateIn
 
    drm_display_mode *display_mode = reinterpret_cast<drm_display_mode *>(pCreateInfo->displayMode);
 
+   drm_display_registry *registry = drm_display_registry::get_for_presentation();
+   drm_display *display = registry != nullptr ? registry->find_display(display_mode) : nullptr;
+   if (display == nullptr)
+   {
+      WSI_LOG_ERROR("Display mode does not belong to any DRM display.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   if (!display->is_presentable())
+   {
+      WSI_LOG_ERROR("No CRTC or primary plane is available for the display of the mode.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   const drm_overlay_plane *overlay_plane = nullptr;
+   if (registry->get_plane_display(pCreateInfo->planeIndex, overlay_plane) != display)
+   {
+      WSI_LOG_ERROR("Plane %u cannot present to the display of the mode.", pCreateInfo->planeIndex);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
    VkResult res = instance_data.disp.CreateDisplayPlaneSurfaceKHR(instance, pCreateInfo, pAllocator, pSurface);
    if (res == VK_SUCCESS)
    {
 
-      auto wsi_surface = allocator.make_unique<surface>(display_mode, pCreateInfo->imageExtent);
+      auto wsi_surface =
+         allocator.make_unique<surface>(*display, overlay_plane, display_mode, pCreateInfo->imageExtent);
       if (wsi_surface == nullptr)
       {
          return VK_ERROR_OUT_OF_HOST_MEMORY;
@@ -304,7 +438,6 @@ GetDisplayPlaneCapabilitiesKHR(VkPhysicalDevice physicalDevice, VkDisplayModeKHR
                                VkDisplayPlaneCapabilitiesKHR *pCapabilities)
 {
    UNUSED(physicalDevice);
-   UNUSED(planeIndex);
    assert(physicalDevice != VK_NULL_HANDLE);
    assert(mode != VK_NULL_HANDLE);
    assert(pCapabilities != nullptr);
@@ -312,25 +445,18 @@ GetDisplayPlaneCapabilitiesKHR(VkPhysicalDevice physicalDevice, VkDisplayModeKHR
    drm_display_mode *display_mode = reinterpret_cast<drm_display_mode *>(mode);
    assert(display_mode != nullptr);
 
-   auto &display = drm_display::get_display();
-   if (!display.has_value())
+   drm_display_registry *registry = drm_display_registry::get_for_presentation();
+   if (registry == nullptr)
    {
       WSI_LOG_ERROR("DRM display not available.");
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
 
-   /* Implementation supports only one plane for presenting
-    * images. Therefore plane index must be 0. */
-   assert(planeIndex == 0);
-
-   auto valid_mode =
-      std::find_if(display->get_display_modes_begin(), display->get_display_modes_end(), [&display_mode](auto &mode) {
-         return (display_mode->get_width() == mode.get_width()) && (display_mode->get_height() == mode.get_height()) &&
-                (display_mode->get_refresh_rate() == mode.get_refresh_rate());
-      });
-
-   assert(valid_mode != display->get_display_modes_end());
-   UNUSED(valid_mode);
+   const drm_overlay_plane *overlay_plane = nullptr;
+   drm_display *plane_display = registry->get_plane_display(planeIndex, overlay_plane);
+   UNUSED(plane_display);
+   assert(plane_display != nullptr);
+   assert(registry->find_display(display_mode) == plane_display);
 
    VkDisplayPlaneCapabilitiesKHR planeCapabilities{};
    planeCapabilities.supportedAlpha = VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR;
@@ -344,6 +470,14 @@ GetDisplayPlaneCapabilitiesKHR(VkPhysicalDevice physicalDevice, VkDisplayModeKHR
    planeCapabilities.minDstExtent = { display_mode->get_width(), display_mode->get_height() };
    planeCapabilities.maxDstExtent = { display_mode->get_width(), display_mode->get_height() };
 
+   if (overlay_plane != nullptr)
+   {
+      /* Overlay planes cover the top left of the display at the size of the image, and are blended by the display
+       * controller over the primary plane using the alpha channel of the image. */
+      planeCapabilities.supportedAlpha |= VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_BIT_KHR;
+      planeCapabilities.minDstExtent = { 1, 1 };
+   }
+
    *pCapabilities = planeCapabilities;
 
    return VK_SUCCESS;
@@ -354,26 +488,32 @@ GetDisplayPlaneSupportedDisplaysKHR(VkPhysicalDevice physicalDevice, uint32_t pl
                                     VkDisplayKHR *pDisplays)
 {
    UNUSED(physicalDevice);
-   UNUSED(planeIndex);
    assert(physicalDevice != VK_NULL_HANDLE);
    assert(pDisplayCount != nullptr);
 
-   auto &display = drm_display::get_display();
-   if (!display.has_value())
+   drm_display_registry *registry = drm_display_registry::get_for_presentation();
+   if (registry == nullptr)
    {
       WSI_LOG_ERROR("DRM display not available.");
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
 
-   /* Implementation supports only one plane for presenting
-    * images. Therefore plane index must be 0. */
-   assert(planeIndex == 0);
+   /* Each plane belongs to the CRTC of a single display. */
+   const drm_overlay_plane *overlay_plane = nullptr;
+   drm_display *display = registry->get_plane_display(planeIndex, overlay_plane);
+   assert(display != nullptr);
 
+   /* The primary plane index of a display that got no CRTC does not correspond to any plane. */
+   const uint32_t num_displays = display->is_presentable() ? 1 : 0;
    if (pDisplays == nullptr)
    {
-      /* Implementation will expose just one (the main)
-       * plane for the application to use. */
-      *pDisplayCount = 1;
+      *pDisplayCount = num_displays;
+      return VK_SUCCESS;
+   }
+
+   if (num_displays == 0)
+   {
+      *pDisplayCount = 0;
       return VK_SUCCESS;
    }
 
@@ -382,7 +522,7 @@ GetDisplayPlaneSupportedDisplaysKHR(VkPhysicalDevice physicalDevice, uint32_t pl
       return VK_INCOMPLETE;
    }
 
-   *pDisplays = reinterpret_cast<VkDisplayKHR>(&display.value());
+   *pDisplays = reinterpret_cast<VkDisplayKHR>(display);
    *pDisplayCount = 1;
 
    return VK_SUCCESS;
@@ -396,37 +536,46 @@ GetPhysicalDeviceDisplayPlanePropertiesKHR(VkPhysicalDevice physicalDevice, uint
    assert(physicalDevice != VK_NULL_HANDLE);
    assert(pPropertyCount != nullptr);
 
-   auto &display = drm_display::get_display();
-   if (!display.has_value())
+   drm_display_registry *registry = drm_display_registry::get_for_presentation();
+   if (registry == nullptr)
    {
       WSI_LOG_ERROR("DRM display not available.");
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
 
+   /* Implementation exposes the primary plane and the overlay planes of every display for the application to use. */
+   const uint32_t num_planes = static_cast<uint32_t>(registry->get_num_planes());
    if (pProperties == nullptr)
    {
-      /* Implementation will expose just one (the main)
-       * plane for the application to use. */
-      *pPropertyCount = 1;
+      *pPropertyCount = num_planes;
       return VK_SUCCESS;
    }
 
-   if (*pPropertyCount == 0)
+   const uint32_t count = std::min(*pPropertyCount, num_planes);
+   for (uint32_t i = 0; i < count; i++)
    {
-      return VK_INCOMPLETE;
-   }
+      const drm_overlay_plane *overlay_plane = nullptr;
+      drm_display *display = registry->get_plane_display(i, overlay_plane);
 
-   VkDisplayPlanePropertiesKHR planeProperties{};
-   planeProperties.currentDisplay = reinterpret_cast<VkDisplayKHR>(&display.value());
+      VkDisplayPlanePropertiesKHR planeProperties{};
+      planeProperties.currentDisplay =
+         display->is_presentable() ? reinterpret_cast<VkDisplayKHR>(display) : VK_NULL_HANDLE;
 
-   /* Since the implementation is exposing just one plane the value for
-    * the current stack index must be 0.*/
-   planeProperties.currentStackIndex = 0;
+      /* The primary plane is reported at the bottom of the stack, with the overlay planes above it. */
+      planeProperties.currentStackIndex = 0;
+      for (uint32_t j = 0; overlay_plane != nullptr && j < display->get_num_overlay_planes(); j++)
+      {
+         if (display->get_overlay_plane(j) == overlay_plane)
+         {
+            planeProperties.currentStackIndex = j + 1;
+         }
+      }
 
-   *pProperties = planeProperties;
-   *pPropertyCount = 1;
+      pProperties[i] = planeProperties;
+   }
+   *pPropertyCount = count;
 
-   return VK_SUCCESS;
+   return count < num_planes ? VK_INCOMPLETE : VK_SUCCESS;
 }
 
 VWL_VKAPI_CALL(VkResult)
@@ -437,74 +586,59 @@ GetPhysicalDeviceDisplayPropertiesKHR(VkPhysicalDevice physicalDevice, uint32_t
    assert(physicalDevice != VK_NULL_HANDLE);
    assert(pPropertyCount != nullptr);
 
-   auto &display = drm_display::get_display();
+   drm_display_registry *registry = drm_display_registry::get();
 
-   if (!display.has_value())
+   if (registry == nullptr)
    {
       *pPropertyCount = 0;
       return VK_SUCCESS;
    }
 
+   const uint32_t num_displays = static_cast<uint32_t>(registry->get_num_displays());
    if (pProperties == nullptr)
    {
-      *pPropertyCount = 1;
+      *pPropertyCount = num_displays;
       return VK_SUCCESS;
    }
 
-   if (*pPropertyCount == 0)
+   const uint32_t count = std::min(*pPropertyCount, num_displays);
+   for (uint32_t i = 0; i < count; i++)
    {
-      return VK_INCOMPLETE;
+      drm_display *display = registry->get_display(i);
+
+      VkDisplayPropertiesKHR display_properties = {};
+      display_properties.display = reinterpret_cast<VkDisplayKHR>(display);
+      display_properties.displayName = "DRM display";
+      display_properties.physicalDimensions = { display->get_connector()->mmWidth,
+                                                display->get_connector()->mmHeight };
+      display_properties.physicalResolution = { display->get_max_width(), display->get_max_height() };
+      display_properties.supportedTransforms = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+      display_properties.planeReorderPossible = VK_FALSE;
+      display_properties.persistentContent = VK_FALSE;
+
+      pProperties[i] = display_properties;
    }
+   *pPropertyCount = count;
 
-   *pPropertyCount = 1;
-
-   VkDisplayPropertiesKHR display_properties = {};
-   display_properties.display = reinterpret_cast<VkDisplayKHR>(&display.value());
-   display_properties.displayName = "DRM display";
-   display_properties.physicalDimensions = { display->get_connector()->mmWidth, display->get_connector()->mmHeight };
-   display_properties.physicalResolution = { display->get_max_width(), display->get_max_height() };
-   display_properties.supportedTransforms = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-   display_properties.planeReorderPossible = VK_FALSE;
-   display_properties.persistentContent = VK_FALSE;
-
-   *pProperties = display_properties;
-
-   return VK_SUCCESS;
+   return count < num_displays ? VK_INCOMPLETE : VK_SUCCESS;
 }
 
 PFN_vkVoidFunction surface_properties::get_proc_addr(const char *name)
 {
+   /* Sorted by name. */
+   static constexpr util::proc_addr_entry entrypoints[] = {
+      PROC_ADDR_ENTRY(CreateDisplayModeKHR),
+      PROC_ADDR_ENTRY(CreateDisplayPlaneSurfaceKHR),
+      PROC_ADDR_ENTRY(GetDisplayModePropertiesKHR),
+      PROC_ADDR_ENTRY(GetDisplayPlaneCapabilitiesKHR),
+      PROC_ADDR_ENTRY(GetDisplayPlaneSupportedDisplaysKHR),
+      PROC_ADDR_ENTRY(GetPhysicalDeviceDisplayPlanePropertiesKHR),
+      PROC_ADDR_ENTRY(GetPhysicalDeviceDisplayPropertiesKHR),
+   };
+   static_assert(util::is_sorted_by_name(entrypoints), "Entrypoints must be sorted by name");
 
-   if (strcmp(name, "vkCreateDisplayModeKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(CreateDisplayModeKHR);
-   }
-   else if (strcmp(name, "vkCreateDisplayPlaneSurfaceKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(CreateDisplayPlaneSurfaceKHR);
-   }
-   else if (strcmp(name, "vkGetDisplayModePropertiesKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(GetDisplayModePropertiesKHR);
-   }
-   else if (strcmp(name, "vkGetDisplayPlaneCapabilitiesKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(GetDisplayPlaneCapabilitiesKHR);
-   }
-   else if (strcmp(name, "vkGetDisplayPlaneSupportedDisplaysKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(GetDisplayPlaneSupportedDisplaysKHR);
-   }
-   else if (strcmp(name, "vkGetPhysicalDeviceDisplayPlanePropertiesKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(GetPhysicalDeviceDisplayPlanePropertiesKHR);
-   }
-   else if (strcmp(name, "vkGetPhysicalDeviceDisplayPropertiesKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(GetPhysicalDeviceDisplayPropertiesKHR);
-   }
-
-   return nullptr;
+   const util::proc_addr_entry *entry = util::find_proc_addr(entrypoints, name);
+   return entry != nullptr ? entry->get_fn() : nullptr;
 }
 
 VkResult surface_properties::get_required_instance_extensions(util::extension_list &extension_list)
@@ -535,11 +669,15 @@ bool surface_properties::is_surface_extension_enabled(const layer::instance_priv
 void surface_properties::get_present_timing_surface_caps(
    VkPresentTimingSurfaceCapabilitiesEXT *present_timing_surface_caps)
 {
-   present_timing_surface_caps->presentTimingSupported = VK_FALSE;
-   present_timing_surface_caps->presentAtAbsoluteTimeSupported = VK_FALSE;
+   /* Page flip events carry the timestamp of the vblank the image was latched on. */
+   present_timing_surface_caps->presentTimingSupported = VK_TRUE;
+   present_timing_surface_caps->presentAtAbsoluteTimeSupported = VK_TRUE;
    present_timing_surface_caps->presentAtRelativeTimeSupported = VK_FALSE;
-   present_timing_surface_caps->presentStageQueries = 0;
-   present_timing_surface_caps->presentStageTargets = 0;
+   present_timing_surface_caps->presentStageQueries = VK_PRESENT_STAGE_QUEUE_OPERATIONS_END_BIT_EXT |
+                                                      VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT |
+                                                      VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT;
+   present_timing_surface_caps->presentStageTargets =
+      VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT | VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT;
 }
 #endif
 
@@ -556,6 +694,15 @@ void surface_properties::get_surface_present_scaling_and_gravity(
    scaling_capabilities->supportedPresentScaling = VK_PRESENT_SCALING_ONE_TO_ONE_BIT_EXT;
    scaling_capabilities->supportedPresentGravityX = VK_PRESENT_GRAVITY_MIN_BIT_EXT;
    scaling_capabilities->supportedPresentGravityY = VK_PRESENT_GRAVITY_MIN_BIT_EXT;
+   if (supports_plane_scaling())
+   {
+      constexpr VkPresentGravityFlagsEXT all_gravities =
+         VK_PRESENT_GRAVITY_MIN_BIT_EXT | VK_PRESENT_GRAVITY_MAX_BIT_EXT | VK_PRESENT_GRAVITY_CENTERED_BIT_EXT;
+      scaling_capabilities->supportedPresentScaling |=
+         VK_PRESENT_SCALING_STRETCH_BIT_EXT | VK_PRESENT_SCALING_ASPECT_RATIO_STRETCH_BIT_EXT;
+      scaling_capabilities->supportedPresentGravityX = all_gravities;
+      scaling_capabilities->supportedPresentGravityY = all_gravities;
+   }
 }
 
 bool surface_properties::is_compatible_present_modes(VkPresentModeKHR present_mode_a, VkPresentModeKHR present_mode_b)
@@ -77,11 +77,46 @@ public:
 private:
    surface *const m_specific_surface;
 
+   /* Number of presentation modes; VK_PRESENT_MODE_IMMEDIATE_KHR needs async page flips from the DRM device and
+    * VK_PRESENT_MODE_FIFO_RELAXED_KHR either variable refresh rate or async page flips. */
+   static constexpr std::size_t NUM_PRESENT_MODES = 4;
+
    /* List of supported presentation modes */
-   std::array<VkPresentModeKHR, 1> m_supported_modes;
+   std::array<VkPresentModeKHR, NUM_PRESENT_MODES> m_supported_modes;
 
    /* Stores compatible presentation modes */
-   compatible_present_modes<1> m_compatible_present_modes;
+   compatible_present_modes<NUM_PRESENT_MODES> m_compatible_present_modes;
+
+   /**
+    * @brief Get the display of @ref m_specific_surface, or the first display if there is no surface.
+    *
+    * @return The display, or nullptr if no display is available.
+    */
+   drm_display *get_display() const;
+
+   /**
+    * @brief Whether the display can flip without waiting for vblank, which VK_PRESENT_MODE_IMMEDIATE_KHR requires.
+    *
+    * Also lets VK_PRESENT_MODE_FIFO_RELAXED_KHR flip late frames immediately.
+    */
+   bool supports_async_page_flip() const;
+
+   /**
+    * @brief Whether the surface can enable variable refresh rate, which makes the display wait for the late frames
+    *        of VK_PRESENT_MODE_FIFO_RELAXED_KHR.
+    */
+   bool supports_vrr() const;
+
+   /**
+    * @brief Whether the display controller can scale and position the images on the plane, which requires atomic
+    *        modesetting to set the source and CRTC rectangles of the plane.
+    */
+   bool supports_plane_scaling() const;
+
+   /**
+    * @brief Whether a present mode can be used with the surface's display.
+    */
+   bool is_present_mode_available(VkPresentModeKHR present_mode) const;
 
    void get_surface_present_scaling_and_gravity(VkSurfacePresentScalingCapabilitiesEXT *scaling_capabilities) override;
    void populate_present_mode_compatibilities() override;
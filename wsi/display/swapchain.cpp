@@ -31,12 +31,20 @@
 #include <vulkan/vk_icd.h>
 #include <vulkan/vulkan.h>
 #include <errno.h>
+#include <algorithm>
+#include <chrono>
+#include <utility>
 
+#include <util/drm/drm_utils.hpp>
+#include <util/helpers.hpp>
 #include <util/macros.hpp>
+#include <util/trace.hpp>
 #include <wsi/extensions/image_compression_control.hpp>
 #include <wsi/extensions/present_id.hpp>
 #include <wsi/swapchain_base.hpp>
+#include <wsi/synchronization.hpp>
 
+#include "present_timing_handler.hpp"
 #include "swapchain.hpp"
 
 namespace wsi
@@ -45,42 +53,145 @@ namespace wsi
 namespace display
 {
 
+/**
+ * @brief Get the current time in the clock of DRM event timestamps.
+ *
+ * @return The CLOCK_MONOTONIC time in nanoseconds.
+ */
+static uint64_t monotonic_now_ns()
+{
+   /* steady_clock is CLOCK_MONOTONIC. */
+   return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+         .count());
+}
+
+/**
+ * @brief Get the offset of the image on one axis of the surface.
+ *
+ * @param gravity      The gravity requested on the axis, MIN when none was requested.
+ * @param surface_size Size of the surface on the axis.
+ * @param image_size   Size of the scaled image on the axis.
+ */
+static uint32_t get_gravity_offset(VkPresentGravityFlagsEXT gravity, uint32_t surface_size, uint32_t image_size)
+{
+   const uint32_t space = surface_size > image_size ? surface_size - image_size : 0;
+   switch (gravity)
+   {
+   case VK_PRESENT_GRAVITY_CENTERED_BIT_EXT:
+      return space / 2;
+   case VK_PRESENT_GRAVITY_MAX_BIT_EXT:
+      return space;
+   default:
+      return 0;
+   }
+}
+
+/**
+ * @brief Get the CRTC rectangle the images of a swapchain are scanned out to.
+ *
+ * @param swapchain_create_info The create info of the swapchain.
+ * @param surface_extent        Extent of the surface the swapchain presents to.
+ */
+static VkRect2D get_scanout_rect(const VkSwapchainCreateInfoKHR *swapchain_create_info, VkExtent2D surface_extent)
+{
+   const VkExtent2D &image_extent = swapchain_create_info->imageExtent;
+   VkRect2D rect{ { 0, 0 }, image_extent };
+
+   auto scaling_create_info = util::find_extension<VkSwapchainPresentScalingCreateInfoEXT>(
+      VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_SCALING_CREATE_INFO_EXT, swapchain_create_info);
+   if (scaling_create_info == nullptr)
+   {
+      return rect;
+   }
+
+   if (scaling_create_info->scalingBehavior == VK_PRESENT_SCALING_STRETCH_BIT_EXT)
+   {
+      rect.extent = surface_extent;
+   }
+   else if (scaling_create_info->scalingBehavior == VK_PRESENT_SCALING_ASPECT_RATIO_STRETCH_BIT_EXT)
+   {
+      /* Fill the height of the surface, unless the image is then wider than the surface. */
+      const uint64_t width = static_cast<uint64_t>(image_extent.width) * surface_extent.height / image_extent.height;
+      if (width <= surface_extent.width)
+      {
+         rect.extent = { std::max(static_cast<uint32_t>(width), 1u), surface_extent.height };
+      }
+      else
+      {
+         const uint64_t height =
+            static_cast<uint64_t>(image_extent.height) * surface_extent.width / image_extent.width;
+         rect.extent = { surface_extent.width, std::max(static_cast<uint32_t>(height), 1u) };
+      }
+   }
+
+   rect.offset.x = static_cast<int32_t>(
+      get_gravity_offset(scaling_create_info->presentGravityX, surface_extent.width, rect.extent.width));
+   rect.offset.y = static_cast<int32_t>(
+      get_gravity_offset(scaling_create_info->presentGravityY, surface_extent.height, rect.extent.height));
+   return rect;
+}
+
 swapchain::swapchain(layer::device_private_data &dev_data, const VkAllocationCallbacks *pAllocator,
                      surface &wsi_surface)
    : wsi::swapchain_base(dev_data, pAllocator)
    , m_wsi_allocator(nullptr)
+   , m_batch_allocations(m_allocator)
+   , m_speculative_allocation(wsi_surface.take_speculative_allocation())
+   , m_display(wsi_surface.get_display())
+   , m_overlay_plane(wsi_surface.get_overlay_plane())
    , m_display_mode(wsi_surface.get_display_mode())
+   , m_surface_extent(wsi_surface.get_extent())
    , m_image_creation_parameters({}, m_allocator, {}, {})
+   , m_use_atomic(false)
+   , m_plane_scaled(false)
+   , m_mode_blob_id(0)
+   , m_atomic_base_request(nullptr)
+   , m_flip_listener_added(false)
+   , m_pending_flip_index(NO_IMAGE_INDEX)
+   , m_pending_flip_present_id(0)
+   , m_pending_flip_timing_slot(0)
+   , m_scanout_index(NO_IMAGE_INDEX)
+   , m_mailbox_index(NO_IMAGE_INDEX)
+   , m_mailbox_present_id(0)
+   , m_mailbox_timing_slot(0)
+   , m_async_in_fence_supported(true)
+   , m_last_flip_time_ns(0)
 {
    m_image_create_info.format = VK_FORMAT_UNDEFINED;
 }
 
 swapchain::~swapchain()
 {
+   /* Teardown unlinks the descendant, which may reuse the buffers this swapchain gives back to the wsialloc cache. */
+   const bool replaced = m_descendant != VK_NULL_HANDLE;
+
    /* Call the base class teardown */
    teardown();
 
+   /* Close the buffers of a batch that were not used, which only happens when creating the swapchain failed. */
+   m_batch_allocations.release_unused();
+
    /* Free WSI allocator. */
-   if (m_wsi_allocator != nullptr)
+   release_shared_wsialloc_allocator(m_device_data, m_wsi_allocator, replaced);
+   m_wsi_allocator = nullptr;
+
+   if (m_flip_listener_added)
    {
-      wsialloc_delete(m_wsi_allocator);
+      /* Only when teardown did not finish presenting. */
+      m_display.get_event_loop().remove_listener(this);
    }
-   m_wsi_allocator = nullptr;
-}
 
-static void page_flip_event(int fd, unsigned int sequence, unsigned int tv_sec, unsigned int tv_usec, void *user_data)
-{
-   UNUSED(fd);
-   UNUSED(sequence);
-   UNUSED(tv_sec);
-   UNUSED(tv_usec);
-   bool *done = (bool *)user_data;
-   *done = true;
+   if (m_mode_blob_id != 0)
+   {
+      /* The kernel keeps its own reference to the blob while the mode is in use. */
+      drmModeDestroyPropertyBlob(m_display.get_drm_fd(), m_mode_blob_id);
+   }
 }
 
 VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info)
 {
-   auto compression_control = wsi_ext_image_compression_control::create(device, swapchain_create_info);
+   auto compression_control = wsi_ext_image_compression_control::create(device, swapchain_create_info, true);
    if (compression_control)
    {
       if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_image_compression_control>(*compression_control)))
@@ -99,11 +210,21 @@ VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCr
 
    if (m_device_data.should_layer_handle_frame_boundary_events())
    {
-      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_frame_boundary>(m_device_data)))
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_frame_boundary>()))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   if (swapchain_create_info->flags & VK_SWAPCHAIN_CREATE_PRESENT_TIMING_BIT_EXT)
+   {
+      if (!add_swapchain_extension(wsi_ext_present_timing_display::create(m_allocator, get_refresh_duration())))
       {
          return VK_ERROR_OUT_OF_HOST_MEMORY;
       }
    }
+#endif
 
    return VK_SUCCESS;
 }
@@ -112,15 +233,107 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
                                   bool &use_presentation_thread)
 {
    UNUSED(device);
-   UNUSED(swapchain_create_info);
    UNUSED(use_presentation_thread);
    WSIALLOC_ASSERT_VERSION();
-   if (wsialloc_new(&m_wsi_allocator) != WSIALLOC_ERROR_NONE)
+   if (acquire_shared_wsialloc_allocator(m_device_data, &m_wsi_allocator) != WSIALLOC_ERROR_NONE)
    {
       WSI_LOG_ERROR("Failed to create wsi allocator.");
       return VK_ERROR_INITIALIZATION_FAILED;
    }
 
+   /* Parallel image creation allocates the images concurrently rather than in one batch. */
+   const bool deferred_allocation =
+      swapchain_create_info->flags & VK_SWAPCHAIN_CREATE_DEFERRED_MEMORY_ALLOCATION_BIT_EXT;
+   if (!deferred_allocation && !m_parallel_image_creation && swapchain_create_info->oldSwapchain == VK_NULL_HANDLE)
+   {
+      m_batch_allocations.set_count(static_cast<uint32_t>(m_swapchain_images.size()));
+   }
+
+   if (!m_display.get_event_loop().add_listener(this))
+   {
+      WSI_LOG_ERROR("Failed to register the swapchain with the DRM event loop.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+   m_flip_listener_added = true;
+
+   return init_atomic_request(swapchain_create_info);
+}
+
+VkResult swapchain::init_atomic_request(const VkSwapchainCreateInfoKHR *swapchain_create_info)
+{
+   const VkExtent2D &extent = swapchain_create_info->imageExtent;
+   const VkRect2D scanout_rect = get_scanout_rect(swapchain_create_info, m_surface_extent);
+   m_plane_scaled = scanout_rect.offset.x != 0 || scanout_rect.offset.y != 0 ||
+                    scanout_rect.extent.width != extent.width || scanout_rect.extent.height != extent.height;
+
+   if (m_display.get_atomic_properties() == nullptr)
+   {
+      /* Overlay planes are only assigned to displays using atomic KMS. */
+      if (m_overlay_plane != nullptr)
+      {
+         WSI_LOG_ERROR("Overlay plane %u requires atomic modesetting.", m_overlay_plane->id);
+         return VK_ERROR_INITIALIZATION_FAILED;
+      }
+      if (m_plane_scaled)
+      {
+         WSI_LOG_ERROR("Scaling the images on the plane requires atomic modesetting.");
+         return VK_ERROR_INITIALIZATION_FAILED;
+      }
+      return VK_SUCCESS;
+   }
+
+   /* The mode is set by the swapchains on the primary plane. */
+   drmModeModeInfo mode_info = m_display_mode->get_drm_mode();
+   if (m_overlay_plane == nullptr &&
+       drmModeCreatePropertyBlob(m_display.get_drm_fd(), &mode_info, sizeof(mode_info), &m_mode_blob_id) != 0)
+   {
+      WSI_LOG_WARNING("Failed to create the mode property blob, using legacy KMS: %s", std::strerror(errno));
+      m_mode_blob_id = 0;
+      return m_plane_scaled ? VK_ERROR_INITIALIZATION_FAILED : VK_SUCCESS;
+   }
+
+   drm_atomic_req_owner request{ drmModeAtomicAlloc() };
+   if (request == nullptr)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   /* Scan out the whole image, which the plane scales into the CRTC rectangle. Plane source coordinates are in 16.16
+    * fixed point. */
+   uint32_t plane_id = 0;
+   const drm_plane_properties &props = get_plane_properties(plane_id);
+   const std::pair<uint32_t, uint64_t> plane_properties[] = {
+      { props.crtc_id, static_cast<uint64_t>(m_display.get_crtc_id()) },
+      { props.src_x, 0 },
+      { props.src_y, 0 },
+      { props.src_w, static_cast<uint64_t>(extent.width) << 16 },
+      { props.src_h, static_cast<uint64_t>(extent.height) << 16 },
+      { props.crtc_x, static_cast<uint64_t>(scanout_rect.offset.x) },
+      { props.crtc_y, static_cast<uint64_t>(scanout_rect.offset.y) },
+      { props.crtc_w, scanout_rect.extent.width },
+      { props.crtc_h, scanout_rect.extent.height },
+   };
+
+   for (const auto &property : plane_properties)
+   {
+      if (drmModeAtomicAddProperty(request.get(), plane_id, property.first, property.second) < 0)
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   /* Presents only test the commit that sets the mode on the primary plane and never test overlay plane commits, so
+    * check now that the driver can scale the plane instead of losing the surface on the first present. */
+   if (m_plane_scaled && !m_display.test_plane_scaling(plane_id, props, extent, scanout_rect,
+                                                       m_overlay_plane == nullptr ? &mode_info : nullptr))
+   {
+      WSI_LOG_ERROR("The plane cannot scale %ux%u images to %ux%u.", extent.width, extent.height,
+                    scanout_rect.extent.width, scanout_rect.extent.height);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   m_atomic_base_request = std::move(request);
+   m_use_atomic = true;
    return VK_SUCCESS;
 }
 
@@ -138,96 +351,42 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
                                                    util::vector<uint64_t> &exportable_modifers,
                                                    util::vector<VkDrmFormatModifierPropertiesEXT> &drm_format_props)
 {
-   TRY_LOG(util::get_drm_format_properties(m_device_data.physical_device, info.format, drm_format_props),
-           "Failed to get format properties");
-
-   auto &display = drm_display::get_display();
-   if (!display.has_value())
+   const VkImageCompressionControlEXT *compression_control = nullptr;
+   VkImageCompressionControlEXT compression_properties = {};
+   auto *compression_ext = get_swapchain_extension<wsi_ext_image_compression_control>();
+   if (compression_ext)
    {
-      WSI_LOG_ERROR("DRM display not available.");
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
+      compression_properties = compression_ext->get_compression_control_properties();
+      compression_control = &compression_properties;
    }
 
-   for (const auto &prop : drm_format_props)
-   {
-      drm_format_pair drm_format{ util::drm::vk_to_drm_format(info.format), prop.drmFormatModifier };
+   util::vector<util::drm_format_modifier_support> supported_modifiers(
+      util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+   TRY_LOG(m_device_data.get_format_modifier_cache().get_supported_modifiers(info, compression_control,
+                                                                             supported_modifiers),
+           "Failed to get format properties");
 
-      if (!display->is_format_supported(drm_format))
+   for (const auto &modifier : supported_modifiers)
+   {
+      const auto &prop = modifier.modifier_properties;
+      if (!drm_format_props.try_push_back(prop))
       {
-         continue;
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
       }
 
-      VkExternalImageFormatPropertiesKHR external_props = {};
-      external_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES_KHR;
-
-      VkImageFormatProperties2KHR format_props = {};
-      format_props.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2_KHR;
-      format_props.pNext = &external_props;
-
-      VkResult result = VK_SUCCESS;
-      {
-         VkPhysicalDeviceExternalImageFormatInfoKHR external_info = {};
-         external_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO_KHR;
-         external_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
-
-         VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_mod_info = {};
-         drm_mod_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT;
-         drm_mod_info.pNext = &external_info;
-         drm_mod_info.drmFormatModifier = prop.drmFormatModifier;
-         drm_mod_info.sharingMode = info.sharingMode;
-         drm_mod_info.queueFamilyIndexCount = info.queueFamilyIndexCount;
-         drm_mod_info.pQueueFamilyIndices = info.pQueueFamilyIndices;
-
-         VkPhysicalDeviceImageFormatInfo2KHR image_info = {};
-         image_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2_KHR;
-         image_info.pNext = &drm_mod_info;
-         image_info.format = info.format;
-         image_info.type = info.imageType;
-         image_info.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
-         image_info.usage = info.usage;
-         image_info.flags = info.flags;
-
-         VkImageCompressionControlEXT compression_control = {};
+      drm_format_pair drm_format{ util::drm::vk_to_drm_format(info.format), prop.drmFormatModifier };
 
-         if (m_device_data.is_swapchain_compression_control_enabled())
-         {
-            auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
-            /* For Image compression control, additional requirements to be satisfied such as
-               existence of VkImageCompressionControlEXT in swaphain_create_info for
-               the ext to be added to the list. so we check whether we got a valid pointer
-               and proceed if yes. */
-            if (ext)
-            {
-               compression_control = ext->get_compression_control_properties();
-               compression_control.pNext = image_info.pNext;
-               image_info.pNext = &compression_control;
-            }
-         }
-         result = m_device_data.instance_data.disp.GetPhysicalDeviceImageFormatProperties2KHR(
-            m_device_data.physical_device, &image_info, &format_props);
-      }
-      if (result != VK_SUCCESS)
-      {
-         continue;
-      }
-      if (format_props.imageFormatProperties.maxExtent.width < info.extent.width ||
-          format_props.imageFormatProperties.maxExtent.height < info.extent.height ||
-          format_props.imageFormatProperties.maxExtent.depth < info.extent.depth)
-      {
-         continue;
-      }
-      if (format_props.imageFormatProperties.maxMipLevels < info.mipLevels ||
-          format_props.imageFormatProperties.maxArrayLayers < info.arrayLayers)
+      if (!m_display.is_format_supported(drm_format, m_overlay_plane))
       {
          continue;
       }
-      if ((format_props.imageFormatProperties.sampleCounts & info.samples) != info.samples)
+
+      if (!modifier.supports_image(info))
       {
          continue;
       }
 
-      if (external_props.externalMemoryProperties.externalMemoryFeatures &
-          VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT_KHR)
+      if (modifier.external_memory_features & VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT_KHR)
       {
          if (!exportable_modifers.try_push_back(drm_format.modifier))
          {
@@ -235,8 +394,7 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
          }
       }
 
-      if (external_props.externalMemoryProperties.externalMemoryFeatures &
-          VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT_KHR)
+      if (modifier.external_memory_features & VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT_KHR)
       {
          uint64_t flags =
             (prop.drmFormatModifierTilingFeatures & VK_FORMAT_FEATURE_DISJOINT_BIT) ? 0 : WSIALLOC_FORMAT_NON_DISJOINT;
@@ -248,35 +406,44 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
       }
    }
 
+   if (compression_ext && compression_ext->is_layer_default())
+   {
+      sort_formats_by_compression(importable_formats, supported_modifiers);
+   }
+
    return VK_SUCCESS;
 }
 
-VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, display_image_data *image_data,
-                                      util::vector<wsialloc_format> &importable_formats,
-                                      wsialloc_format *allocated_format, bool avoid_allocation)
+uint64_t swapchain::get_allocation_flags(const VkImageCreateInfo &image_create_info)
 {
    bool is_protected_memory = (image_create_info.flags & VK_IMAGE_CREATE_PROTECTED_BIT) != 0;
    uint64_t allocation_flags = is_protected_memory ? WSIALLOC_ALLOCATE_PROTECTED : 0;
-   if (avoid_allocation)
-   {
-      allocation_flags |= WSIALLOC_ALLOCATE_NO_MEMORY;
-   }
+   /* The buffers are scanned out directly by the display controller. */
+   allocation_flags |= WSIALLOC_ALLOCATE_USAGE_SCANOUT;
 
-   if (m_device_data.is_swapchain_compression_control_enabled())
+   /* The extension is only added when the application controls the compression of the swapchain, or when the
+      layer chooses it for the swapchain, so we check whether we got a valid pointer and proceed if yes. */
+   auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
+   if (ext)
    {
-      auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
-      /* For Image compression control, additional requirements to be satisfied such as
-         existence of VkImageCompressionControlEXT in swaphain_create_info for
-         the ext to be added to the list. so we check whether we got a valid pointer
-         and proceed if yes. */
-      if (ext)
+      if ((ext->get_bitmask_for_image_compression_flags() & VK_IMAGE_COMPRESSION_FIXED_RATE_EXPLICIT_EXT) ||
+          ext->is_layer_default())
       {
-         if (ext->get_bitmask_for_image_compression_flags() & VK_IMAGE_COMPRESSION_FIXED_RATE_EXPLICIT_EXT)
-         {
-            allocation_flags |= WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION;
-         }
+         allocation_flags |= WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION;
       }
    }
+   return allocation_flags;
+}
+
+VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, display_image_data *image_data,
+                                      util::vector<wsialloc_format> &importable_formats,
+                                      wsialloc_format *allocated_format, bool avoid_allocation)
+{
+   uint64_t allocation_flags = get_allocation_flags(image_create_info);
+   if (avoid_allocation)
+   {
+      allocation_flags |= WSIALLOC_ALLOCATE_NO_MEMORY;
+   }
 
    wsialloc_allocate_info alloc_info = { importable_formats.data(), static_cast<unsigned>(importable_formats.size()),
                                          image_create_info.extent.width, image_create_info.extent.height,
@@ -292,7 +459,7 @@ VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, disp
    {
       alloc_result.buffer_fds[i] = -1;
    }
-   const auto res = wsialloc_alloc(m_wsi_allocator, &alloc_info, &alloc_result);
+   const auto res = m_batch_allocations.allocate(m_wsi_allocator, alloc_info, alloc_result);
    if (res != WSIALLOC_ERROR_NONE)
    {
       WSI_LOG_ERROR("Failed allocation of DMA Buffer. WSI error: %d", static_cast<int>(res));
@@ -303,10 +470,17 @@ VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, disp
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
    *allocated_format = alloc_result.format;
+   /* Importing the buffer into Vulkan consumes its FDs, so keep duplicates to give it back to the wsialloc cache. */
+   if (!avoid_allocation && !image_data->allocated_buffer.keep(alloc_result, allocation_flags))
+   {
+      WSI_LOG_WARNING("Failed to duplicate the buffer FDs, the buffer will not be cached once released.");
+   }
    auto &external_memory = image_data->external_mem;
    external_memory.set_strides(alloc_result.average_row_strides);
    external_memory.set_buffer_fds(alloc_result.buffer_fds);
    external_memory.set_offsets(alloc_result.offsets);
+   external_memory.set_memory_source(alloc_result.format.fourcc, alloc_result.format.modifier, allocation_flags);
+   external_memory.set_memory_usage(m_memory_usage);
 
    uint32_t num_planes = util::drm::drm_fourcc_format_get_num_planes(alloc_result.format.fourcc);
 
@@ -356,88 +530,89 @@ static VkResult fill_image_create_info(VkImageCreateInfo &image_create_info,
 VkResult swapchain::allocate_image(display_image_data *image_data)
 {
    util::vector<wsialloc_format> importable_formats(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
-   auto &m_allocated_format = m_image_creation_parameters.m_allocated_format;
-   if (!importable_formats.try_push_back(m_allocated_format))
+   /* The format was chosen with the first image, so the result is not stored back, which lets images be allocated
+    * concurrently. */
+   wsialloc_format allocated_format = m_image_creation_parameters.m_allocated_format;
+   if (!importable_formats.try_push_back(allocated_format))
    {
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
-   TRY_LOG_CALL(allocate_wsialloc(m_image_create_info, image_data, importable_formats, &m_allocated_format, false));
+   TRY_LOG_CALL(allocate_wsialloc(m_image_create_info, image_data, importable_formats, &allocated_format, false));
 
    return VK_SUCCESS;
 }
 
-VkResult swapchain::create_framebuffer(const VkImageCreateInfo &image_create_info, display_image_data *image_data)
+void swapchain::take_speculative_allocation()
 {
-   VkResult ret_code = VK_SUCCESS;
-   std::array<uint32_t, util::MAX_PLANES> strides{ 0, 0, 0, 0 };
-   std::array<uint64_t, util::MAX_PLANES> modifiers{ 0, 0, 0, 0 };
-   const drm_format_pair allocated_format{ m_image_creation_parameters.m_allocated_format.fourcc,
-                                           m_image_creation_parameters.m_allocated_format.modifier };
-
-   auto &display = drm_display::get_display();
-   if (!display.has_value())
+   if (m_speculative_allocation == nullptr)
    {
-      return VK_ERROR_INITIALIZATION_FAILED;
+      return;
    }
 
-   drm_gem_handle_array<util::MAX_PLANES> buffer_handles{ display->get_drm_fd() };
-
-   const auto &buffer_fds = image_data->external_mem.get_buffer_fds();
-
-   for (uint32_t plane = 0; plane < image_data->external_mem.get_num_planes(); plane++)
+   const VkExtent2D extent{ m_image_create_info.extent.width, m_image_create_info.extent.height };
+   const uint32_t taken =
+      m_speculative_allocation->take(m_image_creation_parameters.m_allocated_format, extent,
+                                     get_allocation_flags(m_image_create_info), m_batch_allocations);
+   if (taken > 0)
    {
-      assert(image_data->external_mem.get_strides()[plane] > 0);
-      strides[plane] = image_data->external_mem.get_strides()[plane];
-      modifiers[plane] = allocated_format.modifier;
-      if (drmPrimeFDToHandle(display->get_drm_fd(), buffer_fds[plane], &buffer_handles[plane]) != 0)
-      {
-         WSI_LOG_ERROR("Failed to convert buffer FD to GEM handle: %s", std::strerror(errno));
-         return VK_ERROR_INITIALIZATION_FAILED;
-      }
+      /* The images the surface did not allocate, if any, are allocated one at a time. */
+      m_batch_allocations.set_count(1);
    }
-
-   if (!display->is_format_supported(allocated_format))
+   else
    {
-      WSI_LOG_ERROR("Format not supported.");
-      return VK_ERROR_INITIALIZATION_FAILED;
+      WSI_LOG_INFO("The buffers allocated ahead of the swapchain do not match its images.");
    }
 
-   int error = 0;
-   if (display->supports_fb_modifiers())
-   {
-      error = drmModeAddFB2WithModifiers(
-         display->get_drm_fd(), image_create_info.extent.width, image_create_info.extent.height,
-         allocated_format.fourcc, buffer_handles.data(), strides.data(), image_data->external_mem.get_offsets().data(),
-         modifiers.data(), &image_data->fb_id, DRM_MODE_FB_MODIFIERS);
-   }
-   else
+   /* Free the buffers that were not taken. */
+   m_speculative_allocation.reset();
+}
+
+VkResult swapchain::create_framebuffer(const VkImageCreateInfo &image_create_info, display_image_data *image_data)
+{
+   const drm_format_pair allocated_format{ m_image_creation_parameters.m_allocated_format.fourcc,
+                                           m_image_creation_parameters.m_allocated_format.modifier };
+   if (!m_display.is_format_supported(allocated_format, m_overlay_plane))
    {
-      error = drmModeAddFB2(display->get_drm_fd(), image_create_info.extent.width, image_create_info.extent.height,
-                            allocated_format.fourcc, buffer_handles.data(), strides.data(),
-                            image_data->external_mem.get_offsets().data(), &image_data->fb_id, 0);
+      WSI_LOG_ERROR("Format not supported.");
+      return VK_ERROR_INITIALIZATION_FAILED;
    }
 
-   if (error != 0)
+   drm_framebuffer_desc desc{};
+   desc.width = image_create_info.extent.width;
+   desc.height = image_create_info.extent.height;
+   desc.format = allocated_format;
+   desc.num_planes = image_data->external_mem.get_num_planes();
+   desc.buffer_fds = image_data->external_mem.get_buffer_fds();
+   desc.offsets = image_data->external_mem.get_offsets();
+   for (uint32_t plane = 0; plane < desc.num_planes; plane++)
    {
-      WSI_LOG_ERROR("Failed to create framebuffer: %s", strerror(errno));
-      return VK_ERROR_INITIALIZATION_FAILED;
+      assert(image_data->external_mem.get_strides()[plane] > 0);
+      desc.strides[plane] = image_data->external_mem.get_strides()[plane];
    }
 
-   return ret_code;
+   /* Buffers that already have a framebuffer, e.g. on another swapchain of the display, share it. */
+   return m_display.get_framebuffer_cache().acquire(desc, image_data->fb_id);
 }
 
-VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+VkResult swapchain::allocate_swapchain_image_buffer(swapchain_image &image)
 {
-   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
-   image.status = swapchain_image::FREE;
+   image.status.store(swapchain_image::FREE);
    assert(image.data != nullptr);
    auto image_data = static_cast<display_image_data *>(image.data);
    TRY_LOG(allocate_image(image_data), "Failed to allocate image");
+   return VK_SUCCESS;
+}
 
-   image_status_lock.unlock();
-
+VkResult swapchain::export_swapchain_image(const VkImageCreateInfo &image_create_info, swapchain_image &image)
+{
+   auto image_data = static_cast<display_image_data *>(image.data);
    TRY_LOG(create_framebuffer(image_create_info, image_data), "Failed to create framebuffer");
+   return VK_SUCCESS;
+}
 
+VkResult swapchain::import_swapchain_image_buffer(swapchain_image &image)
+{
+   auto image_data = static_cast<display_image_data *>(image.data);
    TRY_LOG(image_data->external_mem.import_memory_and_bind_swapchain_image(image.image),
            "Failed to import memory and bind swapchain image");
 
@@ -452,10 +627,17 @@ VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_cr
    return VK_SUCCESS;
 }
 
+VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+{
+   TRY_LOG_CALL(allocate_swapchain_image_buffer(image));
+   TRY_LOG_CALL(export_swapchain_image(image_create_info, image));
+   return import_swapchain_image_buffer(image);
+}
+
 VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
 {
    /* Create image_data */
-   auto image_data = m_allocator.create<display_image_data>(1, m_device, m_allocator);
+   auto image_data = m_image_allocator.create<display_image_data>(1, m_device, m_image_allocator);
    if (image_data == nullptr)
    {
       return VK_ERROR_OUT_OF_HOST_MEMORY;
@@ -500,125 +682,461 @@ VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info,
 
       m_image_create_info = image_create_info;
       m_image_creation_parameters.m_allocated_format = allocated_format;
+
+      take_speculative_allocation();
    }
 
    return m_device_data.disp.CreateImage(m_device, &m_image_create_info, get_allocation_callbacks(), &image.image);
 }
 
-void swapchain::present_image(const pending_present_request &pending_present)
+const drm_plane_properties &swapchain::get_plane_properties(uint32_t &plane_id) const
 {
-   int drm_res = 0;
-   display_image_data *image_data =
-      reinterpret_cast<display_image_data *>(m_swapchain_images[pending_present.image_index].data);
-   const auto &display = drm_display::get_display();
-   if (!display.has_value())
+   if (m_overlay_plane != nullptr)
    {
-      set_error_state(VK_ERROR_SURFACE_LOST_KHR);
-      return;
+      plane_id = m_overlay_plane->id;
+      return m_overlay_plane->properties;
    }
 
-   if (m_first_present)
+   assert(m_display.get_atomic_properties() != nullptr);
+   plane_id = m_display.get_primary_plane_id();
+   return m_display.get_atomic_properties()->plane;
+}
+
+VkResult swapchain::present_image_atomic(display_image_data &image_data)
+{
+   const drm_atomic_properties *props = m_display.get_atomic_properties();
+   assert(props != nullptr);
+
+   /* Async commits may only change the framebuffer, so they do not carry the rest of the plane state. Drivers
+    * generally only flip primary planes asynchronously, so overlay planes always flip with vblank. */
+   const bool async_flip = (m_present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR || is_present_late()) &&
+                           !m_first_present && m_overlay_plane == nullptr && m_display.supports_async_page_flip(true);
+   drm_atomic_req_owner request{ async_flip ? drmModeAtomicAlloc() :
+                                              drmModeAtomicDuplicate(m_atomic_base_request.get()) };
+   if (request == nullptr)
    {
-      /* Now we can set the mode of the new swapchain. */
-      drmModeModeInfo modeInfo = m_display_mode->get_drm_mode();
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
 
-      uint32_t connector_id = display->get_connector_id();
-      drm_res = drmModeSetCrtc(display->get_drm_fd(), display->get_crtc_id(), image_data->fb_id, 0, 0, &connector_id, 1,
-                               &modeInfo);
+   const int drm_fd = m_display.get_drm_fd();
+   const uint32_t crtc_id = static_cast<uint32_t>(m_display.get_crtc_id());
+   uint32_t plane_id = 0;
+   const drm_plane_properties &plane_props = get_plane_properties(plane_id);
+   uint32_t commit_flags = DRM_MODE_ATOMIC_NONBLOCK | (async_flip ? DRM_MODE_PAGE_FLIP_ASYNC : 0);
 
-      if (drm_res != 0)
+   if (drmModeAtomicAddProperty(request.get(), plane_id, plane_props.fb_id, image_data.fb_id) < 0)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   if (m_first_present && m_overlay_plane == nullptr)
+   {
+      const uint32_t connector_id = m_display.get_connector_id();
+      if (drmModeAtomicAddProperty(request.get(), connector_id, props->connector_crtc_id, crtc_id) < 0 ||
+          drmModeAtomicAddProperty(request.get(), crtc_id, props->crtc_mode_id, m_mode_blob_id) < 0 ||
+          drmModeAtomicAddProperty(request.get(), crtc_id, props->crtc_active, 1) < 0)
       {
-         WSI_LOG_ERROR("drmModeSetCrtc failed: %s\n", std::strerror(errno));
-         set_error_state(VK_ERROR_SURFACE_LOST_KHR);
-         return;
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+
+      /* With variable refresh rate the display waits for late frames and scans them out as soon as they arrive,
+       * rather than holding them back until the next vblank. Set it either way so a previous swapchain's state
+       * does not carry over. */
+      if (props->crtc_vrr_enabled != 0)
+      {
+         const bool vrr = m_present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR ||
+                          m_present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR;
+         if (drmModeAtomicAddProperty(request.get(), crtc_id, props->crtc_vrr_enabled, vrr ? 1 : 0) < 0)
+         {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+         }
+      }
+
+      /* Check the configuration before consuming the present payload, so the legacy path can still be taken. When
+       * the CRTC already scans out the mode, e.g. after another swapchain, the commit is accepted without a modeset
+       * and is a plain flip, instead of a modeset that blanks the display. */
+      if (drmModeAtomicCommit(drm_fd, request.get(), DRM_MODE_ATOMIC_TEST_ONLY, nullptr) != 0)
+      {
+         if (drmModeAtomicCommit(drm_fd, request.get(), DRM_MODE_ATOMIC_TEST_ONLY | DRM_MODE_ATOMIC_ALLOW_MODESET,
+                                 nullptr) != 0)
+         {
+            WSI_LOG_WARNING("Atomic modeset rejected, falling back to legacy KMS: %s", std::strerror(errno));
+            return VK_ERROR_INCOMPATIBLE_DISPLAY_KHR;
+         }
+
+         /* Not all drivers support non-blocking modesets. */
+         commit_flags = DRM_MODE_ATOMIC_ALLOW_MODESET;
       }
    }
-   /* The swapchain has already started presenting. */
-   else
+
+   /* Let the kernel wait for rendering to finish. An invalid FD means the payload has already signalled. */
+   const int request_cursor = drmModeAtomicGetCursor(request.get());
+   std::optional<util::fd_owner> in_fence = std::move(image_data.in_fence);
+   image_data.in_fence.reset();
+   if (!in_fence.has_value())
+   {
+      in_fence = image_data.present_fence.export_sync_fd();
+   }
+   if (!in_fence.has_value())
+   {
+      TRY_LOG(image_data.present_fence.wait_payload(UINT64_MAX), "Failed to wait for the present payload");
+   }
+   else if (in_fence->is_valid() && async_flip && !m_async_in_fence_supported)
+   {
+      TRY_LOG(wait_sync_fd(in_fence->get(), UINT64_MAX), "Failed to wait for the present payload");
+   }
+   else if (in_fence->is_valid())
+   {
+      if (drmModeAtomicAddProperty(request.get(), plane_id, plane_props.in_fence_fd, in_fence->get()) < 0)
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   auto *listener = static_cast<drm_page_flip_listener *>(this);
+   int drm_res = drmModeAtomicCommit(drm_fd, request.get(), commit_flags | DRM_MODE_PAGE_FLIP_EVENT, listener);
+   if (drm_res != 0 && errno == EINVAL && async_flip && drmModeAtomicGetCursor(request.get()) != request_cursor)
+   {
+      /* Older kernels only accept FB_ID in async commits. Wait for rendering on the CPU instead. */
+      WSI_LOG_WARNING("Async atomic commit with IN_FENCE_FD rejected, waiting for rendering before flipping.");
+      m_async_in_fence_supported = false;
+      drmModeAtomicSetCursor(request.get(), request_cursor);
+      TRY_LOG(wait_sync_fd(in_fence->get(), UINT64_MAX), "Failed to wait for the present payload");
+      drm_res = drmModeAtomicCommit(drm_fd, request.get(), commit_flags | DRM_MODE_PAGE_FLIP_EVENT, listener);
+   }
+
+   if (drm_res != 0 && errno == EBUSY && (commit_flags & DRM_MODE_ATOMIC_NONBLOCK) != 0)
+   {
+      /* A swapchain on another plane of the CRTC has a commit pending. Wait for it in the kernel. */
+      commit_flags &= ~static_cast<uint32_t>(DRM_MODE_ATOMIC_NONBLOCK);
+      drm_res = drmModeAtomicCommit(drm_fd, request.get(), commit_flags | DRM_MODE_PAGE_FLIP_EVENT, listener);
+   }
+
+   if (drm_res != 0)
    {
+      WSI_LOG_ERROR("drmModeAtomicCommit failed: %s", std::strerror(errno));
+      return VK_ERROR_SURFACE_LOST_KHR;
+   }
+
+   return VK_SUCCESS;
+}
 
-      bool page_flip_complete = false;
+VkResult swapchain::present_image_legacy(display_image_data &image_data)
+{
+   /* A first present that fell back from atomic KMS has not waited for the present payload yet. */
+   TRY_LOG(image_data.present_fence.wait_payload(UINT64_MAX), "Failed to wait for the present payload");
 
-      drm_res = drmModePageFlip(display->get_drm_fd(), display->get_crtc_id(), image_data->fb_id,
-                                DRM_MODE_PAGE_FLIP_EVENT, (void *)&page_flip_complete);
+   drmModeModeInfo modeInfo = m_display_mode->get_drm_mode();
+   if (!m_first_present || m_display.is_mode_set(modeInfo))
+   {
+      /* When the CRTC already scans out the mode of a new swapchain, e.g. after another swapchain, flipping to its
+       * first image avoids a modeset that blanks the display. */
+      uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT;
+      if ((m_present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR || is_present_late()) &&
+          m_display.supports_async_page_flip(false))
+      {
+         flags |= DRM_MODE_PAGE_FLIP_ASYNC;
+      }
 
-      if (drm_res != 0)
+      int drm_res = drmModePageFlip(m_display.get_drm_fd(), m_display.get_crtc_id(), image_data.fb_id, flags,
+                                    static_cast<drm_page_flip_listener *>(this));
+      if (drm_res == 0)
+      {
+         return VK_SUCCESS;
+      }
+      if (!m_first_present)
       {
          WSI_LOG_ERROR("drmModePageFlip failed: %s\n", std::strerror(errno));
-         set_error_state(VK_ERROR_SURFACE_LOST_KHR);
-         return;
+         return VK_ERROR_SURFACE_LOST_KHR;
       }
+      /* The framebuffer may not fit the current configuration of the CRTC, set the mode instead. */
+   }
+
+   /* Now we can set the mode of the new swapchain. */
+   uint32_t connector_id = m_display.get_connector_id();
+   int drm_res = drmModeSetCrtc(m_display.get_drm_fd(), m_display.get_crtc_id(), image_data.fb_id, 0, 0,
+                                &connector_id, 1, &modeInfo);
+
+   if (drm_res != 0)
+   {
+      WSI_LOG_ERROR("drmModeSetCrtc failed: %s\n", std::strerror(errno));
+      return VK_ERROR_SURFACE_LOST_KHR;
+   }
+
+   /* The mode set is synchronous and sends no event, the image is already on screen. */
+   m_last_flip_time_ns = monotonic_now_ns();
+   complete_flip();
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::submit_flip(uint32_t image_index, uint64_t present_id, uint64_t timing_slot)
+{
+   auto *image_data = reinterpret_cast<display_image_data *>(m_swapchain_images[image_index].data);
 
-      fd_set fds;
-      FD_ZERO(&fds);
-      FD_SET(display->get_drm_fd(), &fds);
+   /* Record the flip before requesting it, since it may complete as soon as it has been requested. */
+   m_pending_flip_index = image_index;
+   m_pending_flip_present_id = present_id;
+   m_pending_flip_timing_slot = timing_slot;
 
-      do
+   VkResult result = VK_ERROR_INCOMPATIBLE_DISPLAY_KHR;
+   if (m_use_atomic)
+   {
+      result = present_image_atomic(*image_data);
+      if (result == VK_ERROR_INCOMPATIBLE_DISPLAY_KHR && m_plane_scaled)
+      {
+         /* Legacy KMS cannot scale the images, so the driver rejecting the plane scaling loses the surface. */
+         WSI_LOG_ERROR("The display controller cannot scale the images as requested.");
+         result = VK_ERROR_SURFACE_LOST_KHR;
+      }
+      else if (result == VK_ERROR_INCOMPATIBLE_DISPLAY_KHR)
       {
-         struct timeval t;
-         t.tv_sec = 1;
-         t.tv_usec = 0;
-         drm_res = select(display->get_drm_fd() + 1, &fds, NULL, NULL, &t);
+         m_use_atomic = false;
+         m_atomic_base_request.reset();
+      }
+   }
+
+   if (result == VK_ERROR_INCOMPATIBLE_DISPLAY_KHR)
+   {
+      result = present_image_legacy(*image_data);
+   }
 
-         if (drm_res < 0)
+   if (result != VK_SUCCESS)
+   {
+      m_pending_flip_index = NO_IMAGE_INDEX;
+   }
+   return result;
+}
+
+VkResult swapchain::wait_for_pending_flip(std::unique_lock<std::mutex> &lock)
+{
+   while (m_pending_flip_index != NO_IMAGE_INDEX)
+   {
+      if (m_flip_cond.wait_for(lock, std::chrono::seconds(1)) == std::cv_status::timeout)
+      {
+         if (!m_display.get_event_loop().is_running())
          {
-            if (errno != EINTR && errno != EAGAIN)
-            {
-               WSI_LOG_ERROR("select() failed with errno: %d\n", errno);
-               set_error_state(VK_ERROR_SURFACE_LOST_KHR);
-               break;
-            }
-            WSI_LOG_ERROR("select() failed with %d, carrying on with page flip\n", errno);
+            WSI_LOG_ERROR("The DRM event loop has stopped, the pending page flip will not complete.");
+            return VK_ERROR_SURFACE_LOST_KHR;
          }
-         else if (drm_res == 0)
+         WSI_LOG_WARNING("Timed out waiting for the pending page flip, carrying on.");
+      }
+   }
+
+   return VK_SUCCESS;
+}
+
+void swapchain::complete_flip()
+{
+   assert(m_pending_flip_index != NO_IMAGE_INDEX);
+
+   /* The image is on screen, change the image status to PRESENTED. */
+   const uint32_t previous_index = m_scanout_index;
+   m_scanout_index = m_pending_flip_index;
+   m_pending_flip_index = NO_IMAGE_INDEX;
+   m_swapchain_images[m_scanout_index].status = swapchain_image::PRESENTED;
+
+   WSI_TRACE_EVENT("drm_page_flip", m_pending_flip_present_id);
+   set_present_id(m_pending_flip_present_id);
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   auto *present_timing = get_swapchain_extension<wsi_ext_present_timing_display>();
+   if (present_timing != nullptr)
+   {
+      present_timing->image_presented(m_pending_flip_timing_slot, m_last_flip_time_ns);
+   }
+#endif
+
+   /* And release the one it replaced. */
+   if (previous_index != NO_IMAGE_INDEX)
+   {
+      unpresent_image(previous_index);
+   }
+
+   /* In mailbox mode the newest image queued while the flip was pending goes on screen next. */
+   if (m_mailbox_index != NO_IMAGE_INDEX)
+   {
+      const uint32_t mailbox_index = m_mailbox_index;
+      m_mailbox_index = NO_IMAGE_INDEX;
+      VkResult result = submit_flip(mailbox_index, m_mailbox_present_id, m_mailbox_timing_slot);
+      if (result != VK_SUCCESS)
+      {
+         present_dropped(m_mailbox_present_id);
+         unpresent_image(mailbox_index);
+         set_error_state(result);
+      }
+   }
+
+   m_flip_cond.notify_all();
+}
+
+void swapchain::finish_presentation()
+{
+   if (!m_flip_listener_added)
+   {
+      return;
+   }
+
+   {
+      /* The event loop commits the mailbox image when the pending flip completes, which sets a new pending flip. The
+       * kernel keeps reading the images of both until then, and delivers their events to this swapchain. */
+      std::unique_lock<std::mutex> lock(m_flip_lock);
+      while (m_pending_flip_index != NO_IMAGE_INDEX)
+      {
+         if (wait_for_pending_flip(lock) != VK_SUCCESS)
          {
-            WSI_LOG_ERROR("select() timed out, carrying on with page flip\n");
+            break;
          }
-         else
+      }
+   }
+
+   m_display.get_event_loop().remove_listener(this);
+   m_flip_listener_added = false;
+}
+
+void swapchain::page_flip_complete(uint64_t timestamp_ns)
+{
+   std::lock_guard<std::mutex> lock(m_flip_lock);
+   m_last_flip_time_ns = timestamp_ns;
+   complete_flip();
+}
+
+void swapchain::displays_changed()
+{
+   const drmModeModeInfo mode = m_display_mode->get_drm_mode();
+   if (!m_display.is_connected() || !m_display.is_mode_available(mode))
+   {
+      WSI_LOG_INFO("The display of the swapchain was unplugged or lost its mode, the swapchain is out of date.");
+      set_error_state(VK_ERROR_OUT_OF_DATE_KHR);
+   }
+   else if (m_display_mode->is_preferred() && !m_display.is_mode_preferred(mode) && !error_has_occured())
+   {
+      /* The mode still works, but the display plugged in now prefers another one. Presenting carries on as usual. */
+      set_suboptimal();
+   }
+}
+
+bool swapchain::is_present_late() const
+{
+   /* With variable refresh rate the display already waits for late frames, so they can flip with vblank. */
+   if (m_present_mode != VK_PRESENT_MODE_FIFO_RELAXED_KHR || m_last_flip_time_ns == 0 || m_display.supports_vrr())
+   {
+      return false;
+   }
+
+   const uint64_t refresh_interval_ns = get_refresh_duration();
+   if (refresh_interval_ns == 0)
+   {
+      return false;
+   }
+
+   /* The vblank following the last flip has already passed, waiting for the next one would repeat the last image
+    * for another refresh. */
+   return monotonic_now_ns() > m_last_flip_time_ns + refresh_interval_ns;
+}
+
+uint64_t swapchain::get_refresh_duration() const
+{
+   const uint32_t refresh_rate_mhz = m_display_mode->get_refresh_rate();
+   return refresh_rate_mhz != 0 ? 1000000000000ULL / refresh_rate_mhz : 0;
+}
+
+void swapchain::wait_for_target_vblank(std::unique_lock<std::mutex> &lock, uint64_t target_time_ns)
+{
+   const uint64_t refresh_duration = get_refresh_duration();
+   if (target_time_ns == 0 || refresh_duration == 0 || m_last_flip_time_ns == 0 || m_display.supports_vrr())
+   {
+      return;
+   }
+
+   /* Bound the target so a bogus time cannot stall the presentation thread. */
+   constexpr uint64_t max_target_delay_ns = 1000000000ull;
+   const uint64_t now_ns = monotonic_now_ns();
+   const uint64_t target_ns = std::min(target_time_ns, now_ns + max_target_delay_ns);
+
+   /* Present on the first vblank no earlier than half a refresh before the target, the vblanks following the last
+    * flip every refresh duration. */
+   const uint64_t earliest_vblank_ns = target_ns - std::min(target_ns, refresh_duration / 2);
+   if (earliest_vblank_ns <= m_last_flip_time_ns + refresh_duration)
+   {
+      return;
+   }
+   const uint64_t vblank_count = (earliest_vblank_ns - m_last_flip_time_ns + refresh_duration - 1) / refresh_duration;
+   const uint64_t request_time_ns = m_last_flip_time_ns + (vblank_count - 1) * refresh_duration;
+
+   const std::chrono::steady_clock::time_point request_time{ std::chrono::nanoseconds(request_time_ns) };
+   while (monotonic_now_ns() < request_time_ns && !error_has_occured())
+   {
+      m_flip_cond.wait_until(lock, request_time);
+   }
+}
+
+void swapchain::present_image(const pending_present_request &pending_present)
+{
+   uint64_t timing_slot = 0;
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   timing_slot = pending_present.timing_slot;
+   auto *present_timing = get_swapchain_extension<wsi_ext_present_timing_display>();
+#endif
+
+   if (m_present_mode == VK_PRESENT_MODE_MAILBOX_KHR && m_use_atomic && !m_first_present)
+   {
+      /* The image may be flipped to by the DRM event thread when the pending flip completes, which must not block on
+       * the payload. Export it for IN_FENCE_FD now, or wait for it here if it cannot be exported. */
+      auto *image_data = reinterpret_cast<display_image_data *>(m_swapchain_images[pending_present.image_index].data);
+      image_data->in_fence = image_data->present_fence.export_sync_fd();
+      if (!image_data->in_fence.has_value())
+      {
+         VkResult result = image_data->present_fence.wait_payload(UINT64_MAX);
+         if (result != VK_SUCCESS)
          {
-            int result = FD_ISSET(display->get_drm_fd(), &fds);
-            assert(result > 0);
-            UNUSED(result);
-            drmEventContext ev = {};
-            ev.version = DRM_EVENT_CONTEXT_VERSION;
-            ev.page_flip_handler = page_flip_event;
-
-            drmHandleEvent(display->get_drm_fd(), &ev);
+            WSI_LOG_ERROR("Failed to wait for the present payload.");
+            present_dropped(pending_present.present_id);
+            set_error_state(result);
+            return;
          }
-      } while ((drm_res == -1 && (errno == EINTR || errno == EAGAIN)) || drm_res == 0 || !page_flip_complete);
+         image_data->in_fence.emplace();
+      }
    }
 
-   /* Find currently presented image */
-   uint32_t presented_index = m_swapchain_images.size();
-   if (!m_first_present)
+   std::unique_lock<std::mutex> lock(m_flip_lock);
+   if (m_present_mode == VK_PRESENT_MODE_MAILBOX_KHR && m_pending_flip_index != NO_IMAGE_INDEX)
    {
-      for (uint32_t i = 0; i < m_swapchain_images.size(); ++i)
+      /* Replace the image waiting for the pending flip to complete, it will never be shown. */
+      if (m_mailbox_index != NO_IMAGE_INDEX)
       {
-         if (m_swapchain_images[i].status == swapchain_image::PRESENTED)
+         /* Drop the payload exported for IN_FENCE_FD, later rendering to the image is ordered after it on the queue. */
+         auto *image_data = reinterpret_cast<display_image_data *>(m_swapchain_images[m_mailbox_index].data);
+         image_data->in_fence.reset();
+         present_dropped(m_mailbox_present_id);
+         unpresent_image(m_mailbox_index);
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+         if (present_timing != nullptr)
          {
-            presented_index = i;
-            break;
+            present_timing->image_discarded(m_mailbox_timing_slot);
          }
+#endif
       }
-      /* There should always be a presented image, unless there was an error */
-      assert(presented_index < m_swapchain_images.size());
+      m_mailbox_index = pending_present.image_index;
+      m_mailbox_present_id = pending_present.present_id;
+      m_mailbox_timing_slot = timing_slot;
+      return;
    }
-   /* The image is on screen, change the image status to PRESENTED. */
-   m_swapchain_images[pending_present.image_index].status = swapchain_image::PRESENTED;
 
-   if (m_device_data.is_present_id_enabled())
+   /* The kernel queues a single flip per CRTC. Wait for the previous one rather than having the next one rejected. */
+   VkResult result = wait_for_pending_flip(lock);
+   if (result == VK_SUCCESS)
    {
-      auto *ext = get_swapchain_extension<wsi_ext_present_id>(true);
-      ext->set_present_id(pending_present.present_id);
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+      wait_for_target_vblank(lock, pending_present.target_time_ns);
+#endif
+      result = submit_flip(pending_present.image_index, pending_present.present_id, timing_slot);
    }
 
-   /* And release the old one. */
-   if (presented_index < m_swapchain_images.size())
+   if (result != VK_SUCCESS)
    {
-      unpresent_image(presented_index);
+      present_dropped(pending_present.present_id);
+      set_error_state(result);
    }
-
-   return;
 }
 
 VkResult swapchain::image_set_present_payload(swapchain_image &image, VkQueue queue,
@@ -630,44 +1148,98 @@ VkResult swapchain::image_set_present_payload(swapchain_image &image, VkQueue qu
 
 VkResult swapchain::image_wait_present(swapchain_image &image, uint64_t timeout)
 {
+   if (m_use_atomic)
+   {
+      /* The kernel waits for the payload through IN_FENCE_FD. */
+      return VK_SUCCESS;
+   }
+
    auto data = reinterpret_cast<display_image_data *>(image.data);
    return data->present_fence.wait_payload(timeout);
 }
 
-void swapchain::destroy_image(swapchain_image &image)
+int swapchain::image_get_present_sync_fd(swapchain_image &image)
+{
+   if (m_use_atomic)
+   {
+      return -1;
+   }
+
+   auto data = reinterpret_cast<display_image_data *>(image.data);
+   return data->present_fence.get_poll_fd();
+}
+
+VkResult swapchain::image_import_present_payload(swapchain_image &image, VkFence fence)
+{
+   auto data = reinterpret_cast<display_image_data *>(image.data);
+   return data->present_fence.import_payload_to_fence(fence);
+}
+
+VkResult swapchain::image_get_shareable_present_payload(swapchain_image &image, int &sync_fd)
+{
+   auto data = reinterpret_cast<display_image_data *>(image.data);
+   return data->present_fence.get_shareable_payload_fd(sync_fd);
+}
+
+VkResult swapchain::image_set_shared_present_payload(swapchain_image &image, VkQueue queue, int sync_fd)
+{
+   UNUSED(queue);
+   auto data = reinterpret_cast<display_image_data *>(image.data);
+   return data->present_fence.import_payload(sync_fd);
+}
+
+bool swapchain::adopt_ancestor_image(swapchain_base &ancestor, swapchain_image &image)
 {
-   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
+   auto &ancestor_format = static_cast<swapchain &>(ancestor).m_image_creation_parameters.m_allocated_format;
+   auto &allocated_format = m_image_creation_parameters.m_allocated_format;
+   if (ancestor_format.fourcc != allocated_format.fourcc || ancestor_format.modifier != allocated_format.modifier ||
+       ancestor_format.flags != allocated_format.flags)
+   {
+      return false;
+   }
+
+   /* The framebuffer belongs to the DRM device rather than the swapchain, so it can be used as it is. */
+   auto image_data = reinterpret_cast<display_image_data *>(image.data);
+   if (image_data == nullptr || image_data->fb_id == std::numeric_limits<uint32_t>::max())
+   {
+      return false;
+   }
+
+   /* The counters of the ancestor are freed with it, and the memory is ours from now on. */
+   image_data->external_mem.move_memory_usage(m_memory_usage);
+   return true;
+}
 
-   if (image.status != swapchain_image::INVALID)
+void swapchain::destroy_image(swapchain_image &image)
+{
+   /* Only the first caller to invalidate the image destroys the VkImage. */
+   const auto previous_status = image.status.exchange(swapchain_image::INVALID);
+   if (previous_status != swapchain_image::INVALID)
    {
       if (image.image != VK_NULL_HANDLE)
       {
          m_device_data.disp.DestroyImage(m_device, image.image, get_allocation_callbacks());
          image.image = VK_NULL_HANDLE;
       }
-
-      image.status = swapchain_image::INVALID;
    }
 
-   image_status_lock.unlock();
-
    if (image.data != nullptr)
    {
       auto image_data = reinterpret_cast<display_image_data *>(image.data);
-      auto &display = drm_display::get_display();
-      if (!display.has_value())
-      {
-         return;
-      }
+      wsialloc_buffer_ref allocated_buffer = std::move(image_data->allocated_buffer);
       if (image_data->fb_id != std::numeric_limits<uint32_t>::max())
       {
-         int result = drmModeRmFB(display->get_drm_fd(), image_data->fb_id);
-         assert(result == 0);
-         UNUSED(result);
+         m_display.get_framebuffer_cache().release(image_data->fb_id);
       }
 
-      m_allocator.destroy(1, image_data);
+      m_image_allocator.destroy(1, image_data);
       image.data = nullptr;
+
+      /* The page flip that replaced a free image on the plane has completed, so the buffer is no longer scanned out. */
+      if (previous_status == swapchain_image::FREE)
+      {
+         allocated_buffer.release(m_wsi_allocator);
+      }
    }
 }
 
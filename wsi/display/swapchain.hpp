@@ -37,6 +37,12 @@
 #include "surface.hpp"
 #include <util/wsialloc/wsialloc.h>
 #include <wsi/external_memory.hpp>
+#include <wsi/wsialloc_batch.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
 
 namespace wsi
 {
@@ -53,8 +59,12 @@ struct display_image_data
    }
 
    external_memory external_mem;
+   /* The buffer of @ref external_mem, given back to the wsialloc cache once it is no longer scanned out. */
+   wsialloc_buffer_ref allocated_buffer;
    uint32_t fb_id;
    sync_fd_fence_sync present_fence;
+   /* Present payload exported ahead of the flip, to be passed as IN_FENCE_FD. An invalid FD means it has completed. */
+   std::optional<util::fd_owner> in_fence;
 };
 
 struct image_creation_parameters
@@ -78,7 +88,7 @@ struct image_creation_parameters
 /**
  * @brief Display swapchain class.
  */
-class swapchain : public wsi::swapchain_base
+class swapchain : public wsi::swapchain_base, public drm_page_flip_listener
 {
 public:
    swapchain(layer::device_private_data &dev_data, const VkAllocationCallbacks *pAllocator, surface &wsi_surface);
@@ -91,6 +101,17 @@ public:
 
    VkResult allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image) override;
 
+   bool supports_parallel_image_creation() const override
+   {
+      return true;
+   }
+
+   VkResult allocate_swapchain_image_buffer(swapchain_image &image) override;
+
+   VkResult export_swapchain_image(const VkImageCreateInfo &image_create_info, swapchain_image &image) override;
+
+   VkResult import_swapchain_image_buffer(swapchain_image &image) override;
+
    virtual VkResult create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image) override;
 
    /**
@@ -108,15 +129,64 @@ public:
 
    virtual VkResult image_wait_present(swapchain_image &image, uint64_t timeout) override;
 
+   int image_get_present_sync_fd(swapchain_image &image) override;
+
+   bool supports_present_payload_import() override
+   {
+      return true;
+   }
+
+   VkResult image_import_present_payload(swapchain_image &image, VkFence fence) override;
+
+   VkResult image_get_shareable_present_payload(swapchain_image &image, int &sync_fd) override;
+
+   VkResult image_set_shared_present_payload(swapchain_image &image, VkQueue queue, int sync_fd) override;
+
+   bool adopt_ancestor_image(swapchain_base &ancestor, swapchain_image &image) override;
+
+   /**
+    * @brief Wait for the pending flip, and the mailbox image the DRM event loop flips after it, then stop receiving
+    *        page flip events.
+    */
+   void finish_presentation() override;
+
    void destroy_image(swapchain_image &image) override;
 
+   /**
+    * @brief Mark the image of the pending flip as presented and release the one it replaced on screen.
+    *
+    * Called on the DRM event loop thread when the flip completes.
+    *
+    * @param timestamp_ns Time at which the image started scanning out.
+    */
+   void page_flip_complete(uint64_t timestamp_ns) override;
+
+   /**
+    * @brief Mark the swapchain out of date or suboptimal if its display has been unplugged or its mode changed.
+    *
+    * Called on the DRM event loop thread after a hotplug event.
+    */
+   void displays_changed() override;
+
 private:
    VkResult allocate_image(display_image_data *image_data);
 
+   /**
+    * @brief Get the wsialloc flags the buffers of the images are allocated with.
+    *
+    * @param image_create_info The create info of the images.
+    */
+   uint64_t get_allocation_flags(const VkImageCreateInfo &image_create_info);
+
    VkResult allocate_wsialloc(VkImageCreateInfo &image_create_info, display_image_data *image_data,
                               util::vector<wsialloc_format> &importable_formats, wsialloc_format *allocated_format,
                               bool avoid_allocation);
 
+   /**
+    * @brief Use the buffers the surface allocated ahead of the swapchain for the images, if they match.
+    */
+   void take_speculative_allocation();
+
    VkResult get_surface_compatible_formats(const VkImageCreateInfo &info,
                                            util::vector<wsialloc_format> &importable_formats,
                                            util::vector<uint64_t> &exportable_modifers,
@@ -124,6 +194,101 @@ private:
 
    VkResult create_framebuffer(const VkImageCreateInfo &image_create_info, display_image_data *image_data);
 
+   /**
+    * @brief Prepare the atomic request with the plane state that is the same for every present.
+    *
+    * Leaves the swapchain on the legacy KMS path if the display does not support atomic modesetting. Swapchains on
+    * overlay planes fail instead, since overlay planes can only be driven with atomic commits.
+    *
+    * @param swapchain_create_info Swapchain create info.
+    * @return VK_SUCCESS on success, other result codes on failure.
+    */
+   VkResult init_atomic_request(const VkSwapchainCreateInfoKHR *swapchain_create_info);
+
+   /**
+    * @brief Get the id and the atomic KMS properties of the plane the swapchain presents to.
+    *
+    * Only valid when presenting with atomic commits.
+    *
+    * @param plane_id Set to the id of the plane.
+    */
+   const drm_plane_properties &get_plane_properties(uint32_t &plane_id) const;
+
+   /**
+    * @brief Present an image with an atomic commit.
+    *
+    * The kernel waits for the image's present payload through the plane's IN_FENCE_FD property, so the
+    * presentation engine does not need to block on it beforehand. The first present to a primary plane also sets
+    * the mode, overlay planes rely on the CRTC having been enabled by a swapchain on the primary plane.
+    *
+    * @param image_data The image to present.
+    * @return VK_SUCCESS once the commit is queued, VK_ERROR_INCOMPATIBLE_DISPLAY_KHR if the driver rejected the
+    *         atomic modeset and the legacy path should be used instead, other result codes on failure.
+    */
+   VkResult present_image_atomic(display_image_data &image_data);
+
+   /**
+    * @brief Present an image with the legacy drmModeSetCrtc and drmModePageFlip interfaces.
+    *
+    * @param image_data The image to present.
+    * @return VK_SUCCESS once the flip is queued, other result codes on failure.
+    */
+   VkResult present_image_legacy(display_image_data &image_data);
+
+   /**
+    * @brief Request a flip to an image, through atomic KMS if possible and legacy KMS otherwise.
+    *
+    * Must be called with @ref m_flip_lock held and no flip pending.
+    *
+    * @param image_index Index of the image to flip to.
+    * @param present_id  Present id of the image.
+    * @param timing_slot Slot of the present timing entry of the present, 0 if no timing was requested.
+    * @return VK_SUCCESS once the flip is queued, other result codes on failure.
+    */
+   VkResult submit_flip(uint32_t image_index, uint64_t present_id, uint64_t timing_slot);
+
+   /**
+    * @brief Wait for the completion of the flip requested by the previous present, if any.
+    *
+    * @param lock Lock holding @ref m_flip_lock.
+    * @return VK_SUCCESS once there is no pending flip, VK_ERROR_SURFACE_LOST_KHR if it can no longer complete.
+    */
+   VkResult wait_for_pending_flip(std::unique_lock<std::mutex> &lock);
+
+   /**
+    * @brief Mark the image of the pending flip as presented, release the one it replaced on screen and flip to the
+    *        mailbox image, if any.
+    *
+    * Must be called with @ref m_flip_lock held.
+    */
+   void complete_flip();
+
+   /**
+    * @brief Whether a VK_PRESENT_MODE_FIFO_RELAXED_KHR present missed the vblank following the last flip, in which
+    *        case it flips without waiting for vblank.
+    *
+    * Must be called with @ref m_flip_lock held.
+    */
+   bool is_present_late() const;
+
+   /**
+    * @brief Get the refresh duration of the display mode.
+    *
+    * @return The refresh duration in nanoseconds, or 0 if the mode has no refresh rate.
+    */
+   uint64_t get_refresh_duration() const;
+
+   /**
+    * @brief Hold the next flip until it lands on the vblank closest to a target time.
+    *
+    * A flip completes on the first vblank after it is requested, so the wait ends one refresh before that vblank.
+    * Must be called with @ref m_flip_lock held and no flip pending.
+    *
+    * @param lock           The lock holding @ref m_flip_lock, released while waiting.
+    * @param target_time_ns CLOCK_MONOTONIC time the image should be presented at in nanoseconds, 0 for none.
+    */
+   void wait_for_target_vblank(std::unique_lock<std::mutex> &lock, uint64_t target_time_ns);
+
    /**
     * @brief Adds required extensions to the extension list of the swapchain
     *
@@ -134,8 +299,121 @@ private:
    VkResult add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info) override;
 
    wsialloc_allocator *m_wsi_allocator;
+
+   /**
+    * @brief Buffers allocated by the batch, or by the surface ahead of the swapchain, that have not been handed to an
+    *        image yet.
+    */
+   wsialloc_batch m_batch_allocations;
+
+   /**
+    * @brief Buffers the surface started allocating ahead of the swapchain, until the first image is created.
+    */
+   util::unique_ptr<speculative_allocation> m_speculative_allocation;
+
+   /**
+    * @brief The display presented to, owned by the @ref drm_display_registry.
+    */
+   drm_display &m_display;
+
+   /**
+    * @brief The overlay plane presented to, or nullptr for the primary plane of @ref m_display.
+    */
+   const drm_overlay_plane *m_overlay_plane;
+
    drm_display_mode *m_display_mode;
+
+   /**
+    * @brief Extent of the surface, the area of the plane the images are scaled and placed into.
+    */
+   VkExtent2D m_surface_extent;
+
    image_creation_parameters m_image_creation_parameters;
+
+   /**
+    * @brief Whether presents use atomic commits.
+    *
+    * Read when waiting for present payloads, which may happen outside the presentation thread.
+    */
+   std::atomic<bool> m_use_atomic;
+
+   /**
+    * @brief Whether the images are scaled or placed away from the top left of the CRTC, which only atomic commits
+    *        can do.
+    */
+   bool m_plane_scaled;
+
+   /**
+    * @brief Property blob holding the display mode, set by the first atomic commit.
+    */
+   uint32_t m_mode_blob_id;
+
+   /**
+    * @brief Atomic request with the plane state shared by all presents. Duplicated for each commit.
+    */
+   drm_atomic_req_owner m_atomic_base_request;
+
+   /**
+    * @brief Whether the swapchain is registered with the DRM event loop.
+    */
+   bool m_flip_listener_added;
+
+   static constexpr uint32_t NO_IMAGE_INDEX = std::numeric_limits<uint32_t>::max();
+
+   /**
+    * @brief Protects the flip state below, which is updated by the DRM event loop.
+    */
+   std::mutex m_flip_lock;
+
+   /**
+    * @brief Signalled when the pending flip completes.
+    */
+   std::condition_variable m_flip_cond;
+
+   /**
+    * @brief Index of the image waiting to be flipped on screen, or NO_IMAGE_INDEX.
+    */
+   uint32_t m_pending_flip_index;
+
+   /**
+    * @brief Present id of the image waiting to be flipped on screen.
+    */
+   uint64_t m_pending_flip_present_id;
+
+   /**
+    * @brief Slot of the present timing entry of the image waiting to be flipped on screen, 0 if none.
+    */
+   uint64_t m_pending_flip_timing_slot;
+
+   /**
+    * @brief Index of the image being scanned out, or NO_IMAGE_INDEX before the first flip.
+    */
+   uint32_t m_scanout_index;
+
+   /**
+    * @brief Index of the image to flip to once the pending flip completes in mailbox mode, or NO_IMAGE_INDEX.
+    */
+   uint32_t m_mailbox_index;
+
+   /**
+    * @brief Present id of the mailbox image.
+    */
+   uint64_t m_mailbox_present_id;
+
+   /**
+    * @brief Slot of the present timing entry of the mailbox image, 0 if none.
+    */
+   uint64_t m_mailbox_timing_slot;
+
+   /**
+    * @brief Whether the kernel accepts IN_FENCE_FD in async atomic commits.
+    */
+   bool m_async_in_fence_supported;
+
+   /**
+    * @brief Time at which the last flip completed, in CLOCK_MONOTONIC nanoseconds, or 0 before the first one.
+    */
+   uint64_t m_last_flip_time_ns;
 };
 } /* namespace display */
 
@@ -29,16 +29,13 @@
  */
 #include "frame_boundary.hpp"
 
-namespace wsi
-{
+#include <algorithm>
 
-wsi_ext_frame_boundary::wsi_ext_frame_boundary(const layer::device_private_data &device_data)
-   : m_handle_frame_boundary_events(device_data.should_layer_handle_frame_boundary_events())
+namespace wsi
 {
-}
 
 std::optional<VkFrameBoundaryEXT> wsi_ext_frame_boundary::handle_frame_boundary_event(
-   const VkPresentInfoKHR *present_info, VkImage *current_image_to_be_presented)
+   const VkFrameBoundaryEXT *application_frame_boundary, VkImage *current_image_to_be_presented)
 {
    /* If frame boundary feature is not enabled by the application, the layer will
     * pass its own frame boundary events back to ICD. Otherwise, let the application
@@ -46,25 +43,17 @@ std::optional<VkFrameBoundaryEXT> wsi_ext_frame_boundary::handle_frame_boundary_
 
    /* First, check if the application passed any frame boundary events and if that's
     * the case, just forward it at queue submission. */
-   auto application_frame_boundary_event = wsi::create_frame_boundary(*present_info);
+   auto application_frame_boundary_event = wsi::create_frame_boundary(application_frame_boundary);
    if (application_frame_boundary_event.has_value())
    {
       return application_frame_boundary_event;
    }
 
-   if (m_handle_frame_boundary_events)
-   {
-      return create_frame_boundary(current_image_to_be_presented);
-   }
-
-   return std::nullopt;
+   return create_frame_boundary(current_image_to_be_presented);
 }
 
-std::optional<VkFrameBoundaryEXT> create_frame_boundary(const VkPresentInfoKHR &present_info)
+std::optional<VkFrameBoundaryEXT> create_frame_boundary(const VkFrameBoundaryEXT *present_frame_boundary)
 {
-   auto *present_frame_boundary =
-      util::find_extension<VkFrameBoundaryEXT>(VK_STRUCTURE_TYPE_PRESENT_ID_KHR, present_info.pNext);
-
    /* Extract the VkFrameBoundaryEXT structure to avoid passing other, unrelated structures to vkQueueSubmit */
    if (present_frame_boundary != nullptr)
    {
@@ -74,11 +63,6 @@ std::optional<VkFrameBoundaryEXT> create_frame_boundary(const VkPresentInfoKHR &
    return std::nullopt;
 }
 
-bool wsi_ext_frame_boundary::should_layer_handle_frame_boundary_events() const
-{
-   return m_handle_frame_boundary_events;
-}
-
 VkFrameBoundaryEXT wsi_ext_frame_boundary::create_frame_boundary(VkImage *image)
 {
    VkFrameBoundaryEXT frame_boundary{};
@@ -107,16 +91,108 @@ VkFrameBoundaryEXT wsi_ext_frame_boundary::create_frame_boundary(VkImage *image)
    return frame_boundary;
 }
 
-std::optional<VkFrameBoundaryEXT> handle_frame_boundary_event(const VkPresentInfoKHR *present_info,
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+VkSwapchainFrameStatisticsARM *wsi_ext_frame_boundary::get_frame_statistics_slot(uint64_t slot)
+{
+   if (slot == 0 || slot > m_frame_statistics_count ||
+       m_frame_statistics_count - slot >= VK_SWAPCHAIN_FRAME_STATISTICS_COUNT_ARM)
+   {
+      return nullptr;
+   }
+   return &m_frame_statistics[(slot - 1) % VK_SWAPCHAIN_FRAME_STATISTICS_COUNT_ARM];
+}
+
+uint64_t wsi_ext_frame_boundary::begin_frame_statistics(uint64_t frame_id, uint64_t present_call_time,
+                                                        uint32_t images_in_flight)
+{
+   std::lock_guard<std::mutex> lock(m_frame_statistics_lock);
+   const uint64_t slot = ++m_frame_statistics_count;
+   VkSwapchainFrameStatisticsARM *frame = get_frame_statistics_slot(slot);
+   assert(frame != nullptr);
+   *frame = {};
+   frame->frameID = frame_id;
+   frame->presentCallTime = present_call_time;
+   frame->imagesInFlight = images_in_flight;
+   return slot;
+}
+
+void wsi_ext_frame_boundary::end_present_call(uint64_t slot, uint64_t time_ns)
+{
+   std::lock_guard<std::mutex> lock(m_frame_statistics_lock);
+   VkSwapchainFrameStatisticsARM *frame = get_frame_statistics_slot(slot);
+   if (frame != nullptr && time_ns > frame->presentCallTime)
+   {
+      frame->presentCallDuration = time_ns - frame->presentCallTime;
+   }
+}
+
+void wsi_ext_frame_boundary::discard_frame_statistics(uint64_t slot)
+{
+   std::lock_guard<std::mutex> lock(m_frame_statistics_lock);
+   assert(slot == m_frame_statistics_count);
+   if (slot != 0 && slot == m_frame_statistics_count)
+   {
+      m_frame_statistics_count--;
+   }
+}
+
+void wsi_ext_frame_boundary::record_gpu_wait(uint64_t slot, uint64_t duration_ns)
+{
+   std::lock_guard<std::mutex> lock(m_frame_statistics_lock);
+   VkSwapchainFrameStatisticsARM *frame = get_frame_statistics_slot(slot);
+   if (frame != nullptr)
+   {
+      frame->gpuWaitDuration = duration_ns;
+   }
+}
+
+void wsi_ext_frame_boundary::record_presentation_counts(uint64_t slot, uint64_t flip_count, uint64_t copy_count)
+{
+   std::lock_guard<std::mutex> lock(m_frame_statistics_lock);
+   VkSwapchainFrameStatisticsARM *frame = get_frame_statistics_slot(slot);
+   if (frame != nullptr)
+   {
+      frame->flipCount = flip_count;
+      frame->copyCount = copy_count;
+   }
+}
+
+VkResult wsi_ext_frame_boundary::get_frame_statistics(uint32_t *frame_count,
+                                                      VkSwapchainFrameStatisticsARM *frame_statistics)
+{
+   assert(frame_count != nullptr);
+
+   std::lock_guard<std::mutex> lock(m_frame_statistics_lock);
+   const auto available = static_cast<uint32_t>(
+      std::min<uint64_t>(m_frame_statistics_count, VK_SWAPCHAIN_FRAME_STATISTICS_COUNT_ARM));
+   if (frame_statistics == nullptr)
+   {
+      *frame_count = available;
+      return VK_SUCCESS;
+   }
+
+   const uint32_t written = std::min(*frame_count, available);
+   const uint64_t first_slot = m_frame_statistics_count - available + 1;
+   for (uint32_t i = 0; i < written; i++)
+   {
+      frame_statistics[i] = *get_frame_statistics_slot(first_slot + i);
+   }
+   *frame_count = written;
+
+   return written < available ? VK_INCOMPLETE : VK_SUCCESS;
+}
+#endif
+
+std::optional<VkFrameBoundaryEXT> handle_frame_boundary_event(const VkFrameBoundaryEXT *application_frame_boundary,
                                                               VkImage *current_image_to_be_presented,
                                                               wsi::wsi_ext_frame_boundary *frame_boundary)
 {
    if (frame_boundary)
    {
-      return frame_boundary->handle_frame_boundary_event(present_info, current_image_to_be_presented);
+      return frame_boundary->handle_frame_boundary_event(application_frame_boundary, current_image_to_be_presented);
    }
 
-   return create_frame_boundary(*present_info);
+   return create_frame_boundary(application_frame_boundary);
 }
 
 }
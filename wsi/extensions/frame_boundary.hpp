@@ -32,10 +32,13 @@
 
 #include <vulkan/vulkan.h>
 #include <layer/private_data.hpp>
+#include <layer/wsi_layer_experimental.hpp>
 
 #include <util/custom_allocator.hpp>
 #include <util/macros.hpp>
 
+#include <array>
+#include <mutex>
 #include <optional>
 
 #include "wsi_extension.hpp"
@@ -47,7 +50,8 @@ namespace wsi
  * @brief Frame boundary extension class
  *
  * This class defines the frame boundary extension
- * features.
+ * features. It is only added to swapchains when the layer passes its own frame boundary events, so the presents of
+ * other swapchains only forward the frame boundaries given by the application.
  */
 class wsi_ext_frame_boundary : public wsi_ext
 {
@@ -55,19 +59,69 @@ public:
    /**
     * @brief The name of the extension.
     */
-   WSI_DEFINE_EXTENSION(VK_EXT_FRAME_BOUNDARY_EXTENSION_NAME);
+   WSI_DEFINE_EXTENSION(VK_EXT_FRAME_BOUNDARY_EXTENSION_NAME, frame_boundary);
 
-   wsi_ext_frame_boundary(const layer::device_private_data &device_data);
+   wsi_ext_frame_boundary() = default;
 
    /**
     * @brief Handle frame boundary event at present time
     *
-    * @param present_info Information about the swapchain and image to be presented.
+    * @param application_frame_boundary Frame boundary passed by the application at present, or nullptr.
     * @param current_image_to_be_presented Address to the currently to be presented image
     */
-   std::optional<VkFrameBoundaryEXT> handle_frame_boundary_event(const VkPresentInfoKHR *present_info,
+   std::optional<VkFrameBoundaryEXT> handle_frame_boundary_event(const VkFrameBoundaryEXT *application_frame_boundary,
                                                                  VkImage *current_image_to_be_presented);
 
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   /**
+    * @brief Record the statistics of a frame as it is queued for presentation.
+    *
+    * @param frame_id          frameID of the frame boundary of the present.
+    * @param present_call_time Time vkQueuePresentKHR was called, as returned by latency_recorder::now().
+    * @param images_in_flight  Number of images queued for presentation or being presented, including this one.
+    *
+    * @return Slot of the frame to pass to @ref end_present_call and @ref record_gpu_wait. Never 0.
+    */
+   uint64_t begin_frame_statistics(uint64_t frame_id, uint64_t present_call_time, uint32_t images_in_flight);
+
+   /**
+    * @brief Record the time vkQueuePresentKHR finished queueing the frame in @p slot.
+    */
+   void end_present_call(uint64_t slot, uint64_t time_ns);
+
+   /**
+    * @brief Drop the frame in @p slot as it failed to be queued for presentation.
+    *
+    * Only the most recent frame can be dropped, so it must be called before beginning the statistics of another one.
+    */
+   void discard_frame_statistics(uint64_t slot);
+
+   /**
+    * @brief Record the time the present payload of the frame in @p slot took to complete.
+    *
+    * Does nothing if @p slot is 0 or the frame has been overwritten by newer ones.
+    */
+   void record_gpu_wait(uint64_t slot, uint64_t duration_ns);
+
+   /**
+    * @brief Record how many presents of the swapchain completed by flipping and by copying, as of the frame in @p slot.
+    *
+    * Does nothing if @p slot is 0 or the frame has been overwritten by newer ones.
+    */
+   void record_presentation_counts(uint64_t slot, uint64_t flip_count, uint64_t copy_count);
+
+   /**
+    * @brief Copy the statistics of the most recent frames, oldest first.
+    *
+    * @param[in,out] frame_count      Number of elements of @p frame_statistics, set to the number written. If
+    *                                 @p frame_statistics is nullptr, set to the number of frames available.
+    * @param[out]    frame_statistics Output array, or nullptr.
+    *
+    * @return VK_INCOMPLETE if more frames were available than written, VK_SUCCESS otherwise.
+    */
+   VkResult get_frame_statistics(uint32_t *frame_count, VkSwapchainFrameStatisticsARM *frame_statistics);
+#endif
+
 private:
    /**
     * @brief Create a frame boundary with the current image
@@ -78,39 +132,52 @@ private:
    VkFrameBoundaryEXT create_frame_boundary(VkImage *image);
 
    /**
-    * @brief Check whether we should handle frame boundary events.
+    * @brief Holds the number of the current frame identifier for the swapchain
+    */
+   uint64_t m_current_frame_boundary_id{ 0 };
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   /**
+    * @brief Get the statistics of the frame in @p slot, or nullptr if it has been overwritten by newer frames.
     *
-    * @return true if supported, false otherwise.
+    * Must be called with @ref m_frame_statistics_lock held.
     */
-   bool should_layer_handle_frame_boundary_events() const;
+   VkSwapchainFrameStatisticsARM *get_frame_statistics_slot(uint64_t slot);
 
    /**
-    * @brief Holds the number of the current frame identifier for the swapchain
+    * @brief Protects the frame statistics, which the presentation thread completes while the application presents.
     */
-   uint64_t m_current_frame_boundary_id{ 0 };
+   std::mutex m_frame_statistics_lock;
+
+   /**
+    * @brief Statistics of the most recent frames. The frame in slot N is at index
+    *        (N - 1) % VK_SWAPCHAIN_FRAME_STATISTICS_COUNT_ARM.
+    */
+   std::array<VkSwapchainFrameStatisticsARM, VK_SWAPCHAIN_FRAME_STATISTICS_COUNT_ARM> m_frame_statistics{};
 
    /**
-    * @brief Stores whether the layer should handle frame boundary events.
+    * @brief Number of frames recorded, which is also the slot of the most recent one.
     */
-   const bool m_handle_frame_boundary_events;
+   uint64_t m_frame_statistics_count{ 0 };
+#endif
 };
 
 /**
  * @brief Create a frame boundary object
  *
- * @param present_info Present info
- * @return Frame boundary if @p present_info has passed it.
+ * @param present_frame_boundary Frame boundary found in the pNext chain of the present info, or nullptr.
+ * @return Frame boundary if the application has passed it, without its pNext chain.
  */
-std::optional<VkFrameBoundaryEXT> create_frame_boundary(const VkPresentInfoKHR &present_info);
+std::optional<VkFrameBoundaryEXT> create_frame_boundary(const VkFrameBoundaryEXT *present_frame_boundary);
 
 /**
  * @brief Handle frame boundary event at present time
  *
- * @param present_info Information about the swapchain and image to be presented.
+ * @param application_frame_boundary Frame boundary passed by the application at present, or nullptr.
  * @param current_image_to_be_presented Address to the currently to be presented image
  * @param frame_boundary Frame boundary extension for current backend or nullptr if not enabled.
  */
-std::optional<VkFrameBoundaryEXT> handle_frame_boundary_event(const VkPresentInfoKHR *present_info,
+std::optional<VkFrameBoundaryEXT> handle_frame_boundary_event(const VkFrameBoundaryEXT *application_frame_boundary,
                                                               VkImage *current_image_to_be_presented,
                                                               wsi::wsi_ext_frame_boundary *frame_boundary);
 
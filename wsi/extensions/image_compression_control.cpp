@@ -36,9 +36,11 @@
 
 namespace wsi
 {
-wsi_ext_image_compression_control::wsi_ext_image_compression_control(const VkImageCompressionControlEXT &extension)
+wsi_ext_image_compression_control::wsi_ext_image_compression_control(const VkImageCompressionControlEXT &extension,
+                                                                     bool layer_default)
    : m_compression_control{ VK_STRUCTURE_TYPE_IMAGE_COMPRESSION_CONTROL_EXT, nullptr, extension.flags,
                             extension.compressionControlPlaneCount, m_array_fixed_rate_flags }
+   , m_layer_default{ layer_default }
 {
    for (uint32_t i = 0; i < extension.compressionControlPlaneCount; i++)
    {
@@ -47,7 +49,7 @@ wsi_ext_image_compression_control::wsi_ext_image_compression_control(const VkIma
 }
 
 wsi_ext_image_compression_control::wsi_ext_image_compression_control(const wsi_ext_image_compression_control &extension)
-   : wsi_ext_image_compression_control(extension.m_compression_control)
+   : wsi_ext_image_compression_control(extension.m_compression_control, extension.m_layer_default)
 {
 }
 
@@ -62,7 +64,7 @@ VkImageCompressionFlagsEXT wsi_ext_image_compression_control::get_bitmask_for_im
 }
 
 std::optional<wsi_ext_image_compression_control> wsi_ext_image_compression_control::create(
-   VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info)
+   VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info, bool scanout)
 {
    const auto *image_compression_control = util::find_extension<VkImageCompressionControlEXT>(
       VK_STRUCTURE_TYPE_IMAGE_COMPRESSION_CONTROL_EXT, swapchain_create_info->pNext);
@@ -73,6 +75,18 @@ std::optional<wsi_ext_image_compression_control> wsi_ext_image_compression_contr
       return wsi_ext_image_compression_control{ *image_compression_control };
    }
 
+   if (scanout && image_compression_control == nullptr &&
+       device_data.instance_data.get_layer_settings().scanout_compression &&
+       device_data.instance_data.has_image_compression_support(device_data.physical_device))
+   {
+      /* Querying the modifiers with the default fixed-rate compression reports the rates each of them applies. */
+      const VkImageCompressionControlEXT layer_compression_control = {
+         VK_STRUCTURE_TYPE_IMAGE_COMPRESSION_CONTROL_EXT, nullptr, VK_IMAGE_COMPRESSION_FIXED_RATE_DEFAULT_EXT, 0,
+         nullptr
+      };
+      return wsi_ext_image_compression_control{ layer_compression_control, true };
+   }
+
    return std::nullopt;
 }
 
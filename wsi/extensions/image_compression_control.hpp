@@ -56,14 +56,14 @@ public:
    /**
     * @brief The name of the extension.
     */
-   WSI_DEFINE_EXTENSION(VK_EXT_IMAGE_COMPRESSION_CONTROL_EXTENSION_NAME);
+   WSI_DEFINE_EXTENSION(VK_EXT_IMAGE_COMPRESSION_CONTROL_EXTENSION_NAME, image_compression_control);
 
    /**
     * @brief Constructor for the wsi_ext_image_compression_control class.
     *
     * @param extension Reference to VkImageCompressionControlEXT structure.
     */
-   wsi_ext_image_compression_control(const VkImageCompressionControlEXT &extension);
+   wsi_ext_image_compression_control(const VkImageCompressionControlEXT &extension, bool layer_default = false);
 
    wsi_ext_image_compression_control(const wsi_ext_image_compression_control &extension);
 
@@ -76,6 +76,7 @@ public:
 
       auto compression_control = wsi_ext_image_compression_control(extension);
       std::swap(m_compression_control, compression_control.m_compression_control);
+      m_layer_default = compression_control.m_layer_default;
       for (uint32_t i = 0; i < compression_control.m_compression_control.compressionControlPlaneCount; i++)
       {
          m_compression_control.pFixedRateFlags[i] = compression_control.m_compression_control.pFixedRateFlags[i];
@@ -87,13 +88,18 @@ public:
    /**
     * @brief Create wsi_ext_image_compression_control class if deemed necessary.
     *
+    * When the application does not control the compression of a swapchain that is scanned out, the
+    * "scanout_compression" layer setting gives it the default fixed-rate compression instead, see
+    * is_layer_default().
+    *
     * @param device The Vulkan device
     * @param swapchain_create_info Swapchain create info
-    * @return Valid wsi_ext_image_compression_control if requested by application,
+    * @param scanout Whether the images of the swapchain are scanned out by a display controller.
+    * @return Valid wsi_ext_image_compression_control if requested by application or by the layer settings,
     * otherwise - an empty optional.
     */
    static std::optional<wsi_ext_image_compression_control> create(
-      VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info);
+      VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info, bool scanout = false);
 
    /**
     * @brief This API is used to get the compression control properties of an image.
@@ -109,6 +115,16 @@ public:
     */
    VkImageCompressionFlagsEXT get_bitmask_for_image_compression_flags();
 
+   /**
+    * @brief Check whether the compression was chosen by the layer rather than by the application.
+    *
+    * The images then use the most compressed modifier among those the presentation engine accepts.
+    */
+   bool is_layer_default() const
+   {
+      return m_layer_default;
+   }
+
 private:
    /**
     * @brief Array to hold the pFixedRateFlags.
@@ -119,6 +135,11 @@ private:
     * @brief Image compression control properties.
     */
    VkImageCompressionControlEXT m_compression_control;
+
+   /**
+    * @brief Whether the compression was chosen by the layer.
+    */
+   bool m_layer_default;
 };
 
 } /* namespace wsi */
@@ -29,16 +29,153 @@
  */
 #include "present_id.hpp"
 
+#include <cassert>
+#include <chrono>
+
+#include <util/futex.hpp>
+
 namespace wsi
 {
 
 void wsi_ext_present_id::set_present_id(uint64_t value)
 {
-   if (value != 0)
+   uint64_t current = m_present_id.load(std::memory_order_relaxed);
+   do
+   {
+      if (value <= current)
+      {
+         return;
+      }
+   } while (!m_present_id.compare_exchange_weak(current, value));
+
+   /* Pairs with the waiters publishing their present ID before re-checking m_present_id. */
+   if (m_min_waited_present_id.load() > value)
+   {
+      return;
+   }
+
+   std::lock_guard<std::mutex> lock(m_waiters_mutex);
+   wake_waiters_locked(value);
+}
+
+void wsi_ext_present_id::set_error_state(VkResult error)
+{
+   assert(error < 0);
+
+   VkResult expected = VK_SUCCESS;
+   if (!m_error_state.compare_exchange_strong(expected, error))
+   {
+      return;
+   }
+
+   std::lock_guard<std::mutex> lock(m_waiters_mutex);
+   wake_waiters_locked(UINT64_MAX);
+}
+
+void wsi_ext_present_id::wake_waiters_locked(uint64_t present_id)
+{
+   while (m_waiters != nullptr && m_waiters->present_id <= present_id)
+   {
+      present_waiter *waiter = m_waiters;
+      m_waiters = waiter->next;
+      if (m_waiters != nullptr)
+      {
+         m_waiters->prev = nullptr;
+      }
+
+      /* The waiter takes the lock before returning, so the node stays valid until the lock is released. */
+      waiter->woken.store(1, std::memory_order_release);
+      util::futex_wake(waiter->woken, 1);
+   }
+
+   m_min_waited_present_id.store(m_waiters != nullptr ? m_waiters->present_id : UINT64_MAX);
+}
+
+VkResult wsi_ext_present_id::wait_for_present(uint64_t present_id, uint64_t timeout)
+{
+   if (m_present_id.load(std::memory_order_acquire) >= present_id)
+   {
+      return VK_SUCCESS;
+   }
+
+   VkResult error = m_error_state.load(std::memory_order_acquire);
+   if (error != VK_SUCCESS)
+   {
+      return error;
+   }
+
+   if (timeout == 0)
+   {
+      return VK_TIMEOUT;
+   }
+
+   present_waiter waiter{};
+   waiter.present_id = present_id;
+   {
+      std::lock_guard<std::mutex> lock(m_waiters_mutex);
+
+      present_waiter **link = &m_waiters;
+      present_waiter *prev = nullptr;
+      while (*link != nullptr && (*link)->present_id <= present_id)
+      {
+         prev = *link;
+         link = &prev->next;
+      }
+      waiter.prev = prev;
+      waiter.next = *link;
+      if (waiter.next != nullptr)
+      {
+         waiter.next->prev = &waiter;
+      }
+      *link = &waiter;
+      m_min_waited_present_id.store(m_waiters->present_id);
+
+      /* The present ID may have been set before the waiter was visible to set_present_id. */
+      wake_waiters_locked(m_error_state.load() != VK_SUCCESS ? UINT64_MAX : m_present_id.load());
+   }
+
+   const auto start = std::chrono::steady_clock::now();
+   while (waiter.woken.load(std::memory_order_acquire) == 0)
+   {
+      uint64_t remaining = UINT64_MAX;
+      if (timeout != UINT64_MAX)
+      {
+         const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                                   start);
+         if (static_cast<uint64_t>(elapsed.count()) >= timeout)
+         {
+            break;
+         }
+         remaining = timeout - static_cast<uint64_t>(elapsed.count());
+      }
+      util::futex_wait(waiter.woken, 0, remaining);
+   }
+
+   std::lock_guard<std::mutex> lock(m_waiters_mutex);
+   if (waiter.woken.load(std::memory_order_relaxed) == 0)
+   {
+      /* Timed out, so the waiter is still in the list. */
+      if (waiter.prev != nullptr)
+      {
+         waiter.prev->next = waiter.next;
+      }
+      else
+      {
+         m_waiters = waiter.next;
+      }
+      if (waiter.next != nullptr)
+      {
+         waiter.next->prev = waiter.prev;
+      }
+      m_min_waited_present_id.store(m_waiters != nullptr ? m_waiters->present_id : UINT64_MAX);
+      return VK_TIMEOUT;
+   }
+
+   if (m_present_id.load(std::memory_order_relaxed) >= present_id)
    {
-      assert(value > m_present_id);
-      m_present_id = value;
+      return VK_SUCCESS;
    }
+   return m_error_state.load(std::memory_order_relaxed);
 }
 
-};
+} /* namespace wsi */
@@ -30,6 +30,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
 #include <util/custom_allocator.hpp>
 #include <util/macros.hpp>
 
@@ -42,7 +46,10 @@ namespace wsi
  * @brief Present ID extension class
  *
  * This class defines the present ID extension
- * features.
+ * features, including waiting for presents as defined by VK_KHR_present_wait.
+ *
+ * The present ID only increases. Threads waiting for a present ID sleep on their own futex word, and are kept in a
+ * list sorted by the ID they wait for, so that advancing the present ID only wakes the threads whose wait is over.
  */
 class wsi_ext_present_id : public wsi_ext
 {
@@ -50,20 +57,80 @@ public:
    /**
     * @brief The name of the extension.
     */
-   WSI_DEFINE_EXTENSION(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+   WSI_DEFINE_EXTENSION(VK_KHR_PRESENT_ID_EXTENSION_NAME, present_id);
 
    /**
     * @brief Set the present ID for the swapchain.
     *
-    * @param value Value to set for the present_id.
+    * Called by the presentation engine once the presentation with the present ID @p value is complete, which also
+    * completes the presentations with a lower present ID. Can be called from any thread.
+    *
+    * @param value Value to set for the present_id. Values not higher than the current present ID are ignored.
     */
    void set_present_id(uint64_t value);
 
+   /**
+    * @brief Stop the waits for presentations that will not complete anymore.
+    *
+    * @param error Error returned by the current and future waits for presentations that have not completed.
+    */
+   void set_error_state(VkResult error);
+
+   /**
+    * @brief Implementation of the vkWaitForPresentKHR entrypoint.
+    *
+    * @param present_id The present ID to wait for.
+    * @param timeout    Time to wait (ns). UINT64_MAX waits indefinitely.
+    *
+    * @return VK_SUCCESS once the present ID has been reached, VK_TIMEOUT if the timeout was reached first, or the
+    * error given to @ref set_error_state.
+    */
+   VkResult wait_for_present(uint64_t present_id, uint64_t timeout);
+
 private:
+   /**
+    * @brief A thread waiting in @ref wait_for_present, allocated on its stack.
+    */
+   struct present_waiter
+   {
+      uint64_t present_id;
+      /* Futex word, set to 1 once the waiter has been removed from the list by a waker. */
+      std::atomic<uint32_t> woken{ 0 };
+      present_waiter *prev{ nullptr };
+      present_waiter *next{ nullptr };
+   };
+
+   /**
+    * @brief Wake the waiters up to @p present_id, with @ref m_waiters_mutex held.
+    */
+   void wake_waiters_locked(uint64_t present_id);
+
    /**
     * @brief Current present ID for this swapchain.
     */
-   uint64_t m_present_id{ 0 };
+   std::atomic<uint64_t> m_present_id{ 0 };
+
+   /**
+    * @brief Lowest present ID waited for, UINT64_MAX without waiters.
+    *
+    * Lets @ref set_present_id skip taking @ref m_waiters_mutex when no wait is over.
+    */
+   std::atomic<uint64_t> m_min_waited_present_id{ UINT64_MAX };
+
+   /**
+    * @brief Error set by @ref set_error_state, VK_SUCCESS while presentations can still complete.
+    */
+   std::atomic<VkResult> m_error_state{ VK_SUCCESS };
+
+   /**
+    * @brief Protects @ref m_waiters.
+    */
+   std::mutex m_waiters_mutex;
+
+   /**
+    * @brief The waiters, sorted by the present ID they wait for.
+    */
+   present_waiter *m_waiters{ nullptr };
 };
 
 } /* namespace wsi */
@@ -28,6 +28,8 @@
  * @brief Contains the implentation for the VK_EXT_present_timing extension.
  */
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
 #include <wsi/swapchain_base.hpp>
 
 #include "present_timing.hpp"
@@ -36,6 +38,124 @@
 namespace wsi
 {
 
+/**
+ * @brief Smallest number of slots allocated for a timings queue.
+ */
+static constexpr size_t MIN_TIMINGS_QUEUE_CAPACITY = 8;
+
+timings_queue::timings_queue(const util::allocator &allocator)
+   : m_allocator(allocator, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE)
+{
+}
+
+timings_queue::~timings_queue()
+{
+   m_allocator.destroy(m_capacity, m_slots);
+}
+
+VkResult timings_queue::set_size(size_t queue_size)
+{
+   const size_t num_outstanding = outstanding();
+   if (num_outstanding > queue_size)
+   {
+      return VK_NOT_READY;
+   }
+
+   if (queue_size > m_capacity)
+   {
+      /* The presentation engine may complete an outstanding entry at any time, so it can't be moved. */
+      if (num_outstanding != 0)
+      {
+         return VK_NOT_READY;
+      }
+
+      size_t capacity = MIN_TIMINGS_QUEUE_CAPACITY;
+      while (capacity < queue_size)
+      {
+         capacity *= 2;
+      }
+
+      auto *slots = m_allocator.create<swapchain_presentation_entry>(capacity);
+      if (slots == nullptr)
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+
+      m_allocator.destroy(m_capacity, m_slots);
+      m_slots = slots;
+      m_capacity = capacity;
+   }
+
+   m_size = queue_size;
+   return VK_SUCCESS;
+}
+
+size_t timings_queue::outstanding() const
+{
+   return static_cast<size_t>(m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire));
+}
+
+bool timings_queue::full() const
+{
+   return outstanding() >= m_size;
+}
+
+uint64_t timings_queue::push(uint64_t present_id, VkPresentStageFlagsEXT stage_queries)
+{
+   const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+   /* Acquire so the application has finished reading the slot before it is reused. */
+   if (tail - m_head.load(std::memory_order_acquire) >= m_size)
+   {
+      return 0;
+   }
+
+   auto &slot = m_slots[tail & (m_capacity - 1)];
+   slot.is_complete.store(false, std::memory_order_relaxed);
+   slot.present_id = present_id;
+   slot.stage_queries = stage_queries;
+   slot.reported_stages = 0;
+   slot.present_time = 0;
+   slot.refresh_duration = 0;
+   slot.flags = 0;
+   slot.sequence.store(tail, std::memory_order_release);
+
+   m_tail.store(tail + 1, std::memory_order_release);
+   return tail;
+}
+
+void timings_queue::complete(uint64_t sequence, VkPresentStageFlagsEXT stages, uint64_t present_time,
+                             uint64_t refresh_duration, uint32_t flags)
+{
+   auto &slot = m_slots[sequence & (m_capacity - 1)];
+   if (slot.sequence.load(std::memory_order_acquire) != sequence || slot.is_complete.load(std::memory_order_relaxed))
+   {
+      return;
+   }
+
+   slot.reported_stages = stages;
+   slot.present_time = present_time;
+   slot.refresh_duration = refresh_duration;
+   slot.flags = flags;
+   slot.is_complete.store(true, std::memory_order_release);
+}
+
+const swapchain_presentation_entry *timings_queue::peek_complete(size_t offset) const
+{
+   const uint64_t sequence = m_head.load(std::memory_order_relaxed) + offset;
+   if (sequence >= m_tail.load(std::memory_order_acquire))
+   {
+      return nullptr;
+   }
+
+   const auto &slot = m_slots[sequence & (m_capacity - 1)];
+   return slot.is_complete.load(std::memory_order_acquire) ? &slot : nullptr;
+}
+
+void timings_queue::pop_complete(size_t count)
+{
+   m_head.store(m_head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+}
+
 wsi_ext_present_timing::wsi_ext_present_timing(const util::allocator &allocator)
    : m_allocator(allocator)
    , m_queue(allocator)
@@ -49,52 +169,181 @@ wsi_ext_present_timing::~wsi_ext_present_timing()
 
 VkResult wsi_ext_present_timing::present_timing_queue_set_size(size_t queue_size)
 {
-   if (present_timing_get_num_outstanding_results() > queue_size)
+   return m_queue.set_size(queue_size);
+}
+
+size_t wsi_ext_present_timing::present_timing_get_num_outstanding_results()
+{
+   return m_queue.outstanding();
+}
+
+bool wsi_ext_present_timing::present_timing_queue_full()
+{
+   return m_queue.full();
+}
+
+VkResult wsi_ext_present_timing::add_presentation_entry(uint64_t present_id, VkPresentStageFlagsEXT stage_queries,
+                                                        uint64_t &timing_slot)
+{
+   timing_slot = m_queue.push(present_id, stage_queries);
+   if (timing_slot == 0)
    {
-      return VK_NOT_READY;
+      return VK_ERROR_PRESENT_TIMING_QUEUE_FULL_EXT;
+   }
+   return VK_SUCCESS;
+}
+
+void wsi_ext_present_timing::complete_presentation_entry(uint64_t timing_slot, VkPresentStageFlagsEXT stages,
+                                                         uint64_t present_time, uint64_t refresh_duration,
+                                                         uint32_t flags)
+{
+   if (timing_slot != 0)
+   {
+      m_queue.complete(timing_slot, stages, present_time, refresh_duration, flags);
    }
+}
+
+/**
+ * @brief Fill in the past presentation timing of a complete entry.
+ *
+ * The queried stages the presentation engine did not report have a time of 0.
+ */
+static void write_past_presentation_timing(const swapchain_presentation_entry &entry,
+                                           swapchain_time_domains &time_domains, VkPastPresentationTimingEXT &timing)
+{
+   timing.presentId = entry.present_id;
+   timing.reportComplete = VK_TRUE;
 
-   util::vector<swapchain_presentation_entry> presentation_timing(
-      util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE));
-   if (!presentation_timing.try_reserve(queue_size))
+   /* The times are those of the stages the presentation engine reported, in the domain of the first of them. */
+   const VkPresentStageFlagsEXT stages = entry.reported_stages != 0 ? entry.reported_stages : entry.stage_queries;
+   if (!time_domains.get_time_domain(stages & (~stages + 1), timing.timeDomain, timing.timeDomainId))
    {
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
+      timing.timeDomain = VK_TIME_DOMAIN_PRESENT_STAGE_LOCAL_EXT;
+      timing.timeDomainId = 0;
    }
-   for (auto iter : m_queue.m_timings)
+
+   uint32_t stage_count = 0;
+   for (VkPresentStageFlagsEXT stage = VK_PRESENT_STAGE_QUEUE_OPERATIONS_END_BIT_EXT;
+        stage <= VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_VISIBLE_BIT_EXT; stage <<= 1)
    {
-      if (iter.is_outstanding)
+      if ((entry.stage_queries & stage) == 0)
+      {
+         continue;
+      }
+
+      if (timing.pPresentStages != nullptr)
       {
-         if (!presentation_timing.try_push_back(iter))
+         if (stage_count == timing.presentStageCount)
          {
-            return VK_ERROR_OUT_OF_HOST_MEMORY;
+            break;
          }
+         timing.pPresentStages[stage_count].stage = stage;
+         timing.pPresentStages[stage_count].time = (entry.reported_stages & stage) != 0 ? entry.present_time : 0;
       }
+      stage_count++;
    }
-   m_queue.m_timings.swap(presentation_timing);
-   return VK_SUCCESS;
+   timing.presentStageCount = stage_count;
 }
 
-size_t wsi_ext_present_timing::present_timing_get_num_outstanding_results()
+VkResult wsi_ext_present_timing::get_past_presentation_timing(
+   VkPastPresentationTimingPropertiesEXT &past_timing_properties)
 {
-   size_t num_outstanding = 0;
+   VkSwapchainTimingPropertiesEXT timing_properties = {};
+   TRY(get_swapchain_timing_properties(past_timing_properties.timingPropertiesCounter, timing_properties));
+   TRY(m_time_domains.get_swapchain_time_domain_properties(nullptr, &past_timing_properties.timeDomainsCounter));
 
-   for (const auto &iter : m_queue.m_timings)
+   if (past_timing_properties.pPresentationTimings == nullptr)
    {
-      if (iter.is_outstanding)
+      uint32_t num_complete = 0;
+      while (m_queue.peek_complete(num_complete) != nullptr)
       {
-         num_outstanding++;
+         num_complete++;
       }
+      past_timing_properties.presentationTimingCount = num_complete;
+      return VK_SUCCESS;
    }
-   return num_outstanding;
+
+   uint32_t num_written = 0;
+   for (; num_written < past_timing_properties.presentationTimingCount; num_written++)
+   {
+      const auto *entry = m_queue.peek_complete(num_written);
+      if (entry == nullptr)
+      {
+         break;
+      }
+      write_past_presentation_timing(*entry, m_time_domains, past_timing_properties.pPresentationTimings[num_written]);
+   }
+
+   m_queue.pop_complete(num_written);
+   past_timing_properties.presentationTimingCount = num_written;
+
+   return m_queue.peek_complete(0) != nullptr ? VK_INCOMPLETE : VK_SUCCESS;
 }
 
-VkResult wsi_ext_present_timing::add_presentation_entry(const wsi::swapchain_presentation_entry &presentation_entry)
+/**
+ * @brief Number of readings a calibration keeps the tightest of.
+ */
+static constexpr int CLOCK_CALIBRATION_ATTEMPTS = 4;
+
+static uint64_t read_clock_ns(clockid_t clock_id)
+{
+   timespec now = {};
+   clock_gettime(clock_id, &now);
+   return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+}
+
+clock_calibration::clock_calibration(clockid_t clock_id)
+   : m_clock_id(clock_id)
+{
+}
+
+void clock_calibration::sample(uint64_t &monotonic_time, int64_t &offset) const
 {
-   if (!m_queue.m_timings.try_push_back(presentation_entry))
+   uint64_t best_width = UINT64_MAX;
+   for (int attempt = 0; attempt < CLOCK_CALIBRATION_ATTEMPTS; attempt++)
    {
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
+      const uint64_t before = read_clock_ns(CLOCK_MONOTONIC);
+      const uint64_t time = read_clock_ns(m_clock_id);
+      const uint64_t after = read_clock_ns(CLOCK_MONOTONIC);
+      if (after - before < best_width)
+      {
+         /* The clock was read somewhere between the two readings of CLOCK_MONOTONIC, most likely halfway. */
+         best_width = after - before;
+         monotonic_time = before + best_width / 2;
+         offset = static_cast<int64_t>(time - monotonic_time);
+      }
    }
-   return VK_SUCCESS;
+}
+
+int64_t clock_calibration::extrapolate(uint64_t monotonic_time) const
+{
+   const auto elapsed = static_cast<int64_t>(monotonic_time - m_base_time);
+   return m_base_offset + static_cast<int64_t>(std::llround(m_drift * static_cast<double>(elapsed)));
+}
+
+int64_t clock_calibration::get_offset(uint64_t monotonic_time)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   if (!m_calibrated || static_cast<int64_t>(monotonic_time - m_base_time) >= static_cast<int64_t>(REFRESH_PERIOD_NS))
+   {
+      uint64_t time = 0;
+      int64_t offset = 0;
+      sample(time, offset);
+      if (m_calibrated && std::llabs(offset - extrapolate(time)) <= DEVIATION_BOUND_NS)
+      {
+         m_drift = static_cast<double>(offset - m_base_offset) / static_cast<double>(time - m_base_time);
+      }
+      else
+      {
+         /* First calibration, or the clock jumped: the offset is only valid from now on. */
+         m_drift = 0.0;
+      }
+      m_base_time = time;
+      m_base_offset = offset;
+      m_calibrated = true;
+   }
+
+   return extrapolate(monotonic_time);
 }
 
 swapchain_time_domains &wsi_ext_present_timing::get_swapchain_time_domains()
@@ -117,6 +366,42 @@ VkResult swapchain_time_domains::calibrate(VkPresentStageFlagBitsEXT present_sta
    return VK_ERROR_OUT_OF_HOST_MEMORY;
 }
 
+uint64_t swapchain_time_domains::get_time_domain_id(VkTimeDomainKHR time_domain)
+{
+   uint64_t id = 0;
+   for (size_t i = 0; i < m_time_domains.size(); i++)
+   {
+      const VkTimeDomainKHR domain = m_time_domains[i]->calibrate().time_domain;
+      if (domain == time_domain)
+      {
+         return id;
+      }
+
+      bool seen = false;
+      for (size_t j = 0; j < i; j++)
+      {
+         seen = seen || m_time_domains[j]->calibrate().time_domain == domain;
+      }
+      id += seen ? 0 : 1;
+   }
+   return id;
+}
+
+bool swapchain_time_domains::get_time_domain(VkPresentStageFlagsEXT present_stage, VkTimeDomainKHR &time_domain,
+                                             uint64_t &time_domain_id)
+{
+   for (auto &domain : m_time_domains)
+   {
+      if ((domain->get_present_stages() & present_stage) != 0)
+      {
+         time_domain = domain->calibrate().time_domain;
+         time_domain_id = get_time_domain_id(time_domain);
+         return true;
+      }
+   }
+   return false;
+}
+
 VkResult swapchain_time_domains::get_swapchain_time_domain_properties(
    VkSwapchainTimeDomainPropertiesEXT *pSwapchainTimeDomainProperties, uint64_t *pTimeDomainsCounter)
 {
@@ -125,22 +410,32 @@ VkResult swapchain_time_domains::get_swapchain_time_domain_properties(
       *pTimeDomainsCounter = 1;
    }
 
-   if (pSwapchainTimeDomainProperties != nullptr)
+   /* Stages sharing a time domain report it once. */
+   uint32_t domain_count = 0;
+   for (size_t i = 0; i < m_time_domains.size(); i++)
    {
-      if ((pSwapchainTimeDomainProperties->pTimeDomains == nullptr &&
-           pSwapchainTimeDomainProperties->pTimeDomainIds == nullptr) ||
-          pSwapchainTimeDomainProperties->timeDomainCount == 0)
+      const VkTimeDomainKHR domain = m_time_domains[i]->calibrate().time_domain;
+      if (get_time_domain_id(domain) != domain_count)
       {
-         pSwapchainTimeDomainProperties->timeDomainCount = 1;
+         continue;
       }
-      else
+
+      if (pSwapchainTimeDomainProperties != nullptr && pSwapchainTimeDomainProperties->pTimeDomains != nullptr &&
+          pSwapchainTimeDomainProperties->pTimeDomainIds != nullptr)
       {
-         /* Since we only have a single time domain available we don't need to check
-          * timeDomainCount since it can only be >= 1 */
-         pSwapchainTimeDomainProperties->timeDomainCount = 1;
-         pSwapchainTimeDomainProperties->pTimeDomains[0] = VK_TIME_DOMAIN_PRESENT_STAGE_LOCAL_EXT;
-         pSwapchainTimeDomainProperties->pTimeDomainIds[0] = 0;
+         if (domain_count == pSwapchainTimeDomainProperties->timeDomainCount)
+         {
+            return VK_INCOMPLETE;
+         }
+         pSwapchainTimeDomainProperties->pTimeDomains[domain_count] = domain;
+         pSwapchainTimeDomainProperties->pTimeDomainIds[domain_count] = domain_count;
       }
+      domain_count++;
+   }
+
+   if (pSwapchainTimeDomainProperties != nullptr)
+   {
+      pSwapchainTimeDomainProperties->timeDomainCount = domain_count;
    }
 
    return VK_SUCCESS;
@@ -33,10 +33,15 @@
 
 #include <layer/wsi_layer_experimental.hpp>
 #include <util/custom_allocator.hpp>
+#include <util/helpers.hpp>
 #include <util/macros.hpp>
 
+#include <atomic>
+#include <ctime>
 #include <iterator>
+#include <mutex>
 #include <type_traits>
+#include <utility>
 
 #include "wsi_extension.hpp"
 
@@ -47,35 +52,191 @@ namespace wsi
 /**
  * @brief Swapchain presentation entry
  *
- * This structure is used to keep the parameters for the swapchain presentation entry.
+ * A slot of the present timing queue, holding the timing of one presentation.
  *
  */
 struct swapchain_presentation_entry
 {
    /**
-    * Whether this entry is an outstanding result or not.
+    * Sequence number of the presentation held by the slot, 0 if the slot was never used.
     */
-   bool is_outstanding{ false };
+   std::atomic<uint64_t> sequence{ 0 };
+   /**
+    * Whether the presentation engine has reported the timing of this entry. The fields below are only read by the
+    * application thread after this has been set.
+    */
+   std::atomic<bool> is_complete{ false };
    /**
     * The present id.
     */
    uint64_t present_id{ 0 };
+   /**
+    * The present stages the application asked the timing for.
+    */
+   VkPresentStageFlagsEXT stage_queries{ 0 };
+   /**
+    * The present stages reported by the presentation engine.
+    */
+   VkPresentStageFlagsEXT reported_stages{ 0 };
+   /**
+    * Time the image reached the reported present stages, or 0 if it was never displayed.
+    */
+   uint64_t present_time{ 0 };
+   /**
+    * Refresh duration of the output at the time of the presentation in nanoseconds, or 0 if unknown.
+    */
+   uint64_t refresh_duration{ 0 };
+   /**
+    * Backend specific flags describing how the image was presented.
+    */
+   uint32_t flags{ 0 };
 };
 
 /**
  * @brief Timings queue
  *
- * This structure is used to keep the parameters related to the presentation timing queue.
+ * Fixed capacity ring of the presentation entries, in the order of the presentations. Entries are pushed by the
+ * thread presenting to the swapchain, completed by the presentation engine from any thread using the sequence number
+ * returned when they were pushed, and popped by the application once complete. None of these take a lock.
  *
+ * Sequence numbers start at 1, so 0 can be used for presentations without an entry. The entry of sequence number s
+ * is in slot s & (capacity - 1).
  */
-struct timings_queue
+class timings_queue : private util::noncopyable
 {
-   timings_queue(const util::allocator &allocator)
-      : m_timings(allocator)
-   {
-   }
+public:
+   timings_queue(const util::allocator &allocator);
+
+   ~timings_queue();
+
+   /**
+    * @brief Set the maximum number of entries of the queue.
+    *
+    * Must not be called concurrently with @ref push or @ref pop_complete.
+    *
+    * @param queue_size The new queue size.
+    *
+    * @return VK_SUCCESS on success. VK_NOT_READY if there are more outstanding entries than @p queue_size, or if the
+    * slots need to be reallocated while entries are outstanding, as the presentation engine may be completing them.
+    * VK_ERROR_OUT_OF_HOST_MEMORY when the slots could not be allocated.
+    */
+   VkResult set_size(size_t queue_size);
+
+   /**
+    * @brief Get the number of entries pushed and not popped yet.
+    */
+   size_t outstanding() const;
+
+   /**
+    * @brief Check whether @ref push would fail.
+    */
+   bool full() const;
+
+   /**
+    * @brief Push the entry of a presentation.
+    *
+    * @param present_id    The present id of the presentation.
+    * @param stage_queries The present stages to report the timing of.
+    *
+    * @return The sequence number of the entry, or 0 if the queue is full.
+    */
+   uint64_t push(uint64_t present_id, VkPresentStageFlagsEXT stage_queries);
+
+   /**
+    * @brief Record the timing of an outstanding entry. Entries that are not outstanding are ignored.
+    *
+    * @param sequence         The sequence number returned by @ref push.
+    * @param stages           The present stages @p present_time applies to.
+    * @param present_time     Time the image reached @p stages, or 0 if it was discarded.
+    * @param refresh_duration Refresh duration of the output in nanoseconds, or 0 if unknown.
+    * @param flags            Backend specific flags describing how the image was presented.
+    */
+   void complete(uint64_t sequence, VkPresentStageFlagsEXT stages, uint64_t present_time, uint64_t refresh_duration,
+                 uint32_t flags);
+
+   /**
+    * @brief Get the oldest entry if it is complete.
+    *
+    * @param offset Number of complete entries after the oldest one to skip.
+    *
+    * @return The entry, or nullptr if there are not more than @p offset complete entries at the front of the queue.
+    */
+   const swapchain_presentation_entry *peek_complete(size_t offset) const;
+
+   /**
+    * @brief Pop entries returned by @ref peek_complete.
+    *
+    * @param count Number of entries to pop.
+    */
+   void pop_complete(size_t count);
+
+private:
+   util::allocator m_allocator;
+
+   /**
+    * @brief The slots, a power of two number of them.
+    */
+   swapchain_presentation_entry *m_slots{ nullptr };
+   size_t m_capacity{ 0 };
+
+   /**
+    * @brief Maximum number of outstanding entries, as set by the application.
+    */
+   size_t m_size{ 0 };
 
-   util::vector<swapchain_presentation_entry> m_timings;
+   /**
+    * @brief Sequence number of the oldest outstanding entry, and the one after the newest.
+    */
+   std::atomic<uint64_t> m_head{ 1 };
+   std::atomic<uint64_t> m_tail{ 1 };
+};
+
+/**
+ * @brief Cached calibration of a clock against CLOCK_MONOTONIC.
+ *
+ * Reading two clocks is not atomic, so a calibration reads CLOCK_MONOTONIC before and after the clock and keeps the
+ * tightest of a few attempts. The offset and the drift measured between two calibrations are then extrapolated, and
+ * the clocks are only read again once @ref REFRESH_PERIOD_NS has elapsed. A calibration deviating from the
+ * extrapolation by more than @ref DEVIATION_BOUND_NS, such as after the clock was stepped, discards the drift.
+ */
+class clock_calibration : private util::noncopyable
+{
+public:
+   static constexpr uint64_t REFRESH_PERIOD_NS = 1000000000;
+   static constexpr int64_t DEVIATION_BOUND_NS = 50000;
+
+   explicit clock_calibration(clockid_t clock_id);
+
+   /**
+    * @brief Get the offset from CLOCK_MONOTONIC to the clock.
+    *
+    * Only reads the clocks when the calibration needs to be refreshed, otherwise it is pure arithmetic.
+    *
+    * @param monotonic_time CLOCK_MONOTONIC time the offset is needed at.
+    *
+    * @return The time of the clock minus the time of CLOCK_MONOTONIC at @p monotonic_time.
+    */
+   int64_t get_offset(uint64_t monotonic_time);
+
+private:
+   /**
+    * @brief Read the clock and CLOCK_MONOTONIC as close together as possible.
+    *
+    * @param[out] monotonic_time CLOCK_MONOTONIC time of the reading.
+    * @param[out] offset         Offset from CLOCK_MONOTONIC to the clock at @p monotonic_time.
+    */
+   void sample(uint64_t &monotonic_time, int64_t &offset) const;
+
+   int64_t extrapolate(uint64_t monotonic_time) const;
+
+   const clockid_t m_clock_id;
+   std::mutex m_lock;
+   bool m_calibrated{ false };
+   /** CLOCK_MONOTONIC time and offset of the last calibration. */
+   uint64_t m_base_time{ 0 };
+   int64_t m_base_offset{ 0 };
+   /** Change of the offset per nanosecond of CLOCK_MONOTONIC. */
+   double m_drift{ 0.0 };
 };
 
 // Predefined struct for calibrated time
@@ -158,7 +319,24 @@ public:
    VkResult get_swapchain_time_domain_properties(VkSwapchainTimeDomainPropertiesEXT *pSwapchainTimeDomainProperties,
                                                  uint64_t *pTimeDomainsCounter);
 
+   /**
+    * @brief Get the time domain the times of a present stage are reported in.
+    *
+    * @param present_stage  The present stage.
+    * @param time_domain    Set to the time domain of the stage.
+    * @param time_domain_id Set to the id of the time domain, as reported by @ref get_swapchain_time_domain_properties.
+    *
+    * @return true on success, false if no time domain covers the stage.
+    */
+   bool get_time_domain(VkPresentStageFlagsEXT present_stage, VkTimeDomainKHR &time_domain,
+                        uint64_t &time_domain_id);
+
 private:
+   /**
+    * @brief Get the id of a time domain, which is its index among the distinct domains of @ref m_time_domains.
+    */
+   uint64_t get_time_domain_id(VkTimeDomainKHR time_domain);
+
    util::vector<util::unique_ptr<swapchain_time_domain>> m_time_domains;
 };
 
@@ -174,13 +352,19 @@ public:
    /**
     * @brief The name of the extension.
     */
-   WSI_DEFINE_EXTENSION(VK_EXT_PRESENT_TIMING_EXTENSION_NAME);
+   WSI_DEFINE_EXTENSION(VK_EXT_PRESENT_TIMING_EXTENSION_NAME, present_timing);
 
-   template <typename T, std::size_t N>
+   template <typename T, std::size_t N, typename... Args>
    static util::unique_ptr<T> create(const util::allocator &allocator,
-                                     std::array<util::unique_ptr<wsi::vulkan_time_domain>, N> &domains)
+                                     std::array<util::unique_ptr<wsi::vulkan_time_domain>, N> &domains,
+                                     Args &&...args)
    {
-      auto present_timing = allocator.make_unique<T>(allocator);
+      auto present_timing = allocator.make_unique<T>(allocator, std::forward<Args>(args)...);
+      if (present_timing == nullptr)
+      {
+         return nullptr;
+      }
+
       for (auto &domain : domains)
       {
          if (!present_timing->get_swapchain_time_domains().add_time_domain(std::move(domain)))
@@ -212,7 +396,8 @@ public:
     *
     * @return VK_SUCCESS on if the queue size was updated correctly.
     * VK_NOT_READY when the number of present timing outstanding
-    * items are larger than the queue size. VK_ERROR_OUT_OF_HOST_MEMORY
+    * items are larger than the queue size, or when the queue needs to
+    * grow while items are outstanding. VK_ERROR_OUT_OF_HOST_MEMORY
     * when there is no host memory available for the new size.
     */
    VkResult present_timing_queue_set_size(size_t queue_size);
@@ -226,17 +411,50 @@ public:
     */
    size_t present_timing_get_num_outstanding_results();
 
+   /**
+    * @brief Check whether a presentation entry can be added to the present timing queue.
+    *
+    * @return true if @ref add_presentation_entry would fail with VK_ERROR_PRESENT_TIMING_QUEUE_FULL_EXT.
+    */
+   bool present_timing_queue_full();
+
    /**
     * @brief Add a presentation entry to the present timing queue.
     *
-    * This API pushes a presentation entry to the present timing queue.
+    * @param present_id    The present id of the presentation.
+    * @param stage_queries The present stages the application asked the timing for.
+    * @param[out] timing_slot Set to the slot the presentation engine completes the entry with.
+    *
+    * @return VK_SUCCESS when the entry was inserted successfully and VK_ERROR_PRESENT_TIMING_QUEUE_FULL_EXT
+    * when the queue is full.
+    */
+   VkResult add_presentation_entry(uint64_t present_id, VkPresentStageFlagsEXT stage_queries, uint64_t &timing_slot);
+
+   /**
+    * @brief Record the timing reported by the presentation engine for a presentation entry.
+    *
+    * Can be called from any thread, once per entry.
+    *
+    * @param timing_slot      The slot of the entry, as set by @ref add_presentation_entry. Does nothing if 0.
+    * @param stages           The present stages @p present_time applies to, 0 if the image was discarded.
+    * @param present_time     Time the image reached @p stages, or 0 if it was discarded.
+    * @param refresh_duration Refresh duration of the output in nanoseconds, or 0 if unknown.
+    * @param flags            Backend specific flags describing how the image was presented.
+    */
+   void complete_presentation_entry(uint64_t timing_slot, VkPresentStageFlagsEXT stages, uint64_t present_time,
+                                    uint64_t refresh_duration, uint32_t flags);
+
+   /**
+    * @brief Implementation of the vkGetPastPresentationTimingEXT entrypoint.
+    *
+    * Returns the complete entries in presentation order and removes them from the queue.
     *
-    * @param sc_presentation_entry Reference to the presentation entry to be added.
+    * @param past_timing_properties The properties to fill in.
     *
-    * @return VK_SUCCESS when the entry was inserted successfully and VK_ERROR_OUT_OF_HOST_MEMORY
-    * when there is no host memory.
+    * @return VK_SUCCESS, or VK_INCOMPLETE if not all the complete entries fit in the array of
+    * @p past_timing_properties.
     */
-   VkResult add_presentation_entry(const wsi::swapchain_presentation_entry &sc_presentation_entry);
+   VkResult get_past_presentation_timing(VkPastPresentationTimingPropertiesEXT &past_timing_properties);
 
    /**
     * @brief Get the swapchain time domains
@@ -57,9 +57,17 @@ VkResult wsi_ext_swapchain_maintenance1::handle_switching_presentation_mode(VkPr
    return VK_SUCCESS;
 }
 
+bool wsi_ext_swapchain_maintenance1::is_present_mode_enabled(VkPresentModeKHR present_mode) const
+{
+   return present_mode == m_present_mode ||
+          std::find(m_present_modes.begin(), m_present_modes.end(), present_mode) != m_present_modes.end();
+}
+
 VkResult wsi_ext_swapchain_maintenance1::handle_swapchain_present_modes_create_info(
    VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info, VkSurfaceKHR surface)
 {
+   m_present_mode = swapchain_create_info->presentMode;
+
    const auto *swapchain_present_modes_create_info = util::find_extension<VkSwapchainPresentModesCreateInfoEXT>(
       VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_MODES_CREATE_INFO_EXT, swapchain_create_info->pNext);
    if (swapchain_present_modes_create_info != nullptr)
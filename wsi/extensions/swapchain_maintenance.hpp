@@ -49,7 +49,7 @@ public:
    /**
     * @brief The name of the extension.
     */
-   WSI_DEFINE_EXTENSION(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+   WSI_DEFINE_EXTENSION(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME, swapchain_maintenance1);
 
    /**
     * @brief Constructor for the wsi_ext_swapchain_maintenance1 class.
@@ -69,6 +69,23 @@ public:
     */
    VkResult handle_switching_presentation_mode(VkPresentModeKHR swapchain_present_mode);
 
+   /**
+    * @brief Get the presentation mode presents currently use, following any switch made by an earlier present.
+    */
+   VkPresentModeKHR get_present_mode() const
+   {
+      return m_present_mode;
+   }
+
+   /**
+    * @brief Check whether the swapchain may present with a presentation mode.
+    *
+    * @param present_mode Presentation mode to check.
+    *
+    * @return true if the swapchain was created with the mode or may switch to it.
+    */
+   bool is_present_mode_enabled(VkPresentModeKHR present_mode) const;
+
    /**
     * @brief If VkSwapchainPresentModesCreateInfoEXT is supplied as part of the pNext chain of VkSwapchainCreateInfoKHR
     * then this function gets the surface properties and checks whether the present modes are compatible and updates the object's present modes.
@@ -105,7 +122,7 @@ private:
    /**
     * @brief Present mode currently being used for this swapchain
     */
-   VkPresentModeKHR m_present_mode;
+   VkPresentModeKHR m_present_mode{ VK_PRESENT_MODE_FIFO_KHR };
 };
 
 } /* namespace wsi */
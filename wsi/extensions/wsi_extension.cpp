@@ -44,20 +44,27 @@ bool wsi_ext_maintainer::add_extension(util::unique_ptr<wsi_ext> extension)
 {
    if (extension)
    {
-      auto it = std::find_if(m_enabled_extensions.begin(), m_enabled_extensions.end(),
-                             [&extension](util::unique_ptr<wsi_ext> &ext) { return ext->is_same_type(*extension); });
-
-      if (it != m_enabled_extensions.end())
+      wsi_ext *&slot = m_slots[static_cast<size_t>(extension->get_slot())];
+      if (slot != nullptr)
       {
          WSI_LOG_WARNING("Adding a duplicate extension (%s) to the extension list.", extension->get_name());
          assert(false && "Adding a duplicate extension to the extension list.");
 
          /* Replace the extension. Preferably this should never happen at runtime. */
+         auto it = std::find_if(m_enabled_extensions.begin(), m_enabled_extensions.end(),
+                                [slot](util::unique_ptr<wsi_ext> &ext) { return ext.get() == slot; });
+         slot = extension.get();
          *it = std::move(extension);
          return true;
       }
 
-      return m_enabled_extensions.try_push_back(std::move(extension));
+      wsi_ext *added = extension.get();
+      if (!m_enabled_extensions.try_push_back(std::move(extension)))
+      {
+         return false;
+      }
+      slot = added;
+      return true;
    }
    return false;
 }
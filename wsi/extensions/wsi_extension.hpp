@@ -31,17 +31,37 @@
 #pragma once
 #include <cstring>
 #include <algorithm>
+#include <array>
+#include <cstdint>
 
 #include "util/custom_allocator.hpp"
 
 namespace wsi
 {
 
-#define WSI_DEFINE_EXTENSION(x)           \
-   static constexpr char ext_name[] = #x; \
-   const char *get_name() const override  \
-   {                                      \
-      return ext_name;                    \
+/**
+ * @brief Slot of each swapchain extension in @ref wsi_ext_maintainer, so that looking an extension up is a single load.
+ */
+enum class wsi_ext_slot : uint32_t
+{
+   present_id,
+   present_timing,
+   frame_boundary,
+   swapchain_maintenance1,
+   image_compression_control,
+   count,
+};
+
+#define WSI_DEFINE_EXTENSION(x, slot)                                     \
+   static constexpr char ext_name[] = #x;                                 \
+   static constexpr wsi::wsi_ext_slot ext_slot = wsi::wsi_ext_slot::slot; \
+   const char *get_name() const override                                  \
+   {                                                                      \
+      return ext_name;                                                    \
+   }                                                                      \
+   wsi::wsi_ext_slot get_slot() const override                            \
+   {                                                                      \
+      return ext_slot;                                                    \
    }
 
 /**
@@ -71,6 +91,11 @@ public:
     */
    virtual const char *get_name() const = 0;
 
+   /**
+    * @brief Get the slot of the extension in @ref wsi_ext_maintainer.
+    */
+   virtual wsi_ext_slot get_slot() const = 0;
+
    /**
     * @brief Checks if the extension is of same type as this one.
     *
@@ -78,10 +103,7 @@ public:
     */
    bool is_same_type(const wsi_ext &extension) const
    {
-      /* The functionality of this relies that the address of the pointers returned by
-       * get_name() function is the same. As long as the derived extension is using
-       * "WSI_DEFINE_EXTENSION" macro, then this should work. */
-      return extension.get_name() == get_name();
+      return extension.get_slot() == get_slot();
    }
 
    /**
@@ -93,10 +115,7 @@ public:
    template <typename T>
    bool is_same_type() const
    {
-      /* The functionality of this relies that the address of the pointers returned by
-       * get_name() function & T::ext_name is the same. As long as the derived extension
-       * is using "WSI_DEFINE_EXTENSION" macro, then this should work. */
-      return T::ext_name == get_name();
+      return T::ext_slot == get_slot();
    }
 };
 
@@ -115,6 +134,11 @@ private:
     */
    util::vector<util::unique_ptr<wsi_ext>> m_enabled_extensions;
 
+   /**
+    * @brief The enabled extensions indexed by their slot, nullptr for the ones that are not enabled.
+    */
+   std::array<wsi_ext *, static_cast<size_t>(wsi_ext_slot::count)> m_slots{};
+
 public:
    /**
     * @brief Constructor for the wsi_ext_maintainer class.
@@ -129,10 +153,7 @@ public:
    template <typename T>
    T *get_extension()
    {
-      auto it = std::find_if(m_enabled_extensions.begin(), m_enabled_extensions.end(),
-                             [](util::unique_ptr<wsi_ext> &ext) { return ext->is_same_type<T>(); });
-
-      return it != m_enabled_extensions.end() ? static_cast<T *>((*it).get()) : nullptr;
+      return static_cast<T *>(m_slots[static_cast<size_t>(T::ext_slot)]);
    }
 
    /**
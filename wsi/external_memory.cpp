@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2022-2024 Arm Limited.
+ * Copyright (c) 2022-2025 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -29,6 +29,7 @@
 #include <unistd.h>
 #include <algorithm>
 
+#include "util/allocation_tracker.hpp"
 #include "util/log.hpp"
 #include "util/helpers.hpp"
 #include "util/drm/drm_utils.hpp"
@@ -51,6 +52,8 @@ external_memory::~external_memory()
       if (memory != VK_NULL_HANDLE)
       {
          device_data.disp.FreeMemory(m_device, memory, m_allocator.get_original_callbacks());
+         const bool dma_buf = m_handle_type == VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+         m_memory_usage->remove_device_memory(m_memory_heaps[plane], m_memory_sizes[plane], dma_buf);
       }
       else if (m_buffer_fds[plane] >= 0)
       {
@@ -63,6 +66,23 @@ external_memory::~external_memory()
    }
 }
 
+void external_memory::move_memory_usage(util::memory_usage &usage)
+{
+   if (m_memory_usage != nullptr && m_memory_usage != &usage)
+   {
+      const bool dma_buf = m_handle_type == VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+      for (uint32_t plane = 0; plane < get_num_planes(); plane++)
+      {
+         if (m_memories[plane] != VK_NULL_HANDLE)
+         {
+            usage.add_device_memory(m_memory_heaps[plane], m_memory_sizes[plane], dma_buf);
+            m_memory_usage->remove_device_memory(m_memory_heaps[plane], m_memory_sizes[plane], dma_buf);
+         }
+      }
+   }
+   m_memory_usage = &usage;
+}
+
 uint32_t external_memory::get_num_planes()
 {
    return m_num_planes;
@@ -110,19 +130,37 @@ VkResult external_memory::import_plane_memories()
          auto it = std::find(std::begin(m_buffer_fds), std::end(m_buffer_fds), m_buffer_fds[plane]);
          if (std::distance(std::begin(m_buffer_fds), it) == static_cast<int>(plane))
          {
-            TRY_LOG_CALL(import_plane_memory(m_buffer_fds[plane], &m_memories[memory_plane]));
+            TRY_LOG_CALL(import_plane_memory(m_buffer_fds[plane], memory_plane, &m_memories[memory_plane]));
             memory_plane++;
          }
       }
       return VK_SUCCESS;
    }
-   return import_plane_memory(m_buffer_fds[0], &m_memories[0]);
+   return import_plane_memory(m_buffer_fds[0], 0, &m_memories[0]);
 }
 
-VkResult external_memory::import_plane_memory(int fd, VkDeviceMemory *memory)
+VkResult external_memory::import_plane_memory(int fd, uint32_t memory_plane, VkDeviceMemory *memory)
 {
+   auto &device_data = layer::device_private_data::get(m_device);
+
+   std::optional<layer::device_private_data::import_memory_source> source = m_memory_source;
+   std::optional<uint32_t> cached_mem_index;
+   if (source.has_value())
+   {
+      source->handle_type = m_handle_type;
+      source->memory_plane = memory_plane;
+      cached_mem_index = device_data.get_import_memory_type(*source);
+   }
+
    uint32_t mem_index = 0;
-   TRY_LOG_CALL(get_fd_mem_type_index(fd, &mem_index));
+   if (cached_mem_index.has_value())
+   {
+      mem_index = *cached_mem_index;
+   }
+   else
+   {
+      TRY_LOG_CALL(get_fd_mem_type_index(fd, &mem_index));
+   }
 
    const off_t fd_size = lseek(fd, 0, SEEK_END);
    if (fd_size < 0)
@@ -142,9 +180,38 @@ VkResult external_memory::import_plane_memory(int fd, VkDeviceMemory *memory)
    alloc_info.allocationSize = static_cast<uint64_t>(fd_size);
    alloc_info.memoryTypeIndex = mem_index;
 
-   auto &device_data = layer::device_private_data::get(m_device);
-   TRY_LOG(device_data.disp.AllocateMemory(m_device, &alloc_info, m_allocator.get_original_callbacks(), memory),
-           "Failed to import device memory");
+   const VkAllocationCallbacks *callbacks = m_allocator.get_original_callbacks();
+   VkResult result = device_data.disp.AllocateMemory(m_device, &alloc_info, callbacks, memory);
+   if (result != VK_SUCCESS && cached_mem_index.has_value())
+   {
+      /* A failed import leaves the fd with the caller, so retry with the memory type reported for this fd. The
+       * import failed for another reason if that is the cached type. */
+      TRY_LOG_CALL(get_fd_mem_type_index(fd, &mem_index));
+      if (mem_index != *cached_mem_index)
+      {
+         WSI_LOG_WARNING("Memory type %u of a previous import does not fit, using memory type %u.",
+                         *cached_mem_index, mem_index);
+         alloc_info.memoryTypeIndex = mem_index;
+         cached_mem_index.reset();
+         result = device_data.disp.AllocateMemory(m_device, &alloc_info, callbacks, memory);
+      }
+   }
+   TRY_LOG(result, "Failed to import device memory");
+
+   if (source.has_value() && !cached_mem_index.has_value())
+   {
+      device_data.set_import_memory_type(*source, mem_index);
+   }
+
+   if (m_memory_usage == nullptr)
+   {
+      m_memory_usage = &device_data.get_memory_usage();
+   }
+   m_memory_sizes[memory_plane] = alloc_info.allocationSize;
+   m_memory_heaps[memory_plane] = device_data.get_memory_heap_index(mem_index);
+   const bool dma_buf = m_handle_type == VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+   m_memory_usage->add_device_memory(m_memory_heaps[memory_plane], m_memory_sizes[memory_plane], dma_buf);
+   WSI_TRACK_DEVICE_ALLOCATION(m_memory_sizes[memory_plane]);
 
    return VK_SUCCESS;
 }
@@ -192,6 +259,19 @@ VkResult external_memory::import_memory_and_bind_swapchain_image(const VkImage &
    return VK_SUCCESS;
 }
 
+VkResult external_memory::import_memory_and_bind_buffer(const VkBuffer &buffer)
+{
+   if (is_disjoint())
+   {
+      WSI_LOG_ERROR("Disjoint memory cannot be bound to a buffer.");
+      return VK_ERROR_FORMAT_NOT_SUPPORTED;
+   }
+
+   TRY_LOG_CALL(import_plane_memories());
+   auto &device_data = layer::device_private_data::get(m_device);
+   return device_data.disp.BindBufferMemory(m_device, buffer, m_memories[0], m_offsets[0]);
+}
+
 VkResult external_memory::fill_image_plane_layouts(util::vector<VkSubresourceLayout> &image_plane_layouts)
 {
    if (!image_plane_layouts.try_resize(get_num_planes()))
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2022-2024 Arm Limited.
+ * Copyright (c) 2022-2025 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -32,12 +32,14 @@
 
 #include <array>
 #include <cstdint>
+#include <optional>
 #include <vulkan/vulkan.h>
 
 #include "wsi/synchronization.hpp"
 #include "layer/private_data.hpp"
 #include "util/custom_allocator.hpp"
 #include "util/helpers.hpp"
+#include "util/memory_usage.hpp"
 
 namespace wsi
 {
@@ -162,6 +164,39 @@ public:
       }
    }
 
+   /**
+    * @brief Describe how the external memory was allocated.
+    *
+    * When set, the memory type found when importing the first image allocated this way is reused for the following
+    * ones, skipping the vkGetMemoryFdPropertiesKHR query.
+    *
+    * @param fourcc           DRM format of the image.
+    * @param modifier         DRM modifier of the image.
+    * @param allocation_flags Flags given to the external allocator.
+    */
+   void set_memory_source(uint32_t fourcc, uint64_t modifier, uint64_t allocation_flags)
+   {
+      m_memory_source = layer::device_private_data::import_memory_source{ m_handle_type, fourcc, modifier,
+                                                                          allocation_flags, 0 };
+   }
+
+   /**
+    * @brief Set the counters the imported memory is recorded in, the ones of the device by default.
+    *
+    * @param usage Counters that must outlive the external memory.
+    */
+   void set_memory_usage(util::memory_usage &usage)
+   {
+      m_memory_usage = &usage;
+   }
+
+   /**
+    * @brief Move the memory already imported to other counters, when the image is taken over by another swapchain.
+    *
+    * @param usage Counters that must outlive the external memory.
+    */
+   void move_memory_usage(util::memory_usage &usage);
+
    /**
     * @brief Binds the external memory to a swapchain image.
     *
@@ -184,6 +219,18 @@ public:
     */
    VkResult import_memory_and_bind_swapchain_image(const VkImage &image);
 
+   /**
+    * @brief Imports the externally allocated memory into the Vulkan framework and binds it to a buffer.
+    *
+    * Only non-disjoint memory can be bound to a buffer, which is bound at the offset of the first plane.
+    *
+    * @param buffer    The buffer, created with the handle type of the memory in VkExternalMemoryBufferCreateInfo.
+    *
+    * @return VK_ERROR_OUT_OF_HOST_MEMORY when out of memory. Other possible values include the result of calling
+    *         VkAllocateMemory/VkBindBufferMemory.
+    */
+   VkResult import_memory_and_bind_buffer(const VkBuffer &buffer);
+
    /**
     * @brief Fills out a list of VkSubresourceLayout for each plane using the stored planes layout data.
     *
@@ -217,7 +264,7 @@ private:
 
    VkResult import_plane_memories(void);
 
-   VkResult import_plane_memory(int fd, VkDeviceMemory *memory);
+   VkResult import_plane_memory(int fd, uint32_t memory_plane, VkDeviceMemory *memory);
 
    std::array<int, MAX_PLANES> m_buffer_fds{ -1, -1, -1, -1 };
    std::array<int, MAX_PLANES> m_strides{ 0, 0, 0, 0 };
@@ -227,8 +274,13 @@ private:
    uint32_t m_num_planes{ 0 };
    uint32_t m_num_memories{ 0 };
    VkExternalMemoryHandleTypeFlagBits m_handle_type{ VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT };
-   const VkDevice &m_device;
-   const util::allocator &m_allocator;
+   std::optional<layer::device_private_data::import_memory_source> m_memory_source;
+   /* Size and heap of the imported memories, as recorded in m_memory_usage. */
+   std::array<uint64_t, MAX_PLANES> m_memory_sizes{ 0, 0, 0, 0 };
+   std::array<uint32_t, MAX_PLANES> m_memory_heaps{ 0, 0, 0, 0 };
+   util::memory_usage *m_memory_usage{ nullptr };
+   const VkDevice m_device;
+   const util::allocator m_allocator;
 };
 
 } // namespace wsi
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file frame_pacer.cpp
+ *
+ * @brief Contains the implementation for estimating when applications should start their frames.
+ */
+
+#include "frame_pacer.hpp"
+
+#include <cerrno>
+#include <time.h>
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+
+namespace wsi
+{
+
+/**
+ * @brief Time the frames aim to complete ahead of the presentation engine taking them, absorbing small variations of
+ *        their duration.
+ */
+static constexpr uint64_t FRAME_START_MARGIN_NS = 1000000;
+
+/**
+ * @brief Longest interval between presents that is taken as the presentation rate, longer ones are pauses.
+ */
+static constexpr uint64_t MAX_PRESENT_INTERVAL_NS = 1000000000;
+
+void frame_pacer::moving_average::add(uint64_t sample)
+{
+   if (value == 0)
+   {
+      value = sample;
+      return;
+   }
+
+   value = value - value / 8 + sample / 8;
+}
+
+void frame_pacer::set_marker(VkLatencyMarkerARM marker, uint64_t time_ns)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   switch (marker)
+   {
+   case VK_LATENCY_MARKER_SIMULATION_START_ARM:
+      m_markers.start_ns = time_ns;
+      break;
+   case VK_LATENCY_MARKER_RENDER_SUBMIT_ARM:
+      m_markers.render_submit_ns = time_ns;
+      break;
+   case VK_LATENCY_MARKER_PRESENT_ARM:
+      m_markers.present_ns = time_ns;
+      break;
+   }
+}
+
+void frame_pacer::record_acquire(uint64_t time_ns)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   if (m_acquire_ns == 0)
+   {
+      m_acquire_ns = time_ns;
+   }
+}
+
+frame_pacer::frame_timings frame_pacer::end_frame(uint64_t present_time_ns)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   frame_timings timings = m_markers;
+   if (timings.start_ns == 0)
+   {
+      timings.start_ns = m_acquire_ns;
+   }
+   if (timings.present_ns == 0)
+   {
+      timings.present_ns = present_time_ns;
+   }
+
+   const uint64_t cpu_end_ns = timings.render_submit_ns != 0 ? timings.render_submit_ns : timings.present_ns;
+   if (timings.start_ns != 0 && cpu_end_ns > timings.start_ns)
+   {
+      m_cpu_time.add(cpu_end_ns - timings.start_ns);
+   }
+
+   m_markers = {};
+   m_acquire_ns = 0;
+   return timings;
+}
+
+void frame_pacer::record_payload_complete(const frame_timings &timings, uint64_t time_ns)
+{
+   if (timings.start_ns == 0 || time_ns <= timings.start_ns)
+   {
+      return;
+   }
+
+   std::lock_guard<std::mutex> lock(m_lock);
+   m_frame_latency.add(time_ns - timings.start_ns);
+}
+
+void frame_pacer::record_present_complete(uint64_t time_ns)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   if (m_last_present_ns != 0 && time_ns > m_last_present_ns && time_ns - m_last_present_ns < MAX_PRESENT_INTERVAL_NS)
+   {
+      m_present_interval.add(time_ns - m_last_present_ns);
+   }
+   m_last_present_ns = time_ns;
+}
+
+uint64_t frame_pacer::get_frame_start_target(uint32_t queued_frames)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   const uint64_t interval = m_present_interval.value;
+   const uint64_t latency = m_frame_latency.value + FRAME_START_MARGIN_NS;
+   if (interval == 0 || m_frame_latency.value == 0 || m_cpu_time.value >= interval)
+   {
+      /* Not enough frames were presented yet, or the application is CPU bound and has no time to spare. */
+      return 0;
+   }
+
+   /* The presentation engine takes the frames queued before the next one at the rate it took the recent ones. */
+   const uint64_t next_present_ns = m_last_present_ns + (static_cast<uint64_t>(queued_frames) + 1) * interval;
+   if (next_present_ns <= latency)
+   {
+      return 0;
+   }
+
+   return next_present_ns - latency;
+}
+
+void frame_pacer::sleep_until(uint64_t time_ns)
+{
+   struct timespec ts = {};
+   ts.tv_sec = static_cast<time_t>(time_ns / 1000000000ULL);
+   ts.tv_nsec = static_cast<long>(time_ns % 1000000000ULL);
+   while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+   {
+   }
+}
+
+} /* namespace wsi */
+
+#endif /* VULKAN_WSI_LAYER_EXPERIMENTAL */
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file frame_pacer.hpp
+ *
+ * @brief Contains the class definition for estimating when applications should start their frames.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+#include "layer/wsi_layer_experimental.hpp"
+#include "util/helpers.hpp"
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+
+namespace wsi
+{
+
+/**
+ * @brief Estimates the optimal time for the application to start its next frame.
+ *
+ * A frame started at the optimal time completes its rendering just before the presentation engine can take it, so
+ * the CPU does not run frames ahead of the display and the input it samples is as recent as possible. The estimate
+ * is based on the latency markers given by the application, on the acquires and presents of the swapchain, and on the
+ * times the frames are handed over to the presentation engine.
+ *
+ * The application threads and the presentation thread update the pacer concurrently, so its state is guarded by a
+ * mutex.
+ */
+class frame_pacer : private util::noncopyable
+{
+public:
+   /**
+    * @brief Times of the points of a frame, as returned by latency_recorder::now(). 0 when not reached.
+    */
+   struct frame_timings
+   {
+      uint64_t start_ns;
+      uint64_t render_submit_ns;
+      uint64_t present_ns;
+   };
+
+   /**
+    * @brief Record a latency marker of the frame the application is working on.
+    */
+   void set_marker(VkLatencyMarkerARM marker, uint64_t time_ns);
+
+   /**
+    * @brief Record that an image was acquired, which starts the frame if no simulation start marker was given.
+    */
+   void record_acquire(uint64_t time_ns);
+
+   /**
+    * @brief End the frame the application is working on, when it is presented.
+    *
+    * @param present_time_ns Time of the present request, used when no present marker was given.
+    *
+    * @return The timings of the frame, to pass to @ref record_payload_complete.
+    */
+   frame_timings end_frame(uint64_t present_time_ns);
+
+   /**
+    * @brief Record that the rendering of a frame completed.
+    */
+   void record_payload_complete(const frame_timings &timings, uint64_t time_ns);
+
+   /**
+    * @brief Record that a frame was handed over to the presentation engine.
+    */
+   void record_present_complete(uint64_t time_ns);
+
+   /**
+    * @brief Get the optimal time to start the next frame.
+    *
+    * @param queued_frames Number of frames presented that the presentation engine has not taken yet.
+    *
+    * @return The time, as returned by latency_recorder::now(), or 0 if the frame should start right away, e.g. when
+    *         there are not enough frames to estimate it or when the CPU time of the frames leaves no room to wait.
+    */
+   uint64_t get_frame_start_target(uint32_t queued_frames);
+
+   /**
+    * @brief Sleep until a time.
+    *
+    * @param time_ns Time to wake up at, as returned by latency_recorder::now().
+    */
+   static void sleep_until(uint64_t time_ns);
+
+private:
+   /**
+    * @brief Exponential moving average of a duration, updated with a weight of 1/8 per sample.
+    */
+   struct moving_average
+   {
+      uint64_t value{ 0 };
+
+      void add(uint64_t sample);
+   };
+
+   std::mutex m_lock;
+
+   /* Points of the frame the application is working on. */
+   uint64_t m_acquire_ns{ 0 };
+   frame_timings m_markers{};
+
+   /* Time from the start of the frames until the end of their CPU work, i.e. their render submit or present. */
+   moving_average m_cpu_time;
+
+   /* Time from the start of the frames until their rendering completed. */
+   moving_average m_frame_latency;
+
+   /* Time between the frames being handed over to the presentation engine, and the last time one was. */
+   moving_average m_present_interval;
+   uint64_t m_last_present_ns{ 0 };
+};
+
+} /* namespace wsi */
+
+#endif /* VULKAN_WSI_LAYER_EXPERIMENTAL */
@@ -0,0 +1,573 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file frame_capture.cpp
+ *
+ * @brief Contains the implementation of the capture of the frames presented to headless swapchains.
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "frame_capture.hpp"
+
+#include <util/allocation_tracker.hpp>
+#include <util/helpers.hpp>
+#include <util/log.hpp>
+
+namespace wsi
+{
+namespace headless
+{
+
+/**
+ * @brief Alignment of the slots of a capture ring file, so that the frames start on a page boundary.
+ */
+static constexpr uint64_t ring_file_alignment = 4096;
+
+static uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+   return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * @brief Select a host visible memory type for the staging buffers, preferring cached memory for fast host reads.
+ */
+static std::optional<uint32_t> select_staging_memory_type(const layer::device_private_data &device_data,
+                                                          uint32_t memory_type_bits)
+{
+   VkPhysicalDeviceMemoryProperties2 memory_props = {};
+   memory_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+   device_data.instance_data.disp.GetPhysicalDeviceMemoryProperties2KHR(device_data.physical_device, &memory_props);
+
+   std::optional<uint32_t> host_visible;
+   for (uint32_t i = 0; i < memory_props.memoryProperties.memoryTypeCount; ++i)
+   {
+      const VkMemoryPropertyFlags flags = memory_props.memoryProperties.memoryTypes[i].propertyFlags;
+      if ((memory_type_bits & (1u << i)) == 0 || (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
+      {
+         continue;
+      }
+
+      if ((flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0)
+      {
+         return i;
+      }
+
+      if (!host_visible.has_value())
+      {
+         host_visible = i;
+      }
+   }
+
+   return host_visible;
+}
+
+frame_capture::frame_capture(layer::device_private_data &device_data, const util::allocator &allocator,
+                             const VkAllocationCallbacks *callbacks, VkFormat format, VkExtent2D extent,
+                             uint32_t texel_size)
+   : m_device_data(device_data)
+   , m_allocator(allocator)
+   , m_callbacks(callbacks)
+   , m_format(format)
+   , m_extent(extent)
+   , m_row_pitch(extent.width * texel_size)
+   , m_frame_size(static_cast<VkDeviceSize>(extent.width) * extent.height * texel_size)
+   , m_invalidate_staging(false)
+   , m_slots(allocator)
+   , m_command_pool(VK_NULL_HANDLE)
+   , m_queue_family_index(0)
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   , m_callback(nullptr)
+   , m_callback_user_data(nullptr)
+#endif
+   , m_ring_file()
+   , m_ring_map(MAP_FAILED)
+   , m_ring_size(0)
+   , m_ring_slot_size(0)
+{
+}
+
+frame_capture::~frame_capture()
+{
+   VkDevice device = m_device_data.device;
+   for (auto &image_slot : m_slots)
+   {
+      if (image_slot.copy_pending)
+      {
+         m_device_data.disp.WaitForFences(device, 1, &image_slot.copy_fence, VK_TRUE, UINT64_MAX);
+      }
+
+      m_device_data.disp.DestroyFence(device, image_slot.copy_fence, m_callbacks);
+      m_device_data.disp.DestroySemaphore(device, image_slot.copy_done, m_callbacks);
+      m_device_data.disp.DestroyBuffer(device, image_slot.buffer, m_callbacks);
+      if (image_slot.memory != VK_NULL_HANDLE)
+      {
+         /* Freeing the memory also unmaps it. */
+         m_device_data.disp.FreeMemory(device, image_slot.memory, m_callbacks);
+      }
+   }
+
+   /* Destroying the pool frees its command buffers. */
+   if (m_command_pool != VK_NULL_HANDLE)
+   {
+      m_device_data.disp.DestroyCommandPool(device, m_command_pool, m_callbacks);
+   }
+
+   if (m_ring_map != MAP_FAILED)
+   {
+      munmap(m_ring_map, m_ring_size);
+   }
+}
+
+bool frame_capture::is_requested(const VkSwapchainCreateInfoKHR &swapchain_create_info)
+{
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   if (util::find_extension<VkSwapchainFrameCaptureCreateInfoARM>(
+          VK_STRUCTURE_TYPE_SWAPCHAIN_FRAME_CAPTURE_CREATE_INFO_ARM, swapchain_create_info.pNext) != nullptr)
+   {
+      return true;
+   }
+#else
+   UNUSED(swapchain_create_info);
+#endif
+
+   return std::getenv("WSI_HEADLESS_CAPTURE_FILE") != nullptr;
+}
+
+util::unique_ptr<frame_capture> frame_capture::create(layer::device_private_data &device_data,
+                                                      const util::allocator &allocator,
+                                                      const VkAllocationCallbacks *callbacks,
+                                                      const VkSwapchainCreateInfoKHR &swapchain_create_info)
+{
+   /* The application keeps rendering to shared presentable images while they are presented. */
+   if (swapchain_create_info.presentMode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR ||
+       swapchain_create_info.presentMode == VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR)
+   {
+      WSI_LOG_WARNING("Frames presented to shared presentable images are not captured.");
+      return nullptr;
+   }
+
+   const uint32_t texel_size = util::get_texel_size(swapchain_create_info.imageFormat);
+   if (texel_size == 0)
+   {
+      WSI_LOG_WARNING("Frames in format %d are not captured.", static_cast<int>(swapchain_create_info.imageFormat));
+      return nullptr;
+   }
+
+   auto capture = allocator.make_unique<frame_capture>(device_data, allocator, callbacks,
+                                                       swapchain_create_info.imageFormat,
+                                                       swapchain_create_info.imageExtent, texel_size);
+   if (capture == nullptr)
+   {
+      return nullptr;
+   }
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   const auto *capture_info = util::find_extension<VkSwapchainFrameCaptureCreateInfoARM>(
+      VK_STRUCTURE_TYPE_SWAPCHAIN_FRAME_CAPTURE_CREATE_INFO_ARM, swapchain_create_info.pNext);
+   if (capture_info != nullptr)
+   {
+      capture->m_callback = capture_info->pfnFrameCaptured;
+      capture->m_callback_user_data = capture_info->pUserData;
+   }
+#endif
+
+   const char *path = std::getenv("WSI_HEADLESS_CAPTURE_FILE");
+   if (path != nullptr && capture->init_ring_file(path) != VK_SUCCESS)
+   {
+      return nullptr;
+   }
+
+   if (capture->init_slots(swapchain_create_info.minImageCount) != VK_SUCCESS)
+   {
+      WSI_LOG_ERROR("Failed to create the frame capture staging buffers.");
+      return nullptr;
+   }
+
+   return capture;
+}
+
+VkResult frame_capture::init_slots(uint32_t image_count)
+{
+   if (!m_slots.try_resize(image_count))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   VkDevice device = m_device_data.device;
+   for (auto &image_slot : m_slots)
+   {
+      VkBufferCreateInfo buffer_info = {};
+      buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      buffer_info.size = m_frame_size;
+      buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+      buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      TRY(m_device_data.disp.CreateBuffer(device, &buffer_info, m_callbacks, &image_slot.buffer));
+
+      VkMemoryRequirements memory_requirements = {};
+      m_device_data.disp.GetBufferMemoryRequirements(device, image_slot.buffer, &memory_requirements);
+      auto memory_type = select_staging_memory_type(m_device_data, memory_requirements.memoryTypeBits);
+      if (!memory_type.has_value())
+      {
+         return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+      }
+
+      VkPhysicalDeviceMemoryProperties2 memory_props = {};
+      memory_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+      m_device_data.instance_data.disp.GetPhysicalDeviceMemoryProperties2KHR(m_device_data.physical_device,
+                                                                             &memory_props);
+      const VkMemoryPropertyFlags flags = memory_props.memoryProperties.memoryTypes[*memory_type].propertyFlags;
+      if ((flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
+      {
+         m_invalidate_staging = true;
+      }
+
+      VkMemoryAllocateInfo memory_info = {};
+      memory_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      memory_info.allocationSize = memory_requirements.size;
+      memory_info.memoryTypeIndex = *memory_type;
+      TRY(m_device_data.disp.AllocateMemory(device, &memory_info, m_callbacks, &image_slot.memory));
+      WSI_TRACK_DEVICE_ALLOCATION(memory_info.allocationSize);
+      TRY(m_device_data.disp.BindBufferMemory(device, image_slot.buffer, image_slot.memory, 0));
+      TRY(m_device_data.disp.MapMemory(device, image_slot.memory, 0, VK_WHOLE_SIZE, 0, &image_slot.mapped));
+
+      VkSemaphoreCreateInfo semaphore_info = {};
+      semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      TRY(m_device_data.disp.CreateSemaphore(device, &semaphore_info, m_callbacks, &image_slot.copy_done));
+
+      VkFenceCreateInfo fence_info = {};
+      fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+      TRY(m_device_data.disp.CreateFence(device, &fence_info, m_callbacks, &image_slot.copy_fence));
+   }
+
+   return VK_SUCCESS;
+}
+
+VkResult frame_capture::init_ring_file(const char *path)
+{
+   m_ring_slot_size = align_up(sizeof(capture_frame_header) + m_frame_size, ring_file_alignment);
+   const uint64_t slots_offset = align_up(sizeof(capture_file_header), ring_file_alignment);
+   m_ring_size = slots_offset + HEADLESS_CAPTURE_RING_SLOTS * m_ring_slot_size;
+
+   /* Fill a new file and rename it over the path, so that readers of a previous file are not cut off. */
+   char temp_path[PATH_MAX];
+   if (snprintf(temp_path, sizeof(temp_path), "%s.XXXXXX", path) >= static_cast<int>(sizeof(temp_path)))
+   {
+      WSI_LOG_ERROR("WSI_HEADLESS_CAPTURE_FILE \"%s\" is too long.", path);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   m_ring_file = util::fd_owner(mkostemp(temp_path, O_CLOEXEC));
+   if (!m_ring_file.is_valid())
+   {
+      WSI_LOG_ERROR("Failed to create the capture file \"%s\": %s.", temp_path, strerror(errno));
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   if (ftruncate(m_ring_file.get(), static_cast<off_t>(m_ring_size)) != 0)
+   {
+      WSI_LOG_ERROR("Failed to resize the capture file: %s.", strerror(errno));
+      unlink(temp_path);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   m_ring_map = mmap(nullptr, m_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_ring_file.get(), 0);
+   if (m_ring_map == MAP_FAILED)
+   {
+      WSI_LOG_ERROR("Failed to map the capture file: %s.", strerror(errno));
+      unlink(temp_path);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   /* The file is zero filled, so the frames_written and sequence atomics start at 0. */
+   auto *header = static_cast<capture_file_header *>(m_ring_map);
+   header->magic = HEADLESS_CAPTURE_FILE_MAGIC;
+   header->version = HEADLESS_CAPTURE_FILE_VERSION;
+   header->slot_count = HEADLESS_CAPTURE_RING_SLOTS;
+   header->width = m_extent.width;
+   header->height = m_extent.height;
+   header->format = static_cast<uint32_t>(m_format);
+   header->row_pitch = m_row_pitch;
+   header->slots_offset = slots_offset;
+   header->slot_size = m_ring_slot_size;
+   header->frame_size = m_frame_size;
+
+   if (rename(temp_path, path) != 0)
+   {
+      WSI_LOG_ERROR("Failed to move the capture file to \"%s\": %s.", path, strerror(errno));
+      unlink(temp_path);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   return VK_SUCCESS;
+}
+
+VkResult frame_capture::record_copy(slot &image_slot, VkImage image)
+{
+   VkDevice device = m_device_data.device;
+   if (image_slot.command_buffer == VK_NULL_HANDLE)
+   {
+      VkCommandBufferAllocateInfo allocate_info = {};
+      allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocate_info.commandPool = m_command_pool;
+      allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      allocate_info.commandBufferCount = 1;
+      TRY(m_device_data.disp.AllocateCommandBuffers(device, &allocate_info, &image_slot.command_buffer));
+      /* Command buffers are dispatchable, so they need the loader data like the queues of the layer. */
+      TRY(m_device_data.SetDeviceLoaderData(device, image_slot.command_buffer));
+   }
+   else
+   {
+      TRY(m_device_data.disp.ResetCommandBuffer(image_slot.command_buffer, 0));
+   }
+   image_slot.recorded_image = VK_NULL_HANDLE;
+
+   VkCommandBufferBeginInfo begin_info = {};
+   begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+   TRY(m_device_data.disp.BeginCommandBuffer(image_slot.command_buffer, &begin_info));
+
+   VkImageMemoryBarrier to_transfer = {};
+   to_transfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+   to_transfer.srcAccessMask = 0;
+   to_transfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+   to_transfer.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+   to_transfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+   to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_transfer.image = image;
+   to_transfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+   m_device_data.disp.CmdPipelineBarrier(image_slot.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_transfer);
+
+   VkBufferImageCopy region = {};
+   region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+   region.imageExtent = { m_extent.width, m_extent.height, 1 };
+   m_device_data.disp.CmdCopyImageToBuffer(image_slot.command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                           image_slot.buffer, 1, &region);
+
+   /* Give the image back in the layout it was presented in, and make the frame available to the host. */
+   VkImageMemoryBarrier to_present = to_transfer;
+   to_present.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+   to_present.dstAccessMask = 0;
+   to_present.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+   to_present.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+   VkBufferMemoryBarrier to_host = {};
+   to_host.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+   to_host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   to_host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+   to_host.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_host.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_host.buffer = image_slot.buffer;
+   to_host.offset = 0;
+   to_host.size = VK_WHOLE_SIZE;
+
+   m_device_data.disp.CmdPipelineBarrier(image_slot.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                                         nullptr, 1, &to_host, 1, &to_present);
+
+   TRY(m_device_data.disp.EndCommandBuffer(image_slot.command_buffer));
+   image_slot.recorded_image = image;
+   return VK_SUCCESS;
+}
+
+VkResult frame_capture::submit_copy(VkQueue queue, uint32_t image_index, VkImage image,
+                                    const queue_submit_semaphores &semaphores, VkSemaphore &copy_done)
+{
+   copy_done = VK_NULL_HANDLE;
+   assert(image_index < m_slots.size());
+   slot &image_slot = m_slots[image_index];
+
+   auto queue_family_index = m_device_data.get_queue_family_index(queue);
+   if (!queue_family_index.has_value())
+   {
+      return VK_SUCCESS;
+   }
+
+   VkDevice device = m_device_data.device;
+   if (m_command_pool == VK_NULL_HANDLE)
+   {
+      VkCommandPoolCreateInfo pool_info = {};
+      pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+      pool_info.queueFamilyIndex = *queue_family_index;
+      TRY_LOG(m_device_data.disp.CreateCommandPool(device, &pool_info, m_callbacks, &m_command_pool),
+              "Failed to create the frame capture command pool");
+      m_queue_family_index = *queue_family_index;
+   }
+   else if (*queue_family_index != m_queue_family_index)
+   {
+      /* The copies are only recorded for the queue family of the first presenting queue. */
+      return VK_SUCCESS;
+   }
+
+   /* The previous copy has completed by the time the image is presented again, unless it was never published. */
+   if (image_slot.copy_pending)
+   {
+      TRY(m_device_data.disp.WaitForFences(device, 1, &image_slot.copy_fence, VK_TRUE, UINT64_MAX));
+      image_slot.copy_pending = false;
+   }
+   TRY(m_device_data.disp.ResetFences(device, 1, &image_slot.copy_fence));
+
+   if (image_slot.recorded_image != image)
+   {
+      TRY_LOG(record_copy(image_slot, image), "Failed to record the frame capture copy");
+   }
+
+   util::vector<VkPipelineStageFlags> wait_stages{ util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) };
+   if (!wait_stages.try_resize(semaphores.wait_semaphores_count, VK_PIPELINE_STAGE_TRANSFER_BIT))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   VkSubmitInfo submit_info = {};
+   submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+   submit_info.waitSemaphoreCount = semaphores.wait_semaphores_count;
+   submit_info.pWaitSemaphores = semaphores.wait_semaphores;
+   submit_info.pWaitDstStageMask = wait_stages.data();
+   submit_info.commandBufferCount = 1;
+   submit_info.pCommandBuffers = &image_slot.command_buffer;
+   submit_info.signalSemaphoreCount = 1;
+   submit_info.pSignalSemaphores = &image_slot.copy_done;
+   TRY_LOG(m_device_data.disp.QueueSubmit(queue, 1, &submit_info, image_slot.copy_fence),
+           "Failed to submit the frame capture copy");
+
+   image_slot.copy_pending = true;
+   copy_done = image_slot.copy_done;
+   return VK_SUCCESS;
+}
+
+VkResult frame_capture::cancel_copy(uint32_t image_index)
+{
+   assert(image_index < m_slots.size());
+   slot &image_slot = m_slots[image_index];
+   if (!image_slot.copy_pending)
+   {
+      return VK_SUCCESS;
+   }
+
+   VkDevice device = m_device_data.device;
+   TRY(m_device_data.disp.WaitForFences(device, 1, &image_slot.copy_fence, VK_TRUE, UINT64_MAX));
+   image_slot.copy_pending = false;
+
+   /* A binary semaphore cannot be signalled again before it is waited on, so the next copy needs a new one. */
+   VkSemaphore copy_done = VK_NULL_HANDLE;
+   VkSemaphoreCreateInfo semaphore_info = {};
+   semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+   TRY(m_device_data.disp.CreateSemaphore(device, &semaphore_info, m_callbacks, &copy_done));
+   m_device_data.disp.DestroySemaphore(device, image_slot.copy_done, m_callbacks);
+   image_slot.copy_done = copy_done;
+   return VK_SUCCESS;
+}
+
+void frame_capture::write_ring_file(const slot &image_slot, uint32_t image_index, uint64_t present_id,
+                                    uint64_t present_time)
+{
+   auto *file_header = static_cast<capture_file_header *>(m_ring_map);
+   const uint64_t frame = file_header->frames_written.load(std::memory_order_relaxed);
+
+   auto *slot_base = static_cast<uint8_t *>(m_ring_map) + file_header->slots_offset +
+                     (frame % HEADLESS_CAPTURE_RING_SLOTS) * m_ring_slot_size;
+   auto *frame_header = reinterpret_cast<capture_frame_header *>(slot_base);
+
+   frame_header->sequence.store(2 * frame + 1, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+
+   frame_header->present_id = present_id;
+   frame_header->present_time = present_time;
+   frame_header->image_index = image_index;
+   memcpy(slot_base + sizeof(capture_frame_header), image_slot.mapped, m_frame_size);
+
+   frame_header->sequence.store(2 * frame + 2, std::memory_order_release);
+   file_header->frames_written.store(frame + 1, std::memory_order_release);
+}
+
+void frame_capture::publish(uint32_t image_index, uint64_t present_id, uint64_t present_time)
+{
+   assert(image_index < m_slots.size());
+   slot &image_slot = m_slots[image_index];
+   if (!image_slot.copy_pending)
+   {
+      return;
+   }
+
+   /* The present payload waits for the copy, so this only waits when the payload was not waited on. */
+   if (m_device_data.disp.WaitForFences(m_device_data.device, 1, &image_slot.copy_fence, VK_TRUE, UINT64_MAX) !=
+       VK_SUCCESS)
+   {
+      WSI_LOG_ERROR("Failed to wait for the frame capture copy.");
+      return;
+   }
+   image_slot.copy_pending = false;
+
+   if (m_invalidate_staging)
+   {
+      VkMappedMemoryRange range = {};
+      range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+      range.memory = image_slot.memory;
+      range.offset = 0;
+      range.size = VK_WHOLE_SIZE;
+      /* The host may not see the copied frame otherwise, so it is dropped rather than published. */
+      if (m_device_data.disp.InvalidateMappedMemoryRanges(m_device_data.device, 1, &range) != VK_SUCCESS)
+      {
+         WSI_LOG_ERROR("Failed to invalidate the frame capture staging buffer.");
+         return;
+      }
+   }
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   if (m_callback != nullptr)
+   {
+      VkSwapchainCapturedFrameARM frame = {};
+      frame.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CAPTURED_FRAME_ARM;
+      frame.imageIndex = image_index;
+      frame.presentId = present_id;
+      frame.presentTime = present_time;
+      frame.extent = m_extent;
+      frame.format = m_format;
+      frame.rowPitch = m_row_pitch;
+      frame.size = m_frame_size;
+      frame.pData = image_slot.mapped;
+      m_callback(&frame, m_callback_user_data);
+   }
+#endif
+
+   if (m_ring_map != MAP_FAILED)
+   {
+      write_ring_file(image_slot, image_index, present_id, present_time);
+   }
+}
+
+} /* namespace headless */
+} /* namespace wsi */
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file frame_capture.hpp
+ *
+ * @brief Contains the capture of the frames presented to headless swapchains.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include <layer/private_data.hpp>
+#include <layer/wsi_layer_experimental.hpp>
+#include <util/custom_allocator.hpp>
+#include <util/file_descriptor.hpp>
+#include <wsi/synchronization.hpp>
+
+namespace wsi
+{
+namespace headless
+{
+
+/**
+ * @brief Number of frames kept in a capture ring file.
+ */
+#define HEADLESS_CAPTURE_RING_SLOTS 4
+
+/**
+ * @brief Magic number at the start of a capture ring file, "WSIC" in little endian.
+ */
+#define HEADLESS_CAPTURE_FILE_MAGIC 0x43495357u
+
+#define HEADLESS_CAPTURE_FILE_VERSION 1u
+
+/**
+ * @brief Header at the start of a capture ring file.
+ *
+ * The file is replaced, rather than modified, when a new swapchain starts capturing to it, so readers should check
+ * whether the path refers to a different file when the format of the frames may have changed.
+ */
+struct capture_file_header
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t slot_count;
+   uint32_t width;
+   uint32_t height;
+   /* VkFormat of the frames. */
+   uint32_t format;
+   uint32_t row_pitch;
+   uint32_t reserved;
+   /* Offset of the first slot, slot i starts at slots_offset + i * slot_size. */
+   uint64_t slots_offset;
+   uint64_t slot_size;
+   /* Size of the frame that follows the header of each slot. */
+   uint64_t frame_size;
+   /* Number of frames written, frame n is in slot n % slot_count. */
+   std::atomic<uint64_t> frames_written;
+};
+
+/**
+ * @brief Header of a slot of a capture ring file, followed by the frame.
+ *
+ * The sequence works as a sequence lock: it is odd while frame n is written to the slot and 2 * (n + 1) once it is
+ * complete. Readers copy the frame out and check the sequence did not change in the meantime, so they never block
+ * the presenting application.
+ */
+struct capture_frame_header
+{
+   std::atomic<uint64_t> sequence;
+   uint64_t present_id;
+   /* CLOCK_MONOTONIC time the frame was presented at, in nanoseconds. */
+   uint64_t present_time;
+   uint32_t image_index;
+   uint32_t reserved;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Capture files need lock-free atomics");
+
+/**
+ * @brief Copies the images presented to a headless swapchain into host visible staging buffers.
+ *
+ * Each swapchain image has its own persistently mapped staging buffer. The copy is submitted on the presenting queue
+ * ahead of the present payload, so the frame is in the staging buffer by the time the presentation thread presents
+ * the image. The frame is then handed to the application callback without copying it, or written into a memory
+ * mapped ring file selected with the WSI_HEADLESS_CAPTURE_FILE environment variable.
+ */
+class frame_capture
+{
+public:
+   /**
+    * @brief Check whether frame capture is requested for a swapchain.
+    */
+   static bool is_requested(const VkSwapchainCreateInfoKHR &swapchain_create_info);
+
+   /**
+    * @brief Create the capture of a swapchain.
+    *
+    * @param device_data           The device of the swapchain.
+    * @param allocator             Allocator for the host objects.
+    * @param callbacks             Allocation callbacks for the Vulkan objects.
+    * @param swapchain_create_info The create info of the swapchain.
+    *
+    * @return The capture, or nullptr if capturing the swapchain is not possible.
+    */
+   static util::unique_ptr<frame_capture> create(layer::device_private_data &device_data,
+                                                 const util::allocator &allocator,
+                                                 const VkAllocationCallbacks *callbacks,
+                                                 const VkSwapchainCreateInfoKHR &swapchain_create_info);
+
+   frame_capture(const frame_capture &) = delete;
+   frame_capture &operator=(const frame_capture &) = delete;
+
+   ~frame_capture();
+
+   /**
+    * @brief Submit the copy of an image into its staging buffer.
+    *
+    * @param queue       The queue the image is presented on.
+    * @param image_index Index of the image in the swapchain.
+    * @param image       The image.
+    * @param semaphores  The semaphores the copy waits on, the copy does not signal any of the signal semaphores.
+    * @param[out] copy_done Semaphore signalled by the copy, to be waited on by the present payload, or
+    *                       VK_NULL_HANDLE if the image is not captured.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult submit_copy(VkQueue queue, uint32_t image_index, VkImage image, const queue_submit_semaphores &semaphores,
+                        VkSemaphore &copy_done);
+
+   /**
+    * @brief Cancel the copy of an image submitted by @ref submit_copy, when the present payload waiting on it failed.
+    *
+    * Waits for the copy and replaces its semaphore, which nothing will wait on anymore.
+    *
+    * @param image_index Index of the image in the swapchain.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult cancel_copy(uint32_t image_index);
+
+   /**
+    * @brief Hand over the frame copied from an image, if it was captured.
+    *
+    * @param image_index  Index of the image in the swapchain.
+    * @param present_id   Present id of the presentation.
+    * @param present_time CLOCK_MONOTONIC time the image was presented at, in nanoseconds.
+    */
+   void publish(uint32_t image_index, uint64_t present_id, uint64_t present_time);
+
+private:
+   frame_capture(layer::device_private_data &device_data, const util::allocator &allocator,
+                 const VkAllocationCallbacks *callbacks, VkFormat format, VkExtent2D extent, uint32_t texel_size);
+
+   /* Allow util::allocator to access the private constructor */
+   friend util::allocator;
+
+   /**
+    * @brief Staging resources of a swapchain image.
+    */
+   struct slot
+   {
+      VkBuffer buffer{ VK_NULL_HANDLE };
+      VkDeviceMemory memory{ VK_NULL_HANDLE };
+      void *mapped{ nullptr };
+      VkCommandBuffer command_buffer{ VK_NULL_HANDLE };
+      /* Image the command buffer copies from, it is recorded again when the image changes. */
+      VkImage recorded_image{ VK_NULL_HANDLE };
+      VkSemaphore copy_done{ VK_NULL_HANDLE };
+      VkFence copy_fence{ VK_NULL_HANDLE };
+      /* Whether a copy was submitted that has not been published yet. */
+      bool copy_pending{ false };
+   };
+
+   VkResult init_slots(uint32_t image_count);
+   VkResult init_ring_file(const char *path);
+   VkResult record_copy(slot &image_slot, VkImage image);
+   void write_ring_file(const slot &image_slot, uint32_t image_index, uint64_t present_id, uint64_t present_time);
+
+   layer::device_private_data &m_device_data;
+   const util::allocator m_allocator;
+   const VkAllocationCallbacks *m_callbacks;
+
+   VkFormat m_format;
+   VkExtent2D m_extent;
+   uint32_t m_row_pitch;
+   VkDeviceSize m_frame_size;
+
+   /* Whether the staging memory needs invalidating before the host reads it. */
+   bool m_invalidate_staging;
+
+   util::vector<slot> m_slots;
+
+   /* Command pool for the queue family of the presenting queue, created on the first capture. */
+   VkCommandPool m_command_pool;
+   uint32_t m_queue_family_index;
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   PFN_vkSwapchainFrameCapturedARM m_callback;
+   void *m_callback_user_data;
+#endif
+
+   util::fd_owner m_ring_file;
+   void *m_ring_map;
+   size_t m_ring_size;
+   uint64_t m_ring_slot_size;
+};
+
+} /* namespace headless */
+} /* namespace wsi */
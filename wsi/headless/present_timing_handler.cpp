@@ -31,37 +31,50 @@
 #include "present_timing_handler.hpp"
 #include <cstdint>
 
-wsi_ext_present_timing_headless::wsi_ext_present_timing_headless(const util::allocator &allocator)
+wsi_ext_present_timing_headless::wsi_ext_present_timing_headless(const util::allocator &allocator,
+                                                                 uint64_t refresh_duration)
    : wsi::wsi_ext_present_timing(allocator)
+   , m_refresh_duration(refresh_duration)
 {
 }
 
 util::unique_ptr<wsi_ext_present_timing_headless> wsi_ext_present_timing_headless::create(
-   const util::allocator &allocator)
+   const util::allocator &allocator, uint64_t refresh_duration)
 {
+   /* Images are latched on the virtual vertical blanks, which are timed with CLOCK_MONOTONIC. */
    std::array<util::unique_ptr<wsi::vulkan_time_domain>, 4> time_domains_array = {
       allocator.make_unique<wsi::vulkan_time_domain>(VK_PRESENT_STAGE_QUEUE_OPERATIONS_END_BIT_EXT,
                                                      VK_TIME_DOMAIN_DEVICE_KHR),
       allocator.make_unique<wsi::vulkan_time_domain>(VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT,
-                                                     VK_TIME_DOMAIN_CLOCK_MONOTONIC_RAW_KHR),
+                                                     VK_TIME_DOMAIN_CLOCK_MONOTONIC_KHR),
       allocator.make_unique<wsi::vulkan_time_domain>(VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT,
-                                                     VK_TIME_DOMAIN_CLOCK_MONOTONIC_RAW_KHR),
+                                                     VK_TIME_DOMAIN_CLOCK_MONOTONIC_KHR),
       allocator.make_unique<wsi::vulkan_time_domain>(VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_VISIBLE_BIT_EXT,
-                                                     VK_TIME_DOMAIN_CLOCK_MONOTONIC_RAW_KHR)
+                                                     VK_TIME_DOMAIN_CLOCK_MONOTONIC_KHR)
    };
 
-   return wsi_ext_present_timing::create<wsi_ext_present_timing_headless>(allocator, time_domains_array);
+   return wsi_ext_present_timing::create<wsi_ext_present_timing_headless>(allocator, time_domains_array,
+                                                                          refresh_duration);
 }
 
 VkResult wsi_ext_present_timing_headless::get_swapchain_timing_properties(
    uint64_t &timing_properties_counter, VkSwapchainTimingPropertiesEXT &timing_properties)
 {
-   /* Use a reasonable approximate (5ms) that most devices should be able to match. */
+   /* Without pacing, use a reasonable approximate (5ms) that most devices should be able to match. */
    const uint64_t fixed_refresh_duration_ns = 5e+6;
 
    timing_properties_counter = 1;
-   timing_properties.refreshDuration = fixed_refresh_duration_ns;
+   timing_properties.refreshDuration = m_refresh_duration != 0 ? m_refresh_duration : fixed_refresh_duration_ns;
    timing_properties.variableRefreshDelay = UINT64_MAX;
 
    return VK_SUCCESS;
 }
+
+void wsi_ext_present_timing_headless::image_presented(uint64_t timing_slot, uint64_t present_time)
+{
+   /* The virtual display shows the image from the moment it is latched. */
+   constexpr VkPresentStageFlagsEXT stages = VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT |
+                                             VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT |
+                                             VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_VISIBLE_BIT_EXT;
+   complete_presentation_entry(timing_slot, stages, present_time, m_refresh_duration, 0);
+}
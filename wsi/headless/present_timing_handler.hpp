@@ -41,16 +41,39 @@
 class wsi_ext_present_timing_headless : public wsi::wsi_ext_present_timing
 {
 public:
-   static util::unique_ptr<wsi_ext_present_timing_headless> create(const util::allocator &allocator);
+   /**
+    * @brief Create the headless present timing extension.
+    *
+    * @param allocator        Allocator for the extension.
+    * @param refresh_duration Refresh duration of the virtual display in nanoseconds, or 0 if presentations are not
+    *                         paced.
+    *
+    * @return The extension, or nullptr on failure.
+    */
+   static util::unique_ptr<wsi_ext_present_timing_headless> create(const util::allocator &allocator,
+                                                                   uint64_t refresh_duration);
 
    VkResult get_swapchain_timing_properties(uint64_t &timing_properties_counter,
                                             VkSwapchainTimingPropertiesEXT &timing_properties) override;
 
+   /**
+    * @brief Record the presentation of an image on the virtual display.
+    *
+    * @param timing_slot  The slot of the presentation entry, 0 if no timing was requested.
+    * @param present_time CLOCK_MONOTONIC time the image was latched, in nanoseconds.
+    */
+   void image_presented(uint64_t timing_slot, uint64_t present_time);
+
 private:
-   wsi_ext_present_timing_headless(const util::allocator &allocator);
+   wsi_ext_present_timing_headless(const util::allocator &allocator, uint64_t refresh_duration);
 
    /* Allow util::allocator to access the private constructor */
    friend util::allocator;
+
+   /**
+    * @brief Refresh duration of the virtual display, 0 when presentations are not paced.
+    */
+   uint64_t m_refresh_duration;
 };
 
 #endif
\ No newline at end of file
@@ -38,6 +38,7 @@
 #include "surface_properties.hpp"
 #include "surface.hpp"
 #include "util/macros.hpp"
+#include "util/proc_addr_table.hpp"
 
 namespace wsi
 {
@@ -178,11 +179,14 @@ CreateHeadlessSurfaceEXT(VkInstance instance, const VkHeadlessSurfaceCreateInfoE
 
 PFN_vkVoidFunction surface_properties::get_proc_addr(const char *name)
 {
-   if (strcmp(name, "vkCreateHeadlessSurfaceEXT") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(CreateHeadlessSurfaceEXT);
-   }
-   return nullptr;
+   /* Sorted by name. */
+   static constexpr util::proc_addr_entry entrypoints[] = {
+      PROC_ADDR_ENTRY(CreateHeadlessSurfaceEXT),
+   };
+   static_assert(util::is_sorted_by_name(entrypoints), "Entrypoints must be sorted by name");
+
+   const util::proc_addr_entry *entry = util::find_proc_addr(entrypoints, name);
+   return entry != nullptr ? entry->get_fn() : nullptr;
 }
 
 VkResult surface_properties::get_required_instance_extensions(util::extension_list &extension_list)
@@ -28,6 +28,8 @@
  * @brief Contains the implementation for a headless swapchain.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
 
@@ -48,15 +50,40 @@ namespace wsi
 namespace headless
 {
 
+/**
+ * @brief Device memory that one or more swapchain images are sub-allocated from.
+ */
+struct image_memory_block
+{
+   VkDeviceMemory memory{ VK_NULL_HANDLE };
+   VkDeviceSize size{ 0 };
+   uint32_t heap_index{ 0 };
+
+   /* One reference per image bound to the block, plus one held by the swapchain while it sub-allocates from it.
+    * Images taken over by a descendant keep their reference, so the block may outlive the swapchain. */
+   std::atomic<uint32_t> refcount{ 1 };
+};
+
 struct image_data
 {
-   /* Device memory backing the image. */
-   VkDeviceMemory memory{};
+   /* Device memory block backing the image, and the offset of the image in it. */
+   image_memory_block *memory_block{ nullptr };
+   VkDeviceSize memory_offset{ 0 };
    fence_sync present_fence;
+
+   /* Value of the present timeline that signals the present payload, when the swapchain uses one. */
+   uint64_t present_timeline_payload{ 0 };
 };
 
 swapchain::swapchain(layer::device_private_data &dev_data, const VkAllocationCallbacks *pAllocator)
    : wsi::swapchain_base(dev_data, pAllocator)
+   , m_vsync_clock(vsync_clock::create_from_environment())
+   , m_memory_props()
+   , m_memory_block_images(1)
+   , m_memory_block(nullptr)
+   , m_memory_block_offset(0)
+   , m_frame_capture(nullptr)
+   , m_wait_payload_on_present(false)
 {
 }
 
@@ -64,6 +91,16 @@ swapchain::~swapchain()
 {
    /* Call the base's teardown */
    teardown();
+
+   /* Teardown waited for the presents, which include the capture copies. */
+   m_frame_capture.reset();
+
+   /* The images still bound to the block keep it alive. */
+   if (m_memory_block != nullptr)
+   {
+      release_memory_block(m_memory_block);
+      m_memory_block = nullptr;
+   }
 }
 
 VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info)
@@ -95,7 +132,7 @@ VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCr
 
    if (m_device_data.should_layer_handle_frame_boundary_events())
    {
-      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_frame_boundary>(m_device_data)))
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_frame_boundary>()))
       {
          return VK_ERROR_OUT_OF_HOST_MEMORY;
       }
@@ -105,7 +142,8 @@ VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCr
    bool swapchain_support_enabled = swapchain_create_info->flags & VK_SWAPCHAIN_CREATE_PRESENT_TIMING_BIT_EXT;
    if (swapchain_support_enabled)
    {
-      if (!add_swapchain_extension(wsi_ext_present_timing_headless::create(m_allocator)))
+      const uint64_t refresh_duration = m_vsync_clock.has_value() ? m_vsync_clock->get_refresh_duration() : 0;
+      if (!add_swapchain_extension(wsi_ext_present_timing_headless::create(m_allocator, refresh_duration)))
       {
          return VK_ERROR_OUT_OF_HOST_MEMORY;
       }
@@ -119,47 +157,250 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
                                   bool &use_presentation_thread)
 {
    UNUSED(device);
+
+   m_memory_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+   m_device_data.instance_data.disp.GetPhysicalDeviceMemoryProperties2KHR(m_device_data.physical_device,
+                                                                          &m_memory_props);
+
+   const bool deferred_allocation =
+      swapchain_create_info->flags & VK_SWAPCHAIN_CREATE_DEFERRED_MEMORY_ALLOCATION_BIT_EXT;
+   if (!deferred_allocation && swapchain_create_info->oldSwapchain == VK_NULL_HANDLE)
+   {
+      m_memory_block_images = m_swapchain_images.size();
+   }
+
+   if (frame_capture::is_requested(*swapchain_create_info))
+   {
+      m_frame_capture =
+         frame_capture::create(m_device_data, m_allocator, get_allocation_callbacks(), *swapchain_create_info);
+      if (m_frame_capture == nullptr)
+      {
+         WSI_LOG_WARNING("Frame capture is disabled for the swapchain.");
+      }
+   }
+
+   if (m_device_data.instance_data.get_layer_settings().present_sync == layer::present_sync_mode::timeline &&
+       timeline_semaphore_sync::is_supported(m_device_data))
+   {
+      /* Keep using the per image fences if the timeline cannot be created. */
+      m_present_timeline = timeline_semaphore_sync::create(m_device_data);
+   }
+
+   /*
+    * Nothing reads the images of a headless surface, so present_image can be called during vkQueuePresent without
+    * waiting for the present payload, which saves handing every present over to the page flip thread. The thread is
+    * still needed by the presents that wait for a vertical blank of the virtual display, by shared continuous refresh,
+    * which keeps presenting the shared image, and by frame capture, which publishes the images once their payload has
+    * completed. Present ids and present timing must only report a present once its payload has completed too, so
+    * they also keep the thread, except for demand refresh where present_image waits for the payload instead.
+    */
+   bool reports_presents = get_swapchain_extension<wsi_ext_present_id>() != nullptr;
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   reports_presents = reports_presents || get_swapchain_extension<wsi_ext_present_timing_headless>() != nullptr;
+#endif
    if (swapchain_create_info->presentMode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR)
    {
       use_presentation_thread = false;
+      m_wait_payload_on_present = reports_presents;
    }
    else
    {
-      use_presentation_thread = true;
+      use_presentation_thread = m_vsync_clock.has_value() || m_frame_capture != nullptr || reports_presents ||
+                                is_present_mode_enabled(VK_PRESENT_MODE_FIFO_KHR) ||
+                                is_present_mode_enabled(VK_PRESENT_MODE_FIFO_RELAXED_KHR) ||
+                                is_present_mode_enabled(VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR);
    }
 
    return VK_SUCCESS;
 }
 
-VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_create, swapchain_image &image)
+/**
+ * @brief Select the memory type for swapchain images.
+ *
+ * Memory types are listed by decreasing performance, so the first device local type is the fastest. Lazily allocated
+ * memory is skipped as it is only meant for transient attachments.
+ *
+ * @param memory_props     Memory properties of the physical device.
+ * @param memory_type_bits Memory types supported by the images.
+ *
+ * @return The memory type index, or std::nullopt if the device has none of the memory types.
+ */
+static std::optional<uint32_t> select_memory_type(const VkPhysicalDeviceMemoryProperties &memory_props,
+                                                  uint32_t memory_type_bits)
 {
-   UNUSED(image_create);
-   VkResult res = VK_SUCCESS;
-   const std::lock_guard<std::recursive_mutex> lock(m_image_status_mutex);
+   std::optional<uint32_t> fallback;
+   for (uint32_t i = 0; i < memory_props.memoryTypeCount; ++i)
+   {
+      const VkMemoryPropertyFlags flags = memory_props.memoryTypes[i].propertyFlags;
+      if ((memory_type_bits & (1u << i)) == 0 || (flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0)
+      {
+         continue;
+      }
 
-   VkMemoryRequirements memory_requirements = {};
-   m_device_data.disp.GetImageMemoryRequirements(m_device, image.image, &memory_requirements);
+      if ((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0)
+      {
+         return i;
+      }
+
+      if (!fallback.has_value())
+      {
+         fallback = i;
+      }
+   }
 
-   /* Find a memory type */
-   size_t mem_type_idx = 0;
-   for (; mem_type_idx < 8 * sizeof(memory_requirements.memoryTypeBits); ++mem_type_idx)
+   if (fallback.has_value())
    {
-      if (memory_requirements.memoryTypeBits & (1u << mem_type_idx))
+      return *fallback;
+   }
+
+   /* Only lazily allocated types are supported, use the first one. */
+   for (uint32_t i = 0; i < memory_props.memoryTypeCount; ++i)
+   {
+      if ((memory_type_bits & (1u << i)) != 0)
       {
-         break;
+         return i;
       }
    }
+   return std::nullopt;
+}
+
+/**
+ * @brief Get the memory requirements of an image, and whether it needs a dedicated allocation.
+ */
+static void get_image_memory_requirements(const layer::device_private_data &device_data, VkDevice device,
+                                          VkImage image, VkMemoryRequirements &requirements, bool &dedicated)
+{
+   auto get_requirements2 =
+      device_data.disp.get_fn<PFN_vkGetImageMemoryRequirements2KHR>(
+         layer::device_entrypoint::GetImageMemoryRequirements2KHR);
+   if (!get_requirements2.has_value())
+   {
+      device_data.disp.GetImageMemoryRequirements(device, image, &requirements);
+      dedicated = false;
+      return;
+   }
+
+   VkMemoryDedicatedRequirements dedicated_requirements = {};
+   dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
 
-   assert(mem_type_idx <= 8 * sizeof(memory_requirements.memoryTypeBits) - 1);
+   VkMemoryRequirements2 requirements2 = {};
+   requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+   requirements2.pNext = &dedicated_requirements;
+
+   VkImageMemoryRequirementsInfo2 requirements_info = {};
+   requirements_info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+   requirements_info.image = image;
+
+   (*get_requirements2)(device, &requirements_info, &requirements2);
+   requirements = requirements2.memoryRequirements;
+   dedicated = dedicated_requirements.requiresDedicatedAllocation == VK_TRUE;
+}
+
+VkResult swapchain::allocate_memory_block(VkDeviceSize size, uint32_t memory_type, VkImage dedicated_image,
+                                          image_memory_block *&block)
+{
+   VkMemoryDedicatedAllocateInfo dedicated_info = {};
+   dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+   dedicated_info.image = dedicated_image;
 
    VkMemoryAllocateInfo mem_info = {};
    mem_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-   mem_info.allocationSize = memory_requirements.size;
-   mem_info.memoryTypeIndex = mem_type_idx;
+   mem_info.pNext = dedicated_image != VK_NULL_HANDLE ? &dedicated_info : nullptr;
+   mem_info.allocationSize = size;
+   mem_info.memoryTypeIndex = memory_type;
+
+   block = m_image_allocator.create<image_memory_block>(1);
+   if (block == nullptr)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   VkResult res = m_device_data.disp.AllocateMemory(m_device, &mem_info, get_allocation_callbacks(), &block->memory);
+   if (res != VK_SUCCESS)
+   {
+      m_image_allocator.destroy(1, block);
+      block = nullptr;
+      return res;
+   }
+
+   block->size = size;
+   block->heap_index = m_device_data.get_memory_heap_index(memory_type);
+   /* The block may outlive the swapchain, so it is only recorded in the totals of the device. */
+   m_device_data.get_memory_usage().add_device_memory(block->heap_index, block->size, false);
+   WSI_TRACK_DEVICE_ALLOCATION(block->size);
+   return VK_SUCCESS;
+}
+
+void swapchain::release_memory_block(image_memory_block *block)
+{
+   if (block->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+   {
+      m_device_data.disp.FreeMemory(m_device, block->memory, get_allocation_callbacks());
+      m_device_data.get_memory_usage().remove_device_memory(block->heap_index, block->size, false);
+      m_image_allocator.destroy(1, block);
+   }
+}
+
+VkResult swapchain::bind_image_memory(VkImage image, image_data &data)
+{
+   VkMemoryRequirements memory_requirements = {};
+   bool dedicated = false;
+   get_image_memory_requirements(m_device_data, m_device, image, memory_requirements, dedicated);
+
+   const std::optional<uint32_t> selected_type =
+      select_memory_type(m_memory_props.memoryProperties, memory_requirements.memoryTypeBits);
+   if (!selected_type.has_value())
+   {
+      WSI_LOG_ERROR("No memory type supports the swapchain images.");
+      return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+   }
+   const uint32_t memory_type = *selected_type;
+
+   if (dedicated)
+   {
+      TRY_LOG(allocate_memory_block(memory_requirements.size, memory_type, image, data.memory_block),
+              "Failed to allocate dedicated memory for a swapchain image");
+      data.memory_offset = 0;
+   }
+   else
+   {
+      const VkDeviceSize alignment = std::max<VkDeviceSize>(memory_requirements.alignment, 1);
+      const VkDeviceSize slot_size = (memory_requirements.size + alignment - 1) / alignment * alignment;
+      VkDeviceSize offset = (m_memory_block_offset + alignment - 1) / alignment * alignment;
+
+      if (m_memory_block == nullptr || offset + memory_requirements.size > m_memory_block->size)
+      {
+         if (m_memory_block != nullptr)
+         {
+            release_memory_block(m_memory_block);
+            m_memory_block = nullptr;
+         }
+
+         TRY_LOG(allocate_memory_block(slot_size * m_memory_block_images, memory_type, VK_NULL_HANDLE, m_memory_block),
+                 "Failed to allocate memory for the swapchain images");
+         /* The images that need memory later on were not counted, so they get blocks of their own. */
+         m_memory_block_images = 1;
+         offset = 0;
+      }
+
+      m_memory_block->refcount.fetch_add(1, std::memory_order_relaxed);
+      data.memory_block = m_memory_block;
+      data.memory_offset = offset;
+      m_memory_block_offset = offset + slot_size;
+   }
+
+   return m_device_data.disp.BindImageMemory(m_device, image, data.memory_block->memory, data.memory_offset);
+}
+
+VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_create, swapchain_image &image)
+{
+   UNUSED(image_create);
+   VkResult res = VK_SUCCESS;
+
    image_data *data = nullptr;
 
    /* Create image_data */
-   data = m_allocator.create<image_data>(1);
+   data = m_image_allocator.create<image_data>(1);
    if (data == nullptr)
    {
       m_device_data.disp.DestroyImage(m_device, image.image, get_allocation_callbacks());
@@ -168,30 +409,24 @@ VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_cr
    image.data = reinterpret_cast<void *>(data);
    image.status = wsi::swapchain_image::FREE;
 
-   res = m_device_data.disp.AllocateMemory(m_device, &mem_info, get_allocation_callbacks(), &data->memory);
-   assert(VK_SUCCESS == res);
+   res = bind_image_memory(image.image, *data);
    if (res != VK_SUCCESS)
    {
       destroy_image(image);
       return res;
    }
 
-   res = m_device_data.disp.BindImageMemory(m_device, image.image, data->memory, 0);
-   assert(VK_SUCCESS == res);
-   if (res != VK_SUCCESS)
+   /* Initialize presentation fence, unless the payloads signal the present timeline. */
+   if (!m_present_timeline.has_value())
    {
-      destroy_image(image);
-      return res;
-   }
-
-   /* Initialize presentation fence. */
-   auto present_fence = fence_sync::create(m_device_data);
-   if (!present_fence.has_value())
-   {
-      destroy_image(image);
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
+      auto present_fence = fence_sync::create(m_device_data);
+      if (!present_fence.has_value())
+      {
+         destroy_image(image);
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+      data->present_fence = std::move(present_fence.value());
    }
-   data->present_fence = std::move(present_fence.value());
 
    return res;
 }
@@ -199,6 +434,11 @@ VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_cr
 VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
 {
    m_image_create_info = image_create_info;
+   if (m_frame_capture != nullptr)
+   {
+      /* The presented images are copied into the capture staging buffers. */
+      m_image_create_info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+   }
    VkImageCompressionControlEXT image_compression_control = {};
 
    if (m_device_data.is_swapchain_compression_control_enabled())
@@ -218,55 +458,174 @@ VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info,
    return m_device_data.disp.CreateImage(m_device, &m_image_create_info, get_allocation_callbacks(), &image.image);
 }
 
+vsync_event swapchain::wait_for_latch(const pending_present_request &pending_present)
+{
+   assert(m_vsync_clock.has_value());
+
+   const uint64_t now = vsync_clock::now();
+   if (m_present_mode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR)
+   {
+      /* Demand refresh presents from the application thread, so get the timing without blocking it. */
+      return m_vsync_clock->get_next_vsync(now);
+   }
+
+   const vsync_event next_vsync = m_vsync_clock->get_next_vsync(now);
+   if (pending_present.present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR && m_last_latch_msc.has_value() &&
+       next_vsync.msc > *m_last_latch_msc + 1)
+   {
+      /* The image missed the vertical blank after the previous one, so it is latched straight away and tears. */
+      return { next_vsync.msc - 1, now };
+   }
+
+   uint64_t not_before = 0;
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   /* Bound the target so a bogus time cannot stall the presentation thread. */
+   constexpr uint64_t max_target_delay_ns = 1000000000ull;
+   not_before = std::min(pending_present.target_time_ns, now + max_target_delay_ns);
+#endif
+   return m_vsync_clock->wait_for_vsync(not_before);
+}
+
 void swapchain::present_image(const pending_present_request &pending_present)
 {
-   if (m_device_data.is_present_id_enabled())
+   if (m_wait_payload_on_present)
+   {
+      const VkResult result = image_wait_present(m_swapchain_images[pending_present.image_index], UINT64_MAX);
+      if (result != VK_SUCCESS)
+      {
+         WSI_LOG_ERROR("Failed to wait for the present payload.");
+         set_error_state(result);
+      }
+   }
+
+   uint64_t present_time = 0;
+   if (m_vsync_clock.has_value())
    {
-      auto *ext = get_swapchain_extension<wsi_ext_present_id>(true);
-      ext->set_present_id(pending_present.present_id);
+      /* Each image stays on the virtual display for at least one refresh cycle. */
+      const vsync_event latch = wait_for_latch(pending_present);
+      m_last_latch_msc = latch.msc;
+      present_time = latch.time_ns;
    }
+   else
+   {
+      present_time = vsync_clock::now();
+   }
+
+   set_present_id(pending_present.present_id);
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   auto *present_timing = get_swapchain_extension<wsi_ext_present_timing_headless>();
+   if (present_timing != nullptr)
+   {
+      present_timing->image_presented(pending_present.timing_slot, present_time);
+   }
+#endif
+
+   if (m_frame_capture != nullptr)
+   {
+      m_frame_capture->publish(pending_present.image_index, pending_present.present_id, present_time);
+   }
+
    unpresent_image(pending_present.image_index);
 }
 
 void swapchain::destroy_image(wsi::swapchain_image &image)
 {
-   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
-   if (image.status != wsi::swapchain_image::INVALID)
+   /* Only the first caller to invalidate the image destroys the VkImage. */
+   if (image.status.exchange(wsi::swapchain_image::INVALID) != wsi::swapchain_image::INVALID)
    {
       if (image.image != VK_NULL_HANDLE)
       {
          m_device_data.disp.DestroyImage(m_device, image.image, get_allocation_callbacks());
          image.image = VK_NULL_HANDLE;
       }
-
-      image.status = wsi::swapchain_image::INVALID;
    }
 
-   image_status_lock.unlock();
-
    if (image.data != nullptr)
    {
       auto *data = reinterpret_cast<image_data *>(image.data);
-      if (data->memory != VK_NULL_HANDLE)
+      if (data->memory_block != nullptr)
       {
-         m_device_data.disp.FreeMemory(m_device, data->memory, get_allocation_callbacks());
-         data->memory = VK_NULL_HANDLE;
+         release_memory_block(data->memory_block);
+         data->memory_block = nullptr;
       }
-      m_allocator.destroy(1, data);
+      m_image_allocator.destroy(1, data);
       image.data = nullptr;
    }
 }
 
+bool swapchain::adopt_ancestor_image(swapchain_base &ancestor, wsi::swapchain_image &image)
+{
+   /* The compression control parameters are not tracked per image, so such images are always created again. */
+   if (get_swapchain_extension<wsi_ext_image_compression_control>() != nullptr ||
+       ancestor.get_swapchain_extension<wsi_ext_image_compression_control>() != nullptr)
+   {
+      return false;
+   }
+
+   /* Images only have a present fence when the swapchain does not use a present timeline. */
+   auto &headless_ancestor = static_cast<swapchain &>(ancestor);
+   if (m_present_timeline.has_value() != headless_ancestor.m_present_timeline.has_value())
+   {
+      return false;
+   }
+
+   /* The image memory and the present fence do not refer to the swapchain that created them. FREE images have no
+    * pending payload, so the value of the ancestor timeline can be dropped. */
+   auto *data = reinterpret_cast<image_data *>(image.data);
+   if (data == nullptr)
+   {
+      return false;
+   }
+   data->present_timeline_payload = 0;
+   return true;
+}
+
 VkResult swapchain::image_set_present_payload(swapchain_image &image, VkQueue queue,
                                               const queue_submit_semaphores &semaphores, const void *submission_pnext)
 {
    auto data = reinterpret_cast<image_data *>(image.data);
-   return data->present_fence.set_payload(queue, semaphores, submission_pnext);
+
+   queue_submit_semaphores payload_semaphores = semaphores;
+   VkSemaphore copy_done = VK_NULL_HANDLE;
+   if (m_frame_capture != nullptr)
+   {
+      /* The copy takes over the wait semaphores, and the payload completes once the copy does. */
+      const auto image_index = static_cast<uint32_t>(&image - m_swapchain_images.data());
+      TRY_LOG_CALL(m_frame_capture->submit_copy(queue, image_index, image.image, semaphores, copy_done));
+      if (copy_done != VK_NULL_HANDLE)
+      {
+         payload_semaphores.wait_semaphores = &copy_done;
+         payload_semaphores.wait_semaphores_count = 1;
+      }
+   }
+
+   VkResult result = VK_SUCCESS;
+   if (m_present_timeline.has_value())
+   {
+      result = m_present_timeline->set_payload(queue, payload_semaphores, submission_pnext,
+                                               data->present_timeline_payload);
+   }
+   else
+   {
+      result = data->present_fence.set_payload(queue, payload_semaphores, submission_pnext);
+   }
+
+   if (result != VK_SUCCESS && copy_done != VK_NULL_HANDLE)
+   {
+      const auto image_index = static_cast<uint32_t>(&image - m_swapchain_images.data());
+      TRY_LOG_CALL(m_frame_capture->cancel_copy(image_index));
+   }
+   return result;
 }
 
 VkResult swapchain::image_wait_present(swapchain_image &image, uint64_t timeout)
 {
    auto data = reinterpret_cast<image_data *>(image.data);
+   if (m_present_timeline.has_value())
+   {
+      return m_present_timeline->wait_payload(data->present_timeline_payload, timeout);
+   }
    return data->present_fence.wait_payload(timeout);
 }
 
@@ -276,9 +635,10 @@ VkResult swapchain::bind_swapchain_image(VkDevice &device, const VkBindImageMemo
    auto &device_data = layer::device_private_data::get(device);
 
    const wsi::swapchain_image &swapchain_image = m_swapchain_images[bind_sc_info->imageIndex];
-   VkDeviceMemory memory = reinterpret_cast<image_data *>(swapchain_image.data)->memory;
+   const auto *data = reinterpret_cast<image_data *>(swapchain_image.data);
 
-   return device_data.disp.BindImageMemory(device, bind_image_mem_info->image, memory, 0);
+   return device_data.disp.BindImageMemory(device, bind_image_mem_info->image, data->memory_block->memory,
+                                           data->memory_offset);
 }
 
 } /* namespace headless */
@@ -30,15 +30,24 @@
 
 #pragma once
 
+#include <optional>
+
 #include <vulkan/vk_icd.h>
 #include <vulkan/vulkan.h>
 
 #include <wsi/swapchain_base.hpp>
 
+#include "frame_capture.hpp"
+#include "vsync_clock.hpp"
+
 namespace wsi
 {
 namespace headless
 {
+
+struct image_memory_block;
+struct image_data;
+
 /**
  * @brief Headless swapchain class.
  *
@@ -112,6 +121,19 @@ protected:
 
    VkResult image_wait_present(swapchain_image &image, uint64_t timeout) override;
 
+   bool adopt_ancestor_image(swapchain_base &ancestor, swapchain_image &image) override;
+
+   bool supports_deferred_teardown() const override
+   {
+      return true;
+   }
+
+   /* Presents only wait when the virtual display holds each image for a refresh cycle. */
+   bool present_image_may_block() const override
+   {
+      return m_vsync_clock.has_value();
+   }
+
    /**
     * @brief Bind image to a swapchain
     *
@@ -134,6 +156,94 @@ private:
     * @return VK_SUCCESS on success, other result codes on failure
     */
    VkResult add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info) override;
+
+   /**
+    * @brief Timeline semaphore signalled by the present payloads of all the images, instead of a fence per image.
+    *
+    * Only used on devices with the timeline semaphore feature enabled.
+    */
+   std::optional<timeline_semaphore_sync> m_present_timeline;
+
+   /**
+    * @brief Bind memory to an image, sub-allocated from @ref m_memory_block when possible.
+    *
+    * @param image The image to bind memory to.
+    * @param data  Data of the image, updated with the memory backing it.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult bind_image_memory(VkImage image, image_data &data);
+
+   /**
+    * @brief Allocate a memory block.
+    *
+    * @param size             Size of the block.
+    * @param memory_type      Memory type of the block.
+    * @param dedicated_image  Image the block is dedicated to, or VK_NULL_HANDLE.
+    * @param[out] block       The allocated block, with one reference.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult allocate_memory_block(VkDeviceSize size, uint32_t memory_type, VkImage dedicated_image,
+                                  image_memory_block *&block);
+
+   /**
+    * @brief Drop a reference to a memory block, freeing it once the last reference is gone.
+    */
+   void release_memory_block(image_memory_block *block);
+
+   /**
+    * @brief Memory properties of the physical device.
+    */
+   VkPhysicalDeviceMemoryProperties2 m_memory_props;
+
+   /**
+    * @brief Number of images the next memory block is sized for.
+    *
+    * All the images are sub-allocated from one block when they are allocated at creation. Images allocated on first
+    * acquire, or possibly taken over from the ancestor, get blocks of their own as their number is not known.
+    */
+   size_t m_memory_block_images;
+
+   /**
+    * @brief Block the next images are sub-allocated from, the swapchain holds a reference to it until it is full.
+    */
+   image_memory_block *m_memory_block;
+
+   /**
+    * @brief Offset of the free space in @ref m_memory_block.
+    */
+   VkDeviceSize m_memory_block_offset;
+
+   /**
+    * @brief Wait for the virtual vertical blank an image is latched on.
+    *
+    * @param pending_present Information on the pending present request.
+    *
+    * @return The vertical blank the image was latched on.
+    */
+   vsync_event wait_for_latch(const pending_present_request &pending_present);
+
+   /**
+    * @brief Virtual vertical blanking clock pacing the presentations, if one was requested.
+    */
+   std::optional<vsync_clock> m_vsync_clock;
+
+   /**
+    * @brief MSC of the vertical blank the last image was latched on. Only accessed by the presentation thread.
+    */
+   std::optional<uint64_t> m_last_latch_msc;
+
+   /**
+    * @brief Capture of the presented frames, if it was requested.
+    */
+   util::unique_ptr<frame_capture> m_frame_capture;
+
+   /**
+    * @brief Whether present_image waits for the present payload, when it is called during vkQueuePresent and the
+    *        present id or the timing it reports must only be known once the image is rendered.
+    */
+   bool m_wait_payload_on_present;
 };
 
 } /* namespace headless */
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file vsync_clock.cpp
+ *
+ * @brief Contains the implementation of the virtual vertical blanking clock.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+
+#include "vsync_clock.hpp"
+
+#include <util/log.hpp>
+
+namespace wsi
+{
+namespace headless
+{
+
+/**
+ * @brief Highest refresh rate that can be requested, in Hz.
+ */
+static constexpr unsigned long max_refresh_rate = 1000;
+
+static constexpr uint64_t ns_per_second = 1000000000ull;
+
+vsync_clock::vsync_clock(uint64_t refresh_duration_ns, uint64_t epoch_ns)
+   : m_refresh_duration_ns(refresh_duration_ns)
+   , m_epoch_ns(epoch_ns)
+{
+}
+
+std::optional<vsync_clock> vsync_clock::create_from_environment()
+{
+   const char *env = std::getenv("WSI_HEADLESS_REFRESH_RATE");
+   if (env == nullptr)
+   {
+      return std::nullopt;
+   }
+
+   char *end = nullptr;
+   errno = 0;
+   const unsigned long refresh_rate = std::strtoul(env, &end, 10);
+   if (errno != 0 || end == env || *end != '\0' || refresh_rate > max_refresh_rate)
+   {
+      WSI_LOG_WARNING("Invalid WSI_HEADLESS_REFRESH_RATE \"%s\", presentations are not paced.", env);
+      return std::nullopt;
+   }
+
+   if (refresh_rate == 0)
+   {
+      return std::nullopt;
+   }
+
+   return vsync_clock(ns_per_second / refresh_rate, now());
+}
+
+uint64_t vsync_clock::now()
+{
+   timespec ts = {};
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return static_cast<uint64_t>(ts.tv_sec) * ns_per_second + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+vsync_event vsync_clock::get_next_vsync(uint64_t time_ns) const
+{
+   if (time_ns <= m_epoch_ns)
+   {
+      return { 0, m_epoch_ns };
+   }
+
+   /* Round up to the next vertical blank. */
+   const uint64_t msc = (time_ns - m_epoch_ns + m_refresh_duration_ns - 1) / m_refresh_duration_ns;
+   return { msc, m_epoch_ns + msc * m_refresh_duration_ns };
+}
+
+vsync_event vsync_clock::wait_for_vsync(uint64_t not_before_ns) const
+{
+   /* A vertical blank that is happening right now has already been missed. */
+   const uint64_t earliest = now() + 1;
+   const vsync_event vsync = get_next_vsync(not_before_ns > earliest ? not_before_ns : earliest);
+
+   timespec deadline = {};
+   deadline.tv_sec = static_cast<time_t>(vsync.time_ns / ns_per_second);
+   deadline.tv_nsec = static_cast<long>(vsync.time_ns % ns_per_second);
+   while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+   {
+   }
+
+   return vsync;
+}
+
+} /* namespace headless */
+} /* namespace wsi */
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file vsync_clock.hpp
+ *
+ * @brief Contains the virtual vertical blanking clock used to pace headless presentations.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+namespace wsi
+{
+namespace headless
+{
+
+/**
+ * @brief A vertical blank of the virtual display.
+ */
+struct vsync_event
+{
+   /* Number of vertical blanks since the clock was created, similar to a media stream counter. */
+   uint64_t msc;
+
+   /* CLOCK_MONOTONIC time of the vertical blank in nanoseconds. */
+   uint64_t time_ns;
+};
+
+/**
+ * @brief Virtual vertical blanking clock.
+ *
+ * Vertical blanks happen every refresh duration from the creation of the clock, on CLOCK_MONOTONIC. The refresh rate
+ * is selected in Hz with the WSI_HEADLESS_REFRESH_RATE environment variable, presentations are not paced when it is
+ * not set or set to 0.
+ */
+class vsync_clock
+{
+public:
+   /**
+    * @brief Create a clock for the refresh rate requested in the environment.
+    *
+    * @return The clock, or std::nullopt when presentations should not be paced.
+    */
+   static std::optional<vsync_clock> create_from_environment();
+
+   /**
+    * @brief Get the first vertical blank at or after a time, without waiting for it.
+    *
+    * @param time_ns CLOCK_MONOTONIC time in nanoseconds.
+    */
+   vsync_event get_next_vsync(uint64_t time_ns) const;
+
+   /**
+    * @brief Sleep until the first vertical blank at or after a time.
+    *
+    * @param not_before_ns CLOCK_MONOTONIC time in nanoseconds the vertical blank must not precede, 0 to wait for the
+    *                      next vertical blank.
+    *
+    * @return The vertical blank that was waited for.
+    */
+   vsync_event wait_for_vsync(uint64_t not_before_ns) const;
+
+   /**
+    * @brief Get the duration of a refresh cycle in nanoseconds.
+    */
+   uint64_t get_refresh_duration() const
+   {
+      return m_refresh_duration_ns;
+   }
+
+   /**
+    * @brief Get the current CLOCK_MONOTONIC time in nanoseconds.
+    */
+   static uint64_t now();
+
+private:
+   vsync_clock(uint64_t refresh_duration_ns, uint64_t epoch_ns);
+
+   /* Duration between two vertical blanks. */
+   uint64_t m_refresh_duration_ns;
+
+   /* Time of the vertical blank with an MSC of 0. */
+   uint64_t m_epoch_ns;
+};
+
+} /* namespace headless */
+} /* namespace wsi */
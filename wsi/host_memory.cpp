@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file host_memory.cpp
+ *
+ * @brief Contains the binding of swapchain images to host memory shared with the presentation engine.
+ */
+
+#include <algorithm>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "host_memory.hpp"
+
+#include <util/allocation_tracker.hpp>
+#include <util/log.hpp>
+
+namespace wsi
+{
+
+host_memory::host_memory(const VkDevice &device, const util::allocator &allocator)
+   : m_device(device)
+   , m_allocator(allocator)
+{
+}
+
+host_memory::~host_memory()
+{
+   if (m_memory != VK_NULL_HANDLE)
+   {
+      auto &device_data = layer::device_private_data::get(m_device);
+      device_data.disp.FreeMemory(m_device, m_memory, m_allocator.get_original_callbacks());
+   }
+   if (m_map != nullptr)
+   {
+      munmap(m_map, m_size);
+   }
+}
+
+bool host_memory::is_supported(const layer::device_private_data &device_data)
+{
+   return device_data.is_device_extension_enabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+}
+
+bool host_memory::is_image_supported(const layer::device_private_data &device_data,
+                                     const VkImageCreateInfo &image_create_info)
+{
+   VkPhysicalDeviceExternalImageFormatInfoKHR external_info = {};
+   external_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO_KHR;
+   external_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+   VkPhysicalDeviceImageFormatInfo2KHR image_info = {};
+   image_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2_KHR;
+   image_info.pNext = &external_info;
+   image_info.format = image_create_info.format;
+   image_info.type = image_create_info.imageType;
+   image_info.tiling = VK_IMAGE_TILING_LINEAR;
+   image_info.usage = image_create_info.usage;
+   image_info.flags = image_create_info.flags;
+
+   VkExternalImageFormatPropertiesKHR external_props = {};
+   external_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES_KHR;
+   VkImageFormatProperties2KHR format_props = {};
+   format_props.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2_KHR;
+   format_props.pNext = &external_props;
+
+   if (device_data.instance_data.disp.GetPhysicalDeviceImageFormatProperties2KHR(
+          device_data.physical_device, &image_info, &format_props) != VK_SUCCESS)
+   {
+      return false;
+   }
+
+   const VkExtent3D &max_extent = format_props.imageFormatProperties.maxExtent;
+   return (external_props.externalMemoryProperties.externalMemoryFeatures &
+           VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT) != 0 &&
+          image_create_info.extent.width <= max_extent.width && image_create_info.extent.height <= max_extent.height &&
+          image_create_info.arrayLayers <= format_props.imageFormatProperties.maxArrayLayers;
+}
+
+void host_memory::fill_image_create_info(VkImageCreateInfo &image_create_info,
+                                         VkExternalMemoryImageCreateInfoKHR &external_info)
+{
+   external_info = {};
+   external_info.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO_KHR;
+   external_info.pNext = image_create_info.pNext;
+   external_info.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+   image_create_info.pNext = &external_info;
+   /* The presentation engine reads the memory as packed rows of pixels. */
+   image_create_info.tiling = VK_IMAGE_TILING_LINEAR;
+}
+
+/**
+ * @brief Get the alignment of host memory imported into the device, which is at least the page size.
+ */
+static VkDeviceSize get_import_alignment(const layer::device_private_data &device_data)
+{
+   VkPhysicalDeviceExternalMemoryHostPropertiesEXT host_props = {};
+   host_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+   VkPhysicalDeviceProperties2KHR props = {};
+   props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+   props.pNext = &host_props;
+   device_data.instance_data.disp.GetPhysicalDeviceProperties2KHR(device_data.physical_device, &props);
+
+   const long page_size = sysconf(_SC_PAGESIZE);
+   return std::max<VkDeviceSize>(host_props.minImportedHostPointerAlignment,
+                                 page_size > 0 ? static_cast<VkDeviceSize>(page_size) : 1);
+}
+
+VkResult host_memory::allocate(const VkMemoryRequirements &requirements)
+{
+   auto &device_data = layer::device_private_data::get(m_device);
+
+   const VkDeviceSize alignment = std::max(get_import_alignment(device_data), requirements.alignment);
+   m_size = static_cast<size_t>((requirements.size + alignment - 1) / alignment * alignment);
+
+   m_fd = util::fd_owner{ memfd_create("wsi-shm", MFD_CLOEXEC) };
+   if (!m_fd.is_valid() || ftruncate(m_fd.get(), static_cast<off_t>(m_size)) != 0)
+   {
+      WSI_LOG_ERROR("Failed to create the shared memory of an image.");
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   void *map = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd.get(), 0);
+   if (map == MAP_FAILED)
+   {
+      WSI_LOG_ERROR("Failed to map the shared memory of an image.");
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   m_map = map;
+
+   VkMemoryHostPointerPropertiesEXT pointer_props = {};
+   pointer_props.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+   TRY_LOG(device_data.disp.GetMemoryHostPointerPropertiesEXT(
+              m_device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, m_map, &pointer_props),
+           "Failed to query the properties of the shared memory of an image");
+
+   /* The presentation engine reads the memory without any Vulkan synchronization, so it must be coherent. */
+   VkPhysicalDeviceMemoryProperties2 memory_props = {};
+   memory_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+   device_data.instance_data.disp.GetPhysicalDeviceMemoryProperties2KHR(device_data.physical_device, &memory_props);
+   const VkPhysicalDeviceMemoryProperties &props = memory_props.memoryProperties;
+
+   const uint32_t type_bits = pointer_props.memoryTypeBits & requirements.memoryTypeBits;
+   uint32_t type_index = 0;
+   while (type_index < props.memoryTypeCount &&
+          ((type_bits & (1u << type_index)) == 0 ||
+           (props.memoryTypes[type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0))
+   {
+      type_index++;
+   }
+   if (type_index == props.memoryTypeCount)
+   {
+      WSI_LOG_ERROR("No coherent memory type can import the shared memory of an image.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   VkImportMemoryHostPointerInfoEXT import_info = {};
+   import_info.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+   import_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+   import_info.pHostPointer = m_map;
+
+   VkMemoryAllocateInfo alloc_info = {};
+   alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+   alloc_info.pNext = &import_info;
+   alloc_info.allocationSize = m_size;
+   alloc_info.memoryTypeIndex = type_index;
+   TRY_LOG(device_data.disp.AllocateMemory(m_device, &alloc_info, m_allocator.get_original_callbacks(), &m_memory),
+           "Failed to import the shared memory of an image");
+   WSI_TRACK_DEVICE_ALLOCATION(m_size);
+
+   return VK_SUCCESS;
+}
+
+VkResult host_memory::allocate_and_bind(VkImage image)
+{
+   auto &device_data = layer::device_private_data::get(m_device);
+
+   VkMemoryRequirements requirements;
+   device_data.disp.GetImageMemoryRequirements(m_device, image, &requirements);
+
+   const VkImageSubresource subresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
+   device_data.disp.GetImageSubresourceLayout(m_device, image, &subresource, &m_layout);
+
+   TRY_LOG_CALL(allocate(requirements));
+   return bind(image);
+}
+
+VkResult host_memory::allocate_and_bind_buffer(VkBuffer buffer, VkDeviceSize row_pitch)
+{
+   auto &device_data = layer::device_private_data::get(m_device);
+
+   VkMemoryRequirements requirements;
+   device_data.disp.GetBufferMemoryRequirements(m_device, buffer, &requirements);
+
+   m_layout = {};
+   m_layout.rowPitch = row_pitch;
+   m_layout.size = requirements.size;
+
+   TRY_LOG_CALL(allocate(requirements));
+   return device_data.disp.BindBufferMemory(m_device, buffer, m_memory, 0);
+}
+
+VkResult host_memory::bind(VkImage image)
+{
+   auto &device_data = layer::device_private_data::get(m_device);
+   return device_data.disp.BindImageMemory(m_device, image, m_memory, 0);
+}
+
+} /* namespace wsi */
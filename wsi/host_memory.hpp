@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file host_memory.hpp
+ *
+ * @brief Contains the binding of swapchain images to host memory shared with the presentation engine.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include <vulkan/vulkan.h>
+
+#include <layer/private_data.hpp>
+#include <util/custom_allocator.hpp>
+#include <util/file_descriptor.hpp>
+#include <util/helpers.hpp>
+
+namespace wsi
+{
+
+/**
+ * @brief Host memory bound to a linear swapchain image and shared with the presentation engine.
+ *
+ * Used to present without DMA-BUF, through X11 MIT-SHM or Wayland wl_shm. The memory is a memfd mapping imported with
+ * VK_EXT_external_memory_host, so the device renders straight into the pages the presentation engine reads from.
+ * Devices that cannot render to linear images in imported host memory copy the images into a buffer bound to it
+ * instead, see @ref prime_copy.
+ */
+class host_memory : private util::noncopyable
+{
+public:
+   host_memory(const VkDevice &device, const util::allocator &allocator);
+   ~host_memory();
+
+   /**
+    * @brief Check whether swapchain images can be bound to shared host memory.
+    *
+    * @param device_data The device of the swapchain.
+    */
+   static bool is_supported(const layer::device_private_data &device_data);
+
+   /**
+    * @brief Check whether the device can render to a linear image bound to shared host memory.
+    *
+    * When it cannot, the images have to be copied into shared host memory bound to a buffer instead, see
+    * @ref allocate_and_bind_buffer.
+    *
+    * @param device_data       The device of the swapchain.
+    * @param image_create_info The create info of the swapchain image.
+    */
+   static bool is_image_supported(const layer::device_private_data &device_data,
+                                  const VkImageCreateInfo &image_create_info);
+
+   /**
+    * @brief Fill the create info of a swapchain image that is bound to shared host memory.
+    *
+    * @param[in,out] image_create_info The create info, its pNext chain is extended with @p external_info.
+    * @param[out]    external_info     Storage for the external memory info, must outlive @p image_create_info.
+    */
+   static void fill_image_create_info(VkImageCreateInfo &image_create_info,
+                                      VkExternalMemoryImageCreateInfoKHR &external_info);
+
+   /**
+    * @brief Allocate the shared memory of an image and bind the image to it.
+    *
+    * @param image The image, created with @ref fill_image_create_info.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult allocate_and_bind(VkImage image);
+
+   /**
+    * @brief Allocate the shared memory of a buffer holding the linear copy of an image and bind the buffer to it.
+    *
+    * @param buffer    The buffer, created with the VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT handle type.
+    * @param row_pitch Size of the rows of the image in the buffer, in bytes.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult allocate_and_bind_buffer(VkBuffer buffer, VkDeviceSize row_pitch);
+
+   /**
+    * @brief Bind an image created with VkImageSwapchainCreateInfoKHR to the memory.
+    */
+   VkResult bind(VkImage image);
+
+   /**
+    * @brief Get the file descriptor of the memory, to be shared with the presentation engine.
+    */
+   int get_fd() const
+   {
+      return m_fd.get();
+   }
+
+   /**
+    * @brief Get the size of the memory, in bytes.
+    */
+   size_t get_size() const
+   {
+      return m_size;
+   }
+
+   /**
+    * @brief Get the layout of the image in the memory.
+    */
+   const VkSubresourceLayout &get_layout() const
+   {
+      return m_layout;
+   }
+
+private:
+   /**
+    * @brief Create, map and import the shared memory.
+    *
+    * @param requirements The memory requirements of the image or buffer bound to the memory.
+    */
+   VkResult allocate(const VkMemoryRequirements &requirements);
+
+   const VkDevice m_device;
+   const util::allocator m_allocator;
+
+   util::fd_owner m_fd;
+   void *m_map{ nullptr };
+   size_t m_size{ 0 };
+   VkDeviceMemory m_memory{ VK_NULL_HANDLE };
+   VkSubresourceLayout m_layout{};
+};
+
+} /* namespace wsi */
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file image_count_governor.cpp
+ *
+ * @brief Contains the implementation for adapting the number of images applications can use to their latency.
+ */
+
+#include "image_count_governor.hpp"
+
+#include <time.h>
+
+namespace wsi
+{
+
+/**
+ * @brief Number of acquires measured before the limit is updated.
+ */
+static constexpr uint32_t WINDOW_ACQUIRES = 60;
+
+/**
+ * @brief Longest interval between presents that is taken as the presentation rate, longer ones are pauses.
+ */
+static constexpr uint64_t MAX_PRESENT_INTERVAL_NS = 1000000000;
+
+/**
+ * @brief Number of windows the limit is kept after a lower limit slowed the frame rate down.
+ */
+static constexpr uint32_t BACKOFF_WINDOWS = 16;
+
+uint64_t image_count_governor::now()
+{
+   timespec time = {};
+   clock_gettime(CLOCK_MONOTONIC, &time);
+   return static_cast<uint64_t>(time.tv_sec) * 1000000000ull + static_cast<uint64_t>(time.tv_nsec);
+}
+
+void image_count_governor::enable(uint32_t image_count)
+{
+   m_image_count = image_count;
+   m_limit = image_count;
+}
+
+void image_count_governor::record_present_complete(uint64_t time_ns)
+{
+   const uint64_t last_present_ns = m_last_present_ns.exchange(time_ns, std::memory_order_relaxed);
+   if (last_present_ns == 0 || time_ns - last_present_ns > MAX_PRESENT_INTERVAL_NS)
+   {
+      return;
+   }
+
+   m_present_interval_sum_ns.fetch_add(time_ns - last_present_ns, std::memory_order_relaxed);
+   m_present_count.fetch_add(1, std::memory_order_release);
+}
+
+void image_count_governor::record_acquire(uint64_t wait_ns)
+{
+   m_window_wait_ns += wait_ns;
+   if (++m_window_acquires < WINDOW_ACQUIRES)
+   {
+      return;
+   }
+
+   const uint64_t present_count = m_present_count.load(std::memory_order_acquire);
+   const uint64_t interval_sum_ns = m_present_interval_sum_ns.load(std::memory_order_relaxed);
+   const uint64_t window_presents = present_count - m_window_start_presents;
+
+   /* Windows where the application mostly did not present, e.g. while minimized, say nothing about its latency. */
+   if (window_presents >= WINDOW_ACQUIRES / 2)
+   {
+      evaluate_window((interval_sum_ns - m_window_start_interval_ns) / window_presents, m_window_wait_ns);
+   }
+
+   m_window_acquires = 0;
+   m_window_wait_ns = 0;
+   m_window_start_presents = present_count;
+   m_window_start_interval_ns = interval_sum_ns;
+}
+
+void image_count_governor::evaluate_window(uint64_t frame_interval_ns, uint64_t wait_ns)
+{
+   if (m_interval_before_lowering_ns != 0)
+   {
+      const uint64_t interval_before_ns = m_interval_before_lowering_ns;
+      m_interval_before_lowering_ns = 0;
+
+      /* More than 5% slower than with one more image: the application was starved of images. */
+      if (frame_interval_ns > interval_before_ns + interval_before_ns / 20)
+      {
+         m_limit++;
+         m_backoff_windows = BACKOFF_WINDOWS;
+         return;
+      }
+   }
+
+   if (m_backoff_windows > 0)
+   {
+      m_backoff_windows--;
+      return;
+   }
+
+   /* Waiting for images for over 10% of the frame time means frames are queued faster than they are presented, so
+    * the queue is deeper than the application needs. */
+   if (m_limit > MIN_IMAGE_LIMIT && wait_ns * 10 > frame_interval_ns * WINDOW_ACQUIRES)
+   {
+      m_interval_before_lowering_ns = frame_interval_ns;
+      m_limit--;
+   }
+}
+
+} /* namespace wsi */
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file image_count_governor.hpp
+ *
+ * @brief Contains the class definition for adapting the number of images applications can use to their latency.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "util/helpers.hpp"
+
+namespace wsi
+{
+
+/**
+ * @brief Chooses how many of the swapchain images an application can have in use at once.
+ *
+ * Images in use are the ones acquired by the application, queued for presentation or displayed. Each image beyond
+ * what the application needs to keep its frame rate only adds a frame of latency, as frames then wait in the queue.
+ * The governor starts with all the images and, while the application spends a significant share of its frames
+ * waiting for images in acquire, lowers the limit one image at a time. A limit that slows the frame rate down is
+ * raised back and not probed again for a while.
+ *
+ * Acquires are recorded by the application thread holding the acquire lock of the swapchain, which is also the only
+ * thread updating the limit. Present completions are recorded by the thread presenting the images.
+ */
+class image_count_governor : private util::noncopyable
+{
+public:
+   /**
+    * @brief Fewest images the governor lets applications use: one displayed and one being rendered to.
+    */
+   static constexpr uint32_t MIN_IMAGE_LIMIT = 2;
+
+   /**
+    * @brief Get the current time.
+    *
+    * @return The CLOCK_MONOTONIC time in nanoseconds.
+    */
+   static uint64_t now();
+
+   /**
+    * @brief Start governing a swapchain.
+    *
+    * @param image_count Number of images of the swapchain.
+    */
+   void enable(uint32_t image_count);
+
+   /**
+    * @brief Whether the governor is enabled for the swapchain.
+    */
+   bool is_enabled() const
+   {
+      return m_image_count != 0;
+   }
+
+   /**
+    * @brief Get the number of images the application can have in use.
+    */
+   uint32_t get_limit() const
+   {
+      return m_limit;
+   }
+
+   /**
+    * @brief Record an acquire and update the limit at the end of each measurement window.
+    *
+    * @param wait_ns Time the application waited for a free image.
+    */
+   void record_acquire(uint64_t wait_ns);
+
+   /**
+    * @brief Record that an image was handed over to the presentation engine.
+    *
+    * @param time_ns Time the image was presented, as returned by @ref now.
+    */
+   void record_present_complete(uint64_t time_ns);
+
+private:
+   /**
+    * @brief Update the limit from the measurements of a window.
+    *
+    * @param frame_interval_ns Mean interval between the presents of the window.
+    * @param wait_ns           Total time waited in acquire over the window.
+    */
+   void evaluate_window(uint64_t frame_interval_ns, uint64_t wait_ns);
+
+   uint32_t m_image_count{ 0 };
+   uint32_t m_limit{ 0 };
+
+   /* Measurements of the current window, updated by the application thread. */
+   uint32_t m_window_acquires{ 0 };
+   uint64_t m_window_wait_ns{ 0 };
+   uint64_t m_window_start_presents{ 0 };
+   uint64_t m_window_start_interval_ns{ 0 };
+
+   /* Mean frame interval of the window before the last time the limit was lowered, 0 if it was not just lowered. */
+   uint64_t m_interval_before_lowering_ns{ 0 };
+   /* Number of windows to wait before lowering the limit again. */
+   uint32_t m_backoff_windows{ 0 };
+
+   /* Present completions, updated by the presenting thread. */
+   std::atomic<uint64_t> m_present_count{ 0 };
+   std::atomic<uint64_t> m_present_interval_sum_ns{ 0 };
+   std::atomic<uint64_t> m_last_present_ns{ 0 };
+};
+
+} /* namespace wsi */
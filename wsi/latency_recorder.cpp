@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file latency_recorder.cpp
+ *
+ * @brief Contains the implementation for recording the latency of the presentation stages of a swapchain.
+ */
+
+#include "latency_recorder.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <time.h>
+
+#include "util/log.hpp"
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+
+namespace wsi
+{
+
+uint64_t latency_recorder::now()
+{
+   struct timespec ts = {};
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+/**
+ * @brief Get the histogram bucket of a duration, the base 2 logarithm of the duration in microseconds.
+ */
+static size_t get_bucket(uint64_t duration_ns)
+{
+   const uint64_t duration_us = duration_ns / 1000;
+   if (duration_us == 0)
+   {
+      return 0;
+   }
+
+   const size_t bucket = static_cast<size_t>(63 - __builtin_clzll(duration_us));
+   return std::min(bucket, static_cast<size_t>(VK_SWAPCHAIN_LATENCY_HISTOGRAM_BUCKET_COUNT_ARM - 1));
+}
+
+void latency_recorder::record(stage recorded_stage, uint64_t start_ns, uint64_t end_ns)
+{
+   if (start_ns == 0 || end_ns < start_ns)
+   {
+      return;
+   }
+
+   const uint64_t duration = end_ns - start_ns;
+   auto &hist = m_histograms[static_cast<size_t>(recorded_stage)];
+   hist.buckets[get_bucket(duration)].fetch_add(1, std::memory_order_relaxed);
+   hist.total_duration.fetch_add(duration, std::memory_order_relaxed);
+
+   uint64_t max_duration = hist.max_duration.load(std::memory_order_relaxed);
+   while (duration > max_duration &&
+          !hist.max_duration.compare_exchange_weak(max_duration, duration, std::memory_order_relaxed))
+   {
+   }
+
+   hist.sample_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void latency_recorder::record_frame(uint64_t time_ns)
+{
+   if (m_frame_count.fetch_add(1, std::memory_order_relaxed) == 0)
+   {
+      m_first_frame_ns.store(time_ns, std::memory_order_relaxed);
+   }
+   m_last_frame_ns.store(time_ns, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Get an upper bound of a percentile of a histogram.
+ *
+ * @return The upper bound in microseconds of the bucket holding the percentile, or 0 if the histogram is empty.
+ */
+static uint64_t get_percentile_us(const VkSwapchainLatencyHistogramARM &hist, uint64_t percent)
+{
+   uint64_t total = 0;
+   for (uint64_t count : hist.buckets)
+   {
+      total += count;
+   }
+
+   const uint64_t target = (total * percent + 99) / 100;
+   uint64_t cumulative = 0;
+   for (size_t i = 0; i < VK_SWAPCHAIN_LATENCY_HISTOGRAM_BUCKET_COUNT_ARM && total != 0; ++i)
+   {
+      cumulative += hist.buckets[i];
+      if (cumulative >= target)
+      {
+         return 1ULL << (i + 1);
+      }
+   }
+
+   return 0;
+}
+
+void latency_recorder::log_summary(const void *swapchain) const
+{
+   const uint64_t frame_count = m_frame_count.load(std::memory_order_relaxed);
+   if (frame_count == 0)
+   {
+      return;
+   }
+
+   VkSwapchainLatencyHistogramsARM histograms{};
+   get_histograms(histograms);
+
+   const uint64_t elapsed_ns =
+      m_last_frame_ns.load(std::memory_order_relaxed) - m_first_frame_ns.load(std::memory_order_relaxed);
+   const double frames_per_second = elapsed_ns != 0 ? (frame_count - 1) * 1e9 / static_cast<double>(elapsed_ns) : 0.0;
+
+   WSI_LOG_INFO("Swapchain %p presented %" PRIu64 " frames at %.1f frames/s. Latency upper bounds in us (p50/p99): "
+                "acquire wait %" PRIu64 "/%" PRIu64 ", GPU wait %" PRIu64 "/%" PRIu64
+                ", present to display %" PRIu64 "/%" PRIu64 ".",
+                swapchain, frame_count, frames_per_second, get_percentile_us(histograms.acquireWait, 50),
+                get_percentile_us(histograms.acquireWait, 99), get_percentile_us(histograms.gpuWait, 50),
+                get_percentile_us(histograms.gpuWait, 99), get_percentile_us(histograms.presentToDisplay, 50),
+                get_percentile_us(histograms.presentToDisplay, 99));
+}
+
+void latency_recorder::histogram::read(VkSwapchainLatencyHistogramARM &out) const
+{
+   out.sampleCount = sample_count.load(std::memory_order_relaxed);
+   out.totalDuration = total_duration.load(std::memory_order_relaxed);
+   out.maxDuration = max_duration.load(std::memory_order_relaxed);
+   for (size_t i = 0; i < buckets.size(); ++i)
+   {
+      out.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+   }
+}
+
+void latency_recorder::get_histograms(VkSwapchainLatencyHistogramsARM &histograms) const
+{
+   m_histograms[static_cast<size_t>(stage::acquire_wait)].read(histograms.acquireWait);
+   m_histograms[static_cast<size_t>(stage::gpu_wait)].read(histograms.gpuWait);
+   m_histograms[static_cast<size_t>(stage::present_to_display)].read(histograms.presentToDisplay);
+}
+
+} /* namespace wsi */
+
+#endif /* VULKAN_WSI_LAYER_EXPERIMENTAL */
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file latency_recorder.hpp
+ *
+ * @brief Contains the class definition for recording the latency of the presentation stages of a swapchain.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "layer/wsi_layer_experimental.hpp"
+#include "util/helpers.hpp"
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+
+namespace wsi
+{
+
+/**
+ * @brief Accumulates histograms of the durations of the presentation stages of a swapchain.
+ *
+ * Recording a duration only takes a few relaxed atomic increments, so it can be done from the application thread and
+ * the presentation thread concurrently without locking. Readers get a snapshot that may be slightly torn across
+ * buckets, which is acceptable for monitoring.
+ */
+class latency_recorder : private util::noncopyable
+{
+public:
+   enum class stage
+   {
+      acquire_wait,
+      gpu_wait,
+      present_to_display,
+      count,
+   };
+
+   /**
+    * @brief Get the current time.
+    *
+    * @return The CLOCK_MONOTONIC time in nanoseconds.
+    */
+   static uint64_t now();
+
+   /**
+    * @brief Record the duration of a stage.
+    *
+    * @param recorded_stage The stage the duration belongs to.
+    * @param start_ns       Time the stage started, as returned by @ref now. Ignored if 0.
+    * @param end_ns         Time the stage ended, as returned by @ref now.
+    */
+   void record(stage recorded_stage, uint64_t start_ns, uint64_t end_ns);
+
+   /**
+    * @brief Record that a frame was handed over to the display.
+    *
+    * @param time_ns Time the frame was presented, as returned by @ref now.
+    */
+   void record_frame(uint64_t time_ns);
+
+   /**
+    * @brief Log the frame rate and the p50/p99 latency of each stage recorded so far.
+    *
+    * @param swapchain The swapchain the recorder belongs to, used to identify the summary.
+    */
+   void log_summary(const void *swapchain) const;
+
+   /**
+    * @brief Copy the histograms recorded so far.
+    *
+    * @param histograms Output structure filled with the histograms.
+    */
+   void get_histograms(VkSwapchainLatencyHistogramsARM &histograms) const;
+
+private:
+   struct histogram
+   {
+      std::atomic<uint64_t> sample_count{ 0 };
+      std::atomic<uint64_t> total_duration{ 0 };
+      std::atomic<uint64_t> max_duration{ 0 };
+      std::array<std::atomic<uint64_t>, VK_SWAPCHAIN_LATENCY_HISTOGRAM_BUCKET_COUNT_ARM> buckets{};
+
+      void read(VkSwapchainLatencyHistogramARM &out) const;
+   };
+
+   std::array<histogram, static_cast<size_t>(stage::count)> m_histograms;
+
+   /* Number of frames presented and the times of the first and last ones, only updated by the presentation thread. */
+   std::atomic<uint64_t> m_frame_count{ 0 };
+   std::atomic<uint64_t> m_first_frame_ns{ 0 };
+   std::atomic<uint64_t> m_last_frame_ns{ 0 };
+};
+
+} /* namespace wsi */
+
+#endif /* VULKAN_WSI_LAYER_EXPERIMENTAL */
@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file presentation_worker_pool.cpp
+ *
+ * @brief Contains the implementation for the pool of presentation workers.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "util/log.hpp"
+
+#include "presentation_worker_pool.hpp"
+#include "swapchain_base.hpp"
+
+namespace wsi
+{
+
+presentation_worker_pool::presentation_worker_pool(const util::allocator &allocator)
+   : m_clients(allocator)
+   , m_run_queue(allocator)
+   , m_polled_clients(0)
+   , m_run(true)
+{
+}
+
+/* Interval at which the payload waiter re-checks present payloads that cannot be polled. */
+static constexpr int PAYLOAD_POLL_INTERVAL_MS = 1;
+
+/* Tag of the wake up event in the epoll set, the payload events carry their swapchain. */
+static constexpr uint64_t WAKE_UP_TAG = 0;
+
+util::unique_ptr<presentation_worker_pool> presentation_worker_pool::create(const util::allocator &allocator,
+                                                                             const util::thread_scheduling &scheduling)
+{
+   auto pool = allocator.make_unique<presentation_worker_pool>(allocator);
+   if (pool == nullptr)
+   {
+      return nullptr;
+   }
+
+   pool->m_payload_waiter_event_fd = util::fd_owner{ eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK) };
+   pool->m_epoll_fd = util::fd_owner{ epoll_create1(EPOLL_CLOEXEC) };
+   if (!pool->m_payload_waiter_event_fd.is_valid() || !pool->m_epoll_fd.is_valid())
+   {
+      WSI_LOG_ERROR("Failed to create the presentation worker events.");
+      return nullptr;
+   }
+
+   epoll_event wake_up_event = {};
+   wake_up_event.events = EPOLLIN;
+   wake_up_event.data.u64 = WAKE_UP_TAG;
+   if (epoll_ctl(pool->m_epoll_fd.get(), EPOLL_CTL_ADD, pool->m_payload_waiter_event_fd.get(), &wake_up_event) != 0)
+   {
+      WSI_LOG_ERROR("Failed to set up the presentation worker events: %s.", std::strerror(errno));
+      return nullptr;
+   }
+
+   try
+   {
+      pool->m_payload_waiter = util::start_thread("wsi-worker-wait", &scheduling,
+                                                  &presentation_worker_pool::payload_waiter_thread, pool.get());
+   }
+   catch (const std::system_error &)
+   {
+      WSI_LOG_ERROR("Failed to start the presentation payload waiter thread.");
+      return nullptr;
+   }
+   catch (const std::bad_alloc &)
+   {
+      WSI_LOG_ERROR("Failed to start the presentation payload waiter thread.");
+      return nullptr;
+   }
+
+   for (auto &worker : pool->m_workers)
+   {
+      try
+      {
+         worker = util::start_thread("wsi-worker", &scheduling, &presentation_worker_pool::worker_thread, pool.get());
+      }
+      catch (const std::system_error &)
+      {
+         WSI_LOG_ERROR("Failed to start a presentation worker thread.");
+         return nullptr;
+      }
+      catch (const std::bad_alloc &)
+      {
+         WSI_LOG_ERROR("Failed to start a presentation worker thread.");
+         return nullptr;
+      }
+   }
+
+   return pool;
+}
+
+presentation_worker_pool::~presentation_worker_pool()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      assert(m_clients.empty());
+      m_run = false;
+   }
+   m_work_available.notify_all();
+   if (m_payload_waiter_event_fd.is_valid())
+   {
+      wake_payload_waiter();
+   }
+
+   for (auto &worker : m_workers)
+   {
+      if (worker.joinable())
+      {
+         worker.join();
+      }
+   }
+   if (m_payload_waiter.joinable())
+   {
+      m_payload_waiter.join();
+   }
+}
+
+VkResult presentation_worker_pool::add_swapchain(swapchain_base *swapchain)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   assert(find_client(swapchain) == nullptr);
+
+   if (!m_run_queue.try_reserve(m_clients.size() + 1))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   if (!m_clients.try_push_back(client{ swapchain, false, false, false, false, -1 }))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   return VK_SUCCESS;
+}
+
+void presentation_worker_pool::remove_swapchain(swapchain_base *swapchain)
+{
+   {
+      std::unique_lock<std::mutex> lock(m_lock);
+      m_client_idle.wait(lock, [this, swapchain]() {
+         client *entry = find_client(swapchain);
+         assert(entry != nullptr);
+         return !entry->busy;
+      });
+
+      client *entry = find_client(swapchain);
+      if (entry->parked)
+      {
+         unpark(*entry);
+      }
+
+      m_run_queue.erase(std::remove(m_run_queue.begin(), m_run_queue.end(), swapchain), m_run_queue.end());
+      m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+                                     [swapchain](const client &client_entry) {
+                                        return client_entry.swapchain == swapchain;
+                                     }),
+                      m_clients.end());
+   }
+
+   /* No worker services the swapchain anymore, release the images of the requests that will never be presented. */
+   swapchain->drop_pending_requests();
+}
+
+void presentation_worker_pool::schedule(swapchain_base *swapchain)
+{
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      client *entry = find_client(swapchain);
+      assert(entry != nullptr);
+
+      if (entry->busy || entry->parked)
+      {
+         /* Only one worker may service a swapchain at a time, and requests are presented in order. The swapchain is
+          * queued again when the worker is done or the payload of the oldest request completes. */
+         entry->rescheduled = true;
+         return;
+      }
+      else if (entry->queued)
+      {
+         return;
+      }
+
+      enqueue(*entry);
+   }
+   m_work_available.notify_one();
+}
+
+presentation_worker_pool::client *presentation_worker_pool::find_client(swapchain_base *swapchain)
+{
+   auto it = std::find_if(m_clients.begin(), m_clients.end(),
+                          [swapchain](const client &entry) { return entry.swapchain == swapchain; });
+   return it != m_clients.end() ? &(*it) : nullptr;
+}
+
+void presentation_worker_pool::enqueue(client &entry)
+{
+   entry.queued = true;
+
+   /* Cannot fail, the capacity of the run queue is reserved when swapchains are added. */
+   bool res = m_run_queue.try_push_back(entry.swapchain);
+   assert(res);
+   UNUSED(res);
+}
+
+void presentation_worker_pool::park(client &entry, int wait_fd)
+{
+   entry.parked = true;
+   entry.wait_fd = -1;
+   if (wait_fd >= 0)
+   {
+      epoll_event payload_event = {};
+      payload_event.events = EPOLLIN;
+      payload_event.data.ptr = entry.swapchain;
+      if (epoll_ctl(m_epoll_fd.get(), EPOLL_CTL_ADD, wait_fd, &payload_event) == 0)
+      {
+         entry.wait_fd = wait_fd;
+      }
+      else
+      {
+         WSI_LOG_WARNING("Failed to add a present sync FD to the presentation worker events: %s.",
+                         std::strerror(errno));
+      }
+   }
+   if (entry.wait_fd < 0)
+   {
+      m_polled_clients++;
+   }
+   wake_payload_waiter();
+}
+
+void presentation_worker_pool::unpark(client &entry)
+{
+   if (entry.wait_fd >= 0)
+   {
+      epoll_ctl(m_epoll_fd.get(), EPOLL_CTL_DEL, entry.wait_fd, nullptr);
+      entry.wait_fd = -1;
+   }
+   else
+   {
+      assert(m_polled_clients > 0);
+      m_polled_clients--;
+   }
+   entry.parked = false;
+}
+
+void presentation_worker_pool::wake_payload_waiter()
+{
+   const uint64_t value = 1;
+   ssize_t res = write(m_payload_waiter_event_fd.get(), &value, sizeof(value));
+   /* The write can only fail if the counter would overflow, which still leaves the waiter woken up. */
+   UNUSED(res);
+}
+
+void presentation_worker_pool::payload_waiter_thread()
+{
+   std::array<epoll_event, 16> events = {};
+   std::unique_lock<std::mutex> lock(m_lock);
+   while (m_run)
+   {
+      const int timeout = m_polled_clients > 0 ? PAYLOAD_POLL_INTERVAL_MS : -1;
+      lock.unlock();
+      int event_count = 0;
+      do
+      {
+         event_count = epoll_wait(m_epoll_fd.get(), events.data(), static_cast<int>(events.size()), timeout);
+      } while (event_count == -1 && errno == EINTR);
+      lock.lock();
+
+      bool work_queued = false;
+      for (int i = 0; i < event_count; i++)
+      {
+         if (events[i].data.u64 == WAKE_UP_TAG)
+         {
+            uint64_t value = 0;
+            ssize_t res = read(m_payload_waiter_event_fd.get(), &value, sizeof(value));
+            UNUSED(res);
+            continue;
+         }
+
+         /* The swapchain may have been removed, or parked again for another request, since the event was read. */
+         client *entry = find_client(static_cast<swapchain_base *>(events[i].data.ptr));
+         if (entry != nullptr && entry->parked && entry->wait_fd >= 0)
+         {
+            unpark(*entry);
+            enqueue(*entry);
+            work_queued = true;
+         }
+      }
+
+      /* Payloads that cannot be polled are re-checked by a worker, which parks the swapchain again if needed. */
+      if (m_polled_clients > 0)
+      {
+         for (auto &entry : m_clients)
+         {
+            if (entry.parked && entry.wait_fd < 0)
+            {
+               unpark(entry);
+               enqueue(entry);
+               work_queued = true;
+            }
+         }
+      }
+
+      if (work_queued)
+      {
+         m_work_available.notify_all();
+      }
+   }
+}
+
+void presentation_worker_pool::worker_thread()
+{
+   std::unique_lock<std::mutex> lock(m_lock);
+   while (true)
+   {
+      m_work_available.wait(lock, [this]() { return !m_run || !m_run_queue.empty(); });
+      if (!m_run)
+      {
+         break;
+      }
+
+      swapchain_base *swapchain = m_run_queue.front();
+      m_run_queue.erase(m_run_queue.begin());
+
+      client *entry = find_client(swapchain);
+      assert(entry != nullptr);
+      entry->queued = false;
+      entry->busy = true;
+      entry->rescheduled = false;
+
+      /* Present one request at a time so that the workers are shared fairly between swapchains. */
+      lock.unlock();
+      int wait_fd = -1;
+      const pool_present_status status = swapchain->present_pending_request(wait_fd);
+      lock.lock();
+
+      /* The client list may have been modified while presenting. */
+      entry = find_client(swapchain);
+      assert(entry != nullptr);
+      entry->busy = false;
+      if (status == pool_present_status::payload_pending)
+      {
+         park(*entry, wait_fd);
+      }
+      else if (status == pool_present_status::more_requests || entry->rescheduled)
+      {
+         enqueue(*entry);
+         m_work_available.notify_one();
+      }
+      m_client_idle.notify_all();
+   }
+}
+
+} /* namespace wsi */
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file presentation_worker_pool.hpp
+ *
+ * @brief Contains the class definition for a pool of presentation workers shared by the swapchains of a device.
+ */
+
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <vulkan/vulkan.h>
+
+#include "util/custom_allocator.hpp"
+#include "util/file_descriptor.hpp"
+#include "util/helpers.hpp"
+#include "util/thread.hpp"
+
+#ifndef WSI_PRESENTATION_WORKER_POOL_SIZE
+#define WSI_PRESENTATION_WORKER_POOL_SIZE 2
+#endif
+
+namespace wsi
+{
+
+class swapchain_base;
+
+/**
+ * @brief Outcome of servicing a swapchain on a worker, see @ref swapchain_base::present_pending_request.
+ */
+enum class pool_present_status
+{
+   /* No more present requests are pending. */
+   idle,
+   /* A request was presented or dropped, and more are pending. */
+   more_requests,
+   /* The present payload of the oldest request has not completed yet. */
+   payload_pending,
+};
+
+/**
+ * @brief A bounded pool of threads that present the queued images of any number of swapchains.
+ *
+ * When a swapchain uses the pool it does not start its own page flip thread. Instead, every time it queues a present
+ * request it schedules itself with @ref schedule and one of the workers presents the oldest pending request of the
+ * swapchain. A swapchain is only ever serviced by one worker at a time, so the requests of a swapchain are presented
+ * in order, while the number of threads does not grow with the number of swapchains.
+ *
+ * Workers never block on a single swapchain: only swapchains whose presents do not wait for the presentation engine
+ * use the pool, and a request whose present payload has not completed is parked until a payload waiter thread sees
+ * it complete, while the workers service the other swapchains.
+ */
+class presentation_worker_pool : private util::noncopyable
+{
+public:
+   /**
+    * @brief Create a pool and start its worker threads.
+    *
+    * @param allocator  The allocator the pool will use.
+    * @param scheduling Scheduling of the worker threads.
+    *
+    * @return The pool or nullptr on failure.
+    */
+   static util::unique_ptr<presentation_worker_pool> create(const util::allocator &allocator,
+                                                            const util::thread_scheduling &scheduling);
+
+   /**
+    * @brief Stop and join the worker threads. All swapchains must have been removed from the pool.
+    */
+   ~presentation_worker_pool();
+
+   /**
+    * @brief Register a swapchain so that it can be scheduled on the pool.
+    *
+    * @param swapchain The swapchain to register.
+    *
+    * @return VK_SUCCESS on success, VK_ERROR_OUT_OF_HOST_MEMORY otherwise.
+    */
+   VkResult add_swapchain(swapchain_base *swapchain);
+
+   /**
+    * @brief Unregister a swapchain, blocking until no worker is presenting for it.
+    *
+    * Present requests of the swapchain that have not been serviced yet are dropped, and their images released, see
+    * @ref swapchain_base::drop_pending_requests.
+    *
+    * @param swapchain The swapchain to unregister.
+    */
+   void remove_swapchain(swapchain_base *swapchain);
+
+   /**
+    * @brief Notify the pool that a swapchain has queued a present request.
+    *
+    * @param swapchain A swapchain previously registered with @ref add_swapchain.
+    */
+   void schedule(swapchain_base *swapchain);
+
+private:
+   /* Allow util::allocator to access the private constructor */
+   friend util::allocator;
+
+   presentation_worker_pool(const util::allocator &allocator);
+
+   /**
+    * @brief Scheduling state of a swapchain registered with the pool.
+    */
+   struct client
+   {
+      swapchain_base *swapchain;
+
+      /* Whether the swapchain is in @ref m_run_queue. */
+      bool queued;
+
+      /* Whether a worker is currently presenting for the swapchain. */
+      bool busy;
+
+      /* Whether the swapchain was scheduled while busy and needs to be queued again once the worker is done. */
+      bool rescheduled;
+
+      /* Whether the oldest request of the swapchain waits for its present payload, see @ref park. */
+      bool parked;
+
+      /* File descriptor in @ref m_epoll_fd that signals the payload of a parked swapchain, or -1 to poll it. */
+      int wait_fd;
+   };
+
+   /**
+    * @brief Find the scheduling state of a swapchain. Must be called with @ref m_lock held.
+    */
+   client *find_client(swapchain_base *swapchain);
+
+   /**
+    * @brief Queue a swapchain to be serviced by a worker. Must be called with @ref m_lock held.
+    */
+   void enqueue(client &entry);
+
+   /**
+    * @brief Set a swapchain aside until the present payload of its oldest request completes. Must be called with
+    *        @ref m_lock held.
+    *
+    * @param entry   The swapchain.
+    * @param wait_fd File descriptor that becomes readable once the payload completes, or -1 if there is none.
+    */
+   void park(client &entry, int wait_fd);
+
+   /**
+    * @brief Stop waiting for the payload of a parked swapchain. Must be called with @ref m_lock held.
+    */
+   void unpark(client &entry);
+
+   /**
+    * @brief Main loop of a worker thread.
+    */
+   void worker_thread();
+
+   /**
+    * @brief Main loop of the thread waiting for the present payloads of the parked swapchains.
+    */
+   void payload_waiter_thread();
+
+   /**
+    * @brief Wake up the payload waiter thread, so that it re-reads the parked swapchains.
+    */
+   void wake_payload_waiter();
+
+   std::mutex m_lock;
+
+   /**
+    * @brief Signalled when a swapchain is added to @ref m_run_queue or the workers have to terminate.
+    */
+   std::condition_variable m_work_available;
+
+   /**
+    * @brief Signalled when a worker finishes presenting for a swapchain.
+    */
+   std::condition_variable m_client_idle;
+
+   /**
+    * @brief Scheduling state of all the registered swapchains.
+    */
+   util::vector<client> m_clients;
+
+   /**
+    * @brief Swapchains waiting to be serviced, in the order they were scheduled. Its capacity is kept at least as
+    * large as the number of registered swapchains so that scheduling never allocates.
+    */
+   util::vector<swapchain_base *> m_run_queue;
+
+   std::array<std::thread, WSI_PRESENTATION_WORKER_POOL_SIZE> m_workers;
+
+   std::thread m_payload_waiter;
+
+   /**
+    * @brief Epoll set of the payload waiter thread, with @ref m_payload_waiter_event_fd and the wait_fd of the parked
+    * swapchains.
+    */
+   util::fd_owner m_epoll_fd;
+
+   /**
+    * @brief Wakes up the payload waiter thread.
+    */
+   util::fd_owner m_payload_waiter_event_fd;
+
+   /**
+    * @brief Number of parked swapchains without a file descriptor, which the payload waiter polls.
+    */
+   uint32_t m_polled_clients;
+
+   /**
+    * @brief Whether the worker threads have to continue running or terminate.
+    */
+   bool m_run;
+};
+
+} /* namespace wsi */
@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file prime_copy.cpp
+ *
+ * @brief Contains the copy of swapchain images into linear buffers that another device can display.
+ */
+
+#include <cassert>
+#include <optional>
+
+#include "prime_copy.hpp"
+
+#include <util/allocation_tracker.hpp>
+#include <util/log.hpp>
+#include <util/small_vector.hpp>
+
+namespace wsi
+{
+
+/**
+ * @brief Select the memory type of the swapchain images, device local memory if possible.
+ */
+static std::optional<uint32_t> select_image_memory_type(const layer::device_private_data &device_data,
+                                                        uint32_t memory_type_bits)
+{
+   VkPhysicalDeviceMemoryProperties2 memory_props = {};
+   memory_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+   device_data.instance_data.disp.GetPhysicalDeviceMemoryProperties2KHR(device_data.physical_device, &memory_props);
+
+   std::optional<uint32_t> any_type;
+   for (uint32_t i = 0; i < memory_props.memoryProperties.memoryTypeCount; ++i)
+   {
+      const VkMemoryPropertyFlags flags = memory_props.memoryProperties.memoryTypes[i].propertyFlags;
+      if ((memory_type_bits & (1u << i)) == 0 || (flags & VK_MEMORY_PROPERTY_PROTECTED_BIT) != 0)
+      {
+         continue;
+      }
+
+      if ((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0)
+      {
+         return i;
+      }
+
+      if (!any_type.has_value())
+      {
+         any_type = i;
+      }
+   }
+
+   return any_type;
+}
+
+prime_copy::prime_copy(layer::device_private_data &device_data, const util::allocator &allocator,
+                       const VkAllocationCallbacks *callbacks, util::memory_usage &usage, VkExtent2D extent,
+                       uint32_t texel_size)
+   : m_device_data(device_data)
+   , m_allocator(allocator)
+   , m_callbacks(callbacks)
+   , m_memory_usage(usage)
+   , m_extent(extent)
+   , m_texel_size(texel_size)
+   , m_slots(allocator)
+   , m_command_pool(VK_NULL_HANDLE)
+   , m_queue_family_index(0)
+{
+}
+
+prime_copy::~prime_copy()
+{
+   VkDevice device = m_device_data.device;
+   for (auto &image_slot : m_slots)
+   {
+      if (image_slot.copy_pending)
+      {
+         m_device_data.disp.WaitForFences(device, 1, &image_slot.copy_fence, VK_TRUE, UINT64_MAX);
+      }
+
+      m_device_data.disp.DestroyFence(device, image_slot.copy_fence, m_callbacks);
+      m_device_data.disp.DestroySemaphore(device, image_slot.copy_done, m_callbacks);
+      m_device_data.disp.DestroySemaphore(device, image_slot.sync_fd_wait, m_callbacks);
+      /* The imported memory of the shadow buffer is owned by the external memory it was imported from. */
+      m_device_data.disp.DestroyBuffer(device, image_slot.shadow_buffer, m_callbacks);
+      if (image_slot.image_memory != VK_NULL_HANDLE)
+      {
+         m_device_data.disp.FreeMemory(device, image_slot.image_memory, m_callbacks);
+         m_memory_usage.remove_device_memory(image_slot.image_memory_heap, image_slot.image_memory_size, false);
+      }
+   }
+
+   /* Destroying the pool frees its command buffers. */
+   if (m_command_pool != VK_NULL_HANDLE)
+   {
+      m_device_data.disp.DestroyCommandPool(device, m_command_pool, m_callbacks);
+   }
+}
+
+bool prime_copy::is_supported(layer::device_private_data &device_data,
+                              VkExternalMemoryHandleTypeFlagBits handle_type)
+{
+   VkPhysicalDeviceExternalBufferInfo buffer_info = {};
+   buffer_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_BUFFER_INFO;
+   buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+   buffer_info.handleType = handle_type;
+
+   VkExternalBufferProperties buffer_props = {};
+   buffer_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_BUFFER_PROPERTIES;
+   device_data.instance_data.disp.GetPhysicalDeviceExternalBufferPropertiesKHR(device_data.physical_device,
+                                                                               &buffer_info, &buffer_props);
+
+   return (buffer_props.externalMemoryProperties.externalMemoryFeatures &
+           VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT) != 0;
+}
+
+void prime_copy::fill_image_create_info(VkImageCreateInfo &image_create_info)
+{
+   image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+   image_create_info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+}
+
+util::unique_ptr<prime_copy> prime_copy::create(layer::device_private_data &device_data,
+                                                const util::allocator &allocator,
+                                                const VkAllocationCallbacks *callbacks, util::memory_usage &usage,
+                                                VkFormat format, VkExtent2D extent, uint32_t image_count)
+{
+   const uint32_t texel_size = util::get_texel_size(format);
+   if (texel_size == 0)
+   {
+      WSI_LOG_WARNING("Images in format %d cannot be copied for presentation.", static_cast<int>(format));
+      return nullptr;
+   }
+
+   auto copy = allocator.make_unique<prime_copy>(device_data, allocator, callbacks, usage, extent, texel_size);
+   if (copy == nullptr)
+   {
+      return nullptr;
+   }
+
+   if (copy->init_slots(image_count) != VK_SUCCESS)
+   {
+      WSI_LOG_ERROR("Failed to create the presentation copy resources.");
+      return nullptr;
+   }
+
+   return copy;
+}
+
+VkResult prime_copy::init_slots(uint32_t image_count)
+{
+   if (!m_slots.try_resize(image_count))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   VkDevice device = m_device_data.device;
+   for (auto &image_slot : m_slots)
+   {
+      VkSemaphoreCreateInfo semaphore_info = {};
+      semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      TRY(m_device_data.disp.CreateSemaphore(device, &semaphore_info, m_callbacks, &image_slot.copy_done));
+      TRY(m_device_data.disp.CreateSemaphore(device, &semaphore_info, m_callbacks, &image_slot.sync_fd_wait));
+
+      VkFenceCreateInfo fence_info = {};
+      fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+      TRY(m_device_data.disp.CreateFence(device, &fence_info, m_callbacks, &image_slot.copy_fence));
+   }
+
+   return VK_SUCCESS;
+}
+
+VkResult prime_copy::bind_image_memory(slot &image_slot, VkImage image)
+{
+   VkDevice device = m_device_data.device;
+
+   VkMemoryRequirements memory_requirements = {};
+   m_device_data.disp.GetImageMemoryRequirements(device, image, &memory_requirements);
+   auto memory_type = select_image_memory_type(m_device_data, memory_requirements.memoryTypeBits);
+   if (!memory_type.has_value())
+   {
+      return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+   }
+
+   VkMemoryAllocateInfo memory_info = {};
+   memory_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+   memory_info.allocationSize = memory_requirements.size;
+   memory_info.memoryTypeIndex = *memory_type;
+   TRY_LOG(m_device_data.disp.AllocateMemory(device, &memory_info, m_callbacks, &image_slot.image_memory),
+           "Failed to allocate the swapchain image memory");
+   image_slot.image_memory_size = memory_info.allocationSize;
+   image_slot.image_memory_heap = m_device_data.get_memory_heap_index(*memory_type);
+   m_memory_usage.add_device_memory(image_slot.image_memory_heap, image_slot.image_memory_size, false);
+   WSI_TRACK_DEVICE_ALLOCATION(image_slot.image_memory_size);
+   return m_device_data.disp.BindImageMemory(device, image, image_slot.image_memory, 0);
+}
+
+VkResult prime_copy::create_shadow_buffer(slot &image_slot, uint32_t stride,
+                                          VkExternalMemoryHandleTypeFlagBits handle_type)
+{
+   image_slot.shadow_row_length = stride / m_texel_size;
+
+   VkExternalMemoryBufferCreateInfo external_info = {};
+   external_info.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+   external_info.handleTypes = handle_type;
+
+   VkBufferCreateInfo buffer_info = {};
+   buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+   buffer_info.pNext = &external_info;
+   buffer_info.size = static_cast<VkDeviceSize>(stride) * m_extent.height;
+   buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+   buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+   TRY_LOG(m_device_data.disp.CreateBuffer(m_device_data.device, &buffer_info, m_callbacks, &image_slot.shadow_buffer),
+           "Failed to create the presentation buffer");
+   return VK_SUCCESS;
+}
+
+VkResult prime_copy::bind_image(uint32_t image_index, VkImage image, external_memory &shadow_memory)
+{
+   assert(image_index < m_slots.size());
+   slot &image_slot = m_slots[image_index];
+   TRY_LOG_CALL(bind_image_memory(image_slot, image));
+
+   const int stride = shadow_memory.get_strides()[0];
+   if (stride <= 0 || static_cast<uint32_t>(stride) % m_texel_size != 0)
+   {
+      WSI_LOG_ERROR("The stride %d of the presentation buffer is not a whole number of texels.", stride);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+   TRY_LOG_CALL(
+      create_shadow_buffer(image_slot, static_cast<uint32_t>(stride), VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT));
+
+   TRY_LOG(shadow_memory.import_memory_and_bind_buffer(image_slot.shadow_buffer),
+           "Failed to import the presentation buffer memory");
+
+   return VK_SUCCESS;
+}
+
+VkResult prime_copy::bind_image(uint32_t image_index, VkImage image, host_memory &shadow_memory)
+{
+   assert(image_index < m_slots.size());
+   slot &image_slot = m_slots[image_index];
+   TRY_LOG_CALL(bind_image_memory(image_slot, image));
+
+   const uint32_t stride = m_extent.width * m_texel_size;
+   TRY_LOG_CALL(create_shadow_buffer(image_slot, stride, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT));
+
+   TRY_LOG(shadow_memory.allocate_and_bind_buffer(image_slot.shadow_buffer, stride),
+           "Failed to allocate the presentation buffer memory");
+
+   return VK_SUCCESS;
+}
+
+VkResult prime_copy::bind_alias(uint32_t image_index, VkImage image)
+{
+   assert(image_index < m_slots.size());
+   return m_device_data.disp.BindImageMemory(m_device_data.device, image, m_slots[image_index].image_memory, 0);
+}
+
+VkResult prime_copy::record_copy(slot &image_slot, VkImage image)
+{
+   VkDevice device = m_device_data.device;
+   if (image_slot.command_buffer == VK_NULL_HANDLE)
+   {
+      VkCommandBufferAllocateInfo allocate_info = {};
+      allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocate_info.commandPool = m_command_pool;
+      allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      allocate_info.commandBufferCount = 1;
+      TRY(m_device_data.disp.AllocateCommandBuffers(device, &allocate_info, &image_slot.command_buffer));
+      /* Command buffers are dispatchable, so they need the loader data like the queues of the layer. */
+      TRY(m_device_data.SetDeviceLoaderData(device, image_slot.command_buffer));
+   }
+   else
+   {
+      TRY(m_device_data.disp.ResetCommandBuffer(image_slot.command_buffer, 0));
+   }
+   image_slot.recorded_image = VK_NULL_HANDLE;
+
+   VkCommandBufferBeginInfo begin_info = {};
+   begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+   TRY(m_device_data.disp.BeginCommandBuffer(image_slot.command_buffer, &begin_info));
+
+   VkImageMemoryBarrier to_transfer = {};
+   to_transfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+   to_transfer.srcAccessMask = 0;
+   to_transfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+   to_transfer.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+   to_transfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+   to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_transfer.image = image;
+   to_transfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+   m_device_data.disp.CmdPipelineBarrier(image_slot.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_transfer);
+
+   VkBufferImageCopy region = {};
+   region.bufferRowLength = image_slot.shadow_row_length;
+   region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+   region.imageExtent = { m_extent.width, m_extent.height, 1 };
+   m_device_data.disp.CmdCopyImageToBuffer(image_slot.command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                           image_slot.shadow_buffer, 1, &region);
+
+   /* Give the image back in the layout it was presented in, the next acquire of the image waits for the copy. */
+   VkImageMemoryBarrier to_present = to_transfer;
+   to_present.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+   to_present.dstAccessMask = 0;
+   to_present.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+   to_present.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+   m_device_data.disp.CmdPipelineBarrier(image_slot.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                                         &to_present);
+
+   TRY(m_device_data.disp.EndCommandBuffer(image_slot.command_buffer));
+   image_slot.recorded_image = image;
+   return VK_SUCCESS;
+}
+
+VkResult prime_copy::submit_copy(VkQueue queue, uint32_t image_index, VkImage image,
+                                 const queue_submit_semaphores &semaphores, VkSemaphore &copy_done)
+{
+   copy_done = VK_NULL_HANDLE;
+   assert(image_index < m_slots.size());
+   slot &image_slot = m_slots[image_index];
+
+   auto queue_family_index = m_device_data.get_queue_family_index(queue);
+   if (!queue_family_index.has_value())
+   {
+      WSI_LOG_ERROR("Presenting on a queue unknown to the layer.");
+      return VK_ERROR_UNKNOWN;
+   }
+
+   VkDevice device = m_device_data.device;
+   if (m_command_pool != VK_NULL_HANDLE && *queue_family_index != m_queue_family_index)
+   {
+      /* Unlike a skipped capture, a skipped copy would present stale contents, so move to the new queue family. */
+      for (auto &other_slot : m_slots)
+      {
+         TRY(wait_copy(other_slot));
+         other_slot.command_buffer = VK_NULL_HANDLE;
+         other_slot.recorded_image = VK_NULL_HANDLE;
+      }
+      m_device_data.disp.DestroyCommandPool(device, m_command_pool, m_callbacks);
+      m_command_pool = VK_NULL_HANDLE;
+   }
+
+   if (m_command_pool == VK_NULL_HANDLE)
+   {
+      VkCommandPoolCreateInfo pool_info = {};
+      pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+      pool_info.queueFamilyIndex = *queue_family_index;
+      TRY_LOG(m_device_data.disp.CreateCommandPool(device, &pool_info, m_callbacks, &m_command_pool),
+              "Failed to create the presentation copy command pool");
+      m_queue_family_index = *queue_family_index;
+   }
+
+   /* The present payload waits for the copy, so the previous copy has completed by the time the image is acquired
+    * again, and this does not block. */
+   TRY(wait_copy(image_slot));
+   TRY(m_device_data.disp.ResetFences(device, 1, &image_slot.copy_fence));
+
+   if (image_slot.recorded_image != image)
+   {
+      TRY_LOG(record_copy(image_slot, image), "Failed to record the presentation copy");
+   }
+
+   util::small_vector<VkPipelineStageFlags, MAX_INLINE_SUBMIT_SEMAPHORES> wait_stages{ util::allocator(
+      m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) };
+   if (!wait_stages.try_resize(semaphores.wait_semaphores_count,
+                               VkPipelineStageFlags{ VK_PIPELINE_STAGE_TRANSFER_BIT }))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   VkSubmitInfo submit_info = {};
+   submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+   submit_info.waitSemaphoreCount = semaphores.wait_semaphores_count;
+   submit_info.pWaitSemaphores = semaphores.wait_semaphores;
+   submit_info.pWaitDstStageMask = wait_stages.data();
+   submit_info.commandBufferCount = 1;
+   submit_info.pCommandBuffers = &image_slot.command_buffer;
+   submit_info.signalSemaphoreCount = 1;
+   submit_info.pSignalSemaphores = &image_slot.copy_done;
+
+   VkQueue copy_queue = m_device_data.get_reserved_internal_queue(*queue_family_index);
+   if (copy_queue == VK_NULL_HANDLE)
+   {
+      TRY_LOG(m_device_data.disp.QueueSubmit(queue, 1, &submit_info, image_slot.copy_fence),
+              "Failed to submit the presentation copy");
+   }
+   else
+   {
+      /* On a queue of its own the copy runs alongside the rendering of the next frames rather than in order. */
+      WSI_PROFILED_LOCK(queue_lock, m_device_data.get_internal_queue_lock(), internal_queue);
+      TRY_LOG(m_device_data.disp.QueueSubmit(copy_queue, 1, &submit_info, image_slot.copy_fence),
+              "Failed to submit the presentation copy");
+   }
+
+   image_slot.copy_pending = true;
+   copy_done = image_slot.copy_done;
+   return VK_SUCCESS;
+}
+
+VkResult prime_copy::submit_copy_after(VkQueue queue, uint32_t image_index, VkImage image, int sync_fd,
+                                       VkSemaphore &copy_done)
+{
+   copy_done = VK_NULL_HANDLE;
+   assert(image_index < m_slots.size());
+   slot &image_slot = m_slots[image_index];
+
+   /* The previous copy of the image waited on the semaphore, which cannot be imported into while that is pending. */
+   TRY(wait_copy(image_slot));
+   TRY(import_semaphore_sync_fd(m_device_data, image_slot.sync_fd_wait, sync_fd));
+
+   const queue_submit_semaphores semaphores = { &image_slot.sync_fd_wait, 1, nullptr, 0 };
+   return submit_copy(queue, image_index, image, semaphores, copy_done);
+}
+
+VkResult prime_copy::wait_copy(slot &image_slot)
+{
+   if (image_slot.copy_pending)
+   {
+      TRY(m_device_data.disp.WaitForFences(m_device_data.device, 1, &image_slot.copy_fence, VK_TRUE, UINT64_MAX));
+      image_slot.copy_pending = false;
+   }
+   return VK_SUCCESS;
+}
+
+} /* namespace wsi */
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file prime_copy.hpp
+ *
+ * @brief Contains the copy of swapchain images into linear buffers that another device can display.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include <layer/private_data.hpp>
+#include <util/custom_allocator.hpp>
+#include <util/helpers.hpp>
+#include <util/memory_usage.hpp>
+#include <wsi/external_memory.hpp>
+#include <wsi/host_memory.hpp>
+#include <wsi/synchronization.hpp>
+
+namespace wsi
+{
+
+/**
+ * @brief Presents swapchain images through linear shadow buffers.
+ *
+ * Used when the device cannot render to memory the presentation engine can import, typically when rendering on a
+ * discrete GPU for a compositor or display driven by another GPU. The swapchain images are then ordinary optimally
+ * tiled images in device local memory, and each of them has a shadow buffer imported from linear external memory
+ * the presentation engine can import. The copy into the shadow buffer is submitted ahead of the present payload, so
+ * it overlaps with the rendering of the next frames instead of stalling the application. It goes to the queue
+ * reserved with the internal_queue setting when that queue is in the family of the presenting queue, which needs no
+ * ownership transfer of the image, and to the presenting queue otherwise.
+ */
+class prime_copy : private util::noncopyable
+{
+public:
+   /**
+    * @brief Create the copies of a swapchain.
+    *
+    * @param device_data The device of the swapchain.
+    * @param allocator   Allocator for the host objects.
+    * @param callbacks   Allocation callbacks for the Vulkan objects.
+    * @param usage       Counters the device memory of the swapchain images is recorded in.
+    * @param format      Format of the swapchain images.
+    * @param extent      Extent of the swapchain images.
+    * @param image_count Number of swapchain images.
+    *
+    * @return The copies, or nullptr if the swapchain images cannot be copied into linear buffers.
+    */
+   static util::unique_ptr<prime_copy> create(layer::device_private_data &device_data, const util::allocator &allocator,
+                                              const VkAllocationCallbacks *callbacks, util::memory_usage &usage,
+                                              VkFormat format, VkExtent2D extent, uint32_t image_count);
+
+   /**
+    * @brief Check whether the device can import external memory into the shadow buffers.
+    *
+    * @param device_data The device of the swapchain.
+    * @param handle_type The handle type of the external memory.
+    */
+   static bool is_supported(layer::device_private_data &device_data, VkExternalMemoryHandleTypeFlagBits handle_type);
+
+   /**
+    * @brief Turn the create info of a swapchain image into the one of a locally rendered image.
+    *
+    * @param[in,out] image_create_info The create info, its pNext chain must not import external memory.
+    */
+   static void fill_image_create_info(VkImageCreateInfo &image_create_info);
+
+   ~prime_copy();
+
+   /**
+    * @brief Bind a swapchain image to device local memory and import its shadow buffer.
+    *
+    * @param image_index   Index of the image in the swapchain.
+    * @param image         The image.
+    * @param shadow_memory External memory of the shadow buffer, with a single plane.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult bind_image(uint32_t image_index, VkImage image, external_memory &shadow_memory);
+
+   /**
+    * @brief Bind a swapchain image to device local memory and allocate its shadow buffer in shared host memory.
+    *
+    * The rows of the shadow buffer are packed, see @ref host_memory::get_layout.
+    *
+    * @param image_index   Index of the image in the swapchain.
+    * @param image         The image.
+    * @param shadow_memory Host memory of the shadow buffer, not allocated yet.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult bind_image(uint32_t image_index, VkImage image, host_memory &shadow_memory);
+
+   /**
+    * @brief Bind an image created with VkImageSwapchainCreateInfoKHR to the memory of a swapchain image.
+    *
+    * @param image_index Index of the image in the swapchain.
+    * @param image       The image aliasing the swapchain image.
+    *
+    * @return The result of vkBindImageMemory.
+    */
+   VkResult bind_alias(uint32_t image_index, VkImage image);
+
+   /**
+    * @brief Submit the copy of an image into its shadow buffer.
+    *
+    * @param queue       The queue the image is presented on.
+    * @param image_index Index of the image in the swapchain.
+    * @param image       The image.
+    * @param semaphores  The semaphores the copy waits on, the copy does not signal any of the signal semaphores.
+    * @param[out] copy_done Semaphore signalled by the copy, to be waited on by the present payload.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult submit_copy(VkQueue queue, uint32_t image_index, VkImage image, const queue_submit_semaphores &semaphores,
+                        VkSemaphore &copy_done);
+
+   /**
+    * @brief Submit the copy of an image into its shadow buffer once a Sync FD signals.
+    *
+    * Used for present payloads that are not submitted on a queue, e.g. payloads shared with other swapchains or
+    * merged from the present wait semaphores.
+    *
+    * @param queue       The queue the image is presented on.
+    * @param image_index Index of the image in the swapchain.
+    * @param image       The image.
+    * @param sync_fd     The Sync FD the copy waits on, or -1 if it has already signalled. The caller keeps ownership.
+    * @param[out] copy_done Semaphore signalled by the copy, to be waited on by the present payload.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult submit_copy_after(VkQueue queue, uint32_t image_index, VkImage image, int sync_fd, VkSemaphore &copy_done);
+
+private:
+   prime_copy(layer::device_private_data &device_data, const util::allocator &allocator,
+              const VkAllocationCallbacks *callbacks, util::memory_usage &usage, VkExtent2D extent,
+              uint32_t texel_size);
+
+   /* Allow util::allocator to access the private constructor */
+   friend util::allocator;
+
+   /**
+    * @brief Copy resources of a swapchain image.
+    */
+   struct slot
+   {
+      VkDeviceMemory image_memory{ VK_NULL_HANDLE };
+      VkDeviceSize image_memory_size{ 0 };
+      uint32_t image_memory_heap{ 0 };
+      VkBuffer shadow_buffer{ VK_NULL_HANDLE };
+      /* Row length of the shadow buffer, in texels. */
+      uint32_t shadow_row_length{ 0 };
+      VkCommandBuffer command_buffer{ VK_NULL_HANDLE };
+      /* Image the command buffer copies from, it is recorded again when the image changes. */
+      VkImage recorded_image{ VK_NULL_HANDLE };
+      VkSemaphore copy_done{ VK_NULL_HANDLE };
+      /* Temporarily imports the Sync FD a copy waits on, see submit_copy_after. */
+      VkSemaphore sync_fd_wait{ VK_NULL_HANDLE };
+      VkFence copy_fence{ VK_NULL_HANDLE };
+      bool copy_pending{ false };
+   };
+
+   VkResult init_slots(uint32_t image_count);
+   VkResult bind_image_memory(slot &image_slot, VkImage image);
+   VkResult create_shadow_buffer(slot &image_slot, uint32_t stride, VkExternalMemoryHandleTypeFlagBits handle_type);
+   VkResult record_copy(slot &image_slot, VkImage image);
+   VkResult wait_copy(slot &image_slot);
+
+   layer::device_private_data &m_device_data;
+   const util::allocator m_allocator;
+   const VkAllocationCallbacks *m_callbacks;
+   util::memory_usage &m_memory_usage;
+
+   VkExtent2D m_extent;
+   uint32_t m_texel_size;
+
+   util::vector<slot> m_slots;
+
+   VkCommandPool m_command_pool;
+   uint32_t m_queue_family_index;
+};
+
+} /* namespace wsi */
@@ -85,6 +85,15 @@ public:
       return VK_SUCCESS;
    }
 
+   /**
+    * @brief Return the device extensions that this surface_properties implementation uses when they are available.
+    */
+   virtual VkResult get_optional_device_extensions(util::extension_list &extension_list)
+   {
+      UNUSED(extension_list);
+      return VK_SUCCESS;
+   }
+
    /**
     * @brief Return the instance extensions that this surface_properties implementation needs.
     */
@@ -31,30 +31,83 @@
  * that is not specific to how images are created or presented.
  */
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <system_error>
 
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <vulkan/vulkan.h>
 
+#include "util/allocation_tracker.hpp"
+#include "util/trace.hpp"
+#include "util/futex.hpp"
 #include "util/log.hpp"
 #include "util/helpers.hpp"
+#include "util/thread.hpp"
 
 #include "swapchain_base.hpp"
 #include "wsi_factory.hpp"
 
+#include "extensions/present_id.hpp"
 #include "extensions/present_timing.hpp"
 #include "extensions/swapchain_maintenance.hpp"
 
 namespace wsi
 {
 
+/**
+ * @brief Check whether objects created with one set of allocation callbacks can be freed with another.
+ */
+static bool allocation_callbacks_compatible(const VkAllocationCallbacks *lhs, const VkAllocationCallbacks *rhs)
+{
+   if (lhs == nullptr || rhs == nullptr)
+   {
+      return lhs == rhs;
+   }
+
+   return lhs->pUserData == rhs->pUserData && lhs->pfnAllocation == rhs->pfnAllocation &&
+          lhs->pfnReallocation == rhs->pfnReallocation && lhs->pfnFree == rhs->pfnFree;
+}
+
+/**
+ * @brief Check whether an image created with @p rhs can be used in place of an image created with @p lhs.
+ *
+ * Only the core parameters are compared, the WSI backends are responsible for checking any of their own state. The
+ * pointers of @p rhs refer to the create info of a swapchain that has already been created, so they are not read.
+ */
+static bool image_create_info_compatible(const VkImageCreateInfo &lhs, const VkImageCreateInfo &rhs)
+{
+   /* The queue families and the view formats of the images are given by arrays of the application, which are only
+    * valid while the swapchain is created, so such images are always created again. */
+   if (lhs.sharingMode == VK_SHARING_MODE_CONCURRENT || (lhs.flags & VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT) != 0)
+   {
+      return false;
+   }
+
+   return lhs.flags == rhs.flags && lhs.imageType == rhs.imageType && lhs.format == rhs.format &&
+          lhs.extent.width == rhs.extent.width && lhs.extent.height == rhs.extent.height &&
+          lhs.extent.depth == rhs.extent.depth && lhs.mipLevels == rhs.mipLevels &&
+          lhs.arrayLayers == rhs.arrayLayers && lhs.samples == rhs.samples && lhs.tiling == rhs.tiling &&
+          lhs.usage == rhs.usage && lhs.sharingMode == rhs.sharingMode;
+}
+
 void swapchain_base::page_flip_thread()
 {
+   if (m_page_flip_epoll_fd.is_valid())
+   {
+      event_driven_page_flip_thread();
+      return;
+   }
+
    auto &sc_images = m_swapchain_images;
    VkResult vk_res = VK_SUCCESS;
    uint64_t timeout = UINT64_MAX;
@@ -86,56 +139,277 @@ void swapchain_base::page_flip_thread()
          /* For continuous mode there will be only one image in the swapchain.
           * This image will always be used, and there is no pending state in this case. */
          submit_info.image_index = 0;
+         submit_info.present_mode = m_present_mode;
       }
       else
       {
-         /* Waiting for the page_flip_semaphore which will be signalled once there is an
-          * image to display.*/
-         if ((vk_res = m_page_flip_semaphore.wait(SEMAPHORE_TIMEOUT)) == VK_TIMEOUT)
+         /* Waiting for the pending buffer pool to receive an image to display. */
+         if ((vk_res = m_pending_buffer_pool.wait(SEMAPHORE_TIMEOUT)) == VK_TIMEOUT)
          {
             /* Image is not ready yet. */
             continue;
          }
 
          /* We want to present the oldest queued for present image from our present queue,
-          * which we can find at the sc->pending_buffer_pool.head index. */
-         std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
-
+          * which we can find at the front of the pending buffer pool. The page flip thread
+          * is the only consumer of the pool, so no lock is needed. */
          auto pending_submission = m_pending_buffer_pool.pop_front();
          assert(pending_submission.has_value());
          submit_info = *pending_submission;
       }
 
       /* We may need to wait for the payload of the present sync of the oldest pending image to be finished. */
-      while ((vk_res = image_wait_present(sc_images[submit_info.image_index], timeout)) == VK_TIMEOUT)
       {
-         WSI_LOG_WARNING("Timeout waiting for image's present fences, retrying..");
+         WSI_TRACE_SCOPE("wait_present_payload", submit_info.present_id);
+         while ((vk_res = image_wait_present(sc_images[submit_info.image_index], timeout)) == VK_TIMEOUT)
+         {
+            WSI_LOG_WARNING("Timeout waiting for image's present fences, retrying..");
+         }
       }
       if (vk_res != VK_SUCCESS)
       {
+         present_dropped(submit_info.present_id);
          set_error_state(vk_res);
          m_free_image_semaphore.post();
          continue;
       }
 
-      call_present(submit_info);
+      call_present(submit_info, true);
    }
 }
 
-void swapchain_base::call_present(const pending_present_request &pending_present)
+void swapchain_base::event_driven_page_flip_thread()
 {
-   /* First present of the swapchain. If it has an ancestor, wait until all the
-    * pending buffers from the ancestor have been presented. */
-   if (m_first_present)
+   /* No mutex is needed for the accesses to m_page_flip_thread_run variable, see page_flip_thread. The thread is
+    * woken up through m_page_flip_event_fd after the variable has been changed. */
+   while (m_page_flip_thread_run)
+   {
+      /* We want to present the oldest queued for present image from our present queue. The page flip thread is the
+       * only consumer of the pending buffer pool, so no lock is needed. */
+      auto pending_submission = m_pending_buffer_pool.pop_front();
+      if (!pending_submission.has_value())
+      {
+         /* Sleep until a present request is queued or the thread is asked to terminate. */
+         wait_for_page_flip_event(-1);
+         continue;
+      }
+
+      auto &image = m_swapchain_images[pending_submission->image_index];
+
+      /* Block until the present payload has finished, without waking up for anything other than new present
+       * requests. The swapchain is only torn down after the queue is idle, so the payload always completes. */
+      VkResult vk_res = VK_SUCCESS;
+      {
+         WSI_TRACE_SCOPE("wait_present_payload", pending_submission->present_id);
+         uint64_t timeout = UINT64_MAX;
+         const int sync_fd = image_get_present_sync_fd(image);
+         if (sync_fd >= 0)
+         {
+            bool sync_fd_ready = false;
+            while (!sync_fd_ready)
+            {
+               /* Wake ups for present requests queued in the meantime are consumed here, they are handled in order
+                * once this image has been presented. */
+               sync_fd_ready = wait_for_page_flip_event(sync_fd);
+            }
+            timeout = 0;
+         }
+
+         vk_res = image_wait_present(image, timeout);
+      }
+      if (vk_res != VK_SUCCESS)
+      {
+         present_dropped(pending_submission->present_id);
+         set_error_state(vk_res);
+         m_free_image_semaphore.post();
+         continue;
+      }
+
+      call_present(*pending_submission, true);
+   }
+}
+
+pool_present_status swapchain_base::present_pending_request(int &wait_fd)
+{
+   /* The presentation worker pool guarantees that only one worker at a time consumes the pending buffer pool. */
+   if (!m_pool_request.has_value())
+   {
+      m_pool_request = m_pending_buffer_pool.pop_front();
+      if (!m_pool_request.has_value())
+      {
+         return pool_present_status::idle;
+      }
+   }
+
+   /* Do not block the worker, which is shared with the other swapchains, on the payload. */
+   auto &image = m_swapchain_images[m_pool_request->image_index];
+   VkResult vk_res = image_wait_present(image, 0);
+   if (vk_res == VK_TIMEOUT)
+   {
+      wait_fd = image_get_present_sync_fd(image);
+      return pool_present_status::payload_pending;
+   }
+
+   const pending_present_request pending_submission = *m_pool_request;
+   m_pool_request.reset();
+   if (vk_res != VK_SUCCESS)
+   {
+      present_dropped(pending_submission.present_id);
+      set_error_state(vk_res);
+      m_free_image_semaphore.post();
+   }
+   else
+   {
+      call_present(pending_submission, true);
+   }
+
+   return m_pending_buffer_pool.size() > 0 ? pool_present_status::more_requests : pool_present_status::idle;
+}
+
+void swapchain_base::drop_pending_requests()
+{
+   std::optional<pending_present_request> request = m_pool_request;
+   m_pool_request.reset();
+   if (!request.has_value())
+   {
+      request = m_pending_buffer_pool.pop_front();
+   }
+
+   while (request.has_value())
+   {
+      present_dropped(request->present_id);
+      unpresent_image(request->image_index);
+      mark_present_handed_over();
+      request = m_pending_buffer_pool.pop_front();
+   }
+}
+
+void swapchain_base::mark_present_handed_over()
+{
+   m_handed_over_presents.fetch_add(1, std::memory_order_seq_cst);
+   if (m_handed_over_waiting.load(std::memory_order_seq_cst))
+   {
+      util::futex_wake(m_handed_over_presents, INT32_MAX);
+   }
+}
+
+bool swapchain_base::wait_for_page_flip_event(int sync_fd)
+{
+   constexpr uint64_t page_flip_event_tag = 0;
+   constexpr uint64_t sync_fd_tag = 1;
+
+   if (sync_fd >= 0)
+   {
+      epoll_event sync_fd_event = {};
+      sync_fd_event.events = EPOLLIN;
+      sync_fd_event.data.u64 = sync_fd_tag;
+      if (epoll_ctl(m_page_flip_epoll_fd.get(), EPOLL_CTL_ADD, sync_fd, &sync_fd_event) != 0)
+      {
+         /* Let the caller block in image_wait_present instead. */
+         WSI_LOG_WARNING("Failed to add the present sync FD to the page flip epoll set: %s.", std::strerror(errno));
+         return true;
+      }
+   }
+
+   std::array<epoll_event, 2> events = {};
+   int event_count = 0;
+   do
+   {
+      event_count = epoll_wait(m_page_flip_epoll_fd.get(), events.data(), static_cast<int>(events.size()), -1);
+   } while (event_count == -1 && errno == EINTR);
+
+   bool sync_fd_ready = false;
+   for (int i = 0; i < event_count; i++)
+   {
+      if (events[i].data.u64 == page_flip_event_tag)
+      {
+         /* Reset the event counter, the thread re-checks its state after every wake up. */
+         uint64_t value = 0;
+         ssize_t res = read(m_page_flip_event_fd.get(), &value, sizeof(value));
+         UNUSED(res);
+      }
+      else
+      {
+         sync_fd_ready = true;
+      }
+   }
+
+   if (sync_fd >= 0)
+   {
+      epoll_ctl(m_page_flip_epoll_fd.get(), EPOLL_CTL_DEL, sync_fd, nullptr);
+   }
+
+   if (event_count == -1)
+   {
+      /* Only programming error can cause epoll_wait to fail. */
+      WSI_LOG_ERROR("epoll_wait failed in the page flip thread: %s.", std::strerror(errno));
+      assert(false);
+      return true;
+   }
+
+   return sync_fd_ready;
+}
+
+void swapchain_base::signal_page_flip_event()
+{
+   const uint64_t value = 1;
+   ssize_t res = write(m_page_flip_event_fd.get(), &value, sizeof(value));
+   /* The write can only fail if the counter would overflow, which still leaves the page flip thread woken up. */
+   UNUSED(res);
+}
+
+void swapchain_base::call_present(const pending_present_request &pending_present, bool payload_waited)
+{
+   WSI_FRAME_ALLOCATION_SCOPE("present_image");
+   WSI_TRACE_SCOPE("present_image", pending_present.present_id);
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   /* Without a wait for the payload, the time the image is presented says nothing about the payload. */
+   const uint64_t payload_complete_time = latency_recorder::now();
+   if (payload_waited)
    {
-      if (m_ancestor != VK_NULL_HANDLE)
+      m_latency_recorder.record(latency_recorder::stage::gpu_wait, pending_present.present_time_ns,
+                                payload_complete_time);
+      if (pending_present.frame_statistics_slot != 0)
       {
-         auto *ancestor = reinterpret_cast<swapchain_base *>(m_ancestor);
-         ancestor->wait_for_pending_buffers();
+         auto *frame_boundary = get_swapchain_extension<wsi::wsi_ext_frame_boundary>();
+         assert(frame_boundary != nullptr);
+         frame_boundary->record_gpu_wait(pending_present.frame_statistics_slot,
+                                         payload_complete_time - pending_present.present_time_ns);
       }
+      m_frame_pacer.record_payload_complete(pending_present.frame_timings, payload_complete_time);
+   }
+#else
+   UNUSED(payload_waited);
+#endif
+   m_device_data.get_flight_recorder().record(layer::flight_recorder::event::payload_complete, this,
+                                              pending_present.present_id, pending_present.image_index);
 
-      sem_post(&m_start_present_semaphore);
+   /* First present of the swapchain. If it has an ancestor, queue the image behind the presents of the ancestor in
+    * the presentation engine. The ancestor releases its images while this swapchain presents, and its teardown
+    * waits for them. */
+   if (m_first_present)
+   {
+      /* This swapchain has started presenting, so the ancestor is not unlinked until m_ancestor_released is set. */
+      swapchain_base *ancestor = nullptr;
+      {
+         std::lock_guard<std::mutex> lock(m_device_data.get_swapchain_links_lock());
+         ancestor = reinterpret_cast<swapchain_base *>(m_ancestor);
+      }
+      if (ancestor != nullptr)
+      {
+         /* Ordering is best effort: if the ancestor cannot hand its presents over, present without waiting longer. */
+         ancestor->wait_for_queued_presents();
+         order_after_ancestor(*ancestor);
+      }
+      {
+         std::lock_guard<std::mutex> lock(m_device_data.get_swapchain_links_lock());
+         m_ancestor_released = true;
+      }
+      m_device_data.get_swapchain_links_changed().notify_all();
 
+      /* The first present sets up the presentation engine, e.g. the mode of a display. */
+      WSI_SETUP_ALLOCATION_SCOPE();
       present_image(pending_present);
 
       m_first_present = false;
@@ -145,17 +419,97 @@ void swapchain_base::call_present(const pending_present_request &pending_present
    {
       present_image(pending_present);
    }
+
+   mark_present_handed_over();
+
+   if (m_image_count_governor.is_enabled())
+   {
+      m_image_count_governor.record_present_complete(image_count_governor::now());
+   }
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   if (pending_present.present_time_ns != 0)
+   {
+      const uint64_t present_complete_time = latency_recorder::now();
+      m_latency_recorder.record(latency_recorder::stage::present_to_display, payload_complete_time,
+                                present_complete_time);
+      m_latency_recorder.record_frame(present_complete_time);
+      m_frame_pacer.record_present_complete(present_complete_time);
+   }
+#endif
+}
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+VkResult swapchain_base::latency_sleep(uint64_t timeout)
+{
+   uint32_t queued_frames = 0;
+   for (const auto &image : m_swapchain_images)
+   {
+      queued_frames += image.status.load() == swapchain_image::PENDING ? 1 : 0;
+   }
+
+   const uint64_t target = m_frame_pacer.get_frame_start_target(queued_frames);
+   const uint64_t now = latency_recorder::now();
+   if (target <= now)
+   {
+      return VK_SUCCESS;
+   }
+
+   if (target - now > timeout)
+   {
+      frame_pacer::sleep_until(now + timeout);
+      return VK_TIMEOUT;
+   }
+
+   frame_pacer::sleep_until(target);
+   return VK_SUCCESS;
 }
+#endif
 
 bool swapchain_base::has_descendant_started_presenting()
 {
+   /* The descendant may be destroyed concurrently, which unlinks it under the lock. */
+   std::lock_guard<std::mutex> lock(m_device_data.get_swapchain_links_lock());
    if (m_descendant == VK_NULL_HANDLE)
    {
       return false;
    }
 
    auto *desc = reinterpret_cast<swapchain_base *>(m_descendant);
-   return desc->m_started_presenting;
+   return desc->m_started_presenting.load(std::memory_order_acquire);
+}
+
+void swapchain_base::unlink_swapchains()
+{
+   std::unique_lock<std::mutex> lock(m_device_data.get_swapchain_links_lock());
+
+   /* Once the descendant has started presenting, its first present may use this swapchain, we don't want to delete
+    * vkImages and vkFences and semaphores before the waiting is done. A descendant that has not started presenting
+    * yet reads the cleared link instead. The wait releases the lock, so the descendant may be unlinked and destroyed
+    * meanwhile, which also ends the wait. */
+   m_device_data.get_swapchain_links_changed().wait(lock, [this]() {
+      auto *desc = reinterpret_cast<swapchain_base *>(m_descendant);
+      return desc == nullptr || !desc->m_started_presenting.load(std::memory_order_acquire) ||
+             desc->m_ancestor_released;
+   });
+
+   if (m_descendant != VK_NULL_HANDLE)
+   {
+      auto *sc = reinterpret_cast<swapchain_base *>(m_descendant);
+      sc->clear_ancestor();
+      m_descendant = VK_NULL_HANDLE;
+   }
+
+   if (m_ancestor != VK_NULL_HANDLE)
+   {
+      auto *sc = reinterpret_cast<swapchain_base *>(m_ancestor);
+      sc->clear_descendant();
+      m_ancestor = VK_NULL_HANDLE;
+   }
+   lock.unlock();
+
+   /* The ancestor may be waiting for this swapchain to present. */
+   m_device_data.get_swapchain_links_changed().notify_all();
 }
 
 VkResult swapchain_base::init_page_flip_thread()
@@ -164,11 +518,53 @@ VkResult swapchain_base::init_page_flip_thread()
    TRY_LOG_CALL(m_page_flip_semaphore.init(0));
    m_thread_sem_defined = true;
 
+   /* The continuous refresh mode needs a thread that keeps presenting the shared image, and swapchains whose presents
+    * wait for the presentation engine would hold up the workers shared with the other swapchains. */
+   if (m_device_data.instance_data.get_layer_settings().presentation_worker_pool &&
+       m_present_mode != VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR && !present_image_may_block())
+   {
+      auto *workers = m_device_data.get_presentation_worker_pool();
+      if (workers != nullptr && workers->add_swapchain(this) == VK_SUCCESS)
+      {
+         m_presentation_workers = workers;
+         m_page_flip_thread_run = true;
+         return VK_SUCCESS;
+      }
+
+      WSI_LOG_WARNING("Failed to use the presentation worker pool, falling back to a page flip thread.");
+   }
+
+   /* The continuous refresh mode keeps presenting the shared image and is driven by m_page_flip_semaphore. In all other
+    * modes try to make the page flip thread event driven, so an idle swapchain does not wake up periodically. */
+   if (m_present_mode != VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR)
+   {
+      util::fd_owner event_fd{ eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK) };
+      util::fd_owner epoll_fd{ epoll_create1(EPOLL_CLOEXEC) };
+      if (event_fd.is_valid() && epoll_fd.is_valid())
+      {
+         epoll_event page_flip_event = {};
+         page_flip_event.events = EPOLLIN;
+         page_flip_event.data.u64 = 0;
+         if (epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, event_fd.get(), &page_flip_event) == 0)
+         {
+            m_page_flip_event_fd = std::move(event_fd);
+            m_page_flip_epoll_fd = std::move(epoll_fd);
+         }
+      }
+
+      if (!m_page_flip_epoll_fd.is_valid())
+      {
+         WSI_LOG_WARNING("Failed to set up the page flip thread events, falling back to periodic wake ups.");
+      }
+   }
+
    /* Launch page flipping thread */
    m_page_flip_thread_run = true;
    try
    {
-      m_page_flip_thread = std::thread(&swapchain_base::page_flip_thread, this);
+      m_page_flip_thread =
+         util::start_thread("wsi-present", &m_device_data.instance_data.get_layer_settings().presentation_threads,
+                            &swapchain_base::page_flip_thread, this);
    }
    catch (const std::system_error &)
    {
@@ -183,20 +579,19 @@ VkResult swapchain_base::init_page_flip_thread()
 
 void swapchain_base::unpresent_image(uint32_t presented_index)
 {
-   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
+   m_device_data.get_flight_recorder().record(layer::flight_recorder::event::release, this, 0, presented_index);
 
    if (m_present_mode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR ||
        m_present_mode == VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR)
    {
-      m_swapchain_images[presented_index].status = swapchain_image::ACQUIRED;
+      m_swapchain_images[presented_index].status.store(swapchain_image::ACQUIRED);
    }
    else
    {
-      m_swapchain_images[presented_index].status = swapchain_image::FREE;
+      m_swapchain_images[presented_index].status.store(swapchain_image::FREE);
+      hint_free_image(presented_index);
    }
 
-   image_status_lock.unlock();
-
    if (m_present_mode != VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR &&
        m_present_mode != VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR)
    {
@@ -207,27 +602,113 @@ void swapchain_base::unpresent_image(uint32_t presented_index)
 swapchain_base::swapchain_base(layer::device_private_data &dev_data, const VkAllocationCallbacks *callbacks)
    : m_device_data(dev_data)
    , m_page_flip_thread_run(false)
-   , m_start_present_semaphore()
+   , m_presentation_workers(nullptr)
+   , m_ancestor_released(false)
    , m_thread_sem_defined(false)
    , m_first_present(true)
    , m_pending_buffer_pool()
-   , m_allocator(dev_data.get_allocator(), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, callbacks)
+   , m_memory_usage(&dev_data.get_memory_usage())
+   , m_arena(util::allocator(dev_data.get_allocator(), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, callbacks), &m_memory_usage)
+   , m_allocator(m_arena.get_allocator())
+   , m_image_allocator(m_arena.get_parent())
    , m_swapchain_images(m_allocator)
    , m_surface(VK_NULL_HANDLE)
    , m_present_mode(VK_PRESENT_MODE_IMMEDIATE_KHR)
-   , m_present_modes(m_allocator)
    , m_descendant(VK_NULL_HANDLE)
    , m_ancestor(VK_NULL_HANDLE)
    , m_device(VK_NULL_HANDLE)
    , m_queue(VK_NULL_HANDLE)
    , m_image_create_info()
+   , m_parallel_image_creation(false)
    , m_image_acquire_lock()
    , m_error_state(VK_NOT_READY)
    , m_started_presenting(false)
+   , m_deferred_teardown(false)
+   , m_queued_presents(0)
+   , m_handed_over_presents(0)
+   , m_handed_over_waiting(false)
+   , m_acquire_import_fence_sync_fd(false)
+   , m_acquire_import_semaphore_sync_fd(false)
+   , m_acquire_fence_sync_fd(-1)
+   , m_acquire_semaphore_sync_fd(-1)
+   , m_present_fence_import(false)
+   , m_merge_present_wait_semaphores(false)
+   , m_withheld_images(0)
    , m_extensions(m_allocator)
 {
 }
 
+VkResult swapchain_base::run_image_creation_step(const util::vector<swapchain_image *> &images,
+                                                 VkResult (swapchain_base::*step)(swapchain_image &))
+{
+   if (images.empty())
+   {
+      return VK_SUCCESS;
+   }
+
+   std::atomic<size_t> next_image{ 0 };
+   std::atomic<VkResult> step_result{ VK_SUCCESS };
+   auto worker = [&]() {
+      for (size_t i = next_image++; i < images.size() && step_result.load() == VK_SUCCESS; i = next_image++)
+      {
+         const VkResult result = (this->*step)(*images[i]);
+         if (result != VK_SUCCESS)
+         {
+            VkResult expected = VK_SUCCESS;
+            step_result.compare_exchange_strong(expected, result);
+         }
+      }
+   };
+
+   /* The calling thread works on the images too, so it takes one worker less than there are images. */
+   std::array<std::thread, WSI_IMAGE_CREATION_THREADS> workers;
+   const size_t worker_count = std::min(images.size() - 1, workers.size());
+   for (size_t i = 0; i < worker_count; i++)
+   {
+      try
+      {
+         workers[i] = util::start_thread("wsi-image", nullptr, worker);
+      }
+      catch (const std::system_error &)
+      {
+         /* The threads started so far and the calling thread handle the remaining images. */
+         break;
+      }
+      catch (const std::bad_alloc &)
+      {
+         break;
+      }
+   }
+
+   worker();
+   for (auto &thread : workers)
+   {
+      if (thread.joinable())
+      {
+         thread.join();
+      }
+   }
+   return step_result.load();
+}
+
+VkResult swapchain_base::create_images_in_parallel(const VkImageCreateInfo &image_create_info,
+                                                   const util::vector<swapchain_image *> &images)
+{
+   TRY_LOG(run_image_creation_step(images, &swapchain_base::allocate_swapchain_image_buffer),
+           "Failed to allocate swapchain images");
+
+   /* The platform objects refer to the buffers, which the imports hand over to Vulkan, so they are created in
+    * between. Creating them together keeps the requests to the window system in a single batch. */
+   for (auto *image : images)
+   {
+      TRY_LOG_CALL(export_swapchain_image(image_create_info, *image));
+   }
+
+   TRY_LOG(run_image_creation_step(images, &swapchain_base::import_swapchain_image_buffer),
+           "Failed to import swapchain images");
+   return VK_SUCCESS;
+}
+
 VkResult swapchain_base::init(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info)
 {
    assert(device != VK_NULL_HANDLE);
@@ -254,6 +735,12 @@ VkResult swapchain_base::init(VkDevice device, const VkSwapchainCreateInfoKHR *s
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
 
+   const bool image_deferred_allocation =
+      swapchain_create_info->flags & VK_SWAPCHAIN_CREATE_DEFERRED_MEMORY_ALLOCATION_BIT_EXT;
+   m_parallel_image_creation = m_device_data.instance_data.get_layer_settings().parallel_image_creation &&
+                               !image_deferred_allocation && m_swapchain_images.size() > 1 &&
+                               supports_parallel_image_creation();
+
    /* We have allocated images, we can call the platform init function if something needs to be done. */
    bool use_presentation_thread = true;
    TRY_LOG_CALL(init_platform(device, swapchain_create_info, use_presentation_thread));
@@ -288,41 +775,83 @@ VkResult swapchain_base::init(VkDevice device, const VkSwapchainCreateInfoKHR *s
       return result;
    }
 
-   const bool image_deferred_allocation =
-      swapchain_create_info->flags & VK_SWAPCHAIN_CREATE_DEFERRED_MEMORY_ALLOCATION_BIT_EXT;
+   /* Shared presentable images are never given back, so there is no queue of images to shorten. */
+   if (m_device_data.instance_data.get_layer_settings().adaptive_image_count &&
+       m_present_mode != VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR &&
+       m_present_mode != VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR)
+   {
+      m_image_count_governor.enable(static_cast<uint32_t>(m_swapchain_images.size()));
+   }
+
+   const uint32_t occluded_frame_rate = m_device_data.instance_data.get_layer_settings().occluded_frame_rate;
+   if (occluded_frame_rate != 0)
+   {
+      m_occluded_acquire_interval = std::chrono::nanoseconds(UINT64_C(1000000000) / occluded_frame_rate);
+   }
+
+   util::vector<swapchain_image *> parallel_images(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+   auto *ancestor = reinterpret_cast<swapchain_base *>(swapchain_create_info->oldSwapchain);
    for (auto &img : m_swapchain_images)
    {
+      /* The first image is always created as it sets up m_image_create_info, the rest may be taken over from the
+       * ancestor. Taking over an image that is already allocated is cheaper than deferring the allocation. */
+      if (ancestor != nullptr && m_image_create_info.format != VK_FORMAT_UNDEFINED &&
+          recycle_ancestor_image(*ancestor, img))
+      {
+         continue;
+      }
+
       TRY(create_swapchain_image(image_create_info, img));
 
       if (image_deferred_allocation)
       {
          img.status = swapchain_image::UNALLOCATED;
       }
+      else if (m_parallel_image_creation)
+      {
+         if (!parallel_images.try_push_back(&img))
+         {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+         }
+      }
       else
       {
          TRY_LOG_CALL(allocate_and_bind_swapchain_image(image_create_info, img));
       }
 
-      VkSemaphoreCreateInfo semaphore_info = {};
-      semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-      TRY_LOG_CALL(m_device_data.disp.CreateSemaphore(m_device, &semaphore_info, get_allocation_callbacks(),
-                                                      &img.present_semaphore));
-      TRY_LOG_CALL(m_device_data.disp.CreateSemaphore(m_device, &semaphore_info, get_allocation_callbacks(),
-                                                      &img.present_fence_wait));
+      auto &sync_objects = m_device_data.get_sync_object_pool();
+      TRY_LOG_CALL(sync_objects.get_semaphore(img.present_semaphore));
+      TRY_LOG_CALL(sync_objects.get_semaphore(img.present_fence_wait));
    }
 
-   m_device_data.disp.GetDeviceQueue(m_device, 0, 0, &m_queue);
-   TRY_LOG_CALL(m_device_data.SetDeviceLoaderData(m_device, m_queue));
+   if (!parallel_images.empty())
+   {
+      TRY_LOG_CALL(create_images_in_parallel(image_create_info, parallel_images));
+   }
 
-   int res = sem_init(&m_start_present_semaphore, 0, 0);
-   /* Only programming error can cause this to fail. */
-   assert(res == 0);
-   if (res != 0)
+   for (size_t i = 0; i < m_swapchain_images.size(); i++)
    {
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
+      if (m_swapchain_images[i].status.load() == swapchain_image::FREE)
+      {
+         hint_free_image(i);
+      }
    }
 
+   TRY_LOG_CALL(m_device_data.get_internal_queue(m_queue));
+
+   const auto &sync_fd_import = m_device_data.get_sync_fd_import_support();
+   using acquire_signal_mode = layer::device_private_data::acquire_signal_mode;
+   m_acquire_import_fence_sync_fd = sync_fd_import.fence_acquire_mode != acquire_signal_mode::queue_submit;
+   m_acquire_import_semaphore_sync_fd = sync_fd_import.semaphore_acquire_mode != acquire_signal_mode::queue_submit;
+   m_acquire_fence_sync_fd = sync_fd_import.fence_acquire_mode == acquire_signal_mode::signalled_sync_fd ?
+                                sync_fd_import.signalled_sync_fd :
+                                -1;
+   m_acquire_semaphore_sync_fd = sync_fd_import.semaphore_acquire_mode == acquire_signal_mode::signalled_sync_fd ?
+                                    sync_fd_import.signalled_sync_fd :
+                                    -1;
+   m_present_fence_import = sync_fd_import.fence && supports_present_payload_import();
+   m_merge_present_wait_semaphores = m_present_fence_import && m_device_data.is_present_semaphore_export_enabled();
+
    /* Release the swapchain images of the old swapchain in order
     * to free up memory for new swapchain. This is necessary especially
     * on platform with limited display memory size.
@@ -339,6 +868,13 @@ VkResult swapchain_base::init(VkDevice device, const VkSwapchainCreateInfoKHR *s
       ancestor->deprecate(reinterpret_cast<VkSwapchainKHR>(this));
    }
 
+   /* Allocations made from now on, such as the ones made for every frame, go to the user provided callbacks so that
+    * they do not accumulate in the arena. */
+   m_arena.seal();
+
+   m_device_data.get_flight_recorder().record(layer::flight_recorder::event::create_swapchain, this, 0,
+                                              layer::flight_recorder::NO_IMAGE, m_ancestor != VK_NULL_HANDLE ? 1 : 0);
+
    set_error_state(VK_SUCCESS);
    return VK_SUCCESS;
 }
@@ -350,23 +886,24 @@ void swapchain_base::teardown()
     * immediately. For images in the PENDING state, we will block until the
     * presentation engine is finished with them. */
 
-   if (has_descendant_started_presenting())
-   {
-      /* Here we wait for the start_present_semaphore, once this semaphore is up,
-       * the descendant has finished waiting, we don't want to delete vkImages and vkFences
-       * and semaphores before the waiting is done. */
-      auto *desc = reinterpret_cast<swapchain_base *>(m_descendant);
-      sem_wait(&desc->m_start_present_semaphore);
-   }
-   else if (!error_has_occured())
+   unlink_swapchains();
+
+   if (!error_has_occured())
    {
-      /* If descendant hasn't started presenting, there are pending buffers in the swapchain. */
+      /* The descendant only waits for the presents to be handed over to the presentation engine, so there may be
+       * pending buffers in the swapchain either way. */
       wait_for_pending_buffers();
    }
 
-   if (m_queue != VK_NULL_HANDLE)
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   m_latency_recorder.log_summary(this);
+#endif
+
+   /* A deferred teardown waited for the queue in detach_for_deferred_teardown. */
+   if (m_queue != VK_NULL_HANDLE && !m_deferred_teardown)
    {
       /* Make sure the vkFences are done signaling. */
+      WSI_PROFILED_LOCK(queue_lock, m_device_data.get_internal_queue_lock(), internal_queue);
       m_device_data.disp.QueueWaitIdle(m_queue);
    }
 
@@ -375,8 +912,18 @@ void swapchain_base::teardown()
    {
       /* Tell flip thread to end. */
       m_page_flip_thread_run = false;
+      if (m_page_flip_event_fd.is_valid())
+      {
+         signal_page_flip_event();
+      }
 
-      if (m_page_flip_thread.joinable())
+      if (m_presentation_workers != nullptr)
+      {
+         /* Make sure that no worker is presenting for this swapchain anymore. */
+         m_presentation_workers->remove_swapchain(this);
+         m_presentation_workers = nullptr;
+      }
+      else if (m_page_flip_thread.joinable())
       {
          m_page_flip_thread.join();
       }
@@ -386,139 +933,278 @@ void swapchain_base::teardown()
       }
    }
 
-   int res = sem_destroy(&m_start_present_semaphore);
-   if (res != 0)
+   finish_presentation();
+
+   /* Release the images array. */
+   for (auto &img : m_swapchain_images)
    {
-      WSI_LOG_ERROR("sem_destroy failed for start_present_semaphore with %d", errno);
+      /* Call implementation specific release */
+      destroy_image(img);
+
+      if (img.present_semaphores_reusable && !error_has_occured())
+      {
+         auto &sync_objects = m_device_data.get_sync_object_pool();
+         sync_objects.put_semaphore(img.present_semaphore);
+         sync_objects.put_semaphore(img.present_fence_wait);
+      }
+      else
+      {
+         const VkAllocationCallbacks *callbacks = m_device_data.get_allocator().get_original_callbacks();
+         m_device_data.disp.DestroySemaphore(m_device, img.present_semaphore, callbacks);
+         m_device_data.disp.DestroySemaphore(m_device, img.present_fence_wait, callbacks);
+      }
    }
+}
 
-   if (m_descendant != VK_NULL_HANDLE)
+void swapchain_base::hint_free_image(size_t image_index)
+{
+   if (image_index < 64)
    {
-      auto *sc = reinterpret_cast<swapchain_base *>(m_descendant);
-      sc->clear_ancestor();
+      m_free_image_hint.fetch_or(uint64_t{ 1 } << image_index, std::memory_order_release);
    }
+}
 
-   if (m_ancestor != VK_NULL_HANDLE)
+std::optional<uint32_t> swapchain_base::claim_hinted_free_image()
+{
+   /* The semaphore counts the free images the application may take, the hint only tells which ones they are. */
+   if (m_free_image_hint.load(std::memory_order_relaxed) == 0 || m_free_image_semaphore.wait(0) != VK_SUCCESS)
    {
-      auto *sc = reinterpret_cast<swapchain_base *>(m_ancestor);
-      sc->clear_descendant();
+      return std::nullopt;
    }
-   /* Release the images array. */
-   for (auto &img : m_swapchain_images)
-   {
-      /* Call implementation specific release */
-      destroy_image(img);
 
-      m_device_data.disp.DestroySemaphore(m_device, img.present_semaphore, get_allocation_callbacks());
-      m_device_data.disp.DestroySemaphore(m_device, img.present_fence_wait, get_allocation_callbacks());
+   uint64_t hint = m_free_image_hint.load(std::memory_order_acquire);
+   while (hint != 0)
+   {
+      const uint64_t bit = hint & (~hint + 1);
+      hint = m_free_image_hint.fetch_and(~bit, std::memory_order_acq_rel);
+      const auto index = static_cast<uint32_t>(__builtin_ctzll(bit));
+      if ((hint & bit) != 0 && m_swapchain_images[index].status.transition(swapchain_image::FREE,
+                                                                             swapchain_image::ACQUIRED))
+      {
+         return index;
+      }
+      hint &= ~bit;
    }
+
+   /* Every hinted image was stale, so give the unit back for the slow path to take. */
+   m_free_image_semaphore.post();
+   return std::nullopt;
 }
 
-VkResult swapchain_base::acquire_next_image(uint64_t timeout, VkSemaphore semaphore, VkFence fence,
-                                            uint32_t *image_index)
+VkResult swapchain_base::wait_and_claim_free_image(uint64_t timeout, uint32_t &image_index)
 {
-   std::unique_lock<std::mutex> acquire_lock(m_image_acquire_lock);
+   WSI_PROFILED_LOCK(acquire_lock, m_image_acquire_lock, image_acquire);
+
+   if (m_image_count_governor.is_enabled())
+   {
+      update_withheld_images();
+   }
 
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   const uint64_t acquire_wait_start = latency_recorder::now();
    TRY(wait_for_free_buffer(timeout));
+   const uint64_t acquire_wait_end = latency_recorder::now();
+   m_latency_recorder.record(latency_recorder::stage::acquire_wait, acquire_wait_start, acquire_wait_end);
+   m_frame_pacer.record_acquire(acquire_wait_end);
+   if (m_image_count_governor.is_enabled())
+   {
+      m_image_count_governor.record_acquire(acquire_wait_end - acquire_wait_start);
+   }
+#else
+   if (m_image_count_governor.is_enabled())
+   {
+      const uint64_t acquire_wait_start = image_count_governor::now();
+      TRY(wait_for_free_buffer(timeout));
+      m_image_count_governor.record_acquire(image_count_governor::now() - acquire_wait_start);
+   }
+   else
+   {
+      TRY(wait_for_free_buffer(timeout));
+   }
+#endif
    if (error_has_occured())
    {
       return get_error_state();
    }
 
-   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
-
+   /* Only the thread holding m_image_acquire_lock allocates images, and only it or an acquire through the hint, which
+    * applications do not run concurrently, moves them out of the FREE state. Other threads can only make more images
+    * FREE concurrently, so the first FREE image found can be claimed. */
    size_t i;
    for (i = 0; i < m_swapchain_images.size(); ++i)
    {
-      if (m_swapchain_images[i].status == swapchain_image::UNALLOCATED)
+      if (m_swapchain_images[i].status.transition(swapchain_image::FREE, swapchain_image::ACQUIRED))
+      {
+         break;
+      }
+   }
+
+   if (i == m_swapchain_images.size())
+   {
+      /* With deferred memory allocation, the free image counted by m_free_image_semaphore is one that has not been
+       * allocated yet. Images are only allocated once all the allocated ones are in use, so that applications that
+       * only cycle through some of the images do not pay for the others. */
+      for (i = 0; i < m_swapchain_images.size(); ++i)
       {
-         auto res = allocate_and_bind_swapchain_image(m_image_create_info, m_swapchain_images[i]);
-         if (res != VK_SUCCESS)
+         if (m_swapchain_images[i].status.load() == swapchain_image::UNALLOCATED)
          {
-            WSI_LOG_ERROR("Failed to allocate swapchain image.");
-            return res != VK_ERROR_INITIALIZATION_FAILED ? res : VK_ERROR_OUT_OF_HOST_MEMORY;
+            break;
          }
       }
+      assert(i < m_swapchain_images.size());
 
-      if (m_swapchain_images[i].status == swapchain_image::FREE)
+      WSI_SETUP_ALLOCATION_SCOPE();
+      auto res = allocate_and_bind_swapchain_image(m_image_create_info, m_swapchain_images[i]);
+      if (res != VK_SUCCESS)
       {
-         m_swapchain_images[i].status = swapchain_image::ACQUIRED;
-         *image_index = i;
-         break;
+         WSI_LOG_ERROR("Failed to allocate swapchain image.");
+         return res != VK_ERROR_INITIALIZATION_FAILED ? res : VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+
+      const bool acquired = m_swapchain_images[i].status.transition(swapchain_image::FREE, swapchain_image::ACQUIRED);
+      assert(acquired);
+      UNUSED(acquired);
+   }
+
+   image_index = static_cast<uint32_t>(i);
+   return VK_SUCCESS;
+}
+
+VkResult swapchain_base::throttle_occluded_acquire(uint64_t timeout)
+{
+   using clock = std::chrono::steady_clock;
+   /* Hidden surfaces are polled while waiting, so an application shown again is not held back for a whole frame. */
+   constexpr std::chrono::nanoseconds poll_interval = std::chrono::milliseconds(50);
+   const std::chrono::nanoseconds max_wait(std::min<uint64_t>(timeout, INT64_MAX));
+
+   const clock::time_point start = clock::now();
+   const clock::time_point next_acquire =
+      m_last_acquire_time.load(std::memory_order_relaxed) + m_occluded_acquire_interval;
+   for (clock::time_point now = start; now < next_acquire && is_surface_occluded(); now = clock::now())
+   {
+      const auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start);
+      if (waited >= max_wait)
+      {
+         return timeout == 0 ? VK_NOT_READY : VK_TIMEOUT;
       }
+
+      const auto until_next = std::chrono::duration_cast<std::chrono::nanoseconds>(next_acquire - now);
+      std::this_thread::sleep_for(std::min({ until_next, max_wait - waited, poll_interval }));
+   }
+
+   m_last_acquire_time.store(clock::now(), std::memory_order_relaxed);
+   return VK_SUCCESS;
+}
+
+VkResult swapchain_base::acquire_next_image(uint64_t timeout, VkSemaphore semaphore, VkFence fence,
+                                            uint32_t *image_index)
+{
+   WSI_TRACE_SCOPE("acquire_next_image", 0);
+
+   if (is_occlusion_throttled())
+   {
+      TRY(throttle_occluded_acquire(timeout));
+   }
+
+   /* A free image that is already known is claimed without the acquire lock, which then only serializes acquires that
+    * block or call into the backend with the teardown. The image count governor needs the lock to withhold images. */
+   std::optional<uint32_t> hinted_index;
+   if (!m_image_count_governor.is_enabled() && !error_has_occured())
+   {
+      hinted_index = claim_hinted_free_image();
    }
 
-   assert(i < m_swapchain_images.size());
+   if (hinted_index.has_value())
+   {
+      *image_index = *hinted_index;
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+      const uint64_t acquire_time = latency_recorder::now();
+      m_latency_recorder.record(latency_recorder::stage::acquire_wait, acquire_time, acquire_time);
+      m_frame_pacer.record_acquire(acquire_time);
+#endif
+   }
+   else
+   {
+      TRY(wait_and_claim_free_image(timeout, *image_index));
+   }
 
-   image_status_lock.unlock();
+   const uint32_t i = *image_index;
+   m_device_data.get_flight_recorder().record(layer::flight_recorder::event::acquire, this, 0, i);
 
-   /* Try to signal fences/semaphores with a sync FD for optimal performance. */
-   if (m_device_data.disp.get_fn<PFN_vkImportFenceFdKHR>("vkImportFenceFdKHR").has_value() &&
-       m_device_data.disp.get_fn<PFN_vkImportSemaphoreFdKHR>("vkImportSemaphoreFdKHR").has_value())
+   /* The presentation engine may still be reading the image, in which case its release fence becomes the payload. */
+   util::fd_owner release_sync_fd = image_take_release_sync_fd(m_swapchain_images[i]);
+   if (release_sync_fd.is_valid())
    {
-      if (fence != VK_NULL_HANDLE)
+      if (fence != VK_NULL_HANDLE && m_acquire_import_fence_sync_fd)
       {
-         int already_signalled_sentinel_fd = -1;
-         auto info = VkImportFenceFdInfoKHR{};
-         {
-            info.sType = VK_STRUCTURE_TYPE_IMPORT_FENCE_FD_INFO_KHR;
-            info.fence = fence;
-            info.handleType = VK_EXTERNAL_FENCE_HANDLE_TYPE_SYNC_FD_BIT;
-            info.fd = already_signalled_sentinel_fd;
-            info.flags = VK_FENCE_IMPORT_TEMPORARY_BIT;
-         }
+         TRY_LOG(import_fence_sync_fd(m_device_data, fence, release_sync_fd.get()),
+                 "Failed to import the release fence into the acquire fence.");
+         fence = VK_NULL_HANDLE;
+      }
 
-         auto result = m_device_data.disp.ImportFenceFdKHR(m_device, &info);
-         switch (result)
-         {
-         case VK_SUCCESS:
-            fence = VK_NULL_HANDLE;
-            break;
-         case VK_ERROR_INVALID_EXTERNAL_HANDLE:
-            /* Leave to fallback. */
-            break;
-         default:
-            return result;
-         }
+      if (semaphore != VK_NULL_HANDLE && m_acquire_import_semaphore_sync_fd)
+      {
+         TRY_LOG(import_semaphore_sync_fd(m_device_data, semaphore, release_sync_fd.get()),
+                 "Failed to import the release fence into the acquire semaphore.");
+         semaphore = VK_NULL_HANDLE;
       }
 
-      if (semaphore != VK_NULL_HANDLE)
+      /* The fallback signals the remaining objects straight away, so the buffer must be released first. */
+      if (fence != VK_NULL_HANDLE || semaphore != VK_NULL_HANDLE)
       {
-         int already_signalled_sentinel_fd = -1;
-         auto info = VkImportSemaphoreFdInfoKHR{};
-         {
-            info.sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR;
-            info.semaphore = semaphore;
-            info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
-            info.flags = VK_SEMAPHORE_IMPORT_TEMPORARY_BIT;
-            info.fd = already_signalled_sentinel_fd;
-         }
+         TRY_LOG(wait_sync_fd(release_sync_fd.get(), UINT64_MAX), "Failed to wait for the release fence.");
+      }
+   }
 
-         auto result = m_device_data.disp.ImportSemaphoreFdKHR(m_device, &info);
-         switch (result)
-         {
-         case VK_SUCCESS:
-            semaphore = VK_NULL_HANDLE;
-            break;
-         case VK_ERROR_INVALID_EXTERNAL_HANDLE:
-            /* Leave to fallback. */
-            break;
-         default:
-            return result;
-         }
+   /* Signal fences/semaphores with a sync FD for optimal performance, where the device supports importing them. */
+   if (fence != VK_NULL_HANDLE && m_acquire_import_fence_sync_fd)
+   {
+      auto result = import_fence_sync_fd(m_device_data, fence, m_acquire_fence_sync_fd);
+      switch (result)
+      {
+      case VK_SUCCESS:
+         fence = VK_NULL_HANDLE;
+         break;
+      case VK_ERROR_INVALID_EXTERNAL_HANDLE:
+         /* Leave to fallback, also for any further acquires. */
+         m_acquire_import_fence_sync_fd = false;
+         break;
+      default:
+         return result;
+      }
+   }
+
+   if (semaphore != VK_NULL_HANDLE && m_acquire_import_semaphore_sync_fd)
+   {
+      auto result = import_semaphore_sync_fd(m_device_data, semaphore, m_acquire_semaphore_sync_fd);
+      switch (result)
+      {
+      case VK_SUCCESS:
+         semaphore = VK_NULL_HANDLE;
+         break;
+      case VK_ERROR_INVALID_EXTERNAL_HANDLE:
+         /* Leave to fallback, also for any further acquires. */
+         m_acquire_import_semaphore_sync_fd = false;
+         break;
+      default:
+         return result;
       }
    }
 
    /* Fallback for when importing fence/semaphore sync FDs is unsupported by the ICD. */
-   queue_submit_semaphores semaphores = {
-      nullptr,
-      0,
-      (semaphore != VK_NULL_HANDLE) ? &semaphore : nullptr,
-      (semaphore != VK_NULL_HANDLE) ? 1u : 0,
-   };
-   TRY(sync_queue_submit(m_device_data, m_queue, fence, semaphores));
+   if (fence != VK_NULL_HANDLE || semaphore != VK_NULL_HANDLE)
+   {
+      queue_submit_semaphores semaphores = {
+         nullptr,
+         0,
+         (semaphore != VK_NULL_HANDLE) ? &semaphore : nullptr,
+         (semaphore != VK_NULL_HANDLE) ? 1u : 0,
+      };
+      WSI_PROFILED_LOCK(queue_lock, m_device_data.get_internal_queue_lock(), internal_queue);
+      TRY(sync_queue_submit(m_device_data, m_queue, fence, semaphores));
+   }
 
-   return VK_SUCCESS;
+   return get_success_status();
 }
 
 VkResult swapchain_base::get_swapchain_images(uint32_t *swapchain_image_count, VkImage *swapchain_images)
@@ -568,63 +1254,267 @@ VkResult swapchain_base::create_aliased_image_handle(VkImage *image)
 
 VkResult swapchain_base::get_swapchain_status()
 {
-   return get_error_state();
+   const VkResult error_state = get_error_state();
+   return error_state == VK_SUCCESS ? get_success_status() : error_state;
 }
 
 VkResult swapchain_base::notify_presentation_engine(const pending_present_request &pending_present)
 {
-   const std::lock_guard<std::recursive_mutex> lock(m_image_status_mutex);
-
    /* If the descendant has started presenting, we should release the image
     * however we do not want to block inside the main thread so we mark it
     * as free and let the page flip thread take care of it. */
    const bool descendant_started_presenting = has_descendant_started_presenting();
    if (descendant_started_presenting)
    {
-      m_swapchain_images[pending_present.image_index].status = swapchain_image::FREE;
+      m_swapchain_images[pending_present.image_index].status.store(swapchain_image::FREE);
+      hint_free_image(pending_present.image_index);
       m_free_image_semaphore.post();
       return VK_ERROR_OUT_OF_DATE_KHR;
    }
 
-   m_swapchain_images[pending_present.image_index].status = swapchain_image::PENDING;
-   m_started_presenting = true;
+   /* Throttle the application rather than queue more presents for the presentation thread than requested. */
+   const uint32_t max_pending_presents = m_device_data.instance_data.get_layer_settings().max_pending_presents;
+   if (m_page_flip_thread_run && max_pending_presents != 0 &&
+       m_present_mode != VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR)
+   {
+      constexpr uint64_t PENDING_PRESENTS_TIMEOUT = 250000000; /* 250 ms. */
+      while (m_pending_buffer_pool.wait_for_space(max_pending_presents, PENDING_PRESENTS_TIMEOUT) == VK_TIMEOUT)
+      {
+         /* Give up once the swapchain is in an error state, its presentation thread may no longer make progress. */
+         const VkResult error_state = get_error_state();
+         if (error_state < VK_SUCCESS)
+         {
+            m_swapchain_images[pending_present.image_index].status.store(swapchain_image::FREE);
+            hint_free_image(pending_present.image_index);
+            m_free_image_semaphore.post();
+            return error_state;
+         }
+      }
+   }
+
+   /* The application owns the image being presented, so no other thread can change its status concurrently. */
+   m_swapchain_images[pending_present.image_index].status.store(swapchain_image::PENDING);
+   m_started_presenting.store(true, std::memory_order_release);
+   if (m_present_mode != VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR)
+   {
+      m_queued_presents.fetch_add(1, std::memory_order_release);
+   }
 
    if (m_page_flip_thread_run)
    {
-      bool buffer_pool_res = m_pending_buffer_pool.push_back(pending_present);
-      (void)buffer_pool_res;
-      assert(buffer_pool_res);
-      m_page_flip_semaphore.post();
+      if (m_present_mode == VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR)
+      {
+         /* The page flip thread keeps presenting the single shared image and never drains the pending buffer pool
+          * in this mode, so only signal it. */
+         m_page_flip_semaphore.post();
+      }
+      else
+      {
+         /* The application thread is the only producer of the pending buffer pool, so pushing to it does not
+          * need to synchronize with the page flip thread. */
+         bool buffer_pool_res = m_pending_buffer_pool.push_back(pending_present);
+         (void)buffer_pool_res;
+         assert(buffer_pool_res);
+
+         if (m_presentation_workers != nullptr)
+         {
+            m_presentation_workers->schedule(this);
+         }
+         else if (m_page_flip_event_fd.is_valid())
+         {
+            signal_page_flip_event();
+         }
+      }
    }
    else
    {
-      call_present(pending_present);
+      /* The backend waits for the payload, if at all, while presenting. */
+      call_present(pending_present, false);
    }
 
    return VK_SUCCESS;
 }
 
+/**
+ * @brief Record the region of an image changed by a present, clipped to the image.
+ *
+ * @param[out] damage The damage of the image.
+ * @param      region The changed region given by the application, or nullptr if the whole image may have changed.
+ * @param      extent The extent of the image.
+ */
+static void set_present_damage(present_damage &damage, const VkPresentRegionKHR *region, const VkExtent2D &extent)
+{
+   damage.full = true;
+   damage.rect_count = 0;
+
+   /* A region without rectangles means that the whole image has changed. */
+   if (region == nullptr || region->rectangleCount == 0 || region->pRectangles == nullptr)
+   {
+      return;
+   }
+
+   for (uint32_t i = 0; i < region->rectangleCount; i++)
+   {
+      const VkRectLayerKHR &rect = region->pRectangles[i];
+      const int64_t x0 = std::max<int64_t>(rect.offset.x, 0);
+      const int64_t y0 = std::max<int64_t>(rect.offset.y, 0);
+      const int64_t x1 = std::min<int64_t>(static_cast<int64_t>(rect.offset.x) + rect.extent.width, extent.width);
+      const int64_t y1 = std::min<int64_t>(static_cast<int64_t>(rect.offset.y) + rect.extent.height, extent.height);
+      if (x0 >= x1 || y0 >= y1)
+      {
+         continue;
+      }
+
+      VkRect2D clipped = { { static_cast<int32_t>(x0), static_cast<int32_t>(y0) },
+                           { static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0) } };
+      if (damage.rect_count == damage.rects.size())
+      {
+         /* Out of space, merge into the bounding box of the last rectangle. */
+         VkRect2D &last = damage.rects[damage.rect_count - 1];
+         const int32_t min_x = std::min(last.offset.x, clipped.offset.x);
+         const int32_t min_y = std::min(last.offset.y, clipped.offset.y);
+         const int32_t max_x = std::max<int32_t>(last.offset.x + last.extent.width, x1);
+         const int32_t max_y = std::max<int32_t>(last.offset.y + last.extent.height, y1);
+         last = { { min_x, min_y }, { static_cast<uint32_t>(max_x - min_x), static_cast<uint32_t>(max_y - min_y) } };
+      }
+      else
+      {
+         damage.rects[damage.rect_count++] = clipped;
+      }
+   }
+
+   /* No rectangles left after clipping means nothing within the image has changed. */
+   damage.full = false;
+}
+
+VkResult swapchain_base::set_merged_present_payload(swapchain_image &image, VkQueue queue,
+                                                    const VkSemaphore *wait_semaphores, uint32_t wait_semaphores_count)
+{
+   util::fd_owner merged_sync_fd;
+   uint32_t exported_count = 0;
+   for (; exported_count < wait_semaphores_count; exported_count++)
+   {
+      util::fd_owner sync_fd;
+      if (export_semaphore_sync_fd(m_device_data, wait_semaphores[exported_count], sync_fd) != VK_SUCCESS)
+      {
+         break;
+      }
+      TRY_LOG_CALL(merge_sync_fds(merged_sync_fd, std::move(sync_fd)));
+   }
+
+   if (exported_count == wait_semaphores_count &&
+       image_set_shared_present_payload(image, queue, merged_sync_fd.get()) == VK_SUCCESS)
+   {
+      return VK_SUCCESS;
+   }
+
+   WSI_LOG_WARNING("Failed to merge the present wait semaphores into a Sync FD, using queue submissions.");
+   m_merge_present_wait_semaphores = false;
+
+   /* The exported semaphores have already been waited on, complete them on the host so that the payload submission
+    * only needs to wait on the remaining ones. */
+   TRY_LOG_CALL(wait_sync_fd(merged_sync_fd.get(), UINT64_MAX));
+   const queue_submit_semaphores semaphores = { wait_semaphores + exported_count,
+                                                wait_semaphores_count - exported_count, nullptr, 0 };
+   return image_set_present_payload(image, queue, semaphores, nullptr);
+}
+
+present_info_extensions find_present_info_extensions(const VkPresentInfoKHR &present_info)
+{
+   present_info_extensions extensions{};
+   for (auto entry = reinterpret_cast<const VkBaseInStructure *>(present_info.pNext); entry != nullptr;
+        entry = entry->pNext)
+   {
+      switch (entry->sType)
+      {
+      case VK_STRUCTURE_TYPE_PRESENT_ID_KHR:
+         if (extensions.present_ids == nullptr)
+         {
+            extensions.present_ids = reinterpret_cast<const VkPresentIdKHR *>(entry);
+         }
+         break;
+      case VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR:
+         if (extensions.present_regions == nullptr)
+         {
+            extensions.present_regions = reinterpret_cast<const VkPresentRegionsKHR *>(entry);
+         }
+         break;
+      case VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT:
+         if (extensions.present_fence_info == nullptr)
+         {
+            extensions.present_fence_info = reinterpret_cast<const VkSwapchainPresentFenceInfoEXT *>(entry);
+         }
+         break;
+      case VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_MODE_INFO_EXT:
+         if (extensions.present_mode_info == nullptr)
+         {
+            extensions.present_mode_info = reinterpret_cast<const VkSwapchainPresentModeInfoEXT *>(entry);
+         }
+         break;
+      case VK_STRUCTURE_TYPE_FRAME_BOUNDARY_EXT:
+         if (extensions.frame_boundary == nullptr)
+         {
+            extensions.frame_boundary = reinterpret_cast<const VkFrameBoundaryEXT *>(entry);
+         }
+         break;
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+      case VK_STRUCTURE_TYPE_PRESENT_TIMINGS_INFO_EXT:
+         if (extensions.present_timings_info == nullptr)
+         {
+            extensions.present_timings_info = reinterpret_cast<const VkPresentTimingsInfoEXT *>(entry);
+         }
+         break;
+#endif
+      default:
+         break;
+      }
+   }
+   return extensions;
+}
+
 VkResult swapchain_base::queue_present(VkQueue queue, const VkPresentInfoKHR *present_info,
+                                       const present_info_extensions &present_extensions,
                                        const swapchain_presentation_parameters &submit_info)
 {
+   WSI_TRACE_SCOPE("queue_present", submit_info.pending_present.present_id);
+   m_device_data.get_flight_recorder().record(layer::flight_recorder::event::present, this,
+                                              submit_info.pending_present.present_id,
+                                              submit_info.pending_present.image_index);
+
 #if VULKAN_WSI_LAYER_EXPERIMENTAL
-   auto *ext = get_swapchain_extension<wsi::wsi_ext_present_timing>();
-   if (ext)
+   const uint64_t present_time = latency_recorder::now();
+
+   const VkPresentTimingInfoEXT &timing_info = submit_info.m_present_timing_info;
+   auto *present_timing = get_swapchain_extension<wsi::wsi_ext_present_timing>();
+   if (present_timing == nullptr || timing_info.presentStageQueries == 0)
    {
-      wsi::swapchain_presentation_entry presentation_entry = {};
-      presentation_entry.present_id = submit_info.pending_present.present_id;
-      TRY_LOG_CALL(ext->add_presentation_entry(presentation_entry));
+      present_timing = nullptr;
+   }
+   else if (present_timing->present_timing_queue_full())
+   {
+      return VK_ERROR_PRESENT_TIMING_QUEUE_FULL_EXT;
    }
 #endif
 
-   if (submit_info.switch_presentation_mode)
+   /* Until all the submissions below succeed, the semaphores of the image may be left signalled. */
+   m_swapchain_images[submit_info.pending_present.image_index].present_semaphores_reusable = false;
+
+   set_present_damage(m_swapchain_images[submit_info.pending_present.image_index].damage, submit_info.present_region,
+                      { m_image_create_info.extent.width, m_image_create_info.extent.height });
+
+   pending_present_request pending_present = submit_info.pending_present;
+   pending_present.present_mode = m_present_mode;
+   /* The swapchain_maintenance1 extension implements switching, so it must be available if a switch is requested. */
+   auto *maintenance1 =
+      get_swapchain_extension<wsi::wsi_ext_swapchain_maintenance1>(submit_info.switch_presentation_mode);
+   if (maintenance1 != nullptr)
    {
-      /* Assert when a presentation mode switch is requested and the swapchain_maintenance1 extension which implements this is not available */
-      auto *ext = get_swapchain_extension<wsi::wsi_ext_swapchain_maintenance1>(true);
-      if (ext)
+      if (submit_info.switch_presentation_mode)
       {
-         TRY_LOG_CALL(ext->handle_switching_presentation_mode(submit_info.present_mode));
+         TRY_LOG_CALL(maintenance1->handle_switching_presentation_mode(submit_info.present_mode));
       }
+      /* A switch applies to the presents after this one as well. */
+      pending_present.present_mode = maintenance1->get_present_mode();
    }
 
    const VkSemaphore *wait_semaphores = &m_swapchain_images[submit_info.pending_present.image_index].present_semaphore;
@@ -645,12 +1535,14 @@ VkResult swapchain_base::queue_present(VkQueue queue, const VkPresentInfoKHR *pr
 
    void *submission_pnext = nullptr;
    std::optional<VkFrameBoundaryEXT> frame_boundary;
+   /* Only present while the layer passes its own frame boundary events. */
+   auto *frame_boundary_ext = get_swapchain_extension<wsi::wsi_ext_frame_boundary>();
    /* Do not handle the event if it was handled before reaching this point */
    if (submit_info.handle_present_frame_boundary_event)
    {
-      auto *ext = get_swapchain_extension<wsi::wsi_ext_frame_boundary>();
-      frame_boundary = handle_frame_boundary_event(
-         present_info, &m_swapchain_images[submit_info.pending_present.image_index].image, ext);
+      frame_boundary = handle_frame_boundary_event(present_extensions.frame_boundary,
+                                                   &m_swapchain_images[submit_info.pending_present.image_index].image,
+                                                   frame_boundary_ext);
 
       if (frame_boundary)
       {
@@ -658,18 +1550,65 @@ VkResult swapchain_base::queue_present(VkQueue queue, const VkPresentInfoKHR *pr
       }
    }
 
-   queue_submit_semaphores semaphores = {
-      wait_semaphores,
-      sem_count,
-      (submit_info.present_fence != VK_NULL_HANDLE) ?
-         &m_swapchain_images[submit_info.pending_present.image_index].present_fence_wait :
-         nullptr,
-      (submit_info.present_fence != VK_NULL_HANDLE) ? 1u : 0,
-   };
-   TRY_LOG_CALL(image_set_present_payload(m_swapchain_images[submit_info.pending_present.image_index], queue,
-                                          semaphores, submission_pnext));
+   /* Chain the present fence to the payload through present_fence_wait, unless the payload can be imported into it. */
+   const bool chain_present_fence = submit_info.present_fence != VK_NULL_HANDLE && !m_present_fence_import;
+   if (submit_info.use_shared_payload)
+   {
+      assert(m_present_fence_import);
+      auto &image = m_swapchain_images[submit_info.pending_present.image_index];
+      if (image_set_shared_present_payload(image, queue, submit_info.shared_payload_sync_fd) != VK_SUCCESS)
+      {
+         /* Complete the shared payload on the host, so that an empty payload can stand in for it. */
+         TRY_LOG_CALL(wait_sync_fd(submit_info.shared_payload_sync_fd, UINT64_MAX));
+         TRY_LOG_CALL(image_set_present_payload(image, queue, { nullptr, 0, nullptr, 0 }, submission_pnext));
+      }
+   }
+   else if (m_merge_present_wait_semaphores && !submit_info.use_image_present_semaphore &&
+            submission_pnext == nullptr && m_device_data.are_semaphores_exportable(wait_semaphores, sem_count))
+   {
+      /* The payload submission would only wait on the semaphores, so their Sync FDs can stand in for it. */
+      TRY_LOG_CALL(set_merged_present_payload(m_swapchain_images[submit_info.pending_present.image_index], queue,
+                                              wait_semaphores, sem_count));
+   }
+   else
+   {
+      queue_submit_semaphores semaphores = {
+         wait_semaphores,
+         sem_count,
+         chain_present_fence ? &m_swapchain_images[submit_info.pending_present.image_index].present_fence_wait :
+                               nullptr,
+         chain_present_fence ? 1u : 0,
+      };
+      TRY_LOG_CALL(image_set_present_payload(m_swapchain_images[submit_info.pending_present.image_index], queue,
+                                             semaphores, submission_pnext));
+   }
+
+   if (submit_info.share_payload_sync_fd != nullptr)
+   {
+      /* The semaphores of the request have been waited on, so the other swapchains must not submit them again. */
+      *submit_info.share_payload_submitted = true;
+
+      int sync_fd = -1;
+      auto &image = m_swapchain_images[submit_info.pending_present.image_index];
+      if (image_get_shareable_present_payload(image, sync_fd) != VK_SUCCESS)
+      {
+         /* Complete the payload on the host instead, the other swapchains then share a completed payload. */
+         TRY_LOG(image_wait_present(image, UINT64_MAX), "Failed to share the present payload");
+         sync_fd = -1;
+      }
+      if (sync_fd >= 0)
+      {
+         /* The presentation engine may consume the Sync FD of the image, so the other swapchains get a duplicate. */
+         util::fd_owner shared_sync_fd{ fcntl(sync_fd, F_DUPFD_CLOEXEC, 0) };
+         if (!shared_sync_fd.is_valid())
+         {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+         }
+         *submit_info.share_payload_sync_fd = std::move(shared_sync_fd);
+      }
+   }
 
-   if (submit_info.present_fence != VK_NULL_HANDLE)
+   if (chain_present_fence)
    {
       const queue_submit_semaphores wait_semaphores = {
          &m_swapchain_images[submit_info.pending_present.image_index].present_fence_wait, 1, nullptr, 0
@@ -679,10 +1618,124 @@ VkResult swapchain_base::queue_present(VkQueue queue, const VkPresentInfoKHR *pr
        */
       TRY(sync_queue_submit(m_device_data, queue, submit_info.present_fence, wait_semaphores));
    }
+   else if (submit_info.present_fence != VK_NULL_HANDLE)
+   {
+      auto &image = m_swapchain_images[submit_info.pending_present.image_index];
+      if (image_import_present_payload(image, submit_info.present_fence) != VK_SUCCESS)
+      {
+         /* A failed import completes the payload, so the fence can be signalled without waiting on anything. */
+         WSI_LOG_WARNING("Failed to import the present payload into the present fence, using queue submissions.");
+         m_present_fence_import = false;
+         TRY(sync_queue_submit(m_device_data, queue, submit_info.present_fence, { nullptr, 0, nullptr, 0 }));
+      }
+   }
 
-   TRY(notify_presentation_engine(submit_info.pending_present));
+   m_swapchain_images[submit_info.pending_present.image_index].present_semaphores_reusable = true;
 
-   return VK_SUCCESS;
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   pending_present.present_time_ns = present_time;
+   /* Relative targets are durations from the previous presentation, which the backends do not pace with. */
+   pending_present.target_time_ns = timing_info.presentAtRelativeTime ? 0 : timing_info.time.targetPresentTime;
+   pending_present.timing_slot = 0;
+   pending_present.frame_statistics_slot = 0;
+   pending_present.frame_timings = m_frame_pacer.end_frame(present_time);
+   if (frame_boundary_ext != nullptr)
+   {
+      /* The frame boundary was passed with the wait submission instead if it was handled before reaching this point. */
+      if (!frame_boundary.has_value())
+      {
+         frame_boundary = create_frame_boundary(present_extensions.frame_boundary);
+      }
+      uint32_t images_in_flight = 1;
+      for (const auto &image : m_swapchain_images)
+      {
+         const auto status = image.status.load();
+         images_in_flight += (status == swapchain_image::PENDING || status == swapchain_image::PRESENTED) ? 1 : 0;
+      }
+      pending_present.frame_statistics_slot = frame_boundary_ext->begin_frame_statistics(
+         frame_boundary.has_value() ? frame_boundary->frameID : 0, present_time, images_in_flight);
+   }
+   if (present_timing != nullptr)
+   {
+      /* Only this thread pushes entries, so the queue still has room. */
+      TRY_LOG_CALL(present_timing->add_presentation_entry(pending_present.present_id, timing_info.presentStageQueries,
+                                                          pending_present.timing_slot));
+   }
+#endif
+
+   if (pending_present.present_id != 0)
+   {
+      /* Ended when the presentation completes, in set_present_id, or when it is dropped, in present_dropped. */
+      WSI_TRACE_ASYNC_BEGIN("present", this, pending_present.present_id);
+   }
+   const VkResult result = notify_presentation_engine(pending_present);
+   if (result != VK_SUCCESS)
+   {
+      present_dropped(pending_present.present_id);
+   }
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   if (result != VK_SUCCESS && present_timing != nullptr)
+   {
+      /* The image will not be presented, so the entry is reported without any stage reached. */
+      present_timing->complete_presentation_entry(pending_present.timing_slot, 0, 0, 0, 0);
+   }
+   if (frame_boundary_ext != nullptr)
+   {
+      /* A failed present never reaches the presentation thread, so the slot is not referenced anymore. */
+      if (result != VK_SUCCESS)
+      {
+         frame_boundary_ext->discard_frame_statistics(pending_present.frame_statistics_slot);
+      }
+      else
+      {
+         frame_boundary_ext->end_present_call(pending_present.frame_statistics_slot, latency_recorder::now());
+      }
+   }
+#endif
+   TRY(result);
+
+   return get_success_status();
+}
+
+bool swapchain_base::recycle_ancestor_image(swapchain_base &ancestor, swapchain_image &image)
+{
+   /* The descendant destroys the recycled objects so they need to be compatible with its allocation callbacks. */
+   if (!allocation_callbacks_compatible(get_allocation_callbacks(), ancestor.get_allocation_callbacks()) ||
+       !image_create_info_compatible(m_image_create_info, ancestor.m_image_create_info))
+   {
+      return false;
+   }
+
+   for (auto &candidate : ancestor.m_swapchain_images)
+   {
+      /* Claim the image so that neither the ancestor nor its page flip thread use it anymore. */
+      if (!candidate.status.transition(swapchain_image::FREE, swapchain_image::INVALID))
+      {
+         continue;
+      }
+
+      if (!adopt_ancestor_image(ancestor, candidate))
+      {
+         candidate.status.store(swapchain_image::FREE);
+         return false;
+      }
+
+      image.data = candidate.data;
+      image.image = candidate.image;
+      image.present_semaphore = candidate.present_semaphore;
+      image.present_fence_wait = candidate.present_fence_wait;
+      image.present_semaphores_reusable = candidate.present_semaphores_reusable;
+      image.status.store(swapchain_image::FREE);
+
+      candidate.data = nullptr;
+      candidate.image = VK_NULL_HANDLE;
+      candidate.present_semaphore = VK_NULL_HANDLE;
+      candidate.present_fence_wait = VK_NULL_HANDLE;
+      return true;
+   }
+
+   return false;
 }
 
 void swapchain_base::deprecate(VkSwapchainKHR descendant)
@@ -696,19 +1749,24 @@ void swapchain_base::deprecate(VkSwapchainKHR descendant)
    }
 
    /* Set its descendant. */
+   std::lock_guard<std::mutex> lock(m_device_data.get_swapchain_links_lock());
    m_descendant = descendant;
 }
 
 void swapchain_base::wait_for_pending_buffers()
 {
-   std::unique_lock<std::mutex> acquire_lock(m_image_acquire_lock);
+   WSI_PROFILED_LOCK(acquire_lock, m_image_acquire_lock, image_acquire);
    int wait;
    int acquired_images = 0;
-   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
 
+   /* Waiting for all the images includes the withheld ones. */
+   release_withheld_images();
+
+   /* Only the application moves images into the ACQUIRED state, and it does not acquire while the swapchain is torn
+    * down. */
    for (auto &img : m_swapchain_images)
    {
-      if (img.status == swapchain_image::ACQUIRED)
+      if (img.status.load() == swapchain_image::ACQUIRED)
       {
          acquired_images++;
       }
@@ -718,7 +1776,6 @@ void swapchain_base::wait_for_pending_buffers()
     * compositor. The WSI backend may not necessarily know which pending image is presented to change its state. It may
     * be impossible to wait for that one presented image. */
    wait = static_cast<int>(m_swapchain_images.size()) - acquired_images - 1;
-   image_status_lock.unlock();
 
    while (wait > 0)
    {
@@ -728,6 +1785,71 @@ void swapchain_base::wait_for_pending_buffers()
    }
 }
 
+bool swapchain_base::wait_for_queued_presents()
+{
+   using clock = std::chrono::steady_clock;
+   /* Bounds the sleep so that an error state, which may stop the presentation thread, is noticed. */
+   constexpr uint64_t QUEUED_PRESENTS_TIMEOUT = 250000000; /* 250 ms. */
+   /* A presentation engine that stopped handing presents over must not hang the caller. */
+   constexpr std::chrono::seconds QUEUED_PRESENTS_DEADLINE(2);
+   const clock::time_point deadline = clock::now() + QUEUED_PRESENTS_DEADLINE;
+   const uint32_t queued = m_queued_presents.load(std::memory_order_acquire);
+   while (true)
+   {
+      const uint32_t handed_over = m_handed_over_presents.load(std::memory_order_seq_cst);
+      if (static_cast<int32_t>(queued - handed_over) <= 0)
+      {
+         return true;
+      }
+      if (error_has_occured())
+      {
+         return false;
+      }
+      if (clock::now() >= deadline)
+      {
+         WSI_LOG_WARNING("Timed out waiting for %u queued presents to be handed over.", queued - handed_over);
+         return false;
+      }
+
+      /* Announce the wait before re-checking, so a concurrent present either becomes visible here or sees the flag
+       * and wakes us up. */
+      m_handed_over_waiting.store(true, std::memory_order_seq_cst);
+      if (m_handed_over_presents.load(std::memory_order_seq_cst) == handed_over)
+      {
+         util::futex_wait(m_handed_over_presents, handed_over, QUEUED_PRESENTS_TIMEOUT);
+      }
+      m_handed_over_waiting.store(false, std::memory_order_relaxed);
+   }
+}
+
+bool swapchain_base::detach_for_deferred_teardown()
+{
+   /* In an error state the pending buffers are not waited for, so only waiting for the queue, after the presentation
+    * thread stopped, guarantees the images are unused. */
+   if (error_has_occured() || !supports_deferred_teardown())
+   {
+      return false;
+   }
+
+   if (m_queue != VK_NULL_HANDLE)
+   {
+      /* Make sure the vkFences are done signaling while the application cannot submit to the queue. */
+      WSI_PROFILED_LOCK(queue_lock, m_device_data.get_internal_queue_lock(), internal_queue);
+      m_device_data.disp.QueueWaitIdle(m_queue);
+   }
+
+   /* Handing the queued presents over uses the surface, which the reaper must not. */
+   if (!wait_for_queued_presents())
+   {
+      return false;
+   }
+
+   unlink_swapchains();
+
+   m_deferred_teardown = true;
+   return true;
+}
+
 void swapchain_base::clear_ancestor()
 {
    m_ancestor = VK_NULL_HANDLE;
@@ -761,16 +1883,147 @@ VkResult swapchain_base::wait_for_free_buffer(uint64_t timeout)
    return retval;
 }
 
+bool swapchain_base::has_free_image() const
+{
+   /* The withheld units of the free image semaphore may stand for images not allocated yet, which then count as free
+    * images too. */
+   uint32_t free_images = 0;
+   for (const auto &img : m_swapchain_images)
+   {
+      const auto status = img.status.load();
+      if (status == swapchain_image::FREE || (status == swapchain_image::UNALLOCATED && m_withheld_images != 0))
+      {
+         free_images++;
+      }
+   }
+   return free_images > m_withheld_images;
+}
+
+void swapchain_base::update_withheld_images()
+{
+   const auto image_count = static_cast<uint32_t>(m_swapchain_images.size());
+   const uint32_t limit = m_image_count_governor.get_limit();
+   uint32_t target = limit < image_count ? image_count - limit : 0;
+
+   /* An application acquiring an image while it holds others may need all the images it is entitled to, and the
+    * presentation engine may only give images back once the ones held are presented, so withhold none then. */
+   for (const auto &img : m_swapchain_images)
+   {
+      if (img.status.load() == swapchain_image::ACQUIRED)
+      {
+         target = 0;
+         break;
+      }
+   }
+
+   if (m_withheld_images > target)
+   {
+      m_free_image_semaphore.post(m_withheld_images - target);
+      m_withheld_images = target;
+   }
+
+   while (m_withheld_images < target && m_free_image_semaphore.wait(0) == VK_SUCCESS)
+   {
+      m_withheld_images++;
+   }
+}
+
+void swapchain_base::release_withheld_images()
+{
+   if (m_withheld_images != 0)
+   {
+      m_free_image_semaphore.post(m_withheld_images);
+      m_withheld_images = 0;
+   }
+}
+
+void swapchain_base::set_error_state(VkResult state)
+{
+   const VkResult previous_state = m_error_state;
+   m_error_state = state;
+
+   if (state != VK_SUCCESS && state != previous_state)
+   {
+      auto &recorder = m_device_data.get_flight_recorder();
+      recorder.record(layer::flight_recorder::event::error, this, 0, layer::flight_recorder::NO_IMAGE, state);
+
+      /* Keep the events that led to the loss of the surface, once per swapchain. */
+      if (state == VK_ERROR_SURFACE_LOST_KHR && recorder.dump(nullptr))
+      {
+         WSI_LOG_WARNING("Surface lost, flight recorder dumped.");
+      }
+   }
+
+   /* Presentations will not complete anymore, so waiting for them has to fail. */
+   auto *present_id = get_swapchain_extension<wsi::wsi_ext_present_id>();
+   if (state < 0 && present_id != nullptr)
+   {
+      present_id->set_error_state(state);
+   }
+}
+
+void swapchain_base::present_dropped(uint64_t present_id)
+{
+   if (present_id != 0)
+   {
+      WSI_TRACE_ASYNC_END("present", this, present_id);
+   }
+}
+
+void swapchain_base::set_present_id(uint64_t present_id)
+{
+   if (present_id != 0)
+   {
+      WSI_TRACE_ASYNC_END("present", this, present_id);
+   }
+   m_device_data.get_flight_recorder().record(layer::flight_recorder::event::present_complete, this, present_id,
+                                              layer::flight_recorder::NO_IMAGE);
+
+   auto *ext = get_swapchain_extension<wsi::wsi_ext_present_id>();
+   if (ext != nullptr && present_id != 0)
+   {
+      ext->set_present_id(present_id);
+   }
+}
+
+bool swapchain_base::is_present_mode_enabled(VkPresentModeKHR present_mode)
+{
+   auto *ext = get_swapchain_extension<wsi::wsi_ext_swapchain_maintenance1>();
+   if (ext != nullptr)
+   {
+      return ext->is_present_mode_enabled(present_mode);
+   }
+   return present_mode == m_present_mode;
+}
+
 void swapchain_base::release_images(uint32_t image_count, const uint32_t *indices)
 {
+   /* Shared presentable images stay acquired, as in unpresent_image(). */
+   if (m_present_mode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR ||
+       m_present_mode == VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR)
+   {
+      return;
+   }
+
+   /* The images are owned by the application, so neither the presentation thread nor the backends touch them and
+    * each one can be freed with a single atomic transition. The free images are then counted with a single post. */
+   uint32_t released_count = 0;
    for (uint32_t i = 0; i < image_count; i++)
    {
       uint32_t index = indices[i];
       assert(index < m_swapchain_images.size());
       /* Applications can only pass acquired images that the device doesn't own */
-      assert(m_swapchain_images[index].status == swapchain_image::ACQUIRED);
-      unpresent_image(index);
+      const bool released =
+         m_swapchain_images[index].status.transition(swapchain_image::ACQUIRED, swapchain_image::FREE);
+      assert(released);
+      if (released)
+      {
+         hint_free_image(index);
+         released_count++;
+      }
    }
+
+   m_free_image_semaphore.post(released_count);
 }
 
 VkResult swapchain_base::is_bind_allowed(uint32_t image_index) const
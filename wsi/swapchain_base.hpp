@@ -35,14 +35,23 @@
 #include <vulkan/vulkan.h>
 #include <thread>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <optional>
 
 #include <util/custom_allocator.hpp>
+#include <util/file_descriptor.hpp>
 #include <util/helpers.hpp>
+#include <util/memory_usage.hpp>
 #include <util/ring_buffer.hpp>
 #include <util/timed_semaphore.hpp>
 #include <util/log.hpp>
 #include <layer/private_data.hpp>
 
+#include "frame_pacer.hpp"
+#include "image_count_governor.hpp"
+#include "latency_recorder.hpp"
+#include "presentation_worker_pool.hpp"
 #include "surface_properties.hpp"
 #include "synchronization.hpp"
 
@@ -54,6 +63,28 @@ namespace wsi
 {
 
 using util::MAX_PLANES;
+
+/* Maximum number of worker threads that allocate and import swapchain images, see "parallel_image_creation". */
+#ifndef WSI_IMAGE_CREATION_THREADS
+#define WSI_IMAGE_CREATION_THREADS 4
+#endif
+
+/* Maximum number of damage rectangles kept per present, more are merged into their bounding box. */
+#ifndef WSI_MAX_PRESENT_DAMAGE_RECTS
+#define WSI_MAX_PRESENT_DAMAGE_RECTS 16
+#endif
+
+/**
+ * @brief The part of a swapchain image that changed since the previous present, from VK_KHR_incremental_present.
+ */
+struct present_damage
+{
+   /* Whether the whole image may have changed, in which case @ref rects is unused. */
+   bool full{ true };
+   uint32_t rect_count{ 0 };
+   std::array<VkRect2D, WSI_MAX_PRESENT_DAMAGE_RECTS> rects{};
+};
+
 struct swapchain_image
 {
    enum status
@@ -66,13 +97,94 @@ struct swapchain_image
       UNALLOCATED,
    };
 
+   /**
+    * @brief Atomic holder for the status of a single image.
+    *
+    * Each image tracks its own status so that threads acquiring, presenting and releasing different images never
+    * contend with each other. Transitions that can race, such as acquiring a FREE image while the presentation
+    * engine releases another one, are done with @ref transition. Copying is only supported so that the images can be
+    * placed in a util::vector while the swapchain is initialized, when no other thread accesses them.
+    */
+   class atomic_status
+   {
+   public:
+      atomic_status(enum status initial)
+         : m_value(initial)
+      {
+      }
+
+      atomic_status(const atomic_status &other)
+         : m_value(other.load())
+      {
+      }
+
+      atomic_status &operator=(const atomic_status &other)
+      {
+         store(other.load());
+         return *this;
+      }
+
+      atomic_status &operator=(enum status desired)
+      {
+         store(desired);
+         return *this;
+      }
+
+      operator enum status() const
+      {
+         return load();
+      }
+
+      enum status load() const
+      {
+         return m_value.load(std::memory_order_acquire);
+      }
+
+      void store(enum status desired)
+      {
+         m_value.store(desired, std::memory_order_release);
+      }
+
+      /**
+       * @brief Unconditionally set a new status.
+       *
+       * @return The status the image had before the call.
+       */
+      enum status exchange(enum status desired)
+      {
+         return m_value.exchange(desired, std::memory_order_acq_rel);
+      }
+
+      /**
+       * @brief Move the image from status @p expected to status @p desired.
+       *
+       * @return true if the image had status @p expected and now has status @p desired, false if the image had a
+       *         different status, in which case it is left unchanged.
+       */
+      bool transition(enum status expected, enum status desired)
+      {
+         return m_value.compare_exchange_strong(expected, desired, std::memory_order_acq_rel,
+                                                std::memory_order_acquire);
+      }
+
+   private:
+      std::atomic<enum status> m_value;
+   };
+
    /* Implementation specific data */
    void *data{ nullptr };
 
    VkImage image{ VK_NULL_HANDLE };
-   status status{ swapchain_image::INVALID };
+   atomic_status status{ swapchain_image::INVALID };
    VkSemaphore present_semaphore{ VK_NULL_HANDLE };
    VkSemaphore present_fence_wait{ VK_NULL_HANDLE };
+
+   /* Whether the semaphores are known to be unsignalled, so that they can be returned to the sync object pool. A
+    * failed present may leave them signalled. */
+   bool present_semaphores_reusable{ true };
+
+   /* Damage of the last present of the image, set on queue present and read by the WSI backend's present_image. */
+   present_damage damage{};
 };
 
 struct pending_present_request
@@ -85,8 +197,55 @@ struct pending_present_request
     * If 0, no present ID has been assigned to this request.
     */
    uint64_t present_id;
+
+   /* Presentation mode of the request, which VK_EXT_swapchain_maintenance1 may switch between presents. */
+   VkPresentModeKHR present_mode;
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   /* Time of the present request, as returned by latency_recorder::now(). 0 if not recorded. */
+   uint64_t present_time_ns;
+
+   /* Time the image should be presented at, given with VkPresentTimingInfoEXT. 0 if there is no target. */
+   uint64_t target_time_ns;
+
+   /* Slot of the present timing queue entry to complete once presented. 0 if no timing was requested. */
+   uint64_t timing_slot;
+
+   /* Slot of the frame statistics of the present in the frame boundary extension. 0 if they are not recorded. */
+   uint64_t frame_statistics_slot;
+
+   /* Points of the frame presented, for estimating when the following frames should start. */
+   frame_pacer::frame_timings frame_timings;
+#endif
+};
+
+/**
+ * @brief The structures of the pNext chain of a VkPresentInfoKHR the layer handles.
+ *
+ * Filled in a single walk of the chain by @ref find_present_info_extensions, rather than walking it again for each
+ * structure. Only the first structure of each type is used. Members are nullptr if the structure is not chained.
+ */
+struct present_info_extensions
+{
+   const VkPresentIdKHR *present_ids{ nullptr };
+   const VkPresentRegionsKHR *present_regions{ nullptr };
+   const VkSwapchainPresentFenceInfoEXT *present_fence_info{ nullptr };
+   const VkSwapchainPresentModeInfoEXT *present_mode_info{ nullptr };
+   const VkFrameBoundaryEXT *frame_boundary{ nullptr };
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   const VkPresentTimingsInfoEXT *present_timings_info{ nullptr };
+#endif
 };
 
+/**
+ * @brief Find the structures the layer handles in the pNext chain of a VkPresentInfoKHR.
+ *
+ * @param present_info The present info.
+ *
+ * @return The structures found in the chain.
+ */
+present_info_extensions find_present_info_extensions(const VkPresentInfoKHR &present_info);
+
 struct swapchain_presentation_parameters
 {
    /* Fence supplied by the application with VkSwapchainPresentFenceInfoEXT. */
@@ -115,6 +274,26 @@ struct swapchain_presentation_parameters
     */
    VkBool32 handle_present_frame_boundary_event{ true };
 
+   /*
+    * Flag that indicates whether the image takes over the present payload
+    * of another swapchain in the same presentation request from
+    * shared_payload_sync_fd, instead of submitting its own payload.
+    */
+   VkBool32 use_shared_payload{ false };
+
+   /* Sync FD of the shared present payload, -1 if it has already completed. */
+   int shared_payload_sync_fd{ -1 };
+
+   /* If not nullptr, receives a Sync FD of the present payload for other swapchains to share. */
+   util::fd_owner *share_payload_sync_fd{ nullptr };
+
+   /* If not nullptr, set once the payload for share_payload_sync_fd has waited on the semaphores of the request, even
+    * if the present fails afterwards. */
+   bool *share_payload_submitted{ nullptr };
+
+   /* Changed region given with VkPresentRegionsKHR, nullptr if the whole image may have changed. */
+   const VkPresentRegionKHR *present_region{ nullptr };
+
 #if VULKAN_WSI_LAYER_EXPERIMENTAL
    /**
     * The present timing info.
@@ -187,6 +366,8 @@ public:
     *
     * @param present_info Information about the swapchain and image to be presented.
     *
+    * @param present_extensions The structures found in the pNext chain of @p present_info.
+    *
     * @param presentation_parameters Presentation parameters.
     *
     * @return If queue submission fails returns error of vkQueueSubmit, if the
@@ -194,6 +375,7 @@ public:
     * otherwise returns VK_SUCCESS.
     */
    VkResult queue_present(VkQueue queue, const VkPresentInfoKHR *present_info,
+                          const present_info_extensions &present_extensions,
                           const swapchain_presentation_parameters &presentation_parameters);
 
    /**
@@ -251,6 +433,17 @@ public:
       return m_swapchain_images[image_index].present_semaphore;
    }
 
+   /**
+    * @brief Check whether the swapchain can share present payloads with other swapchains.
+    *
+    * @return true if swapchain_presentation_parameters::use_shared_payload and
+    *         swapchain_presentation_parameters::share_payload_sync_fd can be used with this swapchain.
+    */
+   bool can_share_present_payload() const
+   {
+      return m_present_fence_import;
+   }
+
    /**
     * @brief Get the swapchain status.
     *
@@ -262,6 +455,8 @@ public:
     * @brief Release all images not belonging to the device
     * by making them available to be acquired again
     *
+    * Does not lock nor wait for the presentation thread, so that resizes are not held up by the presentation engine.
+    *
     * @param image_count Amount of images in the indices array
     * @param indices Array of image indices
     */
@@ -304,7 +499,84 @@ public:
 
    bool add_swapchain_extension(util::unique_ptr<wsi_ext> extension);
 
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   /**
+    * @brief Get the latency histograms of the swapchain.
+    *
+    * @param histograms Output structure filled with the histograms accumulated since the swapchain was created.
+    */
+   void get_latency_histograms(VkSwapchainLatencyHistogramsARM &histograms) const
+   {
+      m_latency_recorder.get_histograms(histograms);
+   }
+
+   /**
+    * @brief Get the memory held by the swapchain.
+    */
+   const util::memory_usage &get_memory_usage() const
+   {
+      return m_memory_usage;
+   }
+
+   /**
+    * @brief Get the statistics of the most recent frames presented to the swapchain.
+    *
+    * @param[in,out] frame_count      Number of elements of @p frame_statistics, set to the number written. If
+    *                                 @p frame_statistics is nullptr, set to the number of frames available.
+    * @param[out]    frame_statistics Output array, or nullptr.
+    *
+    * @return VK_SUCCESS or VK_INCOMPLETE, or VK_ERROR_FEATURE_NOT_PRESENT if the layer does not pass its own frame
+    *         boundary events, in which case it records no statistics.
+    */
+   VkResult get_frame_statistics(uint32_t *frame_count, VkSwapchainFrameStatisticsARM *frame_statistics)
+   {
+      auto *ext = get_swapchain_extension<wsi::wsi_ext_frame_boundary>();
+      if (ext == nullptr)
+      {
+         return VK_ERROR_FEATURE_NOT_PRESENT;
+      }
+      return ext->get_frame_statistics(frame_count, frame_statistics);
+   }
+
+   /**
+    * @brief Record a latency marker of the frame the application is working on.
+    */
+   void set_latency_marker(VkLatencyMarkerARM marker)
+   {
+      m_frame_pacer.set_marker(marker, latency_recorder::now());
+   }
+
+   /**
+    * @brief Wait until the optimal time to start the next frame.
+    *
+    * @param timeout Longest time to wait for, in nanoseconds.
+    *
+    * @return VK_SUCCESS, or VK_TIMEOUT if the optimal time is further away than @p timeout.
+    */
+   VkResult latency_sleep(uint64_t timeout);
+#endif
+
+   /**
+    * @brief Prepare the swapchain to be torn down on another thread than the one destroying it.
+    *
+    * Does the part of the teardown that involves other objects on the destroying thread: waits for the queue of the
+    * swapchain to be idle, as the application may submit to it from other threads later on, waits for the descendant
+    * to be done with this swapchain and unlinks it from its ancestor and descendant. The rest of the teardown only
+    * waits for the presentation engine to release the images of the swapchain and destroys them.
+    *
+    * Must only be called for swapchains created without allocation callbacks of the application, which must not be
+    * called once vkDestroySwapchainKHR returns.
+    *
+    * @return false if the swapchain has to be torn down synchronously, because it is in an error state or its
+    *         teardown uses the surface, see @ref supports_deferred_teardown. The swapchain can be torn down
+    *         synchronously either way.
+    */
+   bool detach_for_deferred_teardown();
+
 protected:
+   /* Allow the presentation worker pool to present on behalf of the page flip thread. */
+   friend class presentation_worker_pool;
+
    layer::device_private_data &m_device_data;
 
    /**
@@ -319,23 +591,54 @@ protected:
 
    /**
     * @brief A semaphore to be signalled once a page flip event occurs.
+    *
+    * Only used in VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR mode, other modes wake up the page flip thread through
+    * @ref m_pending_buffer_pool.
     */
    util::timed_semaphore m_page_flip_semaphore;
 
    /**
-    * @brief A semaphore to be signalled once the swapchain has one frame on screen.
+    * @brief Pool of presentation workers that services this swapchain instead of @ref m_page_flip_thread, or nullptr
+    * if the swapchain uses its own page flip thread.
+    */
+   presentation_worker_pool *m_presentation_workers;
+
+   /**
+    * @brief Request taken from @ref m_pending_buffer_pool by the presentation worker pool, whose present payload has
+    * not finished yet. Only accessed by the worker servicing the swapchain.
+    */
+   std::optional<pending_present_request> m_pool_request;
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   /**
+    * @brief Latency histograms of the acquire, GPU and presentation stages of the swapchain.
+    */
+   latency_recorder m_latency_recorder;
+
+   /**
+    * @brief Estimates when the application should start its frames, see latency_sleep().
     */
-   sem_t m_start_present_semaphore;
+   frame_pacer m_frame_pacer;
+#endif
 
    /**
-    * @brief A mutex to protect access to the statuses of the swapchain's images and
-    * any code paths that rely on this information. We use a recursive mutex as some
-    * functions such as 'destroy_image' both change an image's status and are called
-    * conditionally based on an image's status in some cases. A recursive mutex allows
-    * these functions to be called both with and without the mutex already locked in the
-    * same thread.
+    * @brief Event file descriptor used to wake up the page flip thread when a present request is queued or when the
+    * thread has to terminate. Only valid when the page flip thread is event driven.
     */
-   std::recursive_mutex m_image_status_mutex;
+   util::fd_owner m_page_flip_event_fd;
+
+   /**
+    * @brief Epoll instance the event driven page flip thread blocks on. It watches @ref m_page_flip_event_fd and the
+    * present sync FD of the image the thread is waiting for.
+    */
+   util::fd_owner m_page_flip_epoll_fd;
+
+   /**
+    * @brief Set once the first present no longer uses the ancestor, protected by the swapchain links lock of the
+    *        device. Once @ref m_started_presenting is set, the ancestor waits for it before it is unlinked, see
+    *        @ref unlink_swapchains.
+    */
+   bool m_ancestor_released;
 
    /**
     * @brief Defines if the pthread_t and sem_t members of the class are defined.
@@ -352,18 +655,41 @@ protected:
 
    /**
     * @brief In order to present the images in a FIFO order we implement
-    * a ring buffer to hold the images queued for presentation. Since the
-    * two pointers (head and tail) are used by different
-    * threads and we do not allow the application to acquire more images
-    * than we have we eliminate race conditions.
+    * a ring buffer to hold the images queued for presentation. The application
+    * thread in @ref notify_presentation_engine is the only producer and the
+    * page flip thread is the only consumer, so the ring buffer is lock-free.
+    */
+   util::spsc_ring_buffer<pending_present_request, wsi::surface_properties::MAX_SWAPCHAIN_IMAGE_COUNT>
+      m_pending_buffer_pool;
+
+   /**
+    * @brief Memory held by the swapchain, also recorded in the totals of the device.
+    *
+    * Counts the device memory of the swapchain images, the dma-bufs they are imported from and the chunks of
+    * @ref m_arena. The allocations made after the arena is sealed are not counted.
+    */
+   util::memory_usage m_memory_usage;
+
+   /**
+    * @brief Arena holding the allocations made while the swapchain is created, released when it is destroyed.
+    *
+    * It is sealed once @ref init succeeds, after which @ref m_allocator forwards to the user provided callbacks.
     */
-   util::ring_buffer<pending_present_request, wsi::surface_properties::MAX_SWAPCHAIN_IMAGE_COUNT> m_pending_buffer_pool;
+   util::arena m_arena;
 
    /**
     * @brief User provided memory allocation callbacks.
     */
    const util::allocator m_allocator;
 
+   /**
+    * @brief Allocator for the per image data of the backends.
+    *
+    * The data of FREE images may be taken over by a descendant swapchain, see @ref adopt_ancestor_image, and outlive
+    * this swapchain, so it never comes from @ref m_arena.
+    */
+   const util::allocator m_image_allocator;
+
    /**
     * @brief Vector of images in the swapchain.
     */
@@ -375,15 +701,13 @@ protected:
    VkSurfaceKHR m_surface;
 
    /**
-    * @brief Present mode currently being used for this swapchain
+    * @brief Present mode this swapchain was created with.
+    *
+    * Presents may use another mode enabled with VkSwapchainPresentModesCreateInfoEXT, which is given to the backends
+    * in pending_present_request::present_mode.
     */
    VkPresentModeKHR m_present_mode;
 
-   /**
-    * @brief Possible presentation modes this swapchain is allowed to present with VkSwapchainPresentModesCreateInfoEXT
-    */
-   util::vector<VkPresentModeKHR> m_present_modes;
-
    /**
     * @brief Descendant of this swapchain.
     * Used to check whether or not a descendant of this swapchain has started
@@ -415,6 +739,12 @@ protected:
     */
    VkImageCreateInfo m_image_create_info;
 
+   /**
+    * @brief Whether the images created with the swapchain are allocated and imported on worker threads, see
+    *        @ref supports_parallel_image_creation. Set before @ref init_platform is called.
+    */
+   bool m_parallel_image_creation;
+
    /**
     * @brief Return the VkAllocationCallbacks passed in this object constructor.
     */
@@ -430,11 +760,13 @@ protected:
 
    /**
     * @brief Remove cached ancestor.
+    * @note The swapchain links lock of the device must be held.
     */
    void clear_ancestor();
 
    /**
     * @brief Remove cached descendant.
+    * @note The swapchain links lock of the device must be held.
     */
    void clear_descendant();
 
@@ -501,6 +833,66 @@ protected:
     */
    virtual VkResult allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image) = 0;
 
+   /**
+    * @brief Whether the backend splits @ref allocate_and_bind_swapchain_image into the steps used by parallel image
+    *        creation: @ref allocate_swapchain_image_buffer, @ref export_swapchain_image and
+    *        @ref import_swapchain_image_buffer.
+    *
+    * When it does and the "parallel_image_creation" setting is enabled, the images created with the swapchain are
+    * allocated and imported on worker threads, while the platform objects are created on the calling thread, in
+    * image order, once all the buffers are allocated.
+    */
+   virtual bool supports_parallel_image_creation() const
+   {
+      return false;
+   }
+
+   /**
+    * @brief Allocate the buffer of a swapchain image created by @ref create_swapchain_image.
+    *
+    * Called on worker threads for several images at once, it must only touch the state of @p image.
+    *
+    * @param image The image.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   virtual VkResult allocate_swapchain_image_buffer(swapchain_image &image)
+   {
+      UNUSED(image);
+      return VK_SUCCESS;
+   }
+
+   /**
+    * @brief Create the platform object of a swapchain image, e.g. its pixmap, wl_buffer or framebuffer.
+    *
+    * Called on the thread creating the swapchain, for one image at a time in image order, after the buffers of all
+    * the images have been allocated and before any of them is imported.
+    *
+    * @param image_create_info Data used to create the image.
+    * @param image             The image.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   virtual VkResult export_swapchain_image(const VkImageCreateInfo &image_create_info, swapchain_image &image)
+   {
+      return allocate_and_bind_swapchain_image(image_create_info, image);
+   }
+
+   /**
+    * @brief Import the buffer of a swapchain image and bind it to the image.
+    *
+    * Called on worker threads for several images at once, it must only touch the state of @p image.
+    *
+    * @param image The image.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   virtual VkResult import_swapchain_image_buffer(swapchain_image &image)
+   {
+      UNUSED(image);
+      return VK_SUCCESS;
+   }
+
    /**
     * @brief Creates a new swapchain image.
     *
@@ -531,6 +923,16 @@ protected:
     */
    void unpresent_image(uint32_t presented_index);
 
+   /**
+    * @brief Check whether an image is free for the application to acquire.
+    *
+    * Free images withheld by the image count governor do not count. Must be called with the acquire lock held, as
+    * from get_free_buffer().
+    *
+    * @return true if an image is free, otherwise false.
+    */
+   bool has_free_image() const;
+
    /**
     * @brief Method to release a swapchain image
     *
@@ -587,6 +989,193 @@ protected:
     */
    virtual VkResult image_wait_present(swapchain_image &image, uint64_t timeout) = 0;
 
+   /**
+    * @brief Get a Sync FD that becomes readable once the present payload of an image has finished.
+    *
+    * Allows the event driven page flip thread to block on the present payload together with its other events,
+    * instead of blocking in @ref image_wait_present. The WSI implementation keeps ownership of the file descriptor.
+    *
+    * @param[in] image The swapchain image for which the page flip thread needs to wait for the present payload.
+    *
+    * @return A file descriptor to poll, or -1 if there is nothing to poll. In both cases @ref image_wait_present is
+    *         still called before presenting the image.
+    */
+   virtual int image_get_present_sync_fd(swapchain_image &image)
+   {
+      UNUSED(image);
+      return -1;
+   }
+
+   /**
+    * @brief Take the release fence of an image that has just been acquired.
+    *
+    * Presentation engines that return buffers with a release fence can make images available for acquire before
+    * they have finished reading them. The fence then becomes the payload of the acquire semaphore and fence.
+    *
+    * @param[in] image The swapchain image that has been acquired.
+    *
+    * @return A Sync FD the application's use of the image must wait for, or an invalid file descriptor if the image
+    *         can be used right away.
+    */
+   virtual util::fd_owner image_take_release_sync_fd(swapchain_image &image)
+   {
+      UNUSED(image);
+      return util::fd_owner{};
+   }
+
+   /**
+    * @brief Whether the WSI implementation can exchange present payloads as Sync FDs.
+    *
+    * @return true if @ref image_import_present_payload, @ref image_get_shareable_present_payload and
+    *         @ref image_set_shared_present_payload are implemented, false otherwise.
+    */
+   virtual bool supports_present_payload_import()
+   {
+      return false;
+   }
+
+   /**
+    * @brief Make a fence signal when the present payload of an image completes, without a queue submission.
+    *
+    * Only called if @ref supports_present_payload_import returns true.
+    *
+    * @param[in] image The swapchain image with the present payload set by @ref image_set_present_payload.
+    * @param     fence The fence to signal.
+    *
+    * @return VK_SUCCESS on success or an error code otherwise. On failure the present payload must have completed, so
+    *         that the fence can be signalled without being ordered after it.
+    */
+   virtual VkResult image_import_present_payload(swapchain_image &image, VkFence fence)
+   {
+      UNUSED(image);
+      UNUSED(fence);
+      return VK_ERROR_FEATURE_NOT_PRESENT;
+   }
+
+   /**
+    * @brief Get a Sync FD of the present payload of an image that images of other swapchains can share.
+    *
+    * Only called if @ref supports_present_payload_import returns true.
+    *
+    * @param[in]  image   The swapchain image with the present payload set by @ref image_set_present_payload.
+    * @param[out] sync_fd A file descriptor owned by the WSI implementation and valid until the image is handed to the
+    *                     presentation engine, or -1 if the payload has completed.
+    *
+    * @return VK_SUCCESS on success or an error code otherwise.
+    */
+   virtual VkResult image_get_shareable_present_payload(swapchain_image &image, int &sync_fd)
+   {
+      UNUSED(image);
+      sync_fd = -1;
+      return VK_ERROR_FEATURE_NOT_PRESENT;
+   }
+
+   /**
+    * @brief Set the present payload of an image to a payload shared by another swapchain.
+    *
+    * Only called if @ref supports_present_payload_import returns true.
+    *
+    * @param[in] image   The swapchain image for which to set a present payload.
+    * @param     queue   The queue the image is presented on, for implementations that still need to submit work.
+    * @param     sync_fd Sync FD of the shared payload, or -1 if it has completed. The caller keeps ownership.
+    *
+    * @return VK_SUCCESS on success or an error code otherwise.
+    */
+   virtual VkResult image_set_shared_present_payload(swapchain_image &image, VkQueue queue, int sync_fd)
+   {
+      UNUSED(image);
+      UNUSED(queue);
+      UNUSED(sync_fd);
+      return VK_ERROR_FEATURE_NOT_PRESENT;
+   }
+
+   /**
+    * @brief Take over a FREE image of the ancestor swapchain.
+    *
+    * Called during swapchain creation with an image of @p ancestor that already has been claimed and is compatible
+    * with the core parameters of @ref m_image_create_info. The WSI implementation should check that its own image
+    * parameters match and move any per image state that refers to the ancestor over to this swapchain.
+    *
+    * @param ancestor The swapchain the image currently belongs to. It has the same WSI implementation as this one.
+    * @param image    The image of the ancestor to take over.
+    *
+    * @return true if the image can be used by this swapchain, false if it has to be left with the ancestor.
+    */
+   virtual bool adopt_ancestor_image(swapchain_base &ancestor, swapchain_image &image)
+   {
+      UNUSED(ancestor);
+      UNUSED(image);
+      return false;
+   }
+
+   /**
+    * @brief Check whether the swapchain can be torn down on the swapchain reaper.
+    *
+    * The teardown then runs while a new swapchain presents to the same surface, so it must neither use the surface
+    * nor objects shared with the other swapchains of the surface.
+    */
+   virtual bool supports_deferred_teardown() const
+   {
+      return false;
+   }
+
+   /**
+    * @brief Wait for the presents handed to the presentation engine to complete, and stop receiving its events.
+    *
+    * Called by @ref teardown once no more presents are handed to the presentation engine, before the images are
+    * destroyed. Only needed when the presentation engine completes presents asynchronously, through callbacks that
+    * use the images.
+    */
+   virtual void finish_presentation()
+   {
+   }
+
+   /**
+    * @brief Check whether @ref present_image may wait for the presentation engine, e.g. for a refresh or for an
+    *        earlier present to complete.
+    *
+    * Only swapchains whose presents never wait are presented by the presentation worker pool, as the workers are
+    * shared with the other swapchains of the device.
+    */
+   virtual bool present_image_may_block() const
+   {
+      return true;
+   }
+
+   /**
+    * @brief Order the first present of the swapchain after the presents of the ancestor swapchain.
+    *
+    * Called by the first present, once @p ancestor has handed all its queued presents over to the presentation
+    * engine but possibly before they are shown. The presentation engine shows presents to the same surface in the
+    * order they are received on most window systems, so the default does nothing.
+    *
+    * @param ancestor The ancestor swapchain. It has the same WSI implementation as this one.
+    */
+   virtual void order_after_ancestor(swapchain_base &ancestor)
+   {
+      UNUSED(ancestor);
+   }
+
+   /**
+    * @brief Whether the surface is hidden, so that the images presented to it are not seen.
+    *
+    * Called by acquire when the "occluded_frame_rate" setting is enabled, so it must not block. By default surfaces
+    * are never reported hidden.
+    */
+   virtual bool is_surface_occluded()
+   {
+      return false;
+   }
+
+   /**
+    * @brief Whether acquires are throttled while the surface is hidden, so backends only track whether it is when
+    *        needed.
+    */
+   bool is_occlusion_throttled() const
+   {
+      return m_occluded_acquire_interval.count() != 0;
+   }
+
    /**
     * @brief Returns true if an error has occurred.
     */
@@ -608,11 +1197,56 @@ protected:
     *
     * @param state Error code to be returned from acquire_next_image.
     */
-   void set_error_state(VkResult state)
+   void set_error_state(VkResult state);
+
+   /**
+    * @brief Make the acquires, presents and status queries of the swapchain return VK_SUBOPTIMAL_KHR from now on.
+    *
+    * Unlike an error state, this does not stop the presentation thread and the teardown still waits for the
+    * presented images.
+    */
+   void set_suboptimal()
    {
-      m_error_state = state;
+      m_suboptimal.store(true, std::memory_order_relaxed);
    }
 
+   /**
+    * @brief Get VK_SUBOPTIMAL_KHR if @ref set_suboptimal was called, VK_SUCCESS otherwise.
+    */
+   VkResult get_success_status() const
+   {
+      return m_suboptimal.load(std::memory_order_relaxed) ? VK_SUBOPTIMAL_KHR : VK_SUCCESS;
+   }
+
+   /**
+    * @brief Advance the present ID of the swapchain, once the presentation with @p present_id is complete.
+    *
+    * Does nothing if the present ID feature is not enabled or @p present_id is 0.
+    *
+    * @param present_id The present ID of the presentation.
+    */
+   void set_present_id(uint64_t present_id);
+
+   /**
+    * @brief Record that the presentation with @p present_id is dropped and will never complete, e.g. replaced in
+    *        mailbox mode or failed, so that its trace slice ends.
+    *
+    * @param present_id The present ID of the presentation, or 0.
+    */
+   void present_dropped(uint64_t present_id);
+
+   /**
+    * @brief Check whether presents may use a presentation mode.
+    *
+    * Backends use this where they set up state at creation time which some of the modes the swapchain can switch
+    * between need.
+    *
+    * @param present_mode The presentation mode to check.
+    *
+    * @return true if the swapchain was created with @p present_mode or may switch to it.
+    */
+   bool is_present_mode_enabled(VkPresentModeKHR present_mode);
+
 private:
    std::mutex m_image_acquire_lock;
    /**
@@ -624,6 +1258,11 @@ private:
     */
    VkResult m_error_state;
 
+   /**
+    * @brief Set by @ref set_suboptimal.
+    */
+   std::atomic<bool> m_suboptimal{ false };
+
    /**
     * @brief Wait for a buffer to become free.
     */
@@ -639,6 +1278,85 @@ private:
     */
    util::timed_semaphore m_free_image_semaphore;
 
+   /**
+    * @brief Chooses how many images the application can use when the "adaptive_image_count" setting is enabled.
+    */
+   image_count_governor m_image_count_governor;
+
+   /**
+    * @brief Number of units of @ref m_free_image_semaphore taken to keep images from the application, following the
+    *        limit of @ref m_image_count_governor. Only accessed with the acquire lock held.
+    */
+   uint32_t m_withheld_images;
+
+   /**
+    * @brief Withhold free images, or give them back, to follow the limit of @ref m_image_count_governor.
+    *
+    * Never waits: only the images that are free already are withheld.
+    */
+   void update_withheld_images();
+
+   /**
+    * @brief Give all the withheld images back, e.g. before waiting for all the images to be free.
+    */
+   void release_withheld_images();
+
+   /**
+    * @brief Bitmask of the images made FREE since they were last acquired, one bit per image index below 64.
+    *
+    * Lets acquire find a free image with a single atomic operation instead of searching the images. It is only a hint:
+    * images are claimed by their status transition, and a bit may stay set for an image that has since been claimed
+    * otherwise, e.g. by the search of the slow path or by a descendant taking it over.
+    */
+   std::atomic<uint64_t> m_free_image_hint{ 0 };
+
+   /**
+    * @brief Record in @ref m_free_image_hint that an image has been made FREE.
+    *
+    * Must be called after the status of the image is set and before @ref m_free_image_semaphore is posted for it.
+    */
+   void hint_free_image(size_t image_index);
+
+   /**
+    * @brief Claim an image found through @ref m_free_image_hint, without taking the acquire lock or blocking.
+    *
+    * @return The index of the image, which is now ACQUIRED, or an empty optional if no free image is known.
+    */
+   std::optional<uint32_t> claim_hinted_free_image();
+
+   /**
+    * @brief Wait for a free image and claim it, allocating its memory if needed, with the acquire lock held.
+    *
+    * @param      timeout     Time to wait for a free image, in nanoseconds.
+    * @param[out] image_index The index of the image, which is now ACQUIRED.
+    *
+    * @return VK_SUCCESS on success, otherwise the result of waiting or the error state of the swapchain.
+    */
+   VkResult wait_and_claim_free_image(uint64_t timeout, uint32_t &image_index);
+
+   /**
+    * @brief Minimum time between acquires while the surface is hidden, from the "occluded_frame_rate" setting. 0 when
+    *        acquires are not throttled.
+    */
+   std::chrono::nanoseconds m_occluded_acquire_interval{ 0 };
+
+   /**
+    * @brief Time the last acquire went past @ref throttle_occluded_acquire.
+    *
+    * Atomic since acquires of the swapchain are not serialized by the layer before they are throttled.
+    */
+   std::atomic<std::chrono::steady_clock::time_point> m_last_acquire_time{};
+
+   /**
+    * @brief Hold an acquire back while the surface is hidden, to keep to the "occluded_frame_rate" setting.
+    *
+    * @param timeout Time the acquire may wait, in nanoseconds.
+    *
+    * @return VK_SUCCESS once the acquire may go ahead, VK_NOT_READY or VK_TIMEOUT if it would have to wait longer than
+    *         @p timeout.
+    */
+   VkResult throttle_occluded_acquire(uint64_t timeout);
+
    /**
     * @brief Per swapchain thread function that handles page flipping.
     *
@@ -665,6 +1383,52 @@ private:
     **/
    void page_flip_thread();
 
+   /**
+    * @brief Page flip thread loop used when the thread is event driven.
+    *
+    * Instead of waking up periodically, the thread blocks on @ref m_page_flip_epoll_fd until a present request is
+    * queued, the present payload of the oldest pending image finishes or the thread is asked to terminate.
+    */
+   void event_driven_page_flip_thread();
+
+   /**
+    * @brief Present the oldest pending present request, if any.
+    *
+    * Used by the presentation worker pool in place of the page flip thread. Does not wait for the present payload of
+    * the image: if it has not finished the request is kept to be presented by a later call.
+    *
+    * @param[out] wait_fd Set when the payload has not finished, to a file descriptor that becomes readable once it
+    *                     has, or -1 if there is none. The WSI implementation keeps ownership of it.
+    *
+    * @return Whether more present requests are pending, or the payload of the oldest one is.
+    */
+   pool_present_status present_pending_request(int &wait_fd);
+
+   /**
+    * @brief Release the images of the present requests that the presentation worker pool has not presented. Called
+    *        once the swapchain has been removed from the pool.
+    */
+   void drop_pending_requests();
+
+   /**
+    * @brief Count a present request as handed over to the presentation engine, see @ref wait_for_queued_presents.
+    */
+   void mark_present_handed_over();
+
+   /**
+    * @brief Block until the page flip thread has an event to handle.
+    *
+    * @param sync_fd A present Sync FD to wait for in addition to @ref m_page_flip_event_fd, or -1.
+    *
+    * @return true if @p sync_fd is readable or could not be waited on, false otherwise.
+    */
+   bool wait_for_page_flip_event(int sync_fd);
+
+   /**
+    * @brief Wake up the event driven page flip thread.
+    */
+   void signal_page_flip_event();
+
    /**
     * @brief Call the swapchain implementation specific present_image function.
     *
@@ -672,14 +1436,36 @@ private:
     * communication with the ancestor before the first presentation.
     *
     * @param pending_present_request Submission information for the present request.
+    * @param payload_waited          Whether the present payload of the image is known to have completed, in which
+    *                                case the latency of the payload is recorded.
     */
-   void call_present(const pending_present_request &pending_present);
+   void call_present(const pending_present_request &pending_present, bool payload_waited);
 
    /**
     * @brief Return true if the descendant has started presenting.
     */
    bool has_descendant_started_presenting();
 
+   /**
+    * @brief Wait for the descendant to be done with this swapchain, then unlink it from its ancestor and descendant.
+    *
+    * The links are only read and written with the swapchain links lock of the device held, so that the swapchains
+    * linked to this one can be destroyed concurrently on other threads.
+    */
+   void unlink_swapchains();
+
+   /**
+    * @brief Move a compatible FREE image of the ancestor swapchain into @p image.
+    *
+    * Must be called before the ancestor is deprecated, as deprecation destroys its FREE images.
+    *
+    * @param ancestor The swapchain passed as oldSwapchain.
+    * @param image    The image slot of this swapchain to fill.
+    *
+    * @return true if an image was recycled, false if @p image needs to be created.
+    */
+   bool recycle_ancestor_image(swapchain_base &ancestor, swapchain_image &image);
+
    /**
     * @brief Initialize the page flipping thread.
     *
@@ -687,6 +1473,30 @@ private:
     */
    VkResult init_page_flip_thread();
 
+   /**
+    * @brief Allocate, export and import the images created with the swapchain, running the allocations and imports
+    *        on worker threads.
+    *
+    * @param image_create_info Data used to create the images.
+    * @param images            The images, created by @ref create_swapchain_image.
+    *
+    * @return VK_SUCCESS on success or the error of the first step that failed.
+    */
+   VkResult create_images_in_parallel(const VkImageCreateInfo &image_create_info,
+                                      const util::vector<swapchain_image *> &images);
+
+   /**
+    * @brief Run a step of @ref create_images_in_parallel for all the images, on worker threads and on the calling
+    *        thread. Once a step fails, the images not started yet are skipped.
+    *
+    * @param images The images.
+    * @param step   The step.
+    *
+    * @return VK_SUCCESS on success or the error of a step that failed.
+    */
+   VkResult run_image_creation_step(const util::vector<swapchain_image *> &images,
+                                    VkResult (swapchain_base::*step)(swapchain_image &));
+
    /**
     * @brief Notify the presentation engine with the next image to be presented.
     *
@@ -701,9 +1511,86 @@ private:
    VkResult notify_presentation_engine(const pending_present_request &submit_info);
 
    /**
-    * @brief A flag to track if swapchain has started presenting.
+    * @brief A flag to track if swapchain has started presenting. Read by the ancestor from other threads.
+    */
+   std::atomic<bool> m_started_presenting;
+
+   /**
+    * @brief Whether the swapchain is torn down on the swapchain reaper, see @ref detach_for_deferred_teardown.
+    */
+   bool m_deferred_teardown;
+
+   /**
+    * @brief Number of present requests queued to the swapchain, only written by the application thread.
+    */
+   std::atomic<uint32_t> m_queued_presents;
+
+   /**
+    * @brief Number of present requests handed over to the presentation engine, see @ref wait_for_queued_presents.
+    */
+   std::atomic<uint32_t> m_handed_over_presents;
+
+   /**
+    * @brief Set while a descendant may be sleeping on @ref m_handed_over_presents.
+    */
+   std::atomic<bool> m_handed_over_waiting;
+
+   /**
+    * @brief Set the present payload of an image to the merged Sync FDs of the wait semaphores of a present request.
+    *
+    * Each semaphore is exported to a Sync FD, which waits on it the same way a queue submission would, and the Sync
+    * FDs are merged into a single one that the presentation engine waits on. This saves the queue submission of the
+    * payload. Semaphores that fail to export are waited on by a queue submission instead, after the ones already
+    * exported have completed on the host.
+    *
+    * @param image                 The swapchain image for which to set a present payload.
+    * @param queue                 The queue used if a semaphore cannot be exported.
+    * @param wait_semaphores       The wait semaphores, all of them exportable to Sync FDs.
+    * @param wait_semaphores_count Number of wait semaphores.
+    *
+    * @return VK_SUCCESS on success or an error code otherwise.
+    */
+   VkResult set_merged_present_payload(swapchain_image &image, VkQueue queue, const VkSemaphore *wait_semaphores,
+                                       uint32_t wait_semaphores_count);
+
+   /**
+    * @brief Wait until the present requests queued so far have been handed over to the presentation engine.
+    *
+    * Used by the first present of a descendant, so that it is queued behind the last present of this swapchain in the
+    * presentation engine without waiting for the images to be released. Gives up if the swapchain enters an error
+    * state, as its presentation thread may then drop requests, or if the requests are not handed over within a few
+    * seconds.
+    *
+    * @return true if all the queued requests were handed over, false if the wait gave up.
+    */
+   bool wait_for_queued_presents();
+
+   /**
+    * @brief Whether acquire signals the application's fence and semaphore by importing an already signalled sync FD.
+    *
+    * Chosen from the device's sync FD import support on creation and cleared if the ICD rejects an import later.
+    * Only accessed by acquire, which applications synchronize externally.
+    */
+   bool m_acquire_import_fence_sync_fd;
+   bool m_acquire_import_semaphore_sync_fd;
+
+   /**
+    * @brief The already signalled sync FDs imported by acquire: -1 for the sentinel or the device's signalled sync FD.
+    */
+   int m_acquire_fence_sync_fd;
+   int m_acquire_semaphore_sync_fd;
+
+   /**
+    * @brief Whether the present payload is imported into the application's present fence, instead of signalling the
+    * fence with a second queue submission.
+    */
+   bool m_present_fence_import;
+
+   /**
+    * @brief Whether the wait semaphores of the application are exported and merged into the present payload as a Sync
+    * FD, instead of being waited on by a queue submission. See @ref set_merged_present_payload.
     */
-   bool m_started_presenting;
+   bool m_merge_present_wait_semaphores;
 
    /**
     * @brief Holds the swapchain extensions and related functionalities.
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file swapchain_reaper.cpp
+ *
+ * @brief Contains the deferred destruction of swapchains on a background thread.
+ */
+
+#include <cassert>
+#include <new>
+#include <system_error>
+
+#include "layer/private_data.hpp"
+#include "util/log.hpp"
+#include "util/macros.hpp"
+#include "util/thread.hpp"
+
+#include "swapchain_base.hpp"
+#include "swapchain_reaper.hpp"
+
+namespace wsi
+{
+
+swapchain_reaper::swapchain_reaper(layer::device_private_data &device_data, const util::allocator &allocator)
+   : m_device_data(device_data)
+   , m_pending(allocator)
+   , m_run(true)
+{
+}
+
+util::unique_ptr<swapchain_reaper> swapchain_reaper::create(layer::device_private_data &device_data,
+                                                            const util::allocator &allocator)
+{
+   auto reaper = allocator.make_unique<swapchain_reaper>(device_data, allocator);
+   if (reaper == nullptr)
+   {
+      return nullptr;
+   }
+
+   try
+   {
+      reaper->m_thread = util::start_thread("wsi-reaper", nullptr, &swapchain_reaper::reaper_thread, reaper.get());
+   }
+   catch (const std::system_error &)
+   {
+      WSI_LOG_ERROR("Failed to start the swapchain reaper thread.");
+      return nullptr;
+   }
+   catch (const std::bad_alloc &)
+   {
+      WSI_LOG_ERROR("Failed to start the swapchain reaper thread.");
+      return nullptr;
+   }
+
+   return reaper;
+}
+
+swapchain_reaper::~swapchain_reaper()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_run = false;
+   }
+   m_work_available.notify_all();
+
+   if (m_thread.joinable())
+   {
+      m_thread.join();
+   }
+   assert(m_pending.empty());
+}
+
+bool swapchain_reaper::defer_destruction(swapchain_base *swapchain, const util::allocator &allocator)
+{
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (!m_pending.try_reserve(m_pending.size() + 1))
+      {
+         return false;
+      }
+
+      /* Cannot fail, the capacity was reserved above. */
+      bool res = m_pending.try_push_back(pending_destruction{ swapchain, allocator });
+      assert(res);
+      UNUSED(res);
+      m_device_data.instance_data.add_deferred_swapchain_destruction();
+   }
+   m_work_available.notify_one();
+   return true;
+}
+
+void swapchain_reaper::reaper_thread()
+{
+   std::unique_lock<std::mutex> lock(m_lock);
+   while (true)
+   {
+      m_work_available.wait(lock, [this]() { return !m_run || !m_pending.empty(); });
+      if (m_pending.empty())
+      {
+         /* Only terminate once all the swapchains handed over have been destroyed. */
+         break;
+      }
+
+      pending_destruction entry = m_pending.front();
+      m_pending.erase(m_pending.begin());
+
+      lock.unlock();
+      entry.allocator.destroy(1, entry.swapchain);
+      m_device_data.instance_data.complete_deferred_swapchain_destruction();
+      lock.lock();
+   }
+}
+
+} /* namespace wsi */
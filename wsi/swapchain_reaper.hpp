@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file swapchain_reaper.hpp
+ *
+ * @brief Contains the deferred destruction of swapchains on a background thread.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <vulkan/vulkan.h>
+
+#include "util/custom_allocator.hpp"
+#include "util/helpers.hpp"
+
+namespace layer
+{
+class device_private_data;
+}
+
+namespace wsi
+{
+
+class swapchain_base;
+
+/**
+ * @brief Destroys the swapchains of a device on a background thread.
+ *
+ * Tearing a swapchain down waits for the presentation engine to release its images and for the presentation thread
+ * to finish, which can take several frames. When the deferred_swapchain_destruction setting is enabled,
+ * vkDestroySwapchainKHR detaches the swapchain from the queue and the other swapchains and hands it over to the reaper
+ * instead, so that the destroying thread, often the one recreating the swapchain on a resize, does not wait for the
+ * presentation engine. The reaper neither calls allocation callbacks of the application nor uses the surface.
+ *
+ * The swapchains are destroyed in the order they were handed over. Destroying a surface or the device first waits for
+ * the pending destructions, as the swapchains still use them.
+ */
+class swapchain_reaper : private util::noncopyable
+{
+public:
+   /**
+    * @brief Create a reaper and start its thread.
+    *
+    * @param device_data The device the swapchains belong to.
+    * @param allocator   The allocator the reaper will use.
+    *
+    * @return The reaper or nullptr on failure.
+    */
+   static util::unique_ptr<swapchain_reaper> create(layer::device_private_data &device_data,
+                                                    const util::allocator &allocator);
+
+   /**
+    * @brief Destroy the pending swapchains and join the thread.
+    */
+   ~swapchain_reaper();
+
+   /**
+    * @brief Hand a swapchain over to be destroyed on the reaper thread.
+    *
+    * @param swapchain The swapchain, which the application can no longer use. It must have been detached with
+    *                  swapchain_base::detach_for_deferred_teardown.
+    * @param allocator The allocator of the device the swapchain was created with, as swapchains created with
+    *                  allocation callbacks of the application are not destroyed on the reaper.
+    *
+    * @return false if the swapchain could not be queued and has to be destroyed by the caller.
+    */
+   bool defer_destruction(swapchain_base *swapchain, const util::allocator &allocator);
+
+private:
+   /* Allow util::allocator to access the private constructor */
+   friend util::allocator;
+
+   swapchain_reaper(layer::device_private_data &device_data, const util::allocator &allocator);
+
+   /**
+    * @brief A swapchain waiting to be destroyed.
+    */
+   struct pending_destruction
+   {
+      swapchain_base *swapchain;
+      util::allocator allocator;
+   };
+
+   /**
+    * @brief Main loop of the reaper thread.
+    */
+   void reaper_thread();
+
+   layer::device_private_data &m_device_data;
+
+   std::mutex m_lock;
+
+   /**
+    * @brief Signalled when a swapchain is queued or the thread has to terminate.
+    */
+   std::condition_variable m_work_available;
+
+   /**
+    * @brief Swapchains waiting to be destroyed, in the order they were handed over.
+    */
+   util::vector<pending_destruction> m_pending;
+
+   std::thread m_thread;
+
+   /**
+    * @brief Whether the thread has to continue running. It destroys all the pending swapchains before terminating.
+    */
+   bool m_run;
+};
+
+} /* namespace wsi */
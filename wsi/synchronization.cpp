@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2021-2024 Arm Limited.
+ * Copyright (c) 2021-2025 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -31,15 +31,133 @@
 #include "synchronization.hpp"
 #include "layer/private_data.hpp"
 #include "util/helpers.hpp"
+#include "util/small_vector.hpp"
 
 #include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/sync_file.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 namespace wsi
 {
 
-fence_sync::fence_sync(layer::device_private_data &device, VkFence vk_fence)
+sync_object_pool::sync_object_pool(layer::device_private_data &device, const util::allocator &allocator)
+   : m_device{ device }
+   , m_semaphores{ allocator }
+   , m_fences{ util::vector<VkFence>{ allocator }, util::vector<VkFence>{ allocator },
+                util::vector<VkFence>{ allocator } }
+{
+}
+
+sync_object_pool::~sync_object_pool()
+{
+   const VkAllocationCallbacks *callbacks = m_device.get_allocator().get_original_callbacks();
+   for (VkSemaphore semaphore : m_semaphores)
+   {
+      m_device.disp.DestroySemaphore(m_device.device, semaphore, callbacks);
+   }
+
+   for (auto &fences : m_fences)
+   {
+      for (VkFence fence : fences)
+      {
+         m_device.disp.DestroyFence(m_device.device, fence, callbacks);
+      }
+   }
+}
+
+VkResult sync_object_pool::get_semaphore(VkSemaphore &semaphore)
+{
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (!m_semaphores.empty())
+      {
+         semaphore = m_semaphores.back();
+         m_semaphores.pop_back();
+         return VK_SUCCESS;
+      }
+   }
+
+   VkSemaphoreCreateInfo semaphore_info = {};
+   semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+   return m_device.disp.CreateSemaphore(m_device.device, &semaphore_info,
+                                        m_device.get_allocator().get_original_callbacks(), &semaphore);
+}
+
+void sync_object_pool::put_semaphore(VkSemaphore semaphore)
+{
+   if (semaphore == VK_NULL_HANDLE)
+   {
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (m_semaphores.size() < WSI_SYNC_OBJECT_POOL_SIZE && m_semaphores.try_push_back(semaphore))
+      {
+         return;
+      }
+   }
+
+   m_device.disp.DestroySemaphore(m_device.device, semaphore, m_device.get_allocator().get_original_callbacks());
+}
+
+VkResult sync_object_pool::get_fence(fence_type type, VkFence &fence)
+{
+   auto &fences = m_fences[static_cast<size_t>(type)];
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (!fences.empty())
+      {
+         fence = fences.back();
+         fences.pop_back();
+         return VK_SUCCESS;
+      }
+   }
+
+   VkExportFenceCreateInfo export_fence_create_info = {};
+   export_fence_create_info.sType = VK_STRUCTURE_TYPE_EXPORT_FENCE_CREATE_INFO;
+   export_fence_create_info.handleTypes = VK_EXTERNAL_FENCE_HANDLE_TYPE_SYNC_FD_BIT;
+   if (type == fence_type::syncobj)
+   {
+      export_fence_create_info.handleTypes |= VK_EXTERNAL_FENCE_HANDLE_TYPE_OPAQUE_FD_BIT;
+   }
+   VkFenceCreateInfo fence_info = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                                    type != fence_type::plain ? &export_fence_create_info : nullptr, 0 };
+   return m_device.disp.CreateFence(m_device.device, &fence_info, m_device.get_allocator().get_original_callbacks(),
+                                    &fence);
+}
+
+void sync_object_pool::put_fence(fence_type type, VkFence fence)
+{
+   if (fence == VK_NULL_HANDLE)
+   {
+      return;
+   }
+
+   /* Resetting also drops any temporarily imported payload, restoring the fence to its state after creation. */
+   if (m_device.disp.ResetFences(m_device.device, 1, &fence) == VK_SUCCESS)
+   {
+      auto &fences = m_fences[static_cast<size_t>(type)];
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (fences.size() < WSI_SYNC_OBJECT_POOL_SIZE && fences.try_push_back(fence))
+      {
+         return;
+      }
+   }
+
+   m_device.disp.DestroyFence(m_device.device, fence, m_device.get_allocator().get_original_callbacks());
+}
+
+fence_sync::fence_sync(layer::device_private_data &device, VkFence vk_fence, sync_object_pool::fence_type type)
    : fence{ vk_fence }
    , has_payload{ false }
+   , fence_type{ type }
    , dev{ &device }
 {
 }
@@ -47,9 +165,7 @@ fence_sync::fence_sync(layer::device_private_data &device, VkFence vk_fence)
 std::optional<fence_sync> fence_sync::create(layer::device_private_data &device)
 {
    VkFence fence{ VK_NULL_HANDLE };
-   VkFenceCreateInfo fence_info{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, nullptr, 0 };
-   VkResult res =
-      device.disp.CreateFence(device.device, &fence_info, device.get_allocator().get_original_callbacks(), &fence);
+   VkResult res = device.get_sync_object_pool().get_fence(sync_object_pool::fence_type::plain, fence);
    if (res != VK_SUCCESS)
    {
       return std::nullopt;
@@ -67,6 +183,7 @@ fence_sync &fence_sync::operator=(fence_sync &&rhs)
    std::swap(fence, rhs.fence);
    std::swap(has_payload, rhs.has_payload);
    std::swap(payload_finished, rhs.payload_finished);
+   std::swap(fence_type, rhs.fence_type);
    std::swap(dev, rhs.dev);
    return *this;
 }
@@ -75,8 +192,15 @@ fence_sync::~fence_sync()
 {
    if (fence != VK_NULL_HANDLE)
    {
-      wait_payload(UINT64_MAX);
-      dev->disp.DestroyFence(dev->device, fence, dev->get_allocator().get_original_callbacks());
+      if (wait_payload(UINT64_MAX) == VK_SUCCESS)
+      {
+         dev->get_sync_object_pool().put_fence(fence_type, fence);
+      }
+      else
+      {
+         /* The fence may still have a pending signal operation, so it cannot be reset and reused. */
+         dev->disp.DestroyFence(dev->device, fence, dev->get_allocator().get_original_callbacks());
+      }
    }
 }
 
@@ -120,8 +244,9 @@ bool fence_sync::swap_payload(bool new_payload)
    return old_payload;
 }
 
-sync_fd_fence_sync::sync_fd_fence_sync(layer::device_private_data &device, VkFence vk_fence)
-   : fence_sync{ device, vk_fence }
+sync_fd_fence_sync::sync_fd_fence_sync(layer::device_private_data &device, VkFence vk_fence,
+                                       sync_object_pool::fence_type type)
+   : fence_sync{ device, vk_fence, type }
 {
 }
 
@@ -138,13 +263,8 @@ bool sync_fd_fence_sync::is_supported(layer::instance_private_data &instance, Vk
 
 std::optional<sync_fd_fence_sync> sync_fd_fence_sync::create(layer::device_private_data &device)
 {
-   VkExportFenceCreateInfo export_fence_create_info = {};
-   export_fence_create_info.sType = VK_STRUCTURE_TYPE_EXPORT_FENCE_CREATE_INFO;
-   export_fence_create_info.handleTypes = VK_EXTERNAL_FENCE_HANDLE_TYPE_SYNC_FD_BIT;
-   VkFenceCreateInfo fence_info = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, &export_fence_create_info, 0 };
    VkFence fence = VK_NULL_HANDLE;
-   VkResult res =
-      device.disp.CreateFence(device.device, &fence_info, device.get_allocator().get_original_callbacks(), &fence);
+   VkResult res = device.get_sync_object_pool().get_fence(sync_object_pool::fence_type::sync_fd, fence);
    if (res != VK_SUCCESS)
    {
       return std::nullopt;
@@ -154,6 +274,12 @@ std::optional<sync_fd_fence_sync> sync_fd_fence_sync::create(layer::device_priva
 
 std::optional<util::fd_owner> sync_fd_fence_sync::export_sync_fd()
 {
+   if (!is_payload_set() && poll_sync_fd.is_valid())
+   {
+      /* The payload has already been exported for polling. */
+      return std::optional<util::fd_owner>{ std::move(poll_sync_fd) };
+   }
+
    int exported_fd = -1;
    VkFenceGetFdInfoKHR fence_fd_info = {};
    fence_fd_info.sType = VK_STRUCTURE_TYPE_FENCE_GET_FD_INFO_KHR;
@@ -169,6 +295,192 @@ std::optional<util::fd_owner> sync_fd_fence_sync::export_sync_fd()
    return std::nullopt;
 }
 
+bool sync_fd_fence_sync::export_poll_sync_fd()
+{
+   if (is_payload_set())
+   {
+      auto sync_fd = export_sync_fd();
+      if (!sync_fd.has_value())
+      {
+         return false;
+      }
+      poll_sync_fd = std::move(sync_fd.value());
+   }
+   return true;
+}
+
+int sync_fd_fence_sync::get_poll_fd()
+{
+   if (!export_poll_sync_fd())
+   {
+      return -1;
+   }
+
+   return poll_sync_fd.get();
+}
+
+VkResult sync_fd_fence_sync::wait_payload(uint64_t timeout)
+{
+   if (is_payload_set() || !poll_sync_fd.is_valid())
+   {
+      return fence_sync::wait_payload(timeout);
+   }
+
+   /* Exporting the payload has reset the fence, so wait on the Sync FD instead. */
+   return wait_sync_fd(poll_sync_fd.get(), timeout);
+}
+
+VkResult sync_fd_fence_sync::import_payload_to_fence(VkFence vk_fence)
+{
+   int sync_fd = -1;
+   TRY(get_shareable_payload_fd(sync_fd));
+
+   VkResult result = import_fence_sync_fd(get_device(), vk_fence, sync_fd);
+   if (result != VK_SUCCESS)
+   {
+      /* Nothing orders signalling vk_fence after the payload, so complete the payload first. */
+      TRY(wait_payload(UINT64_MAX));
+   }
+   return result;
+}
+
+VkResult sync_fd_fence_sync::get_shareable_payload_fd(int &sync_fd)
+{
+   if (!export_poll_sync_fd())
+   {
+      TRY(wait_payload(UINT64_MAX));
+      sync_fd = -1;
+      return VK_SUCCESS;
+   }
+
+   sync_fd = poll_sync_fd.get();
+   return VK_SUCCESS;
+}
+
+VkResult sync_fd_fence_sync::import_payload(int sync_fd)
+{
+   poll_sync_fd = util::fd_owner{};
+   TRY(import_fence_sync_fd(get_device(), get_fence(), sync_fd));
+   swap_payload(true);
+   return VK_SUCCESS;
+}
+
+bool timeline_semaphore_sync::is_supported(const layer::device_private_data &device)
+{
+   auto get_counter_value = device.disp.get_fn<PFN_vkGetSemaphoreCounterValue>(
+      layer::device_entrypoint::GetSemaphoreCounterValue);
+   auto wait_semaphores = device.disp.get_fn<PFN_vkWaitSemaphores>(layer::device_entrypoint::WaitSemaphores);
+   return device.is_timeline_semaphore_enabled() && get_counter_value.value_or(nullptr) != nullptr &&
+          wait_semaphores.value_or(nullptr) != nullptr;
+}
+
+timeline_semaphore_sync::timeline_semaphore_sync(layer::device_private_data &device, VkSemaphore vk_semaphore)
+   : semaphore{ vk_semaphore }
+   , dev{ &device }
+{
+}
+
+std::optional<timeline_semaphore_sync> timeline_semaphore_sync::create(layer::device_private_data &device)
+{
+   VkSemaphoreTypeCreateInfo type_info = {};
+   type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+   type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+   type_info.initialValue = 0;
+   VkSemaphoreCreateInfo semaphore_info = {};
+   semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+   semaphore_info.pNext = &type_info;
+
+   VkSemaphore semaphore = VK_NULL_HANDLE;
+   VkResult res = device.disp.CreateSemaphore(device.device, &semaphore_info,
+                                              device.get_allocator().get_original_callbacks(), &semaphore);
+   if (res != VK_SUCCESS)
+   {
+      return std::nullopt;
+   }
+   return timeline_semaphore_sync(device, semaphore);
+}
+
+timeline_semaphore_sync::timeline_semaphore_sync(timeline_semaphore_sync &&rhs)
+{
+   *this = std::move(rhs);
+}
+
+timeline_semaphore_sync &timeline_semaphore_sync::operator=(timeline_semaphore_sync &&rhs)
+{
+   std::swap(semaphore, rhs.semaphore);
+   std::swap(last_payload, rhs.last_payload);
+   std::swap(dev, rhs.dev);
+   return *this;
+}
+
+timeline_semaphore_sync::~timeline_semaphore_sync()
+{
+   if (semaphore != VK_NULL_HANDLE)
+   {
+      wait_payload(last_payload, UINT64_MAX);
+      dev->disp.DestroySemaphore(dev->device, semaphore, dev->get_allocator().get_original_callbacks());
+   }
+}
+
+VkResult timeline_semaphore_sync::set_payload(VkQueue queue, const queue_submit_semaphores &semaphores,
+                                              const void *submission_pnext, uint64_t &payload)
+{
+   /* The values of binary semaphores are ignored, only the last entry is used for the timeline semaphore. */
+   const uint32_t signal_count = semaphores.signal_semaphores_count + 1;
+
+   /* Only allocate on the heap for unusually many semaphores. */
+   util::allocator allocator{ dev->get_allocator(), VK_SYSTEM_ALLOCATION_SCOPE_COMMAND };
+   util::small_vector<VkSemaphore, MAX_INLINE_SUBMIT_SEMAPHORES> signal_semaphores_vector{ allocator };
+   util::small_vector<uint64_t, MAX_INLINE_SUBMIT_SEMAPHORES> signal_values_vector{ allocator };
+   if (!signal_semaphores_vector.try_resize(signal_count) || !signal_values_vector.try_resize(signal_count, 0))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   VkSemaphore *signal_semaphores = signal_semaphores_vector.data();
+   uint64_t *signal_values = signal_values_vector.data();
+
+   std::copy(semaphores.signal_semaphores, semaphores.signal_semaphores + semaphores.signal_semaphores_count,
+             signal_semaphores);
+   signal_semaphores[signal_count - 1] = semaphore;
+   signal_values[signal_count - 1] = last_payload + 1;
+
+   VkTimelineSemaphoreSubmitInfo timeline_info = {};
+   timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+   timeline_info.pNext = submission_pnext;
+   timeline_info.signalSemaphoreValueCount = signal_count;
+   timeline_info.pSignalSemaphoreValues = signal_values;
+
+   const queue_submit_semaphores timeline_semaphores = { semaphores.wait_semaphores, semaphores.wait_semaphores_count,
+                                                         signal_semaphores, signal_count };
+   TRY(sync_queue_submit(*dev, queue, VK_NULL_HANDLE, timeline_semaphores, &timeline_info));
+
+   last_payload++;
+   payload = last_payload;
+   return VK_SUCCESS;
+}
+
+VkResult timeline_semaphore_sync::wait_payload(uint64_t payload, uint64_t timeout) const
+{
+   if (payload == 0)
+   {
+      return VK_SUCCESS;
+   }
+
+   uint64_t counter = 0;
+   TRY(dev->disp.GetSemaphoreCounterValue(dev->device, semaphore, &counter));
+   if (counter >= payload)
+   {
+      return VK_SUCCESS;
+   }
+
+   VkSemaphoreWaitInfo wait_info = {};
+   wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+   wait_info.semaphoreCount = 1;
+   wait_info.pSemaphores = &semaphore;
+   wait_info.pValues = &payload;
+   return dev->disp.WaitSemaphores(dev->device, &wait_info, timeout);
+}
+
 VkResult sync_queue_submit(const layer::device_private_data &device, VkQueue queue, VkFence fence,
                            const queue_submit_semaphores &semaphores, const void *submission_pnext)
 {
@@ -176,22 +488,15 @@ VkResult sync_queue_submit(const layer::device_private_data &device, VkQueue que
     * want to block any future Vulkan queue work on it. So, we pass in BOTTOM_OF_PIPE bit as the
     * wait flag.
     */
-   VkPipelineStageFlags pipeline_stage_flag = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-   VkPipelineStageFlags *pipeline_stage_flag_data = &pipeline_stage_flag;
-
-   util::vector<VkPipelineStageFlags> pipeline_stage_flags_vector{ util::allocator(
+   /* Only allocate on the heap for unusually many semaphores. */
+   util::small_vector<VkPipelineStageFlags, MAX_INLINE_SUBMIT_SEMAPHORES> pipeline_stage_flags_vector{ util::allocator(
       device.get_allocator(), VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) };
-   /* Try to avoid memory allocation for single semaphore */
-   if (semaphores.wait_semaphores_count > 1)
+   if (!pipeline_stage_flags_vector.try_resize(semaphores.wait_semaphores_count,
+                                               VkPipelineStageFlags{ VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT }))
    {
-      if (!pipeline_stage_flags_vector.try_resize(semaphores.wait_semaphores_count))
-      {
-         return VK_ERROR_OUT_OF_HOST_MEMORY;
-      }
-      std::fill(pipeline_stage_flags_vector.begin(), pipeline_stage_flags_vector.end(),
-                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
-      pipeline_stage_flag_data = pipeline_stage_flags_vector.data();
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
+   const VkPipelineStageFlags *pipeline_stage_flag_data = pipeline_stage_flags_vector.data();
 
    VkSubmitInfo submit_info = { VK_STRUCTURE_TYPE_SUBMIT_INFO,
                                 submission_pnext,
@@ -207,4 +512,143 @@ VkResult sync_queue_submit(const layer::device_private_data &device, VkQueue que
    return VK_SUCCESS;
 }
 
+VkResult wait_sync_fd(int sync_fd, uint64_t timeout)
+{
+   if (sync_fd < 0)
+   {
+      return VK_SUCCESS;
+   }
+
+   int timeout_ms = -1;
+   if (timeout != UINT64_MAX)
+   {
+      const uint64_t rounded_up_ms = timeout / 1000000 + (timeout % 1000000 != 0 ? 1 : 0);
+      timeout_ms = static_cast<int>(std::min<uint64_t>(rounded_up_ms, INT_MAX));
+   }
+
+   struct pollfd pfd = {};
+   pfd.fd = sync_fd;
+   pfd.events = POLLIN;
+   int res;
+   do
+   {
+      res = poll(&pfd, 1, timeout_ms);
+   } while (res < 0 && errno == EINTR);
+
+   if (res == 0)
+   {
+      return VK_TIMEOUT;
+   }
+   else if (res < 0 || (pfd.revents & (POLLERR | POLLNVAL)) != 0)
+   {
+      return VK_ERROR_DEVICE_LOST;
+   }
+   return VK_SUCCESS;
+}
+
+/**
+ * @brief Duplicate a Sync FD for an import that takes ownership of it on success.
+ *
+ * @return The duplicate, -1 for the already signalled sentinel, or -2 if the duplication failed.
+ */
+static int dup_sync_fd_for_import(int sync_fd)
+{
+   if (sync_fd < 0)
+   {
+      return -1;
+   }
+   int import_fd = fcntl(sync_fd, F_DUPFD_CLOEXEC, 0);
+   return import_fd >= 0 ? import_fd : -2;
+}
+
+VkResult import_fence_sync_fd(layer::device_private_data &device, VkFence fence, int sync_fd)
+{
+   const int import_fd = dup_sync_fd_for_import(sync_fd);
+   if (import_fd == -2)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   VkImportFenceFdInfoKHR info = {};
+   info.sType = VK_STRUCTURE_TYPE_IMPORT_FENCE_FD_INFO_KHR;
+   info.fence = fence;
+   info.handleType = VK_EXTERNAL_FENCE_HANDLE_TYPE_SYNC_FD_BIT;
+   info.flags = VK_FENCE_IMPORT_TEMPORARY_BIT;
+   info.fd = import_fd;
+
+   VkResult result = device.disp.ImportFenceFdKHR(device.device, &info);
+   if (result != VK_SUCCESS && import_fd >= 0)
+   {
+      close(import_fd);
+   }
+   return result;
+}
+
+VkResult import_semaphore_sync_fd(layer::device_private_data &device, VkSemaphore semaphore, int sync_fd)
+{
+   const int import_fd = dup_sync_fd_for_import(sync_fd);
+   if (import_fd == -2)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   VkImportSemaphoreFdInfoKHR info = {};
+   info.sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR;
+   info.semaphore = semaphore;
+   info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
+   info.flags = VK_SEMAPHORE_IMPORT_TEMPORARY_BIT;
+   info.fd = import_fd;
+
+   VkResult result = device.disp.ImportSemaphoreFdKHR(device.device, &info);
+   if (result != VK_SUCCESS && import_fd >= 0)
+   {
+      close(import_fd);
+   }
+   return result;
+}
+
+VkResult export_semaphore_sync_fd(layer::device_private_data &device, VkSemaphore semaphore,
+                                  util::fd_owner &sync_fd)
+{
+   VkSemaphoreGetFdInfoKHR info = {};
+   info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR;
+   info.semaphore = semaphore;
+   info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
+
+   int exported_fd = -1;
+   TRY(device.disp.GetSemaphoreFdKHR(device.device, &info, &exported_fd));
+   /* Drivers return -1 for a payload that has already signalled. */
+   sync_fd = util::fd_owner{ exported_fd };
+   return VK_SUCCESS;
+}
+
+VkResult merge_sync_fds(util::fd_owner &sync_fd, util::fd_owner other)
+{
+   if (!other.is_valid())
+   {
+      return VK_SUCCESS;
+   }
+   if (!sync_fd.is_valid())
+   {
+      sync_fd = std::move(other);
+      return VK_SUCCESS;
+   }
+
+   struct sync_merge_data merge_data = {};
+   std::strncpy(merge_data.name, "wsi-present", sizeof(merge_data.name) - 1);
+   merge_data.fd2 = other.get();
+   int res;
+   do
+   {
+      res = ioctl(sync_fd.get(), SYNC_IOC_MERGE, &merge_data);
+   } while (res < 0 && (errno == EINTR || errno == EAGAIN));
+
+   if (res < 0)
+   {
+      return wait_sync_fd(other.get(), UINT64_MAX);
+   }
+   sync_fd = util::fd_owner{ merge_data.fence };
+   return VK_SUCCESS;
+}
+
 } /* namespace wsi */
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2021-2024 Arm Limited.
+ * Copyright (c) 2021-2025 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -30,12 +30,20 @@
 
 #pragma once
 
+#include <array>
+#include <mutex>
 #include <optional>
 
+#include "util/custom_allocator.hpp"
 #include "util/file_descriptor.hpp"
+#include "util/helpers.hpp"
 
 #include <vulkan/vulkan.h>
 
+#ifndef WSI_SYNC_OBJECT_POOL_SIZE
+#define WSI_SYNC_OBJECT_POOL_SIZE 64
+#endif
+
 namespace layer
 {
 class device_private_data;
@@ -45,6 +53,11 @@ class instance_private_data;
 namespace wsi
 {
 
+/**
+ * @brief Number of semaphores a queue submission made by the layer can wait on or signal without allocating.
+ */
+static constexpr uint32_t MAX_INLINE_SUBMIT_SEMAPHORES = 8;
+
 struct queue_submit_semaphores
 {
    const VkSemaphore *wait_semaphores;
@@ -53,6 +66,83 @@ struct queue_submit_semaphores
    uint32_t signal_semaphores_count;
 };
 
+/**
+ * @brief Pool of unsignalled Vulkan semaphores and fences shared by the swapchains of a device.
+ *
+ * Swapchains are frequently recreated, e.g. on every window resize, and each of them needs a few semaphores and fences
+ * per image. Objects released by a destroyed swapchain stay in the pool until a new swapchain takes them, instead of
+ * being destroyed and created again. Objects in excess of @ref WSI_SYNC_OBJECT_POOL_SIZE of each kind are destroyed.
+ * All the objects are created with the allocation callbacks of the device.
+ */
+class sync_object_pool : private util::noncopyable
+{
+public:
+   enum class fence_type
+   {
+      /* A fence without external handle types. */
+      plain,
+      /* A fence exportable to a Sync FD. */
+      sync_fd,
+      /* A fence exportable to a Sync FD and to an opaque FD, which DRM drivers back with a syncobj. */
+      syncobj,
+      count,
+   };
+
+   /**
+    * @brief Construct an empty pool.
+    *
+    * @param device    The device private data the objects belong to.
+    * @param allocator The allocator used for the storage of the pool.
+    */
+   sync_object_pool(layer::device_private_data &device, const util::allocator &allocator);
+
+   /**
+    * @brief Destroys all the objects in the pool.
+    */
+   ~sync_object_pool();
+
+   /**
+    * @brief Get an unsignalled binary semaphore, creating one if the pool is empty.
+    *
+    * @param[out] semaphore The semaphore.
+    *
+    * @return VK_SUCCESS on success or an error code if a semaphore could not be created.
+    */
+   VkResult get_semaphore(VkSemaphore &semaphore);
+
+   /**
+    * @brief Return a semaphore to the pool.
+    *
+    * @param semaphore The semaphore, or VK_NULL_HANDLE. It must be unsignalled and not have any pending operations.
+    */
+   void put_semaphore(VkSemaphore semaphore);
+
+   /**
+    * @brief Get an unsignalled fence, creating one if the pool is empty.
+    *
+    * @param type       The kind of fence.
+    * @param[out] fence The fence.
+    *
+    * @return VK_SUCCESS on success or an error code if a fence could not be created.
+    */
+   VkResult get_fence(fence_type type, VkFence &fence);
+
+   /**
+    * @brief Reset a fence and return it to the pool.
+    *
+    * @param type  The kind of fence, as given to @ref get_fence.
+    * @param fence The fence, or VK_NULL_HANDLE. It must not have any pending queue operations.
+    */
+   void put_fence(fence_type type, VkFence fence);
+
+private:
+   layer::device_private_data &m_device;
+
+   std::mutex m_lock;
+   util::vector<VkSemaphore> m_semaphores;
+   std::array<util::vector<VkFence>, static_cast<size_t>(fence_type::count)> m_fences;
+};
+
 /**
  * Synchronization using a Vulkan Fence object.
  */
@@ -108,9 +198,11 @@ protected:
     * Non-public constructor to initialize the object with valid data.
     *
     * @param device   The device private data for the fence.
-    * @param vk_fence The created Vulkan fence.
+    * @param vk_fence The Vulkan fence, taken from the sync object pool of the device.
+    * @param type     The kind of fence, used to return it to the pool.
     */
-   fence_sync(layer::device_private_data &device, VkFence vk_fence);
+   fence_sync(layer::device_private_data &device, VkFence vk_fence,
+              sync_object_pool::fence_type type = sync_object_pool::fence_type::plain);
 
    VkFence get_fence()
    {
@@ -126,6 +218,14 @@ protected:
     */
    bool swap_payload(bool new_payload);
 
+   /**
+    * Returns whether a payload is currently set on the fence.
+    */
+   bool is_payload_set() const
+   {
+      return has_payload;
+   }
+
    layer::device_private_data &get_device()
    {
       return *dev;
@@ -135,6 +235,7 @@ private:
    VkFence fence{ VK_NULL_HANDLE };
    bool has_payload{ false };
    bool payload_finished{ false };
+   sync_object_pool::fence_type fence_type{ sync_object_pool::fence_type::plain };
    layer::device_private_data *dev{ nullptr };
 };
 
@@ -174,14 +275,172 @@ public:
     */
    std::optional<util::fd_owner> export_sync_fd();
 
-private:
+   /**
+    * Gets a Sync FD that can be polled for the completion of the current payload.
+    *
+    * The payload is exported to a Sync FD that is kept by this object. A following call to @ref export_sync_fd
+    * returns the same Sync FD, unless a new payload has been set in the meantime.
+    *
+    * @note This method is not threadsafe.
+    *
+    * @return A file descriptor owned by this object, or -1 if there is no payload to poll, the payload has already
+    *         completed or the export failed.
+    */
+   int get_poll_fd();
+
+   /**
+    * Waits for the current payload, also after it has been exported for polling with @ref get_poll_fd.
+    *
+    * @param timeout Timeout for waiting in nanoseconds.
+    *
+    * @return VK_SUCCESS on success or if no payload or a completed payload is set.
+    *         Other error code on failure or timeout.
+    */
+   VkResult wait_payload(uint64_t timeout);
+
+   /**
+    * Imports the current payload into another fence, so that it signals when the payload completes.
+    *
+    * The payload is exported the same way as for @ref get_poll_fd, which saves a queue submission to signal
+    * @p vk_fence.
+    *
+    * @note This method is not threadsafe.
+    *
+    * @param vk_fence The fence to signal. It must support temporarily importing Sync FDs.
+    *
+    * @return VK_SUCCESS on success or an error code otherwise. On failure the payload has completed, unless waiting for
+    *         it failed as well, so that @p vk_fence can be signalled without being ordered after the payload.
+    */
+   VkResult import_payload_to_fence(VkFence vk_fence);
+
+   /**
+    * Gets a Sync FD of the current payload that other fences can import.
+    *
+    * The payload is exported the same way as for @ref get_poll_fd. If that fails, the payload is waited for instead.
+    *
+    * @note This method is not threadsafe.
+    *
+    * @param[out] sync_fd A file descriptor owned by this object, or -1 if the payload has completed.
+    *
+    * @return VK_SUCCESS on success, or an error code if the payload could neither be exported nor waited for.
+    */
+   VkResult get_shareable_payload_fd(int &sync_fd);
+
+   /**
+    * Sets the payload by temporarily importing a Sync FD into the fence, instead of a queue submission.
+    *
+    * @note This method is not threadsafe.
+    *
+    * @param sync_fd The Sync FD to import, or -1 for a completed payload. A duplicate is imported, the caller keeps
+    *                ownership of @p sync_fd.
+    *
+    * @return VK_SUCCESS on success or an error code otherwise.
+    */
+   VkResult import_payload(int sync_fd);
+
+protected:
    /**
     * Non-public constructor to initialize the object with valid data.
     *
     * @param device   The device private data for the fence.
-    * @param vk_fence The created exportable Vulkan fence.
+    * @param vk_fence The exportable Vulkan fence, taken from the sync object pool of the device.
+    * @param type     The kind of fence, used to return it to the pool.
+    */
+   sync_fd_fence_sync(layer::device_private_data &device, VkFence vk_fence,
+                      sync_object_pool::fence_type type = sync_object_pool::fence_type::sync_fd);
+
+private:
+   /**
+    * Sync FD that the last payload was exported to by @ref get_poll_fd.
     */
-   sync_fd_fence_sync(layer::device_private_data &device, VkFence vk_fence);
+   util::fd_owner poll_sync_fd;
+
+   /**
+    * Exports a set payload to @ref poll_sync_fd.
+    *
+    * @return true on success or if there is no payload to export, false if the export failed.
+    */
+   bool export_poll_sync_fd();
+};
+
+/**
+ * Synchronization using a timeline semaphore shared by all the images of a swapchain.
+ *
+ * Every payload signals the next value of the timeline, which identifies the payload. Whether a payload has completed
+ * is then a comparison with the counter of the semaphore, and no per image objects need to be reset between payloads.
+ */
+class timeline_semaphore_sync
+{
+public:
+   /**
+    * Checks if the timeline semaphores of a device can be used for synchronization.
+    *
+    * @param device The device private data to check.
+    *
+    * @return true if the timeline semaphore feature is enabled and its entrypoints are available, false otherwise.
+    */
+   static bool is_supported(const layer::device_private_data &device);
+
+   /**
+    * Creates a new timeline semaphore synchronization object.
+    *
+    * @param device The device private data for which to create it.
+    *
+    * @return Empty optional on failure or initialized object.
+    */
+   static std::optional<timeline_semaphore_sync> create(layer::device_private_data &device);
+
+   timeline_semaphore_sync(const timeline_semaphore_sync &) = delete;
+   timeline_semaphore_sync &operator=(const timeline_semaphore_sync &) = delete;
+
+   timeline_semaphore_sync(timeline_semaphore_sync &&rhs);
+   timeline_semaphore_sync &operator=(timeline_semaphore_sync &&rhs);
+
+   ~timeline_semaphore_sync();
+
+   /**
+    * Sets a payload that signals the next value of the timeline.
+    *
+    * @note This method is not threadsafe.
+    *
+    * @param      queue            The Vulkan queue that may be used to submit synchronization commands.
+    * @param      semaphores       The wait and signal semaphores.
+    * @param      submission_pnext Chain of pointers to attach to the payload submission.
+    * @param[out] payload          The value identifying the payload, to be given to @ref wait_payload.
+    *
+    * @return VK_SUCCESS on success or other error code on failing to set the payload.
+    */
+   VkResult set_payload(VkQueue queue, const queue_submit_semaphores &semaphores, const void *submission_pnext,
+                        uint64_t &payload);
+
+   /**
+    * Waits for a payload to complete execution.
+    *
+    * @note This method can be called concurrently with @ref set_payload.
+    *
+    * @param payload The value identifying the payload, or 0 for no payload.
+    * @param timeout Timeout for waiting in nanoseconds.
+    *
+    * @return VK_SUCCESS on success or if the payload has completed. Other error code on failure or timeout.
+    */
+   VkResult wait_payload(uint64_t payload, uint64_t timeout) const;
+
+private:
+   /**
+    * Non-public constructor to initialize the object with valid data.
+    *
+    * @param device    The device private data for the semaphore.
+    * @param semaphore The created timeline semaphore.
+    */
+   timeline_semaphore_sync(layer::device_private_data &device, VkSemaphore semaphore);
+
+   VkSemaphore semaphore{ VK_NULL_HANDLE };
+
+   /**
+    * The value signalled by the last payload.
+    */
+   uint64_t last_payload{ 0 };
+   layer::device_private_data *dev{ nullptr };
 };
 
 /**
@@ -198,4 +457,64 @@ private:
  */
 VkResult sync_queue_submit(const layer::device_private_data &device, VkQueue queue, VkFence fence,
                            const queue_submit_semaphores &semaphores, const void *submission_pnext = nullptr);
+
+/**
+ * @brief Wait on the host for a Sync FD to signal.
+ *
+ * @param sync_fd The Sync FD to wait for, or -1 if it has already signalled.
+ * @param timeout Timeout for waiting in nanoseconds.
+ *
+ * @return VK_SUCCESS once signalled, VK_TIMEOUT on timeout or VK_ERROR_DEVICE_LOST if waiting failed.
+ */
+VkResult wait_sync_fd(int sync_fd, uint64_t timeout);
+
+/**
+ * @brief Temporarily import a Sync FD into a fence.
+ *
+ * @param device  The device private data for the fence.
+ * @param fence   The fence to import the Sync FD into.
+ * @param sync_fd The Sync FD to import, or -1 for a payload that has already signalled. It is duplicated for the
+ *                import, so the caller keeps ownership.
+ *
+ * @return VK_SUCCESS on success or the error code returned by the import.
+ */
+VkResult import_fence_sync_fd(layer::device_private_data &device, VkFence fence, int sync_fd);
+
+/**
+ * @brief Temporarily import a Sync FD into a binary semaphore.
+ *
+ * @param device    The device private data for the semaphore.
+ * @param semaphore The semaphore to import the Sync FD into.
+ * @param sync_fd   The Sync FD to import, or -1 for a payload that has already signalled. It is duplicated for the
+ *                  import, so the caller keeps ownership.
+ *
+ * @return VK_SUCCESS on success or the error code returned by the import.
+ */
+VkResult import_semaphore_sync_fd(layer::device_private_data &device, VkSemaphore semaphore, int sync_fd);
+
+/**
+ * @brief Export the pending payload of a binary semaphore to a Sync FD.
+ *
+ * The export waits on the semaphore, which is unsignalled again afterwards, as a queue submission waiting on it would.
+ *
+ * @param device       The device private data for the semaphore.
+ * @param semaphore    The semaphore, created exportable to Sync FDs and with a signal operation pending.
+ * @param[out] sync_fd The exported Sync FD, left invalid if the payload has already signalled.
+ *
+ * @return VK_SUCCESS on success or the error code returned by the export.
+ */
+VkResult export_semaphore_sync_fd(layer::device_private_data &device, VkSemaphore semaphore,
+                                  util::fd_owner &sync_fd);
+
+/**
+ * @brief Merge a Sync FD into another one, which then signals once both have signalled.
+ *
+ * If the kernel fails to merge them, @p other is waited for on the host instead.
+ *
+ * @param[in,out] sync_fd The Sync FD to merge into, invalid if it has already signalled.
+ * @param other           The Sync FD to merge, invalid if it has already signalled.
+ *
+ * @return VK_SUCCESS on success or an error code if @p other could neither be merged nor waited for.
+ */
+VkResult merge_sync_fds(util::fd_owner &sync_fd, util::fd_owner other);
 } /* namespace wsi */
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file
+ *
+ * @brief Contains the implementation of the fence synchronization primitive backed by a DRM syncobj.
+ */
+
+#include "syncobj_fence_sync.hpp"
+#include "layer/private_data.hpp"
+#include "util/file_descriptor.hpp"
+#include "util/helpers.hpp"
+#include "util/log.hpp"
+
+#include <utility>
+#include <xf86drm.h>
+
+namespace wsi
+{
+
+syncobj_fence_sync::syncobj_fence_sync(layer::device_private_data &device, VkFence vk_fence,
+                                       sync_object_pool::fence_type type)
+   : sync_fd_fence_sync{ device, vk_fence, type }
+{
+}
+
+bool syncobj_fence_sync::is_supported(layer::instance_private_data &instance, VkPhysicalDevice phys_dev)
+{
+   VkPhysicalDeviceExternalFenceInfoKHR external_fence_info = {};
+   external_fence_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_FENCE_INFO;
+   external_fence_info.handleType = VK_EXTERNAL_FENCE_HANDLE_TYPE_OPAQUE_FD_BIT;
+   VkExternalFencePropertiesKHR fence_properties = {};
+   fence_properties.sType = VK_STRUCTURE_TYPE_EXTERNAL_FENCE_PROPERTIES;
+   instance.disp.GetPhysicalDeviceExternalFencePropertiesKHR(phys_dev, &external_fence_info, &fence_properties);
+   return (fence_properties.externalFenceFeatures & VK_EXTERNAL_FENCE_FEATURE_EXPORTABLE_BIT_KHR) &&
+          (fence_properties.compatibleHandleTypes & VK_EXTERNAL_FENCE_HANDLE_TYPE_SYNC_FD_BIT);
+}
+
+std::optional<syncobj_fence_sync> syncobj_fence_sync::create(layer::device_private_data &device, int drm_fd)
+{
+   auto type = sync_object_pool::fence_type::sync_fd;
+   if (drm_fd >= 0 && is_supported(device.instance_data, device.physical_device))
+   {
+      type = sync_object_pool::fence_type::syncobj;
+   }
+
+   VkFence fence = VK_NULL_HANDLE;
+   VkResult res = device.get_sync_object_pool().get_fence(type, fence);
+   if (res != VK_SUCCESS)
+   {
+      return std::nullopt;
+   }
+
+   syncobj_fence_sync sync{ device, fence, type };
+   if (type == sync_object_pool::fence_type::syncobj)
+   {
+      sync.drm_fd = drm_fd;
+      if (!sync.import_syncobj())
+      {
+         WSI_LOG_WARNING("Fence is not backed by a DRM syncobj, its payloads are exported to Sync FDs instead.");
+         sync.drm_fd = -1;
+      }
+   }
+   return std::optional<syncobj_fence_sync>{ std::move(sync) };
+}
+
+syncobj_fence_sync::syncobj_fence_sync(syncobj_fence_sync &&rhs)
+   : sync_fd_fence_sync{ std::move(rhs) }
+{
+   std::swap(drm_fd, rhs.drm_fd);
+   std::swap(syncobj, rhs.syncobj);
+   std::swap(payload_imported, rhs.payload_imported);
+}
+
+syncobj_fence_sync &syncobj_fence_sync::operator=(syncobj_fence_sync &&rhs)
+{
+   sync_fd_fence_sync::operator=(std::move(rhs));
+   std::swap(drm_fd, rhs.drm_fd);
+   std::swap(syncobj, rhs.syncobj);
+   std::swap(payload_imported, rhs.payload_imported);
+   return *this;
+}
+
+syncobj_fence_sync::~syncobj_fence_sync()
+{
+   /* Only the handle is released, the payload object stays owned by the fence. */
+   if (syncobj != 0)
+   {
+      drmSyncobjDestroy(drm_fd, syncobj);
+   }
+}
+
+bool syncobj_fence_sync::import_syncobj()
+{
+   int opaque_fd = -1;
+   VkFenceGetFdInfoKHR fence_fd_info = {};
+   fence_fd_info.sType = VK_STRUCTURE_TYPE_FENCE_GET_FD_INFO_KHR;
+   fence_fd_info.fence = get_fence();
+   fence_fd_info.handleType = VK_EXTERNAL_FENCE_HANDLE_TYPE_OPAQUE_FD_BIT;
+   if (get_device().disp.GetFenceFdKHR(get_device().device, &fence_fd_info, &opaque_fd) != VK_SUCCESS)
+   {
+      return false;
+   }
+
+   /* Opaque FDs have reference transference, so the handle refers to the payload of every following submission. */
+   util::fd_owner fd{ opaque_fd };
+   return drmSyncobjFDToHandle(drm_fd, fd.get(), &syncobj) == 0;
+}
+
+VkResult syncobj_fence_sync::set_payload(VkQueue queue, const queue_submit_semaphores &semaphores,
+                                         const void *submission_pnext)
+{
+   TRY(fence_sync::set_payload(queue, semaphores, submission_pnext));
+   payload_imported = false;
+   return VK_SUCCESS;
+}
+
+VkResult syncobj_fence_sync::import_payload(int sync_fd)
+{
+   payload_imported = true;
+   return sync_fd_fence_sync::import_payload(sync_fd);
+}
+
+bool syncobj_fence_sync::transfer_payload(uint32_t timeline, uint64_t point)
+{
+   if (syncobj == 0 || payload_imported || !is_payload_set())
+   {
+      return false;
+   }
+
+   /* The driver may still be submitting the payload to the kernel from another thread. */
+   return drmSyncobjTransfer(drm_fd, timeline, point, syncobj, 0, DRM_SYNCOBJ_WAIT_FLAGS_WAIT_FOR_SUBMIT) == 0;
+}
+
+} /* namespace wsi */
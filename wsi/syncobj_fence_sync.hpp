@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file
+ *
+ * @brief Contains the definition of a fence synchronization primitive backed by a DRM syncobj.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "wsi/synchronization.hpp"
+
+namespace wsi
+{
+
+/**
+ * Synchronization using a Vulkan fence whose payload lives in a DRM syncobj.
+ *
+ * DRM drivers implement fences exported to an opaque FD as syncobjs. The fence is exported once when it is created,
+ * after which every payload set by a queue submission can be moved into a point of a DRM timeline syncobj with a
+ * single ioctl, without exporting it to a new Sync FD for each frame. When the opaque FD is not a syncobj, or the
+ * driver cannot export one, the object behaves as a @ref sync_fd_fence_sync.
+ */
+class syncobj_fence_sync : public sync_fd_fence_sync
+{
+public:
+   syncobj_fence_sync() = default;
+
+   /**
+    * Checks if a Vulkan device can export fences to both a Sync FD and an opaque FD.
+    *
+    * @param instance The instance private data for the physical device.
+    * @param phys_dev The physical device to check support for.
+    *
+    * @return true if supported, false otherwise.
+    */
+   static bool is_supported(layer::instance_private_data &instance, VkPhysicalDevice phys_dev);
+
+   /**
+    * Creates a new fence compatible with Sync FD, backed by a syncobj when possible.
+    *
+    * @param device The device private data for which to create the fence.
+    * @param drm_fd The DRM device the timelines given to @ref transfer_payload belong to, or -1 to only use Sync FDs.
+    *               It must stay open until the object is destroyed.
+    *
+    * @return Empty optional on failure or initialized fence.
+    */
+   static std::optional<syncobj_fence_sync> create(layer::device_private_data &device, int drm_fd);
+
+   syncobj_fence_sync(syncobj_fence_sync &&rhs);
+   syncobj_fence_sync &operator=(syncobj_fence_sync &&rhs);
+
+   ~syncobj_fence_sync() override;
+
+   /**
+    * Sets the payload for the fence, see @ref fence_sync::set_payload.
+    */
+   VkResult set_payload(VkQueue queue, const queue_submit_semaphores &semaphores,
+                        const void *submission_pnext = nullptr);
+
+   /**
+    * Sets the payload by temporarily importing a Sync FD, see @ref sync_fd_fence_sync::import_payload.
+    *
+    * A temporarily imported payload is not held by the syncobj, so it cannot be transferred.
+    */
+   VkResult import_payload(int sync_fd);
+
+   /**
+    * Moves the current payload into a point of a DRM timeline syncobj.
+    *
+    * The payload stays set on the fence, so it can still be waited for or exported afterwards.
+    *
+    * @note This method is not threadsafe.
+    *
+    * @param timeline Handle of the timeline syncobj, on the DRM device given to @ref create.
+    * @param point    The point of the timeline to signal when the payload completes.
+    *
+    * @return true on success, false if the fence is not backed by a syncobj, its payload has been exported or
+    *         imported, or the transfer failed. The caller must then export the payload to a Sync FD instead.
+    */
+   bool transfer_payload(uint32_t timeline, uint64_t point);
+
+private:
+   /**
+    * Non-public constructor to initialize the object with valid data.
+    *
+    * @param device   The device private data for the fence.
+    * @param vk_fence The exportable Vulkan fence, taken from the sync object pool of the device.
+    * @param type     The kind of fence, used to return it to the pool.
+    */
+   syncobj_fence_sync(layer::device_private_data &device, VkFence vk_fence, sync_object_pool::fence_type type);
+
+   /**
+    * Exports the fence to an opaque FD and imports it as a syncobj on @ref drm_fd.
+    *
+    * @return true on success, false if the opaque FD is not a syncobj or the export failed.
+    */
+   bool import_syncobj();
+
+   int drm_fd{ -1 };
+   /**
+    * Handle of the syncobj holding the permanent payload of the fence, or 0 when not backed by a syncobj.
+    */
+   uint32_t syncobj{ 0 };
+   bool payload_imported{ false };
+};
+
+} /* namespace wsi */
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Implementation of the per wl_display cache of the compositor globals and dmabuf formats.
+ */
+
+#include "display_cache.hpp"
+
+#include <cassert>
+#include <cstring>
+
+#include "wl_helpers.hpp"
+#include "util/log.hpp"
+
+namespace wsi
+{
+namespace wayland
+{
+
+namespace
+{
+/** Protects the list of caches and their reference counts. */
+std::mutex display_cache_list_lock;
+/** Caches of all the displays the layer has surfaces on. */
+display_cache *display_cache_list = nullptr;
+} // namespace
+
+VWL_CAPI_CALL(void)
+display_cache_global_handler(void *data, struct wl_registry *wl_registry, uint32_t name, const char *interface,
+                             uint32_t version) VWL_API_POST
+{
+   UNUSED(wl_registry);
+   auto cache = reinterpret_cast<display_cache *>(data);
+
+   if (strlen(interface) >= WAYLAND_MAX_CACHED_INTERFACE_NAME)
+   {
+      return;
+   }
+
+   display_cache::global global = {};
+   global.name = name;
+   strcpy(global.interface, interface);
+   global.version = version;
+   if (!cache->m_globals.try_push_back(global))
+   {
+      WSI_LOG_ERROR("Host got out of memory, the global %s is not cached.", interface);
+   }
+
+   cache->invalidate_locked();
+}
+
+VWL_CAPI_CALL(void)
+display_cache_global_remove_handler(void *data, struct wl_registry *wl_registry, uint32_t name) VWL_API_POST
+{
+   UNUSED(wl_registry);
+   auto cache = reinterpret_cast<display_cache *>(data);
+
+   for (auto it = cache->m_globals.begin(); it != cache->m_globals.end(); ++it)
+   {
+      if (it->name == name)
+      {
+         cache->m_globals.erase(it);
+         break;
+      }
+   }
+
+   cache->invalidate_locked();
+}
+
+display_cache::display_cache(wl_display *display, const util::allocator &allocator)
+   : m_display(display)
+   , m_queue(nullptr)
+   , m_registry(nullptr)
+   , m_globals(allocator)
+   , m_formats(allocator)
+   , m_has_formats(false)
+   , m_presentation_clock(CLOCK_MONOTONIC)
+   , m_has_presentation_clock(false)
+   , m_ref_count(0)
+   , m_next(nullptr)
+{
+}
+
+display_cache *display_cache::acquire(wl_display *display)
+{
+   std::lock_guard<std::mutex> lock(display_cache_list_lock);
+   for (display_cache *cache = display_cache_list; cache != nullptr; cache = cache->m_next)
+   {
+      if (cache->m_display == display)
+      {
+         cache->m_ref_count++;
+         return cache;
+      }
+   }
+
+   const util::allocator &allocator = util::allocator::get_generic();
+   display_cache *cache = allocator.create<display_cache>(1, display, allocator);
+   if (cache == nullptr)
+   {
+      return nullptr;
+   }
+
+   if (!cache->init())
+   {
+      allocator.destroy(1, cache);
+      return nullptr;
+   }
+
+   cache->m_ref_count = 1;
+   cache->m_next = display_cache_list;
+   display_cache_list = cache;
+   return cache;
+}
+
+void display_cache::release(display_cache *cache)
+{
+   if (cache == nullptr)
+   {
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(display_cache_list_lock);
+      assert(cache->m_ref_count > 0);
+      if (--cache->m_ref_count > 0)
+      {
+         return;
+      }
+
+      display_cache **link = &display_cache_list;
+      while (*link != cache)
+      {
+         link = &(*link)->m_next;
+      }
+      *link = cache->m_next;
+   }
+
+   util::allocator::get_generic().destroy(1, cache);
+}
+
+bool display_cache::init()
+{
+   m_queue.reset(wl_display_create_queue(m_display));
+   if (m_queue == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to create the display cache queue.");
+      return false;
+   }
+
+   auto display_proxy = make_proxy_with_queue(m_display, m_queue.get());
+   if (display_proxy == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to create wl display proxy.");
+      return false;
+   }
+
+   m_registry.reset(wl_display_get_registry(display_proxy.get()));
+   if (m_registry == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to get wl display registry.");
+      return false;
+   }
+
+   static const wl_registry_listener registry_listener = { display_cache_global_handler,
+                                                           display_cache_global_remove_handler };
+   int res = wl_registry_add_listener(m_registry.get(), &registry_listener, this);
+   if (res < 0)
+   {
+      WSI_LOG_ERROR("Failed to add registry listener.");
+      return false;
+   }
+
+   /* The cache is not shared yet, so the handlers can run without the lock. */
+   res = wl_display_roundtrip_queue(m_display, m_queue.get());
+   if (res < 0)
+   {
+      WSI_LOG_ERROR("Roundtrip failed.");
+      return false;
+   }
+
+   return true;
+}
+
+void display_cache::update_locked()
+{
+   /* Only picks up the events already sent by the compositor, without waiting for more. */
+   if (dispatch_queue(m_display, m_queue.get(), 0) < 0)
+   {
+      WSI_LOG_WARNING("Failed to update the display cache.");
+   }
+}
+
+void display_cache::invalidate_locked()
+{
+   m_formats.clear();
+   m_has_formats = false;
+   m_has_presentation_clock = false;
+}
+
+bool display_cache::bind_globals(wl_event_queue *queue, global_handler handler, void *data)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   update_locked();
+
+   auto registry_proxy = make_proxy_with_queue(m_registry.get(), queue);
+   if (registry_proxy == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to create wl registry proxy.");
+      return false;
+   }
+
+   for (const auto &global : m_globals)
+   {
+      handler(data, registry_proxy.get(), global.name, global.interface, global.version);
+   }
+
+   return true;
+}
+
+VkResult display_cache::get_formats(util::vector<drm_format_pair> &formats)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   update_locked();
+
+   if (!m_has_formats)
+   {
+      return VK_NOT_READY;
+   }
+
+   if (!formats.try_push_back_many(m_formats.data(), m_formats.data() + m_formats.size()))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   return VK_SUCCESS;
+}
+
+void display_cache::store_formats(const util::vector<drm_format_pair> &formats)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   m_formats.clear();
+   m_has_formats = m_formats.try_push_back_many(formats.data(), formats.data() + formats.size());
+}
+
+bool display_cache::get_presentation_clock(clockid_t &clock_id)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   if (m_has_presentation_clock)
+   {
+      clock_id = m_presentation_clock;
+   }
+   return m_has_presentation_clock;
+}
+
+void display_cache::store_presentation_clock(clockid_t clock_id)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   m_presentation_clock = clock_id;
+   m_has_presentation_clock = true;
+}
+
+} // namespace wayland
+} // namespace wsi
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Per wl_display cache of the compositor globals and dmabuf formats.
+ */
+
+#pragma once
+
+#ifndef __STDC_VERSION__
+#define __STDC_VERSION__ 0
+#endif
+#include <wayland-client.h>
+#include <time.h>
+
+#include <mutex>
+
+#include "wsi/surface.hpp"
+#include "wl_object_owner.hpp"
+#include "util/custom_allocator.hpp"
+#include "util/macros.hpp"
+
+namespace wsi
+{
+namespace wayland
+{
+
+/** Size of the interface names the cache can store. Globals with longer names are not cached. */
+#define WAYLAND_MAX_CACHED_INTERFACE_NAME 64
+
+/**
+ * Wayland callback for the global wl_registry events of the registry owned by @ref wsi::wayland::display_cache
+ */
+VWL_CAPI_CALL(void)
+display_cache_global_handler(void *data, struct wl_registry *wl_registry, uint32_t name, const char *interface,
+                             uint32_t version) VWL_API_POST;
+
+/**
+ * Wayland callback for the global_remove wl_registry events of the registry owned by
+ * @ref wsi::wayland::display_cache
+ */
+VWL_CAPI_CALL(void)
+display_cache_global_remove_handler(void *data, struct wl_registry *wl_registry, uint32_t name) VWL_API_POST;
+
+/**
+ * @brief Globals and dmabuf formats of a wl_display, shared by all the surfaces created on it.
+ *
+ * The first surface of a display fills the cache with a registry round trip and its format negotiation. Surfaces
+ * created while the cache is alive bind the cached globals and reuse the cached formats without any round trip.
+ *
+ * The cache keeps its registry, so globals announced or removed by the compositor update it. Any such change
+ * invalidates the cached formats and presentation clock, which the next surface then queries again.
+ */
+class display_cache
+{
+public:
+   /** Type of the handler global events are replayed to, matching wl_registry_listener::global. */
+   using global_handler = void (*)(void *data, struct wl_registry *wl_registry, uint32_t name, const char *interface,
+                                   uint32_t version);
+
+   /**
+    * @brief Get the cache of a display, creating it with a registry round trip if there is none yet.
+    *
+    * Every successful call must be balanced by a call to @ref release.
+    *
+    * @param display The Wayland display.
+    *
+    * @return The cache or nullptr on failure.
+    */
+   static display_cache *acquire(wl_display *display);
+
+   /**
+    * @brief Drop a reference obtained from @ref acquire, destroying the cache with the last reference.
+    */
+   static void release(display_cache *cache);
+
+   /**
+    * @brief Replay the cached globals to @p handler as the global events of a new registry would.
+    *
+    * Objects bound through the registry passed to @p handler are assigned to @p queue.
+    *
+    * @return true on success, false otherwise.
+    */
+   bool bind_globals(wl_event_queue *queue, global_handler handler, void *data);
+
+   /**
+    * @brief Copy the cached dmabuf formats to @p formats.
+    *
+    * @retval VK_SUCCESS                 The formats have been copied.
+    * @retval VK_NOT_READY               No formats are cached.
+    * @retval VK_ERROR_OUT_OF_HOST_MEMORY The host went out of memory.
+    */
+   VkResult get_formats(util::vector<drm_format_pair> &formats);
+
+   /**
+    * @brief Store the dmabuf formats negotiated by a surface.
+    */
+   void store_formats(const util::vector<drm_format_pair> &formats);
+
+   /**
+    * @brief Get the cached wp_presentation clock.
+    *
+    * @return true if a clock is cached, false otherwise.
+    */
+   bool get_presentation_clock(clockid_t &clock_id);
+
+   /**
+    * @brief Store the wp_presentation clock announced to a surface.
+    */
+   void store_presentation_clock(clockid_t clock_id);
+
+   display_cache(wl_display *display, const util::allocator &allocator);
+
+   display_cache(const display_cache &) = delete;
+   display_cache &operator=(const display_cache &) = delete;
+
+private:
+   /**
+    * @brief Create the registry and receive the initial globals.
+    *
+    * @return true on success, false otherwise.
+    */
+   bool init();
+
+   /** @brief Process the registry events received since the last call. Called with @ref m_lock held. */
+   void update_locked();
+
+   /** @brief Drop the cached formats and presentation clock. Called with @ref m_lock held. */
+   void invalidate_locked();
+
+   friend void display_cache_global_handler(void *data, struct wl_registry *wl_registry, uint32_t name,
+                                            const char *interface, uint32_t version) VWL_API_POST;
+   friend void display_cache_global_remove_handler(void *data, struct wl_registry *wl_registry,
+                                                   uint32_t name) VWL_API_POST;
+
+   /** A global announced by the compositor. */
+   struct global
+   {
+      uint32_t name;
+      char interface[WAYLAND_MAX_CACHED_INTERFACE_NAME];
+      uint32_t version;
+   };
+
+   /** The Wayland display. */
+   wl_display *m_display;
+
+   /** Queue of the registry events. It should be destroyed after the registry. */
+   wayland_owner<wl_event_queue> m_queue;
+
+   /** The registry the globals are received from. */
+   wayland_owner<wl_registry> m_registry;
+
+   /** Protects the members below. */
+   std::mutex m_lock;
+
+   /** Globals currently announced by the compositor. */
+   util::vector<global> m_globals;
+
+   /** Cached dmabuf formats, valid if @ref m_has_formats is set. */
+   util::vector<drm_format_pair> m_formats;
+   bool m_has_formats;
+
+   /** Cached wp_presentation clock, valid if @ref m_has_presentation_clock is set. */
+   clockid_t m_presentation_clock;
+   bool m_has_presentation_clock;
+
+   /** Number of references handed out by @ref acquire, protected by the list lock. */
+   uint32_t m_ref_count;
+
+   /** Next cache in the list of the caches of all the displays, protected by the list lock. */
+   display_cache *m_next;
+};
+
+} // namespace wayland
+} // namespace wsi
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Implementation of the per wl_display event thread.
+ */
+
+#include "event_thread.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <system_error>
+#include <unistd.h>
+
+#include "util/log.hpp"
+#include "util/macros.hpp"
+#include "util/thread.hpp"
+
+namespace wsi
+{
+namespace wayland
+{
+
+namespace
+{
+/** Protects the list of event threads and their reference counts. */
+std::mutex event_thread_list_lock;
+/** Event threads of all the displays the layer has surfaces on. */
+event_thread *event_thread_list = nullptr;
+} // namespace
+
+event_thread::event_thread(wl_display *display, const util::allocator &allocator)
+   : m_display(display)
+   , m_read_queue(nullptr)
+   , m_wakeup_fd()
+   , m_queues(allocator)
+   , m_run(false)
+   , m_running(false)
+   , m_ref_count(0)
+   , m_next(nullptr)
+{
+}
+
+event_thread::~event_thread()
+{
+   stop();
+}
+
+event_thread *event_thread::acquire(wl_display *display)
+{
+   std::lock_guard<std::mutex> lock(event_thread_list_lock);
+   for (event_thread *thread = event_thread_list; thread != nullptr; thread = thread->m_next)
+   {
+      if (thread->m_display == display)
+      {
+         thread->m_ref_count++;
+         return thread;
+      }
+   }
+
+   const util::allocator &allocator = util::allocator::get_generic();
+   event_thread *thread = allocator.create<event_thread>(1, display, allocator);
+   if (thread == nullptr)
+   {
+      return nullptr;
+   }
+
+   if (!thread->start())
+   {
+      allocator.destroy(1, thread);
+      return nullptr;
+   }
+
+   thread->m_ref_count = 1;
+   thread->m_next = event_thread_list;
+   event_thread_list = thread;
+   return thread;
+}
+
+void event_thread::release(event_thread *thread)
+{
+   if (thread == nullptr)
+   {
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(event_thread_list_lock);
+      assert(thread->m_ref_count > 0);
+      if (--thread->m_ref_count > 0)
+      {
+         return;
+      }
+
+      event_thread **link = &event_thread_list;
+      while (*link != thread)
+      {
+         link = &(*link)->m_next;
+      }
+      *link = thread->m_next;
+   }
+
+   util::allocator::get_generic().destroy(1, thread);
+}
+
+bool event_thread::start()
+{
+   m_read_queue.reset(wl_display_create_queue(m_display));
+   if (m_read_queue == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to create the event thread queue.");
+      return false;
+   }
+
+   m_wakeup_fd = util::fd_owner{ eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK) };
+   if (!m_wakeup_fd.is_valid())
+   {
+      WSI_LOG_ERROR("Failed to create the event thread wake up event.");
+      return false;
+   }
+
+   m_run.store(true, std::memory_order_release);
+   m_running.store(true, std::memory_order_release);
+   try
+   {
+      m_thread = util::start_thread("wsi-wl-events", nullptr, &event_thread::run, this);
+   }
+   catch (const std::system_error &)
+   {
+      WSI_LOG_ERROR("Failed to start the Wayland event thread.");
+      m_run.store(false, std::memory_order_release);
+      m_running.store(false, std::memory_order_release);
+      return false;
+   }
+
+   return true;
+}
+
+void event_thread::stop()
+{
+   m_run.store(false, std::memory_order_release);
+   if (m_thread.joinable())
+   {
+      wake_up();
+      m_thread.join();
+   }
+}
+
+void event_thread::wake_up()
+{
+   const uint64_t value = 1;
+   ssize_t res = write(m_wakeup_fd.get(), &value, sizeof(value));
+   /* The write can only fail if the counter would overflow, which still leaves the thread woken up. */
+   UNUSED(res);
+}
+
+bool event_thread::add_queue(wl_event_queue *queue)
+{
+   {
+      std::lock_guard<std::mutex> lock(m_dispatch_lock);
+      if (!m_queues.try_push_back(queue))
+      {
+         return false;
+      }
+   }
+
+   /* Events for the queue may already have been read, dispatch them without waiting for the next read. */
+   wake_up();
+   return true;
+}
+
+void event_thread::remove_queue(wl_event_queue *queue)
+{
+   std::lock_guard<std::mutex> lock(m_dispatch_lock);
+   auto it = std::find(m_queues.begin(), m_queues.end(), queue);
+   if (it != m_queues.end())
+   {
+      m_queues.erase(it);
+   }
+}
+
+void event_thread::dispatch_queues()
+{
+   std::lock_guard<std::mutex> lock(m_dispatch_lock);
+   for (wl_event_queue *queue : m_queues)
+   {
+      wl_display_dispatch_queue_pending(m_display, queue);
+   }
+}
+
+void event_thread::run()
+{
+   while (m_run.load(std::memory_order_acquire))
+   {
+      /* Nothing is ever queued on the read queue, so preparing the read only fails if an event somehow got there. */
+      if (wl_display_prepare_read_queue(m_display, m_read_queue.get()) != 0)
+      {
+         wl_display_dispatch_queue_pending(m_display, m_read_queue.get());
+         continue;
+      }
+
+      /* Other threads may have read events for the registered queues since the last dispatch. Those events do not
+       * make the display readable, so dispatch them before sleeping. */
+      dispatch_queues();
+
+      /* Send the requests made by the handlers. A failure shows up as an error on the display file descriptor. */
+      wl_display_flush(m_display);
+
+      struct pollfd fds[2] = {};
+      fds[0].fd = wl_display_get_fd(m_display);
+      fds[0].events = POLLIN;
+      fds[1].fd = m_wakeup_fd.get();
+      fds[1].events = POLLIN;
+
+      int ret = poll(fds, 2, -1);
+      if (ret < 0)
+      {
+         wl_display_cancel_read(m_display);
+         if (errno == EINTR)
+         {
+            continue;
+         }
+
+         WSI_LOG_ERROR("Failed to poll the Wayland display.");
+         break;
+      }
+
+      if ((fds[1].revents & POLLIN) != 0)
+      {
+         /* Reset the event counter, the thread re-checks its state after every wake up. */
+         uint64_t value = 0;
+         ssize_t res = read(m_wakeup_fd.get(), &value, sizeof(value));
+         UNUSED(res);
+      }
+
+      if ((fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+      {
+         wl_display_cancel_read(m_display);
+         WSI_LOG_ERROR("Lost the connection to the Wayland display.");
+         break;
+      }
+
+      if ((fds[0].revents & POLLIN) != 0)
+      {
+         /* A failure in read_events cancels the read. */
+         if (wl_display_read_events(m_display) != 0)
+         {
+            WSI_LOG_ERROR("Failed to read the Wayland display events.");
+            break;
+         }
+      }
+      else
+      {
+         wl_display_cancel_read(m_display);
+      }
+
+      dispatch_queues();
+   }
+
+   m_running.store(false, std::memory_order_release);
+}
+
+} // namespace wayland
+} // namespace wsi
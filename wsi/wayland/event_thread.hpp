@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Per wl_display thread dispatching the Wayland events of the layer.
+ */
+
+#pragma once
+
+#ifndef __STDC_VERSION__
+#define __STDC_VERSION__ 0
+#endif
+#include <wayland-client.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "wl_object_owner.hpp"
+#include "util/custom_allocator.hpp"
+#include "util/file_descriptor.hpp"
+
+namespace wsi
+{
+namespace wayland
+{
+
+/**
+ * @brief Thread reading a wl_display and dispatching a set of event queues.
+ *
+ * A single thread is shared by all the surfaces and swapchains created on the same wl_display. It does the
+ * prepare_read/poll/read_events cycle once for all of them and dispatches the registered queues, so the buffer release
+ * and frame done handlers run as soon as the events arrive. The acquire and present paths then only wait on the
+ * state updated by the handlers instead of dispatching the queues themselves.
+ *
+ * The handlers of the registered queues run on the event thread with the dispatch lock held.
+ */
+class event_thread
+{
+public:
+   /**
+    * @brief Get the event thread of a display, starting it if there is none yet.
+    *
+    * Every successful call must be balanced by a call to @ref release.
+    *
+    * @param display The Wayland display to read events from.
+    *
+    * @return The event thread or nullptr if it could not be started.
+    */
+   static event_thread *acquire(wl_display *display);
+
+   /**
+    * @brief Drop a reference obtained from @ref acquire, stopping the thread with the last reference.
+    *
+    * All the queues registered by the caller must have been removed.
+    */
+   static void release(event_thread *thread);
+
+   /**
+    * @brief Start dispatching @p queue on the event thread.
+    *
+    * @return true on success, false if memory could not be allocated.
+    */
+   bool add_queue(wl_event_queue *queue);
+
+   /**
+    * @brief Stop dispatching @p queue on the event thread.
+    *
+    * When this returns none of the handlers of the queue are running and none will run from the event thread.
+    */
+   void remove_queue(wl_event_queue *queue);
+
+   /**
+    * @brief Lock held by the event thread while it dispatches the registered queues.
+    *
+    * Holding it allows destroying proxies of a registered queue without racing against their handlers.
+    */
+   std::mutex &get_dispatch_lock()
+   {
+      return m_dispatch_lock;
+   }
+
+   /**
+    * @brief Whether the thread is still dispatching events.
+    *
+    * The thread exits if the connection to the compositor fails, in which case the owners of the registered queues
+    * have to dispatch them themselves.
+    */
+   bool is_running() const
+   {
+      return m_running.load(std::memory_order_acquire);
+   }
+
+   event_thread(wl_display *display, const util::allocator &allocator);
+   ~event_thread();
+
+   event_thread(const event_thread &) = delete;
+   event_thread &operator=(const event_thread &) = delete;
+
+private:
+   /**
+    * @brief Create the queue and wake up event and start the thread.
+    *
+    * @return true on success, false otherwise.
+    */
+   bool start();
+
+   /** @brief Stop and join the thread. */
+   void stop();
+
+   /** @brief Wake up the thread from its poll. */
+   void wake_up();
+
+   /** @brief Dispatch the events already read for the registered queues. */
+   void dispatch_queues();
+
+   /** @brief Entry point of the thread. */
+   void run();
+
+   /** The Wayland display the thread reads. */
+   wl_display *m_display;
+
+   /**
+    * Queue without any objects. Preparing a read on it always succeeds, which lets the thread read events for all the
+    * registered queues at once.
+    */
+   wayland_owner<wl_event_queue> m_read_queue;
+
+   /** Event used to wake the thread up from its poll. */
+   util::fd_owner m_wakeup_fd;
+
+   /** Protects @ref m_queues and is held while dispatching them. */
+   std::mutex m_dispatch_lock;
+
+   /** Queues dispatched by the thread. */
+   util::vector<wl_event_queue *> m_queues;
+
+   /** Set while the thread should keep running. */
+   std::atomic<bool> m_run;
+
+   /** Set while the thread is dispatching events. */
+   std::atomic<bool> m_running;
+
+   /** The thread reading the display. */
+   std::thread m_thread;
+
+   /** Number of references handed out by @ref acquire, protected by the list lock. */
+   uint32_t m_ref_count;
+
+   /** Next thread in the list of the threads of all the displays, protected by the list lock. */
+   event_thread *m_next;
+};
+
+} // namespace wayland
+} // namespace wsi
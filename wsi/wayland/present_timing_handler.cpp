@@ -29,29 +29,201 @@
  */
 
 #include "present_timing_handler.hpp"
+#include "wl_helpers.hpp"
 
-wsi_ext_present_timing_wayland::wsi_ext_present_timing_wayland(const util::allocator &allocator)
+#include <algorithm>
+
+#include <util/log.hpp>
+
+wayland_presentation_time_domain::wayland_presentation_time_domain(VkPresentStageFlagsEXT present_stages,
+                                                                   clockid_t clock_id)
+   : wsi::swapchain_time_domain(present_stages)
+   , m_clock_id(clock_id)
+   , m_calibration(clock_id)
+{
+}
+
+static uint64_t clock_now_ns(clockid_t clock_id)
+{
+   timespec now = {};
+   clock_gettime(clock_id, &now);
+   return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+}
+
+wsi::swapchain_calibrated_time wayland_presentation_time_domain::calibrate()
+{
+   switch (m_clock_id)
+   {
+   case CLOCK_MONOTONIC:
+      return { VK_TIME_DOMAIN_CLOCK_MONOTONIC_KHR, 0 };
+   case CLOCK_MONOTONIC_RAW:
+      return { VK_TIME_DOMAIN_CLOCK_MONOTONIC_RAW_KHR, 0 };
+   default:
+   {
+      const int64_t offset = m_calibration.get_offset(clock_now_ns(CLOCK_MONOTONIC));
+      return { VK_TIME_DOMAIN_CLOCK_MONOTONIC_KHR, static_cast<uint64_t>(offset) };
+   }
+   }
+}
+
+VWL_CAPI_CALL(void)
+wp_presentation_feedback_sync_output(void *data, struct wp_presentation_feedback *wp_feedback,
+                                     struct wl_output *output) VWL_API_POST
+{
+   UNUSED(data);
+   UNUSED(wp_feedback);
+   UNUSED(output);
+}
+
+VWL_CAPI_CALL(void)
+wp_presentation_feedback_presented(void *data, struct wp_presentation_feedback *wp_feedback, uint32_t tv_sec_hi,
+                                   uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh, uint32_t seq_hi,
+                                   uint32_t seq_lo, uint32_t flags) VWL_API_POST
+{
+   UNUSED(wp_feedback);
+   UNUSED(seq_hi);
+   UNUSED(seq_lo);
+
+   auto feedback = reinterpret_cast<wayland_presentation_feedback *>(data);
+   const uint64_t tv_sec = (static_cast<uint64_t>(tv_sec_hi) << 32) | tv_sec_lo;
+   feedback->ext->feedback_presented(*feedback, tv_sec * 1000000000ull + tv_nsec, refresh, flags);
+}
+
+VWL_CAPI_CALL(void)
+wp_presentation_feedback_discarded(void *data, struct wp_presentation_feedback *wp_feedback) VWL_API_POST
+{
+   UNUSED(wp_feedback);
+
+   auto feedback = reinterpret_cast<wayland_presentation_feedback *>(data);
+   feedback->ext->feedback_discarded(*feedback);
+}
+
+static const wp_presentation_feedback_listener presentation_feedback_listener = {
+   wp_presentation_feedback_sync_output,
+   wp_presentation_feedback_presented,
+   wp_presentation_feedback_discarded,
+};
+
+wsi_ext_present_timing_wayland::wsi_ext_present_timing_wayland(const util::allocator &allocator,
+                                                               wl_display *display, wp_presentation *presentation)
    : wsi_ext_present_timing(allocator)
+   , m_display(display)
+   , m_presentation(presentation)
+   , m_queue(nullptr)
+   , m_feedbacks()
+   , m_refresh_duration(0)
+   , m_timing_properties_counter(0)
 {
+   for (auto &feedback : m_feedbacks)
+   {
+      feedback.ext = this;
+   }
 }
 
 util::unique_ptr<wsi_ext_present_timing_wayland> wsi_ext_present_timing_wayland::create(
-   const util::allocator &allocator)
+   const util::allocator &allocator, wl_display *display, wp_presentation *presentation, clockid_t clock_id)
 {
    std::array<util::unique_ptr<wsi::vulkan_time_domain>, 1> time_domains_array = {
       allocator.make_unique<wsi::vulkan_time_domain>(VK_PRESENT_STAGE_QUEUE_OPERATIONS_END_BIT_EXT,
                                                      VK_TIME_DOMAIN_DEVICE_KHR)
    };
 
-   return wsi_ext_present_timing::create<wsi_ext_present_timing_wayland>(allocator, time_domains_array);
+   auto present_timing = wsi_ext_present_timing::create<wsi_ext_present_timing_wayland>(allocator, time_domains_array,
+                                                                                        display, presentation);
+   if (present_timing == nullptr || presentation == nullptr)
+   {
+      return present_timing;
+   }
+
+   /* wp_presentation reports when a commit turned into light on its main output. */
+   auto presentation_domain = allocator.make_unique<wayland_presentation_time_domain>(
+      VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_VISIBLE_BIT_EXT, clock_id);
+   if (!present_timing->get_swapchain_time_domains().add_time_domain(std::move(presentation_domain)))
+   {
+      WSI_LOG_ERROR("Failed to add a time domain.");
+      return nullptr;
+   }
+
+   present_timing->m_queue.reset(wl_display_create_queue(display));
+   if (present_timing->m_queue == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to create presentation feedback queue.");
+      return nullptr;
+   }
+
+   return present_timing;
 }
 
 VkResult wsi_ext_present_timing_wayland::get_swapchain_timing_properties(
    uint64_t &timing_properties_counter, VkSwapchainTimingPropertiesEXT &timing_properties)
 {
-   timing_properties_counter = 0;
-   timing_properties.refreshDuration = 0;
-   timing_properties.variableRefreshDelay = 0;
+   const uint64_t refresh_duration = m_refresh_duration.load(std::memory_order_relaxed);
+
+   timing_properties_counter = m_timing_properties_counter.load(std::memory_order_relaxed);
+   timing_properties.refreshDuration = refresh_duration;
+   /* wp_presentation does not tell whether the output refreshes at a variable rate. */
+   timing_properties.variableRefreshDelay = refresh_duration != 0 ? UINT64_MAX : 0;
 
    return VK_SUCCESS;
-}
\ No newline at end of file
+}
+
+void wsi_ext_present_timing_wayland::request_presentation_feedback(wl_surface *surface, uint64_t timing_slot)
+{
+   if (m_presentation == nullptr)
+   {
+      return;
+   }
+
+   /* Frees the slots of the commits that have been presented or discarded since the last call. */
+   if (dispatch_queue(m_display, m_queue.get(), 0) < 0)
+   {
+      WSI_LOG_ERROR("Failed to dispatch presentation feedback events.");
+   }
+
+   auto slot = std::find_if(m_feedbacks.begin(), m_feedbacks.end(),
+                            [](const wayland_presentation_feedback &feedback) { return feedback.feedback == nullptr; });
+   if (slot == m_feedbacks.end())
+   {
+      /* The compositor is not keeping up, so leave this presentation without timing rather than blocking. */
+      complete_presentation_entry(timing_slot, 0, 0, 0, 0);
+      return;
+   }
+
+   auto presentation_proxy = make_proxy_with_queue(m_presentation, m_queue.get());
+   if (presentation_proxy != nullptr)
+   {
+      slot->feedback.reset(wp_presentation_feedback(presentation_proxy.get(), surface));
+   }
+
+   if (slot->feedback == nullptr ||
+       wp_presentation_feedback_add_listener(slot->feedback.get(), &presentation_feedback_listener, &*slot) < 0)
+   {
+      WSI_LOG_ERROR("Failed to request presentation feedback.");
+      slot->feedback.reset();
+      complete_presentation_entry(timing_slot, 0, 0, 0, 0);
+      return;
+   }
+
+   slot->timing_slot = timing_slot;
+}
+
+void wsi_ext_present_timing_wayland::feedback_presented(wayland_presentation_feedback &feedback,
+                                                        uint64_t present_time, uint32_t refresh, uint32_t flags)
+{
+   complete_presentation_entry(feedback.timing_slot, VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_VISIBLE_BIT_EXT, present_time,
+                               refresh, flags);
+
+   if (refresh != 0 && m_refresh_duration.exchange(refresh, std::memory_order_relaxed) != refresh)
+   {
+      m_timing_properties_counter.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   /* The compositor destroys the feedback object once either event has been sent. */
+   feedback.feedback.reset();
+}
+
+void wsi_ext_present_timing_wayland::feedback_discarded(wayland_presentation_feedback &feedback)
+{
+   complete_presentation_entry(feedback.timing_slot, 0, 0, 0, 0);
+   feedback.feedback.reset();
+}
@@ -33,6 +33,50 @@
 
 #include <wsi/extensions/present_timing.hpp>
 
+#ifndef __STDC_VERSION__
+#define __STDC_VERSION__ 0
+#endif
+#include <wayland-client.h>
+#include <time.h>
+
+#include <array>
+#include <atomic>
+
+#include "wl_object_owner.hpp"
+
+/**
+ * @brief Maximum number of commits with a wp_presentation_feedback that has not been presented or discarded yet.
+ */
+#define WAYLAND_MAX_PENDING_PRESENTATION_FEEDBACKS 16
+
+class wsi_ext_present_timing_wayland;
+
+/**
+ * @brief A wp_presentation_feedback requested for a commit.
+ */
+struct wayland_presentation_feedback
+{
+   wsi_ext_present_timing_wayland *ext{ nullptr };
+   uint64_t timing_slot{ 0 };
+   wsi::wayland::wayland_owner<struct wp_presentation_feedback> feedback;
+};
+
+/**
+ * @brief Time domain of the clock the compositor reports presentation times in.
+ */
+class wayland_presentation_time_domain : public wsi::swapchain_time_domain
+{
+public:
+   wayland_presentation_time_domain(VkPresentStageFlagsEXT present_stages, clockid_t clock_id);
+
+   /* Clocks without a Vulkan time domain are reported as an offset from CLOCK_MONOTONIC, see clock_calibration. */
+   wsi::swapchain_calibrated_time calibrate() override;
+
+private:
+   clockid_t m_clock_id;
+   wsi::clock_calibration m_calibration;
+};
+
 /**
  * @brief Present timing extension class
  *
@@ -41,16 +85,80 @@
 class wsi_ext_present_timing_wayland : public wsi::wsi_ext_present_timing
 {
 public:
-   static util::unique_ptr<wsi_ext_present_timing_wayland> create(const util::allocator &allocator);
+   /**
+    * @brief Create the Wayland present timing extension.
+    *
+    * @param allocator    Allocator for the extension.
+    * @param display      The Wayland display of the surface.
+    * @param presentation The compositor's wp_presentation, or nullptr if it is not supported, in which case only
+    *                     the queue operations end stage is available.
+    * @param clock_id     Clock announced by @p presentation.
+    *
+    * @return The extension, or nullptr on failure.
+    */
+   static util::unique_ptr<wsi_ext_present_timing_wayland> create(const util::allocator &allocator,
+                                                                  wl_display *display, wp_presentation *presentation,
+                                                                  clockid_t clock_id);
 
    VkResult get_swapchain_timing_properties(uint64_t &timing_properties_counter,
                                             VkSwapchainTimingPropertiesEXT &timing_properties) override;
 
+   /**
+    * @brief Request wp_presentation feedback for the next commit of a surface.
+    *
+    * Also completes the entries of earlier commits whose feedback has arrived. It must only be called from the thread
+    * presenting to the surface, before its commit.
+    *
+    * @param surface     The surface about to be committed.
+    * @param timing_slot The slot of the presentation entry for the commit, 0 if no timing was requested.
+    */
+   void request_presentation_feedback(wl_surface *surface, uint64_t timing_slot);
+
+   /**
+    * @brief Handle the presented event of a feedback.
+    *
+    * @param feedback     The feedback that was presented.
+    * @param present_time Time the commit turned into light, in the clock of the surface's wp_presentation.
+    * @param refresh      Refresh duration of the output in nanoseconds, or 0 if unknown.
+    * @param flags        The wp_presentation_feedback kind flags.
+    */
+   void feedback_presented(wayland_presentation_feedback &feedback, uint64_t present_time, uint32_t refresh,
+                           uint32_t flags);
+
+   /**
+    * @brief Handle the discarded event of a feedback.
+    *
+    * @param feedback The feedback that was discarded.
+    */
+   void feedback_discarded(wayland_presentation_feedback &feedback);
+
 private:
-   wsi_ext_present_timing_wayland(const util::allocator &allocator);
+   wsi_ext_present_timing_wayland(const util::allocator &allocator, wl_display *display,
+                                  wp_presentation *presentation);
 
    /* Allow util::allocator to access the private constructor */
    friend util::allocator;
+
+   wl_display *m_display;
+   wp_presentation *m_presentation;
+
+   /**
+    * @brief Queue the feedback events are delivered to, only dispatched by @ref request_presentation_feedback.
+    *
+    * It is destroyed after @ref m_feedbacks, so no events are dispatched for destroyed feedbacks.
+    */
+   wsi::wayland::wayland_owner<wl_event_queue> m_queue;
+
+   /**
+    * @brief Feedbacks of the commits not presented or discarded yet, a slot is free when its feedback is nullptr.
+    */
+   std::array<wayland_presentation_feedback, WAYLAND_MAX_PENDING_PRESENTATION_FEEDBACKS> m_feedbacks;
+
+   /**
+    * @brief Last refresh duration reported by the compositor, and the number of times it changed.
+    */
+   std::atomic<uint64_t> m_refresh_duration;
+   std::atomic<uint64_t> m_timing_properties_counter;
 };
 
-#endif
\ No newline at end of file
+#endif
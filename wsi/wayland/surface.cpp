@@ -33,6 +33,19 @@
 #include "wl_helpers.hpp"
 #include "util/log.hpp"
 
+#include <drm_fourcc.h>
+
+#include <chrono>
+
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+#include <fcntl.h>
+#include <xf86drm.h>
+#endif
+
+#if WAYLAND_DMABUF_FEEDBACK_ENABLED
+#include <sys/mman.h>
+#endif
+
 namespace wsi
 {
 namespace wayland
@@ -122,6 +135,261 @@ static VkResult get_supported_formats_and_modifiers(wl_display *display, wl_even
    return VK_SUCCESS;
 }
 
+#if WAYLAND_DMABUF_FEEDBACK_ENABLED
+dmabuf_feedback_state::dmabuf_feedback_state(const util::allocator &allocator)
+   : tranche_formats(allocator)
+   , pending_formats(allocator)
+   , pending_scanout_formats(allocator)
+   , formats(allocator)
+   , scanout_formats(allocator)
+{
+}
+
+dmabuf_feedback_state::~dmabuf_feedback_state()
+{
+   if (format_table != nullptr)
+   {
+      munmap(format_table, format_table_size);
+   }
+}
+
+namespace
+{
+/* Layout of the entries of the zwp_linux_dmabuf_feedback_v1 format table. */
+struct dmabuf_format_table_entry
+{
+   uint32_t format;
+   uint32_t padding;
+   uint64_t modifier;
+};
+
+/* Add a format to a list unless it is already there. Returns false if out of memory. */
+bool add_unique_format(util::vector<drm_format_pair> &formats, const drm_format_pair &format)
+{
+   for (const auto &existing : formats)
+   {
+      if (existing.fourcc == format.fourcc && existing.modifier == format.modifier)
+      {
+         return true;
+      }
+   }
+   return formats.try_push_back(format);
+}
+
+/* Handler for done event of the zwp_linux_dmabuf_feedback_v1 interface. */
+VWL_CAPI_CALL(void)
+dmabuf_feedback_done(void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback) VWL_API_POST
+{
+   UNUSED(feedback);
+   auto state = reinterpret_cast<dmabuf_feedback_state *>(data);
+
+   if (state->is_out_of_memory)
+   {
+      WSI_LOG_ERROR("Host got out of memory, dropping the dmabuf feedback.");
+   }
+   else
+   {
+      std::lock_guard<std::mutex> lock(state->lock);
+      state->formats.swap(state->pending_formats);
+      state->scanout_formats.swap(state->pending_scanout_formats);
+      state->done_count++;
+   }
+
+   state->pending_formats.clear();
+   state->pending_scanout_formats.clear();
+   state->is_out_of_memory = false;
+}
+
+/* Handler for format_table event of the zwp_linux_dmabuf_feedback_v1 interface. */
+VWL_CAPI_CALL(void)
+dmabuf_feedback_format_table(void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback, int32_t fd,
+                             uint32_t size) VWL_API_POST
+{
+   UNUSED(feedback);
+   auto state = reinterpret_cast<dmabuf_feedback_state *>(data);
+   util::fd_owner table_fd{ fd };
+
+   if (state->format_table != nullptr)
+   {
+      munmap(state->format_table, state->format_table_size);
+      state->format_table = nullptr;
+      state->format_table_size = 0;
+   }
+
+   void *table = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, table_fd.get(), 0);
+   if (table == MAP_FAILED)
+   {
+      WSI_LOG_ERROR("Failed to map the dmabuf feedback format table.");
+      return;
+   }
+
+   state->format_table = table;
+   state->format_table_size = size;
+}
+
+/* Handler for main_device event of the zwp_linux_dmabuf_feedback_v1 interface. */
+VWL_CAPI_CALL(void)
+dmabuf_feedback_main_device(void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback,
+                            struct wl_array *device) VWL_API_POST
+{
+   UNUSED(data);
+   UNUSED(feedback);
+   UNUSED(device);
+}
+
+/* Handler for tranche_done event of the zwp_linux_dmabuf_feedback_v1 interface. */
+VWL_CAPI_CALL(void)
+dmabuf_feedback_tranche_done(void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback) VWL_API_POST
+{
+   UNUSED(feedback);
+   auto state = reinterpret_cast<dmabuf_feedback_state *>(data);
+
+   const bool is_scanout = (state->tranche_flags & ZWP_LINUX_DMABUF_FEEDBACK_V1_TRANCHE_FLAGS_SCANOUT) != 0;
+   for (const auto &format : state->tranche_formats)
+   {
+      if (!add_unique_format(state->pending_formats, format) ||
+          (is_scanout && !add_unique_format(state->pending_scanout_formats, format)))
+      {
+         state->is_out_of_memory = true;
+      }
+   }
+
+   state->tranche_formats.clear();
+   state->tranche_flags = 0;
+}
+
+/* Handler for tranche_target_device event of the zwp_linux_dmabuf_feedback_v1 interface. */
+VWL_CAPI_CALL(void)
+dmabuf_feedback_tranche_target_device(void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback,
+                                      struct wl_array *device) VWL_API_POST
+{
+   UNUSED(data);
+   UNUSED(feedback);
+   UNUSED(device);
+}
+
+/* Handler for tranche_formats event of the zwp_linux_dmabuf_feedback_v1 interface. */
+VWL_CAPI_CALL(void)
+dmabuf_feedback_tranche_formats(void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback,
+                                struct wl_array *indices) VWL_API_POST
+{
+   UNUSED(feedback);
+   auto state = reinterpret_cast<dmabuf_feedback_state *>(data);
+   if (state->format_table == nullptr)
+   {
+      WSI_LOG_ERROR("Received dmabuf feedback tranche formats without a format table.");
+      return;
+   }
+
+   auto table = reinterpret_cast<const dmabuf_format_table_entry *>(state->format_table);
+   const size_t table_entries = state->format_table_size / sizeof(dmabuf_format_table_entry);
+   const uint16_t *index_data = reinterpret_cast<const uint16_t *>(indices->data);
+   const size_t index_count = indices->size / sizeof(uint16_t);
+   for (size_t i = 0; i < index_count; i++)
+   {
+      if (index_data[i] >= table_entries)
+      {
+         continue;
+      }
+
+      drm_format_pair format = {};
+      format.fourcc = table[index_data[i]].format;
+      format.modifier = table[index_data[i]].modifier;
+      if (!state->tranche_formats.try_push_back(format))
+      {
+         state->is_out_of_memory = true;
+      }
+   }
+}
+
+/* Handler for tranche_flags event of the zwp_linux_dmabuf_feedback_v1 interface. */
+VWL_CAPI_CALL(void)
+dmabuf_feedback_tranche_flags(void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback, uint32_t flags) VWL_API_POST
+{
+   UNUSED(feedback);
+   auto state = reinterpret_cast<dmabuf_feedback_state *>(data);
+   state->tranche_flags = flags;
+}
+} // namespace
+
+/*
+ * @brief Get supported formats and modifiers using the dmabuf feedback of a surface.
+ *
+ * The feedback object is kept so that later feedback updates the scanout formats of @p state.
+ *
+ * @param[in]  display               The wl_display that is being used.
+ * @param[in]  queue                 The wl_event_queue set for the @p dmabuf_interface
+ * @param[in]  dmabuf_interface      Object of the zwp_linux_dmabuf_v1 interface, bound with version 4 or newer.
+ * @param[in]  wayland_surface       The surface to get the feedback for.
+ * @param[out] feedback              The feedback object of the surface.
+ * @param[in]  state                 State updated by the feedback events.
+ * @param[in]  wait_for_feedback     Whether to wait for the initial feedback and fill @p supported_formats with it.
+ * @param[out] supported_formats     Vector which will contain the supported drm
+ *                                   formats and their modifiers.
+ *
+ * @retval VK_SUCCESS                    Indicates success.
+ * @retval VK_ERROR_UNKNOWN              Indicates one of the Wayland functions failed.
+ * @retval VK_ERROR_OUT_OF_DEVICE_MEMORY Indicates the host went out of memory.
+ */
+static VkResult get_dmabuf_feedback_formats(wl_display *display, wl_event_queue *queue,
+                                            zwp_linux_dmabuf_v1 *dmabuf_interface, wl_surface *wayland_surface,
+                                            wayland_owner<zwp_linux_dmabuf_feedback_v1> &feedback,
+                                            dmabuf_feedback_state &state, bool wait_for_feedback,
+                                            util::vector<drm_format_pair> &supported_formats)
+{
+   feedback.reset(zwp_linux_dmabuf_v1_get_surface_feedback(dmabuf_interface, wayland_surface));
+   if (feedback == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to get the dmabuf feedback of the surface.");
+      return VK_ERROR_UNKNOWN;
+   }
+
+   static const zwp_linux_dmabuf_feedback_v1_listener feedback_listener = {
+      .done = dmabuf_feedback_done,
+      .format_table = dmabuf_feedback_format_table,
+      .main_device = dmabuf_feedback_main_device,
+      .tranche_done = dmabuf_feedback_tranche_done,
+      .tranche_target_device = dmabuf_feedback_tranche_target_device,
+      .tranche_formats = dmabuf_feedback_tranche_formats,
+      .tranche_flags = dmabuf_feedback_tranche_flags,
+   };
+   int res = zwp_linux_dmabuf_feedback_v1_add_listener(feedback.get(), &feedback_listener, &state);
+   if (res < 0)
+   {
+      WSI_LOG_ERROR("Failed to add zwp_linux_dmabuf_feedback_v1 listener.");
+      return VK_ERROR_UNKNOWN;
+   }
+
+   if (!wait_for_feedback)
+   {
+      return VK_SUCCESS;
+   }
+
+   /* The compositor sends the initial feedback straight away. */
+   res = wl_display_roundtrip_queue(display, queue);
+   if (res < 0)
+   {
+      WSI_LOG_ERROR("Roundtrip failed.");
+      return VK_ERROR_UNKNOWN;
+   }
+
+   std::lock_guard<std::mutex> lock(state.lock);
+   if (state.done_count == 0)
+   {
+      WSI_LOG_ERROR("The compositor did not send the dmabuf feedback of the surface.");
+      return VK_ERROR_UNKNOWN;
+   }
+
+   if (!supported_formats.try_push_back_many(state.formats.data(), state.formats.data() + state.formats.size()))
+   {
+      WSI_LOG_ERROR("Host got out of memory.");
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   return VK_SUCCESS;
+}
+#endif
+
 struct surface::init_parameters
 {
    const util::allocator &allocator;
@@ -136,9 +404,26 @@ surface::surface(const init_parameters &params)
    , wayland_surface(params.surf)
    , supported_formats(params.allocator)
    , properties(this, params.allocator)
+#if WAYLAND_DMABUF_FEEDBACK_ENABLED
+   , feedback_state(params.allocator)
+#endif
+   , presentation_clock_id(CLOCK_MONOTONIC)
    , last_frame_callback(nullptr)
-   , present_pending(false)
+   , visibility_callback(nullptr)
+   , globals_cache(nullptr)
+#if WAYLAND_EVENT_THREAD_ENABLED
+   , dispatch_thread(nullptr)
+#endif
+{
+}
+
+/* Handler for clock_id event of the wp_presentation interface. */
+VWL_CAPI_CALL(void)
+wp_presentation_clock_id_impl(void *data, struct wp_presentation *presentation, uint32_t clk_id) VWL_API_POST
 {
+   UNUSED(presentation);
+   auto clock_id = reinterpret_cast<std::atomic<clockid_t> *>(data);
+   clock_id->store(static_cast<clockid_t>(clk_id));
 }
 
 VWL_CAPI_CALL(void)
@@ -149,8 +434,16 @@ surface_registry_handler(void *data, struct wl_registry *wl_registry, uint32_t n
 
    if (!strcmp(interface, zwp_linux_dmabuf_v1_interface.name) && version >= ZWP_LINUX_DMABUF_V1_MODIFIER_SINCE_VERSION)
    {
-      zwp_linux_dmabuf_v1 *dmabuf_interface_obj = reinterpret_cast<zwp_linux_dmabuf_v1 *>(wl_registry_bind(
-         wl_registry, name, &zwp_linux_dmabuf_v1_interface, ZWP_LINUX_DMABUF_V1_MODIFIER_SINCE_VERSION));
+      uint32_t bind_version = ZWP_LINUX_DMABUF_V1_MODIFIER_SINCE_VERSION;
+#if WAYLAND_DMABUF_FEEDBACK_ENABLED
+      /* Version 4 replaces the format and modifier events with the per surface feedback. */
+      if (version >= ZWP_LINUX_DMABUF_V1_GET_SURFACE_FEEDBACK_SINCE_VERSION)
+      {
+         bind_version = ZWP_LINUX_DMABUF_V1_GET_SURFACE_FEEDBACK_SINCE_VERSION;
+      }
+#endif
+      zwp_linux_dmabuf_v1 *dmabuf_interface_obj = reinterpret_cast<zwp_linux_dmabuf_v1 *>(
+         wl_registry_bind(wl_registry, name, &zwp_linux_dmabuf_v1_interface, bind_version));
 
       if (dmabuf_interface_obj == nullptr)
       {
@@ -160,6 +453,18 @@ surface_registry_handler(void *data, struct wl_registry *wl_registry, uint32_t n
 
       wsi_surface->dmabuf_interface.reset(dmabuf_interface_obj);
    }
+   else if (!strcmp(interface, wl_shm_interface.name))
+   {
+      wl_shm *shm_interface_obj = reinterpret_cast<wl_shm *>(wl_registry_bind(wl_registry, name, &wl_shm_interface, 1));
+
+      if (shm_interface_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to get wl_shm interface.");
+         return;
+      }
+
+      wsi_surface->shm_interface.reset(shm_interface_obj);
+   }
    else if (!strcmp(interface, zwp_linux_explicit_synchronization_v1_interface.name))
    {
       zwp_linux_explicit_synchronization_v1 *explicit_sync_interface_obj =
@@ -174,6 +479,79 @@ surface_registry_handler(void *data, struct wl_registry *wl_registry, uint32_t n
 
       wsi_surface->explicit_sync_interface.reset(explicit_sync_interface_obj);
    }
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   else if (!strcmp(interface, wp_linux_drm_syncobj_manager_v1_interface.name))
+   {
+      wp_linux_drm_syncobj_manager_v1 *syncobj_manager_obj = reinterpret_cast<wp_linux_drm_syncobj_manager_v1 *>(
+         wl_registry_bind(wl_registry, name, &wp_linux_drm_syncobj_manager_v1_interface, 1));
+
+      if (syncobj_manager_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to get wp_linux_drm_syncobj_manager_v1 interface.");
+         return;
+      }
+
+      wsi_surface->syncobj_manager_interface.reset(syncobj_manager_obj);
+   }
+#endif
+#if WAYLAND_FIFO_V1_ENABLED
+   else if (!strcmp(interface, wp_fifo_manager_v1_interface.name))
+   {
+      wp_fifo_manager_v1 *fifo_manager_obj =
+         reinterpret_cast<wp_fifo_manager_v1 *>(wl_registry_bind(wl_registry, name, &wp_fifo_manager_v1_interface, 1));
+
+      if (fifo_manager_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to get wp_fifo_manager_v1 interface.");
+         return;
+      }
+
+      wsi_surface->fifo_manager_interface.reset(fifo_manager_obj);
+   }
+#endif
+#if WAYLAND_COMMIT_TIMING_ENABLED
+   else if (!strcmp(interface, wp_commit_timing_manager_v1_interface.name))
+   {
+      wp_commit_timing_manager_v1 *commit_timing_manager_obj = reinterpret_cast<wp_commit_timing_manager_v1 *>(
+         wl_registry_bind(wl_registry, name, &wp_commit_timing_manager_v1_interface, 1));
+
+      if (commit_timing_manager_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to get wp_commit_timing_manager_v1 interface.");
+         return;
+      }
+
+      wsi_surface->commit_timing_manager_interface.reset(commit_timing_manager_obj);
+   }
+#endif
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   else if (!strcmp(interface, wp_tearing_control_manager_v1_interface.name))
+   {
+      wp_tearing_control_manager_v1 *tearing_control_manager_obj = reinterpret_cast<wp_tearing_control_manager_v1 *>(
+         wl_registry_bind(wl_registry, name, &wp_tearing_control_manager_v1_interface, 1));
+
+      if (tearing_control_manager_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to get wp_tearing_control_manager_v1 interface.");
+         return;
+      }
+
+      wsi_surface->tearing_control_manager_interface.reset(tearing_control_manager_obj);
+   }
+#endif
+   else if (!strcmp(interface, wp_viewporter_interface.name))
+   {
+      wp_viewporter *viewporter_obj =
+         reinterpret_cast<wp_viewporter *>(wl_registry_bind(wl_registry, name, &wp_viewporter_interface, 1));
+
+      if (viewporter_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to get wp_viewporter interface.");
+         return;
+      }
+
+      wsi_surface->viewporter_interface.reset(viewporter_obj);
+   }
    else if (!strcmp(interface, wp_presentation_interface.name))
    {
       wp_presentation *wp_presentation_obj =
@@ -186,51 +564,136 @@ surface_registry_handler(void *data, struct wl_registry *wl_registry, uint32_t n
       }
 
       wsi_surface->presentation_time_interface.reset(wp_presentation_obj);
+
+      /* The clock_id event is sent on bind and dispatched by the roundtrip getting the supported formats. When the
+       * formats are cached, the cached clock is used until the event is dispatched. */
+      static const wp_presentation_listener presentation_listener = { wp_presentation_clock_id_impl };
+      if (wp_presentation_add_listener(wp_presentation_obj, &presentation_listener,
+                                       &wsi_surface->presentation_clock_id) < 0)
+      {
+         WSI_LOG_ERROR("Failed to add wp_presentation listener.");
+      }
    }
 }
 
-bool surface::init()
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+/**
+ * @brief Open the first DRM render node on the system.
+ *
+ * Timeline syncobjs are exported to the compositor as file descriptors, so they can be created on any DRM device.
+ *
+ * @return The render node, or an invalid file descriptor if there is none.
+ */
+static util::fd_owner open_render_node()
 {
-   surface_queue.reset(wl_display_create_queue(wayland_display));
-   if (surface_queue.get() == nullptr)
+   drmDevicePtr devices[32];
+   int device_count = drmGetDevices2(0, devices, sizeof(devices) / sizeof(devices[0]));
+   if (device_count <= 0)
    {
-      WSI_LOG_ERROR("Failed to create wl surface queue.");
+      return util::fd_owner{};
+   }
+
+   util::fd_owner drm_fd;
+   for (int i = 0; i < device_count && !drm_fd.is_valid(); i++)
+   {
+      if (devices[i]->available_nodes & (1 << DRM_NODE_RENDER))
+      {
+         drm_fd = util::fd_owner{ open(devices[i]->nodes[DRM_NODE_RENDER], O_RDWR | O_CLOEXEC) };
+      }
+   }
+   drmFreeDevices(devices, device_count);
+
+   uint64_t has_timeline = 0;
+   if (drm_fd.is_valid() &&
+       (drmGetCap(drm_fd.get(), DRM_CAP_SYNCOBJ_TIMELINE, &has_timeline) != 0 || has_timeline == 0))
+   {
+      return util::fd_owner{};
+   }
+   return drm_fd;
+}
+#endif
+
+bool surface::init_dmabuf_formats()
+{
+   VkResult vk_res = globals_cache->get_formats(supported_formats);
+   if (vk_res == VK_ERROR_OUT_OF_HOST_MEMORY)
+   {
+      WSI_LOG_ERROR("Host got out of memory.");
       return false;
    }
+   /* Without cached formats the format negotiation does a round trip, which also dispatches the clock_id event. */
+   const bool query_formats = (vk_res == VK_NOT_READY);
+   clockid_t cached_clock_id = CLOCK_MONOTONIC;
+   if (!query_formats && globals_cache->get_presentation_clock(cached_clock_id))
+   {
+      presentation_clock_id = cached_clock_id;
+   }
 
-   auto display_proxy = make_proxy_with_queue(wayland_display, surface_queue.get());
-   if (display_proxy == nullptr)
+   vk_res = VK_SUCCESS;
+   bool use_feedback = false;
+#if WAYLAND_DMABUF_FEEDBACK_ENABLED
+   use_feedback =
+      zwp_linux_dmabuf_v1_get_version(dmabuf_interface.get()) >= ZWP_LINUX_DMABUF_V1_GET_SURFACE_FEEDBACK_SINCE_VERSION;
+   if (use_feedback)
+   {
+      /* The surface feedback is still needed for its scanout tranches, but with cached formats it is not waited for. */
+      vk_res = get_dmabuf_feedback_formats(wayland_display, surface_queue.get(), dmabuf_interface.get(),
+                                           wayland_surface, dmabuf_feedback, feedback_state, query_formats,
+                                           supported_formats);
+   }
+#endif
+   if (!use_feedback && query_formats)
+   {
+      vk_res = get_supported_formats_and_modifiers(wayland_display, surface_queue.get(), dmabuf_interface.get(),
+                                                   supported_formats);
+   }
+   if (vk_res != VK_SUCCESS)
    {
-      WSI_LOG_ERROR("Failed to create wl display proxy.");
       return false;
-   };
+   }
 
-   auto registry = wayland_owner<wl_registry>{ wl_display_get_registry(display_proxy.get()) };
-   if (registry == nullptr)
+   if (query_formats)
    {
-      WSI_LOG_ERROR("Failed to get wl display registry.");
+      globals_cache->store_formats(supported_formats);
+      if (presentation_time_interface != nullptr)
+      {
+         globals_cache->store_presentation_clock(presentation_clock_id);
+      }
+   }
+
+   return true;
+}
+
+bool surface::init()
+{
+   surface_queue.reset(wl_display_create_queue(wayland_display));
+   if (surface_queue.get() == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to create wl surface queue.");
       return false;
    }
 
-   const wl_registry_listener registry_listener = { surface_registry_handler, nullptr };
-   int res = wl_registry_add_listener(registry.get(), &registry_listener, this);
-   if (res < 0)
+   /* The cache avoids a registry round trip when another surface has already been created on the display. */
+   globals_cache = display_cache::acquire(wayland_display);
+   if (globals_cache == nullptr)
    {
-      WSI_LOG_ERROR("Failed to add registry listener.");
+      WSI_LOG_ERROR("Failed to get the globals of the Wayland display.");
       return false;
    }
 
-   res = wl_display_roundtrip_queue(wayland_display, surface_queue.get());
-   if (res < 0)
+   if (!globals_cache->bind_globals(surface_queue.get(), surface_registry_handler, this))
    {
-      WSI_LOG_ERROR("Roundtrip failed.");
       return false;
    }
 
    if (dmabuf_interface.get() == nullptr)
    {
-      WSI_LOG_ERROR("Failed to obtain zwp_linux_dma_buf_v1 interface.");
-      return false;
+      if (shm_interface.get() == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to obtain zwp_linux_dma_buf_v1 interface.");
+         return false;
+      }
+      WSI_LOG_INFO("zwp_linux_dmabuf_v1 is not available, images are presented through wl_shm.");
    }
 
    if (presentation_time_interface.get() == nullptr)
@@ -239,7 +702,33 @@ bool surface::init()
       //return false;
    }
 
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   /* Prefer timeline syncobjs, which carry the release fence as well. A surface must not use both protocols. */
+   if (syncobj_manager_interface.get() != nullptr)
+   {
+      drm_fd = open_render_node();
+      if (drm_fd.is_valid())
+      {
+         auto syncobj_surface_obj =
+            wp_linux_drm_syncobj_manager_v1_get_surface(syncobj_manager_interface.get(), wayland_surface);
+         if (syncobj_surface_obj == nullptr)
+         {
+            WSI_LOG_ERROR("Failed to retrieve surface syncobj interface");
+            return false;
+         }
+
+         syncobj_surface_interface.reset(syncobj_surface_obj);
+      }
+      else
+      {
+         WSI_LOG_WARNING("No DRM render node with timeline syncobj support, not using wp_linux_drm_syncobj_v1.");
+      }
+   }
+
+   if (explicit_sync_interface.get() != nullptr && syncobj_surface_interface.get() == nullptr)
+#else
    if (explicit_sync_interface.get() != nullptr)
+#endif
    {
       auto surface_sync_obj =
          zwp_linux_explicit_synchronization_v1_get_synchronization(explicit_sync_interface.get(), wayland_surface);
@@ -252,13 +741,80 @@ bool surface::init()
       surface_sync_interface.reset(surface_sync_obj);
    }
 
-   VkResult vk_res = get_supported_formats_and_modifiers(wayland_display, surface_queue.get(), dmabuf_interface.get(),
-                                                         supported_formats);
-   if (vk_res != VK_SUCCESS)
+#if WAYLAND_FIFO_V1_ENABLED
+   if (fifo_manager_interface.get() != nullptr)
+   {
+      auto fifo_obj = wp_fifo_manager_v1_get_fifo(fifo_manager_interface.get(), wayland_surface);
+      if (fifo_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to retrieve surface fifo interface");
+         return false;
+      }
+
+      fifo_interface.reset(fifo_obj);
+   }
+#endif
+
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   if (tearing_control_manager_interface.get() != nullptr)
+   {
+      auto tearing_control_obj =
+         wp_tearing_control_manager_v1_get_tearing_control(tearing_control_manager_interface.get(), wayland_surface);
+      if (tearing_control_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to retrieve surface tearing control interface");
+         return false;
+      }
+
+      tearing_control_interface.reset(tearing_control_obj);
+   }
+#endif
+
+#if WAYLAND_COMMIT_TIMING_ENABLED
+   if (commit_timing_manager_interface.get() != nullptr)
+   {
+      auto commit_timer_obj =
+         wp_commit_timing_manager_v1_get_timer(commit_timing_manager_interface.get(), wayland_surface);
+      if (commit_timer_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to retrieve surface commit timer interface");
+         return false;
+      }
+
+      commit_timer_interface.reset(commit_timer_obj);
+   }
+#endif
+
+   if (use_shm())
+   {
+      /* Every compositor supports these formats with wl_shm. */
+      if (!supported_formats.try_push_back(drm_format_pair{ DRM_FORMAT_ARGB8888, DRM_FORMAT_MOD_LINEAR }) ||
+          !supported_formats.try_push_back(drm_format_pair{ DRM_FORMAT_XRGB8888, DRM_FORMAT_MOD_LINEAR }))
+      {
+         WSI_LOG_ERROR("Host got out of memory.");
+         return false;
+      }
+   }
+   else if (!init_dmabuf_formats())
    {
       return false;
    }
 
+#if WAYLAND_EVENT_THREAD_ENABLED
+   /* Once initialized only frame done and dmabuf feedback events are delivered to the surface queue. Without the
+    * event thread the frame waits dispatch the queue themselves. */
+   dispatch_thread = event_thread::acquire(wayland_display);
+   if (dispatch_thread != nullptr && !dispatch_thread->add_queue(surface_queue.get()))
+   {
+      event_thread::release(dispatch_thread);
+      dispatch_thread = nullptr;
+   }
+   if (dispatch_thread == nullptr)
+   {
+      WSI_LOG_WARNING("Failed to start the Wayland event thread, events are dispatched on the calling threads.");
+   }
+#endif
+
    return true;
 }
 
@@ -278,6 +834,47 @@ util::unique_ptr<surface> surface::make_surface(const util::allocator &allocator
 
 surface::~surface()
 {
+#if WAYLAND_EVENT_THREAD_ENABLED
+   if (dispatch_thread != nullptr)
+   {
+      dispatch_thread->remove_queue(surface_queue.get());
+      event_thread::release(dispatch_thread);
+   }
+#endif
+   display_cache::release(globals_cache);
+}
+
+bool surface::is_scanout_format(const drm_format_pair &format)
+{
+#if WAYLAND_DMABUF_FEEDBACK_ENABLED
+   std::lock_guard<std::mutex> lock(feedback_state.lock);
+   for (const auto &scanout_format : feedback_state.scanout_formats)
+   {
+      if (scanout_format.fourcc == format.fourcc && scanout_format.modifier == format.modifier)
+      {
+         return true;
+      }
+   }
+#else
+   UNUSED(format);
+#endif
+   return false;
+}
+
+wp_viewport *surface::get_or_create_viewport()
+{
+   if (viewport_interface.get() == nullptr && viewporter_interface.get() != nullptr)
+   {
+      auto viewport_obj = wp_viewporter_get_viewport(viewporter_interface.get(), wayland_surface);
+      if (viewport_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to retrieve surface viewport interface");
+         return nullptr;
+      }
+
+      viewport_interface.reset(viewport_obj);
+   }
+   return viewport_interface.get();
 }
 
 wsi::surface_properties &surface::get_properties()
@@ -297,10 +894,12 @@ static void frame_done(void *data, wl_callback *cb, uint32_t time)
    UNUSED(time);
    UNUSED(cb);
 
-   bool *present_pending = reinterpret_cast<bool *>(data);
-   assert(present_pending);
+   auto state = reinterpret_cast<frame_event_state *>(data);
+   assert(state);
 
-   *present_pending = false;
+   std::lock_guard<std::mutex> lock(state->lock);
+   state->present_pending = false;
+   state->cond.notify_all();
 }
 
 bool surface::set_frame_callback()
@@ -313,6 +912,15 @@ bool surface::set_frame_callback()
       return false;
    }
 
+#if WAYLAND_EVENT_THREAD_ENABLED
+   /* Keep the event thread from running the handler of the callback object being destroyed. */
+   std::unique_lock<std::mutex> dispatch_lock;
+   if (dispatch_thread != nullptr)
+   {
+      dispatch_lock = std::unique_lock<std::mutex>(dispatch_thread->get_dispatch_lock());
+   }
+#endif
+
    /* Reset will also destroy the previous callback object. */
    last_frame_callback.reset(wl_surface_frame(surface_proxy.get()));
    if (last_frame_callback.get() == nullptr)
@@ -322,8 +930,11 @@ bool surface::set_frame_callback()
    }
 
    static const wl_callback_listener frame_listener = { frame_done };
-   present_pending = true;
-   int res = wl_callback_add_listener(last_frame_callback.get(), &frame_listener, &present_pending);
+   {
+      std::lock_guard<std::mutex> lock(frame_state.lock);
+      frame_state.present_pending = true;
+   }
+   int res = wl_callback_add_listener(last_frame_callback.get(), &frame_listener, &frame_state);
    if (res < 0)
    {
       WSI_LOG_ERROR("Failed to add frame done callback listener.");
@@ -333,17 +944,111 @@ bool surface::set_frame_callback()
    return true;
 }
 
+static void visibility_frame_done(void *data, wl_callback *cb, uint32_t time)
+{
+   UNUSED(time);
+   UNUSED(cb);
+
+   auto state = reinterpret_cast<frame_event_state *>(data);
+   assert(state);
+
+   std::lock_guard<std::mutex> lock(state->lock);
+   state->visibility_pending = false;
+}
+
+bool surface::request_visibility_check()
+{
+   {
+      std::lock_guard<std::mutex> lock(frame_state.lock);
+      if (frame_state.visibility_pending)
+      {
+         return true;
+      }
+   }
+
+   auto surface_proxy = make_proxy_with_queue(wayland_surface, surface_queue.get());
+   if (surface_proxy == nullptr)
+   {
+      WSI_LOG_ERROR("failed to create wl_surface proxy");
+      return false;
+   }
+
+#if WAYLAND_EVENT_THREAD_ENABLED
+   std::unique_lock<std::mutex> dispatch_lock;
+   if (dispatch_thread != nullptr)
+   {
+      dispatch_lock = std::unique_lock<std::mutex>(dispatch_thread->get_dispatch_lock());
+   }
+#endif
+
+   visibility_callback.reset(wl_surface_frame(surface_proxy.get()));
+   if (visibility_callback.get() == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to create frame callback.");
+      return false;
+   }
+
+   static const wl_callback_listener visibility_listener = { visibility_frame_done };
+   {
+      std::lock_guard<std::mutex> lock(frame_state.lock);
+      frame_state.visibility_pending = true;
+      frame_state.visibility_request_time = std::chrono::steady_clock::now();
+   }
+   if (wl_callback_add_listener(visibility_callback.get(), &visibility_listener, &frame_state) < 0)
+   {
+      WSI_LOG_ERROR("Failed to add frame done callback listener.");
+      return false;
+   }
+
+   return true;
+}
+
+/*
+ * If the compositor isn't sending us frame events at least every second we don't
+ * wait for them indefinitely, so we don't block the next image presentation if we
+ * are, e.g. minimised. The surface is then considered hidden.
+ */
+static constexpr int FRAME_EVENT_TIMEOUT_MS = 1000;
+
+bool surface::is_occluded()
+{
+#if WAYLAND_EVENT_THREAD_ENABLED
+   if (dispatch_thread == nullptr || !dispatch_thread->is_running())
+#endif
+   {
+      /* Pick up a frame event that has already been received. */
+      dispatch_queue(wayland_display, surface_queue.get(), 0);
+   }
+
+   std::lock_guard<std::mutex> lock(frame_state.lock);
+   return frame_state.visibility_pending && std::chrono::steady_clock::now() - frame_state.visibility_request_time >=
+                                               std::chrono::milliseconds(FRAME_EVENT_TIMEOUT_MS);
+}
+
 bool surface::wait_next_frame_event()
 {
    /*
     * In a previous present call we sent a wl_surface::frame request, which will
     * trigger an event when the compositor starts a redraw using the previous frame
-    * we sent. If the compositor isn't sending us frame events at least every second
-    * we don't wait indefinitely so we don't block the next image presentation if
-    * we are, e.g. minimised.
+    * we sent.
     */
-   const int timeout = 1000;
-   while (present_pending)
+   const int timeout = FRAME_EVENT_TIMEOUT_MS;
+
+#if WAYLAND_EVENT_THREAD_ENABLED
+   if (dispatch_thread != nullptr && dispatch_thread->is_running())
+   {
+      std::unique_lock<std::mutex> lock(frame_state.lock);
+      if (!frame_state.cond.wait_for(lock, std::chrono::milliseconds(timeout),
+                                     [this] { return !frame_state.present_pending; }))
+      {
+         WSI_LOG_INFO("Wait for frame event timed out, present anyway.");
+         frame_state.present_pending = false;
+      }
+      return true;
+   }
+#endif
+
+   while (frame_state.present_pending)
    {
       int res = dispatch_queue(wayland_display, surface_queue.get(), timeout);
       if (res < 0)
@@ -354,7 +1059,7 @@ bool surface::wait_next_frame_event()
       else if (res == 0)
       {
          WSI_LOG_INFO("Wait for frame event timed out, present anyway.");
-         present_pending = false;
+         frame_state.present_pending = false;
       }
    }
 
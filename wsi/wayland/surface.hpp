@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2021, 2024 Arm Limited.
+ * Copyright (c) 2021, 2024-2025 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -32,11 +32,19 @@
 #define __STDC_VERSION__ 0
 #endif
 #include <wayland-client.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 
 #include "wsi/surface.hpp"
 #include "surface_properties.hpp"
 #include "wl_object_owner.hpp"
+#include "event_thread.hpp"
+#include "display_cache.hpp"
 #include "util/macros.hpp"
+#include "util/file_descriptor.hpp"
 
 namespace wsi
 {
@@ -50,6 +58,79 @@ VWL_CAPI_CALL(void)
 surface_registry_handler(void *data, struct wl_registry *wl_registry, uint32_t name, const char *interface,
                          uint32_t version) VWL_API_POST;
 
+/**
+ * @brief State of the latest frame request, updated by its frame done handler.
+ */
+struct frame_event_state
+{
+   /**
+    * @brief true when waiting for the server hint to present a buffer
+    *
+    * true if a buffer has been presented and we've not had a wl_surface::frame
+    * callback to indicate the server is ready for the next buffer.
+    */
+   bool present_pending{ false };
+
+   /**
+    * @brief true while the frame event requested by the last visibility check has not arrived.
+    *
+    * The compositor withholds frame events while the surface is hidden.
+    */
+   bool visibility_pending{ false };
+
+   /** When the frame event of the last visibility check was requested. */
+   std::chrono::steady_clock::time_point visibility_request_time{};
+
+   /** Protects @ref present_pending and @ref visibility_pending, which the event thread may update. */
+   std::mutex lock;
+
+   /** Signalled when @ref present_pending is cleared. */
+   std::condition_variable cond;
+};
+
+#if WAYLAND_DMABUF_FEEDBACK_ENABLED
+/**
+ * @brief Formats received through the zwp_linux_dmabuf_feedback_v1 events of a surface.
+ *
+ * The tranches are collected while the events of a feedback arrive and applied together on its done event. The
+ * compositor sends new feedback when the preferred formats change, e.g. when the surface becomes a candidate for
+ * direct scanout.
+ */
+struct dmabuf_feedback_state
+{
+   dmabuf_feedback_state(const util::allocator &allocator);
+   ~dmabuf_feedback_state();
+
+   dmabuf_feedback_state(const dmabuf_feedback_state &) = delete;
+   dmabuf_feedback_state &operator=(const dmabuf_feedback_state &) = delete;
+
+   /** Mapping of the format table shared by the compositor. */
+   void *format_table{ nullptr };
+   /** Size of @ref format_table in bytes. */
+   size_t format_table_size{ 0 };
+
+   /** Formats of the tranche being received. */
+   util::vector<drm_format_pair> tranche_formats;
+   /** Flags of the tranche being received. */
+   uint32_t tranche_flags{ 0 };
+   /** Formats of all the tranches of the feedback being received. */
+   util::vector<drm_format_pair> pending_formats;
+   /** Formats of the scanout tranches of the feedback being received. */
+   util::vector<drm_format_pair> pending_scanout_formats;
+   /** Set if an allocation failed while receiving the feedback, which is then dropped. */
+   bool is_out_of_memory{ false };
+
+   /** Protects the members below, which are updated by the done event. */
+   std::mutex lock;
+   /** Formats of the latest feedback. */
+   util::vector<drm_format_pair> formats;
+   /** Formats the compositor can scan out directly according to the latest feedback. */
+   util::vector<drm_format_pair> scanout_formats;
+   /** Number of feedback done events received. */
+   uint32_t done_count{ 0 };
+};
+#endif
+
 class surface : public wsi::surface
 {
 public:
@@ -100,6 +181,26 @@ public:
       return dmabuf_interface.get();
    }
 
+   /**
+    * @brief Returns a pointer to the Wayland wl_shm interface.
+    *
+    * The raw pointer is valid throughout the lifetime of this surface.
+    */
+   wl_shm *get_shm_interface()
+   {
+      return shm_interface.get();
+   }
+
+   /**
+    * @brief Whether the compositor does not support zwp_linux_dmabuf_v1, so images are presented through wl_shm.
+    *
+    * The formats of the surface are then the ones every compositor supports with wl_shm.
+    */
+   bool use_shm() const
+   {
+      return dmabuf_interface.get() == nullptr;
+   }
+
    /**
     * @brief Returns a pointer to the Wayland zwp_linux_surface_synchronization_v1 interface obtained for the wayland
     *        surface.
@@ -111,6 +212,131 @@ public:
       return surface_sync_interface.get();
    }
 
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   /**
+    * @brief Returns a pointer to the Wayland wp_linux_drm_syncobj_surface_v1 interface obtained for the wayland
+    *        surface, or nullptr if the compositor does not support timeline syncobj explicit sync.
+    *
+    * When set, every commit attaching a buffer must also set an acquire and a release point, and
+    * @ref get_surface_sync_interface returns nullptr.
+    *
+    * The raw pointer is valid for the lifetime of the surface.
+    */
+   wp_linux_drm_syncobj_surface_v1 *get_syncobj_surface_interface()
+   {
+      return syncobj_surface_interface.get();
+   }
+
+   /**
+    * @brief Returns a pointer to the Wayland wp_linux_drm_syncobj_manager_v1 interface.
+    *
+    * The raw pointer is valid throughout the lifetime of this surface.
+    */
+   wp_linux_drm_syncobj_manager_v1 *get_syncobj_manager_interface()
+   {
+      return syncobj_manager_interface.get();
+   }
+
+   /**
+    * @brief Returns the DRM render node used to create the timeline syncobjs shared with the compositor.
+    *
+    * Only valid when @ref get_syncobj_surface_interface is not nullptr.
+    */
+   int get_drm_fd() const
+   {
+      return drm_fd.get();
+   }
+#endif
+
+#if WAYLAND_FIFO_V1_ENABLED
+   /**
+    * @brief Returns a pointer to the Wayland wp_fifo_v1 interface obtained for the wayland surface, or nullptr if the
+    *        compositor does not support it.
+    *
+    * The raw pointer is valid for the lifetime of the surface.
+    */
+   wp_fifo_v1 *get_fifo_interface()
+   {
+      return fifo_interface.get();
+   }
+#endif
+
+#if WAYLAND_COMMIT_TIMING_ENABLED
+   /**
+    * @brief Returns a pointer to the Wayland wp_commit_timer_v1 interface obtained for the wayland surface, or nullptr
+    *        if the compositor does not support it.
+    *
+    * The raw pointer is valid for the lifetime of the surface.
+    */
+   wp_commit_timer_v1 *get_commit_timer_interface()
+   {
+      return commit_timer_interface.get();
+   }
+#endif
+
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   /**
+    * @brief Returns a pointer to the Wayland wp_tearing_control_v1 interface obtained for the wayland surface, or
+    *        nullptr if the compositor does not support it.
+    *
+    * The raw pointer is valid for the lifetime of the surface.
+    */
+   wp_tearing_control_v1 *get_tearing_control_interface()
+   {
+      return tearing_control_interface.get();
+   }
+#endif
+
+   /**
+    * @brief Whether the compositor supports wp_viewporter.
+    */
+   bool supports_viewport() const
+   {
+      return viewporter_interface.get() != nullptr;
+   }
+
+   /**
+    * @brief Returns a pointer to the Wayland wp_viewport interface of the surface, or nullptr if no scaled swapchain
+    *        created it yet.
+    *
+    * The raw pointer is valid for the lifetime of the surface.
+    */
+   wp_viewport *get_viewport_interface()
+   {
+      return viewport_interface.get();
+   }
+
+   /**
+    * @brief Get the wp_viewport interface of the surface, creating it on first use.
+    *
+    * The viewport is only created for swapchains that ask for scaled presents, as a wl_surface can only have one and
+    * applications or toolkits using wp_viewporter themselves get a viewport_exists protocol error otherwise. Once
+    * created it lives as long as the surface, since destroying it also resets the viewport state of the surface.
+    * Must be called with the surface externally synchronized, as for swapchain creation.
+    *
+    * @return The viewport, or nullptr if the compositor does not support wp_viewporter or creating it failed.
+    */
+   wp_viewport *get_or_create_viewport();
+
+   /**
+    * @brief Returns a pointer to the Wayland wp_presentation interface, or nullptr if the compositor does not
+    *        support it.
+    *
+    * The raw pointer is valid throughout the lifetime of this surface.
+    */
+   wp_presentation *get_presentation_time_interface()
+   {
+      return presentation_time_interface.get();
+   }
+
+   /**
+    * @brief Returns the clock the compositor reports wp_presentation_feedback timestamps in.
+    */
+   clockid_t get_presentation_clock_id() const
+   {
+      return presentation_clock_id.load();
+   }
+
    /**
     * @brief Returns a reference to a list of DRM formats supported by the Wayland surface.
     *
@@ -121,6 +347,25 @@ public:
       return supported_formats;
    }
 
+   /**
+    * @brief Check whether the compositor reported that it can scan out buffers with the given format directly.
+    *
+    * The answer follows the latest dmabuf feedback of the surface, so it may change while the surface is in use.
+    */
+   bool is_scanout_format(const drm_format_pair &format);
+
+#if WAYLAND_EVENT_THREAD_ENABLED
+   /**
+    * @brief Returns the thread dispatching the events of the surface's display, or nullptr if there is none.
+    *
+    * The raw pointer is valid for the lifetime of the surface.
+    */
+   event_thread *get_event_thread()
+   {
+      return dispatch_thread;
+   }
+#endif
+
    /**
     * @brief Set the next frame callback.
     *
@@ -138,6 +383,22 @@ public:
     */
    bool wait_next_frame_event();
 
+   /**
+    * @brief Request a frame event with the next wl_surface::commit, to tell whether the surface is hidden.
+    *
+    * Unlike @ref set_frame_callback, presents never wait for it. Does nothing while the frame event of the previous
+    * check is still pending.
+    *
+    * @return true for success, false otherwise.
+    */
+   bool request_visibility_check();
+
+   /**
+    * @brief Whether the compositor has withheld the frame event of the last visibility check for so long that the
+    *        surface is most likely hidden, e.g. minimized or on another workspace.
+    */
+   bool is_occluded();
+
 private:
    /**
     * @brief Initialize the WSI surface by creating Wayland queues and linking to Wayland protocols.
@@ -146,6 +407,13 @@ private:
     */
    bool init();
 
+   /**
+    * @brief Get the formats and modifiers the compositor supports through zwp_linux_dmabuf_v1.
+    *
+    * @return true on success, false otherwise.
+    */
+   bool init_dmabuf_formats();
+
    friend void surface_registry_handler(void *data, struct wl_registry *wl_registry, uint32_t name,
                                         const char *interface, uint32_t version) VWL_API_POST;
 
@@ -169,13 +437,60 @@ private:
    /** Container for the zwp_linux_dmabuf_v1 interface binding */
    wayland_owner<zwp_linux_dmabuf_v1> dmabuf_interface;
 
+   /** Container for the wl_shm interface binding */
+   wayland_owner<wl_shm> shm_interface;
+
+#if WAYLAND_DMABUF_FEEDBACK_ENABLED
+   /** Formats received through @ref dmabuf_feedback. It must outlive the feedback object. */
+   dmabuf_feedback_state feedback_state;
+   /** Container for the surface's zwp_linux_dmabuf_feedback_v1, kept to receive feedback updates. */
+   wayland_owner<zwp_linux_dmabuf_feedback_v1> dmabuf_feedback;
+#endif
+
    /** Container for the zwp_linux_explicit_synchronization_v1 interface binding */
    wayland_owner<zwp_linux_explicit_synchronization_v1> explicit_sync_interface;
    /** Container for the surface specific zwp_linux_surface_synchronization_v1 interface. */
    wayland_owner<zwp_linux_surface_synchronization_v1> surface_sync_interface;
 
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   /** Container for the wp_linux_drm_syncobj_manager_v1 interface binding */
+   wayland_owner<wp_linux_drm_syncobj_manager_v1> syncobj_manager_interface;
+   /** Container for the surface specific wp_linux_drm_syncobj_surface_v1 interface. */
+   wayland_owner<wp_linux_drm_syncobj_surface_v1> syncobj_surface_interface;
+   /** DRM render node the timeline syncobjs are created on. */
+   util::fd_owner drm_fd;
+#endif
+
+#if WAYLAND_FIFO_V1_ENABLED
+   /** Container for the wp_fifo_manager_v1 interface binding */
+   wayland_owner<wp_fifo_manager_v1> fifo_manager_interface;
+   /** Container for the surface specific wp_fifo_v1 interface. */
+   wayland_owner<wp_fifo_v1> fifo_interface;
+#endif
+
+#if WAYLAND_COMMIT_TIMING_ENABLED
+   /** Container for the wp_commit_timing_manager_v1 interface binding */
+   wayland_owner<wp_commit_timing_manager_v1> commit_timing_manager_interface;
+   /** Container for the surface specific wp_commit_timer_v1 interface. */
+   wayland_owner<wp_commit_timer_v1> commit_timer_interface;
+#endif
+
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   /** Container for the wp_tearing_control_manager_v1 interface binding */
+   wayland_owner<wp_tearing_control_manager_v1> tearing_control_manager_interface;
+   /** Container for the surface specific wp_tearing_control_v1 interface. */
+   wayland_owner<wp_tearing_control_v1> tearing_control_interface;
+#endif
+
+   /** Container for the wp_viewporter interface binding */
+   wayland_owner<wp_viewporter> viewporter_interface;
+   /** Container for the surface specific wp_viewport interface, created by the first scaled swapchain. */
+   wayland_owner<wp_viewport> viewport_interface;
+
    /** Container for the wp_presentation interface binding */
    wayland_owner<wp_presentation> presentation_time_interface;
+   /** Clock announced by the wp_presentation clock_id event. */
+   std::atomic<clockid_t> presentation_clock_id;
 
    /**
     * Container for a callback object for the latest frame done event.
@@ -187,13 +502,19 @@ private:
     */
    wayland_owner<wl_callback> last_frame_callback;
 
-   /**
-    * @brief true when waiting for the server hint to present a buffer
-    *
-    * true if a buffer has been presented and we've not had a wl_surface::frame
-    * callback to indicate the server is ready for the next buffer.
-    */
-   bool present_pending;
+   /** Container for the callback object of the last visibility check, destroyed before the queue likewise. */
+   wayland_owner<wl_callback> visibility_callback;
+
+   /** State of the latest frame request. */
+   frame_event_state frame_state;
+
+   /** Globals and formats shared with the other surfaces of the display. */
+   display_cache *globals_cache;
+
+#if WAYLAND_EVENT_THREAD_ENABLED
+   /** Thread dispatching the surface queue once the surface is initialized, nullptr if it could not be started. */
+   event_thread *dispatch_thread;
+#endif
 };
 
 } // namespace wayland
@@ -45,6 +45,7 @@
 #include "util/log.hpp"
 #include "util/macros.hpp"
 #include "util/helpers.hpp"
+#include "util/proc_addr_table.hpp"
 
 namespace wsi
 {
@@ -53,17 +54,51 @@ namespace wayland
 
 void surface_properties::populate_present_mode_compatibilities()
 {
-   std::array<present_mode_compatibility, 2> compatible_present_modes_list = {
-      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_KHR, 1, { VK_PRESENT_MODE_FIFO_KHR } },
-      present_mode_compatibility{ VK_PRESENT_MODE_MAILBOX_KHR, 1, { VK_PRESENT_MODE_MAILBOX_KHR } }
+   std::array<present_mode_compatibility, NUM_PRESENT_MODES> compatible_present_modes_list = {
+#if WAYLAND_TEARING_CONTROL_ENABLED
+      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_KHR,
+                                  4,
+                                  { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+                                    VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR } },
+      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+                                  4,
+                                  { VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR,
+                                    VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR } },
+      present_mode_compatibility{ VK_PRESENT_MODE_MAILBOX_KHR,
+                                  4,
+                                  { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR,
+                                    VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR } },
+      present_mode_compatibility{ VK_PRESENT_MODE_IMMEDIATE_KHR,
+                                  4,
+                                  { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR,
+                                    VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR } },
+#else
+      present_mode_compatibility{
+         VK_PRESENT_MODE_FIFO_KHR,
+         3,
+         { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR } },
+      present_mode_compatibility{
+         VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+         3,
+         { VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR } },
+      present_mode_compatibility{
+         VK_PRESENT_MODE_MAILBOX_KHR,
+         3,
+         { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR } },
+#endif
    };
-   m_compatible_present_modes = compatible_present_modes<2>(compatible_present_modes_list);
+   m_compatible_present_modes = compatible_present_modes<NUM_PRESENT_MODES>(compatible_present_modes_list);
 }
 
 surface_properties::surface_properties(surface *wsi_surface, const util::allocator &allocator)
    : specific_surface(wsi_surface)
    , supported_formats(allocator)
-   , m_supported_modes({ VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR })
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   , m_supported_modes({ VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+                         VK_PRESENT_MODE_IMMEDIATE_KHR })
+#else
+   , m_supported_modes({ VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR })
+#endif
 {
    populate_present_mode_compatibilities();
 }
@@ -79,6 +114,15 @@ surface_properties &surface_properties::get_instance()
    return instance;
 }
 
+bool surface_properties::supports_tearing() const
+{
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   return specific_surface != nullptr && specific_surface->get_tearing_control_interface() != nullptr;
+#else
+   return false;
+#endif
+}
+
 VkResult surface_properties::get_surface_capabilities(VkPhysicalDevice physical_device,
                                                       VkSurfaceCapabilitiesKHR *pSurfaceCapabilities)
 {
@@ -98,11 +142,29 @@ VkResult surface_properties::get_surface_capabilities(VkPhysicalDevice physical_
                                                       VkSurfaceCapabilities2KHR *pSurfaceCapabilities)
 {
    TRY(check_surface_present_mode_query_is_supported(pSurfaceInfo, m_supported_modes));
+   auto surface_present_mode =
+      util::find_extension<VkSurfacePresentModeEXT>(VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_EXT, pSurfaceInfo);
+   if (surface_present_mode != nullptr && surface_present_mode->presentMode == VK_PRESENT_MODE_IMMEDIATE_KHR &&
+       !supports_tearing())
+   {
+      WSI_LOG_ERROR("Querying surface capability support for a present mode that is not supported by the surface");
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
 
    /* Image count limits */
    get_surface_capabilities(physical_device, &pSurfaceCapabilities->surfaceCapabilities);
 
    m_compatible_present_modes.get_surface_present_mode_compatibility_common(pSurfaceInfo, pSurfaceCapabilities);
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   auto surface_present_mode_compatibility = util::find_extension<VkSurfacePresentModeCompatibilityEXT>(
+      VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_COMPATIBILITY_EXT, pSurfaceCapabilities);
+   if (surface_present_mode_compatibility != nullptr && !supports_tearing())
+   {
+      /* VK_PRESENT_MODE_IMMEDIATE_KHR is listed last, so leaving it out only shortens the list. */
+      surface_present_mode_compatibility->presentModeCount = std::min<uint32_t>(
+         surface_present_mode_compatibility->presentModeCount, NUM_PRESENT_MODES - 1);
+   }
+#endif
 
    auto surface_scaling_capabilities = util::find_extension<VkSurfacePresentScalingCapabilitiesEXT>(
       VK_STRUCTURE_TYPE_SURFACE_PRESENT_SCALING_CAPABILITIES_EXT, pSurfaceCapabilities);
@@ -147,11 +209,33 @@ static VkResult surface_format_properties_add_modifier_support(VkPhysicalDevice
    return format_props.check_device_support(phys_dev, image_info);
 }
 
+/**
+ * @brief Check whether the device can render to linear images of a format bound to host memory, as shared with wl_shm.
+ */
+static VkResult surface_format_properties_add_host_memory_support(VkPhysicalDevice phys_dev,
+                                                                  surface_format_properties &format_props)
+{
+   VkPhysicalDeviceExternalImageFormatInfoKHR external_info = {};
+   external_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO_KHR;
+   external_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+   VkPhysicalDeviceImageFormatInfo2KHR image_info = {};
+   image_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2_KHR;
+   image_info.pNext = &external_info;
+   image_info.format = format_props.m_surface_format.format;
+   image_info.type = VK_IMAGE_TYPE_2D;
+   image_info.tiling = VK_IMAGE_TILING_LINEAR;
+   image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+   return format_props.check_device_support(phys_dev, image_info);
+}
+
 static VkResult surface_format_properties_map_add(VkPhysicalDevice phys_dev, surface_format_properties_map &format_map,
-                                                  VkFormat format, const drm_format_pair &drm_format)
+                                                  VkFormat format, const drm_format_pair &drm_format, bool use_shm)
 {
    surface_format_properties format_props{ format };
-   VkResult res = surface_format_properties_add_modifier_support(phys_dev, format_props, drm_format);
+   VkResult res = use_shm ? surface_format_properties_add_host_memory_support(phys_dev, format_props) :
+                            surface_format_properties_add_modifier_support(phys_dev, format_props, drm_format);
    if (res == VK_SUCCESS)
    {
       auto it = format_map.try_insert(std::make_pair(format, format_props));
@@ -170,19 +254,20 @@ static VkResult surface_format_properties_map_add(VkPhysicalDevice phys_dev, sur
 }
 
 static VkResult surface_format_properties_map_init(VkPhysicalDevice phys_dev, surface_format_properties_map &format_map,
-                                                   const util::vector<drm_format_pair> &drm_format_list)
+                                                   const util::vector<drm_format_pair> &drm_format_list, bool use_shm)
 {
    for (const auto &drm_format : drm_format_list)
    {
       const VkFormat vk_format = util::drm::drm_to_vk_format(drm_format.fourcc);
       if (vk_format != VK_FORMAT_UNDEFINED && format_map.find(vk_format) == format_map.end())
       {
-         TRY_LOG_CALL(surface_format_properties_map_add(phys_dev, format_map, vk_format, drm_format));
+         TRY_LOG_CALL(surface_format_properties_map_add(phys_dev, format_map, vk_format, drm_format, use_shm));
       }
       const VkFormat srgb_vk_format = util::drm::drm_to_vk_srgb_format(drm_format.fourcc);
       if (srgb_vk_format != VK_FORMAT_UNDEFINED && format_map.find(srgb_vk_format) == format_map.end())
       {
-         TRY_LOG_CALL(surface_format_properties_map_add(phys_dev, format_map, srgb_vk_format, drm_format));
+         TRY_LOG_CALL(
+            surface_format_properties_map_add(phys_dev, format_map, srgb_vk_format, drm_format, use_shm));
       }
    }
 
@@ -224,9 +309,10 @@ VkResult surface_properties::get_surface_formats(VkPhysicalDevice physical_devic
    assert(specific_surface);
    if (!supported_formats.size())
    {
-      TRY_LOG_CALL(
-         surface_format_properties_map_init(physical_device, supported_formats, specific_surface->get_formats()));
-      if (layer::instance_private_data::get(physical_device).has_image_compression_support(physical_device))
+      const bool use_shm = specific_surface->use_shm();
+      TRY_LOG_CALL(surface_format_properties_map_init(physical_device, supported_formats,
+                                                      specific_surface->get_formats(), use_shm));
+      if (!use_shm && layer::instance_private_data::get(physical_device).has_image_compression_support(physical_device))
       {
          TRY_LOG_CALL(surface_format_properties_map_add_compression(physical_device, supported_formats,
                                                                     specific_surface->get_formats()));
@@ -243,6 +329,17 @@ VkResult surface_properties::get_surface_present_modes(VkPhysicalDevice physical
    UNUSED(physical_device);
    UNUSED(surface);
 
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   /* Leave VK_PRESENT_MODE_IMMEDIATE_KHR out if the compositor would not let the surface tear. */
+   if (!supports_tearing())
+   {
+      const std::array<VkPresentModeKHR, NUM_PRESENT_MODES - 1> modes = {
+         VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR
+      };
+      return get_surface_present_modes_common(pPresentModeCount, pPresentModes, modes);
+   }
+#endif
+
    return get_surface_present_modes_common(pPresentModeCount, pPresentModes, m_supported_modes);
 }
 
@@ -264,6 +361,12 @@ VkResult surface_properties::get_required_device_extensions(util::extension_list
    return extension_list.add(required_device_extensions.data(), required_device_extensions.size());
 }
 
+VkResult surface_properties::get_optional_device_extensions(util::extension_list &extension_list)
+{
+   /* Imports the shared memory of the images presented with wl_shm. */
+   return extension_list.add(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+}
+
 VkResult surface_properties::get_required_instance_extensions(util::extension_list &extension_list)
 {
    const std::array required_instance_extensions{
@@ -388,15 +491,15 @@ CreateWaylandSurfaceKHR(VkInstance instance, const VkWaylandSurfaceCreateInfoKHR
 
 PFN_vkVoidFunction surface_properties::get_proc_addr(const char *name)
 {
-   if (strcmp(name, "vkGetPhysicalDeviceWaylandPresentationSupportKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(GetPhysicalDeviceWaylandPresentationSupportKHR);
-   }
-   else if (strcmp(name, "vkCreateWaylandSurfaceKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(CreateWaylandSurfaceKHR);
-   }
-   return nullptr;
+   /* Sorted by name. */
+   static constexpr util::proc_addr_entry entrypoints[] = {
+      PROC_ADDR_ENTRY(CreateWaylandSurfaceKHR),
+      PROC_ADDR_ENTRY(GetPhysicalDeviceWaylandPresentationSupportKHR),
+   };
+   static_assert(util::is_sorted_by_name(entrypoints), "Entrypoints must be sorted by name");
+
+   const util::proc_addr_entry *entry = util::find_proc_addr(entrypoints, name);
+   return entry != nullptr ? entry->get_fn() : nullptr;
 }
 
 bool surface_properties::is_surface_extension_enabled(const layer::instance_private_data &instance_data)
@@ -408,12 +511,25 @@ void surface_properties::get_surface_present_scaling_and_gravity(
    VkSurfacePresentScalingCapabilitiesEXT *scaling_capabilities)
 {
    scaling_capabilities->supportedPresentScaling = VK_PRESENT_SCALING_ONE_TO_ONE_BIT_EXT;
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   /* wp_viewporter stretches the buffer to the destination size, there is no way to letterbox it. The size comes from
+    * VkSwapchainScaledExtentCreateInfoARM, so stretching is only available in builds that declare it. */
+   if (specific_surface != nullptr && specific_surface->supports_viewport())
+   {
+      scaling_capabilities->supportedPresentScaling |= VK_PRESENT_SCALING_STRETCH_BIT_EXT;
+   }
+#endif
    scaling_capabilities->supportedPresentGravityX = VK_PRESENT_GRAVITY_MIN_BIT_EXT;
    scaling_capabilities->supportedPresentGravityY = VK_PRESENT_GRAVITY_MIN_BIT_EXT;
 }
 
 bool surface_properties::is_compatible_present_modes(VkPresentModeKHR present_mode_a, VkPresentModeKHR present_mode_b)
 {
+   if ((present_mode_a == VK_PRESENT_MODE_IMMEDIATE_KHR || present_mode_b == VK_PRESENT_MODE_IMMEDIATE_KHR) &&
+       !supports_tearing())
+   {
+      return false;
+   }
    return m_compatible_present_modes.is_compatible_present_modes(present_mode_a, present_mode_b);
 }
 
@@ -426,6 +542,18 @@ void surface_properties::get_present_timing_surface_caps(
    present_timing_surface_caps->presentAtRelativeTimeSupported = VK_FALSE;
    present_timing_surface_caps->presentStageQueries = VK_PRESENT_STAGE_QUEUE_OPERATIONS_END_BIT_EXT;
    present_timing_surface_caps->presentStageTargets = 0;
+   if (specific_surface != nullptr && specific_surface->get_presentation_time_interface() != nullptr)
+   {
+      present_timing_surface_caps->presentStageQueries |= VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_VISIBLE_BIT_EXT;
+#if WAYLAND_COMMIT_TIMING_ENABLED
+      /* Target times are passed to wp_commit_timer_v1 in the wp_presentation clock. */
+      if (specific_surface->get_commit_timer_interface() != nullptr)
+      {
+         present_timing_surface_caps->presentAtAbsoluteTimeSupported = VK_TRUE;
+         present_timing_surface_caps->presentStageTargets = VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_VISIBLE_BIT_EXT;
+      }
+#endif
+   }
 }
 #endif
 
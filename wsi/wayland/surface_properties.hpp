@@ -66,6 +66,8 @@ public:
 
    VkResult get_required_device_extensions(util::extension_list &extension_list) override;
 
+   VkResult get_optional_device_extensions(util::extension_list &extension_list) override;
+
    VkResult get_required_instance_extensions(util::extension_list &extension_list) override;
 
    PFN_vkVoidFunction get_proc_addr(const char *name) override;
@@ -87,11 +89,23 @@ private:
    /** Set of supported Vulkan formats by the @ref specific_surface. */
    surface_format_properties_map supported_formats;
 
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   /* Number of presentation modes; VK_PRESENT_MODE_IMMEDIATE_KHR needs wp_tearing_control_v1 from the compositor. */
+   static constexpr std::size_t NUM_PRESENT_MODES = 4;
+#else
+   static constexpr std::size_t NUM_PRESENT_MODES = 3;
+#endif
+
    /* List of supported presentation modes */
-   std::array<VkPresentModeKHR, 2> m_supported_modes;
+   std::array<VkPresentModeKHR, NUM_PRESENT_MODES> m_supported_modes;
 
    /* Stores compatible presentation modes */
-   compatible_present_modes<2> m_compatible_present_modes;
+   compatible_present_modes<NUM_PRESENT_MODES> m_compatible_present_modes;
+
+   /**
+    * @brief Whether the compositor lets @ref specific_surface tear, which VK_PRESENT_MODE_IMMEDIATE_KHR requires.
+    */
+   bool supports_tearing() const;
 
    void populate_present_mode_compatibilities() override;
 
@@ -33,7 +33,9 @@
 #include <cerrno>
 #include <cstdio>
 #include <climits>
+#include <ctime>
 #include <functional>
+#include <algorithm>
 
 #include "swapchain.hpp"
 #include "util/drm/drm_utils.hpp"
@@ -41,6 +43,7 @@
 #include "util/helpers.hpp"
 #include "util/log.hpp"
 #include "util/macros.hpp"
+#include "util/trace.hpp"
 #include "wl_helpers.hpp"
 
 #include <wsi/extensions/image_compression_control.hpp>
@@ -49,6 +52,12 @@
 
 #include "present_timing_handler.hpp"
 
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <xf86drm.h>
+#endif
+
 namespace wsi
 {
 namespace wayland
@@ -61,20 +70,58 @@ swapchain::swapchain(layer::device_private_data &dev_data, const VkAllocationCal
    , m_surface(wsi_surface.get_wl_surface())
    , m_wsi_surface(&wsi_surface)
    , m_buffer_queue(nullptr)
+#if WAYLAND_EVENT_THREAD_ENABLED
+   , m_event_thread(nullptr)
+#endif
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   , m_syncobj_surface(nullptr)
+   , m_drm_fd(-1)
+   , m_acquire_timeline()
+   , m_release_timeline()
+   , m_transfer_syncobj(0)
+   , m_release_syncobj(0)
+   , m_timeline_point(0)
+   , m_pending_release_count(0)
+#endif
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   , m_tearing_hint_async(false)
+#endif
    , m_wsi_allocator(nullptr)
+   , m_batch_allocations(m_allocator)
    , m_image_creation_parameters({}, m_allocator, {}, {})
+   , m_prime_copy(nullptr)
+   , m_shm(false)
 {
    m_image_create_info.format = VK_FORMAT_UNDEFINED;
 }
 
 swapchain::~swapchain()
 {
-   teardown();
+   /* Teardown unlinks the descendant, which may reuse the buffers this swapchain gives back to the wsialloc cache. */
+   const bool replaced = m_descendant != VK_NULL_HANDLE;
 
-   if (m_wsi_allocator != nullptr)
+#if WAYLAND_EVENT_THREAD_ENABLED
+   /* Teardown destroys the buffers and dispatches the queue itself while waiting for the compositor to release them. */
+   if (m_event_thread != nullptr)
    {
-      wsialloc_delete(m_wsi_allocator);
+      m_event_thread->remove_queue(m_buffer_queue);
+      m_event_thread = nullptr;
    }
+#endif
+
+   teardown();
+
+   /* Teardown waited for the presents, which include the copies into the linear buffers. */
+   m_prime_copy.reset();
+
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   destroy_drm_syncobj();
+#endif
+
+   /* Close the buffers of a batch that were not used, which only happens when creating the swapchain failed. */
+   m_batch_allocations.release_unused();
+
+   release_shared_wsialloc_allocator(m_device_data, m_wsi_allocator, replaced);
    m_wsi_allocator = nullptr;
    if (m_buffer_queue != nullptr)
    {
@@ -84,7 +131,7 @@ swapchain::~swapchain()
 
 VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info)
 {
-   auto compression_control = wsi_ext_image_compression_control::create(device, swapchain_create_info);
+   auto compression_control = wsi_ext_image_compression_control::create(device, swapchain_create_info, true);
    if (compression_control)
    {
       if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_image_compression_control>(*compression_control)))
@@ -111,7 +158,7 @@ VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCr
 
    if (m_device_data.should_layer_handle_frame_boundary_events())
    {
-      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_frame_boundary>(m_device_data)))
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_frame_boundary>()))
       {
          return VK_ERROR_OUT_OF_HOST_MEMORY;
       }
@@ -121,7 +168,9 @@ VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCr
    bool swapchain_support_enabled = swapchain_create_info->flags & VK_SWAPCHAIN_CREATE_PRESENT_TIMING_BIT_EXT;
    if (swapchain_support_enabled)
    {
-      if (!add_swapchain_extension(wsi_ext_present_timing_wayland::create(m_allocator)))
+      if (!add_swapchain_extension(wsi_ext_present_timing_wayland::create(
+             m_allocator, m_display, m_wsi_surface->get_presentation_time_interface(),
+             m_wsi_surface->get_presentation_clock_id())))
       {
          return VK_ERROR_OUT_OF_HOST_MEMORY;
       }
@@ -131,14 +180,357 @@ VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCr
    return VK_SUCCESS;
 }
 
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+/**
+ * @brief Create a DRM timeline syncobj and import it into the compositor.
+ */
+static VkResult create_timeline_syncobj(wp_linux_drm_syncobj_manager_v1 *manager, int drm_fd,
+                                        wayland_timeline_syncobj &timeline)
+{
+   if (drmSyncobjCreate(drm_fd, 0, &timeline.handle) != 0)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   int fd = -1;
+   if (drmSyncobjHandleToFD(drm_fd, timeline.handle, &fd) != 0)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   /* The file descriptor is duplicated when the request is marshalled. */
+   util::fd_owner syncobj_fd{ fd };
+   timeline.timeline.reset(wp_linux_drm_syncobj_manager_v1_import_timeline(manager, syncobj_fd.get()));
+   if (timeline.timeline == nullptr)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::init_drm_syncobj()
+{
+   m_drm_fd = m_wsi_surface->get_drm_fd();
+   if (drmSyncobjCreate(m_drm_fd, 0, &m_transfer_syncobj) != 0 ||
+       drmSyncobjCreate(m_drm_fd, 0, &m_release_syncobj) != 0)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   m_release_eventfd = util::fd_owner{ eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK) };
+   if (!m_release_eventfd.is_valid())
+   {
+      WSI_LOG_ERROR("Failed to create the release point event.");
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   auto manager = m_wsi_surface->get_syncobj_manager_interface();
+   TRY_LOG(create_timeline_syncobj(manager, m_drm_fd, m_acquire_timeline), "Failed to create acquire timeline.");
+   TRY_LOG(create_timeline_syncobj(manager, m_drm_fd, m_release_timeline), "Failed to create release timeline.");
+
+   m_syncobj_surface = m_wsi_surface->get_syncobj_surface_interface();
+   return VK_SUCCESS;
+}
+
+void swapchain::destroy_drm_syncobj()
+{
+   for (auto *timeline : { &m_acquire_timeline, &m_release_timeline })
+   {
+      timeline->timeline.reset();
+      if (timeline->handle != 0)
+      {
+         drmSyncobjDestroy(m_drm_fd, timeline->handle);
+         timeline->handle = 0;
+      }
+   }
+
+   for (auto *syncobj : { &m_transfer_syncobj, &m_release_syncobj })
+   {
+      if (*syncobj != 0)
+      {
+         drmSyncobjDestroy(m_drm_fd, *syncobj);
+         *syncobj = 0;
+      }
+   }
+   m_syncobj_surface = nullptr;
+}
+
+VkResult swapchain::set_syncobj_points(wayland_image_data *image_data)
+{
+   uint64_t point = m_timeline_point + 1;
+   /* A syncobj backed fence moves its payload to the point directly, without exporting it to a sync FD. */
+   if (!image_data->present_fence.transfer_payload(m_acquire_timeline.handle, point))
+   {
+      auto sync_fd = image_data->present_fence.export_sync_fd();
+      if (!sync_fd.has_value())
+      {
+         WSI_LOG_ERROR("Failed to export present fence.");
+         return VK_ERROR_SURFACE_LOST_KHR;
+      }
+
+      int ret = -1;
+      if (sync_fd->is_valid())
+      {
+         /* Syncobj timelines cannot import a sync FD to a point directly, so go through a binary syncobj. */
+         ret = drmSyncobjImportSyncFile(m_drm_fd, m_transfer_syncobj, sync_fd->get());
+         if (ret == 0)
+         {
+            ret = drmSyncobjTransfer(m_drm_fd, m_acquire_timeline.handle, point, m_transfer_syncobj, 0, 0);
+         }
+
+         if (ret != 0)
+         {
+            /* Wait for the payload on the CPU instead and signal the point from the host. */
+            TRY(wait_sync_fd(sync_fd->get(), UINT64_MAX));
+         }
+      }
+
+      if (ret != 0 && drmSyncobjTimelineSignal(m_drm_fd, &m_acquire_timeline.handle, &point, 1) != 0)
+      {
+         return VK_ERROR_SURFACE_LOST_KHR;
+      }
+   }
+
+   /* The release point is only signalled by the compositor, so the same value can be used on both timelines. */
+   auto point_hi = static_cast<uint32_t>(point >> 32);
+   auto point_lo = static_cast<uint32_t>(point & 0xffffffff);
+   wp_linux_drm_syncobj_surface_v1_set_acquire_point(m_syncobj_surface, m_acquire_timeline.timeline.get(), point_hi,
+                                                     point_lo);
+   wp_linux_drm_syncobj_surface_v1_set_release_point(m_syncobj_surface, m_release_timeline.timeline.get(), point_hi,
+                                                     point_lo);
+
+   image_data->release_point = point;
+   m_timeline_point = point;
+   return VK_SUCCESS;
+}
+
+bool swapchain::export_release_point(wayland_image_data *image_data)
+{
+   if (image_data->release_point == 0)
+   {
+      return true;
+   }
+
+   /* wl_buffer.release may arrive before the compositor's GPU work reading the buffer has completed. Rather than
+    * waiting for the point here, which runs on the event thread, give it to acquire as the release fence, like the
+    * fences of zwp_linux_buffer_release_v1. Transferring an unsubmitted point fails without blocking. */
+   int ret = drmSyncobjTransfer(m_drm_fd, m_release_syncobj, 0, m_release_timeline.handle, image_data->release_point,
+                                0);
+   if (ret != 0)
+   {
+      if (!image_data->release_pending)
+      {
+         /* The event is signalled as soon as the point is submitted, which collect_release_points then picks up. */
+         if (drmSyncobjEventfd(m_drm_fd, m_release_timeline.handle, image_data->release_point,
+                               m_release_eventfd.get(), DRM_SYNCOBJ_WAIT_FLAGS_WAIT_AVAILABLE) != 0)
+         {
+            WSI_LOG_ERROR("Failed to wait for the buffer release point to be submitted.");
+            set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+            image_data->release_point = 0;
+            return true;
+         }
+         image_data->release_pending = true;
+         m_pending_release_count++;
+      }
+      return false;
+   }
+
+   int sync_fd = -1;
+   if (drmSyncobjExportSyncFile(m_drm_fd, m_release_syncobj, &sync_fd) != 0)
+   {
+      WSI_LOG_ERROR("Failed to export the buffer release point.");
+      set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+   }
+   image_data->release_fence = util::fd_owner{ sync_fd };
+
+   if (image_data->release_pending)
+   {
+      image_data->release_pending = false;
+      m_pending_release_count--;
+   }
+   image_data->release_point = 0;
+   return true;
+}
+
+bool swapchain::collect_release_points()
+{
+   std::lock_guard<std::mutex> lock(m_release_points_lock);
+
+   /* Clear the event so it does not keep waking up get_free_buffer. It is non-blocking and the images are checked
+    * whether it was signalled or not. */
+   uint64_t value = 0;
+   ssize_t res = read(m_release_eventfd.get(), &value, sizeof(value));
+   UNUSED(res);
+
+   if (m_pending_release_count == 0)
+   {
+      return false;
+   }
+
+   for (uint32_t i = 0; i < m_swapchain_images.size(); i++)
+   {
+      auto data = reinterpret_cast<wayland_image_data *>(m_swapchain_images[i].data);
+      if (data != nullptr && data->release_pending && export_release_point(data))
+      {
+         unpresent_image(i);
+      }
+   }
+   return m_pending_release_count > 0;
+}
+#endif
+
+bool swapchain::uses_fifo_barrier(VkPresentModeKHR present_mode) const
+{
+#if WAYLAND_FIFO_V1_ENABLED
+   return (present_mode == VK_PRESENT_MODE_FIFO_KHR || present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR) &&
+          m_wsi_surface->get_fifo_interface() != nullptr;
+#else
+   UNUSED(present_mode);
+   return false;
+#endif
+}
+
+static uint64_t clock_now_ns(clockid_t clock_id)
+{
+   timespec now = {};
+   clock_gettime(clock_id, &now);
+   return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+}
+
+VWL_CAPI_CALL(void)
+relaxed_feedback_sync_output(void *data, struct wp_presentation_feedback *feedback,
+                             struct wl_output *output) VWL_API_POST
+{
+   UNUSED(data);
+   UNUSED(feedback);
+   UNUSED(output);
+}
+
+VWL_CAPI_CALL(void)
+relaxed_feedback_presented(void *data, struct wp_presentation_feedback *feedback, uint32_t tv_sec_hi,
+                           uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo,
+                           uint32_t flags) VWL_API_POST
+{
+   UNUSED(feedback);
+   UNUSED(seq_hi);
+   UNUSED(seq_lo);
+   UNUSED(flags);
+
+   auto sc = reinterpret_cast<swapchain *>(data);
+   const uint64_t tv_sec = (static_cast<uint64_t>(tv_sec_hi) << 32) | tv_sec_lo;
+   sc->relaxed_feedback_done(tv_sec * 1000000000ull + tv_nsec, refresh);
+}
+
+VWL_CAPI_CALL(void) relaxed_feedback_discarded(void *data, struct wp_presentation_feedback *feedback) VWL_API_POST
+{
+   UNUSED(feedback);
+
+   auto sc = reinterpret_cast<swapchain *>(data);
+   sc->relaxed_feedback_done(0, 0);
+}
+
+static const wp_presentation_feedback_listener relaxed_feedback_listener = {
+   relaxed_feedback_sync_output,
+   relaxed_feedback_presented,
+   relaxed_feedback_discarded,
+};
+
+void swapchain::relaxed_feedback_done(uint64_t present_time_ns, uint32_t refresh_ns)
+{
+   /* A discarded commit was replaced before it was shown, so the previous presentation time still applies. */
+   if (present_time_ns != 0)
+   {
+      m_last_presentation_ns = present_time_ns;
+      m_refresh_interval_ns = refresh_ns;
+   }
+   m_relaxed_feedback.reset();
+}
+
+void swapchain::request_relaxed_feedback()
+{
+   /* Only the commit after the last presented one matters, so one feedback in flight is enough. */
+   if (m_relaxed_feedback_queue == nullptr || m_relaxed_feedback != nullptr)
+   {
+      return;
+   }
+
+   auto presentation_proxy =
+      make_proxy_with_queue(m_wsi_surface->get_presentation_time_interface(), m_relaxed_feedback_queue.get());
+   if (presentation_proxy != nullptr)
+   {
+      m_relaxed_feedback.reset(wp_presentation_feedback(presentation_proxy.get(), m_surface));
+   }
+
+   if (m_relaxed_feedback == nullptr ||
+       wp_presentation_feedback_add_listener(m_relaxed_feedback.get(), &relaxed_feedback_listener, this) < 0)
+   {
+      /* Presents are then not late until feedback is available again. */
+      WSI_LOG_WARNING("Failed to request presentation feedback.");
+      m_relaxed_feedback.reset();
+   }
+}
+
+bool swapchain::is_present_late()
+{
+   if (m_relaxed_feedback_queue == nullptr)
+   {
+      return false;
+   }
+
+   if (m_relaxed_feedback != nullptr && dispatch_queue(m_display, m_relaxed_feedback_queue.get(), 0) < 0)
+   {
+      set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+      return false;
+   }
+
+   /* The previous commit is not shown yet, so this one can still make the refresh after it. */
+   if (m_relaxed_feedback != nullptr || m_last_presentation_ns == 0 || m_refresh_interval_ns == 0)
+   {
+      return false;
+   }
+
+   const clockid_t clock_id = m_wsi_surface->get_presentation_clock_id();
+   return clock_now_ns(clock_id) > m_last_presentation_ns + m_refresh_interval_ns;
+}
+
+#if WAYLAND_TEARING_CONTROL_ENABLED
+void swapchain::set_tearing_hint(bool async)
+{
+   m_tearing_hint_async = async;
+   if (m_wsi_surface->get_tearing_control_interface() != nullptr)
+   {
+      const uint32_t hint =
+         async ? WP_TEARING_CONTROL_V1_PRESENTATION_HINT_ASYNC : WP_TEARING_CONTROL_V1_PRESENTATION_HINT_VSYNC;
+      wp_tearing_control_v1_set_presentation_hint(m_wsi_surface->get_tearing_control_interface(), hint);
+   }
+}
+#endif
+
+bool swapchain::uses_explicit_sync() const
+{
+   /* The explicit synchronization protocols only support dmabuf buffers. */
+   if (m_shm)
+   {
+      return false;
+   }
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   if (m_syncobj_surface != nullptr)
+   {
+      return true;
+   }
+#endif
+   return m_wsi_surface->get_surface_sync_interface() != nullptr;
+}
+
 VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info,
                                   bool &use_presentation_thread)
 {
    UNUSED(device);
-   UNUSED(swapchain_create_info);
    UNUSED(use_presentation_thread);
 
-   if ((m_display == nullptr) || (m_surface == nullptr) || (m_wsi_surface->get_dmabuf_interface() == nullptr))
+   if ((m_display == nullptr) || (m_surface == nullptr) ||
+       (m_wsi_surface->get_dmabuf_interface() == nullptr && m_wsi_surface->get_shm_interface() == nullptr))
    {
       return VK_ERROR_INITIALIZATION_FAILED;
    }
@@ -150,24 +542,127 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
       return VK_ERROR_INITIALIZATION_FAILED;
    }
 
-   WSIALLOC_ASSERT_VERSION();
-   if (wsialloc_new(&m_wsi_allocator) != WSIALLOC_ERROR_NONE)
+#if WAYLAND_EVENT_THREAD_ENABLED
+   /* Without the event thread get_free_buffer dispatches the queue. */
+   event_thread *thread = m_wsi_surface->get_event_thread();
+   if (thread != nullptr && thread->add_queue(m_buffer_queue))
    {
-      WSI_LOG_ERROR("Failed to create wsi allocator.");
-      return VK_ERROR_INITIALIZATION_FAILED;
+      m_event_thread = thread;
+   }
+#endif
+
+   /* Without dmabuf every image is presented through wl_shm, which needs no external allocator. */
+   if (!m_wsi_surface->use_shm())
+   {
+      WSIALLOC_ASSERT_VERSION();
+      if (acquire_shared_wsialloc_allocator(m_device_data, &m_wsi_allocator) != WSIALLOC_ERROR_NONE)
+      {
+         WSI_LOG_ERROR("Failed to create wsi allocator.");
+         return VK_ERROR_INITIALIZATION_FAILED;
+      }
+
+      /* Parallel image creation allocates the images concurrently rather than in one batch. */
+      const bool deferred_allocation =
+         swapchain_create_info->flags & VK_SWAPCHAIN_CREATE_DEFERRED_MEMORY_ALLOCATION_BIT_EXT;
+      if (!deferred_allocation && !m_parallel_image_creation && swapchain_create_info->oldSwapchain == VK_NULL_HANDLE)
+      {
+         m_batch_allocations.set_count(static_cast<uint32_t>(m_swapchain_images.size()));
+      }
    }
 
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   /* The surface's syncobj object requires acquire and release points on every commit, so there is no fallback. */
+   if (m_wsi_surface->get_syncobj_surface_interface() != nullptr)
+   {
+      TRY_LOG_CALL(init_drm_syncobj());
+   }
+#endif
+
    /*
-    * When VK_PRESENT_MODE_MAILBOX_KHR has been chosen by the application we don't
+    * When only VK_PRESENT_MODE_MAILBOX_KHR or VK_PRESENT_MODE_IMMEDIATE_KHR can be used by the application we don't
     * initialize the page flip thread so the present_image function can be called
-    * during vkQueuePresent.
+    * during vkQueuePresent. The same goes for FIFO and FIFO_RELAXED with fifo-v1 barriers, as
+    * present_image then no longer blocks on frame events.
     */
-   use_presentation_thread =
-      WAYLAND_FIFO_PRESENTATION_THREAD_ENABLED && (m_present_mode != VK_PRESENT_MODE_MAILBOX_KHR);
+   const bool fifo_presentation_thread =
+      m_device_data.instance_data.get_layer_settings().fifo_presentation_thread.value_or(
+         WAYLAND_FIFO_PRESENTATION_THREAD_ENABLED != 0);
+   use_presentation_thread = fifo_presentation_thread &&
+                             ((is_present_mode_enabled(VK_PRESENT_MODE_FIFO_KHR) &&
+                               !uses_fifo_barrier(VK_PRESENT_MODE_FIFO_KHR)) ||
+                              (is_present_mode_enabled(VK_PRESENT_MODE_FIFO_RELAXED_KHR) &&
+                               !uses_fifo_barrier(VK_PRESENT_MODE_FIFO_RELAXED_KHR)));
+
+   /* FIFO_RELAXED presents tell whether they are late from the presentation feedback of the previous commit. */
+   if (is_present_mode_enabled(VK_PRESENT_MODE_FIFO_RELAXED_KHR) &&
+       m_wsi_surface->get_presentation_time_interface() != nullptr)
+   {
+      m_relaxed_feedback_queue.reset(wl_display_create_queue(m_display));
+      if (m_relaxed_feedback_queue == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to create presentation feedback wl queue.");
+         return VK_ERROR_INITIALIZATION_FAILED;
+      }
+   }
+
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   /* The hint is double buffered state of the surface, so it also resets what an older swapchain asked for. */
+   set_tearing_hint(m_present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR);
+#endif
+
+   TRY_LOG_CALL(init_viewport_destination(swapchain_create_info));
 
    return VK_SUCCESS;
 }
 
+VkResult swapchain::init_viewport_destination(const VkSwapchainCreateInfoKHR *swapchain_create_info)
+{
+   auto scaling_create_info = util::find_extension<VkSwapchainPresentScalingCreateInfoEXT>(
+      VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_SCALING_CREATE_INFO_EXT, swapchain_create_info);
+   if (scaling_create_info == nullptr || scaling_create_info->scalingBehavior != VK_PRESENT_SCALING_STRETCH_BIT_EXT)
+   {
+      /* The destination is state of the surface, so unscaled swapchains reset what an older swapchain set. Surfaces
+       * that were never scaled have no viewport of the layer, and may have one of the application instead. */
+      if (m_wsi_surface->get_viewport_interface() != nullptr)
+      {
+         m_viewport_pending = true;
+      }
+      return VK_SUCCESS;
+   }
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   /* The extent of a Wayland surface is the one of the buffers attached to it, so the size to scale the images to
+    * has to come from the application. Without it stretching to the surface extent would leave the images unscaled. */
+   auto scaled_extent_info = util::find_extension<VkSwapchainScaledExtentCreateInfoARM>(
+      VK_STRUCTURE_TYPE_SWAPCHAIN_SCALED_EXTENT_CREATE_INFO_ARM, swapchain_create_info);
+   if (scaled_extent_info == nullptr)
+   {
+      WSI_LOG_ERROR("Stretched presents need a VkSwapchainScaledExtentCreateInfoARM on Wayland.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   const VkExtent2D &extent = scaled_extent_info->scaledExtent;
+   if (extent.width == 0 || extent.height == 0 || extent.width > INT32_MAX || extent.height > INT32_MAX)
+   {
+      WSI_LOG_ERROR("Invalid scaled extent %ux%u.", extent.width, extent.height);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   if (m_wsi_surface->get_or_create_viewport() == nullptr)
+   {
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   m_viewport_width = static_cast<int32_t>(extent.width);
+   m_viewport_height = static_cast<int32_t>(extent.height);
+   m_viewport_pending = true;
+   return VK_SUCCESS;
+#else
+   /* Not reported in the surface capabilities without the scaled extent. */
+   return VK_ERROR_INITIALIZATION_FAILED;
+#endif
+}
+
 VWL_CAPI_CALL(void) buffer_release(void *data, struct wl_buffer *wayl_buffer) VWL_API_POST
 {
    auto sc = reinterpret_cast<swapchain *>(data);
@@ -176,12 +671,38 @@ VWL_CAPI_CALL(void) buffer_release(void *data, struct wl_buffer *wayl_buffer) VW
 
 void swapchain::release_buffer(struct wl_buffer *wayl_buffer)
 {
+   /* Buffers are then released through their zwp_linux_buffer_release_v1, which also carries the release fence. */
+   if (m_wsi_surface->get_surface_sync_interface() != nullptr && !m_shm)
+   {
+      return;
+   }
+
+   WSI_TRACE_EVENT("wl_buffer_release", 0);
+
    uint32_t i;
    for (i = 0; i < m_swapchain_images.size(); i++)
    {
       auto data = reinterpret_cast<wayland_image_data *>(m_swapchain_images[i].data);
       if (data && data->buffer == wayl_buffer)
       {
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+         if (m_syncobj_surface != nullptr)
+         {
+            std::lock_guard<std::mutex> lock(m_release_points_lock);
+            if (!export_release_point(data))
+            {
+               break;
+            }
+
+            if (m_pending_release_count > 0)
+            {
+               /* Wake up an acquire waiting for the pending release points, as this image is now free. */
+               uint64_t value = 1;
+               ssize_t res = write(m_release_eventfd.get(), &value, sizeof(value));
+               UNUSED(res);
+            }
+         }
+#endif
          unpresent_image(i);
          break;
       }
@@ -193,19 +714,104 @@ void swapchain::release_buffer(struct wl_buffer *wayl_buffer)
 
 static struct wl_buffer_listener buffer_listener = { buffer_release };
 
+VWL_CAPI_CALL(void)
+buffer_fenced_release(void *data, struct zwp_linux_buffer_release_v1 *release, int32_t fence) VWL_API_POST
+{
+   UNUSED(release);
+   auto image_data = reinterpret_cast<wayland_image_data *>(data);
+   image_data->owner->release_buffer_fenced(image_data, fence);
+}
+
+VWL_CAPI_CALL(void) buffer_immediate_release(void *data, struct zwp_linux_buffer_release_v1 *release) VWL_API_POST
+{
+   UNUSED(release);
+   auto image_data = reinterpret_cast<wayland_image_data *>(data);
+   image_data->owner->release_buffer_fenced(image_data, -1);
+}
+
+static const zwp_linux_buffer_release_v1_listener buffer_release_listener = { buffer_fenced_release,
+                                                                             buffer_immediate_release };
+
+void swapchain::release_buffer_fenced(wayland_image_data *image_data, int release_fence)
+{
+   WSI_TRACE_EVENT("wl_buffer_release", 0);
+
+   /* The compositor destroys the release object once it has sent either event. */
+   image_data->buffer_release.reset();
+   image_data->release_fence = util::fd_owner{ release_fence };
+
+   uint32_t i;
+   for (i = 0; i < m_swapchain_images.size(); i++)
+   {
+      if (m_swapchain_images[i].data == image_data)
+      {
+         unpresent_image(i);
+         break;
+      }
+   }
+
+   assert(i < m_swapchain_images.size());
+}
+
+bool swapchain::set_buffer_release(wayland_image_data *image_data)
+{
+   /* Deliver the release events with the wl_buffer.release events, which get_free_buffer dispatches. */
+   auto surface_sync_proxy = make_proxy_with_queue(m_wsi_surface->get_surface_sync_interface(), m_buffer_queue);
+   if (surface_sync_proxy == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to create zwp_linux_surface_synchronization_v1 proxy.");
+      return false;
+   }
+
+   image_data->buffer_release.reset(zwp_linux_surface_synchronization_v1_get_release(surface_sync_proxy.get()));
+   if (image_data->buffer_release == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to create buffer release object.");
+      return false;
+   }
+
+   int res = zwp_linux_buffer_release_v1_add_listener(image_data->buffer_release.get(), &buffer_release_listener,
+                                                      image_data);
+   if (res < 0)
+   {
+      WSI_LOG_ERROR("Failed to add buffer release listener.");
+      return false;
+   }
+
+   return true;
+}
+
 VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info,
                                                    util::vector<wsialloc_format> &importable_formats,
                                                    util::vector<uint64_t> &exportable_modifers,
                                                    util::vector<VkDrmFormatModifierPropertiesEXT> &drm_format_props)
 {
-   TRY_LOG(util::get_drm_format_properties(m_device_data.physical_device, info.format, drm_format_props),
+   const VkImageCompressionControlEXT *compression_control = nullptr;
+   VkImageCompressionControlEXT compression_properties = {};
+   auto *compression_ext = get_swapchain_extension<wsi_ext_image_compression_control>();
+   if (compression_ext)
+   {
+      compression_properties = compression_ext->get_compression_control_properties();
+      compression_control = &compression_properties;
+   }
+
+   util::vector<util::drm_format_modifier_support> supported_modifiers(
+      util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+   TRY_LOG(m_device_data.get_format_modifier_cache().get_supported_modifiers(info, compression_control,
+                                                                             supported_modifiers),
            "Failed to get format properties");
 
-   for (const auto &prop : drm_format_props)
-   {
-      bool is_supported = false;
+   for (const auto &modifier : supported_modifiers)
+   {
+      const auto &prop = modifier.modifier_properties;
+      if (!drm_format_props.try_push_back(prop))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+
       drm_format_pair drm_format{ util::drm::vk_to_drm_format(info.format), prop.drmFormatModifier };
 
+      bool is_supported = false;
       for (const auto &format : m_wsi_surface->get_formats())
       {
          if (format.fourcc == drm_format.fourcc && format.modifier == drm_format.modifier)
@@ -219,74 +825,12 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
          continue;
       }
 
-      VkExternalImageFormatPropertiesKHR external_props = {};
-      external_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES_KHR;
-
-      VkImageFormatProperties2KHR format_props = {};
-      format_props.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2_KHR;
-      format_props.pNext = &external_props;
-
-      VkResult result = VK_SUCCESS;
-      {
-         VkPhysicalDeviceExternalImageFormatInfoKHR external_info = {};
-         external_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO_KHR;
-         external_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
-
-         VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_mod_info = {};
-         drm_mod_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT;
-         drm_mod_info.pNext = &external_info;
-         drm_mod_info.drmFormatModifier = prop.drmFormatModifier;
-         drm_mod_info.sharingMode = info.sharingMode;
-         drm_mod_info.queueFamilyIndexCount = info.queueFamilyIndexCount;
-         drm_mod_info.pQueueFamilyIndices = info.pQueueFamilyIndices;
-
-         VkPhysicalDeviceImageFormatInfo2KHR image_info = {};
-         image_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2_KHR;
-         image_info.pNext = &drm_mod_info;
-         image_info.format = info.format;
-         image_info.type = info.imageType;
-         image_info.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
-         image_info.usage = info.usage;
-         image_info.flags = info.flags;
-
-         VkImageCompressionControlEXT compression_control = {};
-
-         if (m_device_data.is_swapchain_compression_control_enabled())
-         {
-            auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
-            if (ext)
-            {
-               compression_control = ext->get_compression_control_properties();
-               compression_control.pNext = image_info.pNext;
-               image_info.pNext = &compression_control;
-            }
-         }
-
-         result = m_device_data.instance_data.disp.GetPhysicalDeviceImageFormatProperties2KHR(
-            m_device_data.physical_device, &image_info, &format_props);
-      }
-      if (result != VK_SUCCESS)
-      {
-         continue;
-      }
-      if (format_props.imageFormatProperties.maxExtent.width < info.extent.width ||
-          format_props.imageFormatProperties.maxExtent.height < info.extent.height ||
-          format_props.imageFormatProperties.maxExtent.depth < info.extent.depth)
-      {
-         continue;
-      }
-      if (format_props.imageFormatProperties.maxMipLevels < info.mipLevels ||
-          format_props.imageFormatProperties.maxArrayLayers < info.arrayLayers)
-      {
-         continue;
-      }
-      if ((format_props.imageFormatProperties.sampleCounts & info.samples) != info.samples)
+      if (!modifier.supports_image(info))
       {
          continue;
       }
 
-      if (external_props.externalMemoryProperties.externalMemoryFeatures &
-          VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT_KHR)
+      if (modifier.external_memory_features & VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT_KHR)
       {
          if (!exportable_modifers.try_push_back(drm_format.modifier))
          {
@@ -294,8 +838,7 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
          }
       }
 
-      if (external_props.externalMemoryProperties.externalMemoryFeatures &
-          VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT_KHR)
+      if (modifier.external_memory_features & VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT_KHR)
       {
          uint64_t flags =
             (prop.drmFormatModifierTilingFeatures & VK_FORMAT_FEATURE_DISJOINT_BIT) ? 0 : WSIALLOC_FORMAT_NON_DISJOINT;
@@ -307,6 +850,18 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
       }
    }
 
+   if (compression_ext && compression_ext->is_layer_default())
+   {
+      /* List the most compressed modifiers first, the scan out formats are then moved ahead in the same order. */
+      sort_formats_by_compression(importable_formats, supported_modifiers);
+   }
+
+   /* The allocator picks the first format it can allocate, so list the formats the compositor can scan out first.
+    * Fullscreen surfaces can then be displayed directly without a composition pass. */
+   std::stable_partition(importable_formats.begin(), importable_formats.end(), [this](const wsialloc_format &format) {
+      return m_wsi_surface->is_scanout_format(drm_format_pair{ format.fourcc, format.modifier });
+   });
+
    return VK_SUCCESS;
 }
 
@@ -316,24 +871,22 @@ VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, wayl
 {
    bool is_protected_memory = (image_create_info.flags & VK_IMAGE_CREATE_PROTECTED_BIT) != 0;
    uint64_t allocation_flags = is_protected_memory ? WSIALLOC_ALLOCATE_PROTECTED : 0;
+   /* The buffers are sampled by the compositor, which may still promote some of them to an overlay plane. */
+   allocation_flags |= WSIALLOC_ALLOCATE_USAGE_COMPOSITE;
    if (avoid_allocation)
    {
       allocation_flags |= WSIALLOC_ALLOCATE_NO_MEMORY;
    }
 
-   if (m_device_data.is_swapchain_compression_control_enabled())
+   /* The extension is only added when the application controls the compression of the swapchain, or when the
+      layer chooses it for the swapchain, so we check whether we got a valid pointer and proceed if yes. */
+   auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
+   if (ext)
    {
-      auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
-      /* For Image compression control, additional requirements to be satisfied such as
-         existence of VkImageCompressionControlEXT in swaphain_create_info for
-         the ext to be added to the list. so we check whether we got a valid pointer
-         and proceed if yes. */
-      if (ext)
+      if ((ext->get_bitmask_for_image_compression_flags() & VK_IMAGE_COMPRESSION_FIXED_RATE_EXPLICIT_EXT) ||
+          ext->is_layer_default())
       {
-         if (ext->get_bitmask_for_image_compression_flags() & VK_IMAGE_COMPRESSION_FIXED_RATE_EXPLICIT_EXT)
-         {
-            allocation_flags |= WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION;
-         }
+         allocation_flags |= WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION;
       }
    }
 
@@ -348,7 +901,7 @@ VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, wayl
       alloc_result.buffer_fds[i] = -1;
       alloc_result.average_row_strides[i] = -1;
    }
-   const auto res = wsialloc_alloc(m_wsi_allocator, &alloc_info, &alloc_result);
+   const auto res = m_batch_allocations.allocate(m_wsi_allocator, alloc_info, alloc_result);
    if (res != WSIALLOC_ERROR_NONE)
    {
       WSI_LOG_ERROR("Failed allocation of DMA Buffer. WSI error: %d", static_cast<int>(res));
@@ -359,10 +912,17 @@ VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, wayl
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
    *allocated_format = alloc_result.format;
+   /* Importing the buffer into Vulkan consumes its FDs, so keep duplicates to give it back to the wsialloc cache. */
+   if (!avoid_allocation && !image_data->allocated_buffer.keep(alloc_result, allocation_flags))
+   {
+      WSI_LOG_WARNING("Failed to duplicate the buffer FDs, the buffer will not be cached once released.");
+   }
    auto &external_memory = image_data->external_mem;
    external_memory.set_strides(alloc_result.average_row_strides);
    external_memory.set_buffer_fds(alloc_result.buffer_fds);
    external_memory.set_offsets(alloc_result.offsets);
+   external_memory.set_memory_source(alloc_result.format.fourcc, alloc_result.format.modifier, allocation_flags);
+   external_memory.set_memory_usage(m_memory_usage);
 
    uint32_t num_planes = util::drm::drm_fourcc_format_get_num_planes(alloc_result.format.fourcc);
 
@@ -412,12 +972,14 @@ static VkResult fill_image_create_info(VkImageCreateInfo &image_create_info,
 VkResult swapchain::allocate_image(wayland_image_data *image_data)
 {
    util::vector<wsialloc_format> importable_formats(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
-   auto &m_allocated_format = m_image_creation_parameters.m_allocated_format;
-   if (!importable_formats.try_push_back(m_allocated_format))
+   /* The format was chosen with the first image, so the result is not stored back, which lets images be allocated
+    * concurrently. */
+   wsialloc_format allocated_format = m_image_creation_parameters.m_allocated_format;
+   if (!importable_formats.try_push_back(allocated_format))
    {
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
-   TRY_LOG_CALL(allocate_wsialloc(m_image_create_info, image_data, importable_formats, &m_allocated_format, false));
+   TRY_LOG_CALL(allocate_wsialloc(m_image_create_info, image_data, importable_formats, &allocated_format, false));
 
    return VK_SUCCESS;
 }
@@ -455,23 +1017,98 @@ VkResult swapchain::create_wl_buffer(const VkImageCreateInfo &image_create_info,
    return VK_SUCCESS;
 }
 
-VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+VkResult swapchain::create_shm_buffer(swapchain_image &image, wayland_image_data *image_data)
+{
+   TRY_LOG_CALL(image_data->shm_memory.allocate_and_bind(image.image));
+
+   const VkSubresourceLayout &layout = image_data->shm_memory.get_layout();
+   const size_t size = image_data->shm_memory.get_size();
+   if (size > INT32_MAX || layout.offset > INT32_MAX || layout.rowPitch > INT32_MAX)
+   {
+      WSI_LOG_ERROR("The image is too large to be shared with wl_shm.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   /* The fd is duplicated when the request is sent, so the pool only lives long enough to create the buffer. */
+   wl_shm_pool *pool = wl_shm_create_pool(m_wsi_surface->get_shm_interface(), image_data->shm_memory.get_fd(),
+                                          static_cast<int32_t>(size));
+   if (pool == nullptr)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   /* Alpha is ignored like with dmabuf buffers, see create_wl_buffer. */
+   image_data->buffer = wl_shm_pool_create_buffer(pool, static_cast<int32_t>(layout.offset),
+                                                  static_cast<int32_t>(m_image_create_info.extent.width),
+                                                  static_cast<int32_t>(m_image_create_info.extent.height),
+                                                  static_cast<int32_t>(layout.rowPitch), WL_SHM_FORMAT_XRGB8888);
+   wl_shm_pool_destroy(pool);
+   if (image_data->buffer == nullptr)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   wl_proxy_set_queue(reinterpret_cast<wl_proxy *>(image_data->buffer), m_buffer_queue);
+   if (wl_buffer_add_listener(image_data->buffer, &buffer_listener, this) < 0)
+   {
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::allocate_swapchain_image_buffer(swapchain_image &image)
 {
-   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
-   image.status = swapchain_image::FREE;
+   image.status.store(swapchain_image::FREE);
 
    assert(image.data != nullptr);
    auto image_data = static_cast<wayland_image_data *>(image.data);
-   TRY_LOG(allocate_image(image_data), "Failed to allocate image");
-   image_status_lock.unlock();
+   if (!m_shm)
+   {
+      TRY_LOG(allocate_image(image_data), "Failed to allocate image");
+   }
+   return VK_SUCCESS;
+}
 
-   TRY_LOG(create_wl_buffer(image_create_info, image, image_data), "Failed to create wl_buffer");
+VkResult swapchain::export_swapchain_image(const VkImageCreateInfo &image_create_info, swapchain_image &image)
+{
+   auto image_data = static_cast<wayland_image_data *>(image.data);
+   if (m_shm)
+   {
+      TRY_LOG(create_shm_buffer(image, image_data), "Failed to create wl_shm buffer");
+   }
+   else
+   {
+      TRY_LOG(create_wl_buffer(image_create_info, image, image_data), "Failed to create wl_buffer");
+   }
+   return VK_SUCCESS;
+}
 
-   TRY_LOG(image_data->external_mem.import_memory_and_bind_swapchain_image(image.image),
-           "Failed to import memory and bind swapchain image");
+VkResult swapchain::import_swapchain_image_buffer(swapchain_image &image)
+{
+   auto image_data = static_cast<wayland_image_data *>(image.data);
+   /* Images presented with wl_shm are bound by create_shm_buffer. */
+   if (!m_shm)
+   {
+      if (m_prime_copy != nullptr)
+      {
+         const auto image_index = static_cast<uint32_t>(&image - m_swapchain_images.data());
+         TRY_LOG(m_prime_copy->bind_image(image_index, image.image, image_data->external_mem),
+                 "Failed to bind swapchain image and its linear buffer");
+      }
+      else
+      {
+         TRY_LOG(image_data->external_mem.import_memory_and_bind_swapchain_image(image.image),
+                 "Failed to import memory and bind swapchain image");
+      }
+   }
 
-   /* Initialize presentation fence. */
-   auto present_fence = sync_fd_fence_sync::create(m_device_data);
+   /* Initialize presentation fence, backed by a syncobj when its payloads go to the acquire timeline. */
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   const int drm_fd = m_syncobj_surface != nullptr ? m_drm_fd : -1;
+#else
+   const int drm_fd = -1;
+#endif
+   auto present_fence = syncobj_fence_sync::create(m_device_data, drm_fd);
    if (!present_fence.has_value())
    {
       return VK_ERROR_OUT_OF_HOST_MEMORY;
@@ -481,17 +1118,30 @@ VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_cr
    return VK_SUCCESS;
 }
 
+VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+{
+   TRY_LOG_CALL(allocate_swapchain_image_buffer(image));
+   TRY_LOG_CALL(export_swapchain_image(image_create_info, image));
+   return import_swapchain_image_buffer(image);
+}
+
 VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
 {
    /* Create image_data */
-   auto image_data = m_allocator.create<wayland_image_data>(1, m_device, m_allocator);
+   auto image_data = m_image_allocator.create<wayland_image_data>(1, m_device, m_image_allocator);
    if (image_data == nullptr)
    {
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
+   image_data->owner = this;
    image.data = image_data;
 
-   if (m_image_create_info.format == VK_FORMAT_UNDEFINED)
+   if (m_image_create_info.format == VK_FORMAT_UNDEFINED && m_wsi_surface->use_shm())
+   {
+      TRY_LOG_CALL(init_shm(image_create_info));
+      m_image_create_info = image_create_info;
+   }
+   else if (m_image_create_info.format == VK_FORMAT_UNDEFINED)
    {
       util::vector<wsialloc_format> importable_formats(
          util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
@@ -505,10 +1155,19 @@ VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info,
          get_surface_compatible_formats(image_create_info, importable_formats, exportable_modifiers, drm_format_props));
 
       /* TODO: Handle exportable images which use ICD allocated memory in preference to an external allocator. */
-      if (importable_formats.empty())
+      if (importable_formats.empty() || m_device_data.instance_data.get_layer_settings().prime_copy)
       {
-         WSI_LOG_ERROR("Export/Import not supported.");
-         return VK_ERROR_INITIALIZATION_FAILED;
+         /* Typically a discrete GPU presenting to a compositor running on another GPU. */
+         VkResult result = init_prime_copy(image_create_info);
+         if (result == VK_ERROR_INITIALIZATION_FAILED && m_wsi_surface->get_shm_interface() != nullptr)
+         {
+            /* Typically a software rasterizer, which cannot export any buffer the compositor can import. */
+            result = init_shm(image_create_info);
+         }
+         TRY_LOG(result, "Export/Import not supported.");
+         m_image_create_info = image_create_info;
+         return m_device_data.disp.CreateImage(m_device, &m_image_create_info, get_allocation_callbacks(),
+                                               &image.image);
       }
 
       wsialloc_format allocated_format = { 0, 0, 0 };
@@ -533,39 +1192,169 @@ VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info,
    return m_device_data.disp.CreateImage(m_device, &m_image_create_info, get_allocation_callbacks(), &image.image);
 }
 
+VkResult swapchain::init_prime_copy(VkImageCreateInfo &image_create_info)
+{
+   const uint32_t fourcc = util::drm::vk_to_drm_format(image_create_info.format);
+   bool linear_supported = false;
+   for (const auto &format : m_wsi_surface->get_formats())
+   {
+      if (format.fourcc == fourcc && format.modifier == DRM_FORMAT_MOD_LINEAR)
+      {
+         linear_supported = true;
+         break;
+      }
+   }
+
+   if (!linear_supported || !prime_copy::is_supported(m_device_data, VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT))
+   {
+      WSI_LOG_ERROR("Linear buffers of format 0x%x cannot be shared with the compositor.", fourcc);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   if ((image_create_info.flags & VK_IMAGE_CREATE_PROTECTED_BIT) != 0)
+   {
+      WSI_LOG_ERROR("Protected images cannot be copied for presentation.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   m_prime_copy = prime_copy::create(m_device_data, m_allocator, get_allocation_callbacks(), m_memory_usage,
+                                     image_create_info.format,
+                                     { image_create_info.extent.width, image_create_info.extent.height },
+                                     static_cast<uint32_t>(m_swapchain_images.size()));
+   if (m_prime_copy == nullptr)
+   {
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   prime_copy::fill_image_create_info(image_create_info);
+   m_image_creation_parameters.m_allocated_format = { fourcc, DRM_FORMAT_MOD_LINEAR, WSIALLOC_FORMAT_NON_DISJOINT };
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::init_shm(VkImageCreateInfo &image_create_info)
+{
+   if (!host_memory::is_supported(m_device_data))
+   {
+      WSI_LOG_ERROR("wl_shm presentation requires " VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME ".");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   /* The surface's syncobj object requires acquire points on every commit, which wl_shm buffers cannot have. */
+   if (m_wsi_surface->get_syncobj_surface_interface() != nullptr)
+   {
+      WSI_LOG_ERROR("wl_shm buffers cannot be presented on a surface using wp_linux_drm_syncobj_v1.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+#endif
+
+   /* Only the formats every compositor supports with wl_shm are used. */
+   const uint32_t fourcc = util::drm::vk_to_drm_format(image_create_info.format);
+   if (fourcc != DRM_FORMAT_ARGB8888 && fourcc != DRM_FORMAT_XRGB8888)
+   {
+      WSI_LOG_ERROR("Format 0x%x cannot be shared with wl_shm.", fourcc);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   if ((image_create_info.flags & VK_IMAGE_CREATE_PROTECTED_BIT) != 0)
+   {
+      WSI_LOG_ERROR("Protected images cannot be shared with wl_shm.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   host_memory::fill_image_create_info(image_create_info, m_image_creation_parameters.m_external_info);
+   m_shm = true;
+   return VK_SUCCESS;
+}
+
 void swapchain::present_image(const pending_present_request &pending_present)
 {
    int res;
    wayland_image_data *image_data =
       reinterpret_cast<wayland_image_data *>(m_swapchain_images[pending_present.image_index].data);
 
-   /* if a frame is already pending, wait for a hint to present again */
-   if (!m_wsi_surface->wait_next_frame_event())
+   const bool relaxed = pending_present.present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+   const bool late = relaxed && is_present_late();
+
+   /* if a frame is already pending, wait for a hint to present again. With fifo-v1 barriers the compositor holds
+    * back the commit instead. */
+   const bool fifo_barrier = uses_fifo_barrier(pending_present.present_mode);
+   if (!fifo_barrier && !late && !m_wsi_surface->wait_next_frame_event())
    {
       set_error_state(VK_ERROR_SURFACE_LOST_KHR);
    }
 
-   wl_surface_attach(m_surface, image_data->buffer, 0, 0);
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   const bool async = pending_present.present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR || late;
+   if (async != m_tearing_hint_async)
+   {
+      /* A switch between tearing and vsynced presents takes effect with the commit of this present. */
+      set_tearing_hint(async);
+   }
+#endif
+
+   if (m_viewport_pending)
+   {
+      wp_viewport_set_destination(m_wsi_surface->get_viewport_interface(), m_viewport_width, m_viewport_height);
+      m_viewport_pending = false;
+   }
+
+   /* The synchronization of the buffer is set before it is attached, so that a buffer is never committed without
+    * it. With wp_linux_drm_syncobj_surface_v1 that would be a protocol error. */
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   if (m_syncobj_surface != nullptr && set_syncobj_points(image_data) != VK_SUCCESS)
+   {
+      set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+      set_present_id(pending_present.present_id);
+      return unpresent_image(pending_present.image_index);
+   }
+#endif
 
-   if (m_wsi_surface->get_surface_sync_interface() != nullptr)
+   /* Not set when the surface uses wp_linux_drm_syncobj_surface_v1 instead, nor used for wl_shm buffers. */
+   if (m_wsi_surface->get_surface_sync_interface() != nullptr && !m_shm)
    {
       auto present_sync_fd = image_data->present_fence.export_sync_fd();
       if (!present_sync_fd.has_value())
       {
          WSI_LOG_ERROR("Failed to export present fence.");
          set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+         set_present_id(pending_present.present_id);
+         return unpresent_image(pending_present.image_index);
       }
       else if (present_sync_fd->is_valid())
       {
          zwp_linux_surface_synchronization_v1_set_acquire_fence(m_wsi_surface->get_surface_sync_interface(),
                                                                 present_sync_fd->get());
       }
+
+      if (!set_buffer_release(image_data))
+      {
+         set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+         set_present_id(pending_present.present_id);
+         return unpresent_image(pending_present.image_index);
+      }
    }
 
-   /* TODO: work out damage */
-   wl_surface_damage(m_surface, 0, 0, INT32_MAX, INT32_MAX);
+   wl_surface_attach(m_surface, image_data->buffer, 0, 0);
+
+   const present_damage &damage = m_swapchain_images[pending_present.image_index].damage;
+   if (damage.full || wl_proxy_get_version(reinterpret_cast<wl_proxy *>(m_surface)) <
+                         WL_SURFACE_DAMAGE_BUFFER_SINCE_VERSION)
+   {
+      /* Surface-local damage would need the buffer scale and transform applied, so only buffer damage is partial. */
+      wl_surface_damage(m_surface, 0, 0, INT32_MAX, INT32_MAX);
+   }
+   else
+   {
+      for (uint32_t i = 0; i < damage.rect_count; i++)
+      {
+         const VkRect2D &rect = damage.rects[i];
+         wl_surface_damage_buffer(m_surface, rect.offset.x, rect.offset.y, static_cast<int32_t>(rect.extent.width),
+                                  static_cast<int32_t>(rect.extent.height));
+      }
+   }
 
-   if (m_present_mode == VK_PRESENT_MODE_FIFO_KHR)
+   if ((pending_present.present_mode == VK_PRESENT_MODE_FIFO_KHR || relaxed) && !fifo_barrier)
    {
       if (!m_wsi_surface->set_frame_callback())
       {
@@ -573,6 +1362,53 @@ void swapchain::present_image(const pending_present_request &pending_present)
       }
    }
 
+   if (is_occlusion_throttled())
+   {
+      m_surface_occluded.store(m_wsi_surface->is_occluded(), std::memory_order_relaxed);
+      if (!m_wsi_surface->request_visibility_check())
+      {
+         set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+      }
+   }
+
+#if WAYLAND_FIFO_V1_ENABLED
+   if (fifo_barrier)
+   {
+      /* Latch this commit no earlier than the refresh after the previous one, and hold back the next one likewise.
+       * A late FIFO_RELAXED commit does not wait, but still holds back the next one. */
+      if (!late)
+      {
+         wp_fifo_v1_wait_barrier(m_wsi_surface->get_fifo_interface());
+      }
+      wp_fifo_v1_set_barrier(m_wsi_surface->get_fifo_interface());
+   }
+#endif
+
+#if WAYLAND_COMMIT_TIMING_ENABLED && VULKAN_WSI_LAYER_EXPERIMENTAL
+   auto *commit_timer = m_wsi_surface->get_commit_timer_interface();
+   if (commit_timer != nullptr && pending_present.target_time_ns != 0)
+   {
+      /* Target times are in the wp_presentation clock, the time domain of the first pixel visible stage. */
+      const uint64_t tv_sec = pending_present.target_time_ns / 1000000000ull;
+      const auto tv_nsec = static_cast<uint32_t>(pending_present.target_time_ns % 1000000000ull);
+      wp_commit_timer_v1_set_timestamp(commit_timer, static_cast<uint32_t>(tv_sec >> 32),
+                                       static_cast<uint32_t>(tv_sec & 0xffffffff), tv_nsec);
+   }
+#endif
+
+   if (relaxed)
+   {
+      request_relaxed_feedback();
+   }
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   auto *present_timing = get_swapchain_extension<wsi_ext_present_timing_wayland>();
+   if (present_timing != nullptr)
+   {
+      present_timing->request_presentation_feedback(m_surface, pending_present.timing_slot);
+   }
+#endif
+
    wl_surface_commit(m_surface);
    res = wl_display_flush(m_display);
    if (res < 0)
@@ -582,56 +1418,72 @@ void swapchain::present_image(const pending_present_request &pending_present)
       set_error_state(VK_ERROR_SURFACE_LOST_KHR);
    }
 
-   if (m_device_data.is_present_id_enabled())
-   {
-      auto *ext = get_swapchain_extension<wsi_ext_present_id>(true);
-      ext->set_present_id(pending_present.present_id);
-   }
+   set_present_id(pending_present.present_id);
 }
 
 void swapchain::destroy_image(swapchain_image &image)
 {
-   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
-
-   if (image.status != swapchain_image::INVALID)
+   /* Only the first caller to invalidate the image destroys the VkImage. */
+   const auto previous_status = image.status.exchange(swapchain_image::INVALID);
+   if (previous_status != swapchain_image::INVALID)
    {
       if (image.image != VK_NULL_HANDLE)
       {
          m_device_data.disp.DestroyImage(m_device, image.image, get_allocation_callbacks());
          image.image = VK_NULL_HANDLE;
       }
-
-      image.status = swapchain_image::INVALID;
    }
 
-   image_status_lock.unlock();
-
    if (image.data != nullptr)
    {
       auto image_data = reinterpret_cast<wayland_image_data *>(image.data);
+      /* A free image has been released by the compositor, which may still read it until its release fence signals. */
+      const bool released =
+         previous_status == swapchain_image::FREE && wait_sync_fd(image_data->release_fence.get(), 0) == VK_SUCCESS;
+      wsialloc_buffer_ref allocated_buffer = std::move(image_data->allocated_buffer);
       if (image_data->buffer != nullptr)
       {
          wl_buffer_destroy(image_data->buffer);
       }
-      m_allocator.destroy(1, image_data);
+      m_image_allocator.destroy(1, image_data);
       image.data = nullptr;
+
+      if (released)
+      {
+         allocated_buffer.release(m_wsi_allocator);
+      }
    }
 }
 
 bool swapchain::free_image_found()
 {
-   for (auto &img : m_swapchain_images)
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   if (m_syncobj_surface != nullptr)
    {
-      if (img.status == swapchain_image::FREE)
-      {
-         return true;
-      }
+      collect_release_points();
    }
-   return false;
+#endif
+   return has_free_image();
 }
 
 VkResult swapchain::get_free_buffer(uint64_t *timeout)
 {
+#if WAYLAND_EVENT_THREAD_ENABLED
+   const bool event_thread_running = m_event_thread != nullptr && m_event_thread->is_running();
+#else
+   const bool event_thread_running = false;
+#endif
+
+   /* Images released before their syncobj release point was submitted are only freed once it is, see
+    * export_release_point, so wait for the point along with the buffer releases. */
+   int wake_fd = -1;
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   if (m_syncobj_surface != nullptr)
+   {
+      wake_fd = m_release_eventfd.get();
+   }
+#endif
+
    int ms_timeout, res;
 
    if (*timeout >= INT_MAX * 1000llu * 1000llu)
@@ -643,14 +1495,39 @@ VkResult swapchain::get_free_buffer(uint64_t *timeout)
       ms_timeout = *timeout / 1000llu / 1000llu;
    }
 
-   /* The current dispatch_queue implementation will return if any
-    * events are returned, even if no events are dispatched to the buffer
-    * queue. Therefore dispatch repeatedly until a buffer has been freed.
-    */
-   do
+   if (event_thread_running)
+   {
+      /* The event thread frees the images as their releases arrive, so waiting on the free image semaphore is
+       * enough, unless some of them are still waiting for their release point. */
+      res = 1;
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+      while (wake_fd >= 0 && collect_release_points() && !has_free_image() && res > 0)
+      {
+         struct pollfd pfd = { wake_fd, POLLIN, 0 };
+         res = poll(&pfd, 1, ms_timeout);
+         if (res < 0 && errno == EINTR)
+         {
+            res = 1;
+         }
+      }
+#endif
+      if (res > 0)
+      {
+         /* Leave the timeout to the wait on the free image semaphore. */
+         return VK_SUCCESS;
+      }
+   }
+   else
    {
-      res = dispatch_queue(m_display, m_buffer_queue, ms_timeout);
-   } while (!free_image_found() && res > 0);
+      /* The current dispatch_queue implementation will return if any
+       * events are returned, even if no events are dispatched to the buffer
+       * queue. Therefore dispatch repeatedly until a buffer has been freed.
+       */
+      do
+      {
+         res = dispatch_queue(m_display, m_buffer_queue, ms_timeout, wake_fd);
+      } while (!free_image_found() && res > 0);
+   }
 
    if (res > 0)
    {
@@ -678,12 +1555,25 @@ VkResult swapchain::image_set_present_payload(swapchain_image &image, VkQueue qu
                                               const queue_submit_semaphores &semaphores, const void *submission_pnext)
 {
    auto image_data = reinterpret_cast<wayland_image_data *>(image.data);
-   return image_data->present_fence.set_payload(queue, semaphores, submission_pnext);
+   if (m_prime_copy == nullptr)
+   {
+      return image_data->present_fence.set_payload(queue, semaphores, submission_pnext);
+   }
+
+   /* The copy takes over the wait semaphores, and the payload completes once the linear buffer is written. */
+   const auto image_index = static_cast<uint32_t>(&image - m_swapchain_images.data());
+   VkSemaphore copy_done = VK_NULL_HANDLE;
+   TRY_LOG_CALL(m_prime_copy->submit_copy(queue, image_index, image.image, semaphores, copy_done));
+
+   queue_submit_semaphores payload_semaphores = semaphores;
+   payload_semaphores.wait_semaphores = &copy_done;
+   payload_semaphores.wait_semaphores_count = 1;
+   return image_data->present_fence.set_payload(queue, payload_semaphores, submission_pnext);
 }
 
 VkResult swapchain::image_wait_present(swapchain_image &image, uint64_t timeout)
 {
-   if (m_wsi_surface->get_surface_sync_interface() == nullptr)
+   if (!uses_explicit_sync())
    {
       auto data = reinterpret_cast<wayland_image_data *>(image.data);
       return data->present_fence.wait_payload(timeout);
@@ -694,12 +1584,99 @@ VkResult swapchain::image_wait_present(swapchain_image &image, uint64_t timeout)
    return VK_SUCCESS;
 }
 
+util::fd_owner swapchain::image_take_release_sync_fd(swapchain_image &image)
+{
+   auto data = reinterpret_cast<wayland_image_data *>(image.data);
+   return std::move(data->release_fence);
+}
+
+int swapchain::image_get_present_sync_fd(swapchain_image &image)
+{
+   if (uses_explicit_sync())
+   {
+      /* image_wait_present does not wait with explicit sync in use, so there is nothing to poll. */
+      return -1;
+   }
+
+   auto data = reinterpret_cast<wayland_image_data *>(image.data);
+   return data->present_fence.get_poll_fd();
+}
+
+VkResult swapchain::image_import_present_payload(swapchain_image &image, VkFence fence)
+{
+   auto data = reinterpret_cast<wayland_image_data *>(image.data);
+   return data->present_fence.import_payload_to_fence(fence);
+}
+
+VkResult swapchain::image_get_shareable_present_payload(swapchain_image &image, int &sync_fd)
+{
+   auto data = reinterpret_cast<wayland_image_data *>(image.data);
+   return data->present_fence.get_shareable_payload_fd(sync_fd);
+}
+
+VkResult swapchain::image_set_shared_present_payload(swapchain_image &image, VkQueue queue, int sync_fd)
+{
+   auto data = reinterpret_cast<wayland_image_data *>(image.data);
+   if (m_prime_copy == nullptr)
+   {
+      return data->present_fence.import_payload(sync_fd);
+   }
+
+   /* The payload only tells that the image is rendered, the linear buffer still has to be written. */
+   const auto image_index = static_cast<uint32_t>(&image - m_swapchain_images.data());
+   VkSemaphore copy_done = VK_NULL_HANDLE;
+   TRY(m_prime_copy->submit_copy_after(queue, image_index, image.image, sync_fd, copy_done));
+   return data->present_fence.set_payload(queue, { &copy_done, 1, nullptr, 0 });
+}
+
+bool swapchain::adopt_ancestor_image(swapchain_base &ancestor, swapchain_image &image)
+{
+   /* The memory of the images is owned by the copies of their swapchain, or bound to host memory for wl_shm. */
+   auto &wayland_ancestor = static_cast<swapchain &>(ancestor);
+   if (m_prime_copy != nullptr || wayland_ancestor.m_prime_copy != nullptr || m_shm || wayland_ancestor.m_shm)
+   {
+      return false;
+   }
+
+   auto &ancestor_format = wayland_ancestor.m_image_creation_parameters.m_allocated_format;
+   auto &allocated_format = m_image_creation_parameters.m_allocated_format;
+   if (ancestor_format.fourcc != allocated_format.fourcc || ancestor_format.modifier != allocated_format.modifier ||
+       ancestor_format.flags != allocated_format.flags)
+   {
+      return false;
+   }
+
+   auto image_data = reinterpret_cast<wayland_image_data *>(image.data);
+   if (image_data == nullptr || image_data->buffer == nullptr)
+   {
+      return false;
+   }
+
+   /* The buffer has been released, so there are no events in flight for it. Deliver the next release to us. */
+   auto buffer_proxy = reinterpret_cast<wl_proxy *>(image_data->buffer);
+   wl_proxy_set_queue(buffer_proxy, m_buffer_queue);
+   wl_proxy_set_user_data(buffer_proxy, this);
+   image_data->owner = this;
+   /* The counters of the ancestor are freed with it, and the memory is ours from now on. */
+   image_data->external_mem.move_memory_usage(m_memory_usage);
+   return true;
+}
+
 VkResult swapchain::bind_swapchain_image(VkDevice &device, const VkBindImageMemoryInfo *bind_image_mem_info,
                                          const VkBindImageMemorySwapchainInfoKHR *bind_sc_info)
 {
    UNUSED(device);
    const wsi::swapchain_image &swapchain_image = m_swapchain_images[bind_sc_info->imageIndex];
+   if (m_prime_copy != nullptr)
+   {
+      return m_prime_copy->bind_alias(bind_sc_info->imageIndex, bind_image_mem_info->image);
+   }
+
    auto image_data = reinterpret_cast<wayland_image_data *>(swapchain_image.data);
+   if (m_shm)
+   {
+      return image_data->shm_memory.bind(bind_image_mem_info->image);
+   }
    return image_data->external_mem.bind_swapchain_image_memory(bind_image_mem_info->image);
 }
 
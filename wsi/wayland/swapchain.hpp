@@ -42,25 +42,62 @@ extern "C" {
 #include "wl_object_owner.hpp"
 
 #include <wsi/external_memory.hpp>
+#include <wsi/host_memory.hpp>
+#include <wsi/prime_copy.hpp>
+#include <wsi/syncobj_fence_sync.hpp>
+#include <wsi/wsialloc_batch.hpp>
+
+#include <mutex>
 
 namespace wsi
 {
 namespace wayland
 {
 
+class swapchain;
+
 struct wayland_image_data
 {
    wayland_image_data(const VkDevice &device, const util::allocator &allocator)
       : external_mem(device, allocator)
       , buffer(nullptr)
+      , shm_memory(device, allocator)
    {
    }
 
    external_memory external_mem;
+   /* The dmabuf of @ref external_mem, given back to the wsialloc cache once the compositor has released it. */
+   wsialloc_buffer_ref allocated_buffer;
    wl_buffer *buffer;
-   sync_fd_fence_sync present_fence;
+   /* With wl_shm, the memory of the image, shared with the compositor through @ref buffer. */
+   host_memory shm_memory;
+   syncobj_fence_sync present_fence;
+
+   /* Point on the release timeline signalled once the compositor is done with the last commit of this buffer. */
+   uint64_t release_point{ 0 };
+   /* Set when the compositor has released the buffer before submitting its release point. */
+   bool release_pending{ false };
+
+   /* Swapchain the release events of @ref buffer_release are delivered to. */
+   swapchain *owner{ nullptr };
+   /* Release object for the last commit of this buffer, when using zwp_linux_surface_synchronization_v1. */
+   wayland_owner<zwp_linux_buffer_release_v1> buffer_release;
+   /* Fence the compositor gave with the last release, or the exported release point, signalled once it has finished
+    * reading the buffer. */
+   util::fd_owner release_fence;
 };
 
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+/**
+ * @brief A DRM timeline syncobj imported into the compositor.
+ */
+struct wayland_timeline_syncobj
+{
+   uint32_t handle{ 0 };
+   wayland_owner<wp_linux_drm_syncobj_timeline_v1> timeline;
+};
+#endif
+
 struct image_creation_parameters
 {
    wsialloc_format m_allocated_format;
@@ -90,6 +127,23 @@ public:
    /* TODO: make the buffer destructor a friend? so this can be protected */
    void release_buffer(struct wl_buffer *wl_buffer);
 
+   /**
+    * @brief Handle the release of a buffer through its zwp_linux_buffer_release_v1 object.
+    *
+    * @param image_data   The released image.
+    * @param release_fence Fence signalled once the compositor has finished reading the buffer, or -1 if it already
+    *                      has. Ownership is transferred to the swapchain.
+    */
+   void release_buffer_fenced(wayland_image_data *image_data, int release_fence);
+
+   /**
+    * @brief Handle the presentation feedback of a FIFO_RELAXED commit.
+    *
+    * @param present_time_ns Time the commit was shown, in the wp_presentation clock, or 0 if it was discarded.
+    * @param refresh_ns      Refresh interval of the output, or 0 if it is unknown.
+    */
+   void relaxed_feedback_done(uint64_t present_time_ns, uint32_t refresh_ns);
+
 protected:
    /**
     * @brief Initialize platform specifics.
@@ -107,6 +161,17 @@ protected:
     */
    VkResult allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image) override;
 
+   bool supports_parallel_image_creation() const override
+   {
+      return true;
+   }
+
+   VkResult allocate_swapchain_image_buffer(swapchain_image &image) override;
+
+   VkResult export_swapchain_image(const VkImageCreateInfo &image_create_info, swapchain_image &image) override;
+
+   VkResult import_swapchain_image_buffer(swapchain_image &image) override;
+
    /**
     * @brief Creates a new swapchain image.
     *
@@ -168,6 +233,42 @@ protected:
 
    VkResult image_wait_present(swapchain_image &image, uint64_t timeout) override;
 
+   int image_get_present_sync_fd(swapchain_image &image) override;
+
+   util::fd_owner image_take_release_sync_fd(swapchain_image &image) override;
+
+   bool supports_present_payload_import() override
+   {
+      return true;
+   }
+
+   VkResult image_import_present_payload(swapchain_image &image, VkFence fence) override;
+
+   VkResult image_get_shareable_present_payload(swapchain_image &image, int &sync_fd) override;
+
+   VkResult image_set_shared_present_payload(swapchain_image &image, VkQueue queue, int sync_fd) override;
+
+   bool adopt_ancestor_image(swapchain_base &ancestor, swapchain_image &image) override;
+
+   /* Once the presents are handed over, the teardown only waits for the releases on the queue of the swapchain. */
+   bool supports_deferred_teardown() const override
+   {
+      return true;
+   }
+
+   bool is_surface_occluded() override
+   {
+      /* A hidden surface is checked again, so that acquires stop being throttled as soon as the frame event of the
+       * visibility check arrives rather than at the next present. */
+      if (!m_surface_occluded.load(std::memory_order_relaxed))
+      {
+         return false;
+      }
+      const bool occluded = m_wsi_surface->is_occluded();
+      m_surface_occluded.store(occluded, std::memory_order_relaxed);
+      return occluded;
+   }
+
    /**
     * @brief Bind image to a swapchain
     *
@@ -182,8 +283,116 @@ protected:
                                  const VkBindImageMemorySwapchainInfoKHR *bind_sc_info) override;
 
 private:
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   /**
+    * @brief Create the acquire and release timelines used with the surface's wp_linux_drm_syncobj_surface_v1.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult init_drm_syncobj();
+
+   /**
+    * @brief Destroy the acquire and release timelines.
+    */
+   void destroy_drm_syncobj();
+
+   /**
+    * @brief Transfer the present payload of an image to the next point of the acquire timeline and set the acquire
+    *        and release points for the next commit.
+    *
+    * @param image_data The image being presented.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult set_syncobj_points(wayland_image_data *image_data);
+
+   /**
+    * @brief Hand the release point of an image the compositor has released over to acquire as its release fence.
+    *
+    * Does not block. If the compositor has not submitted the point yet, the image stays presented and
+    * @ref m_release_eventfd is signalled once it is, see @ref collect_release_points.
+    *
+    * @param image_data The image released by the compositor. Must be called with @ref m_release_points_lock held.
+    *
+    * @return true if the image can be unpresented, false if its release point is still pending.
+    */
+   bool export_release_point(wayland_image_data *image_data);
+
+   /**
+    * @brief Unpresent the images whose release point has been submitted since their wl_buffer.release.
+    *
+    * @return true if there are still images waiting for their release point.
+    */
+   bool collect_release_points();
+#endif
+
+   /**
+    * @brief Whether the compositor waits for the present payloads, so there is no need to wait for them before
+    *        committing.
+    */
+   bool uses_explicit_sync() const;
+
+   /**
+    * @brief Whether presents with @p present_mode are throttled by the compositor with wp_fifo_v1 barriers, instead
+    *        of waiting for frame events before each present. Only FIFO presents are.
+    */
+   bool uses_fifo_barrier(VkPresentModeKHR present_mode) const;
+
+   /**
+    * @brief Whether a FIFO_RELAXED present missed the refresh after the last presented commit, in which case it is
+    *        shown as soon as possible rather than held back for another refresh.
+    *
+    * A present is never late without presentation feedback, or while the previous commit has not been shown yet.
+    */
+   bool is_present_late();
+
+   /**
+    * @brief Request presentation feedback for the next commit of a FIFO_RELAXED present.
+    */
+   void request_relaxed_feedback();
+
+   /**
+    * @brief Set the wp_viewport destination of the surface from the present scaling the swapchain was created with.
+    *
+    * @param swapchain_create_info The create info of the swapchain.
+    *
+    * @return VK_SUCCESS on success, VK_ERROR_INITIALIZATION_FAILED if stretching is requested without a valid
+    *         scaled extent or the viewport of the surface cannot be created.
+    */
+   VkResult init_viewport_destination(const VkSwapchainCreateInfoKHR *swapchain_create_info);
+
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   /**
+    * @brief Set the wp_tearing_control_v1 presentation hint of the next commit, if the compositor supports it. Only
+    *        IMMEDIATE presents and late FIFO_RELAXED presents may tear.
+    *
+    * @param async Whether the next commit may tear.
+    */
+   void set_tearing_hint(bool async);
+#endif
+
+   /**
+    * @brief Request a zwp_linux_buffer_release_v1 for the buffer attached in the next commit.
+    *
+    * @param image_data The image being presented.
+    *
+    * @return true on success, false otherwise.
+    */
+   bool set_buffer_release(wayland_image_data *image_data);
+
    VkResult create_wl_buffer(const VkImageCreateInfo &image_create_info, swapchain_image &image,
                              wayland_image_data *image_data);
+
+   /**
+    * @brief Bind an image to host memory and create a wl_shm buffer sharing the memory with the compositor.
+    *
+    * @param image      The image, created with the create info filled by @ref init_shm.
+    * @param image_data The data of the image.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult create_shm_buffer(swapchain_image &image, wayland_image_data *image_data);
+
    VkResult allocate_image(wayland_image_data *image_data);
    VkResult allocate_wsialloc(VkImageCreateInfo &image_create_info, wayland_image_data *image_data,
                               util::vector<wsialloc_format> &importable_formats, wsialloc_format *allocated_format,
@@ -207,16 +416,122 @@ private:
    /* The queue on which we dispatch buffer related events, mostly buffer_release */
    struct wl_event_queue *m_buffer_queue;
 
+#if WAYLAND_EVENT_THREAD_ENABLED
+   /**
+    * @brief The surface's event thread while it dispatches @ref m_buffer_queue, nullptr otherwise.
+    *
+    * The buffer release handlers then run on the event thread and acquire only waits for the free image semaphore.
+    */
+   event_thread *m_event_thread;
+#endif
+
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   /**
+    * @brief The surface's wp_linux_drm_syncobj_surface_v1, or nullptr when not using timeline syncobjs.
+    *
+    * When set, the present payloads are given to the compositor as points on @ref m_acquire_timeline, and buffers
+    * are only reused once the matching point on @ref m_release_timeline is signalled.
+    */
+   wp_linux_drm_syncobj_surface_v1 *m_syncobj_surface;
+   int m_drm_fd;
+   wayland_timeline_syncobj m_acquire_timeline;
+   wayland_timeline_syncobj m_release_timeline;
+   /* Binary syncobj used to import the present payloads before transferring them to the acquire timeline. */
+   uint32_t m_transfer_syncobj;
+   /* Binary syncobj used to export the release points to sync FDs, only used with @ref m_release_points_lock held. */
+   uint32_t m_release_syncobj;
+   uint64_t m_timeline_point;
+   /* Signalled when the release point of a pending image is submitted, or when a buffer is released. */
+   util::fd_owner m_release_eventfd;
+   /* Protects the release points of the images and @ref m_pending_release_count. */
+   std::mutex m_release_points_lock;
+   /* Number of images released by the compositor whose release point has not been submitted yet. */
+   uint32_t m_pending_release_count;
+#endif
+
+   /**
+    * @brief Whether the surface was hidden at the last present or the last throttled acquire, see
+    *        @ref surface::is_occluded. Only updated when acquires are throttled while the surface is hidden.
+    */
+   std::atomic<bool> m_surface_occluded{ false };
+
+   /**
+    * @brief Lateness of FIFO_RELAXED presents, see @ref is_present_late. Only used by present_image, which
+    *        dispatches the feedback queue itself, so the presentation times need no lock.
+    */
+   wayland_owner<wl_event_queue> m_relaxed_feedback_queue;
+   /** Feedback of the last FIFO_RELAXED commit, until the compositor presents or discards it. */
+   wayland_owner<wp_presentation_feedback> m_relaxed_feedback;
+   uint64_t m_last_presentation_ns{ 0 };
+   uint32_t m_refresh_interval_ns{ 0 };
+
+   /**
+    * @brief Size the compositor scales the images to, or -1 when they are presented unscaled. Set on the surface
+    *        viewport with the commit of the first present.
+    */
+   int32_t m_viewport_width{ -1 };
+   int32_t m_viewport_height{ -1 };
+   bool m_viewport_pending{ false };
+
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   /**
+    * @brief Whether the tearing hint of the surface was last set to async. Only used by present_image after
+    *        initialization.
+    */
+   bool m_tearing_hint_async;
+#endif
+
    /**
     * @brief Handle to the WSI allocator.
     */
    wsialloc_allocator *m_wsi_allocator;
 
+   /**
+    * @brief Buffers of the swapchain images allocated together on the first allocation.
+    */
+   wsialloc_batch m_batch_allocations;
+
    /**
     * @brief Image creation parameters used for all swapchain images.
     */
    struct image_creation_parameters m_image_creation_parameters;
 
+   /**
+    * @brief Copies of the images into linear buffers, when the compositor cannot import the images the device
+    *        renders to. In that case the wl_buffers wrap the linear buffers rather than the images.
+    */
+   util::unique_ptr<prime_copy> m_prime_copy;
+
+   /**
+    * @brief Set the swapchain up to present through linear copies of the images.
+    *
+    * @param[in,out] image_create_info The create info of the images, turned into the one of locally rendered images.
+    *
+    * @return VK_SUCCESS on success, VK_ERROR_INITIALIZATION_FAILED if the compositor does not accept linear buffers
+    *         of the format or the device cannot import them, otherwise an appropriate error code.
+    */
+   VkResult init_prime_copy(VkImageCreateInfo &image_create_info);
+
+   /**
+    * @brief Whether the images are presented through wl_shm buffers.
+    *
+    * The images are then linear and bound to host memory the compositor reads from directly, so presenting makes no
+    * copy. Buffers are released through wl_buffer.release and the compositor is not given any fence, so the present
+    * payloads are waited for before committing.
+    */
+   bool m_shm;
+
+   /**
+    * @brief Set the swapchain up to present through wl_shm buffers.
+    *
+    * @param[in,out] image_create_info The create info of the images, turned into the one of linear images bound to
+    *                                  host memory.
+    *
+    * @return VK_SUCCESS on success, VK_ERROR_INITIALIZATION_FAILED if the compositor or the device cannot share
+    *         images of the format through host memory.
+    */
+   VkResult init_shm(VkImageCreateInfo &image_create_info);
+
    /**
     * @brief Finds what formats are compatible with the requested swapchain image Vulkan Device and Wayland surface.
     *
@@ -34,10 +34,10 @@
 
 #include "util/log.hpp"
 
-int dispatch_queue(struct wl_display *display, struct wl_event_queue *queue, int timeout)
+int dispatch_queue(struct wl_display *display, struct wl_event_queue *queue, int timeout, int wake_fd)
 {
    int err;
-   struct pollfd pfd = {};
+   struct pollfd pfd[2] = {};
    int retval;
 
    /* Before we sleep, dispatch any pending events. prepare_read_queue will return 0 whilst there are pending
@@ -55,8 +55,11 @@ int dispatch_queue(struct wl_display *display, struct wl_event_queue *queue, int
    }
 
    /* wl_display_read_events performs a non-blocking read. */
-   pfd.fd = wl_display_get_fd(display);
-   pfd.events = POLLIN;
+   pfd[0].fd = wl_display_get_fd(display);
+   pfd[0].events = POLLIN;
+   /* poll ignores negative file descriptors. */
+   pfd[1].fd = wake_fd;
+   pfd[1].events = POLLIN;
    while (true)
    {
       /* Timeout is given in milliseconds. A return value of 0, or -1 with errno set to EINTR means that we
@@ -64,7 +67,7 @@ int dispatch_queue(struct wl_display *display, struct wl_event_queue *queue, int
        * return value of 1 means that something happened, and we should inspect the pollfd structure to see
        * just what that was.
        */
-      err = poll(&pfd, 1, timeout);
+      err = poll(pfd, 2, timeout);
       if (0 == err)
       {
          /* Timeout. */
@@ -87,7 +90,13 @@ int dispatch_queue(struct wl_display *display, struct wl_event_queue *queue, int
       }
       else
       {
-         if (POLLIN == pfd.revents)
+         if (pfd[1].revents != 0)
+         {
+            /* The caller has something else to check, leave the events to the next dispatch. */
+            wl_display_cancel_read(display);
+            return 1;
+         }
+         else if (POLLIN == pfd[0].revents)
          {
             /* We have data to read, and no errors; proceed to read_events. */
             break;
@@ -45,7 +45,8 @@
  * @param  queue   Event queue to dispatch events from; other event queues will not have their handlers called from
  *                 within this function
  * @param  timeout Maximum time to wait for events to arrive, in milliseconds
- * @return         1 if one or more events were dispatched on this queue, 0 if the timeout was reached without any
- *                 events being dispatched, or -1 on error.
+ * @param  wake_fd Optional file descriptor polled along with the display, which stops the wait once readable
+ * @return         1 if one or more events were dispatched on this queue or @p wake_fd became readable, 0 if the timeout
+ *                 was reached without any events being dispatched, or -1 on error.
  */
-int dispatch_queue(struct wl_display *display, struct wl_event_queue *queue, int timeout);
+int dispatch_queue(struct wl_display *display, struct wl_event_queue *queue, int timeout, int wake_fd = -1);
@@ -29,6 +29,7 @@
 
 #include "wsi_factory.hpp"
 #include "surface.hpp"
+#include "swapchain_reaper.hpp"
 
 #if BUILD_WSI_HEADLESS
 #include "headless/surface_properties.hpp"
@@ -146,36 +147,17 @@ util::wsi_platform_set find_enabled_layer_platforms(const VkInstanceCreateInfo *
    return ret;
 }
 
-static VkResult get_available_device_extensions(VkPhysicalDevice physical_device,
-                                                util::extension_list &available_extensions)
-{
-   auto &instance_data = layer::instance_private_data::get(physical_device);
-   util::vector<VkExtensionProperties> properties{ available_extensions.get_allocator() };
-   uint32_t count = 0;
-   TRY_LOG(instance_data.disp.EnumerateDeviceExtensionProperties(physical_device, nullptr, &count, nullptr),
-           "Failed to enumurate properties of available physical device extensions");
-
-   if (!properties.try_resize(count))
-   {
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
-   }
-
-   TRY_LOG(instance_data.disp.EnumerateDeviceExtensionProperties(physical_device, nullptr, &count, properties.data()),
-           "Failed to enumurate properties of available physical device extensions");
-   TRY_LOG_CALL(available_extensions.add(properties.data(), count));
-
-   return VK_SUCCESS;
-}
-
 VkResult add_device_extensions_required_by_layer(VkPhysicalDevice phys_dev,
                                                  const util::wsi_platform_set enabled_platforms,
                                                  util::extension_list &extensions_to_enable)
 {
    util::allocator allocator{ extensions_to_enable.get_allocator(), VK_SYSTEM_ALLOCATION_SCOPE_COMMAND };
 
-   util::extension_list available_device_extensions{ allocator };
-   TRY_LOG(get_available_device_extensions(phys_dev, available_device_extensions),
+   auto &instance_data = layer::instance_private_data::get(phys_dev);
+   const util::extension_list *available_extensions = nullptr;
+   TRY_LOG(instance_data.get_available_device_extensions(phys_dev, available_extensions),
            "Failed to acquire available device extensions");
+   const util::extension_list &available_device_extensions = *available_extensions;
 
    /* Add optional extensions independent of winsys. */
    {
@@ -184,9 +166,6 @@ VkResult add_device_extensions_required_by_layer(VkPhysicalDevice phys_dev,
          VK_KHR_EXTERNAL_FENCE_FD_EXTENSION_NAME,
          VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME,
          VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
-#if ENABLE_INSTRUMENTATION
-         VK_EXT_FRAME_BOUNDARY_EXTENSION_NAME,
-#endif
       };
 
       for (auto extension : optional_extensions)
@@ -196,6 +175,13 @@ VkResult add_device_extensions_required_by_layer(VkPhysicalDevice phys_dev,
             TRY_LOG_CALL(extensions_to_enable.add(extension));
          }
       }
+
+      const auto &settings = instance_data.get_layer_settings();
+      if (settings.instrumentation_level >= 1 &&
+          available_device_extensions.contains(VK_EXT_FRAME_BOUNDARY_EXTENSION_NAME))
+      {
+         TRY_LOG_CALL(extensions_to_enable.add(VK_EXT_FRAME_BOUNDARY_EXTENSION_NAME));
+      }
    }
 
    for (const auto &wsi_ext : supported_wsi_extensions)
@@ -228,6 +214,19 @@ VkResult add_device_extensions_required_by_layer(VkPhysicalDevice phys_dev,
       }
 
       TRY_LOG_CALL(extensions_to_enable.add(extensions_required_by_layer));
+
+      util::extension_list optional_extensions{ allocator };
+      TRY_LOG(props->get_optional_device_extensions(optional_extensions),
+              "Failed to acquire optional device extensions");
+      util::vector<const char *> optional_extension_names{ allocator };
+      TRY_LOG_CALL(optional_extensions.get_extension_strings(optional_extension_names));
+      for (const char *extension : optional_extension_names)
+      {
+         if (available_device_extensions.contains(extension))
+         {
+            TRY_LOG_CALL(extensions_to_enable.add(extension));
+         }
+      }
    }
 
    return VK_SUCCESS;
@@ -271,6 +270,17 @@ void destroy_surface_swapchain(swapchain_base *swapchain, layer::device_private_
    assert(swapchain);
 
    util::allocator alloc{ dev_data.get_allocator(), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, pAllocator };
+
+   /* The callbacks of the application must not be called once vkDestroySwapchainKHR returns, so only swapchains that
+    * use the allocator of the device can be freed later on. */
+   if (pAllocator == nullptr && dev_data.instance_data.get_layer_settings().deferred_swapchain_destruction)
+   {
+      auto *reaper = dev_data.get_swapchain_reaper();
+      if (reaper != nullptr && swapchain->detach_for_deferred_teardown() && reaper->defer_destruction(swapchain, alloc))
+      {
+         return;
+      }
+   }
    alloc.destroy(1, swapchain);
 }
 
@@ -63,6 +63,10 @@ util::unique_ptr<swapchain_base> allocate_surface_swapchain(VkSurfaceKHR surface
 /**
  * @brief Destroys a swapchain and frees memory. Used with @ref allocate_surface_swapchain.
  *
+ * When the deferred_swapchain_destruction setting is enabled, swapchains created without allocation callbacks of the
+ * application are detached from the device, and the rest of their teardown is handed over to the swapchain reaper of
+ * the device, when their backend supports it.
+ *
  * @param swapchain  Pointer to the swapchain to destroy.
  * @param dev_data   The device specific data.
  * @param pAllocator The allocator to use for freeing memory.
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file wsialloc_batch.cpp
+ *
+ * @brief Contains the wsialloc helpers shared by the swapchains, such as the buffers of swapchain images allocated
+ *        together.
+ */
+
+#include "wsialloc_batch.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utility>
+
+#include "layer/private_data.hpp"
+#include "util/drm/drm_utils.hpp"
+#include "util/log.hpp"
+
+namespace wsi
+{
+
+namespace
+{
+/**
+ * @brief The wsialloc allocator shared by the swapchains of a device.
+ */
+struct shared_allocator
+{
+   VkDevice device;
+   wsialloc_allocator *allocator;
+   uint32_t ref_count;
+   shared_allocator *next;
+};
+
+/** Protects the list of shared allocators and their reference counts. */
+std::mutex shared_allocator_list_lock;
+/** Allocators of all the devices that have swapchains allocating with wsialloc. */
+shared_allocator *shared_allocator_list = nullptr;
+} // namespace
+
+wsialloc_error create_wsialloc_allocator(layer::instance_private_data &instance_data, VkPhysicalDevice physical_device,
+                                         wsialloc_allocator **allocator)
+{
+   int64_t render_major = 0;
+   int64_t render_minor = 0;
+   if (instance_data.get_render_node(physical_device, render_major, render_minor))
+   {
+      return wsialloc_new_for_device(allocator, render_major, render_minor);
+   }
+   return wsialloc_new(allocator);
+}
+
+wsialloc_error create_wsialloc_allocator(layer::device_private_data &device_data, wsialloc_allocator **allocator)
+{
+   return create_wsialloc_allocator(device_data.instance_data, device_data.physical_device, allocator);
+}
+
+wsialloc_error acquire_shared_wsialloc_allocator(layer::device_private_data &device_data,
+                                                 wsialloc_allocator **allocator)
+{
+   std::lock_guard<std::mutex> lock(shared_allocator_list_lock);
+   for (shared_allocator *shared = shared_allocator_list; shared != nullptr; shared = shared->next)
+   {
+      if (shared->device == device_data.device)
+      {
+         shared->ref_count++;
+         *allocator = shared->allocator;
+         return WSIALLOC_ERROR_NONE;
+      }
+   }
+
+   const util::allocator &generic_allocator = util::allocator::get_generic();
+   auto *shared = generic_allocator.create<shared_allocator>(1);
+   if (shared == nullptr)
+   {
+      return WSIALLOC_ERROR_NO_RESOURCE;
+   }
+
+   const wsialloc_error res = create_wsialloc_allocator(device_data, &shared->allocator);
+   if (res != WSIALLOC_ERROR_NONE)
+   {
+      generic_allocator.destroy(1, shared);
+      return res;
+   }
+
+   const uint64_t cache_budget = device_data.instance_data.get_layer_settings().allocator_cache_budget;
+   if (cache_budget != 0 && wsialloc_set_cache_budget(shared->allocator, cache_budget) != WSIALLOC_ERROR_NONE)
+   {
+      WSI_LOG_WARNING("The wsi allocator does not support caching released buffers.");
+   }
+
+   shared->device = device_data.device;
+   shared->ref_count = 1;
+   shared->next = shared_allocator_list;
+   shared_allocator_list = shared;
+   *allocator = shared->allocator;
+   return WSIALLOC_ERROR_NONE;
+}
+
+void release_shared_wsialloc_allocator(layer::device_private_data &device_data, wsialloc_allocator *allocator,
+                                       bool replaced)
+{
+   if (allocator == nullptr)
+   {
+      return;
+   }
+
+   shared_allocator *shared = nullptr;
+   {
+      std::lock_guard<std::mutex> lock(shared_allocator_list_lock);
+      shared_allocator **link = &shared_allocator_list;
+      while (*link != nullptr && (*link)->device != device_data.device)
+      {
+         link = &(*link)->next;
+      }
+      assert(*link != nullptr && (*link)->allocator == allocator);
+      if (*link == nullptr)
+      {
+         return;
+      }
+
+      assert((*link)->ref_count > 0);
+      if (--(*link)->ref_count > 0)
+      {
+         if (!replaced)
+         {
+            wsialloc_cache_trim(allocator, 0);
+         }
+         return;
+      }
+
+      shared = *link;
+      *link = shared->next;
+   }
+
+   /* Deleting the allocator closes the buffers left in its cache. */
+   wsialloc_delete(shared->allocator);
+   util::allocator::get_generic().destroy(1, shared);
+}
+
+void sort_formats_by_compression(util::vector<wsialloc_format> &formats,
+                                 const util::vector<util::drm_format_modifier_support> &supported_modifiers)
+{
+   auto get_rank = [&supported_modifiers](const wsialloc_format &format) {
+      for (const auto &modifier : supported_modifiers)
+      {
+         if (modifier.modifier_properties.drmFormatModifier == format.modifier)
+         {
+            return util::drm::get_modifier_compression_rank(format.modifier, modifier.fixed_rate_flags);
+         }
+      }
+      return 0u;
+   };
+   std::stable_sort(formats.begin(), formats.end(), [&get_rank](const wsialloc_format &lhs, const wsialloc_format &rhs) {
+      return get_rank(lhs) > get_rank(rhs);
+   });
+}
+
+void close_wsialloc_buffer(const wsialloc_allocate_result &allocation)
+{
+   for (int plane = 0; plane < WSIALLOC_MAX_PLANES; plane++)
+   {
+      const int fd = allocation.buffer_fds[plane];
+      const int *previous_planes_end = allocation.buffer_fds + plane;
+      if (fd >= 0 && std::find(allocation.buffer_fds, previous_planes_end, fd) == previous_planes_end)
+      {
+         close(fd);
+      }
+   }
+}
+
+wsialloc_buffer_ref::wsialloc_buffer_ref()
+   : m_flags(0)
+{
+   m_fds.fill(-1);
+}
+
+wsialloc_buffer_ref::wsialloc_buffer_ref(wsialloc_buffer_ref &&rhs)
+   : wsialloc_buffer_ref()
+{
+   *this = std::move(rhs);
+}
+
+wsialloc_buffer_ref &wsialloc_buffer_ref::operator=(wsialloc_buffer_ref &&rhs)
+{
+   std::swap(m_fds, rhs.m_fds);
+   std::swap(m_flags, rhs.m_flags);
+   return *this;
+}
+
+wsialloc_buffer_ref::~wsialloc_buffer_ref()
+{
+   reset();
+}
+
+bool wsialloc_buffer_ref::keep(const wsialloc_allocate_result &allocation, uint64_t flags)
+{
+   reset();
+   for (int plane = 0; plane < WSIALLOC_MAX_PLANES; plane++)
+   {
+      const int fd = allocation.buffer_fds[plane];
+      const int *previous_planes_end = allocation.buffer_fds + plane;
+      if (fd < 0 || std::find(allocation.buffer_fds, previous_planes_end, fd) != previous_planes_end)
+      {
+         continue;
+      }
+
+      m_fds[plane] = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+      if (m_fds[plane] < 0)
+      {
+         reset();
+         return false;
+      }
+   }
+
+   m_flags = flags;
+   return true;
+}
+
+void wsialloc_buffer_ref::release(wsialloc_allocator *allocator)
+{
+   assert(allocator != nullptr || std::all_of(m_fds.begin(), m_fds.end(), [](int fd) { return fd < 0; }));
+   for (auto &fd : m_fds)
+   {
+      if (fd >= 0)
+      {
+         wsialloc_release(allocator, m_flags, fd);
+         fd = -1;
+      }
+   }
+}
+
+void wsialloc_buffer_ref::reset()
+{
+   for (auto &fd : m_fds)
+   {
+      if (fd >= 0)
+      {
+         close(fd);
+         fd = -1;
+      }
+   }
+}
+
+wsialloc_batch::wsialloc_batch(const util::allocator &allocator)
+   : m_count(1)
+   , m_allocations(allocator)
+{
+}
+
+wsialloc_batch::~wsialloc_batch()
+{
+   release_unused();
+}
+
+void wsialloc_batch::set_count(uint32_t count)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   m_count = count;
+}
+
+bool wsialloc_batch::add(const wsialloc_allocate_result &allocation)
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   return m_allocations.try_push_back(allocation);
+}
+
+wsialloc_error wsialloc_batch::allocate(wsialloc_allocator *wsi_allocator, const wsialloc_allocate_info &alloc_info,
+                                        wsialloc_allocate_result &alloc_result)
+{
+   if (alloc_info.flags & WSIALLOC_ALLOCATE_NO_MEMORY)
+   {
+      return wsialloc_alloc(wsi_allocator, &alloc_info, &alloc_result);
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (m_count > 1)
+      {
+         const uint32_t count = m_count;
+         m_count = 1;
+         if (!m_allocations.try_resize(count, alloc_result))
+         {
+            return WSIALLOC_ERROR_NO_RESOURCE;
+         }
+
+         const auto res = wsialloc_alloc_batch(wsi_allocator, &alloc_info, count, m_allocations.data());
+         if (res != WSIALLOC_ERROR_NONE)
+         {
+            m_allocations.clear();
+            return res;
+         }
+      }
+
+      if (!m_allocations.empty())
+      {
+         alloc_result = m_allocations.back();
+         m_allocations.pop_back();
+         return WSIALLOC_ERROR_NONE;
+      }
+   }
+
+   return wsialloc_alloc(wsi_allocator, &alloc_info, &alloc_result);
+}
+
+void wsialloc_batch::release_unused()
+{
+   std::lock_guard<std::mutex> lock(m_lock);
+   for (const auto &allocation : m_allocations)
+   {
+      close_wsialloc_buffer(allocation);
+   }
+   m_allocations.clear();
+}
+
+} /* namespace wsi */
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2025 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file wsialloc_batch.hpp
+ *
+ * @brief Contains the wsialloc helpers shared by the swapchains, such as the buffers of swapchain images allocated
+ *        together.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+#include "util/custom_allocator.hpp"
+#include "util/format_modifiers.hpp"
+#include "util/helpers.hpp"
+#include "util/wsialloc/wsialloc.h"
+
+namespace layer
+{
+class instance_private_data;
+class device_private_data;
+} /* namespace layer */
+
+namespace wsi
+{
+
+/**
+ * @brief Create a wsialloc allocator for the buffers of a device, on its render node when the ICD reports one.
+ *
+ * @param device_data    The device the swapchain images are rendered by.
+ * @param[out] allocator The new allocator.
+ *
+ * @return The result of wsialloc_new_for_device() or wsialloc_new().
+ */
+wsialloc_error create_wsialloc_allocator(layer::device_private_data &device_data, wsialloc_allocator **allocator);
+
+/**
+ * @brief Create a wsialloc allocator for the buffers of a physical device, see the overload taking the device.
+ */
+wsialloc_error create_wsialloc_allocator(layer::instance_private_data &instance_data, VkPhysicalDevice physical_device,
+                                         wsialloc_allocator **allocator);
+
+/**
+ * @brief Get the wsialloc allocator shared by the swapchains of a device, creating it for the first one.
+ *
+ * Sharing the allocator lets a swapchain reuse the buffers that the swapchain it replaces gave back to the cache of
+ * the allocator. Each successful call must be paired with a call to @ref release_shared_wsialloc_allocator.
+ *
+ * @param device_data    The device the swapchain images are rendered by.
+ * @param[out] allocator The allocator of the device.
+ *
+ * @return WSIALLOC_ERROR_NONE on success, otherwise the error of creating the allocator.
+ */
+wsialloc_error acquire_shared_wsialloc_allocator(layer::device_private_data &device_data,
+                                                 wsialloc_allocator **allocator);
+
+/**
+ * @brief Drop a reference taken with @ref acquire_shared_wsialloc_allocator, deleting the allocator with the last one.
+ *
+ * @param device_data The device the allocator was acquired for.
+ * @param allocator   The allocator, nullptr is ignored.
+ * @param replaced    Whether the swapchain releasing the allocator was replaced by a new one, which may reuse the
+ *                    buffers it gave back. Otherwise the application stopped presenting to the surface, so the cached
+ *                    buffers are closed.
+ */
+void release_shared_wsialloc_allocator(layer::device_private_data &device_data, wsialloc_allocator *allocator,
+                                       bool replaced);
+
+/**
+ * @brief Order the formats given to wsialloc so that the most compressed modifiers come first.
+ *
+ * The allocator picks the first format it can allocate. Formats whose modifiers compress equally keep their order.
+ *
+ * @param[in,out] formats             The formats.
+ * @param         supported_modifiers The modifiers the formats were selected from, as queried with an image
+ *                                    compression control.
+ */
+void sort_formats_by_compression(util::vector<wsialloc_format> &formats,
+                                 const util::vector<util::drm_format_modifier_support> &supported_modifiers);
+
+/**
+ * @brief Close the file descriptors of a buffer allocated by wsialloc, once each as planes may share them.
+ */
+void close_wsialloc_buffer(const wsialloc_allocate_result &allocation);
+
+/**
+ * @brief The buffer of a swapchain image, kept to give it back to the cache of its allocator.
+ *
+ * Importing a buffer into Vulkan consumes its file descriptors, so the image keeps duplicates of them. The buffer is
+ * closed when it is not given back with @ref release.
+ */
+class wsialloc_buffer_ref : private util::noncopyable
+{
+public:
+   wsialloc_buffer_ref();
+   wsialloc_buffer_ref(wsialloc_buffer_ref &&rhs);
+   wsialloc_buffer_ref &operator=(wsialloc_buffer_ref &&rhs);
+   ~wsialloc_buffer_ref();
+
+   /**
+    * @brief Duplicate the file descriptors of a buffer, once each as planes may share them.
+    *
+    * @param allocation The buffer.
+    * @param flags      The flags the buffer was allocated with.
+    *
+    * @return true on success, false if the file descriptors could not be duplicated, in which case none is kept.
+    */
+   bool keep(const wsialloc_allocate_result &allocation, uint64_t flags);
+
+   /**
+    * @brief Give the buffer back to the allocator it was allocated from, which may hand it out again.
+    *
+    * Must only be called once neither Vulkan nor the window system uses the buffer any more.
+    */
+   void release(wsialloc_allocator *allocator);
+
+   /**
+    * @brief Close the buffer without giving it back.
+    */
+   void reset();
+
+private:
+   /** Duplicates of the unique file descriptors of the buffer, -1 for the unused entries. */
+   std::array<int, WSIALLOC_MAX_PLANES> m_fds;
+
+   /** The flags the buffer was allocated with. */
+   uint64_t m_flags;
+};
+
+/**
+ * @brief Buffers of the images of a swapchain allocated by one wsialloc_alloc_batch() call.
+ *
+ * When every image of a swapchain is allocated at creation, the first allocation makes the buffers of all of them
+ * at once and the following ones are handed a buffer from the batch. Buffers that were not handed to an image, which
+ * only happens when creating the swapchain failed, are closed by @ref release_unused.
+ */
+class wsialloc_batch : private util::noncopyable
+{
+public:
+   explicit wsialloc_batch(const util::allocator &allocator);
+   ~wsialloc_batch();
+
+   /**
+    * @brief Set the number of buffers the next allocation makes, 1 to allocate the buffers one at a time.
+    */
+   void set_count(uint32_t count);
+
+   /**
+    * @brief Hand over a buffer allocated ahead of the swapchain, to be given to an image by @ref allocate.
+    *
+    * @return true on success, false if memory could not be allocated.
+    */
+   bool add(const wsialloc_allocate_result &allocation);
+
+   /**
+    * @brief Allocate the buffer of an image, taking it from the batch if there is one.
+    *
+    * Allocations with WSIALLOC_ALLOCATE_NO_MEMORY only select the format, so they never use the batch. Can be called
+    * concurrently for images created in parallel.
+    *
+    * @param wsi_allocator      The allocator of the swapchain.
+    * @param alloc_info         The allocation parameters, which must be the same for all the images.
+    * @param[out] alloc_result  The buffer of the image.
+    *
+    * @return WSIALLOC_ERROR_NONE on success, otherwise the error of the allocation.
+    */
+   wsialloc_error allocate(wsialloc_allocator *wsi_allocator, const wsialloc_allocate_info &alloc_info,
+                           wsialloc_allocate_result &alloc_result);
+
+   /**
+    * @brief Close the buffers that were not handed to an image.
+    *
+    * Must be called before deleting the allocator the buffers were allocated with.
+    */
+   void release_unused();
+
+private:
+   /** Protects the members, see "parallel_image_creation". */
+   std::mutex m_lock;
+
+   /**
+    * @brief Number of images whose buffers are allocated by the next allocation.
+    *
+    * Only greater than 1 when every swapchain image is allocated at creation. Reset to 1 once the batch is made.
+    */
+   uint32_t m_count;
+
+   /** Buffers that have not been handed to an image yet. */
+   util::vector<wsialloc_allocate_result> m_allocations;
+};
+
+} /* namespace wsi */
@@ -26,13 +26,18 @@
  * @brief Implementation of a x11 WSI Surface
  */
 
+#include <cassert>
+
 #include <xcb/xcb.h>
 #include <xcb/xproto.h>
 #include <xcb/dri3.h>
 #include <xcb/present.h>
+#include <xcb/shm.h>
+#include <xcb/xfixes.h>
 #include "surface.hpp"
 #include "swapchain.hpp"
 #include "surface_properties.hpp"
+#include "util/macros.hpp"
 
 namespace wsi
 {
@@ -60,27 +65,74 @@ surface::~surface()
 
 bool surface::init()
 {
-   auto dri3_cookie = xcb_dri3_query_version_unchecked(m_connection, 1, 2);
+   auto dri3_cookie = xcb_dri3_query_version_unchecked(m_connection, XCB_DRI3_MAJOR_VERSION, XCB_DRI3_MINOR_VERSION);
    auto dri3_reply = xcb_dri3_query_version_reply(m_connection, dri3_cookie, nullptr);
    auto has_dri3 = dri3_reply && (dri3_reply->major_version > 1 || dri3_reply->minor_version >= 2);
+   auto has_dri3_syncobj = dri3_reply && (dri3_reply->major_version > 1 || dri3_reply->minor_version >= 4);
    free(dri3_reply);
 
-   auto present_cookie = xcb_present_query_version_unchecked(m_connection, 1, 2);
+   auto present_cookie =
+      xcb_present_query_version_unchecked(m_connection, XCB_PRESENT_MAJOR_VERSION, XCB_PRESENT_MINOR_VERSION);
    auto present_reply = xcb_present_query_version_reply(m_connection, present_cookie, nullptr);
    auto has_present = present_reply && (present_reply->major_version > 1 || present_reply->minor_version >= 2);
+   auto has_present_syncobj =
+      present_reply && (present_reply->major_version > 1 || present_reply->minor_version >= 4);
    free(present_reply);
 
    if (!has_dri3 || !has_present)
    {
-      WSI_LOG_ERROR("DRI3 extension not present");
-      return false;
+      /* Remote, virtual and VNC X servers often lack DRI3, but can still share memory with local clients. */
+      auto shm_cookie = xcb_shm_query_version_unchecked(m_connection);
+      auto shm_reply = xcb_shm_query_version_reply(m_connection, shm_cookie, nullptr);
+      m_use_shm = shm_reply && (shm_reply->major_version > 1 || shm_reply->minor_version >= 2);
+      free(shm_reply);
+
+      if (!m_use_shm)
+      {
+         WSI_LOG_ERROR("Neither DRI3 and Present nor MIT-SHM 1.2 are available.");
+         return false;
+      }
+      WSI_LOG_INFO("DRI3 or Present is not available, images are presented through MIT-SHM.");
+   }
+
+   /* XFixes needs its version negotiated before any other request. */
+   auto xfixes_cookie = xcb_xfixes_query_version_unchecked(m_connection, XCB_XFIXES_MAJOR_VERSION,
+                                                            XCB_XFIXES_MINOR_VERSION);
+   auto xfixes_reply = xcb_xfixes_query_version_reply(m_connection, xfixes_cookie, nullptr);
+   m_has_xfixes = xfixes_reply && xfixes_reply->major_version >= 2;
+   free(xfixes_reply);
+
+#if WSI_X11_EXPLICIT_SYNC
+   if (has_dri3_syncobj && has_present_syncobj)
+   {
+      auto caps_cookie = xcb_present_query_capabilities_unchecked(m_connection, m_window);
+      auto caps_reply = xcb_present_query_capabilities_reply(m_connection, caps_cookie, nullptr);
+      m_has_explicit_sync = caps_reply && (caps_reply->capabilities & XCB_PRESENT_CAPABILITY_SYNCOBJ);
+      free(caps_reply);
    }
+#else
+   UNUSED(has_dri3_syncobj);
+   UNUSED(has_present_syncobj);
+#endif
 
    return true;
 }
 
 bool surface::get_size_and_depth(uint32_t *width, uint32_t *height, int *depth)
 {
+   uint64_t generation = 0;
+   {
+      std::lock_guard<std::mutex> lock(m_geometry_lock);
+      if (m_geometry_valid)
+      {
+         *width = m_width;
+         *height = m_height;
+         *depth = m_depth;
+         return true;
+      }
+      generation = m_geometry_generation;
+   }
+
    auto cookie = xcb_get_geometry(m_connection, m_window);
    if (auto *geom = xcb_get_geometry_reply(m_connection, cookie, nullptr))
    {
@@ -88,11 +140,46 @@ bool surface::get_size_and_depth(uint32_t *width, uint32_t *height, int *depth)
       *height = static_cast<uint32_t>(geom->height);
       *depth = static_cast<int>(geom->depth);
       free(geom);
+
+      std::lock_guard<std::mutex> lock(m_geometry_lock);
+      if (m_configure_listeners != 0 && generation == m_geometry_generation)
+      {
+         m_width = *width;
+         m_height = *height;
+         m_depth = *depth;
+         m_geometry_valid = true;
+      }
       return true;
    }
    return false;
 }
 
+void surface::add_configure_listener()
+{
+   std::lock_guard<std::mutex> lock(m_geometry_lock);
+   m_configure_listeners++;
+}
+
+void surface::remove_configure_listener()
+{
+   std::lock_guard<std::mutex> lock(m_geometry_lock);
+   assert(m_configure_listeners > 0);
+   if (--m_configure_listeners == 0)
+   {
+      /* Nothing keeps the cache up to date any more. */
+      m_geometry_valid = false;
+      m_geometry_generation++;
+   }
+}
+
+void surface::on_configure_notify(uint32_t width, uint32_t height)
+{
+   std::lock_guard<std::mutex> lock(m_geometry_lock);
+   m_geometry_generation++;
+   m_width = width;
+   m_height = height;
+}
+
 wsi::surface_properties &surface::get_properties()
 {
    return properties;
@@ -27,12 +27,26 @@
  */
 
 #pragma once
+#include <mutex>
 #include <vulkan/vk_icd.h>
 #include <xcb/xcb.h>
 #include <xcb/xproto.h>
+#include <xcb/dri3.h>
+#include <xcb/present.h>
 #include "wsi/surface.hpp"
 #include "surface_properties.hpp"
 
+/* Explicit sync with DRM timeline syncobjs needs the DRI3 1.4 and Present 1.4 protocol headers. */
+#if XCB_DRI3_MAJOR_VERSION > 1 || XCB_DRI3_MINOR_VERSION >= 4
+#if XCB_PRESENT_MAJOR_VERSION > 1 || XCB_PRESENT_MINOR_VERSION >= 4
+#define WSI_X11_EXPLICIT_SYNC 1
+#endif
+#endif
+
+#ifndef WSI_X11_EXPLICIT_SYNC
+#define WSI_X11_EXPLICIT_SYNC 0
+#endif
+
 namespace wsi
 {
 namespace x11
@@ -60,8 +74,35 @@ public:
    static util::unique_ptr<surface> make_surface(const util::allocator &allocator, xcb_connection_t *conn,
                                                  xcb_window_t window);
 
+   /**
+    * @brief Get the size and depth of the window.
+    *
+    * While a swapchain of the surface receives the configure notifications of the window, the geometry is cached and
+    * kept up to date from them, so only the first query makes a round trip to the X server. Once the last of them
+    * stops receiving the notifications, e.g. after its event thread exits on an error, the geometry is queried again.
+    *
+    * @return true on success, false if the geometry could not be queried.
+    */
    bool get_size_and_depth(uint32_t *width, uint32_t *height, int *depth);
 
+   /**
+    * @brief Register a swapchain that receives the configure notifications of the window.
+    */
+   void add_configure_listener();
+
+   /**
+    * @brief Unregister a swapchain added with @ref add_configure_listener.
+    */
+   void remove_configure_listener();
+
+   /**
+    * @brief Update the cached geometry from a configure notification of the window.
+    *
+    * @param width  New width of the window.
+    * @param height New height of the window.
+    */
+   void on_configure_notify(uint32_t width, uint32_t height);
+
    xcb_connection_t *get_connection()
    {
       return m_connection;
@@ -72,9 +113,55 @@ public:
       return m_window;
    };
 
+   /**
+    * @brief Whether the X server can wait for DRM syncobj timeline points given with a present.
+    *
+    * @return true if explicit sync is supported, false otherwise.
+    */
+   bool has_explicit_sync() const
+   {
+      return m_has_explicit_sync;
+   }
+
+   /**
+    * @brief Whether the X server supports XFixes regions, used as present update regions.
+    *
+    * @return true if XFixes is supported, false otherwise.
+    */
+   bool has_xfixes() const
+   {
+      return m_has_xfixes;
+   }
+
+   /**
+    * @brief Whether images are presented by copying them from shared memory with MIT-SHM.
+    *
+    * Used when the X server lacks DRI3 1.2 or Present 1.2, so that it cannot take the images as pixmaps.
+    *
+    * @return true if MIT-SHM is used, false if the images are presented as DRI3 pixmaps.
+    */
+   bool use_shm() const
+   {
+      return m_use_shm;
+   }
+
 private:
    xcb_connection_t *m_connection;
    xcb_window_t m_window;
+   bool m_has_explicit_sync{ false };
+   bool m_has_xfixes{ false };
+   bool m_use_shm{ false };
+
+   /** Cached geometry of the window, see @ref get_size_and_depth. */
+   std::mutex m_geometry_lock;
+   bool m_geometry_valid{ false };
+   uint32_t m_width{ 0 };
+   uint32_t m_height{ 0 };
+   int m_depth{ 0 };
+   /** Incremented on every change of the geometry, so that a round trip started before the change is not cached. */
+   uint64_t m_geometry_generation{ 0 };
+   /** Number of swapchains receiving the configure notifications, the cache is only used while there is one. */
+   uint32_t m_configure_listeners{ 0 };
    /** Surface properties specific to the X11 surface. */
    surface_properties properties;
 };
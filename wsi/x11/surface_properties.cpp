@@ -41,6 +41,7 @@
 #include "surface_properties.hpp"
 #include "surface.hpp"
 #include "util/macros.hpp"
+#include "util/proc_addr_table.hpp"
 
 namespace wsi
 {
@@ -49,16 +50,31 @@ namespace x11
 
 void surface_properties::populate_present_mode_compatibilities()
 {
-   std::array<present_mode_compatibility, 2> compatible_present_modes_list = {
-      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_KHR, 1, { VK_PRESENT_MODE_FIFO_KHR } },
-      present_mode_compatibility{ VK_PRESENT_MODE_MAILBOX_KHR, 1, { VK_PRESENT_MODE_MAILBOX_KHR } }
+   std::array<present_mode_compatibility, NUM_PRESENT_MODES> compatible_present_modes_list = {
+      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_KHR,
+                                  4,
+                                  { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+                                    VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR } },
+      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+                                  4,
+                                  { VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR,
+                                    VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR } },
+      present_mode_compatibility{ VK_PRESENT_MODE_MAILBOX_KHR,
+                                  4,
+                                  { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR,
+                                    VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR } },
+      present_mode_compatibility{ VK_PRESENT_MODE_IMMEDIATE_KHR,
+                                  4,
+                                  { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR,
+                                    VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR } }
    };
-   m_compatible_present_modes = compatible_present_modes<2>(compatible_present_modes_list);
+   m_compatible_present_modes = compatible_present_modes<NUM_PRESENT_MODES>(compatible_present_modes_list);
 }
 
 surface_properties::surface_properties(surface *wsi_surface, const util::allocator &allocator)
    : specific_surface(wsi_surface)
-   , m_supported_modes({ VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR })
+   , m_supported_modes({ VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+                         VK_PRESENT_MODE_IMMEDIATE_KHR })
 {
    UNUSED(allocator);
    populate_present_mode_compatibilities();
@@ -117,27 +133,28 @@ VkResult surface_properties::get_surface_capabilities(VkPhysicalDevice physical_
    return VK_SUCCESS;
 }
 
-std::vector<VkFormat> support_formats {
-   VK_FORMAT_R8G8B8A8_UNORM,
-   VK_FORMAT_B8G8R8A8_SRGB,
-   VK_FORMAT_B8G8R8A8_UNORM,
-   VK_FORMAT_R8G8B8A8_SRGB,
-   VK_FORMAT_R5G6B5_UNORM_PACK16
-};
-
 VkResult surface_properties::get_surface_formats(VkPhysicalDevice physical_device, uint32_t *surface_format_count,
                                                  VkSurfaceFormatKHR *surface_formats,
                                                  VkSurfaceFormat2KHR *extended_surface_formats)
 {
    UNUSED(physical_device);
-   std::vector<surface_format_properties> formats;
-   for (auto &format : support_formats)
+   if (specific_surface != nullptr && specific_surface->use_shm())
    {
-      if (format != VK_FORMAT_UNDEFINED)
-      {
-         formats.insert(formats.begin(), (surface_format_properties){ format });
-      }
+      /* MIT-SHM copies the images as they are, so only the layout of the X server's 24 and 32 bit visuals works. */
+      static std::array<surface_format_properties, 2> shm_formats = {
+         surface_format_properties{ VK_FORMAT_B8G8R8A8_UNORM },
+         surface_format_properties{ VK_FORMAT_B8G8R8A8_SRGB },
+      };
+      return surface_properties_formats_helper(shm_formats.begin(), shm_formats.end(), surface_format_count,
+                                               surface_formats, extended_surface_formats);
    }
+
+   /* The formats do not depend on the window, so the list is built once for all surfaces. */
+   static std::array<surface_format_properties, 5> formats = {
+      surface_format_properties{ VK_FORMAT_R5G6B5_UNORM_PACK16 }, surface_format_properties{ VK_FORMAT_R8G8B8A8_SRGB },
+      surface_format_properties{ VK_FORMAT_B8G8R8A8_UNORM },      surface_format_properties{ VK_FORMAT_B8G8R8A8_SRGB },
+      surface_format_properties{ VK_FORMAT_R8G8B8A8_UNORM },
+   };
    return surface_properties_formats_helper(formats.begin(), formats.end(), surface_format_count, surface_formats,
                                             extended_surface_formats);
 }
@@ -171,6 +188,12 @@ VkResult surface_properties::get_required_device_extensions(util::extension_list
                              sizeof(required_device_extensions) / sizeof(required_device_extensions[0]));
 }
 
+VkResult surface_properties::get_optional_device_extensions(util::extension_list &extension_list)
+{
+   /* Imports the shared memory of the images presented with MIT-SHM. */
+   return extension_list.add(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+}
+
 static const char *required_instance_extensions[] = {
    VK_KHR_EXTERNAL_FENCE_CAPABILITIES_EXTENSION_NAME,
    VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME,
@@ -309,27 +332,18 @@ GetPhysicalDeviceXlibPresentationSupportKHR(VkPhysicalDevice physicalDevice, uin
 
 PFN_vkVoidFunction surface_properties::get_proc_addr(const char *name)
 {
-   if (strcmp(name, "vkCreateXcbSurfaceKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(CreateXcbSurfaceKHR);
-   }
-   if (strcmp(name, "vkCreateXlibSurfaceKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(CreateXlibSurfaceKHR);
-   }
-   if (strcmp(name, "vkGetPhysicalDeviceSurfaceSupportKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(GetPhysicalDeviceSurfaceSupportKHR);
-   }
-   if (strcmp(name, "vkGetPhysicalDeviceXcbPresentationSupportKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(GetPhysicalDeviceXcbPresentationSupportKHR);
-   }
-   if (strcmp(name, "vkGetPhysicalDeviceXlibPresentationSupportKHR") == 0)
-   {
-      return reinterpret_cast<PFN_vkVoidFunction>(GetPhysicalDeviceXlibPresentationSupportKHR);
-   }
-   return nullptr;
+   /* Sorted by name. */
+   static constexpr util::proc_addr_entry entrypoints[] = {
+      PROC_ADDR_ENTRY(CreateXcbSurfaceKHR),
+      PROC_ADDR_ENTRY(CreateXlibSurfaceKHR),
+      PROC_ADDR_ENTRY(GetPhysicalDeviceSurfaceSupportKHR),
+      PROC_ADDR_ENTRY(GetPhysicalDeviceXcbPresentationSupportKHR),
+      PROC_ADDR_ENTRY(GetPhysicalDeviceXlibPresentationSupportKHR),
+   };
+   static_assert(util::is_sorted_by_name(entrypoints), "Entrypoints must be sorted by name");
+
+   const util::proc_addr_entry *entry = util::find_proc_addr(entrypoints, name);
+   return entry != nullptr ? entry->get_fn() : nullptr;
 }
 
 bool surface_properties::is_surface_extension_enabled(const layer::instance_private_data &instance_data)
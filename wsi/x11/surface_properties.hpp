@@ -53,6 +53,7 @@ public:
                                       uint32_t *pPresentModeCount, VkPresentModeKHR *pPresentModes) override;
 
    VkResult get_required_device_extensions(util::extension_list &extension_list) override;
+   VkResult get_optional_device_extensions(util::extension_list &extension_list) override;
 
    VkResult get_required_instance_extensions(util::extension_list &extension_list) override;
 
@@ -73,11 +74,14 @@ private:
     */
    surface *specific_surface;
 
+   /* Number of presentation modes */
+   static constexpr std::size_t NUM_PRESENT_MODES = 4;
+
    /* List of supported presentation modes */
-   std::array<VkPresentModeKHR, 2> m_supported_modes;
+   std::array<VkPresentModeKHR, NUM_PRESENT_MODES> m_supported_modes;
 
    /* Stores compatible presentation modes */
-   compatible_present_modes<2> m_compatible_present_modes;
+   compatible_present_modes<NUM_PRESENT_MODES> m_compatible_present_modes;
 
    void populate_present_mode_compatibilities() override;
 
@@ -28,17 +28,24 @@
  * @brief Contains the implementation for a x11 swapchain.
  */
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cerrno>
 #include <chrono>
+#include <cinttypes>
 #include <condition_variable>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <system_error>
 
 #include <dlfcn.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <util/timed_semaphore.hpp>
@@ -46,14 +53,20 @@
 
 #include <xcb/present.h>
 #include <xcb/dri3.h>
+#include <xcb/shm.h>
 #include <xcb/xcb.h>
+#include <xcb/xfixes.h>
 #include <xcb/xproto.h>
 
 #include "drm_display.hpp"
 #include "swapchain.hpp"
 #include "util/log.hpp"
 #include "util/macros.hpp"
+#include "util/thread.hpp"
+#include "util/trace.hpp"
 #include "wsi/external_memory.hpp"
+#include "wsi/extensions/frame_boundary.hpp"
+#include "wsi/extensions/present_id.hpp"
 #include "wsi/swapchain_base.hpp"
 
 namespace wsi
@@ -61,55 +74,291 @@ namespace wsi
 namespace x11
 {
 
-#define X11_SWAPCHAIN_MAX_PENDING_COMPLETIONS 128
-
 swapchain::swapchain(layer::device_private_data &dev_data, const VkAllocationCallbacks *pAllocator, surface &wsi_surface)
    : swapchain_base(dev_data, pAllocator)
    , m_connection(wsi_surface.get_connection())
    , m_window(wsi_surface.get_window())
    , m_wsi_surface(&wsi_surface)
    , m_wsi_allocator(nullptr)
+   , m_batch_allocations(m_allocator)
    , m_image_creation_parameters({}, m_allocator, {}, {})
    , m_send_sbc(0)
-   , m_target_msc(0)
+   , m_pending_completions()
+   , m_pending_completion_count(0)
    , m_last_present_msc(0)
+   , m_flip_count(0)
+   , m_copy_count(0)
+   , m_importable_modifiers(m_allocator)
+   , m_flip_modifier_check_time()
+   , m_min_target_msc(0)
+   , m_explicit_sync(false)
+   , m_drm_fd(-1)
+   , m_acquire_timeline()
+   , m_release_timeline()
+   , m_timeline_point(0)
+   , m_update_region(XCB_NONE)
+   , m_sent_update_region(XCB_NONE)
+   , m_sent_update_full(true)
+   , m_special_event(nullptr)
+   , m_shm(wsi_surface.use_shm())
+   , m_shm_gc(XCB_NONE)
+   , m_shm_depth(0)
+   , m_shm_completed_sbc(0)
+   , m_prime_copy(nullptr)
+   , m_present_event_thread_run(false)
    , m_thread_status_lock()
    , m_thread_status_cond()
+   , m_pixmap_batch_checked(false)
 {
    m_image_create_info.format = VK_FORMAT_UNDEFINED;
 }
 
 swapchain::~swapchain()
 {
+   /* Teardown unlinks the descendant, which may reuse the buffers this swapchain gives back to the wsialloc cache. */
+   const bool replaced = m_descendant != VK_NULL_HANDLE;
+
    auto thread_status_lock = std::unique_lock<std::mutex>(m_thread_status_lock);
 
-   if (m_present_event_thread_run)
+   m_present_event_thread_run = false;
+   m_thread_status_cond.notify_all();
+   wake_present_event_thread();
+   thread_status_lock.unlock();
+
+   /* The thread may also have stopped on its own after an error, it still needs joining. */
+   if (m_present_event_thread.joinable())
    {
-      m_present_event_thread_run = false;
-      m_thread_status_cond.notify_all();
-      thread_status_lock.unlock();
+      m_present_event_thread.join();
+   }
+
+   thread_status_lock.lock();
+
+   if (m_flip_count + m_copy_count != 0)
+   {
+      WSI_LOG_INFO("X11 swapchain %p presented %" PRIu64 " images by flipping and %" PRIu64 " by copying.",
+                   static_cast<void *>(this), m_flip_count, m_copy_count);
+   }
+
+   /* Close the buffers of a batch that were not used, which only happens when creating the swapchain failed. */
+   m_batch_allocations.release_unused();
+
+   if (m_special_event != nullptr)
+   {
+      xcb_unregister_for_special_event(m_connection, m_special_event);
+   }
+
+   if (m_configure_listener)
+   {
+      m_wsi_surface->remove_configure_listener();
+   }
 
-      if (m_present_event_thread.joinable())
+   if (m_update_region != XCB_NONE)
+   {
+      xcb_xfixes_destroy_region(m_connection, m_update_region);
+      xcb_xfixes_destroy_region(m_connection, m_sent_update_region);
+   }
+
+   if (m_shm)
+   {
+      /* Drop the replies of the MIT-SHM presents that have not completed, nothing will read them. */
+      for (auto &completion : m_pending_completions)
       {
-         m_present_event_thread.join();
+         if (completion.pending)
+         {
+            xcb_discard_reply(m_connection, completion.serial);
+            completion.pending = false;
+         }
       }
 
-      thread_status_lock.lock();
+      if (m_shm_gc != XCB_NONE)
+      {
+         xcb_free_gc(m_connection, m_shm_gc);
+      }
    }
 
-   xcb_unregister_for_special_event(m_connection, m_special_event);
-
    thread_status_lock.unlock();
 
    /* Call the base's teardown */
    teardown();
+
+   /* Teardown waited for the presents, which include the copies into the shared memory. */
+   m_prime_copy.reset();
+
+   release_shared_wsialloc_allocator(m_device_data, m_wsi_allocator, replaced);
+   m_wsi_allocator = nullptr;
+
+   if (m_window_attributes_cookie.sequence != 0)
+   {
+      xcb_discard_reply(m_connection, m_window_attributes_cookie.sequence);
+   }
+
+#if WSI_X11_EXPLICIT_SYNC
+   destroy_explicit_sync();
+#endif
+}
+
+#if WSI_X11_EXPLICIT_SYNC
+/**
+ * @brief Create a DRM timeline syncobj and import it into the X server.
+ */
+static VkResult create_timeline_syncobj(xcb_connection_t *connection, xcb_window_t window, int drm_fd,
+                                        x11_timeline_syncobj &timeline)
+{
+   if (drmSyncobjCreate(drm_fd, 0, &timeline.handle) != 0)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   /* The syncobj FD is closed by xcb once sent. */
+   int syncobj_fd = -1;
+   if (drmSyncobjHandleToFD(drm_fd, timeline.handle, &syncobj_fd) != 0)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   auto xid = xcb_generate_id(connection);
+   auto cookie = xcb_dri3_import_syncobj_checked(connection, xid, window, syncobj_fd);
+   auto error = xcb_request_check(connection, cookie);
+   if (error)
+   {
+      free(error);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   timeline.xid = xid;
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::init_explicit_sync()
+{
+   auto &display = drm_display::get_display();
+   if (!display.has_value())
+   {
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   m_drm_fd = display->get_drm_fd();
+   TRY(create_timeline_syncobj(m_connection, m_window, m_drm_fd, m_acquire_timeline));
+   TRY(create_timeline_syncobj(m_connection, m_window, m_drm_fd, m_release_timeline));
+
+   m_explicit_sync = true;
+   return VK_SUCCESS;
+}
+
+void swapchain::destroy_explicit_sync()
+{
+   for (auto *timeline : { &m_acquire_timeline, &m_release_timeline })
+   {
+      if (timeline->xid != XCB_NONE)
+      {
+         xcb_dri3_free_syncobj(m_connection, timeline->xid);
+         timeline->xid = XCB_NONE;
+      }
+      if (timeline->handle != 0)
+      {
+         drmSyncobjDestroy(m_drm_fd, timeline->handle);
+         timeline->handle = 0;
+      }
+   }
+   m_explicit_sync = false;
+}
+
+VkResult swapchain::set_acquire_point(x11_image_data *image_data)
+{
+   uint64_t point = m_timeline_point + 1;
+   /* A syncobj backed fence moves its payload to the point directly, without exporting it to a sync FD. */
+   if (!image_data->present_fence.transfer_payload(m_acquire_timeline.handle, point))
+   {
+      auto sync_fd = image_data->present_fence.export_sync_fd();
+      if (!sync_fd.has_value())
+      {
+         return VK_ERROR_SURFACE_LOST_KHR;
+      }
+
+      int ret = -1;
+      if (sync_fd->is_valid())
+      {
+         /* Syncobj timelines cannot import a sync FD to a point directly, so go through a binary syncobj. */
+         uint32_t binary_syncobj = 0;
+         if (drmSyncobjCreate(m_drm_fd, 0, &binary_syncobj) == 0)
+         {
+            ret = drmSyncobjImportSyncFile(m_drm_fd, binary_syncobj, sync_fd->get());
+            if (ret == 0)
+            {
+               ret = drmSyncobjTransfer(m_drm_fd, m_acquire_timeline.handle, point, binary_syncobj, 0, 0);
+            }
+            drmSyncobjDestroy(m_drm_fd, binary_syncobj);
+         }
+
+         if (ret != 0)
+         {
+            /* Wait for the payload on the CPU instead and signal the point from the host. */
+            TRY(wait_sync_fd(sync_fd->get(), UINT64_MAX));
+         }
+      }
+
+      if (ret != 0 && drmSyncobjTimelineSignal(m_drm_fd, &m_acquire_timeline.handle, &point, 1) != 0)
+      {
+         return VK_ERROR_SURFACE_LOST_KHR;
+      }
+   }
+
+   m_timeline_point = point;
+   return VK_SUCCESS;
+}
+
+bool swapchain::wait_release_point(x11_image_data *image_data, bool block)
+{
+   if (image_data->release_point == 0)
+   {
+      return true;
+   }
+
+   /* The X server usually signals the release point before sending IDLE_NOTIFY, unless it still has GPU work
+    * reading the pixmap, e.g. a composition copy. The timeout is absolute, so 0 only polls. */
+   int ret = drmSyncobjTimelineWait(m_drm_fd, &m_release_timeline.handle, &image_data->release_point, 1,
+                                    block ? INT64_MAX : 0, DRM_SYNCOBJ_WAIT_FLAGS_WAIT_FOR_SUBMIT, nullptr);
+   if (ret == -ETIME && !block)
+   {
+      return false;
+   }
+   else if (ret != 0)
+   {
+      set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+   }
+   image_data->release_point = 0;
+   return true;
+}
+#endif
+
+VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info)
+{
+   UNUSED(device);
+   UNUSED(swapchain_create_info);
+
+   if (m_device_data.is_present_id_enabled())
+   {
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_present_id>()))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   if (m_device_data.should_layer_handle_frame_boundary_events())
+   {
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_frame_boundary>()))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   return VK_SUCCESS;
 }
 
 VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info,
                                   bool &use_presentation_thread)
 {
    UNUSED(device);
-   UNUSED(swapchain_create_info);
    m_device_data.instance_data.disp.GetPhysicalDeviceMemoryProperties2KHR(m_device_data.physical_device,
                                                                           &m_memory_props);
    if (m_wsi_surface == nullptr)
@@ -117,22 +366,66 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
       return VK_ERROR_INITIALIZATION_FAILED;
    }
 
-   WSIALLOC_ASSERT_VERSION();
-   if (wsialloc_new(&m_wsi_allocator) != WSIALLOC_ERROR_NONE)
+   if (m_shm)
    {
-      WSI_LOG_ERROR("Failed to create wsi allocator.");
-      return VK_ERROR_INITIALIZATION_FAILED;
+      TRY_LOG_CALL(init_shm());
+   }
+   else
+   {
+      WSIALLOC_ASSERT_VERSION();
+      if (acquire_shared_wsialloc_allocator(m_device_data, &m_wsi_allocator) != WSIALLOC_ERROR_NONE)
+      {
+         WSI_LOG_ERROR("Failed to create wsi allocator.");
+         return VK_ERROR_INITIALIZATION_FAILED;
+      }
+
+      /* Parallel image creation allocates the images concurrently rather than in one batch. */
+      const bool deferred_allocation =
+         swapchain_create_info->flags & VK_SWAPCHAIN_CREATE_DEFERRED_MEMORY_ALLOCATION_BIT_EXT;
+      if (!deferred_allocation && !m_parallel_image_creation && swapchain_create_info->oldSwapchain == VK_NULL_HANDLE)
+      {
+         m_batch_allocations.set_count(static_cast<uint32_t>(m_swapchain_images.size()));
+      }
+
+      auto eid = xcb_generate_id(m_connection);
+      m_special_event = xcb_register_for_special_xge(m_connection, &xcb_present_id, eid, nullptr);
+      xcb_present_select_input(m_connection, eid, m_window,
+                               XCB_PRESENT_EVENT_MASK_IDLE_NOTIFY | XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY |
+                                  XCB_PRESENT_EVENT_MASK_CONFIGURE_NOTIFY);
+      m_wsi_surface->add_configure_listener();
+      m_configure_listener = true;
+
+      if (m_wsi_surface->has_xfixes())
+      {
+         /* Reused for the update region of every present with VK_KHR_incremental_present damage. */
+         m_update_region = xcb_generate_id(m_connection);
+         xcb_xfixes_create_region(m_connection, m_update_region, 0, nullptr);
+         m_sent_update_region = xcb_generate_id(m_connection);
+         xcb_xfixes_create_region(m_connection, m_sent_update_region, 0, nullptr);
+      }
+
+#if WSI_X11_EXPLICIT_SYNC
+      if (m_wsi_surface->has_explicit_sync() && init_explicit_sync() != VK_SUCCESS)
+      {
+         WSI_LOG_WARNING("Failed to set up explicit sync with the X server, presents will wait on the CPU.");
+         destroy_explicit_sync();
+      }
+#endif
    }
 
-   auto eid = xcb_generate_id(m_connection);
-   m_special_event = xcb_register_for_special_xge(m_connection, &xcb_present_id, eid, nullptr);
-   xcb_present_select_input(m_connection, eid, m_window,
-                            XCB_PRESENT_EVENT_MASK_IDLE_NOTIFY | XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY |
-                               XCB_PRESENT_EVENT_MASK_CONFIGURE_NOTIFY);
+   m_present_event_wakeup_fd = util::fd_owner{ eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK) };
+   if (!m_present_event_wakeup_fd.is_valid())
+   {
+      WSI_LOG_ERROR("Failed to create the present event thread wake up event.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
 
+   m_present_event_thread_run = true;
    try
    {
-      m_present_event_thread = std::thread(&swapchain::present_event_thread, this);
+      m_present_event_thread =
+         util::start_thread("wsi-x11-present", &m_device_data.instance_data.get_layer_settings().presentation_threads,
+                            m_shm ? &swapchain::shm_present_event_thread : &swapchain::present_event_thread, this);
    }
    catch (const std::system_error &)
    {
@@ -144,11 +437,12 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
    }
 
    /*
-    * When VK_PRESENT_MODE_MAILBOX_KHR has been chosen by the application we don't
+    * When only VK_PRESENT_MODE_MAILBOX_KHR or VK_PRESENT_MODE_IMMEDIATE_KHR can be used by the application we don't
     * initialize the page flip thread so the present_image function can be called
-    * during vkQueuePresent.
+    * during vkQueuePresent. FIFO and FIFO_RELAXED presents block in present_image, so they need the thread.
     */
-   use_presentation_thread = (m_present_mode != VK_PRESENT_MODE_MAILBOX_KHR);
+   use_presentation_thread = is_present_mode_enabled(VK_PRESENT_MODE_FIFO_KHR) ||
+                             is_present_mode_enabled(VK_PRESENT_MODE_FIFO_RELAXED_KHR);
 
    return VK_SUCCESS;
 }
@@ -158,7 +452,9 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
                                                    util::vector<uint64_t> &exportable_modifers,
                                                    util::vector<VkDrmFormatModifierPropertiesEXT> &drm_format_props)
 {
-   TRY_LOG(util::get_drm_format_properties(m_device_data.physical_device, info.format, drm_format_props),
+   util::vector<util::drm_format_modifier_support> supported_modifiers(
+      util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+   TRY_LOG(m_device_data.get_format_modifier_cache().get_supported_modifiers(info, nullptr, supported_modifiers),
            "Failed to get format properties");
 
    auto &display = drm_display::get_display();
@@ -168,84 +464,27 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
 
-   for (const auto &prop : drm_format_props)
+   for (const auto &modifier : supported_modifiers)
    {
-      drm_format_pair drm_format{ util::drm::vk_to_drm_format(info.format), prop.drmFormatModifier };
-
-      if (!display->is_format_supported(drm_format))
+      const auto &prop = modifier.modifier_properties;
+      if (!drm_format_props.try_push_back(prop))
       {
-         continue;
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
       }
 
-      VkExternalImageFormatPropertiesKHR external_props = {};
-      external_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES_KHR;
-
-      VkImageFormatProperties2KHR format_props = {};
-      format_props.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2_KHR;
-      format_props.pNext = &external_props;
-
-      VkResult result = VK_SUCCESS;
-      {
-         VkPhysicalDeviceExternalImageFormatInfoKHR external_info = {};
-         external_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO_KHR;
-         external_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
-
-         VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_mod_info = {};
-         drm_mod_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT;
-         drm_mod_info.pNext = &external_info;
-         drm_mod_info.drmFormatModifier = prop.drmFormatModifier;
-         drm_mod_info.sharingMode = info.sharingMode;
-         drm_mod_info.queueFamilyIndexCount = info.queueFamilyIndexCount;
-         drm_mod_info.pQueueFamilyIndices = info.pQueueFamilyIndices;
-
-         VkPhysicalDeviceImageFormatInfo2KHR image_info = {};
-         image_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2_KHR;
-         image_info.pNext = &drm_mod_info;
-         image_info.format = info.format;
-         image_info.type = info.imageType;
-         image_info.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
-         image_info.usage = info.usage;
-         image_info.flags = info.flags;
+      drm_format_pair drm_format{ util::drm::vk_to_drm_format(info.format), prop.drmFormatModifier };
 
-#if WSI_IMAGE_COMPRESSION_CONTROL_SWAPCHAIN
-         VkImageCompressionControlEXT compression_control = {};
-         compression_control.sType = VK_STRUCTURE_TYPE_IMAGE_COMPRESSION_CONTROL_EXT;
-         compression_control.flags = m_image_compression_control_params.flags;
-         compression_control.compressionControlPlaneCount =
-            m_image_compression_control_params.compression_control_plane_count;
-         compression_control.pFixedRateFlags = m_image_compression_control_params.fixed_rate_flags.data();
-
-         if (m_device_data.is_swapchain_compression_control_enabled())
-         {
-            compression_control.pNext = image_info.pNext;
-            image_info.pNext = &compression_control;
-         }
-#endif
-         result = m_device_data.instance_data.disp.GetPhysicalDeviceImageFormatProperties2KHR(
-            m_device_data.physical_device, &image_info, &format_props);
-      }
-      if (result != VK_SUCCESS)
-      {
-         continue;
-      }
-      if (format_props.imageFormatProperties.maxExtent.width < info.extent.width ||
-          format_props.imageFormatProperties.maxExtent.height < info.extent.height ||
-          format_props.imageFormatProperties.maxExtent.depth < info.extent.depth)
-      {
-         continue;
-      }
-      if (format_props.imageFormatProperties.maxMipLevels < info.mipLevels ||
-          format_props.imageFormatProperties.maxArrayLayers < info.arrayLayers)
+      if (!display->is_format_supported(drm_format))
       {
          continue;
       }
-      if ((format_props.imageFormatProperties.sampleCounts & info.samples) != info.samples)
+
+      if (!modifier.supports_image(info))
       {
          continue;
       }
 
-      if (external_props.externalMemoryProperties.externalMemoryFeatures &
-          VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT_KHR)
+      if (modifier.external_memory_features & VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT_KHR)
       {
          if (!exportable_modifers.try_push_back(drm_format.modifier))
          {
@@ -253,8 +492,7 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
          }
       }
 
-      if (external_props.externalMemoryProperties.externalMemoryFeatures &
-          VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT_KHR)
+      if (modifier.external_memory_features & VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT_KHR)
       {
          uint64_t flags =
             (prop.drmFormatModifierTilingFeatures & VK_FORMAT_FEATURE_DISJOINT_BIT) ? 0 : WSIALLOC_FORMAT_NON_DISJOINT;
@@ -266,9 +504,110 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
       }
    }
 
+   prefer_flip_modifiers(importable_formats);
+
    return VK_SUCCESS;
 }
 
+void swapchain::prefer_flip_modifiers(util::vector<wsialloc_format> &importable_formats)
+{
+   /* Kept to tell later whether the X server copies only because of the modifier the images were allocated with. */
+   m_importable_modifiers.clear();
+   for (const auto &format : importable_formats)
+   {
+      if (!m_importable_modifiers.try_push_back(format.modifier))
+      {
+         m_importable_modifiers.clear();
+         break;
+      }
+   }
+
+   /* The same depth and bits per pixel the pixmaps are created with. */
+   auto cookie = xcb_dri3_get_supported_modifiers(m_connection, m_window, 24, 32);
+   auto reply = xcb_dri3_get_supported_modifiers_reply(m_connection, cookie, nullptr);
+   if (reply == nullptr)
+   {
+      return;
+   }
+
+   const std::pair<const uint64_t *, int> modifier_lists[] = {
+      { xcb_dri3_get_supported_modifiers_window_modifiers(reply),
+        xcb_dri3_get_supported_modifiers_window_modifiers_length(reply) },
+      { xcb_dri3_get_supported_modifiers_screen_modifiers(reply),
+        xcb_dri3_get_supported_modifiers_screen_modifiers_length(reply) },
+   };
+
+   for (const auto &modifiers : modifier_lists)
+   {
+      const uint64_t *modifiers_end = modifiers.first + modifiers.second;
+      auto can_flip = [&modifiers, modifiers_end](const wsialloc_format &format) {
+         return std::find(modifiers.first, modifiers_end, format.modifier) != modifiers_end;
+      };
+
+      if (std::any_of(importable_formats.begin(), importable_formats.end(), can_flip))
+      {
+         importable_formats.erase(std::remove_if(importable_formats.begin(), importable_formats.end(),
+                                                 [&can_flip](const wsialloc_format &format) {
+                                                    return !can_flip(format);
+                                                 }),
+                                  importable_formats.end());
+         break;
+      }
+   }
+
+   free(reply);
+}
+
+bool swapchain::can_flip_with_other_modifier()
+{
+   auto cookie = xcb_dri3_get_supported_modifiers(m_connection, m_window, 24, 32);
+   auto reply = xcb_dri3_get_supported_modifiers_reply(m_connection, cookie, nullptr);
+   if (reply == nullptr)
+   {
+      return false;
+   }
+
+   const uint64_t *modifiers = xcb_dri3_get_supported_modifiers_window_modifiers(reply);
+   int modifier_count = xcb_dri3_get_supported_modifiers_window_modifiers_length(reply);
+   if (modifier_count == 0)
+   {
+      modifiers = xcb_dri3_get_supported_modifiers_screen_modifiers(reply);
+      modifier_count = xcb_dri3_get_supported_modifiers_screen_modifiers_length(reply);
+   }
+
+   const uint64_t current_modifier = m_image_creation_parameters.m_allocated_format.modifier;
+   const uint64_t *modifiers_end = modifiers + modifier_count;
+   const bool uses_flip_modifier = std::find(modifiers, modifiers_end, current_modifier) != modifiers_end;
+   const bool imports_flip_modifier =
+      std::any_of(m_importable_modifiers.begin(), m_importable_modifiers.end(), [&](uint64_t modifier) {
+         return std::find(modifiers, modifiers_end, modifier) != modifiers_end;
+      });
+
+   free(reply);
+   return imports_flip_modifier && !uses_flip_modifier;
+}
+
+void swapchain::record_completion_mode(const pending_completion &completion, uint8_t mode)
+{
+   if (mode == XCB_PRESENT_COMPLETE_MODE_FLIP)
+   {
+      m_flip_count++;
+   }
+   else if (mode != XCB_PRESENT_COMPLETE_MODE_SKIP)
+   {
+      m_copy_count++;
+      WSI_TRACE_EVENT("x11_copy", completion.serial);
+   }
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   auto *frame_boundary = get_swapchain_extension<wsi_ext_frame_boundary>();
+   if (frame_boundary != nullptr && completion.frame_statistics_slot != 0)
+   {
+      frame_boundary->record_presentation_counts(completion.frame_statistics_slot, m_flip_count, m_copy_count);
+   }
+#endif
+}
+
 VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, x11_image_data *image_data,
                                       util::vector<wsialloc_format> &importable_formats,
                                       wsialloc_format *allocated_format, bool avoid_allocation)
@@ -298,7 +637,7 @@ VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, x11_
       alloc_result.buffer_fds[i] = -1;
       alloc_result.average_row_strides[i] = -1;
    }
-   const auto res = wsialloc_alloc(m_wsi_allocator, &alloc_info, &alloc_result);
+   const auto res = m_batch_allocations.allocate(m_wsi_allocator, alloc_info, alloc_result);
    if (res != WSIALLOC_ERROR_NONE)
    {
       WSI_LOG_ERROR("Failed allocation of DMA Buffer. WSI error: %d", static_cast<int>(res));
@@ -309,10 +648,17 @@ VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, x11_
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
    *allocated_format = alloc_result.format;
+   /* Importing the buffer into Vulkan consumes its FDs, so keep duplicates to give it back to the wsialloc cache. */
+   if (!avoid_allocation && !image_data->allocated_buffer.keep(alloc_result, allocation_flags))
+   {
+      WSI_LOG_WARNING("Failed to duplicate the buffer FDs, the buffer will not be cached once released.");
+   }
    auto &external_memory = image_data->external_mem;
    external_memory.set_strides(alloc_result.average_row_strides);
    external_memory.set_buffer_fds(alloc_result.buffer_fds);
    external_memory.set_offsets(alloc_result.offsets);
+   external_memory.set_memory_source(alloc_result.format.fourcc, alloc_result.format.modifier, allocation_flags);
+   external_memory.set_memory_usage(m_memory_usage);
 
    uint32_t num_planes = util::drm::drm_fourcc_format_get_num_planes(alloc_result.format.fourcc);
 
@@ -363,12 +709,14 @@ VkResult swapchain::allocate_image(VkImageCreateInfo &image_create_info, x11_ima
 {
    UNUSED(image_create_info);
    util::vector<wsialloc_format> importable_formats(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
-   auto &m_allocated_format = m_image_creation_parameters.m_allocated_format;
-   if (!importable_formats.try_push_back(m_allocated_format))
+   /* The format was chosen with the first image, so the result is not stored back, which lets images be allocated
+    * concurrently. */
+   wsialloc_format allocated_format = m_image_creation_parameters.m_allocated_format;
+   if (!importable_formats.try_push_back(allocated_format))
    {
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
-   TRY_LOG_CALL(allocate_wsialloc(m_image_create_info, image_data, importable_formats, &m_allocated_format, false));
+   TRY_LOG_CALL(allocate_wsialloc(m_image_create_info, image_data, importable_formats, &allocated_format, false));
 
    return VK_SUCCESS;
 }
@@ -406,7 +754,6 @@ static int os_dupfd_cloexec(int fd)
 VkResult swapchain::create_pixmap(const VkImageCreateInfo &image_create_info, swapchain_image &image,
                                   x11_image_data *image_data)
 {
-   UNUSED(image);
    auto &mem = image_data->external_mem;
    auto &offset = mem.get_offsets();
    auto &stride = mem.get_strides();
@@ -430,56 +777,249 @@ VkResult swapchain::create_pixmap(const VkImageCreateInfo &image_create_info, sw
       stride[0], offset[0], stride[1], offset[1], stride[2], offset[2], stride[3], offset[3],
       24, 32, m_image_creation_parameters.m_allocated_format.modifier, &fds[0]);
 
-   auto error = xcb_request_check(m_connection, cookie);
+   auto lock = std::unique_lock<std::mutex>(m_pending_pixmaps_lock);
+   image_data->pending_pixmap = pixmap;
+   image_data->pixmap_cookie = cookie;
+   image_data->pixmap_check_pending = true;
+
+   /* Pixmaps created with the swapchain are checked together once the last one has been sent. Ones created after
+    * that first check are checked straight away. */
+   const bool check_now = &image == &m_swapchain_images[m_swapchain_images.size() - 1] || m_pixmap_batch_checked;
+   lock.unlock();
+
+   if (check_now)
+   {
+      return check_pending_pixmaps();
+   }
+   return VK_SUCCESS;
+}
+
+/**
+ * @brief Collect the error of the pixmap creation request of an image, giving it its pixmap if the request succeeded.
+ */
+static VkResult check_pixmap(xcb_connection_t *connection, x11_image_data *data)
+{
+   data->pixmap_check_pending = false;
+   const xcb_pixmap_t pixmap = data->pending_pixmap;
+   data->pending_pixmap = XCB_NONE;
+
+   auto error = xcb_request_check(connection, data->pixmap_cookie);
    if (error)
    {
       free(error);
       return VK_ERROR_FORMAT_NOT_SUPPORTED;
    }
 
-   image_data->pixmap = pixmap;
+   data->pixmap = pixmap;
    return VK_SUCCESS;
 }
 
-VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+VkResult swapchain::check_pending_pixmaps()
 {
-   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
-   image.status = swapchain_image::FREE;
+   auto lock = std::unique_lock<std::mutex>(m_pending_pixmaps_lock);
+   m_pixmap_batch_checked = true;
 
-   assert(image.data != nullptr);
-   auto image_data = static_cast<x11_image_data *>(image.data);
-   TRY_LOG(allocate_image(image_create_info, image_data), "Failed to allocate image");
-   image_status_lock.unlock();
-
-   TRY_LOG(create_pixmap(image_create_info, image, image_data), "Failed to create pixmap");
+   /* Replies and errors arrive in request order, so checking the newest request first takes a single round trip
+    * and the checks of the older requests do not block. */
+   x11_image_data *newest = nullptr;
+   for (auto &image : m_swapchain_images)
+   {
+      auto data = reinterpret_cast<x11_image_data *>(image.data);
+      if (data != nullptr && data->pixmap_check_pending &&
+          (newest == nullptr || data->pixmap_cookie.sequence > newest->pixmap_cookie.sequence))
+      {
+         newest = data;
+      }
+   }
 
-   TRY_LOG(image_data->external_mem.import_memory_and_bind_swapchain_image(image.image),
-           "Failed to import memory and bind swapchain image");
+   if (newest == nullptr)
+   {
+      return VK_SUCCESS;
+   }
 
-   /* Initialize presentation fence. */
-   auto present_fence = sync_fd_fence_sync::create(m_device_data);
-   if (!present_fence.has_value())
+   VkResult result = check_pixmap(m_connection, newest);
+   for (auto &image : m_swapchain_images)
    {
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
+      auto data = reinterpret_cast<x11_image_data *>(image.data);
+      if (data != nullptr && data->pixmap_check_pending && check_pixmap(m_connection, data) != VK_SUCCESS)
+      {
+         result = VK_ERROR_FORMAT_NOT_SUPPORTED;
+      }
    }
-   image_data->present_fence = std::move(present_fence.value());
 
-   return VK_SUCCESS;
+   return result;
 }
 
-VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+VkResult swapchain::init_shm()
 {
-   /* Create image_data */
-   auto image_data = m_allocator.create<x11_image_data>(1, m_device, m_allocator);
-   if (image_data == nullptr)
+   if (!host_memory::is_supported(m_device_data))
    {
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
+      WSI_LOG_ERROR("MIT-SHM presentation requires " VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME ".");
+      return VK_ERROR_INITIALIZATION_FAILED;
    }
-   image.data = image_data;
 
-   if (m_image_create_info.format == VK_FORMAT_UNDEFINED)
+   uint32_t width = 0, height = 0;
+   int depth = 0;
+   if (!m_wsi_surface->get_size_and_depth(&width, &height, &depth))
    {
-      util::vector<wsialloc_format> importable_formats(
+      WSI_LOG_ERROR("Failed to get the depth of the window.");
+      return VK_ERROR_SURFACE_LOST_KHR;
+   }
+   m_shm_depth = static_cast<uint8_t>(depth);
+
+   m_shm_gc = xcb_generate_id(m_connection);
+   xcb_create_gc(m_connection, m_shm_gc, m_window, 0, nullptr);
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::init_shm_image_create_info(VkImageCreateInfo &image_create_info)
+{
+   if (host_memory::is_image_supported(m_device_data, image_create_info))
+   {
+      host_memory::fill_image_create_info(image_create_info, m_image_creation_parameters.m_external_info);
+      return VK_SUCCESS;
+   }
+
+   if (!prime_copy::is_supported(m_device_data, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT))
+   {
+      WSI_LOG_ERROR("The device can neither render to nor copy into memory shared with MIT-SHM.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   if ((image_create_info.flags & VK_IMAGE_CREATE_PROTECTED_BIT) != 0)
+   {
+      WSI_LOG_ERROR("Protected images cannot be copied for presentation.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   WSI_LOG_INFO("The device cannot render to memory shared with MIT-SHM, the images are copied into it.");
+   m_prime_copy = prime_copy::create(m_device_data, m_allocator, get_allocation_callbacks(), m_memory_usage,
+                                     image_create_info.format,
+                                     { image_create_info.extent.width, image_create_info.extent.height },
+                                     static_cast<uint32_t>(m_swapchain_images.size()));
+   if (m_prime_copy == nullptr)
+   {
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   prime_copy::fill_image_create_info(image_create_info);
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::allocate_shm_image(swapchain_image &image, x11_image_data *image_data)
+{
+   if (m_prime_copy != nullptr)
+   {
+      const auto image_index = static_cast<uint32_t>(&image - m_swapchain_images.data());
+      TRY_LOG_CALL(m_prime_copy->bind_image(image_index, image.image, image_data->shm_memory));
+   }
+   else
+   {
+      TRY_LOG_CALL(image_data->shm_memory.allocate_and_bind(image.image));
+   }
+
+   /* MIT-SHM images are described by their row length in pixels, all the offered formats have 4 byte pixels. */
+   const VkSubresourceLayout &layout = image_data->shm_memory.get_layout();
+   if (layout.rowPitch % 4 != 0 || layout.offset % 4 != 0)
+   {
+      WSI_LOG_ERROR("The linear layout of the image cannot be presented with MIT-SHM.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   /* The fd is closed by xcb once sent. */
+   const int server_fd = os_dupfd_cloexec(image_data->shm_memory.get_fd());
+   if (server_fd < 0)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   const xcb_shm_seg_t seg = xcb_generate_id(m_connection);
+   auto error = xcb_request_check(m_connection, xcb_shm_attach_fd_checked(m_connection, seg, server_fd, 1));
+   if (error)
+   {
+      free(error);
+      WSI_LOG_ERROR("Failed to attach the shared memory of an image to the X server.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+   image_data->shm_seg = seg;
+   image_data->shm_offset = static_cast<uint32_t>(layout.offset);
+   image_data->shm_row_length = static_cast<uint32_t>(layout.rowPitch / 4);
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::allocate_swapchain_image_buffer(swapchain_image &image)
+{
+   image.status.store(swapchain_image::FREE);
+
+   assert(image.data != nullptr);
+   auto image_data = static_cast<x11_image_data *>(image.data);
+   if (!m_shm)
+   {
+      TRY_LOG(allocate_image(m_image_create_info, image_data), "Failed to allocate image");
+   }
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::export_swapchain_image(const VkImageCreateInfo &image_create_info, swapchain_image &image)
+{
+   auto image_data = static_cast<x11_image_data *>(image.data);
+   if (m_shm)
+   {
+      TRY_LOG(allocate_shm_image(image, image_data), "Failed to allocate shared memory image");
+   }
+   else
+   {
+      TRY_LOG(create_pixmap(image_create_info, image, image_data), "Failed to create pixmap");
+   }
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::import_swapchain_image_buffer(swapchain_image &image)
+{
+   auto image_data = static_cast<x11_image_data *>(image.data);
+   if (!m_shm)
+   {
+      TRY_LOG(image_data->external_mem.import_memory_and_bind_swapchain_image(image.image),
+              "Failed to import memory and bind swapchain image");
+   }
+
+   /* Initialize presentation fence, backed by a syncobj when its payloads go to the acquire timeline. */
+   auto present_fence = syncobj_fence_sync::create(m_device_data, m_explicit_sync ? m_drm_fd : -1);
+   if (!present_fence.has_value())
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   image_data->present_fence = std::move(present_fence.value());
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+{
+   TRY_LOG_CALL(allocate_swapchain_image_buffer(image));
+   TRY_LOG_CALL(export_swapchain_image(image_create_info, image));
+   return import_swapchain_image_buffer(image);
+}
+
+VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+{
+   /* Create image_data */
+   auto image_data = m_image_allocator.create<x11_image_data>(1, m_device, m_image_allocator);
+   if (image_data == nullptr)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   image.data = image_data;
+
+   if (m_shm && m_image_create_info.format == VK_FORMAT_UNDEFINED)
+   {
+      TRY_LOG_CALL(init_shm_image_create_info(image_create_info));
+      m_image_create_info = image_create_info;
+   }
+   else if (m_image_create_info.format == VK_FORMAT_UNDEFINED)
+   {
+      util::vector<wsialloc_format> importable_formats(
          util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
       util::vector<uint64_t> exportable_modifiers(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
 
@@ -519,56 +1059,90 @@ VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info,
    return m_device_data.disp.CreateImage(m_device, &m_image_create_info, get_allocation_callbacks(), &image.image);
 }
 
-void swapchain::present_event_thread()
+void swapchain::wake_present_event_thread()
 {
-   auto thread_status_lock = std::unique_lock<std::mutex>(m_thread_status_lock);
-   m_present_event_thread_run = true;
+   if (m_present_event_wakeup_fd.is_valid())
+   {
+      const uint64_t value = 1;
+      ssize_t res = write(m_present_event_wakeup_fd.get(), &value, sizeof(value));
+      /* The write can only fail if the counter would overflow, which still leaves the thread woken up. */
+      UNUSED(res);
+   }
+}
 
-   while (m_present_event_thread_run)
+bool swapchain::wait_for_present_events(bool completions_pending)
+{
+   struct pollfd fds[2] = {};
+   fds[0].fd = m_present_event_wakeup_fd.get();
+   fds[0].events = POLLIN;
+   fds[1].fd = xcb_get_file_descriptor(m_connection);
+   fds[1].events = POLLIN;
+
+   /* Another thread reading the connection can queue the events of this swapchain without waking this poll up. The
+    * timeout bounds how late a completion is then noticed. Other events are picked up when acquire wakes the thread
+    * up before it blocks. */
+   int ret = poll(fds, 2, completions_pending ? X11_PRESENT_EVENT_POLL_TIMEOUT_MS : -1);
+   if (ret < 0 && errno != EINTR)
    {
-      auto assume_forward_progress = false;
+      WSI_LOG_ERROR("Failed to poll for present events: %s", std::strerror(errno));
+      return false;
+   }
 
-      for (auto &image : m_swapchain_images)
-      {
-         if (image.status == swapchain_image::INVALID)
-            continue;
+   /* An invalid descriptor would make every poll return right away. */
+   if (ret > 0 && ((fds[0].revents | fds[1].revents) & POLLNVAL) != 0)
+   {
+      WSI_LOG_ERROR("Invalid file descriptor polled for present events.");
+      return false;
+   }
 
-         auto data = reinterpret_cast<x11_image_data *>(image.data);
-         if (data->pending_completions.size() != 0)
-         {
-            assume_forward_progress = true;
-            break;
-         }
-      }
+   if (ret > 0 && (fds[0].revents & POLLIN) != 0)
+   {
+      /* Reset the event counter, the thread re-checks its state after every wake up. */
+      uint64_t value = 0;
+      ssize_t res = read(m_present_event_wakeup_fd.get(), &value, sizeof(value));
+      UNUSED(res);
+   }
+   return true;
+}
 
-      if (!assume_forward_progress)
-      {
-         m_thread_status_cond.wait(thread_status_lock);
-         continue;
-      }
+void swapchain::present_event_thread()
+{
+   auto thread_status_lock = std::unique_lock<std::mutex>(m_thread_status_lock);
 
+   while (m_present_event_thread_run)
+   {
       if (error_has_occured())
       {
          break;
       }
 
+      const bool completions_pending = m_pending_completion_count != 0;
       thread_status_lock.unlock();
 
-      auto event = xcb_wait_for_special_event(m_connection, m_special_event);
+      auto event = xcb_poll_for_special_event(m_connection, m_special_event);
       if (event == nullptr)
       {
-         set_error_state(VK_ERROR_SURFACE_LOST_KHR);
-         break;
+         if (xcb_connection_has_error(m_connection) || !wait_for_present_events(completions_pending))
+         {
+            set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+            thread_status_lock.lock();
+            break;
+         }
+
+         thread_status_lock.lock();
+         continue;
       }
 
       thread_status_lock.lock();
 
+      bool suboptimal_copy = false;
       auto pe = reinterpret_cast<xcb_present_generic_event_t *>(event);
       switch (pe->evtype)
       {
       case XCB_PRESENT_EVENT_CONFIGURE_NOTIFY:
       {
          auto config = reinterpret_cast<xcb_present_configure_notify_event_t *>(event);
+         m_wsi_surface->on_configure_notify(config->width, config->height);
          if (config->pixmap_flags & (1 << 0))
          {
             set_error_state(VK_ERROR_SURFACE_LOST_KHR);
@@ -583,7 +1157,11 @@ void swapchain::present_event_thread()
       case XCB_PRESENT_EVENT_IDLE_NOTIFY:
       {
          auto idle = reinterpret_cast<xcb_present_idle_notify_event_t *>(event);
-         m_free_buffer_pool.push_back(idle->pixmap);
+         WSI_TRACE_EVENT("x11_idle_notify", 0);
+         if (!recycle_idle_pixmap(idle->pixmap))
+         {
+            m_free_buffer_pool.push_back(idle->pixmap);
+         }
          m_thread_status_cond.notify_all();
          break;
       }
@@ -592,19 +1170,19 @@ void swapchain::present_event_thread()
          auto complete = reinterpret_cast<xcb_present_complete_notify_event_t *>(event);
          if (complete->kind == XCB_PRESENT_COMPLETE_KIND_PIXMAP)
          {
-            for (auto &image : m_swapchain_images)
+            suboptimal_copy = complete->mode == XCB_PRESENT_COMPLETE_MODE_SUBOPTIMAL_COPY;
+
+            auto &completion = m_pending_completions[complete->serial % m_pending_completions.size()];
+            if (completion.pending && completion.serial == complete->serial)
             {
-               auto data = reinterpret_cast<x11_image_data *>(image.data);
-               auto iter = std::find_if(data->pending_completions.begin(), data->pending_completions.end(),
-                                        [complete](auto &pending_completion) -> bool {
-                                           return complete->serial == pending_completion.serial;
-                                        });
-               if (iter != data->pending_completions.end())
-               {
-                  set_present_id(iter->present_id);
-                  data->pending_completions.erase(iter);
-                  m_thread_status_cond.notify_all();
-               }
+               record_completion_mode(completion, complete->mode);
+               auto data = reinterpret_cast<x11_image_data *>(m_swapchain_images[completion.image_index].data);
+               WSI_TRACE_EVENT("x11_complete_notify", completion.present_id);
+               set_present_id(completion.present_id);
+               completion.pending = false;
+               data->pending_completion_count--;
+               m_pending_completion_count--;
+               m_thread_status_cond.notify_all();
             }
             m_last_present_msc = complete->msc;
          }
@@ -612,18 +1190,157 @@ void swapchain::present_event_thread()
       }
       }
       free(event);
+
+      /* The X server also reports suboptimal copies for reasons other than the modifier, e.g. a composited window, in
+       * which case recreating the swapchain would not help. */
+      const auto now = std::chrono::steady_clock::now();
+      if (suboptimal_copy && get_success_status() == VK_SUCCESS &&
+          now - m_flip_modifier_check_time >= std::chrono::seconds(1))
+      {
+         m_flip_modifier_check_time = now;
+         thread_status_lock.unlock();
+         if (can_flip_with_other_modifier())
+         {
+            set_suboptimal();
+         }
+         thread_status_lock.lock();
+      }
+   }
+
+   /* Configure notifications are no longer received, so the geometry cached by the surface would go stale. */
+   if (m_configure_listener)
+   {
+      m_wsi_surface->remove_configure_listener();
+      m_configure_listener = false;
    }
 
    m_present_event_thread_run = false;
    m_thread_status_cond.notify_all();
 }
 
+xcb_xfixes_region_t swapchain::set_update_region(const present_damage &damage, VkPresentModeKHR present_mode)
+{
+   if (m_update_region == XCB_NONE)
+   {
+      return XCB_NONE;
+   }
+
+   /* The update region of the last present sent already includes the damage of the presents sent before it that
+    * have not completed either. */
+   const bool add_sent_update = present_mode == VK_PRESENT_MODE_MAILBOX_KHR && m_pending_completion_count != 0;
+   if (damage.full || (add_sent_update && m_sent_update_full))
+   {
+      m_sent_update_full = true;
+      return XCB_NONE;
+   }
+
+   std::array<xcb_rectangle_t, WSI_MAX_PRESENT_DAMAGE_RECTS> rects;
+   for (uint32_t i = 0; i < damage.rect_count; i++)
+   {
+      /* X11 coordinates are 16 bit, larger images are not presentable anyway. */
+      const VkRect2D &rect = damage.rects[i];
+      rects[i] = { static_cast<int16_t>(rect.offset.x), static_cast<int16_t>(rect.offset.y),
+                   static_cast<uint16_t>(std::min<uint32_t>(rect.extent.width, UINT16_MAX)),
+                   static_cast<uint16_t>(std::min<uint32_t>(rect.extent.height, UINT16_MAX)) };
+   }
+   xcb_xfixes_set_region(m_connection, m_update_region, damage.rect_count, rects.data());
+   if (add_sent_update)
+   {
+      xcb_xfixes_union_region(m_connection, m_update_region, m_sent_update_region, m_update_region);
+   }
+
+   xcb_xfixes_copy_region(m_connection, m_update_region, m_sent_update_region);
+   m_sent_update_full = false;
+   return m_update_region;
+}
+
+void swapchain::order_after_ancestor(swapchain_base &ancestor)
+{
+   auto &x11_ancestor = static_cast<swapchain &>(ancestor);
+   std::lock_guard<std::mutex> lock(x11_ancestor.m_thread_status_lock);
+   if (x11_ancestor.m_last_present_msc != 0 && x11_ancestor.m_pending_completion_count != 0)
+   {
+      /* Each present in flight was targeted at least one refresh after the previous one. */
+      m_min_target_msc = x11_ancestor.m_last_present_msc + x11_ancestor.m_pending_completion_count + 1;
+   }
+}
+
+void swapchain::update_window_unmapped()
+{
+   constexpr std::chrono::milliseconds query_interval(500);
+
+   if (m_window_attributes_cookie.sequence != 0)
+   {
+      void *reply = nullptr;
+      xcb_generic_error_t *error = nullptr;
+      if (xcb_poll_for_reply(m_connection, m_window_attributes_cookie.sequence, &reply, &error) == 0)
+      {
+         return;
+      }
+
+      if (reply != nullptr)
+      {
+         auto *attributes = static_cast<xcb_get_window_attributes_reply_t *>(reply);
+         m_window_unmapped.store(attributes->map_state != XCB_MAP_STATE_VIEWABLE, std::memory_order_relaxed);
+      }
+      free(reply);
+      free(error);
+      m_window_attributes_cookie.sequence = 0;
+   }
+
+   /* The request is flushed with the present, and its reply read by a later one. */
+   const auto now = std::chrono::steady_clock::now();
+   if (now - m_window_attributes_time >= query_interval)
+   {
+      m_window_attributes_cookie = xcb_get_window_attributes(m_connection, m_window);
+      m_window_attributes_time = now;
+   }
+}
+
+bool swapchain::is_surface_occluded()
+{
+   if (!m_window_unmapped.load(std::memory_order_relaxed))
+   {
+      return false;
+   }
+
+   /* Keep reading the attributes of a hidden window, so that acquires stop being throttled as soon as it is mapped
+    * again rather than at the next present. */
+   {
+      std::lock_guard<std::mutex> lock(m_window_attributes_lock);
+      update_window_unmapped();
+   }
+   xcb_flush(m_connection);
+   return m_window_unmapped.load(std::memory_order_relaxed);
+}
+
 void swapchain::present_image(const pending_present_request &pending_present)
 {
    auto image_data = reinterpret_cast<x11_image_data *>(m_swapchain_images[pending_present.image_index].data);
+
+   if (is_occlusion_throttled())
+   {
+      std::lock_guard<std::mutex> lock(m_window_attributes_lock);
+      update_window_unmapped();
+   }
+
+   /* Pixmaps not checked on creation, e.g. ones taken over from an ancestor swapchain's batch. */
+   bool pixmap_check_pending;
+   {
+      std::lock_guard<std::mutex> lock(m_pending_pixmaps_lock);
+      pixmap_check_pending = image_data->pixmap_check_pending;
+   }
+   if (pixmap_check_pending && check_pending_pixmaps() != VK_SUCCESS)
+   {
+      set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+      set_present_id(pending_present.present_id);
+      return unpresent_image(pending_present.image_index);
+   }
+
    auto thread_status_lock = std::unique_lock<std::mutex>(m_thread_status_lock);
 
-   while (image_data->pending_completions.size() == X11_SWAPCHAIN_MAX_PENDING_COMPLETIONS)
+   /* Wait for the slot of the next serial to be released by the present sent with the same slot before it. */
+   while (m_pending_completions[(uint32_t)(m_send_sbc + 1) % m_pending_completions.size()].pending)
    {
       if (!m_present_event_thread_run)
       {
@@ -633,21 +1350,94 @@ void swapchain::present_image(const pending_present_request &pending_present)
       m_thread_status_cond.wait(thread_status_lock);
    }
 
+   if (m_shm)
+   {
+      /* The X server copies the image when it handles the request, there is no refresh to queue the present for. */
+      const unsigned int sequence = put_shm_image(pending_present.image_index, image_data);
+      m_send_sbc++;
+      auto &completion = m_pending_completions[(uint32_t)m_send_sbc % m_pending_completions.size()];
+      completion = { sequence, pending_present.image_index, pending_present.present_id, true };
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+      completion.frame_statistics_slot = pending_present.frame_statistics_slot;
+#endif
+      image_data->pending_completion_count++;
+      m_pending_completion_count++;
+      m_thread_status_cond.notify_all();
+      wake_present_event_thread();
+      return;
+   }
+
+#if WSI_X11_EXPLICIT_SYNC
+   if (m_explicit_sync && set_acquire_point(image_data) != VK_SUCCESS)
+   {
+      set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+      set_present_id(pending_present.present_id);
+      return unpresent_image(pending_present.image_index);
+   }
+#endif
+
+   const bool fifo = pending_present.present_mode == VK_PRESENT_MODE_FIFO_KHR ||
+                     pending_present.present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+   const bool fifo_pipelined = fifo && m_last_present_msc != 0;
+   uint64_t target_msc = 0;
+   if (fifo_pipelined)
+   {
+      /* Queue behind the presents in flight, one refresh interval each, instead of waiting for them to complete. */
+      target_msc = m_last_present_msc + m_pending_completion_count + 1;
+   }
+   if (m_min_target_msc != 0)
+   {
+      target_msc = std::max(target_msc, m_min_target_msc);
+      m_min_target_msc = 0;
+   }
+
    m_send_sbc++;
    uint32_t serial = (uint32_t)m_send_sbc;
-   uint32_t options = XCB_PRESENT_OPTION_NONE;
-
-   auto cookie = xcb_present_pixmap_checked(m_connection, m_window, image_data->pixmap, serial, 0, 0, 0, 0, 0, 0, 0,
-                                            options, m_target_msc, 0, 0, 0, nullptr);
-   xcb_discard_reply(m_connection, cookie.sequence);
+   /* IMMEDIATE may tear. MAILBOX presents without a target MSC, so the X server replaces a frame still queued for
+    * the next refresh instead of showing both. FIFO_RELAXED queues like FIFO, but with the async option the X server
+    * flips a present whose target MSC has already passed immediately instead of holding it for another refresh. */
+   const bool async = pending_present.present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR ||
+                      (pending_present.present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR && fifo_pipelined);
+   /* Ask the X server to tell when it copies the pixmap only because it was allocated with the wrong modifier. */
+   uint32_t options = XCB_PRESENT_OPTION_SUBOPTIMAL | (async ? XCB_PRESENT_OPTION_ASYNC : XCB_PRESENT_OPTION_NONE);
+
+   const xcb_xfixes_region_t update =
+      set_update_region(m_swapchain_images[pending_present.image_index].damage, pending_present.present_mode);
+
+#if WSI_X11_EXPLICIT_SYNC
+   if (m_explicit_sync)
+   {
+      /* The X server waits for the acquire point, so the present does not wait for the GPU on the CPU. */
+      image_data->release_point = m_timeline_point;
+      auto cookie = xcb_present_pixmap_synced_checked(m_connection, m_window, image_data->pixmap, serial, 0, update,
+                                                      0, 0, 0, m_acquire_timeline.xid, m_release_timeline.xid,
+                                                      m_timeline_point, image_data->release_point, options,
+                                                      target_msc, 0, 0, 0, nullptr);
+      xcb_discard_reply(m_connection, cookie.sequence);
+   }
+   else
+#endif
+   {
+      auto cookie = xcb_present_pixmap_checked(m_connection, m_window, image_data->pixmap, serial, 0, update, 0, 0,
+                                               0, 0, 0, options, target_msc, 0, 0, 0, nullptr);
+      xcb_discard_reply(m_connection, cookie.sequence);
+   }
    xcb_flush(m_connection);
 
-   image_data->pending_completions.push_back({ serial, pending_present.present_id });
+   auto &completion = m_pending_completions[serial % m_pending_completions.size()];
+   completion = { serial, pending_present.image_index, pending_present.present_id, true };
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   completion.frame_statistics_slot = pending_present.frame_statistics_slot;
+#endif
+   image_data->pending_completion_count++;
+   m_pending_completion_count++;
    m_thread_status_cond.notify_all();
+   wake_present_event_thread();
 
-   if (m_present_mode == VK_PRESENT_MODE_FIFO_KHR)
+   if (fifo && !fifo_pipelined)
    {
-      while (image_data->pending_completions.size() > 0)
+      /* Wait for the first completion, which gives the MSC the following presents are queued relative to. */
+      while (image_data->pending_completion_count > 0)
       {
          if (!m_present_event_thread_run)
          {
@@ -655,10 +1445,120 @@ void swapchain::present_image(const pending_present_request &pending_present)
          }
          m_thread_status_cond.wait(thread_status_lock);
       }
-      m_target_msc = m_last_present_msc + 1;
    }
 }
 
+unsigned int swapchain::put_shm_image(uint32_t image_index, x11_image_data *image_data)
+{
+   const auto &extent = m_image_create_info.extent;
+   const present_damage &damage = m_swapchain_images[image_index].damage;
+   const uint16_t total_width = static_cast<uint16_t>(std::min<uint32_t>(image_data->shm_row_length, UINT16_MAX));
+   const uint16_t total_height = static_cast<uint16_t>(std::min<uint32_t>(extent.height, UINT16_MAX));
+
+   if (damage.full)
+   {
+      xcb_shm_put_image(m_connection, m_window, m_shm_gc, total_width, total_height, 0, 0,
+                        static_cast<uint16_t>(std::min<uint32_t>(extent.width, UINT16_MAX)), total_height, 0, 0,
+                        m_shm_depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0, image_data->shm_seg, image_data->shm_offset);
+   }
+   else
+   {
+      for (uint32_t i = 0; i < damage.rect_count; i++)
+      {
+         const VkRect2D &rect = damage.rects[i];
+         const int16_t x = static_cast<int16_t>(rect.offset.x);
+         const int16_t y = static_cast<int16_t>(rect.offset.y);
+         xcb_shm_put_image(m_connection, m_window, m_shm_gc, total_width, total_height, x, y,
+                           static_cast<uint16_t>(std::min<uint32_t>(rect.extent.width, UINT16_MAX)),
+                           static_cast<uint16_t>(std::min<uint32_t>(rect.extent.height, UINT16_MAX)), x, y,
+                           m_shm_depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0, image_data->shm_seg, image_data->shm_offset);
+      }
+   }
+
+   /* Requests are handled in order, so the X server has read the image once it has replied to this one. */
+   const unsigned int sequence = xcb_get_input_focus(m_connection).sequence;
+   xcb_flush(m_connection);
+   return sequence;
+}
+
+void swapchain::shm_present_event_thread()
+{
+   auto thread_status_lock = std::unique_lock<std::mutex>(m_thread_status_lock);
+
+   while (m_present_event_thread_run)
+   {
+      if (error_has_occured())
+      {
+         break;
+      }
+
+      auto &completion = m_pending_completions[(uint32_t)(m_shm_completed_sbc + 1) % m_pending_completions.size()];
+      if (!completion.pending)
+      {
+         thread_status_lock.unlock();
+         wait_for_present_events(false);
+         thread_status_lock.lock();
+         continue;
+      }
+
+      void *reply = nullptr;
+      xcb_generic_error_t *error = nullptr;
+      if (xcb_poll_for_reply(m_connection, completion.serial, &reply, &error) == 0)
+      {
+         if (xcb_connection_has_error(m_connection))
+         {
+            set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+            break;
+         }
+
+         thread_status_lock.unlock();
+         wait_for_present_events(true);
+         thread_status_lock.lock();
+         continue;
+      }
+      free(reply);
+      free(error);
+
+      auto data = reinterpret_cast<x11_image_data *>(m_swapchain_images[completion.image_index].data);
+      WSI_TRACE_EVENT("x11_complete_notify", completion.present_id);
+      /* PutImage always copies into the window. */
+      record_completion_mode(completion, XCB_PRESENT_COMPLETE_MODE_COPY);
+      set_present_id(completion.present_id);
+      completion.pending = false;
+      data->pending_completion_count--;
+      m_pending_completion_count--;
+      m_shm_completed_sbc++;
+      unpresent_image(completion.image_index);
+      m_thread_status_cond.notify_all();
+   }
+
+   m_present_event_thread_run = false;
+   m_thread_status_cond.notify_all();
+}
+
+bool swapchain::recycle_idle_pixmap(xcb_pixmap_t pixmap)
+{
+   for (size_t i = 0; i < m_swapchain_images.size(); i++)
+   {
+      auto data = reinterpret_cast<x11_image_data *>(m_swapchain_images[i].data);
+      if (data == nullptr || data->pixmap != pixmap)
+      {
+         continue;
+      }
+
+#if WSI_X11_EXPLICIT_SYNC
+      /* Leave images the X server may still read on the GPU to acquire, which waits for their release point. */
+      if (m_explicit_sync && !wait_release_point(data, false))
+      {
+         return false;
+      }
+#endif
+      unpresent_image(i);
+      return true;
+   }
+   return false;
+}
+
 bool swapchain::free_image_found()
 {
    while (m_free_buffer_pool.size() > 0)
@@ -668,21 +1568,22 @@ bool swapchain::free_image_found()
       for (size_t i = 0; i < m_swapchain_images.size(); i++)
       {
          auto data = reinterpret_cast<x11_image_data *>(m_swapchain_images[i].data);
-         if (data->pixmap == pixmap.value())
+         if (data == nullptr || data->pixmap != pixmap.value())
          {
-            unpresent_image(i);
+            continue;
          }
-      }
-   }
 
-   for (auto &img : m_swapchain_images)
-   {
-      if (img.status == swapchain_image::FREE)
-      {
-         return true;
+#if WSI_X11_EXPLICIT_SYNC
+         if (m_explicit_sync)
+         {
+            wait_release_point(data, true);
+         }
+#endif
+         unpresent_image(i);
       }
    }
-   return false;
+
+   return has_free_image();
 }
 
 VkResult swapchain::get_free_buffer(uint64_t *timeout)
@@ -693,7 +1594,11 @@ VkResult swapchain::get_free_buffer(uint64_t *timeout)
    {
       return free_image_found() ? VK_SUCCESS : VK_NOT_READY;
    }
-   else if (*timeout == UINT64_MAX)
+
+   /* Let the event thread pick up any idle pixmaps another thread has read from the connection. */
+   wake_present_event_thread();
+
+   if (*timeout == UINT64_MAX)
    {
       while (!free_image_found())
       {
@@ -725,29 +1630,45 @@ VkResult swapchain::get_free_buffer(uint64_t *timeout)
 
 void swapchain::destroy_image(wsi::swapchain_image &image)
 {
-   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
-   if (image.status != wsi::swapchain_image::INVALID)
+   /* Only the first caller to invalidate the image destroys the VkImage. */
+   const auto previous_status = image.status.exchange(wsi::swapchain_image::INVALID);
+   if (previous_status != wsi::swapchain_image::INVALID)
    {
       if (image.image != VK_NULL_HANDLE)
       {
          m_device_data.disp.DestroyImage(m_device, image.image, get_allocation_callbacks());
          image.image = VK_NULL_HANDLE;
       }
-
-      image.status = wsi::swapchain_image::INVALID;
    }
 
-   image_status_lock.unlock();
-
    if (image.data != nullptr)
    {
       auto data = reinterpret_cast<x11_image_data *>(image.data);
+      std::unique_lock<std::mutex> lock(m_pending_pixmaps_lock);
+      if (data->pixmap_check_pending)
+      {
+         /* The pixmap only exists if its creation succeeded, which has to be checked to know whether to free it. */
+         check_pixmap(m_connection, data);
+      }
+      lock.unlock();
+
       if (data->pixmap)
       {
          xcb_free_pixmap(m_connection, data->pixmap);
       }
-      m_allocator.destroy(1, data);
+      if (data->shm_seg != XCB_NONE)
+      {
+         xcb_shm_detach(m_connection, data->shm_seg);
+      }
+      wsialloc_buffer_ref allocated_buffer = std::move(data->allocated_buffer);
+      m_image_allocator.destroy(1, data);
       image.data = nullptr;
+
+      /* The X server sent the idle notification of a free image, and its release point, if any, has signalled. */
+      if (previous_status == wsi::swapchain_image::FREE)
+      {
+         allocated_buffer.release(m_wsi_allocator);
+      }
    }
 }
 
@@ -755,21 +1676,61 @@ VkResult swapchain::image_set_present_payload(swapchain_image &image, VkQueue qu
                                               const queue_submit_semaphores &semaphores, const void *submission_pnext)
 {
    auto data = reinterpret_cast<x11_image_data *>(image.data);
-   return data->present_fence.set_payload(queue, semaphores, submission_pnext);
+   if (m_prime_copy == nullptr)
+   {
+      return data->present_fence.set_payload(queue, semaphores, submission_pnext);
+   }
+
+   /* The copy takes over the wait semaphores, and the payload completes once the shared memory is written. */
+   const auto image_index = static_cast<uint32_t>(&image - m_swapchain_images.data());
+   VkSemaphore copy_done = VK_NULL_HANDLE;
+   TRY_LOG_CALL(m_prime_copy->submit_copy(queue, image_index, image.image, semaphores, copy_done));
+
+   queue_submit_semaphores payload_semaphores = semaphores;
+   payload_semaphores.wait_semaphores = &copy_done;
+   payload_semaphores.wait_semaphores_count = 1;
+   return data->present_fence.set_payload(queue, payload_semaphores, submission_pnext);
 }
 
 VkResult swapchain::image_wait_present(swapchain_image &image, uint64_t timeout)
 {
+   if (m_explicit_sync)
+   {
+      /* With explicit sync the X server waits for the present payload, see present_image. */
+      return VK_SUCCESS;
+   }
+
    auto data = reinterpret_cast<x11_image_data *>(image.data);
    return data->present_fence.wait_payload(timeout);
 }
 
+int swapchain::image_get_present_sync_fd(swapchain_image &image)
+{
+   if (m_explicit_sync)
+   {
+      /* image_wait_present does not wait with explicit sync in use, so there is nothing to poll. */
+      return -1;
+   }
+
+   auto data = reinterpret_cast<x11_image_data *>(image.data);
+   return data->present_fence.get_poll_fd();
+}
+
 VkResult swapchain::bind_swapchain_image(VkDevice &device, const VkBindImageMemoryInfo *bind_image_mem_info,
                                          const VkBindImageMemorySwapchainInfoKHR *bind_sc_info)
 {
    UNUSED(device);
    const wsi::swapchain_image &swapchain_image = m_swapchain_images[bind_sc_info->imageIndex];
+   if (m_prime_copy != nullptr)
+   {
+      return m_prime_copy->bind_alias(bind_sc_info->imageIndex, bind_image_mem_info->image);
+   }
+
    auto image_data = reinterpret_cast<x11_image_data *>(swapchain_image.data);
+   if (m_shm)
+   {
+      return image_data->shm_memory.bind(bind_image_mem_info->image);
+   }
    return image_data->external_mem.bind_swapchain_image_memory(bind_image_mem_info->image);
 }
 
@@ -41,40 +41,91 @@ extern "C" {
 #define __STDC_VERSION__ 0
 #endif
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <mutex>
 #include <xcb/xcb.h>
 #include <xcb/shm.h>
 #include <xcb/present.h>
+#include <xcb/xfixes.h>
 #include <xcb/xproto.h>
 
 #include "surface.hpp"
 #include "util/wsialloc/wsialloc.h"
 #include "wsi/external_memory.hpp"
+#include "wsi/host_memory.hpp"
+#include "wsi/prime_copy.hpp"
+#include "wsi/syncobj_fence_sync.hpp"
+#include "wsi/wsialloc_batch.hpp"
 
 namespace wsi
 {
 namespace x11
 {
 
+/* Longest time the present event thread sleeps while waiting for a completion, in milliseconds. */
+#define X11_PRESENT_EVENT_POLL_TIMEOUT_MS 4
+
+/* Maximum number of presents in flight, must be a power of two. */
+#define X11_SWAPCHAIN_MAX_PENDING_COMPLETIONS 128
+
+/**
+ * @brief A present sent to the X server whose completion has not been notified yet.
+ */
 struct pending_completion
 {
    uint32_t serial;
+   uint32_t image_index;
    uint64_t present_id;
+   bool pending;
+   /* Slot of the frame statistics of the present, see pending_present_request. 0 if they are not recorded. */
+   uint64_t frame_statistics_slot{ 0 };
 };
 
 struct x11_image_data
 {
    x11_image_data(const VkDevice &device, const util::allocator &allocator)
       : external_mem(device, allocator)
+      , shm_memory(device, allocator)
    {
    }
 
    external_memory external_mem;
-   xcb_pixmap_t pixmap;
-   std::vector<pending_completion> pending_completions;
+   /* The buffer of @ref external_mem, given back to the wsialloc cache once the X server has released it. */
+   wsialloc_buffer_ref allocated_buffer;
+   xcb_pixmap_t pixmap{ XCB_NONE };
+
+   /* The id of the pixmap being created by @ref pixmap_cookie, only moved to @ref pixmap once the request succeeded. */
+   xcb_pixmap_t pending_pixmap{ XCB_NONE };
+   /* The request that creates @ref pending_pixmap, while its error has not been checked yet. */
+   xcb_void_cookie_t pixmap_cookie{};
+   bool pixmap_check_pending{ false };
+   /* Number of presents of this image in @ref swapchain::m_pending_completions. */
+   uint32_t pending_completion_count{ 0 };
+
+   syncobj_fence_sync present_fence;
+
+   /* Point on the release timeline signalled once the X server is done with the last present of this image. */
+   uint64_t release_point{ 0 };
+
+   /* With MIT-SHM, the memory of the image and the segment attached to the X server for it. */
+   host_memory shm_memory;
+   xcb_shm_seg_t shm_seg{ XCB_NONE };
+   /* Offset of the image in the segment and length of its rows, in pixels. */
+   uint32_t shm_offset{ 0 };
+   uint32_t shm_row_length{ 0 };
+};
 
-   fence_sync present_fence;
+/**
+ * @brief A DRM timeline syncobj imported into the X server.
+ */
+struct x11_timeline_syncobj
+{
+   uint32_t handle{ 0 };
+   uint32_t xid{ XCB_NONE };
 };
 
 struct image_creation_parameters
@@ -115,6 +166,16 @@ protected:
     */
    VkResult init_platform(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info,
                           bool &use_presentation_thread) override;
+
+   /**
+    * @brief Adds required extensions to the extension list of the swapchain
+    *
+    * @param device Vulkan device
+    * @param swapchain_create_info Swapchain create info
+    * @return VK_SUCCESS on success, other result codes on failure
+    */
+   VkResult add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info) override;
+
    /**
     * @brief Allocates and binds a new swapchain image.
     *
@@ -125,6 +186,17 @@ protected:
     */
    VkResult allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image) override;
 
+   bool supports_parallel_image_creation() const override
+   {
+      return true;
+   }
+
+   VkResult allocate_swapchain_image_buffer(swapchain_image &image) override;
+
+   VkResult export_swapchain_image(const VkImageCreateInfo &image_create_info, swapchain_image &image) override;
+
+   VkResult import_swapchain_image_buffer(swapchain_image &image) override;
+
    /**
     * @brief Creates a new swapchain image.
     *
@@ -153,6 +225,22 @@ protected:
     */
    void destroy_image(wsi::swapchain_image &image) override;
 
+   /**
+    * @brief Target the first present at least at the MSC after the last present sent by the ancestor.
+    *
+    * The X server executes presents in the order of their target MSC, so a present without a target could otherwise
+    * be shown before presents of the ancestor still queued for later refreshes.
+    */
+   void order_after_ancestor(swapchain_base &ancestor) override;
+
+   /**
+    * @brief Report the window hidden while it is unmapped, e.g. minimized.
+    *
+    * Fully covered windows are not detected: that needs visibility events, which would be delivered to the event loop
+    * of the application as the layer shares its connection.
+    */
+   bool is_surface_occluded() override;
+
    /**
     * @brief Sets the present payload for a swapchain image.
     *
@@ -168,6 +256,8 @@ protected:
 
    VkResult image_wait_present(swapchain_image &image, uint64_t timeout) override;
 
+   int image_get_present_sync_fd(swapchain_image &image) override;
+
    /**
     * @brief Bind image to a swapchain
     *
@@ -188,6 +278,15 @@ protected:
     */
    bool free_image_found();
 
+   /**
+    * @brief Make the image of a pixmap the X server has sent an IDLE_NOTIFY for free straight away.
+    *
+    * @param pixmap The idle pixmap.
+    *
+    * @return true if the image was made free, false if it has to be left to @ref free_image_found.
+    */
+   bool recycle_idle_pixmap(xcb_pixmap_t pixmap);
+
    /**
     * @brief Hook for any actions to free up a buffer for acquire
     *
@@ -200,8 +299,92 @@ protected:
    VkResult get_free_buffer(uint64_t *timeout) override;
 
 private:
+#if WSI_X11_EXPLICIT_SYNC
+   /**
+    * @brief Create the acquire and release timelines used for explicit sync with the X server.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code, in which case the swapchain falls back to
+    *         waiting for the present payloads on the CPU.
+    */
+   VkResult init_explicit_sync();
+
+   /**
+    * @brief Destroy the acquire and release timelines.
+    */
+   void destroy_explicit_sync();
+
+   /**
+    * @brief Transfer the present payload of an image to the next point of the acquire timeline.
+    *
+    * @param image_data The image being presented.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult set_acquire_point(x11_image_data *image_data);
+
+   /**
+    * @brief Wait for the X server to release an image that it has sent an IDLE_NOTIFY for.
+    *
+    * @param image_data The image to wait for.
+    * @param block      Whether to block until released, otherwise only check.
+    *
+    * @return true once released, false if not released yet and @p block is false.
+    */
+   bool wait_release_point(x11_image_data *image_data, bool block);
+#endif
+
    VkResult create_pixmap(const VkImageCreateInfo &image_create_info, swapchain_image &image,
                           x11_image_data *image_data);
+
+   /**
+    * @brief Set up presenting with MIT-SHM, see @ref m_shm.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult init_shm();
+
+   /**
+    * @brief Fill the create info of the images presented with MIT-SHM.
+    *
+    * The images are bound to the shared memory if the device can render to them there, otherwise they are copied into
+    * it with @ref m_prime_copy.
+    *
+    * @param[in,out] image_create_info The create info of the swapchain images.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult init_shm_image_create_info(VkImageCreateInfo &image_create_info);
+
+   /**
+    * @brief Bind an image to host memory shared with the X server, or to the copy into it, and attach the memory as a
+    *        MIT-SHM segment.
+    *
+    * @param image      The image, created with @ref m_image_create_info.
+    * @param image_data The data of the image.
+    *
+    * @return VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult allocate_shm_image(swapchain_image &image, x11_image_data *image_data);
+
+   /**
+    * @brief Copy the damage of an image to the window from its MIT-SHM segment.
+    *
+    * @param image_index Index of the image.
+    * @param image_data  The data of the image.
+    *
+    * @return Sequence number of a request whose reply tells that the X server has finished reading the image.
+    */
+   unsigned int put_shm_image(uint32_t image_index, x11_image_data *image_data);
+
+   /**
+    * @brief Collect the errors of the pixmap creation requests that have not been checked yet.
+    *
+    * Pixmaps are created without waiting for the X server, so that creating all the images of a swapchain costs a
+    * single round trip, taken here.
+    *
+    * @return VK_SUCCESS if all the pixmaps were created, VK_ERROR_FORMAT_NOT_SUPPORTED otherwise.
+    */
+   VkResult check_pending_pixmaps();
    VkResult allocate_image(VkImageCreateInfo &image_create_info, x11_image_data *image_data);
    VkResult allocate_wsialloc(VkImageCreateInfo &image_create_info, x11_image_data *image_data,
                               util::vector<wsialloc_format> &importable_formats, wsialloc_format *allocated_format,
@@ -219,6 +402,11 @@ private:
     */
    wsialloc_allocator *m_wsi_allocator;
 
+   /**
+    * @brief Buffers of the swapchain images allocated together on the first allocation.
+    */
+   wsialloc_batch m_batch_allocations;
+
    /**
     * @brief Image creation parameters used for all swapchain images.
     */
@@ -238,18 +426,196 @@ private:
                                            util::vector<uint64_t> &exportable_modifers,
                                            util::vector<VkDrmFormatModifierPropertiesEXT> &drm_format_props);
 
+   /**
+    * @brief Keep only the formats with the modifiers the X server can flip to the window, if there are any.
+    *
+    * The modifiers of the window are preferred, then the ones of its screen. When neither are given, or the device
+    * imports none of them, the formats are left unchanged.
+    *
+    * @param[in,out] importable_formats The formats the images can be allocated with.
+    */
+   void prefer_flip_modifiers(util::vector<wsialloc_format> &importable_formats);
+
+   /**
+    * @brief Whether the X server could flip the window if the images were allocated with another modifier.
+    *
+    * Queries the modifiers the X server supports for the window now, so it must not be called with
+    * @ref m_thread_status_lock held.
+    *
+    * @return true if the device imports one of them and the images use none of them.
+    */
+   bool can_flip_with_other_modifier();
+
+   /**
+    * @brief Handle the completion of a present of the image in @p completion, in the given XCB present mode.
+    *
+    * Called by the present event thread with @ref m_thread_status_lock held.
+    */
+   void record_completion_mode(const pending_completion &completion, uint8_t mode);
+
    uint64_t m_send_sbc;
-   uint64_t m_target_msc;
+
+   /**
+    * @brief Ring of the presents in flight, indexed by their serial (the low bits of @ref m_send_sbc).
+    *
+    * Serials are allocated consecutively, so a slot is free again once the present that is
+    * X11_SWAPCHAIN_MAX_PENDING_COMPLETIONS serials older has completed. Protected by @ref m_thread_status_lock.
+    */
+   std::array<pending_completion, X11_SWAPCHAIN_MAX_PENDING_COMPLETIONS> m_pending_completions;
+   uint32_t m_pending_completion_count;
    uint64_t m_last_present_msc;
 
+   /**
+    * @brief Number of presents the X server completed by flipping to the pixmap and by copying it.
+    *
+    * Protected by @ref m_thread_status_lock.
+    */
+   uint64_t m_flip_count;
+   uint64_t m_copy_count;
+
+   /**
+    * @brief Modifiers of the image format the device imports, the candidates for flipping when the X server copies.
+    */
+   util::vector<uint64_t> m_importable_modifiers;
+
+   /**
+    * @brief Time the present event thread last asked the X server for the modifiers it flips, which it does at most
+    *        once per second while the server reports suboptimal copies.
+    */
+   std::chrono::steady_clock::time_point m_flip_modifier_check_time;
+
+   /**
+    * @brief Lowest target MSC of the next present, set from the ancestor by @ref order_after_ancestor. 0 if none.
+    */
+   uint64_t m_min_target_msc;
+
+   /**
+    * @brief Whether the X server waits for the present payloads, given as points on @ref m_acquire_timeline.
+    *
+    * Otherwise presents are only sent once their payload has completed.
+    */
+   bool m_explicit_sync;
+   int m_drm_fd;
+   x11_timeline_syncobj m_acquire_timeline;
+   x11_timeline_syncobj m_release_timeline;
+   uint64_t m_timeline_point;
+
+   /**
+    * @brief XFixes region holding the damage of the image being presented, XCB_NONE if XFixes is unavailable.
+    */
+   xcb_xfixes_region_t m_update_region;
+
+   /**
+    * @brief XFixes region holding the update region of the last present sent, XCB_NONE if XFixes is unavailable.
+    */
+   xcb_xfixes_region_t m_sent_update_region;
+
+   /**
+    * @brief Whether the last present sent updated the whole window, in which case @ref m_sent_update_region is unused.
+    */
+   bool m_sent_update_full;
+
+   /**
+    * @brief Set @ref m_update_region to the damage of a present.
+    *
+    * The X server replaces a MAILBOX present still queued for the next refresh by the following one, so the damage of
+    * the presents that have not completed is added to a MAILBOX present. Must be called with
+    * @ref m_thread_status_lock held.
+    *
+    * @param damage       The damage of the image being presented.
+    * @param present_mode The present mode of the present.
+    *
+    * @return The update region to present with, XCB_NONE to update the whole window.
+    */
+   xcb_xfixes_region_t set_update_region(const present_damage &damage, VkPresentModeKHR present_mode);
+
    xcb_special_event_t *m_special_event;
+
+   /**
+    * @brief Whether the swapchain is registered with @ref surface::add_configure_listener. Only changed before the
+    *        present event thread starts, by the thread when it stops, and after it has been joined.
+    */
+   bool m_configure_listener{ false };
+
+   /**
+    * @brief Whether the window was not viewable when its attributes were last read. Only updated when acquires are
+    *        throttled while the surface is hidden.
+    */
+   std::atomic<bool> m_window_unmapped{ false };
+
+   /**
+    * @brief Protects the request for the window attributes, which is made by presents and throttled acquires.
+    */
+   std::mutex m_window_attributes_lock;
+
+   /**
+    * @brief Request for the attributes of the window whose reply has not been read yet, with a sequence of 0 if none.
+    */
+   xcb_get_window_attributes_cookie_t m_window_attributes_cookie{ 0 };
+
+   /**
+    * @brief When the attributes of the window were last requested.
+    */
+   std::chrono::steady_clock::time_point m_window_attributes_time{};
+
+   /**
+    * @brief Update @ref m_window_unmapped from the reply to the last request for the window attributes, and request
+    *        them again every half second. Never waits for a reply.
+    */
+   void update_window_unmapped();
    VkPhysicalDeviceMemoryProperties2 m_memory_props;
 
+   /**
+    * @brief Whether the images are presented with MIT-SHM, see @ref surface::use_shm.
+    *
+    * The images are then linear and bound to host memory shared with the X server, which copies them to the window,
+    * so presenting makes no copy on the CPU. Presents complete once the X server has replied to a request sent after
+    * the copy, in the order they were sent.
+    */
+   bool m_shm;
+   xcb_gcontext_t m_shm_gc;
+   uint8_t m_shm_depth;
+   /** The last present sent with MIT-SHM that has completed. */
+   uint64_t m_shm_completed_sbc;
+   /** Copies of the images into the shared memory, used with MIT-SHM when the device cannot render to it. */
+   util::unique_ptr<prime_copy> m_prime_copy;
+
    void present_event_thread();
+
+   /**
+    * @brief Thread releasing the images presented with MIT-SHM once the X server has copied them.
+    */
+   void shm_present_event_thread();
+
+   /**
+    * @brief Wake the present event thread up, so that it re-checks its state and the connection's event queue.
+    */
+   void wake_present_event_thread();
+
+   /**
+    * @brief Block the present event thread until the X server connection or the wake up event is readable.
+    *
+    * @param completions_pending Whether presents are waiting for their completion, which bounds the wait.
+    * @return true on success, false if the file descriptors cannot be polled.
+    */
+   bool wait_for_present_events(bool completions_pending);
+
    bool m_present_event_thread_run;
+   util::fd_owner m_present_event_wakeup_fd;
    std::thread m_present_event_thread;
    std::mutex m_thread_status_lock;
    std::condition_variable m_thread_status_cond;
+
+   /**
+    * @brief Protects the pixmap, pending_pixmap and pixmap_check_pending state of the images and
+    *        @ref m_pixmap_batch_checked.
+    */
+   std::mutex m_pending_pixmaps_lock;
+
+   /**
+    * @brief Whether the pixmaps sent in a batch on swapchain creation have been checked.
+    */
+   bool m_pixmap_batch_checked;
    util::ring_buffer<xcb_pixmap_t, 6> m_free_buffer_pool;
 };
 